@@ -217,6 +217,7 @@ void TF_AssignVariable(TF_OpKernelContext* ctx, int input_index,
     *variable->tensor() = value;
   }
   variable->is_initialized = true;
+  variable->MarkUpdated();
   TF_SetStatus(status, TF_OK, "");
 }
 
@@ -285,6 +286,7 @@ void TF_AssignUpdateVariable(TF_OpKernelContext* ctx, int input_index,
   TF_Tensor* tf_var_tensor = TF_TensorFromTensor(*var_tensor, &s);
   TF_Tensor* tf_value = TF_TensorFromTensor(value, &s);
   updateFunc(ctx, tf_var_tensor, tf_value, Op);
+  variable->MarkUpdated();
   TF_SetStatus(tf_status, TF_OK, "");
 }
 
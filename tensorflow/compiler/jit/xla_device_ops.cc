@@ -67,6 +67,7 @@ void XlaAssignVariableOp::Compute(OpKernelContext* context) {
           DataTypeString(dtype_)));
   variable->is_initialized = true;
   *variable->tensor() = value;
+  variable->MarkUpdated();
 }
 
 }  // namespace tensorflow
@@ -503,6 +503,7 @@ Status XlaComputationLaunchContext::PopulateOutputs(
                                    use_multiple_streams_, definition_event));
     var->is_initialized |= write.modified;
     *var->tensor() = output_tensor;
+    var->MarkUpdated();
     ++output_num;
   }
   return OkStatus();
@@ -0,0 +1,65 @@
+// RUN: tf-opt %s -tfl-rematerialize | FileCheck %s
+// RUN: tf-opt %s -tfl-rematerialize=max-cost=0 | FileCheck %s --check-prefix=NO-COST
+
+// The large result of the first broadcast is alive during the second one,
+// rematerializing it after the second one lowers the peak.
+// CHECK-LABEL: @remat_broadcast
+// NO-COST-LABEL: @remat_broadcast
+func.func @remat_broadcast(%arg0: tensor<1xf32>) -> tensor<1000xf32> {
+  %shape0 = "tfl.pseudo_const"() {value = dense<[1000]> : tensor<1xi32>} : () -> tensor<1xi32>
+  %shape1 = "tfl.pseudo_const"() {value = dense<[2000]> : tensor<1xi32>} : () -> tensor<1xi32>
+  %axis = "tfl.pseudo_const"() {value = dense<[0]> : tensor<1xi32>} : () -> tensor<1xi32>
+  %0 = "tfl.broadcast_to"(%arg0, %shape0) : (tensor<1xf32>, tensor<1xi32>) -> tensor<1000xf32>
+  %1 = "tfl.sum"(%0, %axis) {keep_dims = true} : (tensor<1000xf32>, tensor<1xi32>) -> tensor<1xf32>
+  %2 = "tfl.broadcast_to"(%1, %shape1) : (tensor<1xf32>, tensor<1xi32>) -> tensor<2000xf32>
+  %3 = "tfl.sum"(%2, %axis) {keep_dims = true} : (tensor<2000xf32>, tensor<1xi32>) -> tensor<1xf32>
+  %4 = "tfl.add"(%0, %3) {fused_activation_function = "NONE"} : (tensor<1000xf32>, tensor<1xf32>) -> tensor<1000xf32>
+  func.return %4 : tensor<1000xf32>
+}
+// CHECK: %[[BROADCAST0:.*]] = "tfl.broadcast_to"(%arg0, %[[SHAPE0:.*]]) :
+// CHECK-NEXT: %[[SUM0:.*]] = "tfl.sum"(%[[BROADCAST0]],
+// CHECK-NEXT: %[[BROADCAST1:.*]] = "tfl.broadcast_to"(%[[SUM0]],
+// CHECK-NEXT: %[[SUM1:.*]] = "tfl.sum"(%[[BROADCAST1]],
+// CHECK-NEXT: %[[REMAT:.*]] = "tfl.broadcast_to"(%arg0, %[[SHAPE0]]) :
+// CHECK-NEXT: tfl.add{{.*}}%[[REMAT]], %[[SUM1]]
+// NO-COST: "tfl.broadcast_to"
+// NO-COST: "tfl.broadcast_to"
+// NO-COST-NOT: "tfl.broadcast_to"
+
+// Ops with side effects are never rematerialized.
+// CHECK-LABEL: @no_remat_with_side_effects
+// NO-COST-LABEL: @no_remat_with_side_effects
+func.func @no_remat_with_side_effects(%arg0: tensor<1xf32>) -> tensor<1000xf32> {
+  %shape0 = "tfl.pseudo_const"() {value = dense<[1000]> : tensor<1xi32>} : () -> tensor<1xi32>
+  %shape1 = "tfl.pseudo_const"() {value = dense<[2000]> : tensor<1xi32>} : () -> tensor<1xi32>
+  %axis = "tfl.pseudo_const"() {value = dense<[0]> : tensor<1xi32>} : () -> tensor<1xi32>
+  %0 = "tfl.random_uniform"(%shape0) {seed = 0 : i64, seed2 = 0 : i64} : (tensor<1xi32>) -> tensor<1000xf32>
+  %1 = "tfl.sum"(%0, %axis) {keep_dims = true} : (tensor<1000xf32>, tensor<1xi32>) -> tensor<1xf32>
+  %2 = "tfl.broadcast_to"(%1, %shape1) : (tensor<1xf32>, tensor<1xi32>) -> tensor<2000xf32>
+  %3 = "tfl.sum"(%2, %axis) {keep_dims = true} : (tensor<2000xf32>, tensor<1xi32>) -> tensor<1xf32>
+  %4 = "tfl.add"(%0, %3) {fused_activation_function = "NONE"} : (tensor<1000xf32>, tensor<1xf32>) -> tensor<1000xf32>
+  func.return %4 : tensor<1000xf32>
+}
+// CHECK: "tfl.random_uniform"
+// CHECK-NOT: "tfl.random_uniform"
+// CHECK: return
+
+// Convolutions cost much more than the data they read and write, so they are
+// never rematerialized.
+// CHECK-LABEL: @no_remat_conv
+// NO-COST-LABEL: @no_remat_conv
+func.func @no_remat_conv(%arg0: tensor<1x32x32x8xf32>) -> tensor<1x32x32x16xf32> {
+  %filter = "tfl.pseudo_const"() {value = dense<1.0> : tensor<16x3x3x8xf32>} : () -> tensor<16x3x3x8xf32>
+  %bias = "tfl.pseudo_const"() {value = dense<0.0> : tensor<16xf32>} : () -> tensor<16xf32>
+  %shape = "tfl.pseudo_const"() {value = dense<[1, 32, 32, 32]> : tensor<4xi32>} : () -> tensor<4xi32>
+  %axes = "tfl.pseudo_const"() {value = dense<[1, 2, 3]> : tensor<3xi32>} : () -> tensor<3xi32>
+  %0 = "tfl.conv_2d"(%arg0, %filter, %bias) {dilation_h_factor = 1 : i32, dilation_w_factor = 1 : i32, fused_activation_function = "NONE", padding = "SAME", stride_h = 1 : i32, stride_w = 1 : i32} : (tensor<1x32x32x8xf32>, tensor<16x3x3x8xf32>, tensor<16xf32>) -> tensor<1x32x32x16xf32>
+  %1 = "tfl.sum"(%0, %axes) {keep_dims = true} : (tensor<1x32x32x16xf32>, tensor<3xi32>) -> tensor<1x1x1x1xf32>
+  %2 = "tfl.broadcast_to"(%1, %shape) : (tensor<1x1x1x1xf32>, tensor<4xi32>) -> tensor<1x32x32x32xf32>
+  %3 = "tfl.sum"(%2, %axes) {keep_dims = true} : (tensor<1x32x32x32xf32>, tensor<3xi32>) -> tensor<1x1x1x1xf32>
+  %4 = "tfl.add"(%0, %3) {fused_activation_function = "NONE"} : (tensor<1x32x32x16xf32>, tensor<1x1x1x1xf32>) -> tensor<1x32x32x16xf32>
+  func.return %4 : tensor<1x32x32x16xf32>
+}
+// CHECK: "tfl.conv_2d"
+// CHECK-NOT: "tfl.conv_2d"
+// CHECK: return
@@ -462,6 +462,14 @@ void AddPostVariableFreezingTFToTFLConversionPasses(
     pass_manager->addNestedPass<mlir::func::FuncOp>(
         mlir::TFL::CreateSplitMergedOperandsPass());
 
+    // Runs last, as it assumes that the ops keep their order.
+    if (toco_flags.rematerialization_max_cost() != 0) {
+      pass_manager->addNestedPass<mlir::func::FuncOp>(
+          mlir::TFL::CreateRematerializePass(
+              toco_flags.rematerialization_max_cost(),
+              /*max_block_length=*/1, /*min_savings=*/1));
+    }
+
     // Add CallOnceOp when there is a session initializer function in tf saved
     // model dialect.
     pass_manager->addPass(
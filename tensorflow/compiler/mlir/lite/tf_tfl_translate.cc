@@ -307,6 +307,7 @@ int main(int argc, char **argv) {
   toco_flags.set_legalize_custom_tensor_list_ops(
       legalize_custom_tensor_list_ops);
   toco_flags.set_reduce_type_precision(reduce_type_precision);
+  toco_flags.set_rematerialization_max_cost(rematerialization_max_cost);
   // Read list of user select ops.
   llvm::SmallVector<llvm::StringRef, 2> user_ops;
   (llvm::StringRef(select_user_tf_ops))
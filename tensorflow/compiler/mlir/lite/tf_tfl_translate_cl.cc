@@ -203,3 +203,11 @@ opt<bool> reduce_type_precision(
                    "within the reduced precision range. This could have side "
                    "effects triggered by downstream packing algorithms."),
     llvm::cl::init(false));
+
+// NOLINTNEXTLINE
+opt<int> rematerialization_max_cost(
+    "rematerialization-max-cost",
+    llvm::cl::desc("Maximum number of ops to clone per function to lower its "
+                   "peak memory, no rematerialization if 0 and no limit if "
+                   "negative."),
+    llvm::cl::init(0));
@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef TENSORFLOW_COMPILER_MLIR_LITE_TRANSFORMS_PASSES_H_
 #define TENSORFLOW_COMPILER_MLIR_LITE_TRANSFORMS_PASSES_H_
 
+#include <cstdint>
 #include <memory>
 #include <string>
 
@@ -237,6 +238,13 @@ std::unique_ptr<OperationPass<ModuleOp>> CreateReduceTypePrecisionPass();
 std::unique_ptr<OperationPass<func::FuncOp>>
 CreatePartitionedTopologicalSortPass();
 
+// Creates a pass that clones operations to lower the peak memory of the
+// function. `max_cost` is the maximum number of cloned operations, unlimited
+// if negative.
+std::unique_ptr<OperationPass<func::FuncOp>> CreateRematerializePass();
+std::unique_ptr<OperationPass<func::FuncOp>> CreateRematerializePass(
+    int max_cost, int max_block_length, int64_t min_savings);
+
 #define GEN_PASS_DECL_DEFAULTQUANTPARAMSPASS
 #define GEN_PASS_DECL_DENSETOSPARSEPASS
 #define GEN_PASS_DECL_LEGALIZETFPASS
@@ -0,0 +1,234 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// This file implements a pass that lowers the peak memory of a function by
+// rematerializing intermediate tensors, using the Rematerializer to model the
+// memory profile of the function and to find the operations to clone.
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/Casting.h"
+#include "mlir/Dialect/Func/IR/FuncOps.h"  // from @llvm-project
+#include "mlir/Dialect/Quant/QuantTypes.h"  // from @llvm-project
+#include "mlir/IR/Block.h"  // from @llvm-project
+#include "mlir/IR/Builders.h"  // from @llvm-project
+#include "mlir/IR/BuiltinTypes.h"  // from @llvm-project
+#include "mlir/IR/IRMapping.h"  // from @llvm-project
+#include "mlir/IR/Operation.h"  // from @llvm-project
+#include "mlir/IR/ValueRange.h"  // from @llvm-project
+#include "mlir/Interfaces/SideEffectInterfaces.h"  // from @llvm-project
+#include "mlir/Pass/Pass.h"  // from @llvm-project
+#include "tensorflow/compiler/mlir/lite/experimental/remat/rematerializer.h"
+#include "tensorflow/compiler/mlir/lite/ir/tfl_ops.h"
+#include "tensorflow/compiler/mlir/lite/transforms/passes.h"
+
+namespace mlir {
+namespace TFL {
+namespace {
+#define GEN_PASS_DEF_REMATERIALIZEPASS
+#include "tensorflow/compiler/mlir/lite/transforms/passes.h.inc"
+
+// Returns the number of bytes of the arena taken by `value`, or 0 if it isn't
+// statically known.
+Rematerializer::SizeT GetSize(Value value) {
+  auto type = value.getType().dyn_cast<ShapedType>();
+  if (!type || !type.hasStaticShape()) return 0;
+  Type element_type = type.getElementType();
+  if (auto quantized_type = element_type.dyn_cast<quant::QuantizedType>()) {
+    element_type = quantized_type.getStorageType();
+  }
+  int64_t bit_width = 0;
+  if (auto complex_type = element_type.dyn_cast<ComplexType>()) {
+    if (complex_type.getElementType().isIntOrFloat()) {
+      bit_width = 2 * complex_type.getElementType().getIntOrFloatBitWidth();
+    }
+  } else if (element_type.isIntOrFloat()) {
+    bit_width = element_type.getIntOrFloatBitWidth();
+  }
+  return type.getNumElements() * ((bit_width + 7) / 8);
+}
+
+// Operations whose results mustn't be recomputed.
+bool IsStateful(Operation* op) {
+  return op->hasTrait<OpTrait::IsTerminator>() || op->getNumRegions() != 0 ||
+         !isMemoryEffectFree(op);
+}
+
+// Largest arithmetic count per element read or written of an operation cheap
+// enough to be cloned.
+constexpr int64_t kMaxArithmeticCountPerElement = 8;
+
+// Returns the total number of elements of `values`, or -1 if it isn't
+// statically known.
+int64_t GetNumElements(ValueRange values) {
+  int64_t num_elements = 0;
+  for (Value value : values) {
+    auto type = value.getType().dyn_cast<ShapedType>();
+    if (!type || !type.hasStaticShape()) return -1;
+    num_elements += type.getNumElements();
+  }
+  return num_elements;
+}
+
+// Whether the compute cost of `op` is bounded by the data it reads and writes,
+// e.g. elementwise operations, reductions or data movement. The budget of the
+// pass counts cloned operations, so only such operations are cloned: a single
+// clone of a convolution or matrix multiplication may cost more than the rest
+// of the function.
+bool IsCheapToClone(Operation* op) {
+  // Contractions and recurrent operations which don't estimate their
+  // arithmetic count.
+  if (llvm::isa<BatchMatMulOp, Conv3DOp, Conv3DTransposeOp, BasicLSTMOp,
+                LSTMOp, UnidirectionalSequenceLSTMOp,
+                BidirectionalSequenceLSTMOp, UnidirectionalSequenceRNNOp,
+                SVDFOp, RFFT2dOp>(op)) {
+    return false;
+  }
+  auto arithmetic_count_op = llvm::dyn_cast<TflArithmeticCountOpInterface>(op);
+  if (!arithmetic_count_op) return true;
+  const int64_t arithmetic_count = arithmetic_count_op.GetArithmeticCount(op);
+  const int64_t num_operand_elements = GetNumElements(op->getOperands());
+  const int64_t num_result_elements = GetNumElements(op->getResults());
+  if (arithmetic_count < 0 || num_operand_elements < 0 ||
+      num_result_elements < 0) {
+    return false;
+  }
+  return arithmetic_count <= kMaxArithmeticCountPerElement *
+                                 (num_operand_elements + num_result_elements);
+}
+
+// The Rematerializer's model of the operations of a block, which applies the
+// rematerializations it finds to the block.
+class BlockRematerializer : public Rematerializer {
+ public:
+  explicit BlockRematerializer(Block& block) : block_(block) {
+    llvm::DenseMap<Value, int> tensors;
+    const auto get_tensor = [&](Value value) {
+      auto [iter, inserted] = tensors.try_emplace(value, 0);
+      if (inserted) iter->second = AddTensor(GetSize(value));
+      return iter->second;
+    };
+
+    // Block arguments are allocated before the first operation.
+    const int arguments = AddOperation(/*is_stateful=*/true);
+    operations_.push_back(nullptr);
+    for (BlockArgument argument : block.getArguments()) {
+      AddUse(arguments, get_tensor(argument));
+    }
+
+    for (Operation& op : block) {
+      // Constants don't take memory in the arena.
+      if (op.hasTrait<OpTrait::ConstantLike>()) continue;
+      const int ioperation =
+          AddOperation(IsStateful(&op) || !IsCheapToClone(&op));
+      operations_.push_back(&op);
+      for (Value result : op.getResults()) {
+        AddUse(ioperation, get_tensor(result));
+      }
+      // Uses in nested regions keep tensors alive until the end of `op`.
+      op.walk([&](Operation* nested) {
+        for (Value operand : nested->getOperands()) {
+          if (auto iter = tensors.find(operand); iter != tensors.end()) {
+            AddUse(ioperation, iter->second);
+          }
+        }
+      });
+    }
+  }
+
+  // Clones the operations [remat.begin, remat.end) in front of the operation
+  // remat.insert, and lets that operation and all later ones use the results
+  // of the clones instead of the original results.
+  void ApplyRemat(const RematSpec& remat) override {
+    Operation* insert_before = operations_[remat.insert];
+    OpBuilder builder(insert_before);
+    IRMapping mapping;
+    std::vector<Operation*> clones;
+    for (int i = remat.begin; i < remat.end; ++i) {
+      Operation* original = operations_[i];
+      Operation* clone = builder.clone(*original, mapping);
+      clones.push_back(clone);
+      for (auto [original_result, clone_result] :
+           llvm::zip(original->getResults(), clone->getResults())) {
+        original_result.replaceUsesWithIf(clone_result, [&](OpOperand& use) {
+          Operation* user = block_.findAncestorOpInBlock(*use.getOwner());
+          return user != nullptr && !user->isBeforeInBlock(insert_before);
+        });
+      }
+    }
+    operations_.insert(operations_.begin() + remat.insert, clones.begin(),
+                       clones.end());
+    num_cloned_operations_ += clones.size();
+  }
+
+  int num_cloned_operations() const { return num_cloned_operations_; }
+
+ private:
+  Block& block_;
+  // The operation of each index of the Rematerializer, nullptr for the
+  // allocation of the block arguments.
+  std::vector<Operation*> operations_;
+  int num_cloned_operations_ = 0;
+};
+
+class RematerializePass
+    : public impl::RematerializePassBase<RematerializePass> {
+ public:
+  MLIR_DEFINE_EXPLICIT_INTERNAL_INLINE_TYPE_ID(RematerializePass)
+
+  RematerializePass() = default;
+  RematerializePass(int max_cost, int max_block_length, int64_t min_savings) {
+    max_cost_ = max_cost;
+    max_block_length_ = max_block_length;
+    min_savings_ = min_savings;
+  }
+
+  void runOnOperation() override;
+};
+
+void RematerializePass::runOnOperation() {
+  func::FuncOp func = getOperation();
+  if (!func.getBody().hasOneBlock()) return;
+
+  BlockRematerializer rematerializer(func.getBody().front());
+  const Rematerializer::SizeT peak_before =
+      rematerializer.GetPeakMemory().size;
+  rematerializer.RunGreedyAlgorithm(max_cost_, max_block_length_,
+                                    min_savings_);
+  if (rematerializer.num_cloned_operations() == 0) return;
+  emitRemark(func.getLoc(), func.getName())
+      << ": rematerialized " << rematerializer.num_cloned_operations()
+      << " ops, peak memory lowered from " << peak_before << " to "
+      << rematerializer.GetPeakMemory().size << " bytes";
+}
+
+}  // namespace
+
+std::unique_ptr<OperationPass<func::FuncOp>> CreateRematerializePass() {
+  return std::make_unique<RematerializePass>();
+}
+
+std::unique_ptr<OperationPass<func::FuncOp>> CreateRematerializePass(
+    int max_cost, int max_block_length, int64_t min_savings) {
+  return std::make_unique<RematerializePass>(max_cost, max_block_length,
+                                             min_savings);
+}
+
+}  // namespace TFL
+}  // namespace mlir
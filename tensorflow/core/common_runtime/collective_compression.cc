@@ -0,0 +1,183 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/collective_compression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "tensorflow/core/framework/bfloat16.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+namespace collective_compression {
+namespace {
+
+// An int8 encoded chunk starts with the float scale of the chunk, followed by
+// one quantized value per element.
+constexpr int64_t kScaleBytes = sizeof(float);
+constexpr float kInt8Max = 127.0f;
+
+float GetScale(const Tensor& encoded) {
+  float scale;
+  std::memcpy(&scale, encoded.tensor_data().data(), kScaleBytes);
+  return scale;
+}
+
+}  // namespace
+
+Status ValidateCompression(CollectiveCompression compression,
+                           DataType data_type, const DeviceType& device_type) {
+  if (compression == COMPRESSION_NONE) return OkStatus();
+  if (compression != COMPRESSION_BF16 && compression != COMPRESSION_INT8) {
+    return errors::InvalidArgument("Unknown collective compression ",
+                                   compression);
+  }
+  if (data_type != DT_FLOAT) {
+    return errors::InvalidArgument(
+        "Collective compression is only supported for float32, got ",
+        DataTypeString(data_type));
+  }
+  if (device_type != DeviceType(DEVICE_CPU)) {
+    return errors::InvalidArgument(
+        "Collective compression is only supported on CPU, got ",
+        device_type.type_string());
+  }
+  return OkStatus();
+}
+
+Tensor AllocateEncodedChunk(CollectiveCompression compression,
+                            Allocator* allocator, int64_t num_elements) {
+  switch (compression) {
+    case COMPRESSION_BF16:
+      return Tensor(allocator, DT_BFLOAT16, TensorShape({num_elements}));
+    case COMPRESSION_INT8:
+      return Tensor(allocator, DT_INT8,
+                    TensorShape({kScaleBytes + num_elements}));
+    default:
+      LOG(FATAL) << "Unexpected collective compression " << compression;
+      return Tensor();
+  }
+}
+
+void EncodeChunk(CollectiveCompression compression, Tensor* chunk,
+                 Tensor* residual, bool write_back, Tensor* encoded) {
+  const int64_t n = chunk->NumElements();
+  float* values = chunk->flat<float>().data();
+  float* errors = residual ? residual->flat<float>().data() : nullptr;
+  switch (compression) {
+    case COMPRESSION_BF16: {
+      bfloat16* out = encoded->flat<bfloat16>().data();
+      for (int64_t i = 0; i < n; ++i) {
+        const float x = errors ? values[i] + errors[i] : values[i];
+        out[i] = static_cast<bfloat16>(x);
+        const float decoded = static_cast<float>(out[i]);
+        if (errors) errors[i] = x - decoded;
+        if (write_back) values[i] = decoded;
+      }
+      break;
+    }
+    case COMPRESSION_INT8: {
+      float max_abs = 0.0f;
+      for (int64_t i = 0; i < n; ++i) {
+        const float x = errors ? values[i] + errors[i] : values[i];
+        max_abs = std::max(max_abs, std::abs(x));
+      }
+      const float scale = max_abs / kInt8Max;
+      const float inv_scale = scale > 0.0f ? 1.0f / scale : 0.0f;
+      auto flat = encoded->flat<int8>();
+      std::memcpy(flat.data(), &scale, kScaleBytes);
+      int8* out = flat.data() + kScaleBytes;
+      for (int64_t i = 0; i < n; ++i) {
+        const float x = errors ? values[i] + errors[i] : values[i];
+        const float q = std::min(
+            kInt8Max, std::max(-kInt8Max, std::nearbyint(x * inv_scale)));
+        out[i] = static_cast<int8>(q);
+        const float decoded = q * scale;
+        if (errors) errors[i] = x - decoded;
+        if (write_back) values[i] = decoded;
+      }
+      break;
+    }
+    default:
+      LOG(FATAL) << "Unexpected collective compression " << compression;
+  }
+}
+
+void DecodeChunk(CollectiveCompression compression, const Tensor& encoded,
+                 Tensor* chunk) {
+  auto values = chunk->flat<float>();
+  switch (compression) {
+    case COMPRESSION_BF16:
+      values = encoded.flat<bfloat16>().cast<float>();
+      break;
+    case COMPRESSION_INT8: {
+      const float scale = GetScale(encoded);
+      const int8* in = encoded.flat<int8>().data() + kScaleBytes;
+      for (int64_t i = 0; i < values.size(); ++i) {
+        values(i) = static_cast<float>(in[i]) * scale;
+      }
+      break;
+    }
+    default:
+      LOG(FATAL) << "Unexpected collective compression " << compression;
+  }
+}
+
+ResidualStore* ResidualStore::Global() {
+  static ResidualStore* store = new ResidualStore;
+  return store;
+}
+
+Tensor ResidualStore::Get(const string& device, int32_t group_key,
+                          int32_t instance_key, int64_t num_elements) {
+  mutex_lock l(mu_);
+  Key key(device, group_key, instance_key);
+  auto it = residuals_.find(key);
+  if (it == residuals_.end()) {
+    lru_.push_front(key);
+    it = residuals_.emplace(std::move(key), Entry{Tensor(), lru_.begin()})
+             .first;
+  } else {
+    lru_.splice(lru_.begin(), lru_, it->second.position);
+  }
+  Tensor& residual = it->second.residual;
+  if (!residual.IsInitialized() || residual.NumElements() != num_elements) {
+    total_bytes_ -= residual.TotalBytes();
+    residual = Tensor(DT_FLOAT, TensorShape({num_elements}));
+    residual.flat<float>().setZero();
+    total_bytes_ += residual.TotalBytes();
+  }
+  Tensor result = residual;
+
+  // Evicts the least recently used residuals, but never the one returned.
+  while (total_bytes_ > max_bytes_ && lru_.size() > 1) {
+    auto evicted = residuals_.find(lru_.back());
+    total_bytes_ -= evicted->second.residual.TotalBytes();
+    residuals_.erase(evicted);
+    lru_.pop_back();
+  }
+  return result;
+}
+
+int64_t ResidualStore::TotalBytes() const {
+  mutex_lock l(mu_);
+  return total_bytes_;
+}
+
+}  // namespace collective_compression
+}  // namespace tensorflow
@@ -0,0 +1,96 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_COLLECTIVE_COMPRESSION_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_COLLECTIVE_COMPRESSION_H_
+
+#include <list>
+#include <string>
+#include <tuple>
+
+#include "absl/container/flat_hash_map.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/collective.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+
+namespace tensorflow {
+namespace collective_compression {
+
+// Returns OK if a collective over `data_type` values on `device_type` can
+// transfer its chunks with `compression`.
+Status ValidateCompression(CollectiveCompression compression,
+                           DataType data_type, const DeviceType& device_type);
+
+// Returns a tensor able to hold the encoding of `num_elements` floats.
+Tensor AllocateEncodedChunk(CollectiveCompression compression,
+                            Allocator* allocator, int64_t num_elements);
+
+// Encodes the DT_FLOAT tensor `chunk` into `encoded`, which must have been
+// allocated by AllocateEncodedChunk.  If `residual` is non-null it is added to
+// `chunk` before encoding and then replaced by the resulting quantization
+// error.  If `write_back` is true `chunk` is replaced by its decoded value,
+// so that it matches what receivers of `encoded` will see.
+void EncodeChunk(CollectiveCompression compression, Tensor* chunk,
+                 Tensor* residual, bool write_back, Tensor* encoded);
+
+// Decodes `encoded` into the DT_FLOAT tensor `chunk`.
+void DecodeChunk(CollectiveCompression compression, const Tensor& encoded,
+                 Tensor* chunk);
+
+// Holds the error feedback residuals of compressed collectives, one per
+// device and collective instance, across executions.  Instance keys may change
+// on every call, so the store keeps at most `max_bytes` of residuals and
+// evicts the least recently used ones beyond that.  An evicted residual only
+// loses the error not yet fed back.
+class ResidualStore {
+ public:
+  static constexpr int64_t kDefaultMaxBytes = 256 << 20;
+
+  explicit ResidualStore(int64_t max_bytes = kDefaultMaxBytes)
+      : max_bytes_(max_bytes) {}
+
+  static ResidualStore* Global();
+
+  // Returns the residual of `device` for the collective instance, which
+  // aliases the stored buffer.  The residual is zero-initialized when first
+  // requested, after its eviction or when `num_elements` changes.
+  Tensor Get(const string& device, int32_t group_key, int32_t instance_key,
+             int64_t num_elements) TF_LOCKS_EXCLUDED(mu_);
+
+  // Returns the number of bytes of the stored residuals.
+  int64_t TotalBytes() const TF_LOCKS_EXCLUDED(mu_);
+
+ private:
+  using Key = std::tuple<string, int32_t, int32_t>;
+  struct Entry {
+    Tensor residual;
+    std::list<Key>::iterator position;  // In lru_.
+  };
+
+  const int64_t max_bytes_;
+  mutable mutex mu_;
+  absl::flat_hash_map<Key, Entry> residuals_ TF_GUARDED_BY(mu_);
+  // The keys of residuals_, from the most recently used.
+  std::list<Key> lru_ TF_GUARDED_BY(mu_);
+  int64_t total_bytes_ TF_GUARDED_BY(mu_) = 0;
+};
+
+}  // namespace collective_compression
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_COLLECTIVE_COMPRESSION_H_
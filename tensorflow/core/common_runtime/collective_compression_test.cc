@@ -0,0 +1,145 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/collective_compression.h"
+
+#include <vector>
+
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace collective_compression {
+namespace {
+
+Tensor RoundTrip(CollectiveCompression compression, Tensor* chunk,
+                 Tensor* residual, bool write_back) {
+  Tensor encoded = AllocateEncodedChunk(compression, cpu_allocator(),
+                                        chunk->NumElements());
+  EncodeChunk(compression, chunk, residual, write_back, &encoded);
+  Tensor decoded(DT_FLOAT, chunk->shape());
+  DecodeChunk(compression, encoded, &decoded);
+  return decoded;
+}
+
+TEST(CollectiveCompressionTest, ValidateCompression) {
+  TF_EXPECT_OK(ValidateCompression(COMPRESSION_NONE, DT_INT64,
+                                   DeviceType(DEVICE_GPU)));
+  TF_EXPECT_OK(ValidateCompression(COMPRESSION_INT8, DT_FLOAT,
+                                   DeviceType(DEVICE_CPU)));
+  EXPECT_TRUE(errors::IsInvalidArgument(ValidateCompression(
+      COMPRESSION_BF16, DT_DOUBLE, DeviceType(DEVICE_CPU))));
+  EXPECT_TRUE(errors::IsInvalidArgument(ValidateCompression(
+      COMPRESSION_INT8, DT_FLOAT, DeviceType(DEVICE_GPU))));
+  EXPECT_TRUE(errors::IsInvalidArgument(ValidateCompression(
+      static_cast<CollectiveCompression>(7), DT_FLOAT,
+      DeviceType(DEVICE_CPU))));
+}
+
+TEST(CollectiveCompressionTest, Bfloat16RoundTrip) {
+  Tensor chunk = test::AsTensor<float>({1.0f, -2.5f, 3.14159f, 1e-3f});
+  Tensor decoded = RoundTrip(COMPRESSION_BF16, &chunk, nullptr,
+                             /*write_back=*/false);
+  test::ExpectTensorNear<float>(chunk, decoded, 1e-2);
+  EXPECT_EQ(3.14159f, chunk.flat<float>()(2));
+}
+
+TEST(CollectiveCompressionTest, Int8RoundTrip) {
+  Tensor chunk = test::AsTensor<float>({127.0f, -63.5f, 0.0f, 10.0f});
+  Tensor decoded = RoundTrip(COMPRESSION_INT8, &chunk, nullptr,
+                             /*write_back=*/false);
+  test::ExpectTensorNear<float>(chunk, decoded, 0.5f);
+  EXPECT_EQ(127.0f, decoded.flat<float>()(0));
+}
+
+TEST(CollectiveCompressionTest, Int8AllZeros) {
+  Tensor chunk(DT_FLOAT, TensorShape({16}));
+  chunk.flat<float>().setZero();
+  Tensor decoded = RoundTrip(COMPRESSION_INT8, &chunk, nullptr,
+                             /*write_back=*/false);
+  test::ExpectTensorEqual<float>(chunk, decoded);
+}
+
+TEST(CollectiveCompressionTest, WriteBackMatchesDecoded) {
+  for (auto compression : {COMPRESSION_BF16, COMPRESSION_INT8}) {
+    Tensor chunk(DT_FLOAT, TensorShape({100}));
+    chunk.flat<float>().setRandom();
+    Tensor decoded =
+        RoundTrip(compression, &chunk, nullptr, /*write_back=*/true);
+    test::ExpectTensorEqual<float>(decoded, chunk);
+  }
+}
+
+TEST(CollectiveCompressionTest, ErrorFeedback) {
+  // A value too small to be represented next to the chunk maximum is lost
+  // without error feedback, but accumulates in the residual until sent.
+  Tensor residual(DT_FLOAT, TensorShape({2}));
+  residual.flat<float>().setZero();
+  float sent = 0.0f;
+  const int kSteps = 100;
+  for (int step = 0; step < kSteps; ++step) {
+    Tensor chunk = test::AsTensor<float>({127.0f, 0.1f});
+    Tensor decoded = RoundTrip(COMPRESSION_INT8, &chunk, &residual,
+                               /*write_back=*/false);
+    sent += decoded.flat<float>()(1);
+    // The residual holds exactly what has not been sent so far.
+    EXPECT_NEAR(0.1f * (step + 1) - sent, residual.flat<float>()(1), 1e-3);
+  }
+  EXPECT_NEAR(0.1f * kSteps, sent, 1.0f);
+}
+
+TEST(CollectiveCompressionTest, ResidualStore) {
+  ResidualStore store;
+  Tensor residual = store.Get("/device:CPU:0", 1, 2, 8);
+  test::ExpectTensorEqual<float>(test::AsTensor<float>(std::vector<float>(8)),
+                                 residual);
+  residual.flat<float>()(3) = 1.0f;
+  // Updates are visible to later executions of the same instance only.
+  EXPECT_EQ(1.0f, store.Get("/device:CPU:0", 1, 2, 8).flat<float>()(3));
+  EXPECT_EQ(0.0f, store.Get("/device:CPU:1", 1, 2, 8).flat<float>()(3));
+  EXPECT_EQ(0.0f, store.Get("/device:CPU:0", 1, 3, 8).flat<float>()(3));
+  // A different size resets the residual.
+  EXPECT_EQ(0.0f, store.Get("/device:CPU:0", 1, 2, 4).flat<float>()(3));
+}
+
+TEST(CollectiveCompressionTest, ResidualStoreEvictsLeastRecentlyUsed) {
+  // Room for two residuals of 8 floats.
+  ResidualStore store(/*max_bytes=*/64);
+  store.Get("/device:CPU:0", 1, 1, 8).flat<float>()(0) = 1.0f;
+  store.Get("/device:CPU:0", 1, 2, 8).flat<float>()(0) = 2.0f;
+  EXPECT_EQ(1.0f, store.Get("/device:CPU:0", 1, 1, 8).flat<float>()(0));
+  // Instance 2 is now the least recently used one.
+  store.Get("/device:CPU:0", 1, 3, 8);
+  EXPECT_EQ(64, store.TotalBytes());
+  EXPECT_EQ(1.0f, store.Get("/device:CPU:0", 1, 1, 8).flat<float>()(0));
+  EXPECT_EQ(0.0f, store.Get("/device:CPU:0", 1, 2, 8).flat<float>()(0));
+
+  // Instance keys that change on every call don't grow the store.
+  for (int instance_key = 10; instance_key < 1000; ++instance_key) {
+    store.Get("/device:CPU:0", 1, instance_key, 8);
+  }
+  EXPECT_EQ(64, store.TotalBytes());
+  // A residual larger than the budget is still returned.
+  EXPECT_EQ(100, store.Get("/device:CPU:0", 1, 1, 100).NumElements());
+  EXPECT_EQ(400, store.TotalBytes());
+}
+
+}  // namespace
+}  // namespace collective_compression
+}  // namespace tensorflow
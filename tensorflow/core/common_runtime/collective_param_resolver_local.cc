@@ -68,7 +68,12 @@ const char* GetCollectiveName(const CollectiveParams* cp, bool nccl) {
       return nccl ? "NcclBroadcast" : "HierarchicalTreeBroadcast";
 
     case REDUCTION_COLLECTIVE:
-      return nccl ? "NcclReduce" : "RingReduce";
+      if (nccl) return "NcclReduce";
+      // Two-level reduction only pays off when devices span several tasks.
+      return (cp->instance.impl_details.communication_hint == "hierarchical" &&
+              cp->group.num_tasks > 1)
+                 ? "HierarchicalReduce"
+                 : "RingReduce";
 
     case GATHER_COLLECTIVE:
       return nccl ? "NcclGather" : "RingGather";
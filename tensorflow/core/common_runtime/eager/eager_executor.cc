@@ -15,11 +15,14 @@ limitations under the License.
 
 #include "tensorflow/core/common_runtime/eager/eager_executor.h"
 
+#include <algorithm>
 #include <forward_list>
 #include <functional>
 #include <memory>
 #include <utility>
+#include <vector>
 
+#include "absl/container/inlined_vector.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/gtl/cleanup.h"
 #include "tensorflow/core/util/env_var.h"
@@ -32,6 +35,13 @@ bool IsAsyncWaitForRemoteFunctionEnabled() {
                                  true, &enabled));
   return enabled;
 }
+
+int64_t GetAsyncFusionWindow() {
+  int64_t window = 0;
+  TF_CHECK_OK(
+      ReadInt64FromEnvVar("TF_EAGER_ASYNC_FUSION_WINDOW", 0, &window));
+  return window;
+}
 }  // namespace
 
 EagerExecutor::EagerExecutor(bool async, bool enable_streaming_enqueue,
@@ -46,7 +56,8 @@ EagerExecutor::EagerExecutor(bool async, bool enable_streaming_enqueue,
       enable_async_wait_for_remote_function_(
           IsAsyncWaitForRemoteFunctionEnabled()),
       enable_streaming_enqueue_(enable_streaming_enqueue),
-      in_flight_nodes_limit_(in_flight_nodes_limit) {
+      in_flight_nodes_limit_(in_flight_nodes_limit),
+      fusion_window_(async ? GetAsyncFusionWindow() : 0) {
   if (async && in_flight_nodes_limit_ > 0) {
     VLOG(4) << "EagerExecutor InFlightNodes limit is set to "
             << in_flight_nodes_limit_;
@@ -160,7 +171,7 @@ Status EagerExecutor::AddOrExecute(std::unique_ptr<EagerNode> node) {
     } else {
       status = status_;
       if (status.ok()) {
-        node_queue_.push(std::move(item));
+        node_queue_.push_back(std::move(item));
         // If there were no previous nodes pending, wake the run thread to
         // start processing requests again.
         if (node_queue_.size() == 1) {
@@ -256,7 +267,7 @@ void EagerExecutor::NodeDone(const core::RefCountPtr<NodeItem>& item,
     if (from_queue) {
       // Since this was from the async queue, pop it from the front of the queue
       DCHECK(!node_queue_.empty() && item.get() == node_queue_.front().get());
-      node_queue_.pop();
+      node_queue_.pop_front();
     } else if (async) {
       // If it is an Async node then we will find the node in the unfinished
       // nodes list. However we only notify if we are at the front of the list
@@ -290,7 +301,7 @@ void EagerExecutor::NodeDone(const core::RefCountPtr<NodeItem>& item,
       }
       while (!node_queue_.empty()) {
         items_to_destroy.push_front(std::move(node_queue_.front()));
-        node_queue_.pop();
+        node_queue_.pop_front();
       }
       for (auto& it : unfinished_nodes_) {
         items_to_destroy.push_front(std::move(it.second));
@@ -349,6 +360,7 @@ void EagerExecutor::Run() {
       gtl::MakeCleanup([this] { thread_exited_notification_.Notify(); });
   while (true) {
     core::RefCountPtr<NodeItem> curr_item;
+    std::vector<core::RefCountPtr<NodeItem>> successors;
     {
       tensorflow::mutex_lock l(node_queue_mutex_);
       while (node_queue_.empty() || !status_.ok()) {
@@ -364,8 +376,17 @@ void EagerExecutor::Run() {
       // and register a notification for its completion.
       curr_item.reset(node_queue_.front().get());
       curr_item->Ref();
+      const int64_t window =
+          std::min<int64_t>(fusion_window_, node_queue_.size());
+      for (int64_t i = 1; i < window; ++i) {
+        successors.emplace_back(node_queue_[i].get());
+        successors.back()->Ref();
+      }
     }
-    Status status = RunItem(std::move(curr_item), /*from_queue=*/true);
+    Status status =
+        successors.empty()
+            ? RunItem(std::move(curr_item), /*from_queue=*/true)
+            : RunItemFused(std::move(curr_item), successors);
     if (!status.ok()) {
       VLOG(1) << "Failed to run item: " << status;
     }
@@ -425,6 +446,28 @@ Status EagerExecutor::RunItem(core::RefCountPtr<NodeItem> item,
   return status();
 }
 
+Status EagerExecutor::RunItemFused(
+    core::RefCountPtr<NodeItem> item,
+    absl::Span<const core::RefCountPtr<NodeItem>> successors) {
+  absl::InlinedVector<EagerNode*, 8> successor_nodes;
+  for (const core::RefCountPtr<NodeItem>& successor : successors) {
+    successor_nodes.push_back(successor->node.get());
+  }
+  int num_fused = 0;
+  if (!item->node->RunFused(successor_nodes, &num_fused)) {
+    return RunItem(std::move(item), /*from_queue=*/true);
+  }
+  DVLOG(3) << "Ran Node: [id " << item->id << "] fused with " << num_fused
+           << " successors.";
+  // The fused nodes are done in queue order, so waiters and the handles they
+  // wait on observe the same sequence as without fusion.
+  NodeDone(item, OkStatus(), /*from_queue=*/true);
+  for (int i = 0; i < num_fused; ++i) {
+    NodeDone(successors[i], OkStatus(), /*from_queue=*/true);
+  }
+  return OkStatus();
+}
+
 Status EagerExecutor::MoveToUnfinished(core::RefCountPtr<NodeItem> item,
                                        bool from_queue) {
   tensorflow::mutex_lock l(node_queue_mutex_);
@@ -434,7 +477,7 @@ Status EagerExecutor::MoveToUnfinished(core::RefCountPtr<NodeItem> item,
 
   if (from_queue) {
     DCHECK(!node_queue_.empty() && item.get() == node_queue_.front().get());
-    node_queue_.pop();
+    node_queue_.pop_front();
   }
 
   DVLOG(3) << "Add Node: [id " << item->id << "] to unfinished map.";
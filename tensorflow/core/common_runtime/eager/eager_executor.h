@@ -18,15 +18,16 @@ limitations under the License.
 #include <algorithm>
 #include <atomic>
 #include <cstddef>
+#include <deque>
 #include <functional>
 #include <map>
 #include <memory>
-#include <queue>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/types/span.h"
 #include "tensorflow/core/common_runtime/device_factory.h"
 #include "tensorflow/core/common_runtime/function.h"
 #include "tensorflow/core/common_runtime/rendezvous_mgr.h"
@@ -43,6 +44,7 @@ limitations under the License.
 namespace tensorflow {
 
 class AsyncEagerNode;
+class AsyncExecuteNode;
 class AsyncRemoteExecuteNode;
 namespace eager {
 class EagerClient;
@@ -74,6 +76,17 @@ class EagerNode {
   // Returns nullptr iff this Eager node is synchronous.
   virtual AsyncEagerNode* AsAsync() { return nullptr; }
   virtual AsyncRemoteExecuteNode* AsAsyncRemoteExecuteNode() { return nullptr; }
+  virtual AsyncExecuteNode* AsAsyncExecuteNode() { return nullptr; }
+
+  // Runs the computation corresponding to this node fused with a prefix of
+  // `successors`, the nodes queued after it, if that is faster than running
+  // them one by one. Returns true if this node and the first `*num_fused`
+  // successors ran successfully. Returns false if nothing was run, in which
+  // case Run() is called instead.
+  virtual bool RunFused(absl::Span<EagerNode* const> successors,
+                        int* num_fused) {
+    return false;
+  }
 
   virtual string DebugString() const = 0;
 
@@ -211,6 +224,10 @@ class EagerExecutor {
   void Run();
 
   Status RunItem(core::RefCountPtr<NodeItem> item, bool from_queue);
+  // Runs the queued `item`, fusing it with some of the `successors` queued
+  // after it if possible.
+  Status RunItemFused(core::RefCountPtr<NodeItem> item,
+                      absl::Span<const core::RefCountPtr<NodeItem>> successors);
   Status MoveToUnfinished(core::RefCountPtr<NodeItem> item, bool from_queue);
 
   // The impl of WaitForAllPendingNodes
@@ -230,7 +247,7 @@ class EagerExecutor {
   condition_variable nodes_done_ TF_GUARDED_BY(node_queue_mutex_);
 
   // Queue of pending NodeItems. Ordered by NodeItem::id.
-  std::queue<core::RefCountPtr<NodeItem>> node_queue_
+  std::deque<core::RefCountPtr<NodeItem>> node_queue_
       TF_GUARDED_BY(node_queue_mutex_);
 
   // Ordered by NodeItem::id.
@@ -277,6 +294,10 @@ class EagerExecutor {
   // async nodes reach this number, enqueuing to the eager async queue is
   // blocked.
   const int64_t in_flight_nodes_limit_;
+
+  // Number of queued nodes considered at once for fusion in async mode, set
+  // through TF_EAGER_ASYNC_FUSION_WINDOW. Fusion is disabled if it is below 2.
+  const int64_t fusion_window_;
 };
 
 inline bool EagerExecutor::Async() const { return thread_ != nullptr; }
@@ -0,0 +1,347 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/eager/elementwise_fusion.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/monitoring/counter.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/threadpool.h"
+#include "tensorflow/core/profiler/lib/traceme.h"
+
+namespace tensorflow {
+namespace eager {
+namespace {
+
+auto* fused_elementwise_ops_counter = monitoring::Counter<1>::New(
+    "/tensorflow/core/eager_fused_elementwise_ops",
+    "The number of eager ops run as part of a fused elementwise chain.",
+    "op_type");
+
+// Number of elements of the chain evaluated at once, small enough for the
+// values to stay in the L1 cache between ops.
+constexpr int64_t kBlockSize = 4096;
+
+// Binary ops come first.
+enum class OpKind {
+  kAdd,
+  kSub,
+  kMul,
+  kRealDiv,
+  kMaximum,
+  kMinimum,
+  kNeg,
+  kAbs,
+  kSquare,
+  kExp,
+  kTanh,
+  kSigmoid,
+  kRelu,
+};
+
+bool IsBinary(OpKind kind) { return kind < OpKind::kNeg; }
+
+bool GetOpKind(const string& op_type, OpKind* kind) {
+  static const auto* kinds = new absl::flat_hash_map<string, OpKind>({
+      {"Add", OpKind::kAdd},
+      {"AddV2", OpKind::kAdd},
+      {"Sub", OpKind::kSub},
+      {"Mul", OpKind::kMul},
+      {"RealDiv", OpKind::kRealDiv},
+      {"Maximum", OpKind::kMaximum},
+      {"Minimum", OpKind::kMinimum},
+      {"Neg", OpKind::kNeg},
+      {"Abs", OpKind::kAbs},
+      {"Square", OpKind::kSquare},
+      {"Exp", OpKind::kExp},
+      {"Tanh", OpKind::kTanh},
+      {"Sigmoid", OpKind::kSigmoid},
+      {"Relu", OpKind::kRelu},
+  });
+  auto it = kinds->find(op_type);
+  if (it == kinds->end()) return false;
+  *kind = it->second;
+  return true;
+}
+
+using Block = Eigen::TensorMap<Eigen::Tensor<float, 1, Eigen::RowMajor>>;
+using ConstBlock =
+    Eigen::TensorMap<Eigen::Tensor<const float, 1, Eigen::RowMajor>>;
+
+// One op of a fused chain, applied to the output of the previous op.
+struct Step {
+  OpKind kind;
+  // The other operand of a binary op, either a scalar or a tensor with the
+  // shape of the chain.
+  const float* operand = nullptr;
+  bool operand_is_scalar = false;
+  // Whether the output of the previous op is the left hand side operand.
+  bool chain_is_lhs = true;
+  // Where the output of the op is stored, or nullptr if it is unobservable.
+  float* output = nullptr;
+};
+
+struct Chain {
+  TensorShape shape;
+  // Input of the first op.
+  const float* source = nullptr;
+  bool source_is_scalar = false;
+  std::vector<Step> steps;
+  // Keeps the buffers of the operands alive.
+  std::vector<Tensor> operands;
+  // Output of the last op in the chain.
+  const TensorHandle* last = nullptr;
+};
+
+// The functors are the ones of the corresponding kernels in cwise_ops.h and
+// relu_op_functor.h, so that fused ops produce the same values.
+template <typename Functor>
+void ApplyBinary(const Step& step, int64_t offset, Block value) {
+  if (step.operand_is_scalar) {
+    const auto operand = value.constant(*step.operand);
+    if (step.chain_is_lhs) {
+      value = value.binaryExpr(operand, Functor());
+    } else {
+      value = operand.binaryExpr(value, Functor());
+    }
+  } else {
+    ConstBlock operand(step.operand + offset, value.size());
+    if (step.chain_is_lhs) {
+      value = value.binaryExpr(operand, Functor());
+    } else {
+      value = operand.binaryExpr(value, Functor());
+    }
+  }
+}
+
+template <typename Functor>
+void ApplyUnary(Block value) {
+  value = value.unaryExpr(Functor());
+}
+
+void Apply(const Step& step, int64_t offset, Block value) {
+  using namespace Eigen::internal;  // NOLINT
+  switch (step.kind) {
+    case OpKind::kAdd:
+      return ApplyBinary<scalar_sum_op<float>>(step, offset, value);
+    case OpKind::kSub:
+      return ApplyBinary<scalar_difference_op<float>>(step, offset, value);
+    case OpKind::kMul:
+      return ApplyBinary<scalar_product_op<float>>(step, offset, value);
+    case OpKind::kRealDiv:
+      return ApplyBinary<scalar_quotient_op<float>>(step, offset, value);
+    case OpKind::kMaximum:
+      return ApplyBinary<scalar_max_op<float, float, Eigen::PropagateNaN>>(
+          step, offset, value);
+    case OpKind::kMinimum:
+      return ApplyBinary<scalar_min_op<float, float, Eigen::PropagateNaN>>(
+          step, offset, value);
+    case OpKind::kNeg:
+      return ApplyUnary<scalar_opposite_op<float>>(value);
+    case OpKind::kAbs:
+      return ApplyUnary<scalar_abs_op<float>>(value);
+    case OpKind::kSquare:
+      return ApplyUnary<scalar_square_op<float>>(value);
+    case OpKind::kExp:
+      return ApplyUnary<scalar_exp_op<float>>(value);
+    case OpKind::kTanh:
+      return ApplyUnary<scalar_tanh_op<float>>(value);
+    case OpKind::kSigmoid:
+      return ApplyUnary<scalar_logistic_op<float>>(value);
+    case OpKind::kRelu:
+      value = value.cwiseMax<Eigen::PropagateNaN>(0.0f);
+      return;
+  }
+}
+
+// Evaluates blocks [begin, end) of the chain.
+void EvaluateBlocks(const Chain& chain, int64_t begin, int64_t end) {
+  const int64_t num_elements = chain.shape.num_elements();
+  alignas(EIGEN_MAX_ALIGN_BYTES) float buffer[kBlockSize];
+  for (int64_t b = begin; b < end; ++b) {
+    const int64_t offset = b * kBlockSize;
+    const int64_t n = std::min(kBlockSize, num_elements - offset);
+    Block value(buffer, n);
+    if (chain.source_is_scalar) {
+      value.setConstant(*chain.source);
+    } else {
+      std::copy_n(chain.source + offset, n, buffer);
+    }
+    for (const Step& step : chain.steps) {
+      Apply(step, offset, value);
+      if (step.output != nullptr) {
+        std::copy_n(buffer, n, step.output + offset);
+      }
+    }
+  }
+}
+
+// Appends `op` to `chain`.  Returns false if `op` can't extend the chain.
+// `outputs` are the outputs of all the ops considered for fusion, which are
+// not ready before the fused chain runs.
+bool AddToChain(const PendingElementwiseOp& op,
+                const absl::flat_hash_set<const TensorHandle*>& outputs,
+                Chain* chain) {
+  const KernelAndDevice& kernel = *op.kernel;
+  OpKind kind;
+  if (kernel.kernel() == nullptr || kernel.device() == nullptr ||
+      kernel.device()->device_type() != DEVICE_CPU ||
+      !GetOpKind(kernel.kernel()->type_string(), &kind)) {
+    return false;
+  }
+  const int arity = IsBinary(kind) ? 2 : 1;
+  if (kernel.num_inputs() != arity ||
+      static_cast<int>(op.inputs.size()) != arity ||
+      kernel.num_outputs() != 1 || kernel.output_dtypes()[0] != DT_FLOAT) {
+    return false;
+  }
+  for (DataType dtype : kernel.input_dtypes()) {
+    if (dtype != DT_FLOAT) return false;
+  }
+
+  int chain_index = -1;
+  if (chain->last != nullptr) {
+    for (int i = 0; i < arity; ++i) {
+      if (op.inputs[i] != chain->last) continue;
+      if (chain_index != -1) return false;
+      chain_index = i;
+    }
+    if (chain_index == -1) return false;
+  }
+  const Tensor* tensors[2] = {nullptr, nullptr};
+  for (int i = 0; i < arity; ++i) {
+    if (i == chain_index) continue;
+    TensorHandle* h = op.inputs[i];
+    if (outputs.contains(h) || h->Type() != TensorHandle::LOCAL ||
+        h->DeviceOrHostCPU(*op.ctx) != kernel.InputDevice(i) ||
+        !h->Tensor(&tensors[i]).ok()) {
+      return false;
+    }
+  }
+
+  Step step;
+  step.kind = kind;
+  const Tensor* operand = nullptr;
+  if (chain->last == nullptr) {
+    const Tensor* source = tensors[0];
+    if (arity == 2) {
+      operand = tensors[1];
+      if (source->dims() == 0 && operand->dims() != 0) {
+        chain->shape = operand->shape();
+      } else if (operand->dims() == 0 ||
+                 operand->shape() == source->shape()) {
+        chain->shape = source->shape();
+      } else {
+        return false;
+      }
+    } else {
+      chain->shape = source->shape();
+    }
+    chain->operands.push_back(*source);
+    chain->source = source->flat<float>().data();
+    chain->source_is_scalar = source->shape() != chain->shape;
+  } else if (arity == 2) {
+    operand = tensors[1 - chain_index];
+    step.chain_is_lhs = chain_index == 0;
+    if (operand->dims() != 0 && operand->shape() != chain->shape) {
+      return false;
+    }
+  }
+  if (operand != nullptr) {
+    chain->operands.push_back(*operand);
+    step.operand = operand->flat<float>().data();
+    step.operand_is_scalar = operand->shape() != chain->shape;
+  }
+  chain->steps.push_back(step);
+  chain->last = op.retval;
+  return true;
+}
+
+}  // namespace
+
+bool RunFusedElementwiseChain(absl::Span<const PendingElementwiseOp> ops,
+                              int* num_fused) {
+  absl::flat_hash_set<const TensorHandle*> outputs;
+  for (const PendingElementwiseOp& op : ops) {
+    outputs.insert(op.retval);
+  }
+  Chain chain;
+  for (const PendingElementwiseOp& op : ops) {
+    if (!AddToChain(op, outputs, &chain)) break;
+  }
+  const int n = chain.steps.size();
+  if (n < 2) return false;
+
+  profiler::TraceMe activity("RunFusedElementwiseChain",
+                             profiler::TraceMeLevel::kInfo);
+  // The intermediate outputs are only referred to by the ops producing and
+  // consuming them, unless the program kept a handle on them.
+  std::vector<Tensor> values(n);
+  for (int i = 0; i < n; ++i) {
+    if (i < n - 1 && ops[i].retval->RefCount() <= 2) continue;
+    Allocator* allocator =
+        ops[i].kernel->device()->GetAllocator(AllocatorAttributes());
+    values[i] = Tensor(allocator, DT_FLOAT, chain.shape);
+    if (!values[i].IsInitialized()) return false;
+    chain.steps[i].output = values[i].flat<float>().data();
+  }
+
+  const int64_t num_blocks =
+      (chain.shape.num_elements() + kBlockSize - 1) / kBlockSize;
+  thread::ThreadPool* workers =
+      ops[0].kernel->device()->tensorflow_cpu_worker_threads()->workers;
+  if (workers != nullptr && num_blocks > 1) {
+    workers->ParallelFor(num_blocks, /*cost_per_unit=*/kBlockSize * n * 4,
+                         [&chain](int64_t begin, int64_t end) {
+                           EvaluateBlocks(chain, begin, end);
+                         });
+  } else {
+    EvaluateBlocks(chain, 0, num_blocks);
+  }
+
+  for (int i = 0; i < n; ++i) {
+    const Device* d =
+        ops[i].ctx->CanonicalDevice(ops[i].kernel->OutputDevice(0));
+    if (!values[i].IsInitialized()) {
+      ops[i].retval->Poison(
+          errors::Cancelled("Output elided by elementwise op fusion."), d);
+      continue;
+    }
+    Status s = ops[i].retval->SetTensor(std::move(values[i]), d);
+    if (!s.ok()) {
+      ops[i].retval->Poison(s, d);
+    }
+  }
+  for (int i = 0; i < n; ++i) {
+    fused_elementwise_ops_counter
+        ->GetCell(ops[i].kernel->kernel()->type_string())
+        ->IncrementBy(1);
+  }
+  *num_fused = n;
+  return true;
+}
+
+}  // namespace eager
+}  // namespace tensorflow
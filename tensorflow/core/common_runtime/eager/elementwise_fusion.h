@@ -0,0 +1,55 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_EAGER_ELEMENTWISE_FUSION_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_EAGER_ELEMENTWISE_FUSION_H_
+
+#include "absl/types/span.h"
+#include "tensorflow/core/common_runtime/eager/context.h"
+#include "tensorflow/core/common_runtime/eager/kernel_and_device.h"
+#include "tensorflow/core/common_runtime/eager/tensor_handle.h"
+
+namespace tensorflow {
+namespace eager {
+
+// A kernel execution pending in an async EagerExecutor, which may be fused
+// with the executions queued after it.  The execution holds one reference to
+// each of its inputs and to its output.
+struct PendingElementwiseOp {
+  EagerContext* ctx;
+  const KernelAndDevice* kernel;
+  absl::Span<TensorHandle* const> inputs;
+  // Empty handle receiving the only output of the kernel.
+  TensorHandle* retval;
+};
+
+// Runs a prefix of `ops` as one fused computation, if the prefix is a chain of
+// at least two float elementwise ops on CPU, each consuming the output of the
+// previous one, whose other operands are scalars or have the shape of the
+// chain.  The chain is evaluated in cache-sized blocks, without writing the
+// intermediate outputs only referred to by the ops producing and consuming
+// them.
+//
+// On success sets the outputs of the first `*num_fused` ops of `ops` to the
+// values their kernels would have produced, poisons the unobservable ones,
+// and returns true.  Returns false without touching any output otherwise, in
+// which case the ops must be run one by one.
+bool RunFusedElementwiseChain(absl::Span<const PendingElementwiseOp> ops,
+                              int* num_fused);
+
+}  // namespace eager
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_EAGER_ELEMENTWISE_FUSION_H_
@@ -0,0 +1,197 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/eager/elementwise_fusion.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/device_factory.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/eager/context.h"
+#include "tensorflow/core/common_runtime/eager/eager_executor.h"
+#include "tensorflow/core/common_runtime/eager/eager_operation.h"
+#include "tensorflow/core/common_runtime/eager/execute.h"
+#include "tensorflow/core/common_runtime/eager/tensor_handle.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/monitoring/cell_reader.h"
+#include "tensorflow/core/platform/notification.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+using ::tensorflow::monitoring::testing::CellReader;
+
+constexpr char kCpu0[] = "/job:localhost/replica:0/task:0/device:CPU:0";
+constexpr char kFusedOpsMetric[] =
+    "/tensorflow/core/eager_fused_elementwise_ops";
+
+// Blocks the async executor until notified, so that the nodes queued after it
+// are all visible to the fusion window when it starts running them.
+class BlockingNode : public EagerNode {
+ public:
+  explicit BlockingNode(Notification* unblock) : unblock_(unblock) {}
+
+  Status Run() override {
+    unblock_->WaitForNotification();
+    return OkStatus();
+  }
+  void Abort(Status status) override {}
+  string DebugString() const override { return "BlockingNode"; }
+
+ private:
+  Notification* const unblock_;
+};
+
+class ElementwiseFusionTest : public ::testing::Test {
+ protected:
+  ElementwiseFusionTest()
+      : device_mgr_(DeviceFactory::NewDevice(
+            "CPU", {}, "/job:localhost/replica:0/task:0")) {
+    // Read by the default executor of the context.
+    setenv("TF_EAGER_ASYNC_FUSION_WINDOW", "8", /*overwrite=*/1);
+    ctx_ = new EagerContext(
+        SessionOptions(),
+        tensorflow::ContextDevicePlacementPolicy::DEVICE_PLACEMENT_SILENT,
+        /*async=*/true, &device_mgr_, /*device_mgr_owned=*/false,
+        /*rendezvous=*/nullptr, /*cluster_flr=*/nullptr);
+  }
+
+  ~ElementwiseFusionTest() override {
+    ctx_->Unref();
+    unsetenv("TF_EAGER_ASYNC_FUSION_WINDOW");
+  }
+
+  void BlockExecutor() {
+    TF_ASSERT_OK(ctx_->Executor().AddOrExecute(
+        std::make_unique<BlockingNode>(&unblock_)));
+  }
+
+  core::RefCountPtr<TensorHandle> Execute(
+      const char* op_name, const std::vector<TensorHandle*>& inputs) {
+    EagerOperation op(ctx_);
+    TF_CHECK_OK(op.Reset(op_name, kCpu0));
+    for (TensorHandle* h : inputs) {
+      TF_CHECK_OK(op.AddInput(h));
+    }
+    TensorHandle* retval = nullptr;
+    int num_retvals = 1;
+    TF_CHECK_OK(EagerExecute(&op, &retval, &num_retvals));
+    return core::RefCountPtr<TensorHandle>(retval);
+  }
+
+  StaticDeviceMgr device_mgr_;
+  EagerContext* ctx_;
+  Notification unblock_;
+};
+
+Tensor Iota(int64_t n) {
+  Tensor t(DT_FLOAT, TensorShape({n}));
+  for (int64_t i = 0; i < n; ++i) {
+    t.flat<float>()(i) = static_cast<float>(i % 13) / 13.0f - 0.5f;
+  }
+  return t;
+}
+
+TEST_F(ElementwiseFusionTest, FusedChainMatchesUnfusedResults) {
+  CellReader<int64_t> reader(kFusedOpsMetric);
+  // Spans several blocks.
+  const Tensor x_value = Iota(10000);
+  core::RefCountPtr<TensorHandle> x(TensorHandle::CreateLocalHandle(x_value));
+  core::RefCountPtr<TensorHandle> two(
+      TensorHandle::CreateLocalHandle(test::AsScalar<float>(2.0f)));
+
+  BlockExecutor();
+  core::RefCountPtr<TensorHandle> e = Execute("Exp", {x.get()});
+  core::RefCountPtr<TensorHandle> m = Execute("Mul", {two.get(), e.get()});
+  core::RefCountPtr<TensorHandle> s = Execute("Sub", {m.get(), x.get()});
+  core::RefCountPtr<TensorHandle> t = Execute("Tanh", {s.get()});
+  // The intermediate `m` is kept, `e` and `s` are not observable.
+  e.reset();
+  s.reset();
+  unblock_.Notify();
+  TF_ASSERT_OK(ctx_->Executor().WaitForAllPendingNodes());
+
+  // The four ops ran as one chain.
+  EXPECT_EQ(reader.Delta("Exp"), 1);
+  EXPECT_EQ(reader.Delta("Mul"), 1);
+  EXPECT_EQ(reader.Delta("Sub"), 1);
+  EXPECT_EQ(reader.Delta("Tanh"), 1);
+
+  Tensor expected_m(DT_FLOAT, x_value.shape());
+  Tensor expected_t(DT_FLOAT, x_value.shape());
+  for (int64_t i = 0; i < x_value.NumElements(); ++i) {
+    const float xi = x_value.flat<float>()(i);
+    expected_m.flat<float>()(i) = 2.0f * std::exp(xi);
+    expected_t.flat<float>()(i) = std::tanh(2.0f * std::exp(xi) - xi);
+  }
+  const Tensor* actual = nullptr;
+  TF_ASSERT_OK(m->Tensor(&actual));
+  test::ExpectTensorNear<float>(expected_m, *actual, 1e-5);
+  TF_ASSERT_OK(t->Tensor(&actual));
+  test::ExpectTensorNear<float>(expected_t, *actual, 1e-5);
+}
+
+TEST_F(ElementwiseFusionTest, FusesOpsBroadcastingScalarSource) {
+  CellReader<int64_t> reader(kFusedOpsMetric);
+  core::RefCountPtr<TensorHandle> x(
+      TensorHandle::CreateLocalHandle(test::AsTensor<float>({1, 2, 3})));
+  core::RefCountPtr<TensorHandle> one(
+      TensorHandle::CreateLocalHandle(test::AsScalar<float>(1.0f)));
+
+  BlockExecutor();
+  core::RefCountPtr<TensorHandle> a = Execute("AddV2", {one.get(), x.get()});
+  core::RefCountPtr<TensorHandle> n = Execute("Neg", {a.get()});
+  a.reset();
+  unblock_.Notify();
+  TF_ASSERT_OK(ctx_->Executor().WaitForAllPendingNodes());
+  EXPECT_EQ(reader.Delta("AddV2"), 1);
+  EXPECT_EQ(reader.Delta("Neg"), 1);
+
+  const Tensor* actual = nullptr;
+  TF_ASSERT_OK(n->Tensor(&actual));
+  test::ExpectTensorEqual<float>(test::AsTensor<float>({-2, -3, -4}),
+                                 *actual);
+}
+
+TEST_F(ElementwiseFusionTest, IncompatibleShapesFailAsUnfused) {
+  CellReader<int64_t> reader(kFusedOpsMetric);
+  core::RefCountPtr<TensorHandle> x(
+      TensorHandle::CreateLocalHandle(test::AsTensor<float>({1, 2, 3})));
+  core::RefCountPtr<TensorHandle> y(
+      TensorHandle::CreateLocalHandle(test::AsTensor<float>({1, 2})));
+
+  BlockExecutor();
+  core::RefCountPtr<TensorHandle> e = Execute("Exp", {x.get()});
+  core::RefCountPtr<TensorHandle> a = Execute("AddV2", {e.get(), y.get()});
+  unblock_.Notify();
+  Status s = ctx_->Executor().WaitForAllPendingNodes();
+  EXPECT_EQ(error::INVALID_ARGUMENT, s.code());
+  EXPECT_EQ(reader.Delta("Exp"), 0);
+  EXPECT_EQ(reader.Delta("AddV2"), 0);
+
+  // The first op ran on its own before the error.
+  const Tensor* actual = nullptr;
+  TF_ASSERT_OK(e->Tensor(&actual));
+  EXPECT_EQ(3, actual->NumElements());
+  EXPECT_FALSE(a->Tensor(&actual).ok());
+  ctx_->Executor().ClearError();
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -1324,7 +1324,8 @@ Fprint128 GetDeviceCacheKey(EagerOperation* op, const EagerContext& ctx) {
 
 Status GetOrCreateKernelAndDevice(
     EagerOperation* op, TensorHandle** retvals, int* num_retvals,
-    core::RefCountPtr<KernelAndDevice>* out_kernel) {
+    core::RefCountPtr<KernelAndDevice>* out_kernel,
+    Fprint128* out_cache_key = nullptr) {
   EagerContext& ctx = op->EagerContext();
   Device* device = std::get<Device*>(op->Device());
 
@@ -1574,6 +1575,9 @@ Status GetOrCreateKernelAndDevice(
   }
   *num_retvals = num_outputs;
 
+  if (out_cache_key != nullptr) {
+    *out_cache_key = cache_key;
+  }
   kernel->Ref();  // Ownership of reference is passed to out_kernel.
   out_kernel->reset(kernel.get());
   return OkStatus();
@@ -1699,8 +1703,14 @@ Status AddOrExecuteNode(core::RefCountPtr<KernelAndDevice> kernel,
 //    runtime. In this case, we don't select a device because running
 //    a function with explicitly requested device has different behavior than
 //    running without an explicitly requested device.
-Status EagerLocalExecute(EagerOperation* op, TensorHandle** retvals,
-                         int* num_retvals) {
+//
+// If `replay_kernel` is non-null, it is set to the kernel that executed `op`
+// when a primitive op was executed synchronously without being rewritten, and
+// `*replay_cache_key` to the key of that kernel in the kernel cache.
+Status EagerLocalExecute(
+    EagerOperation* op, TensorHandle** retvals, int* num_retvals,
+    core::RefCountPtr<KernelAndDevice>* replay_kernel = nullptr,
+    Fprint128* replay_cache_key = nullptr) {
   profiler::ScopedMemoryDebugAnnotation op_annotation(
       op->op_name(), op->eager_func_params().has_value()
                          ? op->eager_func_params().value().step_id.value_or(0)
@@ -1713,7 +1723,9 @@ Status EagerLocalExecute(EagerOperation* op, TensorHandle** retvals,
   TF_RETURN_IF_ERROR(executor.status());
 
   core::RefCountPtr<KernelAndDevice> kernel;
-  auto status = GetOrCreateKernelAndDevice(op, retvals, num_retvals, &kernel);
+  Fprint128 cache_key;
+  auto status = GetOrCreateKernelAndDevice(op, retvals, num_retvals, &kernel,
+                                           &cache_key);
 
 #ifdef INTEL_MKL
   if (IsMKLEnabled() && kernel != nullptr &&
@@ -1751,6 +1763,14 @@ Status EagerLocalExecute(EagerOperation* op, TensorHandle** retvals,
     }
   }
 
+  if (replay_kernel != nullptr && out_op == nullptr && !op->is_function() &&
+      !kernel->IsFunction() && !executor.Async() &&
+      !op->eager_func_params().has_value()) {
+    kernel->Ref();  // Ownership of reference is passed to replay_kernel.
+    replay_kernel->reset(kernel.get());
+    *replay_cache_key = cache_key;
+  }
+
   Status s = AddOrExecuteNode(std::move(kernel), op, retvals);
   // Since the operation failed, we need to Unref any outputs if they were
   // allocated.
@@ -2088,8 +2108,10 @@ void CollectGraphs(EagerContext* ctx) {
 }
 }  // namespace
 
-Status DoEagerExecute(EagerOperation* op, TensorHandle** retvals,
-                      int* num_retvals) {
+Status DoEagerExecute(
+    EagerOperation* op, TensorHandle** retvals, int* num_retvals,
+    core::RefCountPtr<KernelAndDevice>* replay_kernel = nullptr,
+    Fprint128* replay_cache_key = nullptr) {
   profiler::TraceMe activity([&] {
     return ::tensorflow::profiler::TraceMeEncode(
         "EagerExecute",
@@ -2116,9 +2138,11 @@ Status DoEagerExecute(EagerOperation* op, TensorHandle** retvals,
   if (op->IsLocal()) {
     if (out_op) {
       op = out_op.get();
+      replay_kernel = nullptr;
     }
     TF_RETURN_IF_ERROR(MaybePackInputTensor(op));
-    return EagerLocalExecute(op, retvals, num_retvals);
+    return EagerLocalExecute(op, retvals, num_retvals, replay_kernel,
+                             replay_cache_key);
   }
 
 #if defined(IS_MOBILE_PLATFORM)
@@ -2201,6 +2225,18 @@ Status EagerExecute(EagerOperation* op, TensorHandle** retvals,
   return DoEagerExecute(op, retvals, num_retvals);
 }
 
+Status EagerExecuteAndGetKernel(EagerOperation* op, TensorHandle** retvals,
+                                int* num_retvals,
+                                core::RefCountPtr<KernelAndDevice>* kernel,
+                                Fprint128* cache_key) {
+  kernel->reset();
+  Status s = DoEagerExecute(op, retvals, num_retvals, kernel, cache_key);
+  if (!s.ok()) {
+    kernel->reset();
+  }
+  return s;
+}
+
 namespace {
 
 Status LocalEagerCopyToDevice(TensorHandle* h, EagerContext* ctx,
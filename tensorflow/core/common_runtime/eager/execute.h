@@ -45,6 +45,16 @@ namespace tensorflow {
 Status EagerExecute(EagerOperation* op, TensorHandle** retvals,
                     int* num_retvals);
 
+// Like EagerExecute, but also returns in `*kernel` the kernel that executed
+// `op`, and in `*cache_key` its key in the context's kernel cache, if that
+// kernel may execute the same op again directly.  That is the case for
+// primitive ops executed locally and synchronously which no op rewrite pass
+// replaced.  Otherwise `*kernel` is reset.
+Status EagerExecuteAndGetKernel(EagerOperation* op, TensorHandle** retvals,
+                                int* num_retvals,
+                                core::RefCountPtr<KernelAndDevice>* kernel,
+                                Fprint128* cache_key);
+
 // Low-level utility to execute the kernel specified by `kernel` on
 // `kernel->device()`, with the inputs op_inputs, in the context 'ctx'.
 Status EagerKernelExecute(
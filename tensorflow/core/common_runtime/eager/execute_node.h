@@ -35,6 +35,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/device.h"
 #include "tensorflow/core/common_runtime/eager/context.h"
 #include "tensorflow/core/common_runtime/eager/eager_executor.h"
+#include "tensorflow/core/common_runtime/eager/elementwise_fusion.h"
 #include "tensorflow/core/common_runtime/eager/execute.h"
 #include "tensorflow/core/common_runtime/eager/kernel_and_device.h"
 #include "tensorflow/core/common_runtime/eager/tensor_handle.h"
@@ -227,6 +228,22 @@ class AsyncExecuteNode : public EagerNode {
     }
   }
 
+  AsyncExecuteNode* AsAsyncExecuteNode() override { return this; }
+
+  bool RunFused(absl::Span<EagerNode* const> successors,
+                int* num_fused) override {
+    absl::InlinedVector<eager::PendingElementwiseOp, 8> ops;
+    if (!AppendPendingElementwiseOp(&ops)) return false;
+    for (EagerNode* successor : successors) {
+      AsyncExecuteNode* node = successor->AsAsyncExecuteNode();
+      if (node == nullptr || !node->AppendPendingElementwiseOp(&ops)) break;
+    }
+    int num_ops = 0;
+    if (!eager::RunFusedElementwiseChain(ops, &num_ops)) return false;
+    *num_fused = num_ops - 1;
+    return true;
+  }
+
   std::string DebugString() const override {
     std::string out = "[AsyncExecuteNode]";
     strings::StrAppend(&out, " kernel: ", kernel_->name());
@@ -234,6 +251,19 @@ class AsyncExecuteNode : public EagerNode {
   }
 
  private:
+  // Appends this node to `ops` if it runs a kernel with a single output and
+  // none of the features elementwise fusion does not handle.
+  bool AppendPendingElementwiseOp(
+      absl::InlinedVector<eager::PendingElementwiseOp, 8>* ops) const {
+    if (eager_func_params_.has_value() || graph_collector_ != nullptr ||
+        cancellation_manager_ != nullptr || retvals_.size() != 1 ||
+        ctx_->ShouldStoreGraphs()) {
+      return false;
+    }
+    ops->push_back({ctx_, kernel_.get(), inputs_, retvals_[0]});
+    return true;
+  }
+
   EagerContext* ctx_;
   absl::InlinedVector<TensorHandle*, 4> inputs_;
   const absl::optional<EagerFunctionParams> eager_func_params_;
@@ -0,0 +1,191 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/eager/op_call_site.h"
+
+#include <optional>
+#include <variant>
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/core/common_runtime/eager/eager_executor.h"
+#include "tensorflow/core/common_runtime/eager/execute.h"
+#include "tensorflow/core/common_runtime/eager/execute_node.h"
+#include "tensorflow/core/common_runtime/eager/placement_utils.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/profiler/lib/traceme.h"
+
+namespace tensorflow {
+namespace {
+
+// Inputs with at most this many elements may get an op pinned to the host CPU
+// by eager::MaybePinSmallOpsToCpu.
+constexpr int64_t kMaxSmallOpElements = 64;
+
+bool IsSmallInput(const TensorHandle& h) {
+  int64_t num_elements;
+  return h.NumElements(&num_elements).ok() &&
+         num_elements <= kMaxSmallOpElements;
+}
+
+}  // namespace
+
+EagerOpCallSite::EagerOpCallSite(const EagerOperation& op)
+    : ctx_(&op.EagerContext()),
+      op_name_(op.Name()),
+      device_name_(op.DeviceName()),
+      attrs_(op.Name().c_str()) {
+  attrs_.CopyAttributes(op.Attrs());
+}
+
+Status EagerOpCallSite::Execute(absl::Span<TensorHandle* const> inputs,
+                                TensorHandle** retvals, int* num_retvals) {
+  if (CanReplay(inputs)) {
+    return Replay(inputs, retvals, num_retvals);
+  }
+  return ExecuteAndBind(inputs, retvals, num_retvals);
+}
+
+bool EagerOpCallSite::CanReplay(absl::Span<TensorHandle* const> inputs) const {
+  if (kernel_ == nullptr ||
+      kernel_->num_inputs() != static_cast<int>(inputs.size())) {
+    return false;
+  }
+  if (ctx_->AllowSoftPlacement() != allow_soft_placement_ ||
+      ctx_->PinSmallOpsToCPU() != pin_small_ops_to_cpu_ ||
+      ctx_->RunEagerOpAsFunction() || ctx_->LogDevicePlacement() ||
+      ctx_->Executor().Async() || ctx_->ShouldStoreGraphs()) {
+    return false;
+  }
+  const DataTypeVector& input_dtypes = kernel_->input_dtypes();
+  for (int i = 0, end = inputs.size(); i < end; ++i) {
+    const TensorHandle* h = inputs[i];
+    if (h->Type() != TensorHandle::LOCAL || h->dtype != input_dtypes[i] ||
+        h->DeviceOrHostCPU(*ctx_) != kernel_->InputDevice(i)) {
+      return false;
+    }
+    if (!small_inputs_.empty() && IsSmallInput(*h) != small_inputs_[i]) {
+      return false;
+    }
+  }
+  // The kernel cache may have been cleared since binding.
+  return ctx_->GetCachedKernel(cache_key_).get() == kernel_.get();
+}
+
+Status EagerOpCallSite::Replay(absl::Span<TensorHandle* const> inputs,
+                               TensorHandle** retvals, int* num_retvals) {
+  profiler::TraceMe activity(
+      [&] { return absl::StrCat("EagerOpCallSite::Replay: ", op_name_); },
+      profiler::TraceMeLevel::kInfo);
+  const int num_outputs = kernel_->num_outputs();
+  if (num_outputs > *num_retvals) {
+    return errors::InvalidArgument("Expecting ", num_outputs,
+                                   " outputs, but *num_retvals is ",
+                                   *num_retvals);
+  }
+  *num_retvals = num_outputs;
+  for (int i = 0; i < num_outputs; ++i) {
+    retvals[i] = nullptr;
+  }
+
+  EagerExecutor& executor = ctx_->Executor();
+  // As in EagerExecute, errors of earlier ops don't fail sync executions.
+  executor.ClearError();
+  const absl::InlinedVector<TensorHandle*, 4> op_inputs(inputs.begin(),
+                                                        inputs.end());
+  const std::optional<EagerFunctionParams> eager_func_params;
+  ExecuteNode node(ctx_, op_inputs, eager_func_params, kernel_,
+                   /*graph_collector=*/nullptr,
+                   /*cancellation_manager=*/nullptr,
+                   absl::Span<TensorHandle*>(retvals, num_outputs),
+                   /*stack_trace=*/std::nullopt);
+  Status s = executor.SyncExecute(&node);
+  if (!s.ok()) {
+    for (int i = 0; i < num_outputs; ++i) {
+      if (retvals[i] != nullptr) {
+        retvals[i]->Unref();
+        retvals[i] = nullptr;
+      }
+    }
+    return s;
+  }
+  ++num_replays_;
+  return OkStatus();
+}
+
+Status EagerOpCallSite::ExecuteAndBind(absl::Span<TensorHandle* const> inputs,
+                                       TensorHandle** retvals,
+                                       int* num_retvals) {
+  kernel_.reset();
+  EagerOperation op(ctx_);
+  TF_RETURN_IF_ERROR(op.Reset(op_name_.c_str(), device_name_.c_str(),
+                              /*remote=*/false, /*executor=*/nullptr));
+  for (TensorHandle* h : inputs) {
+    TF_RETURN_IF_ERROR(op.AddInput(h));
+  }
+  // Attributes inferred from the inputs are not overwritten.
+  op.MutableAttrs()->CopyAttributes(attrs_);
+
+  // Same placement logic as EagerOperation::Execute.
+  for (TensorHandle* h : inputs) {
+    TF_RETURN_IF_ERROR(h->WaitUnknownDevice());
+  }
+  Device* device = std::get<Device*>(op.Device());
+  if (device == nullptr) {
+    TF_RETURN_IF_ERROR(eager::MaybePinToResourceDevice(&device, op));
+  }
+  if (device == nullptr && ctx_->PinSmallOpsToCPU()) {
+    bool pin_to_cpu;
+    TF_RETURN_IF_ERROR(eager::MaybePinSmallOpsToCpu(
+        &pin_to_cpu, op.Name(), op.GetInputs(), ctx_->HostCPU()->name()));
+    if (pin_to_cpu) {
+      device = ctx_->HostCPU();
+    }
+  }
+  if (device != nullptr) {
+    op.SetDevice(device);
+  }
+
+  core::RefCountPtr<KernelAndDevice> kernel;
+  Fprint128 cache_key;
+  TF_RETURN_IF_ERROR(
+      EagerExecuteAndGetKernel(&op, retvals, num_retvals, &kernel, &cache_key));
+  if (kernel == nullptr ||
+      kernel->num_inputs() != static_cast<int>(inputs.size()) ||
+      ctx_->GetCachedKernel(cache_key).get() != kernel.get()) {
+    return OkStatus();
+  }
+  // Only bind if the inputs did not need to be copied to other devices, and
+  // are not resources, which influence placement beyond their device.
+  for (int i = 0, end = inputs.size(); i < end; ++i) {
+    const TensorHandle* h = inputs[i];
+    if (h->Type() != TensorHandle::LOCAL || h->dtype == DT_RESOURCE ||
+        h->DeviceOrHostCPU(*ctx_) != kernel->InputDevice(i)) {
+      return OkStatus();
+    }
+  }
+  allow_soft_placement_ = ctx_->AllowSoftPlacement();
+  pin_small_ops_to_cpu_ = ctx_->PinSmallOpsToCPU();
+  small_inputs_.clear();
+  if (pin_small_ops_to_cpu_) {
+    for (const TensorHandle* h : inputs) {
+      small_inputs_.push_back(IsSmallInput(*h));
+    }
+  }
+  kernel_ = std::move(kernel);
+  cache_key_ = cache_key;
+  return OkStatus();
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,91 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_EAGER_OP_CALL_SITE_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_EAGER_OP_CALL_SITE_H_
+
+#include <string>
+
+#include "absl/container/inlined_vector.h"
+#include "absl/types/span.h"
+#include "tensorflow/core/common_runtime/eager/attr_builder.h"
+#include "tensorflow/core/common_runtime/eager/context.h"
+#include "tensorflow/core/common_runtime/eager/eager_operation.h"
+#include "tensorflow/core/common_runtime/eager/kernel_and_device.h"
+#include "tensorflow/core/common_runtime/eager/tensor_handle.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/status.h"
+
+namespace tensorflow {
+
+// Inline kernel cache for an eager op executed repeatedly from one call site,
+// e.g. in the body of a Python loop.
+//
+// The call site binds the op name, attributes and requested device once.  The
+// first execution goes through EagerExecute and remembers the kernel it ran.
+// Later executions whose inputs have the dtypes and devices that kernel
+// expects run it directly, skipping the construction of an EagerOperation,
+// placement and the fingerprinting of attributes for the kernel cache lookup.
+// Any other execution falls back to EagerExecute and rebinds the call site.
+//
+// Not thread-safe.  Must not outlive the context of the bound op.
+class EagerOpCallSite {
+ public:
+  // Binds to the name, attributes and requested device of `op`.  The inputs
+  // of `op` are ignored, and attributes inferred from the inputs of each
+  // execution take precedence over those of `op`.
+  explicit EagerOpCallSite(const EagerOperation& op);
+
+  // Executes the bound op on `inputs`.  `retvals` and `num_retvals` are as in
+  // EagerExecute.
+  Status Execute(absl::Span<TensorHandle* const> inputs,
+                 TensorHandle** retvals, int* num_retvals);
+
+  // Number of executions which ran the cached kernel directly.
+  int64_t num_replays() const { return num_replays_; }
+
+ private:
+  // Returns true if the cached kernel can execute the op on `inputs`.
+  bool CanReplay(absl::Span<TensorHandle* const> inputs) const;
+
+  // Runs the cached kernel on `inputs`.
+  Status Replay(absl::Span<TensorHandle* const> inputs,
+                TensorHandle** retvals, int* num_retvals);
+
+  // Executes the op through EagerExecute and caches the kernel it ran, if
+  // possible.
+  Status ExecuteAndBind(absl::Span<TensorHandle* const> inputs,
+                        TensorHandle** retvals, int* num_retvals);
+
+  EagerContext* const ctx_;  // Not owned.
+  const string op_name_;
+  const string device_name_;
+  AttrBuilder attrs_;
+
+  core::RefCountPtr<KernelAndDevice> kernel_;
+  Fprint128 cache_key_;
+  // Context settings which affect kernel selection, at bind time.
+  bool allow_soft_placement_ = false;
+  bool pin_small_ops_to_cpu_ = false;
+  // Whether each input was small enough to pin the op to the host CPU, if
+  // small op pinning is enabled.
+  absl::InlinedVector<bool, 4> small_inputs_;
+
+  int64_t num_replays_ = 0;
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_EAGER_OP_CALL_SITE_H_
@@ -0,0 +1,178 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/eager/op_call_site.h"
+
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/device_factory.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/eager/context.h"
+#include "tensorflow/core/common_runtime/eager/eager_operation.h"
+#include "tensorflow/core/common_runtime/eager/tensor_handle.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/casts.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+constexpr char kCpu0[] = "/job:localhost/replica:0/task:0/device:CPU:0";
+
+class EagerOpCallSiteTest : public ::testing::Test {
+ protected:
+  EagerOpCallSiteTest()
+      : device_mgr_(DeviceFactory::NewDevice(
+            "CPU", {}, "/job:localhost/replica:0/task:0")),
+        ctx_(new EagerContext(
+            SessionOptions(),
+            tensorflow::ContextDevicePlacementPolicy::DEVICE_PLACEMENT_SILENT,
+            /*async=*/false, &device_mgr_, /*device_mgr_owned=*/false,
+            /*rendezvous=*/nullptr, /*cluster_flr=*/nullptr)) {}
+
+  ~EagerOpCallSiteTest() override { ctx_->Unref(); }
+
+  std::unique_ptr<EagerOpCallSite> CreateAddCallSite() {
+    EagerOperation op(ctx_);
+    TF_CHECK_OK(op.Reset("AddV2", kCpu0));
+    return std::make_unique<EagerOpCallSite>(op);
+  }
+
+  // Executes `call_site` on `x` and `y` and returns its output.
+  template <typename T>
+  Tensor Add(EagerOpCallSite* call_site, T x, T y) {
+    core::RefCountPtr<TensorHandle> a(
+        TensorHandle::CreateLocalHandle(test::AsScalar<T>(x)));
+    core::RefCountPtr<TensorHandle> b(
+        TensorHandle::CreateLocalHandle(test::AsScalar<T>(y)));
+    std::vector<TensorHandle*> inputs = {a.get(), b.get()};
+    TensorHandle* retval = nullptr;
+    int num_retvals = 1;
+    TF_CHECK_OK(call_site->Execute(inputs, &retval, &num_retvals));
+    EXPECT_EQ(1, num_retvals);
+    core::RefCountPtr<TensorHandle> output(retval);
+    const Tensor* t = nullptr;
+    TF_CHECK_OK(output->Tensor(&t));
+    return *t;
+  }
+
+  StaticDeviceMgr device_mgr_;
+  EagerContext* ctx_;
+};
+
+TEST_F(EagerOpCallSiteTest, ReplaysCachedKernel) {
+  auto call_site = CreateAddCallSite();
+  test::ExpectTensorEqual<float>(test::AsScalar<float>(3.0f),
+                                 Add<float>(call_site.get(), 1.0f, 2.0f));
+  EXPECT_EQ(0, call_site->num_replays());
+  test::ExpectTensorEqual<float>(test::AsScalar<float>(7.0f),
+                                 Add<float>(call_site.get(), 3.0f, 4.0f));
+  test::ExpectTensorEqual<float>(test::AsScalar<float>(11.0f),
+                                 Add<float>(call_site.get(), 5.0f, 6.0f));
+  EXPECT_EQ(2, call_site->num_replays());
+}
+
+TEST_F(EagerOpCallSiteTest, RebindsOnInputDtypeChange) {
+  auto call_site = CreateAddCallSite();
+  Add<float>(call_site.get(), 1.0f, 2.0f);
+  test::ExpectTensorEqual<int64_t>(test::AsScalar<int64_t>(3),
+                                   Add<int64_t>(call_site.get(), 1, 2));
+  EXPECT_EQ(0, call_site->num_replays());
+  test::ExpectTensorEqual<int64_t>(test::AsScalar<int64_t>(7),
+                                   Add<int64_t>(call_site.get(), 3, 4));
+  EXPECT_EQ(1, call_site->num_replays());
+}
+
+TEST_F(EagerOpCallSiteTest, RebindsOnContextChange) {
+  auto call_site = CreateAddCallSite();
+  Add<float>(call_site.get(), 1.0f, 2.0f);
+  ctx_->SetAllowSoftPlacement(!ctx_->AllowSoftPlacement());
+  Add<float>(call_site.get(), 1.0f, 2.0f);
+  EXPECT_EQ(0, call_site->num_replays());
+  Add<float>(call_site.get(), 1.0f, 2.0f);
+  EXPECT_EQ(1, call_site->num_replays());
+}
+
+TEST_F(EagerOpCallSiteTest, RebindsAfterKernelCacheCleared) {
+  auto call_site = CreateAddCallSite();
+  Add<float>(call_site.get(), 1.0f, 2.0f);
+  ctx_->ClearCachesAndDefaultExecutor();
+  test::ExpectTensorEqual<float>(test::AsScalar<float>(3.0f),
+                                 Add<float>(call_site.get(), 1.0f, 2.0f));
+  EXPECT_EQ(0, call_site->num_replays());
+}
+
+TEST_F(EagerOpCallSiteTest, PropagatesErrors) {
+  auto call_site = CreateAddCallSite();
+  core::RefCountPtr<TensorHandle> a(
+      TensorHandle::CreateLocalHandle(test::AsScalar<float>(1.0f)));
+  core::RefCountPtr<TensorHandle> b(
+      TensorHandle::CreateLocalHandle(test::AsScalar<int64_t>(2)));
+  std::vector<TensorHandle*> inputs = {a.get(), b.get()};
+  TensorHandle* retval = nullptr;
+  int num_retvals = 1;
+  EXPECT_FALSE(call_site->Execute(inputs, &retval, &num_retvals).ok());
+  EXPECT_EQ(nullptr, retval);
+}
+
+// Measures the dispatch rate of scalar additions executed through a fresh
+// EagerOperation per op, as the Python fast path does, or through a call site.
+void BM_EagerScalarAdd(::testing::benchmark::State& state) {
+  const bool use_call_site = state.range(0);
+  StaticDeviceMgr device_mgr(
+      DeviceFactory::NewDevice("CPU", {}, "/job:localhost/replica:0/task:0"));
+  EagerContext* ctx = new EagerContext(
+      SessionOptions(),
+      tensorflow::ContextDevicePlacementPolicy::DEVICE_PLACEMENT_SILENT,
+      /*async=*/false, &device_mgr, /*device_mgr_owned=*/false,
+      /*rendezvous=*/nullptr, /*cluster_flr=*/nullptr);
+  core::RefCountPtr<TensorHandle> a(
+      TensorHandle::CreateLocalHandle(test::AsScalar<float>(1.0f)));
+  core::RefCountPtr<TensorHandle> b(
+      TensorHandle::CreateLocalHandle(test::AsScalar<float>(2.0f)));
+  std::vector<TensorHandle*> inputs = {a.get(), b.get()};
+  std::unique_ptr<EagerOpCallSite> call_site;
+  {
+    EagerOperation op(ctx);
+    TF_CHECK_OK(op.Reset("AddV2", kCpu0));
+    call_site = std::make_unique<EagerOpCallSite>(op);
+  }
+
+  for (auto s : state) {
+    TensorHandle* retval = nullptr;
+    int num_retvals = 1;
+    if (use_call_site) {
+      TF_CHECK_OK(call_site->Execute(inputs, &retval, &num_retvals));
+    } else {
+      EagerOperation op(ctx);
+      TF_CHECK_OK(op.Reset("AddV2", kCpu0));
+      TF_CHECK_OK(op.AddInput(a.get()));
+      TF_CHECK_OK(op.AddInput(b.get()));
+      AbstractTensorHandle* output = nullptr;
+      TF_CHECK_OK(op.Execute(absl::MakeSpan(&output, 1), &num_retvals));
+      retval = down_cast<TensorHandle*>(output);
+    }
+    retval->Unref();
+  }
+  state.SetItemsProcessed(state.iterations());
+  call_site.reset();
+  ctx->Unref();
+}
+BENCHMARK(BM_EagerScalarAdd)->Arg(0)->Arg(1);
+
+}  // namespace
+}  // namespace tensorflow
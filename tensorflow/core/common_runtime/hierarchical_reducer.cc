@@ -0,0 +1,426 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/hierarchical_reducer.h"
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/collective_rma_local.h"
+#include "tensorflow/core/common_runtime/collective_util.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/dma_helper.h"
+#include "tensorflow/core/common_runtime/ring_reducer.h"
+#include "tensorflow/core/framework/cancellation.h"
+#include "tensorflow/core/framework/device_base.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/refcount.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/profiler/lib/traceme.h"
+
+// Set true for greater intelligibility of debug mode log messages.
+#define READABLE_KEYS false
+
+namespace tensorflow {
+
+namespace {
+// Key to be used for BufRendezvous by HierarchicalReducer.
+string HierarchicalReduceBufKey(const string& exec_key, int subdiv,
+                                int src_rank, int dst_rank) {
+  if (READABLE_KEYS) {
+    return strings::StrCat("hierarchical_reduce(", exec_key, "):subdiv(",
+                           subdiv, "):src(", src_rank, "):dst(", dst_rank,
+                           ")");
+  } else {
+    return strings::StrCat(exec_key, ":", subdiv, ":", src_rank, ":", dst_rank);
+  }
+}
+}  // namespace
+
+HierarchicalReducer::HierarchicalReducer()
+    : col_ctx_(nullptr), col_params_(nullptr) {}
+
+Status HierarchicalReducer::InitializeCollectiveParams(
+    CollectiveParams* col_params) {
+  CHECK_EQ(col_params->instance.type, REDUCTION_COLLECTIVE);
+  CHECK_EQ(col_params->instance.impl_details.collective_name,
+           "HierarchicalReduce");
+  const string& device_name =
+      col_params->group.members[col_params->default_rank].device.name();
+  // Start by counting the devices in each task.
+  // Precondition: device_names must be sorted so that all devices in
+  // the same task are adjacent.
+  std::vector<int> dev_per_task;
+  const string* prior_task_name = &col_params->group.members[0].task;
+  int dev_count = 1;
+  for (int di = 1; di < col_params->group.group_size; ++di) {
+    if (col_params->group.members[di].task != *prior_task_name) {
+      dev_per_task.push_back(dev_count);
+      dev_count = 1;
+      prior_task_name = &col_params->group.members[di].task;
+    } else {
+      ++dev_count;
+    }
+  }
+  dev_per_task.push_back(dev_count);
+  if (col_params->group.num_tasks != static_cast<int>(dev_per_task.size())) {
+    return errors::Internal("Expected ", col_params->group.num_tasks,
+                            " tasks in group ", col_params->group.group_key,
+                            " but found ", dev_per_task.size(),
+                            "; devices must be sorted by task");
+  }
+
+  const int num_tasks = col_params->group.num_tasks;
+  const int num_subdivs = num_tasks + (num_tasks > 1 ? 1 : 0);
+  auto& impl = col_params->instance.impl_details;
+  impl.subdiv_permutations.clear();
+  impl.subdiv_permutations.resize(num_subdivs);
+  col_params->subdiv_rank.clear();
+  col_params->subdiv_rank.reserve(num_subdivs);
+
+  // Inter-task subdiv.  The leader of each task is its first device.  If a
+  // device does not participate in the subdiv, set subdiv_rank to -1.
+  if (num_tasks > 1) {
+    std::vector<int>& perm = impl.subdiv_permutations[0];
+    int leader_rank = -1;
+    int device_count = 0;
+    for (int ti = 0; ti < num_tasks; ++ti) {
+      perm.push_back(device_count);
+      if (col_params->group.members[device_count].device.name() ==
+          device_name) {
+        leader_rank = ti;
+      }
+      device_count += dev_per_task[ti];
+    }
+    col_params->subdiv_rank.push_back(leader_rank);
+  }
+
+  // Intra-task subdivs.  Subdiv ti+1 comprises all devices of task ti.
+  int abs_di = 0;
+  for (int ti = 0; ti < num_tasks; ++ti) {
+    const int sdi = ti + (num_tasks > 1 ? 1 : 0);
+    std::vector<int>& perm = impl.subdiv_permutations[sdi];
+    int local_rank = -1;
+    for (int di = 0; di < dev_per_task[ti]; ++di) {
+      perm.push_back(abs_di);
+      if (col_params->group.members[abs_di].device.name() == device_name) {
+        local_rank = di;
+      }
+      ++abs_di;
+    }
+    col_params->subdiv_rank.push_back(local_rank);
+  }
+
+  VLOG(2) << collective_util::SubdivPermDebugString(*col_params);
+  return OkStatus();
+}
+
+Status HierarchicalReducer::InitializeCollectiveContext(
+    std::shared_ptr<CollectiveContext> col_ctx) {
+  CHECK(col_ctx->dev_mgr);
+  col_ctx_ = col_ctx;
+  col_params_ = col_ctx->col_params.get();
+  return collective_util::InitializeDeviceAndLocality(
+      col_ctx->dev_mgr, col_ctx->device_name, &col_ctx->device,
+      &col_ctx->device_locality);
+}
+
+int HierarchicalReducer::LocalSubdiv() const {
+  const int num_tasks = col_params_->group.num_tasks;
+  for (int sdi = (num_tasks > 1 ? 1 : 0);
+       sdi < static_cast<int>(col_params_->subdiv_rank.size()); ++sdi) {
+    if (col_params_->subdiv_rank[sdi] >= 0) return sdi;
+  }
+  LOG(FATAL) << "Device " << col_ctx_->device_name
+             << " is not a member of any task subdiv";
+  return -1;
+}
+
+void HierarchicalReducer::Run(StatusCallback done) {
+  CHECK(col_ctx_);
+  CHECK(col_params_);
+  const int local_subdiv = LocalSubdiv();
+  const bool is_leader = col_params_->subdiv_rank[local_subdiv] == 0;
+  // The leaders' ring all-reduce unblocks dependent collectives on behalf of
+  // the leaders, so only the other devices record it here.
+  const bool run_leader_ring = is_leader && col_params_->group.num_tasks > 1 &&
+                               col_ctx_->output->NumElements() > 0;
+  if (!run_leader_ring) {
+    col_ctx_->col_exec->UnblockDependencies(*col_params_);
+  }
+
+  Status status;
+  // Start by copying input to output if they're not already the same, i.e. if
+  // we're not computing in-place on the input tensor.
+  if ((col_ctx_->input != col_ctx_->output) &&
+      (DMAHelper::base(col_ctx_->input) != DMAHelper::base(col_ctx_->output))) {
+    Notification note;
+    profiler::TraceMe activity("MemCpyAsync", profiler::TraceMeLevel::kInfo);
+    CollectiveRemoteAccessLocal::MemCpyAsync(
+        col_ctx_->op_ctx->op_device_context(),
+        col_ctx_->op_ctx->op_device_context(), col_ctx_->device,
+        col_ctx_->device, col_ctx_->op_ctx->input_alloc_attr(0),
+        col_ctx_->op_ctx->output_alloc_attr(0), col_ctx_->input,
+        col_ctx_->output, 0 /*dev_to_dev_stream_index*/,
+        [&note, &status](const Status& s) {
+          status.Update(s);
+          note.Notify();
+        });
+    note.WaitForNotification();
+  }
+
+  if (status.ok()) status = ReduceToLeader(local_subdiv);
+  if (status.ok() && run_leader_ring) status = AllReduceAcrossLeaders();
+  if (status.ok() && is_leader) status = Finalize();
+  if (status.ok()) status = BroadcastFromLeader(local_subdiv);
+  if (!status.ok()) StartAbort(status);
+  VLOG(2) << "device=" << col_ctx_->device_name << " return status " << status;
+  done(status);
+}
+
+Status HierarchicalReducer::ReduceToLeader(int subdiv) {
+  profiler::TraceMe activity("ReduceToLeader", profiler::TraceMeLevel::kInfo);
+  const int my_rank = col_params_->subdiv_rank[subdiv];
+  const int num_local_devices = static_cast<int>(
+      col_params_->instance.impl_details.subdiv_permutations[subdiv].size());
+  if (num_local_devices == 1) return OkStatus();
+
+  if (my_rank != 0) {
+    Notification note;
+    Status status;
+    DispatchSend(subdiv, 0, my_rank, col_ctx_->output,
+                 [&note, &status](const Status& s) {
+                   status = s;
+                   note.Notify();
+                 });
+    note.WaitForNotification();
+    return status;
+  }
+
+  // The leader receives from all other local devices at once and merges each
+  // value as soon as it arrives.
+  Allocator* allocator =
+      col_ctx_->device->GetAllocator(col_ctx_->op_ctx->output_alloc_attr(0));
+  std::vector<Tensor> values(num_local_devices);
+  mutex mu;
+  condition_variable arrived;
+  std::deque<int> ready;  // TF_GUARDED_BY(mu)
+  Status status;          // TF_GUARDED_BY(mu)
+  for (int rank = 1; rank < num_local_devices; ++rank) {
+    values[rank] = Tensor(allocator, col_ctx_->output->dtype(),
+                          col_ctx_->output->shape());
+    DispatchRecv(subdiv, rank, 0, &values[rank],
+                 [&mu, &arrived, &ready, &status, rank](const Status& s) {
+                   mutex_lock l(mu);
+                   status.Update(s);
+                   ready.push_back(rank);
+                   arrived.notify_one();
+                 });
+  }
+  // Every receive must complete before returning, even after a failure, since
+  // they write into `values`.
+  bool aborted = false;
+  for (int i = 1; i < num_local_devices; ++i) {
+    int rank;
+    Status recv_status;
+    {
+      mutex_lock l(mu);
+      while (ready.empty()) arrived.wait(l);
+      rank = ready.front();
+      ready.pop_front();
+      recv_status = status;
+    }
+    if (recv_status.ok()) {
+      Status s = collective_util::ComputeBinOp(
+          col_ctx_->op_ctx, col_ctx_->op_params, col_ctx_->device,
+          col_params_->merge_op, col_ctx_->output, &values[rank]);
+      if (!s.ok()) {
+        mutex_lock l(mu);
+        status.Update(s);
+        recv_status = status;
+      }
+    }
+    if (!recv_status.ok() && !aborted) {
+      aborted = true;
+      StartAbort(recv_status);
+    }
+  }
+  mutex_lock l(mu);
+  return status;
+}
+
+Status HierarchicalReducer::AllReduceAcrossLeaders() {
+  profiler::TraceMe activity("AllReduceAcrossLeaders",
+                             profiler::TraceMeLevel::kInfo);
+  const auto& impl = col_params_->instance.impl_details;
+  core::RefCountPtr<CollectiveParams> leader_params(new CollectiveParams());
+  leader_params->name = col_params_->name;
+  leader_params->group.group_key = col_params_->group.group_key;
+  leader_params->group.group_size = col_params_->group.num_tasks;
+  leader_params->group.device_type = col_params_->group.device_type;
+  leader_params->group.num_tasks = col_params_->group.num_tasks;
+  leader_params->group.same_num_devices_per_task = true;
+  // The ring's call to UnblockDependencies stands in for this leader's, so it
+  // must see the device count of the full group.
+  leader_params->group.num_devices_per_task =
+      col_params_->group.num_devices_per_task;
+  for (int idx : impl.subdiv_permutations[0]) {
+    leader_params->group.members.push_back(col_params_->group.members[idx]);
+  }
+  leader_params->default_rank = col_params_->subdiv_rank[0];
+  leader_params->instance = col_params_->instance;
+  leader_params->instance.impl_details.collective_name = "RingReduce";
+  leader_params->instance.impl_details.subdiv_permutations.clear();
+  leader_params->instance.impl_details.subdiv_offsets.clear();
+  leader_params->instance.impl_details.subdiv_source_rank.clear();
+  leader_params->merge_op = col_params_->merge_op;
+  // final_op must divide by the size of the full group, so Finalize() applies
+  // it after the ring completes.
+  leader_params->final_op = nullptr;
+
+  core::RefCountPtr<RingReducer> ring(new RingReducer());
+  TF_RETURN_IF_ERROR(ring->InitializeCollectiveParams(leader_params.get()));
+  auto leader_ctx = std::make_shared<CollectiveContext>(
+      col_ctx_->col_exec, col_ctx_->nccl_communicator, col_ctx_->dev_mgr,
+      col_ctx_->op_ctx, col_ctx_->op_params, leader_params.get(),
+      strings::StrCat(col_ctx_->exec_key, ":leaders"), col_ctx_->step_id,
+      col_ctx_->output, col_ctx_->output);
+  TF_RETURN_IF_ERROR(ring->InitializeCollectiveContext(leader_ctx));
+  Notification note;
+  Status status;
+  ring->Run([&note, &status](const Status& s) {
+    status = s;
+    note.Notify();
+  });
+  note.WaitForNotification();
+  return status;
+}
+
+Status HierarchicalReducer::Finalize() {
+  if (col_params_->final_op == nullptr) return OkStatus();
+  Allocator* allocator =
+      col_ctx_->device->GetAllocator(col_ctx_->op_ctx->output_alloc_attr(0));
+  std::unique_ptr<CollectiveAdapter> ca(
+      MakeCollectiveAdapter(col_ctx_->output, 1, allocator));
+  Tensor group_size_val = ca->Scalar(col_params_->group.group_size);
+  Tensor group_size_tensor = group_size_val;
+  if (col_params_->group.device_type != DEVICE_CPU) {
+    group_size_tensor = ca->Scalar(allocator, AllocationAttributes());
+    TF_RETURN_IF_ERROR(
+        col_ctx_->op_ctx->op_device_context()->CopyCPUTensorToDeviceSync(
+            &group_size_val, col_ctx_->device, &group_size_tensor));
+  }
+  return collective_util::ComputeBinOp(
+      col_ctx_->op_ctx, col_ctx_->op_params, col_ctx_->device,
+      col_params_->final_op, col_ctx_->output, &group_size_tensor);
+}
+
+Status HierarchicalReducer::BroadcastFromLeader(int subdiv) {
+  profiler::TraceMe activity("BroadcastFromLeader",
+                             profiler::TraceMeLevel::kInfo);
+  const int my_rank = col_params_->subdiv_rank[subdiv];
+  const int num_local_devices = static_cast<int>(
+      col_params_->instance.impl_details.subdiv_permutations[subdiv].size());
+  if (num_local_devices == 1) return OkStatus();
+
+  mutex mu;
+  condition_variable all_done;
+  int pending_count = 0;  // TF_GUARDED_BY(mu)
+  Status status;          // TF_GUARDED_BY(mu)
+  auto on_done = [&mu, &all_done, &pending_count, &status](const Status& s) {
+    mutex_lock l(mu);
+    status.Update(s);
+    if (--pending_count == 0) all_done.notify_all();
+  };
+  if (my_rank == 0) {
+    pending_count = num_local_devices - 1;
+    for (int rank = 1; rank < num_local_devices; ++rank) {
+      DispatchSend(subdiv, rank, 0, col_ctx_->output, on_done);
+    }
+  } else {
+    pending_count = 1;
+    DispatchRecv(subdiv, 0, my_rank, col_ctx_->output, on_done);
+  }
+  mutex_lock l(mu);
+  while (pending_count > 0) all_done.wait(l);
+  return status;
+}
+
+void HierarchicalReducer::StartAbort(const Status& s) {
+  LOG(ERROR) << "Aborting HierarchicalReduce on " << col_ctx_->device_name
+             << " with " << s;
+  CancellationManager* cancel_mgr = col_ctx_->op_ctx->cancellation_manager();
+  if (cancel_mgr == nullptr ||
+      (!cancel_mgr->IsCancelled() && !cancel_mgr->IsCancelling())) {
+    col_ctx_->col_exec->StartAbort(s);
+  }
+}
+
+void HierarchicalReducer::DispatchSend(int subdiv, int dst_rank, int src_rank,
+                                       const Tensor* src_tensor,
+                                       const StatusCallback& done) {
+  string send_buf_key =
+      HierarchicalReduceBufKey(col_ctx_->exec_key, subdiv, src_rank, dst_rank);
+  int dst_idx =
+      col_params_->instance.impl_details.subdiv_permutations[subdiv][dst_rank];
+  VLOG(3) << "DispatchSend " << send_buf_key << " from_device "
+          << col_ctx_->device_name << " to_device "
+          << col_params_->group.members[dst_idx].device.name()
+          << " subdiv=" << subdiv << " dst_rank=" << dst_rank
+          << " dst_idx=" << dst_idx;
+  col_ctx_->col_exec->remote_access()->PostToPeer(
+      col_params_->group.members[dst_idx].device.name(),
+      col_params_->group.members[dst_idx].task, send_buf_key, col_ctx_->device,
+      col_ctx_->op_ctx->op_device_context(),
+      col_ctx_->op_ctx->output_alloc_attr(0), src_tensor,
+      col_ctx_->device_locality, col_ctx_->op_ctx->cancellation_manager(),
+      done);
+}
+
+void HierarchicalReducer::DispatchRecv(int subdiv, int src_rank, int dst_rank,
+                                       Tensor* dst_tensor,
+                                       const StatusCallback& done) {
+  string recv_buf_key =
+      HierarchicalReduceBufKey(col_ctx_->exec_key, subdiv, src_rank, dst_rank);
+  int src_idx =
+      col_params_->instance.impl_details.subdiv_permutations[subdiv][src_rank];
+  VLOG(3) << "DispatchRecv " << recv_buf_key << " from_device "
+          << col_params_->group.members[src_idx].device.name() << " to_device "
+          << col_ctx_->device_name << " subdiv=" << subdiv
+          << " src_rank=" << src_rank << " src_idx=" << src_idx;
+  col_ctx_->col_exec->remote_access()->RecvFromPeer(
+      col_params_->group.members[src_idx].device.name(),
+      col_params_->group.members[src_idx].task,
+      col_params_->group.members[src_idx].is_local, recv_buf_key,
+      col_ctx_->device, col_ctx_->op_ctx->op_device_context(),
+      col_ctx_->op_ctx->output_alloc_attr(0), dst_tensor,
+      col_ctx_->device_locality, 0 /*stream_index*/,
+      col_ctx_->op_ctx->cancellation_manager(), done);
+}
+
+namespace {
+REGISTER_COLLECTIVE(HierarchicalReduce, HierarchicalReducer);
+}  // namespace
+
+}  // namespace tensorflow
@@ -0,0 +1,91 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_HIERARCHICAL_REDUCER_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_HIERARCHICAL_REDUCER_H_
+
+#include <memory>
+
+#include "tensorflow/core/common_runtime/base_collective_executor.h"
+#include "tensorflow/core/framework/collective.h"
+
+namespace tensorflow {
+
+// Two-level implementation of collective all-reduce.  The devices of each
+// task first reduce into a leader device, the first device of that task.  The
+// leaders then all-reduce among themselves with a RingReducer, and finally
+// each leader broadcasts the result to the other devices of its task.  Hence
+// inter-task traffic is incurred once per task instead of once per device.
+class HierarchicalReducer : public CollectiveImplementationInterface {
+ public:
+  HierarchicalReducer();
+  ~HierarchicalReducer() override = default;
+
+  // Establishes the subdiv permutations needed for a hierarchical reduction.
+  // If all devices are local, establishes a single subdiv comprising all
+  // devices.  If any devices are on a different task, establishes n+1 subdivs
+  // for n tasks.  The first subdiv comprises the leader device of each task,
+  // and subdiv i+1 comprises all devices of task i with its leader at rank 0.
+  Status InitializeCollectiveParams(CollectiveParams* col_params) override;
+
+  // Initializes members of CollectiveContext not yet initialized, i.e. device
+  // and device_locality.  Also saves the CollectiveContext in this object.
+  Status InitializeCollectiveContext(
+      std::shared_ptr<CollectiveContext> col_ctx) override;
+
+  // Begins execution of the hierarchical reduction.
+  // Must be called in a blockable thread.
+  void Run(StatusCallback done) override;
+
+ private:
+  // Returns the index of the subdiv comprising the devices of this device's
+  // task.
+  int LocalSubdiv() const;
+
+  // Merges the values of all devices in `subdiv` into the output of its
+  // leader.
+  Status ReduceToLeader(int subdiv);
+
+  // All-reduces the output of this leader with the other task leaders.
+  Status AllReduceAcrossLeaders();
+
+  // Applies final_op, if any, to the output of this leader.
+  Status Finalize();
+
+  // Sends the output of the leader of `subdiv` to all other devices in it.
+  Status BroadcastFromLeader(int subdiv);
+
+  // Aborts outstanding transfers of all participants after a failure of this
+  // device, unless the op is already being cancelled.
+  void StartAbort(const Status& s);
+
+  // Sends `src_tensor` asynchronously from this device to device at `dst_rank`
+  // in `subdiv`.  Calls `done` upon completion.
+  void DispatchSend(int subdiv, int dst_rank, int src_rank,
+                    const Tensor* src_tensor, const StatusCallback& done);
+
+  // Receives a tensor into the memory buffer owned by `dst_tensor` at this
+  // device from device at `src_rank` in `subdiv`.  Calls `done` upon
+  // completion.
+  void DispatchRecv(int subdiv, int src_rank, int dst_rank, Tensor* dst_tensor,
+                    const StatusCallback& done);
+
+  std::shared_ptr<CollectiveContext> col_ctx_;
+  const CollectiveParams* col_params_;  // Not owned
+
+  friend class HierarchicalReducerTest;
+};
+
+}  // namespace tensorflow
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_HIERARCHICAL_REDUCER_H_
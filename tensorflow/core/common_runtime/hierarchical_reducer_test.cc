@@ -0,0 +1,186 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/hierarchical_reducer.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/collective_test_util.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/process_util.h"
+#include "tensorflow/core/framework/collective.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/refcount.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/public/version.h"
+
+namespace tensorflow {
+namespace {
+
+std::unique_ptr<OpKernel> GetKernel(const string& op, DataType dtype,
+                                    DeviceBase* device) {
+  NodeDef node_def;
+  TF_CHECK_OK(NodeDefBuilder(strings::StrCat(op, "_node"), op)
+                  .Attr("T", dtype)
+                  .Input(FakeInput(dtype))
+                  .Input(FakeInput(dtype))
+                  .Finalize(&node_def));
+  Status status;
+  std::unique_ptr<OpKernel> k = CreateOpKernel(
+      DEVICE_CPU, device, device->GetAllocator(AllocatorAttributes()),
+      node_def, TF_GRAPH_DEF_VERSION, &status);
+  TF_CHECK_OK(status);
+  return k;
+}
+
+}  // namespace
+
+class HierarchicalReducerTest : public ::testing::Test {
+ protected:
+  class DeviceInstance {
+   public:
+    DeviceInstance(int rank, DataType dtype, const TensorShape& shape,
+                   CollectiveTestEnv* test_env)
+        : test_env_(test_env), tensor_(dtype, shape) {
+      col_params_ =
+          CreateCollectiveParams(*test_env_, rank, "HierarchicalReduce",
+                                 REDUCTION_COLLECTIVE, dtype, shape);
+      string dev_name = col_params_->group.members[rank].device.name();
+      TF_CHECK_OK(test_env_->device_mgr->LookupDevice(dev_name, &device_))
+          << "Couldn't find device " << dev_name
+          << " existing devices: " << test_env_->device_mgr->DebugString();
+      merge_op_ = GetKernel("Add", dtype, device_);
+      final_op_ = GetKernel("Div", dtype, device_);
+      col_params_->merge_op = merge_op_.get();
+      col_params_->final_op = final_op_.get();
+    }
+
+    void DoReduce() {
+      status_ = RunCollective(test_env_, col_params_.get(), device_, &tensor_,
+                              &tensor_);
+    }
+
+    CollectiveTestEnv* test_env_;
+    Tensor tensor_;
+    Device* device_;
+    core::RefCountPtr<CollectiveParams> col_params_;
+    std::unique_ptr<OpKernel> merge_op_;
+    std::unique_ptr<OpKernel> final_op_;
+    Status status_;
+  };
+
+  // Simulates `num_workers` hosts with `num_devices` devices each in this
+  // process, all exchanging data through CollectiveRemoteAccessLocal.
+  void RunTest(int num_workers, int num_devices, int tensor_len,
+               int fail_after) {
+    test_env_ = CreateCollectiveTestEnv(num_workers, num_devices, DEVICE_CPU);
+    test_env_->remote_access->set_fail_after(fail_after);
+    const int group_size = num_workers * num_devices;
+    std::vector<float> expected(tensor_len, 0.0);
+    for (int rank = 0; rank < group_size; ++rank) {
+      instances_.push_back(std::make_unique<DeviceInstance>(
+          rank, DT_FLOAT, TensorShape({tensor_len}), test_env_.get()));
+      auto flat = instances_.back()->tensor_.flat<float>();
+      for (int i = 0; i < tensor_len; ++i) {
+        flat(i) = rank * 10 + (i % 128);
+        expected[i] += flat(i);
+      }
+    }
+    for (int i = 0; i < tensor_len; ++i) expected[i] /= group_size;
+
+    std::atomic<int> done(0);
+    for (auto& di : instances_) {
+      SchedClosure([&di, &done] {
+        di->DoReduce();
+        ++done;
+      });
+    }
+    while (done < group_size) {
+      Env::Default()->SleepForMicroseconds(1000);
+    }
+
+    for (auto& di : instances_) {
+      if (fail_after > 0) {
+        EXPECT_NE(di->status_.message().find("Deliberate failure"),
+                  string::npos);
+      } else {
+        TF_EXPECT_OK(di->status_);
+        test::ExpectTensorNear<float>(test::AsTensor<float>(expected),
+                                      di->tensor_, 1e-5);
+      }
+    }
+  }
+
+  void RunSubdivPermsTest(
+      int num_workers, int num_devices, int rank,
+      const std::vector<std::vector<int>>& expected_subdiv_perms,
+      const std::vector<int>& expected_subdiv_rank) {
+    auto test_env =
+        CreateCollectiveTestEnv(num_workers, num_devices, DEVICE_CPU);
+    auto cp = CreateCollectiveParams(*test_env, rank, "HierarchicalReduce",
+                                     REDUCTION_COLLECTIVE, DT_FLOAT,
+                                     TensorShape({1}));
+    core::RefCountPtr<HierarchicalReducer> reducer(new HierarchicalReducer());
+    TF_CHECK_OK(reducer->InitializeCollectiveParams(cp.get()));
+    EXPECT_EQ(expected_subdiv_perms,
+              cp->instance.impl_details.subdiv_permutations);
+    EXPECT_EQ(expected_subdiv_rank, cp->subdiv_rank);
+  }
+
+  std::unique_ptr<CollectiveTestEnv> test_env_;
+  std::vector<std::unique_ptr<DeviceInstance>> instances_;
+};
+
+TEST_F(HierarchicalReducerTest, InitializeParamsSingleTask) {
+  RunSubdivPermsTest(1, 4, 2, {{0, 1, 2, 3}}, {2});
+}
+
+TEST_F(HierarchicalReducerTest, InitializeParamsLeader) {
+  RunSubdivPermsTest(3, 2, 2, {{0, 2, 4}, {0, 1}, {2, 3}, {4, 5}},
+                     {1, -1, 0, -1});
+}
+
+TEST_F(HierarchicalReducerTest, InitializeParamsNonLeader) {
+  RunSubdivPermsTest(3, 2, 5, {{0, 2, 4}, {0, 1}, {2, 3}, {4, 5}},
+                     {-1, -1, -1, 1});
+}
+
+TEST_F(HierarchicalReducerTest, SingleTask) { RunTest(1, 4, 1001, 0); }
+
+TEST_F(HierarchicalReducerTest, OneDevicePerTask) { RunTest(4, 1, 1001, 0); }
+
+TEST_F(HierarchicalReducerTest, MultiTask) { RunTest(2, 4, 1001, 0); }
+
+TEST_F(HierarchicalReducerTest, MultiTaskLarge) { RunTest(4, 4, 65536, 0); }
+
+TEST_F(HierarchicalReducerTest, MultiTaskShortTensor) { RunTest(3, 2, 1, 0); }
+
+TEST_F(HierarchicalReducerTest, LocalFailure) { RunTest(2, 4, 1001, 1); }
+
+TEST_F(HierarchicalReducerTest, LeaderRingFailure) {
+  RunTest(2, 4, 1001, 14);
+}
+
+}  // namespace tensorflow
@@ -20,6 +20,7 @@ limitations under the License.
 #include <functional>
 #include <utility>
 
+#include "tensorflow/core/common_runtime/collective_compression.h"
 #include "tensorflow/core/common_runtime/collective_rma_local.h"
 #include "tensorflow/core/common_runtime/collective_util.h"
 #include "tensorflow/core/common_runtime/copy_tensor.h"
@@ -39,6 +40,7 @@ limitations under the License.
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/util/env_var.h"
 
 // Set true for greater intelligibility of debug mode log messages.
 #define READABLE_KEYS false
@@ -53,6 +55,11 @@ constexpr size_t kMaxChunkSizeBytes = (4 * 1024 * 1024);
 // through the collectives API. A reasonable value would be a small
 // multiple of the number of NICs adjacent to each device.
 constexpr int kMaxSubdivsPerDeviceDefault = 2;
+// When reductions are pipelined on CPU, smaller chunks and more subdivisions
+// give the ring loop more independent fields to keep in flight, so that the
+// receive of one field overlaps with the reduction of another.
+constexpr size_t kMaxPipelinedChunkSizeBytes = (1024 * 1024);
+constexpr int kMaxPipelinedSubdivsPerDeviceDefault = 4;
 
 namespace tensorflow {
 namespace {
@@ -121,12 +128,16 @@ Status GenerateSubdivsInCollectiveParams(CollectiveParams* col_params) {
   if (col_params->instance.shape.num_elements() == 0) {
     return errors::Internal("shape in CollectiveParams should be non-empty");
   }
+  const bool pipelined = RingAlg::UsePipelinedReduction(*col_params);
+  const size_t max_chunk_size_bytes =
+      pipelined ? kMaxPipelinedChunkSizeBytes : kMaxChunkSizeBytes;
   const int kAvgDevPerTask =
       col_params->group.group_size / col_params->group.num_tasks;
   const int max_subdivs_per_device =
       (col_params->instance.impl_details.max_subdivs_per_device > 0)
           ? col_params->instance.impl_details.max_subdivs_per_device
-          : kMaxSubdivsPerDeviceDefault;
+          : (pipelined ? kMaxPipelinedSubdivsPerDeviceDefault
+                       : kMaxSubdivsPerDeviceDefault);
   const int kMaxNumSubdivs = max_subdivs_per_device * kAvgDevPerTask;
   if (kMaxNumSubdivs <= 0) {
     return errors::Internal("Unexpected kMaxNumSubdivs ", kMaxNumSubdivs,
@@ -135,7 +146,7 @@ Status GenerateSubdivsInCollectiveParams(CollectiveParams* col_params) {
   }
   // NOTE(ayushd): If no subdiv_offsets have been specified, dynamically add
   // as many offsets as needed so that the size of tensor chunks <=
-  // kMaxChunkSizeBytes.  Empirically, chunks that are too small or too large
+  // max_chunk_size_bytes.  Empirically, chunks that are too small or too large
   // lead to worse performance.
   int num_subdivs = 0;
   const size_t tensor_size = col_params->instance.shape.num_elements() *
@@ -147,7 +158,7 @@ Status GenerateSubdivsInCollectiveParams(CollectiveParams* col_params) {
     chunk_size = tensor_size / num_chunks;
     VLOG(2) << "num_subdivs " << num_subdivs << " num_chunks " << num_chunks
             << " chunk_size " << chunk_size;
-  } while (chunk_size > kMaxChunkSizeBytes && num_subdivs < kMaxNumSubdivs);
+  } while (chunk_size > max_chunk_size_bytes && num_subdivs < kMaxNumSubdivs);
   if (num_subdivs <= 0) {
     return errors::Internal("Unexpected num_subdivs ", num_subdivs, " in ",
                             col_params->instance.impl_details.collective_name);
@@ -177,6 +188,21 @@ Status GenerateSubdivsInCollectiveParams(CollectiveParams* col_params) {
 }
 }  // namespace
 
+bool RingAlg::UsePipelinedReduction(const CollectiveParams& col_params) {
+  if (col_params.instance.type != REDUCTION_COLLECTIVE ||
+      col_params.group.device_type != DeviceType(DEVICE_CPU)) {
+    return false;
+  }
+  bool pipelined = false;
+  Status s =
+      ReadBoolFromEnvVar("TF_RING_REDUCE_PIPELINED_CPU", false, &pipelined);
+  if (!s.ok()) {
+    LOG(WARNING) << "Ignoring TF_RING_REDUCE_PIPELINED_CPU: " << s;
+    return false;
+  }
+  return pipelined;
+}
+
 Status RingAlg::InitializeCollectiveParams(CollectiveParams* col_params) {
   const string& device_name =
       col_params->group.members[col_params->default_rank].device.name();
@@ -204,6 +230,17 @@ Status RingAlg::InitializeCollectiveParams(CollectiveParams* col_params) {
   dev_per_task.push_back(dev_count);
   DCHECK_EQ(col_params->group.num_tasks, dev_per_task.size());
 
+  // Compression and its error feedback only make sense for reductions: a
+  // gather has no partial results to carry the quantization error of.
+  if (col_params->instance.impl_details.compression != COMPRESSION_NONE &&
+      type_ != REDUCTION_COLLECTIVE) {
+    return errors::InvalidArgument(
+        "Collective compression is only supported by RingReduce, got ", name_);
+  }
+  TF_RETURN_IF_ERROR(collective_compression::ValidateCompression(
+      col_params->instance.impl_details.compression,
+      col_params->instance.data_type, col_params->group.device_type));
+
   if (col_params->instance.impl_details.subdiv_offsets.empty()) {
     TF_RETURN_IF_ERROR(GenerateSubdivsInCollectiveParams(col_params));
   }
@@ -260,6 +297,7 @@ Status RingAlg::InitializeCollectiveContext(
   DCHECK(col_ctx->dev_mgr);
   col_ctx_ = col_ctx;
   col_params_ = col_ctx->col_params.get();
+  compression_ = col_params_->instance.impl_details.compression;
   return collective_util::InitializeDeviceAndLocality(
       col_ctx->dev_mgr, col_ctx->device_name, &col_ctx->device,
       &col_ctx->device_locality);
@@ -359,6 +397,18 @@ void RingAlg::InitRingField(RingField* rf, int chunk_idx, int subdiv_idx,
       (rf->rank == ((rf->chunk_idx + (group_size_ - 1)) % group_size_));
   if (rf->do_send || rf->do_recv) {
     rf->chunk = ca_->ChunkAlias(rf->sc_idx);
+    if (compression_ != COMPRESSION_NONE) {
+      if (!residual_.IsInitialized()) {
+        residual_ = collective_compression::ResidualStore::Global()->Get(
+            col_ctx_->device_name, col_params_->group.group_key,
+            col_params_->instance.instance_key, ca_->Value().NumElements());
+      }
+      rf->encoded_chunk = collective_compression::AllocateEncodedChunk(
+          compression_,
+          col_ctx_->device->GetAllocator(
+              col_ctx_->op_ctx->output_alloc_attr(0)),
+          rf->chunk.NumElements());
+    }
   }
   VLOG(2) << this << " InitRingField " << rf->DebugString() << " chunk "
           << ca_->TBounds(rf->chunk);
@@ -404,11 +454,34 @@ void RingAlg::DispatchSend(RingField* rf, const StatusCallback& done) {
   int send_to_rank = (rf->rank + 1) % group_size_;
   int send_to_dev_idx = col_params_->instance.impl_details
                             .subdiv_permutations[rf->subdiv_idx][send_to_rank];
+  const Tensor* send_tensor = &rf->chunk;
+  if (compression_ != COMPRESSION_NONE) {
+    if (!ForwardsEncodedChunk(rf)) {
+      // Partial sums feed back their quantization error into the next
+      // execution.  Final values are instead overwritten with their decoded
+      // value so that every device ends up with the same result.
+      const bool partial_sum = !rf->second_pass;
+      Tensor residual_chunk;
+      if (partial_sum) {
+        // The residual is laid out like the flattened output.
+        const int64_t offset =
+            static_cast<const float*>(DMAHelper::base(&rf->chunk)) -
+            static_cast<const float*>(DMAHelper::base(&ca_->Value()));
+        residual_chunk =
+            residual_.Slice(offset, offset + rf->chunk.NumElements());
+      }
+      collective_compression::EncodeChunk(
+          compression_, &rf->chunk,
+          residual_chunk.IsInitialized() ? &residual_chunk : nullptr,
+          /*write_back=*/!partial_sum, &rf->encoded_chunk);
+    }
+    send_tensor = &rf->encoded_chunk;
+  }
   col_ctx_->col_exec->remote_access()->PostToPeer(
       col_params_->group.members[send_to_dev_idx].device.name(),
       col_params_->group.members[send_to_dev_idx].task, send_buf_key,
       col_ctx_->device, col_ctx_->op_ctx->op_device_context(),
-      col_ctx_->op_ctx->output_alloc_attr(0), &rf->chunk,
+      col_ctx_->op_ctx->output_alloc_attr(0), send_tensor,
       col_ctx_->device_locality, col_ctx_->op_ctx->cancellation_manager(),
       done);
 }
@@ -424,6 +497,18 @@ void RingAlg::DispatchRecv(RingField* rf, const StatusCallback& done) {
   Tensor* dst_tensor = (!rf->second_pass && (col_params_->merge_op != nullptr))
                            ? &rf->tmp_chunk
                            : &rf->chunk;
+  StatusCallback recv_done = done;
+  if (compression_ != COMPRESSION_NONE) {
+    // Receive the encoding and decode it into the destination once it lands.
+    recv_done = [this, rf, dst_tensor, done](const Status& s) {
+      if (s.ok()) {
+        collective_compression::DecodeChunk(compression_, rf->encoded_chunk,
+                                            dst_tensor);
+      }
+      done(s);
+    };
+    dst_tensor = &rf->encoded_chunk;
+  }
   col_ctx_->col_exec->remote_access()->RecvFromPeer(
       col_params_->group.members[rf->recv_dev_idx].device.name(),
       col_params_->group.members[rf->recv_dev_idx].task,
@@ -431,7 +516,11 @@ void RingAlg::DispatchRecv(RingField* rf, const StatusCallback& done) {
       col_ctx_->device, col_ctx_->op_ctx->op_device_context(),
       col_ctx_->op_ctx->output_alloc_attr(0), dst_tensor,
       col_ctx_->device_locality, rf->subdiv_idx,
-      col_ctx_->op_ctx->cancellation_manager(), done);
+      col_ctx_->op_ctx->cancellation_manager(), recv_done);
+}
+
+bool RingAlg::ForwardsEncodedChunk(const RingField* rf) const {
+  return rf->do_recv && rf->second_pass;
 }
 
 string RingAlg::FieldState() {
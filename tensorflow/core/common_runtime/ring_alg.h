@@ -42,6 +42,14 @@ class RingAlg : public CollectiveImplementationInterface {
   Status InitializeCollectiveContext(
       std::shared_ptr<CollectiveContext> col_ctx) override;
 
+  // Returns true if reductions for this collective should be pipelined, i.e.
+  // run off the ring loop thread so that they overlap with transfers of other
+  // fields.  Only applies to CPU reductions, and is enabled by setting
+  // TF_RING_REDUCE_PIPELINED_CPU=true.  Because it also changes the
+  // automatically generated subdivisions, every member of a group must use
+  // the same setting.
+  static bool UsePipelinedReduction(const CollectiveParams& col_params);
+
  protected:
   // Called when a bad status is received that implies we should terminate
   // execution and return a bad status.
@@ -75,6 +83,7 @@ class RingAlg : public CollectiveImplementationInterface {
     bool is_final = false;  // is the last field in the pass for this rank
     Tensor chunk;           // alias to field values
     Tensor tmp_chunk;
+    Tensor encoded_chunk;   // chunk as sent or received, if compressing
     Status status;
     string DebugString() const;
   };
@@ -84,6 +93,10 @@ class RingAlg : public CollectiveImplementationInterface {
   void DispatchSend(RingField* rf, const StatusCallback& done);
   void DispatchRecv(RingField* rf, const StatusCallback& done);
 
+  // When compressing, a field forwards the encoding it received in the same
+  // pass rather than encoding its chunk again.
+  bool ForwardsEncodedChunk(const RingField* rf) const;
+
   // For constructing log messages for debugging.
   string FieldState();
   string TensorDebugString(const Tensor& tensor);
@@ -111,6 +124,8 @@ class RingAlg : public CollectiveImplementationInterface {
   Tensor group_size_tensor_;
   Notification group_size_tensor_ready_;
   std::unique_ptr<CollectiveAdapter> ca_;
+  CollectiveCompression compression_ = COMPRESSION_NONE;
+  Tensor residual_;  // error feedback for compressed chunks
   mutex status_mu_;
   Status status_ TF_GUARDED_BY(status_mu_);
   std::vector<RingField> rfv_;
@@ -17,6 +17,7 @@ limitations under the License.
 #include <algorithm>
 
 #include "absl/memory/memory.h"
+#include "absl/strings/match.h"
 #include "tensorflow/core/common_runtime/base_collective_executor.h"
 #include "tensorflow/core/common_runtime/collective_rma_local.h"
 #include "tensorflow/core/common_runtime/collective_test_util.h"
@@ -211,6 +212,22 @@ TEST_F(RingGathererInitParamsTest, SpecifiedSubdivs) {
                      {3});
 }
 
+TEST(RingGathererCompressionTest, RejectsCompression) {
+  auto test_env = CreateCollectiveTestEnv(/*num_workers=*/1,
+                                          /*num_devices_per_worker=*/2,
+                                          DEVICE_CPU);
+  auto cp =
+      CreateCollectiveParams(*test_env, /*rank*/ 0, "RingGather",
+                             GATHER_COLLECTIVE, DT_FLOAT, TensorShape({8}));
+  cp->instance.impl_details.compression = COMPRESSION_BF16;
+  core::RefCountPtr<RingGatherer> gatherer(new RingGatherer());
+  Status s = gatherer->InitializeCollectiveParams(cp.get());
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+  EXPECT_TRUE(
+      absl::StrContains(s.ToString(), "only supported by RingReduce"))
+      << s;
+}
+
 // TODO(b/113171733): change to use TEST_P.
 #define DEF_TEST(B, T, W, D, S, L, A)                                         \
   TEST_F(RingGathererTest,                                                    \
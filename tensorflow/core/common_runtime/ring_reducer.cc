@@ -212,6 +212,8 @@ bool RingReducer::RunAsyncParts() {
   int field_done_count = 0;
   int send_pending_count = 0;
   int recv_pending_count = 0;
+  int reduce_pending_count = 0;
+  const bool pipelined = UsePipelinedReduction(*col_params_);
   std::atomic<bool> aborted(false);
 
   {
@@ -254,18 +256,38 @@ bool RingReducer::RunAsyncParts() {
             --recv_pending_count;
             if (!rf->second_pass) {
               rf->action = RF_REDUCE;
-              Status s = collective_util::ComputeBinOp(
-                  col_ctx_->op_ctx, col_ctx_->op_params, col_ctx_->device,
-                  col_params_->merge_op, &rf->chunk, &rf->tmp_chunk);
-              if (!s.ok()) {
-                aborted = true;
-                StartAbort(s);
+              if (pipelined) {
+                // Hand the reduction to another thread so this loop can keep
+                // dispatching transfers for the other fields meanwhile.
+                auto reduce_complete = [this, rf, &ready_queue,
+                                        &aborted](Status s) {
+                  if (!s.ok()) {
+                    aborted = true;
+                    StartAbort(s);
+                  }
+                  ready_queue.Enqueue(rf);
+                };
+                DispatchReduce(rf, reduce_complete);
+                dispatched = true;
+                ++reduce_pending_count;
+              } else {
+                Status s = collective_util::ComputeBinOp(
+                    col_ctx_->op_ctx, col_ctx_->op_params, col_ctx_->device,
+                    col_params_->merge_op, &rf->chunk, &rf->tmp_chunk);
+                if (!s.ok()) {
+                  aborted = true;
+                  StartAbort(s);
+                }
               }
             } else {
               rf->action = RF_SEND_READY;
             }
             break;
           case RF_REDUCE:
+            if (pipelined) {
+              CHECK_GT(reduce_pending_count, 0);
+              --reduce_pending_count;
+            }
             if (!rf->second_pass && col_params_->final_op && rf->is_final) {
               rf->action = RF_FINALIZE;
               group_size_tensor_ready_.WaitForNotification();
@@ -324,12 +346,16 @@ bool RingReducer::RunAsyncParts() {
     if (aborted) {
       // All of the pending data actions should be aborted; field the
       // callbacks and clear the queue before quitting.
-      while ((send_pending_count > 0) || (recv_pending_count > 0)) {
+      while ((send_pending_count > 0) || (recv_pending_count > 0) ||
+             (reduce_pending_count > 0)) {
         RingField* rf = ready_queue.Dequeue();
         switch (rf->action) {
           case RF_RECV:
             --recv_pending_count;
             break;
+          case RF_REDUCE:
+            if (pipelined) --reduce_pending_count;
+            break;
           case RF_SEND:
             --send_pending_count;
             break;
@@ -342,12 +368,22 @@ bool RingReducer::RunAsyncParts() {
 
   CHECK_EQ(send_pending_count, 0);
   CHECK_EQ(recv_pending_count, 0);
+  CHECK_EQ(reduce_pending_count, 0);
 
   VLOG(2) << this << " device=" << col_ctx_->device_name << " finish;"
           << " final value " << TensorDebugString(ca_->Value());
   return !aborted;
 }
 
+void RingReducer::DispatchReduce(RingField* rf, const StatusCallback& done) {
+  col_ctx_->col_exec->RunClosure([this, rf, done]() {
+    profiler::TraceMe activity("Reduce", profiler::TraceMeLevel::kInfo);
+    done(collective_util::ComputeBinOp(
+        col_ctx_->op_ctx, col_ctx_->op_params, col_ctx_->device,
+        col_params_->merge_op, &rf->chunk, &rf->tmp_chunk));
+  });
+}
+
 namespace {
 REGISTER_COLLECTIVE(RingReduce, RingReducer);
 }  // namespace
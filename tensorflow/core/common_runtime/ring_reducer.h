@@ -48,6 +48,9 @@ class RingReducer : public RingAlg {
  private:
   void ContinueAfterInputCopy();
   bool RunAsyncParts();
+  // Runs the merge op for rf on a collective executor thread and calls done
+  // when it completes.  Used when reductions are pipelined.
+  void DispatchReduce(RingField* rf, const StatusCallback& done);
 
   Tensor group_size_tensor_;
   Notification group_size_tensor_ready_;
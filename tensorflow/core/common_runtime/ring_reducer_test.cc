@@ -14,6 +14,8 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/common_runtime/ring_reducer.h"
 
+#include <stdlib.h>
+
 #include <algorithm>
 
 #include "absl/memory/memory.h"
@@ -36,6 +38,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/lib/core/notification.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/blocking_counter.h"
 #include "tensorflow/core/platform/refcount.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/unbounded_work_queue.h"
@@ -79,6 +82,15 @@ std::unique_ptr<OpKernel> GetDiv(DataType dtype, const DeviceType& device_type,
   return GetKernel(node_def, device_type, device);
 }
 
+// Enables pipelined CPU reductions for the lifetime of the object.
+class ScopedPipelinedReduction {
+ public:
+  ScopedPipelinedReduction() {
+    setenv("TF_RING_REDUCE_PIPELINED_CPU", "true", /*overwrite=*/1);
+  }
+  ~ScopedPipelinedReduction() { unsetenv("TF_RING_REDUCE_PIPELINED_CPU"); }
+};
+
 class RingReducerTest : public ::testing::Test {
  protected:
   void Init(int num_workers, int num_devices, DataType dtype,
@@ -374,6 +386,32 @@ TEST_F(RingReducerInitParamsTest, AutomaticSubdivDisabled) {
   RunSubdivPermsTest(cp.get(), {{0, 1, 2, 3}}, {0});
 }
 
+TEST_F(RingReducerInitParamsTest, AutomaticSubdivPipelined) {
+  ScopedPipelinedReduction pipelined;
+  const int kNumDevsPerWorker = 1;
+  const int kNumWorkers = 4;
+  auto test_env =
+      CreateCollectiveTestEnv(kNumWorkers, kNumDevsPerWorker, DEVICE_CPU);
+  auto cp =
+      CreateCollectiveParams(*test_env, /*rank*/ 0, "RingReduce",
+                             REDUCTION_COLLECTIVE, DT_FLOAT, TensorShape({1}));
+
+  // Pipelined reductions use smaller chunks and a larger default upper bound
+  // on subdivisions than the non-pipelined default of 2.
+  cp->default_rank = 0;
+  cp->instance.impl_details.subdiv_offsets.clear();
+  cp->instance.impl_details.max_subdivs_per_device = 0;
+  cp->instance.shape = TensorShape({104857600 / DataTypeSize(DT_FLOAT)});
+  RunSubdivPermsTest(cp.get(),
+                     {{0, 1, 2, 3}, {0, 1, 2, 3}, {0, 1, 2, 3}, {0, 1, 2, 3}},
+                     {0, 0, 0, 0});
+
+  // A tensor whose chunks already fit in 1 MiB is not subdivided.
+  cp->instance.impl_details.subdiv_offsets.clear();
+  cp->instance.shape = TensorShape({4194304 / DataTypeSize(DT_FLOAT)});
+  RunSubdivPermsTest(cp.get(), {{0, 1, 2, 3}}, {0});
+}
+
 // TODO(b/113171733): change to use TEST_P.
 #define DEF_TEST(B, T, W, D, S, L, A)                                         \
   TEST_F(RingReducerTest,                                                     \
@@ -427,6 +465,163 @@ DEF_TEST(INT64, CPU, 2, 8, 3, 4095, 0)
 DEF_TEST(FLOAT, CPU, 2, 8, 1, 9408, 1)
 DEF_TEST(FLOAT, CPU, 2, 8, 1, 9408, 7)
 DEF_TEST(FLOAT, CPU, 2, 8, 2, 9408, 11)
+
+#define DEF_PIPELINED_TEST(B, T, W, D, S, L, A)                            \
+  TEST_F(RingReducerTest,                                                  \
+         Pipelined_DaTy##B##_Wkr##W##_Dev##D##_Sdiv##S##_Len##L##_Abrt##A) { \
+    ScopedPipelinedReduction pipelined;                                    \
+    RunTest<T>(DT_##B, DEVICE_CPU, W, D, S, L, A);                         \
+  }
+
+DEF_PIPELINED_TEST(FLOAT, float, 1, 2, 1, 1001, 0)
+DEF_PIPELINED_TEST(FLOAT, float, 2, 8, 3, 4095, 0)
+DEF_PIPELINED_TEST(FLOAT, float, 4, 4, 4, 1045991, 0)
+DEF_PIPELINED_TEST(INT64, int64_t, 2, 8, 3, 4095, 0)
+DEF_PIPELINED_TEST(FLOAT, float, 2, 8, 1, 9408, 7)
+DEF_PIPELINED_TEST(FLOAT, float, 2, 8, 2, 9408, 11)
+
+// Runs `num_steps` of data-parallel gradient descent on sum_w |x - t_w|^2 / 2,
+// whose gradients are averaged by compressed all-reduces, and checks that
+// every worker converges to the same parameters near the mean of the t_w.
+static void RunCompressedSgdTest(CollectiveCompression compression,
+                                 int num_steps, float tolerance) {
+  const int kNumWorkers = 4;
+  const int64_t kTensorLen = 1001;
+  const float kLearningRate = 0.5f;
+  auto test_env = CreateCollectiveTestEnv(kNumWorkers, 1, DEVICE_CPU);
+  std::vector<Device*> devices(kNumWorkers);
+  std::vector<std::unique_ptr<OpKernel>> merge_ops;
+  std::vector<std::unique_ptr<OpKernel>> final_ops;
+  std::vector<Tensor> targets;
+  std::vector<Tensor> params;
+  std::vector<float> expected(kTensorLen, 0.0f);
+  for (int rank = 0; rank < kNumWorkers; ++rank) {
+    auto cp = CreateCollectiveParams(*test_env, rank, "RingReduce",
+                                     REDUCTION_COLLECTIVE, DT_FLOAT,
+                                     TensorShape({kTensorLen}));
+    TF_CHECK_OK(test_env->device_mgr->LookupDevice(
+        cp->group.members[rank].device.name(), &devices[rank]));
+    merge_ops.push_back(GetAdd(DT_FLOAT, DEVICE_CPU, devices[rank]));
+    final_ops.push_back(GetDiv(DT_FLOAT, DEVICE_CPU, devices[rank]));
+    targets.emplace_back(DT_FLOAT, TensorShape({kTensorLen}));
+    targets.back().flat<float>().setRandom();
+    params.emplace_back(DT_FLOAT, TensorShape({kTensorLen}));
+    params.back().flat<float>().setZero();
+    for (int i = 0; i < kTensorLen; ++i) {
+      expected[i] += targets.back().flat<float>()(i) / kNumWorkers;
+    }
+  }
+
+  for (int step = 0; step < num_steps; ++step) {
+    std::vector<core::RefCountPtr<CollectiveParams>> col_params;
+    std::vector<Tensor> grads;
+    std::vector<Status> statuses(kNumWorkers);
+    for (int rank = 0; rank < kNumWorkers; ++rank) {
+      col_params.push_back(CreateCollectiveParams(
+          *test_env, rank, "RingReduce", REDUCTION_COLLECTIVE, DT_FLOAT,
+          TensorShape({kTensorLen})));
+      // Keeps the error feedback of each compression scheme apart.
+      col_params.back()->instance.instance_key += compression;
+      col_params.back()->instance.impl_details.compression = compression;
+      col_params.back()->merge_op = merge_ops[rank].get();
+      col_params.back()->final_op = final_ops[rank].get();
+      grads.emplace_back(DT_FLOAT, TensorShape({kTensorLen}));
+      grads.back().flat<float>() =
+          params[rank].flat<float>() - targets[rank].flat<float>();
+    }
+    BlockingCounter counter(kNumWorkers);
+    for (int rank = 0; rank < kNumWorkers; ++rank) {
+      SchedClosure([&, rank] {
+        statuses[rank] =
+            RunCollective(test_env.get(), col_params[rank].get(),
+                          devices[rank], &grads[rank], &grads[rank]);
+        counter.DecrementCount();
+      });
+    }
+    counter.Wait();
+    for (int rank = 0; rank < kNumWorkers; ++rank) {
+      TF_ASSERT_OK(statuses[rank]);
+      params[rank].flat<float>() -= kLearningRate * grads[rank].flat<float>();
+    }
+  }
+
+  for (int rank = 0; rank < kNumWorkers; ++rank) {
+    test::ExpectTensorEqual<float>(params[0], params[rank]);
+    test::ExpectTensorNear<float>(test::AsTensor<float>(expected),
+                                  params[rank], tolerance);
+  }
+}
+
+TEST(RingReducerCompressionTest, Bfloat16Converges) {
+  RunCompressedSgdTest(COMPRESSION_BF16, 40, 1e-2);
+}
+
+TEST(RingReducerCompressionTest, Int8Converges) {
+  RunCompressedSgdTest(COMPRESSION_INT8, 40, 5e-2);
+}
+
+// Measures all-reduce throughput across single-device workers connected
+// through CollectiveRemoteAccessLocal, with and without pipelined reductions.
+// Args: number of workers, tensor length, pipelined.
+static void BM_RingReduce(::testing::benchmark::State& state) {
+  const int num_workers = state.range(0);
+  const int64_t tensor_len = state.range(1);
+  std::unique_ptr<ScopedPipelinedReduction> pipelined;
+  if (state.range(2)) {
+    pipelined = std::make_unique<ScopedPipelinedReduction>();
+  }
+  auto test_env = CreateCollectiveTestEnv(num_workers, 1, DEVICE_CPU);
+  std::vector<Device*> devices(num_workers);
+  std::vector<std::unique_ptr<OpKernel>> merge_ops;
+  std::vector<std::unique_ptr<OpKernel>> final_ops;
+  std::vector<Tensor> tensors;
+  for (int rank = 0; rank < num_workers; ++rank) {
+    auto cp = CreateCollectiveParams(*test_env, rank, "RingReduce",
+                                     REDUCTION_COLLECTIVE, DT_FLOAT,
+                                     TensorShape({tensor_len}));
+    TF_CHECK_OK(test_env->device_mgr->LookupDevice(
+        cp->group.members[rank].device.name(), &devices[rank]));
+    merge_ops.push_back(GetAdd(DT_FLOAT, DEVICE_CPU, devices[rank]));
+    final_ops.push_back(GetDiv(DT_FLOAT, DEVICE_CPU, devices[rank]));
+    tensors.emplace_back(DT_FLOAT, TensorShape({tensor_len}));
+    tensors.back().flat<float>().setRandom();
+  }
+
+  for (auto s : state) {
+    // Collective params are completed in place by each run, so every
+    // iteration starts from a fresh set.
+    std::vector<core::RefCountPtr<CollectiveParams>> col_params;
+    for (int rank = 0; rank < num_workers; ++rank) {
+      col_params.push_back(CreateCollectiveParams(
+          *test_env, rank, "RingReduce", REDUCTION_COLLECTIVE, DT_FLOAT,
+          TensorShape({tensor_len})));
+      col_params.back()->instance.impl_details.max_subdivs_per_device = 0;
+      col_params.back()->merge_op = merge_ops[rank].get();
+      col_params.back()->final_op = final_ops[rank].get();
+    }
+    BlockingCounter counter(num_workers);
+    for (int rank = 0; rank < num_workers; ++rank) {
+      SchedClosure([&, rank] {
+        TF_CHECK_OK(RunCollective(test_env.get(), col_params[rank].get(),
+                                  devices[rank], &tensors[rank],
+                                  &tensors[rank]));
+        counter.DecrementCount();
+      });
+    }
+    counter.Wait();
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          num_workers * tensor_len * sizeof(float));
+}
+
+BENCHMARK(BM_RingReduce)
+    ->UseRealTime()
+    ->Args({4, 1 << 18, 0})
+    ->Args({4, 1 << 18, 1})
+    ->Args({4, 1 << 22, 0})
+    ->Args({4, 1 << 22, 1})
+    ->Args({8, 1 << 22, 0})
+    ->Args({8, 1 << 22, 1});
 #endif
 
 #if GOOGLE_CUDA || TENSORFLOW_USE_ROCM
@@ -88,6 +88,7 @@ CollInstanceParams& CollInstanceParams::operator=(
         other.impl_details.subdiv_source_rank.begin(),
         other.impl_details.subdiv_source_rank.end());
     impl_details.dependencies = other.impl_details.dependencies;
+    impl_details.compression = other.impl_details.compression;
     devices.assign(other.devices.begin(), other.devices.end());
     permutation.assign(other.permutation.begin(), other.permutation.end());
   }
@@ -120,6 +121,9 @@ string CollInstanceParams::ToString() const {
     }
     strings::StrAppend(&v, "}");
   }  // all subdivs
+  if (impl_details.compression != COMPRESSION_NONE) {
+    strings::StrAppend(&v, " compression=", impl_details.compression);
+  }
   if (type == PERMUTE_COLLECTIVE) {
     strings::StrAppend(&v, "}, permute_devices {");
     for (const auto& d : devices) {
@@ -52,6 +52,14 @@ enum CollectiveType {
   UNDEFINED_COLLECTIVE,
 };
 
+// Lossy encodings which the ring all-reduce may apply to the chunks it
+// transfers between devices.
+enum CollectiveCompression {
+  COMPRESSION_NONE = 0,
+  COMPRESSION_BF16,  // Round each float to bfloat16.
+  COMPRESSION_INT8,  // Linearly quantize each chunk to int8 with one scale.
+};
+
 // Some collective op implementations require runtime group configuration from
 // the OpKernel.  Currently, this struct is used to set communicator key for
 // NCCL-based collective implementation.
@@ -116,6 +124,10 @@ struct CollImplDetails {
                               // e.g. ring or nccl
   float timeout_seconds;      // If non zero, set a completion timeout for the
                               // collective op to detect staleness.
+  // Encoding of the chunks sent by RingReduce.  Only supported for DT_FLOAT
+  // on CPU.  Quantization errors are fed back into the next execution of the
+  // same instance on each device.
+  CollectiveCompression compression = COMPRESSION_NONE;
 };
 
 // Data common to all members of a collective instance.
@@ -110,6 +110,17 @@ class Var : public ResourceBase {
   // so desired.
   std::atomic<bool> copy_on_read_mode{false};
 
+  // Incremented through MarkUpdated() by the ops that write the variable,
+  // after a successful write and while they still hold mu(). Readers that copy
+  // the variable without holding its lock for the whole read use it to detect
+  // concurrent updates, which may happen under a shared lock in copy-on-read
+  // mode. It covers the whole variable: a write of any row changes it.
+  std::atomic<int64_t> version{0};
+
+  // Records that the value of the variable has changed. Must be called after
+  // the write, with mu() held in exclusive or shared mode.
+  void MarkUpdated() { version.fetch_add(1); }
+
  private:
   mutex mu_;
   Tensor tensor_;
@@ -491,6 +491,59 @@ uint64 NumElementsFromTensorProto(const TensorProto& tensor_proto) {
   return num_elements;
 }
 
+// Returns true if the properties of `node` only depend on the properties of its
+// regular fanins, so that GraphProperties::UpdateStatically can re-infer them
+// in a subgraph.
+bool CanInferSeparately(
+    const NodeDef& node,
+    const absl::flat_hash_set<absl::string_view>& function_names) {
+  if (IsControlFlow(node) || IsQueue(node) || IsEnqueue(node) ||
+      IsDequeue(node) || function_names.contains(node.op())) {
+    return false;
+  }
+  for (const auto& attr : node.attr()) {
+    if (attr.second.has_func() || attr.second.list().func_size() > 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Symbolic dimensions inferred in different graphs can't be compared.
+void ForgetSymbolicDimensions(
+    std::vector<OpInfo::TensorProperties>* properties) {
+  for (OpInfo::TensorProperties& prop : *properties) {
+    for (auto& dim : *prop.mutable_shape()->mutable_dim()) {
+      if (dim.size() < -1) dim.set_size(-1);
+    }
+  }
+}
+
+bool SameTensorProperties(const std::vector<OpInfo::TensorProperties>& a,
+                          const std::vector<OpInfo::TensorProperties>& b) {
+  if (a.size() != b.size()) return false;
+  for (int i = 0, end = a.size(); i < end; ++i) {
+    const TensorShapeProto& a_shape = a[i].shape();
+    const TensorShapeProto& b_shape = b[i].shape();
+    if (a[i].dtype() != b[i].dtype() ||
+        a_shape.unknown_rank() != b_shape.unknown_rank() ||
+        a_shape.dim_size() != b_shape.dim_size()) {
+      return false;
+    }
+    for (int d = 0; d < a_shape.dim_size(); ++d) {
+      const int64_t a_dim = a_shape.dim(d).size();
+      const int64_t b_dim = b_shape.dim(d).size();
+      if (a_dim != b_dim && (a_dim >= 0 || b_dim >= 0)) return false;
+    }
+    if (a[i].has_value() != b[i].has_value() ||
+        (a[i].has_value() && a[i].value().SerializeAsString() !=
+                                 b[i].value().SerializeAsString())) {
+      return false;
+    }
+  }
+  return true;
+}
+
 }  // namespace
 
 // Note that tensor_as_shape input should not include kUnknownDimFromConst.
@@ -2519,6 +2572,10 @@ Status GraphProperties::InferStatically(bool assume_valid_feeds,
                                         bool aggressive_shape_inference,
                                         bool include_input_tensor_values,
                                         bool include_output_tensor_values) {
+  assume_valid_feeds_ = assume_valid_feeds;
+  aggressive_shape_inference_ = aggressive_shape_inference;
+  include_input_tensor_values_ = include_input_tensor_values;
+  include_output_tensor_values_ = include_output_tensor_values;
   FunctionLibraryDefinition function_library(OpRegistry::Global(),
                                              item_.graph.library());
   absl::flat_hash_map<string, absl::flat_hash_set<int>> fed_ports;
@@ -2757,6 +2814,216 @@ Status GraphProperties::InferStatically(bool assume_valid_feeds,
   TF_RETURN_IF_ERROR(VerboseShapeInferenceLogging(item_.graph, refiner.get(),
                                                   shape_manager.get()));
 
+  inferred_statically_ = true;
+  return OkStatus();
+}
+
+Status GraphProperties::UpdateStatically(
+    const absl::flat_hash_set<string>& dirty_nodes,
+    const absl::flat_hash_set<string>& deleted_nodes) {
+  if (!inferred_statically_) {
+    return errors::FailedPrecondition(
+        "UpdateStatically() requires properties inferred by "
+        "InferStatically().");
+  }
+  for (const string& node_name : deleted_nodes) {
+    input_properties_.erase(node_name);
+    output_properties_.erase(node_name);
+    incompatible_shape_nodes_.erase(node_name);
+  }
+
+  absl::flat_hash_map<absl::string_view, const NodeDef*> nodes;
+  nodes.reserve(item_.graph.node_size());
+  for (const NodeDef& node : item_.graph.node()) {
+    nodes.emplace(node.name(), &node);
+  }
+  absl::flat_hash_set<const NodeDef*> region;
+  for (const string& node_name : dirty_nodes) {
+    auto it = nodes.find(node_name);
+    if (it != nodes.end()) region.insert(it->second);
+  }
+
+  auto infer_all = [this]() {
+    VLOG(1) << "Falling back to inferring the properties of all the nodes.";
+    Clear();
+    incompatible_shape_nodes_.clear();
+    return InferStatically(assume_valid_feeds_, aggressive_shape_inference_,
+                           include_input_tensor_values_,
+                           include_output_tensor_values_);
+  };
+
+  // Re-infer the dirty nodes, then the fanouts of the nodes whose outputs
+  // changed, one wave at a time until the outputs stop changing. Most edits,
+  // e.g. swapping the value of a constant, stop after a wave or two. Past
+  // kMaxWaves, the whole transitive fanout is re-inferred at once.
+  constexpr int kMaxWaves = 8;
+  std::unique_ptr<GraphView> graph_view;
+  int num_updated_nodes = 0;
+  for (int wave = 1; !region.empty(); ++wave) {
+    std::vector<const NodeDef*> changed_nodes;
+    bool updated = true;
+    TF_RETURN_IF_ERROR(UpdateRegion(nodes, region, &changed_nodes, &updated));
+    if (!updated) return infer_all();
+    num_updated_nodes += static_cast<int>(region.size());
+    if (wave > kMaxWaves) break;
+
+    if (graph_view == nullptr && !changed_nodes.empty()) {
+      graph_view = std::make_unique<GraphView>(&item_.graph);
+    }
+    region.clear();
+    const bool transitive = wave == kMaxWaves;
+    while (!changed_nodes.empty()) {
+      const NodeDef* node = changed_nodes.back();
+      changed_nodes.pop_back();
+      for (const GraphView::InputPort& fanout : graph_view->GetFanouts(
+               *node, /*include_controlled_nodes=*/false)) {
+        if (region.insert(fanout.node).second && transitive) {
+          changed_nodes.push_back(fanout.node);
+        }
+      }
+    }
+    // Re-inferring most of the graph in subgraphs isn't worth it.
+    if (2 * (num_updated_nodes + static_cast<int>(region.size())) >
+        item_.graph.node_size()) {
+      return infer_all();
+    }
+  }
+  VLOG(1) << "Updated the properties of " << num_updated_nodes << " nodes.";
+  return OkStatus();
+}
+
+Status GraphProperties::UpdateRegion(
+    const absl::flat_hash_map<absl::string_view, const NodeDef*>& nodes,
+    const absl::flat_hash_set<const NodeDef*>& region,
+    std::vector<const NodeDef*>* changed_nodes, bool* updated) {
+  *updated = false;
+  if (region.empty()) {
+    *updated = true;
+    return OkStatus();
+  }
+  absl::flat_hash_set<absl::string_view> function_names;
+  for (const FunctionDef& function : item_.graph.library().function()) {
+    function_names.insert(function.signature().name());
+  }
+  absl::flat_hash_set<absl::string_view> fed_nodes;
+  if (!assume_valid_feeds_) {
+    for (const auto& feed : item_.feed) {
+      fed_nodes.insert(ParseTensorName(feed.first).node());
+    }
+  }
+
+  // The subgraph contains the nodes of the region, whose fanins outside of the
+  // region are replaced by constants or placeholders with the properties
+  // inferred previously.
+  GrapplerItem region_item;
+  *region_item.graph.mutable_versions() = item_.graph.versions();
+  absl::flat_hash_map<string, string> boundary_inputs;
+  for (const NodeDef* node : region) {
+    if (!CanInferSeparately(*node, function_names) ||
+        fed_nodes.contains(node->name())) {
+      VLOG(2) << "Can't update the properties of " << node->name()
+              << " separately from the rest of the graph.";
+      return OkStatus();
+    }
+    NodeDef* region_node = region_item.graph.add_node();
+    *region_node = *node;
+    region_node->clear_input();
+    for (const string& input : node->input()) {
+      const TensorId tensor_id = ParseTensorName(input);
+      auto it = nodes.find(tensor_id.node());
+      if (it == nodes.end()) {
+        return errors::InvalidArgument("Node ", node->name(),
+                                       " has a missing input ", input);
+      }
+      const NodeDef* fanin = it->second;
+      if (region.contains(fanin)) {
+        region_node->add_input(input);
+        continue;
+      }
+      if (IsControlInput(input)) continue;
+
+      const string tensor = tensor_id.ToString();
+      auto boundary_it = boundary_inputs.find(tensor);
+      if (boundary_it != boundary_inputs.end()) {
+        region_node->add_input(boundary_it->second);
+        continue;
+      }
+      NodeDef* boundary = region_item.graph.add_node();
+      if (IsConstant(*fanin)) {
+        *boundary = *fanin;
+        boundary->clear_input();
+      } else {
+        const auto& fanin_properties = GetOutputProperties(fanin->name());
+        if (tensor_id.index() >= static_cast<int>(fanin_properties.size())) {
+          return OkStatus();
+        }
+        const OpInfo::TensorProperties& prop =
+            fanin_properties[tensor_id.index()];
+        if (prop.dtype() == DT_INVALID || prop.dtype() == DT_RESOURCE ||
+            prop.dtype() == DT_VARIANT) {
+          return OkStatus();
+        }
+        boundary->set_name(absl::StrCat(fanin->name(), "/_UpdateStatically_",
+                                        tensor_id.index()));
+        if (nodes.contains(boundary->name())) return OkStatus();
+        if (prop.has_value()) {
+          boundary->set_op("Const");
+          (*boundary->mutable_attr())["value"].mutable_tensor()->CopyFrom(
+              prop.value());
+        } else {
+          boundary->set_op("Placeholder");
+          TensorShapeProto* shape =
+              (*boundary->mutable_attr())["shape"].mutable_shape();
+          *shape = prop.shape();
+          for (auto& dim : *shape->mutable_dim()) {
+            if (dim.size() < -1) dim.set_size(-1);
+          }
+        }
+        (*boundary->mutable_attr())["dtype"].set_type(prop.dtype());
+      }
+      boundary_inputs.emplace(tensor, boundary->name());
+      region_node->add_input(boundary->name());
+    }
+  }
+
+  GraphProperties region_properties(region_item);
+  Status s = region_properties.InferStatically(
+      /*assume_valid_feeds=*/true, aggressive_shape_inference_,
+      include_input_tensor_values_, include_output_tensor_values_);
+  if (!s.ok()) {
+    VLOG(2) << "Failed to update the properties of a region: " << s;
+    return OkStatus();
+  }
+
+  for (const NodeDef* node : region) {
+    const string& name = node->name();
+    if (!region_properties.HasOutputProperties(name)) {
+      input_properties_.erase(name);
+      if (output_properties_.erase(name) > 0) changed_nodes->push_back(node);
+      continue;
+    }
+    std::vector<OpInfo::TensorProperties> input_properties =
+        region_properties.GetInputProperties(name);
+    ForgetSymbolicDimensions(&input_properties);
+    input_properties_[name] = std::move(input_properties);
+
+    std::vector<OpInfo::TensorProperties> output_properties =
+        region_properties.GetOutputProperties(name);
+    ForgetSymbolicDimensions(&output_properties);
+    auto it = output_properties_.find(name);
+    if (it == output_properties_.end() ||
+        !SameTensorProperties(it->second, output_properties)) {
+      changed_nodes->push_back(node);
+    }
+    output_properties_[name] = std::move(output_properties);
+
+    if (region_properties.CheckShapeIncompatible(name)) {
+      incompatible_shape_nodes_.insert(name);
+    } else {
+      incompatible_shape_nodes_.erase(name);
+    }
+  }
+  *updated = true;
   return OkStatus();
 }
 
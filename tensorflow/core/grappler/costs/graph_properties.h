@@ -21,6 +21,8 @@ limitations under the License.
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/string_view.h"
 #include "tensorflow/core/framework/shape_inference.h"
 #include "tensorflow/core/grappler/clusters/cluster.h"
 #include "tensorflow/core/grappler/costs/op_performance_data.pb.h"
@@ -114,6 +116,20 @@ class GraphProperties {
                            /*aggressive_shape_inference=*/false,
                            /*include_tensor_values=*/true);
   }
+  // Updates the properties inferred by InferStatically after a small edit of
+  // the graph of the item, e.g. as recorded by a MutableGraphView tracking
+  // dirty nodes: the nodes in `dirty_nodes` were added or modified, and the
+  // nodes in `deleted_nodes` were removed. Only the dirty nodes are
+  // re-inferred, followed by the transitive fanout of the nodes whose output
+  // properties changed, using the properties inferred previously for their
+  // other fanins.
+  // Falls back to InferStatically with the same options when the edit affects
+  // control flow, functions, queues, feeds or resources, or most of the graph.
+  // Symbolic dimensions shared across the boundary of the re-inferred region
+  // are not preserved: they become unknown in the updated properties.
+  Status UpdateStatically(const absl::flat_hash_set<string>& dirty_nodes,
+                          const absl::flat_hash_set<string>& deleted_nodes);
+
   // Infer the shape by running the graph on the specified cluster and recording
   // the shapes of the processed tensors.
   Status InferDynamically(Cluster* cluster);
@@ -200,6 +216,16 @@ class GraphProperties {
           resource_handles,
       int num_loops) const;
 
+  // Re-infers the properties of the nodes in `region`, assuming the properties
+  // of their fanins outside of the region are up to date, and appends the
+  // nodes whose output properties changed to `changed_nodes`. Sets `*updated`
+  // to false, leaving the properties untouched, if the region can't be inferred
+  // separately from the rest of the graph.
+  Status UpdateRegion(
+      const absl::flat_hash_map<absl::string_view, const NodeDef*>& nodes,
+      const absl::flat_hash_set<const NodeDef*>& region,
+      std::vector<const NodeDef*>* changed_nodes, bool* updated);
+
   // Data members
   const GrapplerItem& item_;
   absl::flat_hash_map<string, std::vector<OpInfo::TensorProperties>>
@@ -211,6 +237,13 @@ class GraphProperties {
   // Nodes with output shape incompatible between shape inference and
   // annotation.
   std::unordered_set<string> incompatible_shape_nodes_;
+
+  // Options of the last call to InferStatically, reused by UpdateStatically.
+  bool inferred_statically_ = false;
+  bool assume_valid_feeds_ = false;
+  bool aggressive_shape_inference_ = false;
+  bool include_input_tensor_values_ = false;
+  bool include_output_tensor_values_ = false;
 };
 
 // Helper function for GraphProperties.
@@ -29,11 +29,13 @@ limitations under the License.
 #include "tensorflow/core/grappler/grappler_item.h"
 #include "tensorflow/core/grappler/inputs/trivial_test_graph_input_yielder.h"
 #include "tensorflow/core/grappler/inputs/utils.h"
+#include "tensorflow/core/grappler/mutable_graph_view.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/io/path.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/protobuf.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 #ifdef INTEL_MKL
 #include "tensorflow/core/graph/mkl_graph_util.h"
 #endif
@@ -233,6 +235,85 @@ TEST_F(GraphPropertiesTest, Clear) {
   EXPECT_FALSE(properties.has_properties());
 }
 
+TEST_F(GraphPropertiesTest, UpdateStatically) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+  Output x = ops::Placeholder(s.WithOpName("x"), DT_FLOAT,
+                              ops::Placeholder::Shape({4, 8}));
+  Output c = ops::Const(s.WithOpName("c"), 1.0f, {8});
+  Output r = ops::Relu(s.WithOpName("r"), ops::Add(s.WithOpName("a"), x, c));
+  Output w = ops::Const(s.WithOpName("w"), 0.0f, {8, 2});
+  Output m = ops::MatMul(s.WithOpName("m"), r, w);
+  Output shape = ops::Shape(s.WithOpName("shape"), m);
+  Output flat = ops::Reshape(s.WithOpName("flat"), m,
+                             ops::Const(s.WithOpName("minus_one"), {-1}));
+  ops::Identity(s.WithOpName("out"), flat);
+  // Unrelated nodes, so that the edits only affect a small part of the graph.
+  for (int i = 0; i < 20; ++i) {
+    ops::Relu(s.WithOpName(strings::StrCat("unrelated_", i)), x);
+  }
+  GrapplerItem item;
+  TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+
+  GraphProperties properties(item);
+  TF_ASSERT_OK(properties.InferStatically(/*assume_valid_feeds=*/false));
+  EXPECT_EQ("float: [8]",
+            PropToString(properties.GetOutputProperties("out")[0]));
+
+  MutableGraphView graph_view(&item.graph);
+  graph_view.set_track_dirty_nodes(true);
+  // Change the shape of a constant.
+  Tensor new_w(DT_FLOAT, TensorShape({8, 3}));
+  new_w.flat<float>().setZero();
+  new_w.AsProtoTensorContent(
+      (*graph_view.GetNode("w")->mutable_attr())["value"].mutable_tensor());
+  graph_view.MarkNodeDirty("w");
+  // Add and remove nodes.
+  NodeDef extra;
+  TF_ASSERT_OK(NodeDefBuilder("extra", "Square")
+                   .Input("out", 0, DT_FLOAT)
+                   .Finalize(&extra));
+  graph_view.AddNode(std::move(extra));
+  NodeDef unused;
+  TF_ASSERT_OK(NodeDefBuilder("unused", "Neg")
+                   .Input("r", 0, DT_FLOAT)
+                   .Finalize(&unused));
+  graph_view.AddNode(std::move(unused));
+  TF_ASSERT_OK(graph_view.DeleteNodes({"unused"}));
+  TF_ASSERT_OK(properties.UpdateStatically(graph_view.dirty_nodes(),
+                                           graph_view.deleted_nodes()));
+
+  EXPECT_EQ("float: [4,3]",
+            PropToString(properties.GetOutputProperties("m")[0]));
+  const auto& shape_props = properties.GetOutputProperties("shape");
+  ASSERT_EQ(1, shape_props.size());
+  ASSERT_TRUE(shape_props[0].has_value());
+  ExpectTensorValues({4, 3}, shape_props[0].value());
+  EXPECT_EQ("float: [12]",
+            PropToString(properties.GetOutputProperties("out")[0]));
+  EXPECT_EQ("float: [12]",
+            PropToString(properties.GetOutputProperties("extra")[0]));
+  EXPECT_FALSE(properties.HasOutputProperties("unused"));
+
+  // The updated properties match the properties inferred from scratch.
+  GraphProperties expected(item);
+  TF_ASSERT_OK(expected.InferStatically(/*assume_valid_feeds=*/false));
+  for (const NodeDef& node : item.graph.node()) {
+    const auto& props = properties.GetOutputProperties(node.name());
+    const auto& expected_props = expected.GetOutputProperties(node.name());
+    ASSERT_EQ(expected_props.size(), props.size()) << node.name();
+    for (int i = 0, end = props.size(); i < end; ++i) {
+      EXPECT_EQ(PropToString(expected_props[i]), PropToString(props[i]))
+          << node.name();
+    }
+  }
+}
+
+TEST_F(GraphPropertiesTest, UpdateStaticallyRequiresInferStatically) {
+  GrapplerItem item;
+  GraphProperties properties(item);
+  EXPECT_FALSE(properties.UpdateStatically({"x"}, {}).ok());
+}
+
 TEST_F(GraphPropertiesTest, DynamicProperties) {
   TrivialTestGraphInputYielder fake_input(4, 1, 10, false,
                                           cluster_->GetDeviceNames());
@@ -2685,6 +2766,71 @@ TEST(HelperFunctions, IsShapeFullyDefinedIntegerVectorOrScalar) {
   EXPECT_FALSE(IsShapeFullyDefinedIntegerVectorOrScalar(
       &ic, fully_defined_vector, vector_with_unknown_from_const, DT_INT32));
 }
+
+// A graph of `num_nodes` AddV2 nodes in which each node adds the outputs of the
+// previous node and of the node at half its index, followed by the addition of
+// a constant.
+GraphDef MakeAddGraph(int num_nodes) {
+  GraphDef graph;
+  auto add_node = [&graph](const string& name, const string& op) {
+    NodeDef* node = graph.add_node();
+    node->set_name(name);
+    node->set_op(op);
+    (*node->mutable_attr())[op == "AddV2" ? "T" : "dtype"].set_type(DT_FLOAT);
+    return node;
+  };
+  NodeDef* x = add_node("x", "Placeholder");
+  TensorShape({32, 32}).AsProto(
+      (*x->mutable_attr())["shape"].mutable_shape());
+  for (int i = 1; i < num_nodes; ++i) {
+    NodeDef* node = add_node(strings::StrCat("add_", i), "AddV2");
+    node->add_input(i == 1 ? "x" : strings::StrCat("add_", i - 1));
+    node->add_input(i / 2 <= 1 ? "x" : strings::StrCat("add_", i / 2));
+  }
+  NodeDef* c = add_node("c", "Const");
+  test::AsTensor<float>(std::vector<float>(32 * 32, 1.0f), {32, 32})
+      .AsProtoTensorContent((*c->mutable_attr())["value"].mutable_tensor());
+  NodeDef* out = add_node("out", "AddV2");
+  out->add_input(strings::StrCat("add_", num_nodes - 1));
+  out->add_input("c");
+  return graph;
+}
+
+// Updates the properties after swapping the value of a constant, from scratch
+// or incrementally.
+void BM_GraphPropertiesUpdate(::testing::benchmark::State& state) {
+  const int num_nodes = state.range(0);
+  const bool incremental = state.range(1);
+  GrapplerItem item;
+  item.graph = MakeAddGraph(num_nodes);
+  MutableGraphView graph_view(&item.graph);
+  graph_view.set_track_dirty_nodes(true);
+  TensorProto* value =
+      (*graph_view.GetNode("c")->mutable_attr())["value"].mutable_tensor();
+  auto properties = std::make_unique<GraphProperties>(item);
+  TF_CHECK_OK(properties->InferStatically(/*assume_valid_feeds=*/false));
+
+  float c = 1.0f;
+  for (auto s : state) {
+    test::AsTensor<float>(std::vector<float>(32 * 32, ++c), {32, 32})
+        .AsProtoTensorContent(value);
+    graph_view.MarkNodeDirty("c");
+    if (incremental) {
+      TF_CHECK_OK(properties->UpdateStatically(graph_view.dirty_nodes(),
+                                               graph_view.deleted_nodes()));
+    } else {
+      properties = std::make_unique<GraphProperties>(item);
+      TF_CHECK_OK(properties->InferStatically(/*assume_valid_feeds=*/false));
+    }
+    graph_view.ClearDirtyNodes();
+  }
+}
+BENCHMARK(BM_GraphPropertiesUpdate)
+    ->ArgPair(1000, 0)
+    ->ArgPair(1000, 1)
+    ->ArgPair(100000, 0)
+    ->ArgPair(100000, 1);
+
 }  // namespace
 }  // namespace grappler
 }  // namespace tensorflow
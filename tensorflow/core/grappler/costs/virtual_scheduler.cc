@@ -272,6 +272,77 @@ Status PriorityReadyManager::SetPriority(
   return OkStatus();
 }
 
+Status MemoryAwareManager::Init(
+    const std::unordered_map<const NodeDef*, NodeState>* node_map) {
+  node_map_ = node_map;
+  nodes_.clear();
+  curr_index_ = -1;
+  return OkStatus();
+}
+
+int64_t MemoryAwareManager::MemoryDelta(const NodeDef* node) const {
+  const NodeState& node_state = node_map_->at(node);
+  int64_t delta = 0;
+  if (!IsPersistent(*node)) {
+    for (const auto& port_outputs : node_state.outputs) {
+      if (port_outputs.first >= 0 && !port_outputs.second.empty()) {
+        delta += CalculateOutputSize(node_state.output_properties,
+                                     port_outputs.first);
+      }
+    }
+  }
+  const auto& inputs = node_state.inputs;
+  for (int i = 0, end = inputs.size(); i < end; ++i) {
+    const NodeDef* input = inputs[i].first;
+    const int port = inputs[i].second;
+    if (port < 0 || IsPersistent(*input)) continue;
+    // An input consumed several times by the node is only freed once.
+    if (std::find(inputs.begin(), inputs.begin() + i, inputs[i]) !=
+        inputs.begin() + i) {
+      continue;
+    }
+    const int uses = std::count(inputs.begin(), inputs.end(), inputs[i]);
+    const NodeState& input_state = node_map_->at(input);
+    auto executed = input_state.num_outputs_executed.find(port);
+    auto outputs = input_state.outputs.find(port);
+    if (executed == input_state.num_outputs_executed.end() ||
+        outputs == input_state.outputs.end()) {
+      continue;
+    }
+    if (executed->second + uses == static_cast<int>(outputs->second.size())) {
+      delta -= CalculateOutputSize(input_state.output_properties, port);
+    }
+  }
+  return delta;
+}
+
+const NodeDef* MemoryAwareManager::GetCurrNode() {
+  CHECK(!nodes_.empty()) << "GetCurrNode(), but there's no ready node";
+  // The current node is cached until RemoveCurrNode() is called, even if nodes
+  // are added in the meantime.
+  if (curr_index_ < 0) {
+    curr_index_ = 0;
+    int64_t best_delta = MemoryDelta(nodes_[0]);
+    for (int i = 1, end = nodes_.size(); i < end; ++i) {
+      const int64_t delta = MemoryDelta(nodes_[i]);
+      if (delta < best_delta ||
+          (delta == best_delta &&
+           FirstReadyCmp(node_map_, nodes_[curr_index_], nodes_[i]))) {
+        curr_index_ = i;
+        best_delta = delta;
+      }
+    }
+  }
+  return nodes_[curr_index_];
+}
+
+void MemoryAwareManager::RemoveCurrNode() {
+  GetCurrNode();
+  nodes_[curr_index_] = nodes_.back();
+  nodes_.pop_back();
+  curr_index_ = -1;
+}
+
 CompositeNodeManager::CompositeNodeManager()
     : ReadyNodeManager(), send_manager_(), recv_manager_() {}
 
@@ -381,6 +452,8 @@ std::unique_ptr<ReadyNodeManager> ReadyNodeManagerFactory(
     return std::make_unique<FirstReadyManager>();
   } else if (ready_node_manager == "Composite") {
     return std::make_unique<CompositeNodeManager>();
+  } else if (ready_node_manager == "MemoryAware") {
+    return std::make_unique<MemoryAwareManager>();
   }
   LOG(FATAL) << "Not a valid ready node manager: " << ready_node_manager;
   return nullptr;
@@ -22,6 +22,7 @@ limitations under the License.
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include "tensorflow/core/framework/node_def.pb.h"
 #include "tensorflow/core/framework/step_stats.pb.h"
@@ -285,6 +286,34 @@ class PriorityReadyManager : public HeapReadyManager {
   std::unordered_map<string, int> node_priority_;
 };
 
+// MemoryAwareManager picks the ready node whose execution increases the memory
+// in use the least, i.e. the size of its outputs minus the size of the inputs
+// it is the last consumer of, and falls back to FirstReady behaviour for nodes
+// with the same memory delta. Since executing a node changes the memory delta
+// of the other consumers of its inputs, the ready nodes are scanned when the
+// current node is picked rather than kept in a heap.
+class MemoryAwareManager : public ReadyNodeManager {
+ public:
+  MemoryAwareManager() : ReadyNodeManager() {}
+  ~MemoryAwareManager() override {}
+  Status Init(
+      const std::unordered_map<const NodeDef*, NodeState>* node_map) override;
+  void AddNode(const NodeDef* node) override { nodes_.push_back(node); }
+  const NodeDef* GetCurrNode() override;
+  void RemoveCurrNode() override;
+  bool Empty() const override { return nodes_.empty(); }
+
+  // Returns the change of the memory in use if `node` is executed next.
+  int64_t MemoryDelta(const NodeDef* node) const;
+
+ private:
+  std::vector<const NodeDef*> nodes_;
+  // Not owned.
+  const std::unordered_map<const NodeDef*, NodeState>* node_map_ = nullptr;
+  // Index of the current node in nodes_, or -1 if it has to be picked.
+  int curr_index_ = -1;
+};
+
 // CompositeNodeManager has a few other NodeManagers: per-device LIFO for normal
 // ops (neither _Send nor _Recv) and FirstReadyManagers for _Send ops and _Recv
 // ops, and then it chooses FirstReady among the ops chosen from each
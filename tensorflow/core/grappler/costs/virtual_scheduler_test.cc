@@ -434,6 +434,71 @@ TEST_F(ReadyNodeManagerTest, GetAndRemoveMultiplePriorityReadyManager) {
   EXPECT_TRUE(manager.Empty());
 }
 
+TEST_F(ReadyNodeManagerTest, GetAndRemoveMultipleMemoryAwareManager) {
+  // Node1 and Node2 consume the 4000 bytes output of Input; Node3 has no input.
+  NodeDef input;
+  NodeSetUp("Input", kConv2D, kCPU0, 0, &input);
+  auto add_output = [this](const NodeDef* node, int64_t num_elements,
+                           std::vector<const NodeDef*> consumers) {
+    OpInfo::TensorProperties output;
+    output.set_dtype(DT_FLOAT);
+    output.mutable_shape()->add_dim()->set_size(num_elements);
+    NodeState& node_state = node_states_[node];
+    const int port = node_state.output_properties.size();
+    node_state.output_properties.push_back(output);
+    node_state.outputs[port] = std::move(consumers);
+    node_state.num_outputs_executed[port] = 0;
+  };
+  add_output(&input, 1000, {&node1_, &node2_});
+  add_output(&node1_, 100, {&node4_});
+  add_output(&node2_, 2000, {&node4_});
+  add_output(&node3_, 500, {&node4_});
+  node_states_[&node1_].inputs.push_back({&input, 0});
+  node_states_[&node2_].inputs.push_back({&input, 0});
+
+  MemoryAwareManager manager;
+  TF_EXPECT_OK(manager.Init(&node_states_));
+  manager.AddNode(&node1_);
+  manager.AddNode(&node2_);
+  manager.AddNode(&node3_);
+  EXPECT_EQ(manager.MemoryDelta(&node1_), 400);
+  EXPECT_EQ(manager.MemoryDelta(&node2_), 8000);
+  EXPECT_EQ(manager.MemoryDelta(&node3_), 2000);
+
+  EXPECT_EQ(manager.GetCurrNode()->name(), "Node1");
+  manager.RemoveCurrNode();
+  node_states_[&input].num_outputs_executed[0] = 1;
+  // Node2 now frees the output of Input, but still allocates more than Node3.
+  EXPECT_EQ(manager.MemoryDelta(&node2_), 4000);
+  EXPECT_EQ(manager.GetCurrNode()->name(), "Node3");
+  // The current node does not change when nodes are added.
+  manager.AddNode(&node5_);
+  EXPECT_EQ(manager.GetCurrNode()->name(), "Node3");
+  manager.RemoveCurrNode();
+  // Node5 allocates nothing.
+  EXPECT_EQ(manager.GetCurrNode()->name(), "Node5");
+  manager.RemoveCurrNode();
+  EXPECT_EQ(manager.GetCurrNode()->name(), "Node2");
+  manager.RemoveCurrNode();
+  EXPECT_TRUE(manager.Empty());
+}
+
+TEST_F(ReadyNodeManagerTest, MemoryAwareManagerFallsBackToFirstReady) {
+  MemoryAwareManager manager;
+  TF_EXPECT_OK(manager.Init(&node_states_));
+  manager.AddNode(&node1_);
+  manager.AddNode(&node3_);
+  manager.AddNode(&node2_);
+
+  EXPECT_EQ(manager.GetCurrNode()->name(), "Node3");
+  manager.RemoveCurrNode();
+  EXPECT_EQ(manager.GetCurrNode()->name(), "Node2");
+  manager.RemoveCurrNode();
+  EXPECT_EQ(manager.GetCurrNode()->name(), "Node1");
+  manager.RemoveCurrNode();
+  EXPECT_TRUE(manager.Empty());
+}
+
 TEST_F(ReadyNodeManagerTest, RemoveSingleNodeCompositeNodeManager) {
   CompositeNodeManager manager;
   TF_EXPECT_OK(manager.Init(&node_states_));
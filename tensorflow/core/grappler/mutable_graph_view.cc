@@ -459,6 +459,7 @@ NodeDef* MutableGraphView::AddNode(NodeDef&& node) {
   AddUniqueNodeOrDie(node_in_graph);
 
   AddAndDedupFanouts(node_in_graph);
+  MarkNodeDirtyInternal(node_in_graph);
   return node_in_graph;
 }
 
@@ -506,6 +507,7 @@ Status MutableGraphView::AddSubgraph(GraphDef&& subgraph) {
   for (int i = node_size_before; i < graph()->node_size(); ++i) {
     NodeDef* node = graph()->mutable_node(i);
     AddAndDedupFanouts(node);
+    MarkNodeDirtyInternal(node);
   }
 
   return OkStatus();
@@ -540,6 +542,7 @@ Status MutableGraphView::UpdateNode(
         "like an unlikely event and probably a mistake)");
   }
 
+  MarkNodeDirtyInternal(node);
   if (node->device() != device) {
     node->set_device(string(device));
   }
@@ -602,9 +605,12 @@ Status MutableGraphView::UpdateNodeName(absl::string_view from_node_name,
     return error_status("can't update node name because node has fanouts");
   }
 
+  if (update_fanouts) MarkFanoutsDirty(node);
+  MarkNodeDeleted(node->name());
   nodes().erase(node->name());
   node->set_name(string(to_node_name));
   nodes().emplace(node->name(), node);
+  MarkNodeDirtyInternal(node);
   return OkStatus();
 }
 
@@ -628,11 +634,17 @@ Status MutableGraphView::SwapNodeNames(absl::string_view from_node_name,
   TF_RETURN_IF_ERROR(CheckNodeExists(to_node_name, to_node, error_status));
 
   auto swap_names = [this, from_node, to_node]() {
+    // Whether or not the fanouts follow the nodes, the fanouts of both nodes
+    // now read different tensors, or the same tensors under different names.
+    MarkFanoutsDirty(from_node);
+    MarkFanoutsDirty(to_node);
     nodes().erase(from_node->name());
     nodes().erase(to_node->name());
     std::swap(*from_node->mutable_name(), *to_node->mutable_name());
     nodes().emplace(from_node->name(), from_node);
     nodes().emplace(to_node->name(), to_node);
+    MarkNodeDirtyInternal(from_node);
+    MarkNodeDirtyInternal(to_node);
   };
 
   if (update_fanouts) {
@@ -838,6 +850,7 @@ Status MutableGraphView::UpdateFanoutsInternal(NodeDef* from_node,
     input_port.node->set_input(
         input_port.port_id,
         TensorIdToString({to_node->name(), output_port.port_id}));
+    MarkNodeDirtyInternal(input_port.node);
 
     // Remove old edge between the `from_node` and the fanout node.
     remove_edge(output_port, input_port);
@@ -886,6 +899,7 @@ bool MutableGraphView::AddFaninInternal(NodeDef* node,
   input.port_id = input_is_control ? Graph::kControlSlot : num_regular_fanins;
 
   node->add_input(TensorIdToString({fanin.node->name(), fanin.port_id}));
+  MarkNodeDirtyInternal(node);
   if (!input_is_control) {
     const int last_node_input = node->input_size() - 1;
     // If there are control dependencies in node, move newly inserted fanin to
@@ -953,6 +967,7 @@ Status MutableGraphView::AddRegularFaninByPort(absl::string_view node_name,
   const int last_node_input = node->input_size();
   node->add_input(TensorIdToString(fanin));
   node->mutable_input()->SwapElements(num_regular_fanins, last_node_input);
+  MarkNodeDirtyInternal(node);
   for (int i = num_regular_fanins - 1; i >= port; --i) {
     TensorId tensor_id = ParseTensorName(node->input(i));
     OutputPort fanin_port(nodes()[tensor_id.node()], tensor_id.index());
@@ -1105,6 +1120,7 @@ bool MutableGraphView::RemoveRegularFaninInternal(NodeDef* node,
   }
 
   if (modified) {
+    MarkNodeDirtyInternal(node);
     const int last_regular_input_port = curr_pos - 1;
     if (last_regular_input_port < 0) {
       max_regular_input_port().erase(node);
@@ -1158,6 +1174,7 @@ Status MutableGraphView::RemoveRegularFaninByPort(absl::string_view node_name,
   TensorId tensor_id = ParseTensorName(node->input(port));
   OutputPort fanin_port(nodes()[tensor_id.node()], tensor_id.index());
   fanouts()[fanin_port].erase({node, port});
+  MarkNodeDirtyInternal(node);
   auto mutable_inputs = node->mutable_input();
   for (int i = port + 1; i <= last_regular_fanin_port; ++i) {
     TensorId tensor_id = ParseTensorName(node->input(i));
@@ -1195,6 +1212,7 @@ bool MutableGraphView::RemoveControllingFaninInternal(NodeDef* node,
           {node, Graph::kControlSlot});
       node->mutable_input()->SwapElements(i, node->input_size() - 1);
       node->mutable_input()->RemoveLast();
+      MarkNodeDirtyInternal(node);
       return true;
     }
   }
@@ -1239,6 +1257,7 @@ Status MutableGraphView::RemoveAllFanins(absl::string_view node_name,
   const int num_regular_fanins =
       NumFanins(*node, /*include_controlling_nodes=*/false);
   RemoveFaninsInternal(node, keep_controlling_fanins);
+  MarkNodeDirtyInternal(node);
   if (keep_controlling_fanins) {
     if (num_regular_fanins == 0) {
       return OkStatus();
@@ -1323,6 +1342,7 @@ Status MutableGraphView::UpdateFanin(absl::string_view node_name,
       fanouts()[to_fanin_port].insert(input);
 
       node->set_input(i, to_fanin_string);
+      MarkNodeDirtyInternal(node);
       modified = true;
     }
   }
@@ -1379,6 +1399,7 @@ Status MutableGraphView::UpdateRegularFaninByPort(absl::string_view node_name,
   UpdateMaxRegularOutputPortForAddedFanin(to_fanin_port);
 
   node->set_input(port, TensorIdToString(fanin));
+  MarkNodeDirtyInternal(node);
 
   if (CanDedupControlWithRegularInput(*this, *fanin_node)) {
     RemoveControllingFaninInternal(node, fanin_node);
@@ -1427,6 +1448,7 @@ Status MutableGraphView::SwapRegularFaninsByPorts(absl::string_view node_name,
   to_fanouts->insert(from_input);
 
   node->mutable_input()->SwapElements(from_port, to_port);
+  MarkNodeDirtyInternal(node);
 
   return OkStatus();
 }
@@ -1498,6 +1520,7 @@ Status MutableGraphView::UpdateAllRegularFaninsToControlling(
   // Remove duplicate controls and leftover regular fanins.
   node->mutable_input()->DeleteSubrange(pos, node->input_size() - pos);
   max_regular_input_port().erase(node);
+  MarkNodeDirtyInternal(node);
 
   return OkStatus();
 }
@@ -1578,7 +1601,9 @@ Status MutableGraphView::DeleteNodes(
     }
   }
   for (const string& node_name_to_delete : nodes_to_delete) {
-    nodes().erase(node_name_to_delete);
+    if (nodes().erase(node_name_to_delete) > 0) {
+      MarkNodeDeleted(node_name_to_delete);
+    }
   }
 
   // Find nodes in graph and delete by partitioning into nodes to retain and
@@ -1603,6 +1628,20 @@ Status MutableGraphView::DeleteNodes(
   return OkStatus();
 }
 
+void MutableGraphView::MarkFanoutsDirty(const NodeDef* node) {
+  if (!track_dirty_nodes_) return;
+  for (const InputPort& fanout :
+       GetFanouts(*node, /*include_controlled_nodes=*/true)) {
+    dirty_nodes_.insert(fanout.node->name());
+  }
+}
+
+void MutableGraphView::MarkNodeDeleted(const string& node_name) {
+  if (!track_dirty_nodes_) return;
+  dirty_nodes_.erase(node_name);
+  deleted_nodes_.insert(node_name);
+}
+
 void MutableGraphView::RemoveFaninsInternal(NodeDef* deleted_node,
                                             bool keep_controlling_fanins) {
   for (int i = 0; i < deleted_node->input_size(); ++i) {
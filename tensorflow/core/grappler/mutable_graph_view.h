@@ -248,6 +248,33 @@ class MutableGraphView : public internal::GraphViewInternal<GraphDef, NodeDef> {
   // that can't be found are ignored.
   Status DeleteNodes(const absl::flat_hash_set<string>& nodes_to_delete);
 
+  // Dirty node tracking, for incremental re-optimization after small edits of
+  // an already optimized graph. While tracking is enabled, the view records
+  // the names of the nodes it adds, renames or modifies (including the nodes
+  // whose fanins are updated as a side effect, e.g. the fanouts of a node
+  // passed to UpdateFanouts), and the names of the nodes it deletes or
+  // renames away. These can be passed to GraphProperties::UpdateStatically
+  // and to the optimizers supporting GraphOptimizer::set_nodes_to_revisit.
+  // Nodes modified directly through their NodeDef must be marked with
+  // MarkNodeDirty.
+  void set_track_dirty_nodes(bool track_dirty_nodes) {
+    track_dirty_nodes_ = track_dirty_nodes;
+  }
+  bool track_dirty_nodes() const { return track_dirty_nodes_; }
+  void MarkNodeDirty(absl::string_view node_name) {
+    if (track_dirty_nodes_) dirty_nodes_.insert(string(node_name));
+  }
+  const absl::flat_hash_set<string>& dirty_nodes() const {
+    return dirty_nodes_;
+  }
+  const absl::flat_hash_set<string>& deleted_nodes() const {
+    return deleted_nodes_;
+  }
+  void ClearDirtyNodes() {
+    dirty_nodes_.clear();
+    deleted_nodes_.clear();
+  }
+
  private:
   // Adds fanouts for fanins of node to graph, while deduping control
   // dependencies from existing control dependencies and regular fanins. Note,
@@ -323,6 +350,21 @@ class MutableGraphView : public internal::GraphViewInternal<GraphDef, NodeDef> {
 
   // Removes fanouts of the deleted node from internal state.
   void RemoveFanoutsInternal(NodeDef* deleted_node);
+
+  // Records `node` (or all the nodes in the fanout of `node`, including the
+  // controlled nodes) as dirty if dirty node tracking is enabled.
+  void MarkNodeDirtyInternal(const NodeDef* node) {
+    if (track_dirty_nodes_) dirty_nodes_.insert(node->name());
+  }
+  void MarkFanoutsDirty(const NodeDef* node);
+
+  // Records that the node named `node_name` was removed from the graph if dirty
+  // node tracking is enabled.
+  void MarkNodeDeleted(const string& node_name);
+
+  bool track_dirty_nodes_ = false;
+  absl::flat_hash_set<string> dirty_nodes_;
+  absl::flat_hash_set<string> deleted_nodes_;
 };
 
 }  // end namespace grappler
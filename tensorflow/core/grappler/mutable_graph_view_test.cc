@@ -2996,6 +2996,44 @@ TEST(MutableGraphViewTest, DeleteNodesWithLargeError) {
   CheckGraph(graph);
 }
 
+TEST(MutableGraphViewTest, TrackDirtyNodes) {
+  GraphDef graph_def = test::function::GDef(
+      {NDef("a", "NotImportant", {}, {}), NDef("b", "NotImportant", {}, {}),
+       NDef("c", "NotImportant", {"a", "b"}),
+       NDef("d", "NotImportant", {"c", "^a"}),
+       NDef("e", "NotImportant", {"c:1"}), NDef("f", "NotImportant", {"d"})},
+      /*funcs=*/{});
+  MutableGraphView graph(&graph_def);
+
+  // Nothing is recorded until tracking is enabled.
+  TF_EXPECT_OK(graph.UpdateRegularFaninByPort("c", 1, {"a", 1}));
+  graph.MarkNodeDirty("a");
+  EXPECT_TRUE(graph.dirty_nodes().empty());
+
+  graph.set_track_dirty_nodes(true);
+  TF_EXPECT_OK(graph.UpdateRegularFaninByPort("c", 1, {"b", 0}));
+  EXPECT_THAT(graph.dirty_nodes(), ::testing::UnorderedElementsAre("c"));
+
+  // The fanouts of the updated node are dirty.
+  graph.AddNode(NDef("new_c", "NotImportant", {"a", "b"}));
+  TF_EXPECT_OK(graph.UpdateFanouts("c", "new_c"));
+  EXPECT_THAT(graph.dirty_nodes(),
+              ::testing::UnorderedElementsAre("c", "new_c", "d", "e"));
+
+  graph.ClearDirtyNodes();
+  TF_EXPECT_OK(graph.DeleteNodes({"c"}));
+  TF_EXPECT_OK(graph.UpdateNodeName("f", "g", /*update_fanouts=*/false));
+  graph.MarkNodeDirty("b");
+  EXPECT_THAT(graph.dirty_nodes(), ::testing::UnorderedElementsAre("g", "b"));
+  EXPECT_THAT(graph.deleted_nodes(), ::testing::UnorderedElementsAre("c", "f"));
+
+  TF_EXPECT_OK(graph.SwapNodeNames("a", "b", /*update_fanouts=*/true));
+  EXPECT_THAT(graph.dirty_nodes(),
+              ::testing::UnorderedElementsAre("a", "b", "g", "new_c", "d"));
+
+  CheckGraph(graph);
+}
+
 }  // namespace
 }  // namespace grappler
 }  // namespace tensorflow
@@ -4290,8 +4290,31 @@ class RemoveCastIntoSegmentReductionStage : public ArithmeticOptimizerStage {
 Status ArithmeticOptimizer::SimplifyArithmeticOps(bool can_use_shapes) {
   SetVector<NodeDef*> nodes_to_simplify;
   nodes_to_simplify.Reserve(optimized_graph_->node_size());
-  for (int i = 0; i < optimized_graph_->node_size(); ++i) {
-    nodes_to_simplify.PushBack(optimized_graph_->mutable_node(i));
+  if (nodes_to_revisit().has_value()) {
+    // Only the nodes to revisit, and their fanins and fanouts whose
+    // neighborhood changed, can be simplified further.
+    absl::flat_hash_set<string> seeds;
+    for (const string& node_name : *nodes_to_revisit()) {
+      if (node_map_->GetNode(node_name) == nullptr) continue;
+      seeds.insert(node_name);
+      for (const NodeDef* fanout : node_map_->GetOutputs(node_name)) {
+        seeds.insert(fanout->name());
+      }
+      for (const string& input : node_map_->GetNode(node_name)->input()) {
+        seeds.insert(NodeName(input));
+      }
+    }
+    for (int i = 0; i < optimized_graph_->node_size(); ++i) {
+      if (seeds.contains(optimized_graph_->node(i).name())) {
+        nodes_to_simplify.PushBack(optimized_graph_->mutable_node(i));
+      }
+    }
+    VLOG(1) << "Revisiting " << seeds.size() << " of "
+            << optimized_graph_->node_size() << " nodes.";
+  } else {
+    for (int i = 0; i < optimized_graph_->node_size(); ++i) {
+      nodes_to_simplify.PushBack(optimized_graph_->mutable_node(i));
+    }
   }
 
   const GraphOptimizerContext ctx(&nodes_to_preserve_, optimized_graph_,
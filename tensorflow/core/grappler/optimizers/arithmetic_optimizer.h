@@ -47,6 +47,9 @@ class ArithmeticOptimizer : public GraphOptimizer {
 
   bool UsesFunctionLibrary() const override { return false; }
 
+  // The rewrites only look at a node and its direct fanins and fanouts.
+  bool SupportsIncrementalOptimization() const override { return true; }
+
   Status Optimize(Cluster* cluster, const GrapplerItem& item,
                   GraphDef* optimized_graph) override;
 
@@ -610,6 +610,48 @@ TEST_F(ArithmeticOptimizerTest, RemoveInvolutionAdjacentNodes) {
   test::ExpectTensorNear<float>(tensors[0], tensors_expected[0], 1e-6);
 }
 
+TEST_F(ArithmeticOptimizerTest, RevisitOnlyGivenNodes) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+  auto c = ops::Const(s.WithOpName("c"), {1.0f, 2.0f}, {1, 2});
+  auto neg_a1 = ops::Neg(s.WithOpName("neg_a1"), c);
+  auto neg_a2 = ops::Neg(s.WithOpName("neg_a2"), neg_a1);
+  auto id_a = ops::Identity(s.WithOpName("id_a"), neg_a2);
+  auto neg_b1 = ops::Neg(s.WithOpName("neg_b1"), c);
+  auto neg_b2 = ops::Neg(s.WithOpName("neg_b2"), neg_b1);
+  auto id_b = ops::Identity(s.WithOpName("id_b"), neg_b2);
+
+  GrapplerItem item;
+  item.fetch = {"id_a", "id_b"};
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+
+  GraphDef output;
+  ArithmeticOptimizer optimizer;
+  EnableOnlyRemoveInvolution(&optimizer);
+  ASSERT_TRUE(optimizer.SupportsIncrementalOptimization());
+  // E.g. neg_b1 was just added and neg_b2 updated to read it.
+  optimizer.set_nodes_to_revisit({"neg_b1"});
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  NodeMap node_map(&output);
+  const NodeDef* id_a_node = node_map.GetNode("id_a");
+  ASSERT_NE(id_a_node, nullptr);
+  ASSERT_EQ(id_a_node->input_size(), 1);
+  EXPECT_EQ(id_a_node->input(0), "neg_a2");
+  const NodeDef* id_b_node = node_map.GetNode("id_b");
+  ASSERT_NE(id_b_node, nullptr);
+  ASSERT_EQ(id_b_node->input_size(), 1);
+  EXPECT_EQ(id_b_node->input(0), "c");
+
+  optimizer.clear_nodes_to_revisit();
+  item.graph.Swap(&output);
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+  NodeMap full_node_map(&output);
+  id_a_node = full_node_map.GetNode("id_a");
+  ASSERT_NE(id_a_node, nullptr);
+  EXPECT_EQ(id_a_node->input(0), "c");
+}
+
 TEST_F(ArithmeticOptimizerTest, RemoveInvolutionAroundValuePreservingChain) {
   tensorflow::Scope s = tensorflow::Scope::NewRootScope();
 
@@ -16,8 +16,11 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_GRAPH_OPTIMIZER_H_
 #define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_GRAPH_OPTIMIZER_H_
 
+#include <optional>
 #include <string>
+#include <utility>
 
+#include "absl/container/flat_hash_set.h"
 #include "absl/status/status.h"
 #include "tensorflow/core/framework/graph.pb.h"
 #include "tensorflow/core/platform/env.h"
@@ -75,8 +78,24 @@ class GraphOptimizer {
     return deadline_usec_ > 0 && Env::Default()->NowMicros() > deadline_usec_;
   }
 
+  // Returns true if the optimizer honors set_nodes_to_revisit.
+  virtual bool SupportsIncrementalOptimization() const { return false; }
+
+  // Restricts the next calls to Optimize to the given nodes and their
+  // neighborhood, e.g. the dirty nodes recorded by a MutableGraphView after a
+  // small edit of a graph that this optimizer already optimized. Optimizers
+  // that don't SupportsIncrementalOptimization process the whole graph.
+  void set_nodes_to_revisit(absl::flat_hash_set<string> nodes_to_revisit) {
+    nodes_to_revisit_ = std::move(nodes_to_revisit);
+  }
+  void clear_nodes_to_revisit() { nodes_to_revisit_.reset(); }
+  const std::optional<absl::flat_hash_set<string>>& nodes_to_revisit() const {
+    return nodes_to_revisit_;
+  }
+
  private:
   uint64 deadline_usec_;
+  std::optional<absl::flat_hash_set<string>> nodes_to_revisit_;
 };
 
 #define GRAPPLER_RETURN_IF_DEADLINE_EXCEEDED()                \
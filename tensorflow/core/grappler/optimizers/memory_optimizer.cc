@@ -16,10 +16,12 @@ limitations under the License.
 #include "tensorflow/core/grappler/optimizers/memory_optimizer.h"
 
 #include <algorithm>
+#include <memory>
 #include <queue>
 #include <set>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "tensorflow/core/framework/attr_value.pb.h"
@@ -28,9 +30,12 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.pb.h"  // NOLINT
 #include "tensorflow/core/framework/tensor_shape.pb.h"
 #include "tensorflow/core/grappler/clusters/virtual_cluster.h"
+#include "tensorflow/core/grappler/costs/analytical_cost_estimator.h"
 #include "tensorflow/core/grappler/costs/graph_memory.h"
 #include "tensorflow/core/grappler/costs/graph_properties.h"
+#include "tensorflow/core/grappler/costs/op_level_cost_estimator.h"
 #include "tensorflow/core/grappler/costs/utils.h"
+#include "tensorflow/core/grappler/costs/virtual_scheduler.h"
 #include "tensorflow/core/grappler/graph_topology_view.h"
 #include "tensorflow/core/grappler/grappler_item.h"
 #include "tensorflow/core/grappler/mutable_graph_view.h"
@@ -40,6 +45,7 @@ limitations under the License.
 #include "tensorflow/core/grappler/utils/topological_sort.h"
 #include "tensorflow/core/grappler/utils/traversal.h"
 #include "tensorflow/core/lib/math/math_util.h"
+#include "tensorflow/core/lib/strings/numbers.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/protobuf/rewriter_config.pb.h"
 #include "tensorflow/core/util/device_name_utils.h"
@@ -740,6 +746,179 @@ bool SchedulingPass(Cluster* cluster, std::unique_ptr<GraphMemory>* memory_ptr,
   return updated_graph;
 }
 
+// Tensors smaller than this fraction of the peak memory usage of their device
+// do not constrain the order of execution of the graph.
+constexpr double kMinOrderedTensorFraction = 0.01;
+
+// Simulates the execution of the graph with a MemoryAwareManager, which
+// greedily runs the ready node that increases the memory in use the least, and
+// enforces the resulting order of the large allocations of each device with
+// control dependencies: before allocating a large tensor, a node waits for the
+// previous large allocation on its device and for the nodes that released a
+// large tensor since then. Small nodes remain free to run in parallel. The
+// control dependencies are kept only if the peak memory usage of the devices,
+// as estimated by GraphMemory, decreases.
+bool MemoryAwareOrderingPass(Cluster* cluster,
+                             std::unique_ptr<GraphMemory>* memory_ptr,
+                             GrapplerItem* item) {
+  // Control dependencies can't cross frames, and would propagate the deadness
+  // of untaken branches.
+  for (const NodeDef& node : item->graph.node()) {
+    if (IsControlFlow(node) || IsSwitch(node)) {
+      return false;
+    }
+  }
+
+  if ((*memory_ptr) == nullptr) {
+    memory_ptr->reset(new GraphMemory(*item));
+    Status s = (*memory_ptr)->InferStatically(cluster->GetDevices());
+    if (!s.ok()) {
+      memory_ptr->reset();
+      VLOG(1) << "Failed to infer memory usage: " << s.message();
+      return false;
+    }
+  }
+
+  AnalyticalCostEstimator estimator(
+      cluster, std::make_unique<OpLevelCostEstimator>(),
+      std::make_unique<MemoryAwareManager>(), /*use_static_shapes=*/true,
+      /*use_aggressive_shape_inference=*/false);
+  Status s = estimator.Initialize(*item);
+  if (s.ok()) {
+    s = estimator.PredictCosts(item->graph, /*run_metadata=*/nullptr,
+                               /*cost=*/nullptr);
+  }
+  if (!s.ok()) {
+    VLOG(1) << "Failed to simulate the memory-aware schedule: " << s.message();
+    return false;
+  }
+  const VirtualScheduler* scheduler = estimator.GetScheduler();
+  const std::unordered_map<const NodeDef*, NodeState>& node_states =
+      *scheduler->GetNodeStates();
+
+  const std::unordered_set<string> feeds = [&item]() {
+    std::unordered_set<string> feeds;
+    for (const auto& feed : item->feed) feeds.insert(NodeName(feed.first));
+    return feeds;
+  }();
+  NodeMap node_map(&item->graph);
+  // The original number of inputs of the nodes that got control dependencies.
+  std::vector<std::pair<NodeDef*, int>> original_input_sizes;
+  std::vector<string> ordered_devices;
+
+  for (const auto& device : *scheduler->GetDeviceStates()) {
+    const DeviceState& device_state = device.second;
+    // The scheduler also executes the _Send and _Recv nodes it creates.
+    std::vector<NodeDef*> order;
+    std::unordered_map<const NodeDef*, int> position;
+    for (const NodeDef* node : device_state.nodes_executed) {
+      NodeDef* graph_node = node_map.GetNode(node->name());
+      if (graph_node == node) {
+        position[node] = order.size();
+        order.push_back(graph_node);
+      }
+    }
+    const int64_t min_bytes = std::max<int64_t>(
+        1, static_cast<int64_t>(device_state.max_memory_usage *
+                                kMinOrderedTensorFraction));
+
+    // Finds the nodes allocating a large tensor, and the last consumer of each
+    // large tensor, which releases it.
+    std::unordered_set<const NodeDef*> allocates;
+    std::unordered_set<const NodeDef*> releases;
+    for (const NodeDef* node : order) {
+      if (IsPersistent(*node)) continue;
+      const NodeState& node_state = node_states.at(node);
+      for (const auto& port_outputs : node_state.outputs) {
+        if (port_outputs.first < 0 || port_outputs.second.empty() ||
+            CalculateOutputSize(node_state.output_properties,
+                                port_outputs.first) < min_bytes) {
+          continue;
+        }
+        if (feeds.find(node->name()) == feeds.end()) allocates.insert(node);
+        int last_consumer = -1;
+        for (const NodeDef* consumer : port_outputs.second) {
+          auto it = position.find(consumer);
+          if (it == position.end()) {
+            // Released by another device.
+            last_consumer = -1;
+            break;
+          }
+          last_consumer = std::max(last_consumer, it->second);
+        }
+        if (last_consumer >= 0) releases.insert(order[last_consumer]);
+      }
+    }
+
+    NodeDef* last_allocation = nullptr;
+    std::vector<NodeDef*> releases_since_last_allocation;
+    bool ordered = false;
+    for (NodeDef* node : order) {
+      if (allocates.count(node) > 0) {
+        std::unordered_set<string> inputs;
+        for (const string& input : node->input()) {
+          inputs.insert(NodeName(input));
+        }
+        std::vector<NodeDef*> dependencies = releases_since_last_allocation;
+        if (last_allocation != nullptr) {
+          dependencies.push_back(last_allocation);
+        }
+        const int input_size = node->input_size();
+        for (const NodeDef* dependency : dependencies) {
+          if (inputs.insert(dependency->name()).second) {
+            node->add_input(AsControlDependency(dependency->name()));
+          }
+        }
+        if (node->input_size() > input_size) {
+          original_input_sizes.emplace_back(node, input_size);
+          ordered = true;
+        }
+        last_allocation = node;
+        releases_since_last_allocation.clear();
+      }
+      if (releases.count(node) > 0) {
+        releases_since_last_allocation.push_back(node);
+      }
+    }
+    if (ordered) ordered_devices.push_back(device.first);
+  }
+
+  if (original_input_sizes.empty()) {
+    return false;
+  }
+
+  auto new_memory = std::make_unique<GraphMemory>(*item);
+  s = new_memory->InferStatically(cluster->GetDevices());
+  bool reduced = false;
+  bool increased = !s.ok();
+  for (const string& device : ordered_devices) {
+    if (increased) break;
+    const int64_t before =
+        (*memory_ptr)->GetPeakMemoryUsage(device).used_memory;
+    const int64_t after = new_memory->GetPeakMemoryUsage(device).used_memory;
+    if (before < 0 || after < 0 || after > before) {
+      increased = true;
+    } else if (after < before) {
+      reduced = true;
+      VLOG(1) << "Memory-aware ordering reduces the peak memory usage of "
+              << device << " from " << strings::HumanReadableNumBytes(before)
+              << " to " << strings::HumanReadableNumBytes(after);
+    }
+  }
+  if (increased || !reduced) {
+    VLOG(1) << "Memory-aware ordering does not reduce the peak memory usage";
+    for (const auto& node_input_size : original_input_sizes) {
+      NodeDef* node = node_input_size.first;
+      node->mutable_input()->DeleteSubrange(
+          node_input_size.second,
+          node->input_size() - node_input_size.second);
+    }
+    return false;
+  }
+  *memory_ptr = std::move(new_memory);
+  return true;
+}
+
 Status BuildSwapPair(NodeDef* node, int input_to_swap,
                      const std::unordered_map<string, const NodeDef*>& name_map,
                      GraphDef* graph,
@@ -1407,6 +1586,13 @@ Status MemoryOptimizer::Optimize(Cluster* cluster, const GrapplerItem& item,
   // infer the memory usage, so skip optimization if there are no fetches.
   std::unique_ptr<GraphMemory> memory;
   if (!item.fetch.empty() && cluster != nullptr) {
+    // The ordering pass keeps `memory` up to date with the graph.
+    if (optimization_level_ == RewriterConfig::SCHEDULING_HEURISTICS ||
+        optimization_level_ == RewriterConfig::HEURISTICS) {
+      GRAPPLER_RETURN_IF_DEADLINE_EXCEEDED();
+      MemoryAwareOrderingPass(cluster, &memory, &optimized_item);
+    }
+
     bool updated_graph = true;
     for (int i = 0; i < 25 && updated_graph; ++i) {
       GRAPPLER_RETURN_IF_DEADLINE_EXCEEDED();
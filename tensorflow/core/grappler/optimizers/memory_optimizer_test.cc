@@ -20,12 +20,15 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#include "absl/algorithm/container.h"
+#include "absl/strings/str_cat.h"
 #include "tensorflow/cc/ops/standard_ops.h"
 #include "tensorflow/core/framework/graph.pb.h"
 #include "tensorflow/core/framework/node_def.pb.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/grappler/clusters/virtual_cluster.h"
+#include "tensorflow/core/grappler/costs/graph_memory.h"
 #include "tensorflow/core/grappler/grappler_item.h"
 #include "tensorflow/core/grappler/utils.h"
 #include "tensorflow/core/grappler/utils/grappler_test.h"
@@ -448,6 +451,49 @@ TEST_F(MemoryOptimizerTest, AccumulationRewrites) {
   }
 }
 
+TEST_F(MemoryOptimizerTest, MemoryAwareOrdering) {
+  // Four independent chains, each of which allocates a large tensor and
+  // reduces it to a scalar. Running the chains one after the other only keeps
+  // one large tensor in memory at a time.
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope().WithDevice("/cpu:0");
+  std::vector<Output> sums;
+  for (int i = 0; i < 4; ++i) {
+    Output a = ops::RandomNormal(s.WithOpName(absl::StrCat("a", i)),
+                                 {128, 128, 4}, DT_FLOAT);
+    sums.push_back(ops::Sum(s.WithOpName(absl::StrCat("b", i)), a, {0, 1, 2}));
+  }
+  Output sum = ops::AddN(s.WithOpName("sum"), sums);
+
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  item.fetch = {"sum"};
+
+  std::unique_ptr<VirtualCluster> cluster(CreateVirtualCluster());
+  MemoryOptimizer optimizer(RewriterConfig::SCHEDULING_HEURISTICS);
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(cluster.get(), item, &output));
+
+  NodeMap node_map(&output);
+  for (int i = 1; i < 4; ++i) {
+    const NodeDef* a = node_map.GetNode(absl::StrCat("a", i));
+    ASSERT_NE(a, nullptr);
+    EXPECT_TRUE(absl::c_linear_search(a->input(),
+                                      absl::StrCat("^b", i - 1)))
+        << a->DebugString();
+  }
+
+  GraphMemory memory_before(item);
+  TF_ASSERT_OK(memory_before.InferStatically(cluster->GetDevices()));
+  GrapplerItem optimized_item = item.WithGraph(std::move(output));
+  GraphMemory memory_after(optimized_item);
+  TF_ASSERT_OK(memory_after.InferStatically(cluster->GetDevices()));
+  EXPECT_LT(memory_after.GetWorstCaseMemoryUsage(),
+            memory_before.GetWorstCaseMemoryUsage());
+
+  auto tensors = EvaluateNodes(optimized_item.graph, item.fetch, {});
+  EXPECT_EQ(1, tensors.size());
+}
+
 class RelaxAllocatorConstraintsTest : public GrapplerTest {};
 
 TEST_F(RelaxAllocatorConstraintsTest, SameDevice) {
@@ -21,6 +21,7 @@ limitations under the License.
 #include <type_traits>
 #include <utility>
 
+#include "absl/algorithm/container.h"
 #include "absl/status/status.h"
 #include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
@@ -50,6 +51,7 @@ limitations under the License.
 #include "tensorflow/core/grappler/optimizers/loop_optimizer.h"
 #include "tensorflow/core/grappler/optimizers/memory_optimizer.h"
 #include "tensorflow/core/grappler/optimizers/model_pruner.h"
+#include "tensorflow/core/grappler/optimizers/optimized_graph_cache.h"
 #include "tensorflow/core/grappler/optimizers/pin_to_host_optimizer.h"
 #include "tensorflow/core/grappler/optimizers/remapper.h"
 #include "tensorflow/core/grappler/optimizers/scoped_allocator_optimizer.h"
@@ -1074,6 +1076,20 @@ Status MetaOptimizer::OptimizeConsumeItem(Cluster* cluster, GrapplerItem&& item,
       "Deleted $0 unreachable functions from the graph (library size = $1)",
       old_library_size - new_library_size, new_library_size);
 
+  // Reuse the result of an identical optimization, possibly by another
+  // process.
+  OptimizedGraphCache* cache = OptimizedGraphCache::Global();
+  string cache_key;
+  if (cache != nullptr) {
+    cache_key = OptimizedGraphCache::Key(item, config_proto_, cluster,
+                                         cpu_device_ != nullptr);
+    if (cache->Lookup(cache_key, optimized_graph)) {
+      VLOG(1) << "Reused cached optimized graph for grappler item: "
+              << item.id;
+      return OkStatus();
+    }
+  }
+
   // Save a few small fields from item before we move it.
   bool optimize_function_library =
       item.optimization_options().optimize_function_library;
@@ -1301,6 +1317,22 @@ Status MetaOptimizer::OptimizeConsumeItem(Cluster* cluster, GrapplerItem&& item,
   }
 #endif
 
+  // Results of optimizers which failed, e.g. because they ran out of time,
+  // are not worth reusing.
+  const bool optimizers_failed = absl::c_any_of(
+      optimization_results_, [](const GraphOptimizationResult& graph_result) {
+        return absl::c_any_of(graph_result.results,
+                              [](const OptimizerResult& result) {
+                                return !result.status.ok();
+                              });
+      });
+  if (cache != nullptr && !optimizers_failed) {
+    Status s = cache->Insert(cache_key, *optimized_graph);
+    if (!s.ok()) {
+      LOG(WARNING) << "Failed to cache optimized graph: " << s;
+    }
+  }
+
   VLOG(1) << "Optimized " << optimized_funcs.size()
           << " functions: " << absl::StrJoin(optimized_funcs, ", ");
   VLOG(3) << "Optimized graph =\n" << optimized_graph->DebugString();
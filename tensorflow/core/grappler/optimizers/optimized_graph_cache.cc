@@ -0,0 +1,325 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/optimized_graph_cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "absl/algorithm/container.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/grappler/optimizers/custom_graph_optimizer.h"
+#include "tensorflow/core/grappler/optimizers/custom_graph_optimizer_registry.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
+#include "tensorflow/core/platform/coding.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/path.h"
+#include "tensorflow/core/platform/random.h"
+#include "tensorflow/core/platform/raw_coding.h"
+#include "tensorflow/core/public/version.h"
+#include "tensorflow/core/util/device_name_utils.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+// Changing the format of the key or of the entries requires a new version.
+constexpr char kFormatVersion[] = "optimized_graph_cache_v2";
+constexpr char kEntrySuffix[] = ".graph";
+// Appended to the path of an entry for an empty file rewritten on each hit,
+// whose modification time is the time of the last use of the entry.
+constexpr char kLastUseSuffix[] = ".used";
+constexpr char kTempInfix[] = ".tmp.";
+// Temporary files older than this were left by a crashed process.
+constexpr int64_t kTempFileMaxAgeNsec = 3600LL * 1000 * 1000 * 1000;
+// An entry is the fingerprint of the serialized graph followed by the graph.
+constexpr size_t kChecksumBytes = sizeof(uint64_t);
+
+// Combines `fp` with the fingerprint of `s`.
+void Combine(absl::string_view s, Fprint128* fp) {
+  *fp = FingerprintCat128(*fp, Fingerprint128(s));
+}
+
+void CombineProto(const protobuf::MessageLite& proto, Fprint128* fp) {
+  string serialized;
+  SerializeToStringDeterministic(proto, &serialized);
+  Combine(serialized, fp);
+}
+
+template <typename Container>
+void CombineSorted(const Container& strings, Fprint128* fp) {
+  std::vector<string> sorted(strings.begin(), strings.end());
+  std::sort(sorted.begin(), sorted.end());
+  Combine(absl::StrCat(sorted.size()), fp);
+  for (const string& s : sorted) Combine(s, fp);
+}
+
+// Returns the identity of the optimizers which the MetaOptimizer may run
+// besides the built-in ones: the registered custom optimizers, and the plugin
+// optimizers of the device types of `item` and `cluster` with their configs.
+std::vector<string> ExternalOptimizers(const GrapplerItem& item,
+                                       const RewriterConfig& cfg,
+                                       const Cluster* cluster) {
+  std::vector<string> optimizers;
+  for (const string& name :
+       CustomGraphOptimizerRegistry::GetRegisteredOptimizers()) {
+    optimizers.push_back(absl::StrCat("custom:", name));
+  }
+  if (cfg.use_plugin_optimizers() == RewriterConfig::OFF) return optimizers;
+
+  std::set<string> device_types;
+  for (const NodeDef& node : item.graph.node()) {
+    DeviceNameUtils::ParsedName parsed_name;
+    if (DeviceNameUtils::ParseFullName(node.device(), &parsed_name) &&
+        parsed_name.has_type) {
+      device_types.insert(parsed_name.type);
+    }
+  }
+  if (cluster != nullptr) {
+    for (const auto& device : cluster->GetDevices()) {
+      device_types.insert(device.second.type());
+    }
+  }
+  for (const auto& optimizer :
+       PluginGraphOptimizerRegistry::CreateOptimizers(device_types)) {
+    optimizers.push_back(absl::StrCat("plugin:", optimizer->name()));
+  }
+  const ConfigList plugin_configs =
+      PluginGraphOptimizerRegistry::GetPluginConfigs(
+          /*use_plugin_optimizers=*/true, device_types);
+  optimizers.push_back(absl::StrCat("plugin_disable_model_pruning:",
+                                    plugin_configs.disable_model_pruning));
+  for (const auto& toggle : plugin_configs.toggle_config) {
+    optimizers.push_back(
+        absl::StrCat("plugin_toggle:", toggle.first, "=", toggle.second));
+  }
+  return optimizers;
+}
+
+}  // namespace
+
+OptimizedGraphCache* OptimizedGraphCache::Global() {
+  static OptimizedGraphCache* cache = []() -> OptimizedGraphCache* {
+    string dir;
+    TF_CHECK_OK(ReadStringFromEnvVar("TF_GRAPPLER_OPTIMIZED_GRAPH_CACHE_DIR",
+                                     "", &dir));
+    if (dir.empty()) return nullptr;
+    int64_t max_mb;
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_GRAPPLER_OPTIMIZED_GRAPH_CACHE_MAX_MB",
+                                    1024, &max_mb));
+    VLOG(1) << "Caching optimized graphs in " << dir << ", up to " << max_mb
+            << "MB";
+    return new OptimizedGraphCache(Env::Default(), dir, max_mb << 20);
+  }();
+  return cache;
+}
+
+OptimizedGraphCache::OptimizedGraphCache(Env* env, const string& dir,
+                                         int64_t max_bytes)
+    : env_(env), dir_(dir), max_bytes_(max_bytes) {}
+
+string OptimizedGraphCache::Key(const GrapplerItem& item,
+                                const ConfigProto& config_proto,
+                                const Cluster* cluster, bool has_cpu_device) {
+  Fprint128 fp = Fingerprint128(kFormatVersion);
+  Combine(absl::StrCat(TF_VERSION_STRING, "/", TF_GRAPH_DEF_VERSION), &fp);
+
+  // The built-in optimizers read the graph options (the rewriter config and
+  // the JIT level) and the experimental options (the executor type and TFRT),
+  // but custom and plugin optimizers are initialized with the whole config.
+  const RewriterConfig& cfg = config_proto.graph_options().rewrite_options();
+  const std::vector<string> external_optimizers =
+      ExternalOptimizers(item, cfg, cluster);
+  CombineSorted(external_optimizers, &fp);
+  const bool may_run_external_optimizers =
+      !cfg.custom_optimizers().empty() || !cfg.optimizers().empty() ||
+      absl::c_any_of(external_optimizers, [](const string& optimizer) {
+        return absl::StartsWith(optimizer, "plugin:");
+      });
+  if (may_run_external_optimizers) {
+    CombineProto(config_proto, &fp);
+  } else {
+    CombineProto(config_proto.graph_options(), &fp);
+    CombineProto(config_proto.experimental(), &fp);
+  }
+  CombineProto(item.graph, &fp);
+
+  Combine(absl::StrCat(item.feed.size()), &fp);
+  for (const auto& feed : item.feed) {
+    Combine(absl::StrCat(feed.first, ":", DataTypeString(feed.second.dtype()),
+                         feed.second.shape().DebugString()),
+            &fp);
+  }
+  Combine(absl::StrCat(item.fetch.size()), &fp);
+  for (const string& fetch : item.fetch) Combine(fetch, &fp);
+  CombineSorted(item.init_ops, &fp);
+  CombineSorted(item.keep_ops, &fp);
+  Combine(absl::StrCat(item.save_op, ";", item.restore_op, ";",
+                       item.save_restore_loc_tensor),
+          &fp);
+  for (const QueueRunnerDef& queue_runner : item.queue_runners) {
+    CombineProto(queue_runner, &fp);
+  }
+  CombineSorted(item.devices(), &fp);
+
+  const GrapplerItem::OptimizationOptions& options =
+      item.optimization_options();
+  Combine(absl::StrCat(options.allow_non_differentiable_rewrites, ",",
+                       options.allow_pruning_stateful_and_dataset_ops, ",",
+                       options.optimize_function_library, ",",
+                       options.is_eager_mode, ",",
+                       options.intra_op_parallelism_threads, ",",
+                       has_cpu_device),
+          &fp);
+
+  if (cluster != nullptr) {
+    const auto& devices = cluster->GetDevices();
+    std::map<string, const DeviceProperties*> sorted_devices;
+    for (const auto& device : devices) {
+      sorted_devices.emplace(device.first, &device.second);
+    }
+    Combine(absl::StrCat(sorted_devices.size()), &fp);
+    for (const auto& device : sorted_devices) {
+      Combine(device.first, &fp);
+      CombineProto(*device.second, &fp);
+    }
+  }
+  return absl::StrCat(absl::Hex(fp.high64, absl::kZeroPad16),
+                      absl::Hex(fp.low64, absl::kZeroPad16));
+}
+
+string OptimizedGraphCache::EntryPath(const string& key) const {
+  return io::JoinPath(dir_, absl::StrCat(key, kEntrySuffix));
+}
+
+bool OptimizedGraphCache::Lookup(const string& key, GraphDef* optimized_graph) {
+  const string path = EntryPath(key);
+  string contents;
+  if (!ReadFileToString(env_, path, &contents).ok()) {
+    VLOG(2) << "Optimized graph cache miss: " << key;
+    return false;
+  }
+  absl::string_view graph(contents);
+  bool valid = graph.size() >= kChecksumBytes;
+  if (valid) {
+    graph.remove_prefix(kChecksumBytes);
+    valid = core::DecodeFixed64(contents.data()) == Fingerprint64(graph) &&
+            optimized_graph->ParseFromArray(graph.data(), graph.size());
+  }
+  if (!valid) {
+    LOG(WARNING) << "Deleting corrupt optimized graph cache entry " << path;
+    env_->DeleteFile(path).IgnoreError();
+    optimized_graph->Clear();
+    return false;
+  }
+  VLOG(1) << "Optimized graph cache hit: " << key;
+  WriteStringToFile(env_, absl::StrCat(path, kLastUseSuffix), "")
+      .IgnoreError();
+  return true;
+}
+
+Status OptimizedGraphCache::Insert(const string& key,
+                                   const GraphDef& optimized_graph) {
+  string graph;
+  if (!SerializeToStringDeterministic(optimized_graph, &graph)) {
+    return errors::Internal("Failed to serialize optimized graph.");
+  }
+  string contents;
+  core::PutFixed64(&contents, Fingerprint64(graph));
+  contents.append(graph);
+  if (static_cast<int64_t>(contents.size()) > max_bytes_) {
+    VLOG(1) << "Optimized graph of " << contents.size()
+            << " bytes is too large to cache.";
+    return OkStatus();
+  }
+
+  TF_RETURN_IF_ERROR(env_->RecursivelyCreateDir(dir_));
+  // Readers in other processes must never see partially written entries.
+  const string path = EntryPath(key);
+  const string temp_path =
+      absl::StrCat(path, kTempInfix, env_->NowMicros(), "-", random::New64());
+  TF_RETURN_IF_ERROR(WriteStringToFile(env_, temp_path, contents));
+  Status s = env_->RenameFile(temp_path, path);
+  if (!s.ok()) {
+    env_->DeleteFile(temp_path).IgnoreError();
+    return s;
+  }
+  EvictIfNeeded();
+  return OkStatus();
+}
+
+void OptimizedGraphCache::EvictIfNeeded() {
+  std::vector<string> children;
+  if (!env_->GetChildren(dir_, &children).ok()) return;
+
+  struct Entry {
+    int64_t bytes = 0;
+    int64_t last_use_nsec = 0;
+  };
+  std::map<string, Entry> entries;
+  int64_t total_bytes = 0;
+  const int64_t now_nsec = env_->NowNanos();
+  for (const string& child : children) {
+    const string path = io::JoinPath(dir_, child);
+    FileStatistics stat;
+    if (!env_->Stat(path, &stat).ok()) continue;
+    if (absl::StrContains(child, kTempInfix)) {
+      if (now_nsec - stat.mtime_nsec > kTempFileMaxAgeNsec) {
+        env_->DeleteFile(path).IgnoreError();
+      }
+      continue;
+    }
+    string entry_path;
+    if (absl::EndsWith(child, kEntrySuffix)) {
+      entry_path = path;
+      entries[entry_path].bytes = stat.length;
+      total_bytes += stat.length;
+    } else if (absl::EndsWith(child, kLastUseSuffix)) {
+      entry_path = path.substr(0, path.size() - strlen(kLastUseSuffix));
+    } else {
+      continue;
+    }
+    Entry& entry = entries[entry_path];
+    entry.last_use_nsec = std::max(entry.last_use_nsec, stat.mtime_nsec);
+  }
+  if (total_bytes <= max_bytes_) return;
+
+  std::vector<std::pair<int64_t, string>> by_last_use;
+  for (const auto& entry : entries) {
+    by_last_use.emplace_back(entry.second.last_use_nsec, entry.first);
+  }
+  std::sort(by_last_use.begin(), by_last_use.end());
+  for (const auto& entry : by_last_use) {
+    if (total_bytes <= max_bytes_) break;
+    VLOG(1) << "Evicting optimized graph cache entry " << entry.second;
+    env_->DeleteFile(entry.second).IgnoreError();
+    env_->DeleteFile(absl::StrCat(entry.second, kLastUseSuffix)).IgnoreError();
+    total_bytes -= entries[entry.second].bytes;
+  }
+}
+
+}  // end namespace grappler
+}  // end namespace tensorflow
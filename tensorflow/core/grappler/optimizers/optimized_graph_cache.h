@@ -0,0 +1,76 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_OPTIMIZED_GRAPH_CACHE_H_
+#define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_OPTIMIZED_GRAPH_CACHE_H_
+
+#include <string>
+
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/grappler/clusters/cluster.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// On-disk cache of the graphs optimized by the MetaOptimizer, which can be
+// shared by all the processes optimizing the same models.
+//
+// Entries are keyed by a fingerprint of the item to optimize, the optimizer
+// configuration, the registered custom and plugin optimizers, the available
+// devices and the TensorFlow version, so that a change to any of them is a
+// miss. Entries are written atomically and
+// checksummed, and a corrupt entry is deleted and treated as a miss. Once the
+// directory grows beyond its size limit, the least recently used entries are
+// deleted.
+class OptimizedGraphCache {
+ public:
+  // Returns the cache in TF_GRAPPLER_OPTIMIZED_GRAPH_CACHE_DIR, limited to
+  // TF_GRAPPLER_OPTIMIZED_GRAPH_CACHE_MAX_MB megabytes (1024 by default), or
+  // nullptr if the directory is not set.
+  static OptimizedGraphCache* Global();
+
+  OptimizedGraphCache(Env* env, const string& dir, int64_t max_bytes);
+
+  // Returns the key of the optimization of `item` by a MetaOptimizer
+  // configured with `config_proto`, on the devices of `cluster` (which may be
+  // null).
+  static string Key(const GrapplerItem& item, const ConfigProto& config_proto,
+                    const Cluster* cluster, bool has_cpu_device);
+
+  // Returns true and sets `optimized_graph` if the cache has an entry for
+  // `key`.
+  bool Lookup(const string& key, GraphDef* optimized_graph);
+
+  // Stores `optimized_graph` for `key`, then evicts entries if the cache is
+  // over its size limit.
+  Status Insert(const string& key, const GraphDef& optimized_graph);
+
+ private:
+  string EntryPath(const string& key) const;
+  void EvictIfNeeded();
+
+  Env* const env_;
+  const string dir_;
+  const int64_t max_bytes_;
+};
+
+}  // end namespace grappler
+}  // end namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_OPTIMIZED_GRAPH_CACHE_H_
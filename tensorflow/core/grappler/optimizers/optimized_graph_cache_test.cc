@@ -0,0 +1,241 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/optimized_graph_cache.h"
+
+#include <cstdlib>
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/inputs/trivial_test_graph_input_yielder.h"
+#include "tensorflow/core/grappler/optimizers/meta_optimizer.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/path.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+class OptimizedGraphCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    dir_ = io::JoinPath(testing::TmpDir(), "optimized_graph_cache",
+                        ::testing::UnitTest::GetInstance()
+                            ->current_test_info()
+                            ->name());
+    int64_t undeleted_files, undeleted_dirs;
+    Env::Default()
+        ->DeleteRecursively(dir_, &undeleted_files, &undeleted_dirs)
+        .IgnoreError();
+
+    TrivialTestGraphInputYielder fake_input(4, 1, 10, false, {"CPU:0"});
+    ASSERT_TRUE(fake_input.NextItem(&item_));
+  }
+
+  // Returns a graph with `n` nodes.
+  static GraphDef MakeGraph(int n) {
+    tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+    for (int i = 0; i < n; ++i) {
+      ops::Const(s.WithOpName(absl::StrCat("c", i)), 1.0f, {1});
+    }
+    GraphDef graph;
+    TF_CHECK_OK(s.ToGraphDef(&graph));
+    return graph;
+  }
+
+  // Returns the number of entries in the cache directory.
+  int NumEntries() const {
+    std::vector<string> children;
+    TF_CHECK_OK(Env::Default()->GetChildren(dir_, &children));
+    int num_entries = 0;
+    for (const string& child : children) {
+      if (absl::EndsWith(child, ".graph")) ++num_entries;
+    }
+    return num_entries;
+  }
+
+  string dir_;
+  GrapplerItem item_;
+  ConfigProto config_;
+};
+
+TEST_F(OptimizedGraphCacheTest, KeyDependsOnInputs) {
+  const string key =
+      OptimizedGraphCache::Key(item_, config_, /*cluster=*/nullptr, true);
+  EXPECT_EQ(key, OptimizedGraphCache::Key(item_, config_, /*cluster=*/nullptr,
+                                          true));
+  EXPECT_NE(key, OptimizedGraphCache::Key(item_, config_, /*cluster=*/nullptr,
+                                          false));
+
+  ConfigProto other_config = config_;
+  other_config.mutable_graph_options()
+      ->mutable_rewrite_options()
+      ->set_constant_folding(RewriterConfig::OFF);
+  EXPECT_NE(key, OptimizedGraphCache::Key(item_, other_config,
+                                          /*cluster=*/nullptr, true));
+
+  other_config = config_;
+  other_config.mutable_graph_options()
+      ->mutable_optimizer_options()
+      ->set_global_jit_level(OptimizerOptions::ON_1);
+  EXPECT_NE(key, OptimizedGraphCache::Key(item_, other_config,
+                                          /*cluster=*/nullptr, true));
+
+  other_config = config_;
+  other_config.mutable_experimental()->set_executor_type(
+      "SINGLE_THREADED_EXECUTOR");
+  EXPECT_NE(key, OptimizedGraphCache::Key(item_, other_config,
+                                          /*cluster=*/nullptr, true));
+
+  other_config = config_;
+  other_config.mutable_experimental()->set_use_tfrt(true);
+  EXPECT_NE(key, OptimizedGraphCache::Key(item_, other_config,
+                                          /*cluster=*/nullptr, true));
+
+  // Custom optimizers are initialized with the whole config, so any field of
+  // it may change their output.
+  ConfigProto custom_config = config_;
+  RewriterConfig::CustomGraphOptimizer* custom_optimizer =
+      custom_config.mutable_graph_options()
+          ->mutable_rewrite_options()
+          ->add_custom_optimizers();
+  custom_optimizer->set_name("MyOptimizer");
+  const string custom_key = OptimizedGraphCache::Key(
+      item_, custom_config, /*cluster=*/nullptr, true);
+  EXPECT_NE(key, custom_key);
+  (*custom_optimizer->mutable_parameter_map())["param"].set_i(1);
+  EXPECT_NE(custom_key, OptimizedGraphCache::Key(item_, custom_config,
+                                                 /*cluster=*/nullptr, true));
+  custom_optimizer->clear_parameter_map();
+  custom_config.set_inter_op_parallelism_threads(3);
+  EXPECT_NE(custom_key, OptimizedGraphCache::Key(item_, custom_config,
+                                                 /*cluster=*/nullptr, true));
+
+  GrapplerItem other_item = item_;
+  other_item.fetch.push_back("extra_fetch");
+  EXPECT_NE(key, OptimizedGraphCache::Key(other_item, config_,
+                                          /*cluster=*/nullptr, true));
+
+  other_item = item_;
+  TF_ASSERT_OK(
+      other_item.AddDevice("/job:localhost/replica:0/task:0/device:CPU:1"));
+  EXPECT_NE(key, OptimizedGraphCache::Key(other_item, config_,
+                                          /*cluster=*/nullptr, true));
+
+  other_item = item_;
+  other_item.graph.mutable_node(0)->set_device("/device:CPU:1");
+  EXPECT_NE(key, OptimizedGraphCache::Key(other_item, config_,
+                                          /*cluster=*/nullptr, true));
+}
+
+TEST_F(OptimizedGraphCacheTest, InsertAndLookup) {
+  OptimizedGraphCache cache(Env::Default(), dir_, /*max_bytes=*/1 << 20);
+  const string key =
+      OptimizedGraphCache::Key(item_, config_, /*cluster=*/nullptr, true);
+  GraphDef graph;
+  EXPECT_FALSE(cache.Lookup(key, &graph));
+
+  const GraphDef optimized = MakeGraph(3);
+  TF_ASSERT_OK(cache.Insert(key, optimized));
+  // Another cache on the same directory, e.g. in another process.
+  OptimizedGraphCache other_cache(Env::Default(), dir_, 1 << 20);
+  ASSERT_TRUE(other_cache.Lookup(key, &graph));
+  EXPECT_EQ(optimized.DebugString(), graph.DebugString());
+}
+
+TEST_F(OptimizedGraphCacheTest, CorruptEntryIsAMiss) {
+  OptimizedGraphCache cache(Env::Default(), dir_, /*max_bytes=*/1 << 20);
+  TF_ASSERT_OK(cache.Insert("key", MakeGraph(3)));
+  const string path = io::JoinPath(dir_, "key.graph");
+  string contents;
+  TF_ASSERT_OK(ReadFileToString(Env::Default(), path, &contents));
+  contents[contents.size() / 2] ^= 1;
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), path, contents));
+
+  GraphDef graph;
+  EXPECT_FALSE(cache.Lookup("key", &graph));
+  EXPECT_FALSE(Env::Default()->FileExists(path).ok());
+
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), path, "abc"));
+  EXPECT_FALSE(cache.Lookup("key", &graph));
+}
+
+TEST_F(OptimizedGraphCacheTest, EvictsLeastRecentlyUsedEntries) {
+  const GraphDef graph = MakeGraph(20);
+  // Room for two entries.
+  const int64_t max_bytes = 5 * graph.ByteSizeLong() / 2;
+  OptimizedGraphCache cache(Env::Default(), dir_, max_bytes);
+  GraphDef result;
+
+  TF_ASSERT_OK(cache.Insert("a", graph));
+  Env::Default()->SleepForMicroseconds(10000);
+  TF_ASSERT_OK(cache.Insert("b", graph));
+  Env::Default()->SleepForMicroseconds(10000);
+  ASSERT_TRUE(cache.Lookup("a", &result));
+  Env::Default()->SleepForMicroseconds(10000);
+  TF_ASSERT_OK(cache.Insert("c", graph));
+
+  EXPECT_TRUE(cache.Lookup("a", &result));
+  EXPECT_FALSE(cache.Lookup("b", &result));
+  EXPECT_TRUE(cache.Lookup("c", &result));
+}
+
+// OptimizedGraphCache::Global() reads the cache directory once per process,
+// so this is the only test running a MetaOptimizer with the cache.
+TEST_F(OptimizedGraphCacheTest, MetaOptimizersWithDifferentJitLevelsMiss) {
+  setenv("TF_GRAPPLER_OPTIMIZED_GRAPH_CACHE_DIR", dir_.c_str(), 1);
+  ASSERT_NE(OptimizedGraphCache::Global(), nullptr);
+
+  ConfigProto jit_off;
+  RewriterConfig* rewrite_options =
+      jit_off.mutable_graph_options()->mutable_rewrite_options();
+  rewrite_options->set_min_graph_nodes(-1);
+  rewrite_options->add_optimizers("pruning");
+  jit_off.mutable_graph_options()
+      ->mutable_optimizer_options()
+      ->set_global_jit_level(OptimizerOptions::OFF);
+  ConfigProto jit_on = jit_off;
+  jit_on.mutable_graph_options()
+      ->mutable_optimizer_options()
+      ->set_global_jit_level(OptimizerOptions::ON_1);
+
+  GraphDef output;
+  TF_ASSERT_OK(MetaOptimizer(/*cpu_device=*/nullptr, jit_off)
+                   .Optimize(/*cluster=*/nullptr, item_, &output));
+  EXPECT_EQ(NumEntries(), 1);
+  TF_ASSERT_OK(MetaOptimizer(/*cpu_device=*/nullptr, jit_on)
+                   .Optimize(/*cluster=*/nullptr, item_, &output));
+  EXPECT_EQ(NumEntries(), 2);
+  // A MetaOptimizer with the same config hits the first entry.
+  TF_ASSERT_OK(MetaOptimizer(/*cpu_device=*/nullptr, jit_off)
+                   .Optimize(/*cluster=*/nullptr, item_, &output));
+  EXPECT_EQ(NumEntries(), 2);
+}
+
+TEST_F(OptimizedGraphCacheTest, DoesNotCacheGraphsLargerThanTheCache) {
+  OptimizedGraphCache cache(Env::Default(), dir_, /*max_bytes=*/16);
+  TF_ASSERT_OK(cache.Insert("key", MakeGraph(3)));
+  GraphDef graph;
+  EXPECT_FALSE(cache.Lookup("key", &graph));
+}
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
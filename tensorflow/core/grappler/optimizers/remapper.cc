@@ -25,6 +25,7 @@ limitations under the License.
 #include <vector>
 
 #include "absl/container/flat_hash_set.h"
+#include "absl/strings/match.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/versions.pb.h"
 #include "tensorflow/core/grappler/costs/graph_properties.h"
@@ -92,6 +93,8 @@ constexpr char kFusedDepthwiseConv2dNative[] = "_FusedDepthwiseConv2dNative";
 constexpr char kFusedBatchNormEx[] = "_FusedBatchNormEx";
 constexpr char kFusedBatchNormGradEx[] = "_FusedBatchNormGradEx";
 constexpr char kTensorToHashBucket[] = "_TensorToHashBucketFast";
+constexpr char kResourceSparseSegmentReduction[] =
+    "_ResourceSparseSegmentReduction";
 constexpr char kLeakyRelu[] = "LeakyRelu";
 constexpr char kMklFusedMish[] = "_MklFusedMish";
 constexpr char kRelu[] = "Relu";
@@ -167,6 +170,18 @@ struct TensorToHashBucket {
   int string_to_hash_bucket = kMissingIndex;
 };
 
+// ResourceGather whose output is only read by a
+// SparseSegmentSum/Mean/SqrtN[WithNumSegments], which can be replaced with
+// _ResourceSparseSegmentReduction.
+struct ResourceSparseSegmentReduction {
+  ResourceSparseSegmentReduction() = default;
+  ResourceSparseSegmentReduction(int gather, int reduction)
+      : gather(gather), reduction(reduction) {}
+
+  int gather = kMissingIndex;
+  int reduction = kMissingIndex;
+};
+
 // Pad followed by Conv3D/FusedConv3D
 struct PadWithConv3D {
   PadWithConv3D() = default;
@@ -1569,14 +1584,16 @@ bool IsMatchedMatMulBiasAddAndGeluExact(
 // uses Tanh.
 bool FindMatMulBiasAddAndGelu(RemapperContext* ctx, int node_index,
                               const Cluster* cluster,
+                              bool allow_non_differentiable_rewrites,
                               std::map<string, int>* matched_nodes_map,
                               std::set<int>* remove_node_indices,
                               bool* is_gelu_approximate) {
-  // Gelu fusion is enabled with oneDNN or cublasLt or cuDNN library.
-  if (!IsMKLEnabled() && !BlasLtMatmulEnabled() &&
-      !RuntimeFusionEnabled(cluster))
-    return false;
-
+  // Gelu fusion is enabled on CPU with oneDNN or the Eigen _FusedMatMul
+  // kernel, and on GPU with cublasLt or cuDNN library. _FusedMatMul has no
+  // gradient, so without oneDNN the CPU fusion is only done for inference, like
+  // the other Eigen fusions.
+  const bool cpu_fusion_enabled =
+      IsMKLEnabled() || allow_non_differentiable_rewrites;
   using utils::MatchingDirection;
   using utils::NodeStatus;
 
@@ -1691,11 +1708,14 @@ bool FindMatMulBiasAddAndGelu(RemapperContext* ctx, int node_index,
         ctx->graph_view.GetNode(matched_nodes_map->at("matmul"))->node();
     DataType matmul_dtype = GetDataTypeFromAttr(*matmul_node, "T");
 
-    bool cpu_ok = IsMKLEnabled() && IsCpuCompatibleMatMul(*ctx, matmul_node);
-    // Currently, the fusion is not supported on CPU for transpose_a in the
-    // MatMul op.
-    cpu_ok = cpu_ok && matmul_node->attr().contains("transpose_a") &&
-             !matmul_node->attr().at("transpose_a").b();
+    bool cpu_ok =
+        cpu_fusion_enabled && IsCpuCompatibleMatMul(*ctx, matmul_node);
+    // Currently, the oneDNN fusion is not supported on CPU for transpose_a in
+    // the MatMul op.
+    if (IsMKLEnabled()) {
+      cpu_ok = cpu_ok && matmul_node->attr().contains("transpose_a") &&
+               !matmul_node->attr().at("transpose_a").b();
+    }
 
     bool gpu_ok = NodeIsOnGpu(matmul_node) && RuntimeFusionEnabled(cluster) &&
                   matmul_dtype == DT_HALF;
@@ -1728,11 +1748,15 @@ bool FindMatMulBiasAddAndGelu(RemapperContext* ctx, int node_index,
 
     // matmul_node is already the _FusedMatMul and we don't need to check its
     // data type again.
-    if (!IsMKLEnabled() && !NodeIsOnGpu(matmul_node)) return false;
+    if (NodeIsOnGpu(matmul_node) && !BlasLtMatmulEnabled() &&
+        !RuntimeFusionEnabled(cluster)) {
+      return false;
+    }
+    if (NodeIsOnCpu(matmul_node) && !cpu_fusion_enabled) return false;
 
-    // Currently, the fusion is not supported on CPU for transpose_a in the
-    // MatMul op.
-    if (NodeIsOnCpu(matmul_node) &&
+    // Currently, the oneDNN fusion is not supported on CPU for transpose_a in
+    // the MatMul op.
+    if (IsMKLEnabled() && NodeIsOnCpu(matmul_node) &&
         matmul_node->attr().contains("transpose_a") &&
         matmul_node->attr().at("transpose_a").b()) {
       return false;
@@ -2065,15 +2089,34 @@ bool IsCommonNormPattern(RemapperContext* ctx, int node_index,
   return found_op_type_match;
 }
 
+// Returns true if the first output of `node_name` is a vector of `size`
+// elements.
+bool IsVectorOfSize(const RemapperContext& ctx, const string& node_name,
+                    int64_t size) {
+  const std::vector<OpInfo::TensorProperties>& props =
+      ctx.graph_properties.GetOutputProperties(node_name);
+  if (props.empty()) return false;
+  const TensorShapeProto& shape = props[0].shape();
+  return Rank(shape) == 1 && shape.dim(0).size() == size;
+}
+
 // Keras LayerNormalization api uses multiple TensorFlow ops. Current fusion
 // pattern is only for the case, when LayerNormalization uses FusedBatcNormV3.
-// We further restrict it to only 2D or 3D tensor inputs to keras
-// LayerNormalization api.
-bool FindMklLayerNorm(RemapperContext* ctx, int node_index,
-                      std::map<string, int>* matched_nodes_map,
-                      std::set<int>* remove_node_indices,
-                      std::vector<string>* input_node_names, float* epsilon) {
-  if (!IsMKLEnabled()) return false;
+// With oneDNN, we further restrict it to only 2D or 3D tensor inputs to keras
+// LayerNormalization api. Without oneDNN, the pattern is fused into the Eigen
+// based _FusedLayerNorm on CPU, which normalizes the innermost dimension of
+// float tensors of any rank.
+bool FindLayerNorm(RemapperContext* ctx, int node_index,
+                   std::map<string, int>* matched_nodes_map,
+                   std::set<int>* remove_node_indices,
+                   std::vector<string>* input_node_names, float* epsilon) {
+  const bool is_mkl_enabled = IsMKLEnabled();
+  if (!is_mkl_enabled) {
+    const NodeDef* node_def = ctx->graph_view.GetNode(node_index)->node();
+    if (!NodeIsOnCpu(node_def) || !HasDataType(node_def, DT_FLOAT)) {
+      return false;
+    }
+  }
 
   // The following pattern will be searched in the graph with additional
   // contraints. Here * means any type of op.
@@ -2187,6 +2230,36 @@ bool FindMklLayerNorm(RemapperContext* ctx, int node_index,
       if (!TryGetNodeAttr(*fused_batch_norm_node, kIsTraining, &is_training) ||
           !is_training)
         return false;
+      // Keras normalizes the [1, pre_dim, in_dim, 1] reshaped input in NCHW
+      // format, i.e. over its third dimension, which _FusedLayerNorm requires
+      // to be the innermost dimension of the input.
+      if (!is_mkl_enabled) {
+        string data_format;
+        if (!TryGetNodeAttr(*fused_batch_norm_node, "data_format",
+                            &data_format) ||
+            data_format != "NCHW") {
+          return false;
+        }
+        const NodeDef* input_node =
+            ctx->graph_view.GetNode(matched_nodes_map->at("input"))->node();
+        const auto input_props =
+            ctx->graph_properties.GetOutputProperties(input_node->name());
+        const NodeDef* pre_reshape_node =
+            ctx->graph_view.GetNode(matched_nodes_map->at("pre_reshape"))
+                ->node();
+        const auto pre_reshape_props =
+            ctx->graph_properties.GetOutputProperties(pre_reshape_node->name());
+        if (input_props.empty() || pre_reshape_props.empty()) return false;
+        const TensorShapeProto& input_shape = input_props[0].shape();
+        const TensorShapeProto& pre_reshape_shape =
+            pre_reshape_props[0].shape();
+        if (Rank(input_shape) < 1 || Rank(pre_reshape_shape) != 4 ||
+            !IsKnown(input_shape.dim(Rank(input_shape) - 1)) ||
+            input_shape.dim(Rank(input_shape) - 1).size() !=
+                pre_reshape_shape.dim(2).size()) {
+          return false;
+        }
+      }
 
       // FusedBatchNorm node should have mean/variance as empty constant
       NodeDef* empty_const_node =
@@ -2253,6 +2326,18 @@ bool FindMklLayerNorm(RemapperContext* ctx, int node_index,
         if (static_cast<int64>(rank - 1) != mean_axis_tensor.flat<int64>()(0))
           return false;
       }
+      // Use the epsilon added to the variance.
+      NodeDef* epsilon_node =
+          ctx->graph_view.GetNode(matched_nodes_map->at("epsilon"))->node();
+      Tensor epsilon_tensor;
+      if (epsilon_tensor.FromProto(
+              epsilon_node->attr().at("value").tensor()) &&
+          epsilon_tensor.dtype() == DT_FLOAT &&
+          epsilon_tensor.NumElements() == 1) {
+        *epsilon = epsilon_tensor.flat<float>()(0);
+      } else if (!is_mkl_enabled) {
+        return false;
+      }
       auto* gamma_node =
           ctx->graph_view.GetNode(matched_nodes_map->at("gamma"))->node();
       auto* beta_node =
@@ -2277,14 +2362,160 @@ bool FindMklLayerNorm(RemapperContext* ctx, int node_index,
     if (ShapesSymbolicallyEqual(input_props[0].shape(),
                                 output_props[0].shape())) {
       int rank = Rank(input_props[0].shape());
-      if (rank < 2 || rank > 3) return false;
+      if (is_mkl_enabled && (rank < 2 || rank > 3)) return false;
+      if (rank < 1) return false;
     } else {
       return false;
     }
+    // _FusedLayerNorm scales and offsets the innermost dimension, which must
+    // not be broadcast with gamma and beta.
+    if (!is_mkl_enabled) {
+      const TensorShapeProto& shape = input_props[0].shape();
+      const int64_t depth = shape.dim(Rank(shape) - 1).size();
+      if (depth < 0 || !IsVectorOfSize(*ctx, input_node_names->at(1), depth) ||
+          !IsVectorOfSize(*ctx, input_node_names->at(2), depth)) {
+        return false;
+      }
+    }
   }
   return found_op_type_match;
 }
 
+// Finds the scaled dot-product attention of transformer models, with an
+// additive mask, to fuse it into the Eigen based _FusedMaskedSoftmaxAttention
+// on CPU.
+bool FindMaskedSoftmaxAttention(RemapperContext* ctx, int node_index,
+                                std::map<string, int>* matched_nodes_map,
+                                std::set<int>* remove_node_indices,
+                                float* scale) {
+  const NodeDef* node_def = ctx->graph_view.GetNode(node_index)->node();
+  if (!IsAnyBatchMatMul(*node_def) || !NodeIsOnCpu(node_def) ||
+      !HasDataType(node_def, DT_FLOAT)) {
+    return false;
+  }
+
+  using utils::MatchingDirection;
+  using utils::NodeStatus;
+  // clang-format off
+  //            Subgraph for fusion
+  //            -------------------
+  //    *(query)  *(key)
+  //        \      /
+  //      BatchMatMul(adj_y)  Const                          FusedOp
+  //              \          /                               -------
+  //               \       Mul   *(mask)      *(query) *(key) *(value) *(mask)
+  //                \     /       /                \     |     |     /
+  //                  \  /       /          _FusedMaskedSoftmaxAttention
+  //                  AddV2|Add
+  //                     |
+  //                  Softmax   *(value)
+  //                      \     /
+  //                    BatchMatMul(output)
+  utils::OpTypePattern attention_pattern =
+    {"BatchMatMul|BatchMatMulV2", "output", NodeStatus::kReplace,
+      {
+        {"Softmax", "softmax", NodeStatus::kRemove,
+          {
+            {"AddV2|Add", "add", NodeStatus::kRemove,
+              {
+                {"Mul", "mul", NodeStatus::kRemove,
+                  {
+                    {"BatchMatMul|BatchMatMulV2", "scores",
+                     NodeStatus::kRemove},
+                    {"Const", "scale", NodeStatus::kRemain}
+                  }
+                },
+                {"*", "mask", NodeStatus::kRemain}
+              }
+            }
+          }
+        },
+        {"*", "value", NodeStatus::kRemain}
+      }
+    };
+  // clang-format on
+
+  utils::SubGraphMatcher<MatchingDirection::kFollowInputs> graph_matcher(
+      &(ctx->graph_view));
+  matched_nodes_map->clear();
+  remove_node_indices->clear();
+  if (!graph_matcher.GetMatchedNodes(attention_pattern, ctx->nodes_to_preserve,
+                                     ctx->graph_view.GetNode(node_index),
+                                     matched_nodes_map, remove_node_indices)) {
+    return false;
+  }
+
+  auto get_node = [&](const string& name) {
+    return ctx->graph_view.GetNode(matched_nodes_map->at(name))->node();
+  };
+  const NodeDef* output = get_node("output");
+  const NodeDef* scores = get_node("scores");
+  for (const string& name : {"softmax", "add", "mul", "scores"}) {
+    if (!HasDataType(get_node(name), DT_FLOAT)) return false;
+  }
+  // The scores are the product of the queries and the transposed keys, which
+  // weight the values.
+  auto has_adjoints = [](const NodeDef* matmul, bool adj_x, bool adj_y) {
+    bool node_adj_x = false, node_adj_y = false;
+    return TryGetNodeAttr(*matmul, "adj_x", &node_adj_x) &&
+           TryGetNodeAttr(*matmul, "adj_y", &node_adj_y) &&
+           node_adj_x == adj_x && node_adj_y == adj_y;
+  };
+  if (!has_adjoints(scores, false, true) || !has_adjoints(output, false, false))
+    return false;
+
+  Tensor scale_tensor;
+  const NodeDef* scale_node = get_node("scale");
+  if (!scale_tensor.FromProto(scale_node->attr().at("value").tensor()) ||
+      scale_tensor.dtype() != DT_FLOAT || scale_tensor.NumElements() != 1) {
+    return false;
+  }
+  *scale = scale_tensor.flat<float>()(0);
+
+  if (!ctx->inferred_graph_properties) {
+    Status s = ctx->graph_properties.InferStatically(
+        /*assume_valid_feeds=*/true,
+        /*aggressive_shape_inference=*/false,
+        /*include_input_tensor_values=*/false,
+        /*include_output_tensor_values=*/false);
+    if (!s.ok()) return false;
+    ctx->inferred_graph_properties = true;
+  }
+  const auto& scores_props =
+      ctx->graph_properties.GetInputProperties(scores->name());
+  const auto& output_props =
+      ctx->graph_properties.GetInputProperties(output->name());
+  if (scores_props.size() != 2 || output_props.size() != 2) return false;
+  const TensorShapeProto& query_shape = scores_props[0].shape();
+  const TensorShapeProto& key_shape = scores_props[1].shape();
+  const TensorShapeProto& value_shape = output_props[1].shape();
+  // The kernel does not broadcast the batch dimensions of the query, key and
+  // value.
+  const int rank = Rank(query_shape);
+  if (rank < 2 || Rank(key_shape) != rank || Rank(value_shape) != rank) {
+    return false;
+  }
+  for (int i = 0; i < rank - 2; ++i) {
+    const int64_t size = query_shape.dim(i).size();
+    if (size == -1 || key_shape.dim(i).size() != size ||
+        value_shape.dim(i).size() != size) {
+      return false;
+    }
+  }
+  // Neither the scale nor the mask may broadcast the scores.
+  const auto& scores_out_props =
+      ctx->graph_properties.GetOutputProperties(scores->name());
+  if (scores_out_props.empty()) return false;
+  for (const string& name : {"mul", "add"}) {
+    const auto& props =
+        ctx->graph_properties.GetOutputProperties(get_node(name)->name());
+    if (props.empty() || !ShapesSymbolicallyEqual(props[0].shape(),
+                                                  scores_out_props[0].shape()))
+      return false;
+  }
+  return true;
+}
+
 bool FindFusedBatchNorm(const RemapperContext& ctx, int node_index,
                         FusedBatchNorm* matched) {
   const auto* node_view = ctx.graph_view.GetNode(node_index);
@@ -2611,6 +2842,60 @@ bool FindFusedBatchNormGradEx(const RemapperContext& ctx, int node_index,
   return false;
 }
 
+bool FindResourceSparseSegmentReduction(
+    RemapperContext* ctx, int node_index,
+    ResourceSparseSegmentReduction* matched) {
+  // Root of the pattern must be a SparseSegmentSum/Mean/SqrtN on CPU.
+  const auto* node_view = ctx->graph_view.GetNode(node_index);
+  const auto* node_def = node_view->node();
+  if (!IsAnySparseSegmentReduction(*node_def) || !NodeIsOnCpu(node_def) ||
+      HasControlFaninOrFanout(*node_view)) {
+    return false;
+  }
+  if (!HasDataType(node_def, DT_FLOAT) && !HasDataType(node_def, DT_DOUBLE) &&
+      !HasDataType(node_def, DT_HALF) && !HasDataType(node_def, DT_BFLOAT16)) {
+    return false;
+  }
+
+  // Its data must be the only use of a ResourceGather on the same device.
+  if (node_view->NumRegularFanins() < 3) return false;
+  const auto* gather_node_view = node_view->GetRegularFanin(0).node_view();
+  const auto* gather_node_def = gather_node_view->node();
+  if (gather_node_def->op() != "ResourceGather" ||
+      gather_node_def->device() != node_def->device() ||
+      HasControlFaninOrFanout(*gather_node_view) ||
+      !HasAtMostOneFanoutAtPort0(*gather_node_view) ||
+      IsInPreserveSet(*ctx, gather_node_def)) {
+    return false;
+  }
+  int batch_dims = 0;
+  if (TryGetNodeAttr(*gather_node_def, "batch_dims", &batch_dims) &&
+      batch_dims != 0) {
+    return false;
+  }
+
+  // The fused kernel gathers the rows of a vector of ids: the indices of the
+  // reduction index its ids.
+  if (!ctx->inferred_graph_properties) {
+    Status s = ctx->graph_properties.InferStatically(
+        /*assume_valid_feeds=*/true,
+        /*aggressive_shape_inference=*/false,
+        /*include_input_tensor_values=*/false,
+        /*include_output_tensor_values=*/false);
+    if (!s.ok()) return false;
+    ctx->inferred_graph_properties = true;
+  }
+  const auto& gather_props =
+      ctx->graph_properties.GetInputProperties(gather_node_def->name());
+  if (gather_props.size() != 2 || Rank(gather_props[1].shape()) != 1) {
+    return false;
+  }
+
+  *matched = ResourceSparseSegmentReduction(gather_node_view->node_index(),
+                                            node_index);
+  return true;
+}
+
 bool FindTensorToHashBucket(const RemapperContext& ctx, int node_index,
                             TensorToHashBucket* matched) {
   // Root of the pattern must be a StringToHashBucketFast.
@@ -3633,19 +3918,18 @@ Status AddFusedMatMulBiasAddAndGelu(
   return OkStatus();
 }
 
-Status AddMklLayerNorm(RemapperContext* ctx,
-                       const std::map<string, int>& matched_nodes_map,
-                       const std::set<int>& remove_node_indices,
-                       const std::vector<string>& input_node_names,
-                       std::vector<bool>* invalidated_nodes,
-                       std::vector<bool>* nodes_to_delete,
-                       const float epsilon) {
+Status AddLayerNorm(RemapperContext* ctx,
+                    const std::map<string, int>& matched_nodes_map,
+                    const std::set<int>& remove_node_indices,
+                    const std::vector<string>& input_node_names,
+                    std::vector<bool>* invalidated_nodes,
+                    std::vector<bool>* nodes_to_delete, const float epsilon) {
   auto* output_node =
       ctx->graph_view.GetNode(matched_nodes_map.at("output"))->node();
 
   NodeDef fused_node;
   fused_node.set_name(output_node->name());
-  fused_node.set_op("_MklLayerNorm");
+  fused_node.set_op(IsMKLEnabled() ? "_MklLayerNorm" : "_FusedLayerNorm");
   fused_node.set_device(output_node->device());
   for (const auto& name : input_node_names) fused_node.add_input(name);
   auto* attr = fused_node.mutable_attr();
@@ -3666,6 +3950,46 @@ Status AddMklLayerNorm(RemapperContext* ctx,
   return OkStatus();
 }
 
+Status AddMaskedSoftmaxAttention(
+    RemapperContext* ctx, const std::map<string, int>& matched_nodes_map,
+    const std::set<int>& remove_node_indices,
+    std::vector<bool>* invalidated_nodes, std::vector<bool>* nodes_to_delete,
+    float scale) {
+  const NodeDef* output =
+      ctx->graph_view.GetNode(matched_nodes_map.at("output"))->node();
+  const NodeDef* scores =
+      ctx->graph_view.GetNode(matched_nodes_map.at("scores"))->node();
+  const NodeDef* add =
+      ctx->graph_view.GetNode(matched_nodes_map.at("add"))->node();
+  const NodeDef* mul =
+      ctx->graph_view.GetNode(matched_nodes_map.at("mul"))->node();
+
+  NodeDef fused_node;
+  fused_node.set_name(output->name());
+  fused_node.set_op("_FusedMaskedSoftmaxAttention");
+  fused_node.set_device(output->device());
+  fused_node.add_input(scores->input(0));
+  fused_node.add_input(scores->input(1));
+  fused_node.add_input(output->input(1));
+  fused_node.add_input(NodeName(add->input(0)) == mul->name() ? add->input(1)
+                                                              : add->input(0));
+  auto* attr = fused_node.mutable_attr();
+  SetAttrValue(DT_FLOAT, &(*attr)["T"]);
+  SetAttrValue(scale, &(*attr)["scale"]);
+
+  utils::Mutation* mutation = ctx->graph_view.GetMutationBuilder();
+  Status status;
+  mutation->AddNode(std::move(fused_node), &status);
+  TF_RETURN_IF_ERROR(status);
+  TF_RETURN_IF_ERROR(mutation->Apply());
+  (*invalidated_nodes)[matched_nodes_map.at("output")] = true;
+
+  for (const auto& node_idx : remove_node_indices) {
+    (*nodes_to_delete)[node_idx] = true;
+  }
+  return OkStatus();
+}
+
 Status ReplaceMulMaximumWithLeakyRelu(
     RemapperContext* ctx, const std::map<string, int>& matched_nodes_map,
     const std::set<int>& remove_node_indices,
@@ -4109,6 +4433,62 @@ Status AddTensorToHashBucketNode(RemapperContext* ctx,
   return OkStatus();
 }
 
+Status AddResourceSparseSegmentReductionNode(
+    RemapperContext* ctx, const ResourceSparseSegmentReduction& matched,
+    std::vector<bool>* invalidated_nodes, std::vector<bool>* nodes_to_delete) {
+  const GraphDef* graph = ctx->graph_view.graph();
+  const NodeDef& gather = graph->node(matched.gather);
+  const NodeDef& reduction = graph->node(matched.reduction);
+  VLOG(2) << "Fuse ResourceGather with " << reduction.op() << ":"
+          << " gather=" << gather.name() << " reduction=" << reduction.name()
+          << " on device=" << reduction.device();
+
+  const bool with_num_segments =
+      absl::EndsWith(reduction.op(), "WithNumSegments");
+  NodeDef fused_op;
+  fused_op.set_name(reduction.name());
+  fused_op.set_device(reduction.device());
+  fused_op.add_input(gather.input(0));     // 0: resource
+  fused_op.add_input(gather.input(1));     // 1: ids
+  fused_op.add_input(reduction.input(1));  // 2: indices
+  fused_op.add_input(reduction.input(2));  // 3: segment_ids
+  if (with_num_segments) {
+    fused_op.add_input(reduction.input(3));  // 4: num_segments
+  }
+  fused_op.set_op(kResourceSparseSegmentReduction);
+
+  auto* attr = fused_op.mutable_attr();
+  auto& gather_attr = gather.attr();
+  auto& reduction_attr = reduction.attr();
+  (*attr)["dtype"] = reduction_attr.at("T");
+  (*attr)["Tids"] = gather_attr.at("Tindices");
+  for (const char* type_attr : {"Tidx", "Tsegmentids", "Tnumsegments"}) {
+    if (reduction_attr.count(type_attr) > 0) {
+      (*attr)[type_attr] = reduction_attr.at(type_attr);
+    }
+  }
+  string combiner = "sum";
+  if (absl::StartsWith(reduction.op(), "SparseSegmentMean")) {
+    combiner = "mean";
+  } else if (absl::StartsWith(reduction.op(), "SparseSegmentSqrtN")) {
+    combiner = "sqrtn";
+  }
+  SetAttrValue(combiner, &(*attr)["combiner"]);
+  SetAttrValue(with_num_segments ? 1 : 0, &(*attr)["num_num_segments"]);
+  SetAttrValue(0, &(*attr)["num_weights"]);
+
+  utils::Mutation* mutation = ctx->graph_view.GetMutationBuilder();
+  Status status;
+  mutation->AddNode(std::move(fused_op), &status);
+  TF_RETURN_IF_ERROR(status);
+  TF_RETURN_IF_ERROR(mutation->Apply());
+
+  (*invalidated_nodes)[matched.reduction] = true;
+  (*nodes_to_delete)[matched.gather] = true;
+
+  return OkStatus();
+}
+
 Status AddFusedBatchMatMul(RemapperContext* ctx,
                            const std::map<string, int>& matched_nodes_map,
                            const std::set<int>& remove_node_indices,
@@ -4793,9 +5173,9 @@ Status Remapper::Optimize(Cluster* cluster, const GrapplerItem& item,
       remove_node_indices.clear();
       input_node_names.clear();
       float epsilon = 0.001;
-      if (FindMklLayerNorm(&ctx, i, &matched_nodes_map, &remove_node_indices,
-                           &input_node_names, &epsilon)) {
-        TF_RETURN_IF_ERROR(AddMklLayerNorm(
+      if (FindLayerNorm(&ctx, i, &matched_nodes_map, &remove_node_indices,
+                        &input_node_names, &epsilon)) {
+        TF_RETURN_IF_ERROR(AddLayerNorm(
             &ctx, matched_nodes_map, remove_node_indices, input_node_names,
             &invalidated_nodes, &nodes_to_delete, epsilon));
         continue;
@@ -4824,12 +5204,40 @@ Status Remapper::Optimize(Cluster* cluster, const GrapplerItem& item,
       }
     }
 
+    // Without oneDNN, remap the LayerNorm and masked softmax attention
+    // subgraphs of transformer models into the Eigen based _FusedLayerNorm and
+    // _FusedMaskedSoftmaxAttention on CPU.
+    if (!IsMKLEnabled() && allow_non_differentiable_rewrites) {
+      std::map<string, int> matched_nodes_map;
+      std::set<int> remove_node_indices;
+      std::vector<string> input_node_names;
+      float epsilon = 0.001;
+      if (FindLayerNorm(&ctx, i, &matched_nodes_map, &remove_node_indices,
+                        &input_node_names, &epsilon)) {
+        TF_RETURN_IF_ERROR(AddLayerNorm(
+            &ctx, matched_nodes_map, remove_node_indices, input_node_names,
+            &invalidated_nodes, &nodes_to_delete, epsilon));
+        continue;
+      }
+
+      float scale = 1.0;
+      if (FindMaskedSoftmaxAttention(&ctx, i, &matched_nodes_map,
+                                     &remove_node_indices, &scale)) {
+        TF_RETURN_IF_ERROR(AddMaskedSoftmaxAttention(
+            &ctx, matched_nodes_map, remove_node_indices, &invalidated_nodes,
+            &nodes_to_delete, scale));
+        continue;
+      }
+    }
+
     // Remap MatMul + BiasAdd + gelu-subgraph
     std::map<string, int> matched_nodes_map;
     std::set<int> remove_node_indices;
     bool is_gelu_approximate = false;
-    if (FindMatMulBiasAddAndGelu(&ctx, i, cluster, &matched_nodes_map,
-                                 &remove_node_indices, &is_gelu_approximate)) {
+    if (FindMatMulBiasAddAndGelu(&ctx, i, cluster,
+                                 allow_non_differentiable_rewrites,
+                                 &matched_nodes_map, &remove_node_indices,
+                                 &is_gelu_approximate)) {
       TF_RETURN_IF_ERROR(AddFusedMatMulBiasAddAndGelu(
           &ctx, matched_nodes_map, remove_node_indices, &invalidated_nodes,
           &nodes_to_delete, is_gelu_approximate));
@@ -4923,6 +5331,17 @@ Status Remapper::Optimize(Cluster* cluster, const GrapplerItem& item,
       continue;
     }
 
+    // Gather the rows of embedding variables straight into their segment.
+    ResourceSparseSegmentReduction resource_sparse_segment_reduction;
+    if (allow_non_differentiable_rewrites &&
+        FindResourceSparseSegmentReduction(
+            &ctx, i, &resource_sparse_segment_reduction)) {
+      TF_RETURN_IF_ERROR(AddResourceSparseSegmentReductionNode(
+          &ctx, resource_sparse_segment_reduction, &invalidated_nodes,
+          &nodes_to_delete));
+      continue;
+    }
+
     // During inference, most of the inputs to FusedBatchNorm are constant, and
     // we can therefore replace the op with a much cheaper set of primitives.
     FusedBatchNorm fused_batch_norm;
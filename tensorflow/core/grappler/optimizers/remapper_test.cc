@@ -15,16 +15,23 @@ limitations under the License.
 
 #include "tensorflow/core/grappler/optimizers/remapper.h"
 
+#include <cmath>
+
 #include "tensorflow/cc/ops/nn_ops_internal.h"
+#include "tensorflow/cc/ops/resource_variable_ops.h"
 #include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/common_runtime/graph_constructor.h"
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/graph/graph.h"
 #include "tensorflow/core/grappler/devices.h"
 #include "tensorflow/core/grappler/grappler_item.h"
 #include "tensorflow/core/grappler/utils/grappler_test.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow/core/util/util.h"
 
 #if GOOGLE_CUDA
@@ -1539,6 +1546,238 @@ class FuseMklLayerNormPattern : public RemapperTest {
 
 TEST_F(FuseMklLayerNormPattern, F32) { RunTest<DT_FLOAT>(); }
 
+// Builds the layer normalization of `x` over its innermost dimension, of size
+// `depth`, in the form of the common pattern matched by the remapper.
+Output LayerNormSubgraph(const Scope& s, Input x, int rank, int depth) {
+  auto r_indices = ops::Const(s.WithOpName("r_indices"), {rank - 1}, {1});
+  ops::Mean::Attrs attrs;
+  attrs = attrs.KeepDims(true);
+  auto mean = ops::Mean(s.WithOpName("mean"), x, r_indices, attrs);
+  auto s_diff = ops::SquaredDifference(s.WithOpName("s_diff"), mean, x);
+  auto variance =
+      ops::Mean(s.WithOpName("variance"), s_diff, r_indices, attrs);
+  auto e_const = ops::Const(s.WithOpName("e_const"), 0.001f, {});
+  auto add_1 = ops::AddV2(s.WithOpName("add_1"), e_const, variance);
+  auto rsqrt = ops::Rsqrt(s.WithOpName("rsqrt"), add_1);
+  auto g_const = ops::Const(s.WithOpName("g_const"), 1.5f, {depth});
+  auto mul = ops::Mul(s.WithOpName("mul"), rsqrt, g_const);
+  auto mul_1 = ops::Mul(s.WithOpName("mul_1"), mul, x);
+  auto mul_2 = ops::Mul(s.WithOpName("mul_2"), mul, mean);
+  auto b_const = ops::Const(s.WithOpName("b_const"), 0.5f, {depth});
+  auto sub = ops::Sub(s.WithOpName("sub"), b_const, mul_2);
+  return ops::AddV2(s.WithOpName("add_2"), mul_1, sub);
+}
+
+// Builds softmax(query * key^T * scale + mask) * value.
+Output MaskedSoftmaxAttentionSubgraph(const Scope& s, Input query, Input key,
+                                      Input value, Input mask, float scale) {
+  auto scores = ops::BatchMatMulV2(s.WithOpName("scores"), query, key,
+                                   ops::BatchMatMulV2::AdjY(true));
+  auto scale_const = ops::Const(s.WithOpName("scale"), scale, {});
+  auto scaled = ops::Mul(s.WithOpName("scaled"), scores, scale_const);
+  auto masked = ops::AddV2(s.WithOpName("masked"), scaled, mask);
+  auto softmax = ops::Softmax(s.WithOpName("softmax"), masked);
+  return ops::BatchMatMulV2(s.WithOpName("attention"), softmax, value);
+}
+
+// Builds Gelu(x * weights + bias) with the exact (Erf) formulation.
+Output MatMulBiasAddGeluExactSubgraph(const Scope& s, Input x, Input weights,
+                                      Input bias) {
+  auto matmul = ops::MatMul(s.WithOpName("matmul"), x, weights);
+  auto bias_add = ops::BiasAdd(s.WithOpName("bias_add"), matmul, bias);
+  auto sqrt_half = ops::Const(s.WithOpName("sqrt_half"), 0.707106f, {});
+  auto mul = ops::Mul(s.WithOpName("mul"), bias_add, sqrt_half);
+  auto erf = ops::Erf(s.WithOpName("erf"), mul);
+  auto one = ops::Const(s.WithOpName("one"), 1.0f, {});
+  auto add = ops::AddV2(s.WithOpName("add"), erf, one);
+  auto half = ops::Const(s.WithOpName("half"), 0.5f, {});
+  auto mul_half = ops::Mul(s.WithOpName("mul_half"), add, half);
+  return ops::Mul(s.WithOpName("gelu"), mul_half, bias_add);
+}
+
+TEST_F(RemapperTest, FuseLayerNorm) {
+  if (IsMKLEnabled()) GTEST_SKIP() << "oneDNN fuses into _MklLayerNorm.";
+  using ::tensorflow::ops::Placeholder;
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+  auto input = Placeholder(s.WithOpName("input"), DT_FLOAT,
+                           ops::Placeholder::Shape({2, 3, 4}));
+  auto add_const = ops::Const(s.WithOpName("add_const"), 1.0f, {2, 3, 4});
+  auto add = ops::Add(s.WithOpName("b_add"), add_const, input);
+  auto layer_norm = LayerNormSubgraph(s, add, /*rank=*/3, /*depth=*/4);
+  auto fetch = ops::Identity(s.WithOpName("fetch"), layer_norm);
+
+  auto input_t = GenerateTensorWithSetRandom<DT_FLOAT>({2, 3, 4});
+
+  GrapplerItem item;
+  item.fetch = {"fetch"};
+  item.feed = {{"input", input_t}};
+  TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+  for (int i = 0; i < item.graph.node_size(); ++i) {
+    item.graph.mutable_node(i)->set_device("/device:CPU:0");
+  }
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  int found = 0;
+  for (const NodeDef& node : output.node()) {
+    if (node.name() == "add_2") {
+      EXPECT_EQ(node.op(), "_FusedLayerNorm");
+      ASSERT_EQ(node.input_size(), 3);
+      EXPECT_EQ(node.input(0), "b_add");
+      EXPECT_EQ(node.input(1), "g_const");
+      EXPECT_EQ(node.input(2), "b_const");
+      EXPECT_FLOAT_EQ(node.attr().at("epsilon").f(), 0.001f);
+      found++;
+    }
+  }
+  EXPECT_EQ(found, 1);
+
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch, item.feed);
+  ASSERT_EQ(tensors_expected.size(), 1);
+  auto tensors = EvaluateNodes(output, item.fetch, item.feed);
+  ASSERT_EQ(tensors.size(), 1);
+  test::ExpectTensorNear<float>(tensors[0], tensors_expected[0], 1e-4);
+}
+
+TEST_F(RemapperTest, FuseMaskedSoftmaxAttention) {
+  if (IsMKLEnabled()) GTEST_SKIP() << "Not fused with oneDNN.";
+  using ::tensorflow::ops::Placeholder;
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+  auto query = Placeholder(s.WithOpName("query"), DT_FLOAT,
+                           ops::Placeholder::Shape({2, 4, 8, 16}));
+  auto key = Placeholder(s.WithOpName("key"), DT_FLOAT,
+                         ops::Placeholder::Shape({2, 4, 10, 16}));
+  auto value = Placeholder(s.WithOpName("value"), DT_FLOAT,
+                           ops::Placeholder::Shape({2, 4, 10, 16}));
+  auto mask = Placeholder(s.WithOpName("mask"), DT_FLOAT,
+                          ops::Placeholder::Shape({2, 1, 1, 10}));
+  auto attention =
+      MaskedSoftmaxAttentionSubgraph(s, query, key, value, mask, 0.25f);
+  auto fetch = ops::Identity(s.WithOpName("fetch"), attention);
+
+  GrapplerItem item;
+  item.fetch = {"fetch"};
+  item.feed = {{"query", GenerateTensorWithSetRandom<DT_FLOAT>({2, 4, 8, 16})},
+               {"key", GenerateTensorWithSetRandom<DT_FLOAT>({2, 4, 10, 16})},
+               {"value", GenerateTensorWithSetRandom<DT_FLOAT>({2, 4, 10, 16})},
+               {"mask", GenerateTensorWithSetRandom<DT_FLOAT>({2, 1, 1, 10})}};
+  TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+  for (int i = 0; i < item.graph.node_size(); ++i) {
+    item.graph.mutable_node(i)->set_device("/device:CPU:0");
+  }
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  int found = 0;
+  for (const NodeDef& node : output.node()) {
+    if (node.name() == "attention") {
+      EXPECT_EQ(node.op(), "_FusedMaskedSoftmaxAttention");
+      ASSERT_EQ(node.input_size(), 4);
+      EXPECT_EQ(node.input(0), "query");
+      EXPECT_EQ(node.input(1), "key");
+      EXPECT_EQ(node.input(2), "value");
+      EXPECT_EQ(node.input(3), "mask");
+      EXPECT_FLOAT_EQ(node.attr().at("scale").f(), 0.25f);
+      found++;
+    }
+  }
+  EXPECT_EQ(found, 1);
+
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch, item.feed);
+  ASSERT_EQ(tensors_expected.size(), 1);
+  auto tensors = EvaluateNodes(output, item.fetch, item.feed);
+  ASSERT_EQ(tensors.size(), 1);
+  test::ExpectTensorNear<float>(tensors[0], tensors_expected[0], 1e-5);
+}
+
+TEST_F(RemapperTest, FuseMatMulWithBiasAddAndGeluExactOnCpu) {
+  using ::tensorflow::ops::Placeholder;
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+  auto x = Placeholder(s.WithOpName("x"), DT_FLOAT,
+                       ops::Placeholder::Shape({8, 32}));
+  auto weights = Placeholder(s.WithOpName("weights"), DT_FLOAT,
+                             ops::Placeholder::Shape({32, 16}));
+  auto bias = Placeholder(s.WithOpName("bias"), DT_FLOAT,
+                          ops::Placeholder::Shape({16}));
+  auto gelu = MatMulBiasAddGeluExactSubgraph(s, x, weights, bias);
+  auto fetch = ops::Identity(s.WithOpName("fetch"), gelu);
+
+  GrapplerItem item;
+  item.fetch = {"fetch"};
+  item.feed = {{"x", GenerateTensorWithSetRandom<DT_FLOAT>({8, 32})},
+               {"weights", GenerateTensorWithSetRandom<DT_FLOAT>({32, 16})},
+               {"bias", GenerateTensorWithSetRandom<DT_FLOAT>({16})}};
+  TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+  for (int i = 0; i < item.graph.node_size(); ++i) {
+    item.graph.mutable_node(i)->set_device("/device:CPU:0");
+  }
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  int found = 0;
+  for (const NodeDef& node : output.node()) {
+    if (node.name() == "gelu") {
+      EXPECT_EQ(node.op(), "_FusedMatMul");
+      ASSERT_GE(node.input_size(), 3);
+      EXPECT_EQ(node.input(0), "x");
+      EXPECT_EQ(node.input(1), "weights");
+      EXPECT_EQ(node.input(2), "bias");
+      const auto fused_ops = node.attr().at("fused_ops").list().s();
+      ASSERT_EQ(fused_ops.size(), 2);
+      EXPECT_EQ(fused_ops[0], "BiasAdd");
+      EXPECT_EQ(fused_ops[1], "GeluExact");
+      found++;
+    }
+  }
+  EXPECT_EQ(found, 1);
+
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch, item.feed);
+  ASSERT_EQ(tensors_expected.size(), 1);
+  auto tensors = EvaluateNodes(output, item.fetch, item.feed);
+  ASSERT_EQ(tensors.size(), 1);
+  test::ExpectTensorNear<float>(tensors[0], tensors_expected[0], 1e-5);
+}
+
+TEST_F(RemapperTest, DoNotFuseMatMulWithBiasAddAndGeluForTraining) {
+  if (IsMKLEnabled()) GTEST_SKIP() << "oneDNN fusions are differentiable.";
+  using ::tensorflow::ops::Placeholder;
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+  auto x = Placeholder(s.WithOpName("x"), DT_FLOAT,
+                       ops::Placeholder::Shape({8, 32}));
+  auto weights = Placeholder(s.WithOpName("weights"), DT_FLOAT,
+                             ops::Placeholder::Shape({32, 16}));
+  auto bias = Placeholder(s.WithOpName("bias"), DT_FLOAT,
+                          ops::Placeholder::Shape({16}));
+  auto gelu = MatMulBiasAddGeluExactSubgraph(s, x, weights, bias);
+  auto fetch = ops::Identity(s.WithOpName("fetch"), gelu);
+
+  GrapplerItem item;
+  item.fetch = {"fetch"};
+  item.optimization_options().allow_non_differentiable_rewrites = false;
+  TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+  for (int i = 0; i < item.graph.node_size(); ++i) {
+    item.graph.mutable_node(i)->set_device("/device:CPU:0");
+  }
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  for (const NodeDef& node : output.node()) {
+    EXPECT_NE(node.op(), "_FusedMatMul") << node.name();
+  }
+}
+
 class RemapperTensorToHashBucketTest : public RemapperTest {
  public:
   template <DataType DTYPE>
@@ -1607,6 +1846,89 @@ TEST_F(RemapperTensorToHashBucketTest, I32) { RunTest<DT_INT32>(); }
 
 TEST_F(RemapperTensorToHashBucketTest, I64) { RunTest<DT_INT64>(); }
 
+class RemapperResourceSparseSegmentReductionTest : public RemapperTest {
+ protected:
+  // Builds an embedding lookup of a variable of 10 rows of 4 columns, combined
+  // by SparseSegmentMeanWithNumSegments, on CPU.
+  void BuildItem(bool gather_has_other_consumer, GrapplerItem* item) {
+    tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+    auto var =
+        ops::VarHandleOp(s.WithOpName("var"), DT_FLOAT, TensorShape({10, 4}));
+    Tensor init_t = GenerateRandomTensor<DT_FLOAT>({10, 4});
+    auto init = ops::Const(s.WithOpName("init"), init_t);
+    auto assign = ops::AssignVariableOp(s.WithOpName("assign"), var, init);
+    auto ids = ops::Const(s.WithOpName("ids"), {7, 2, 9, 2});
+    auto gather = ops::ResourceGather(s.WithOpName("gather"), var, ids,
+                                      DT_FLOAT);
+    auto indices = ops::Const(s.WithOpName("indices"), {0, 1, 2, 3, 1});
+    auto segment_ids = ops::Const(s.WithOpName("segment_ids"), {0, 0, 1, 3, 3});
+    auto num_segments = ops::Const(s.WithOpName("num_segments"), 5);
+    auto mean = ops::SparseSegmentMeanWithNumSegments(
+        s.WithOpName("mean"), gather, indices, segment_ids, num_segments);
+    auto fetch = ops::Identity(s.WithOpName("fetch"), mean);
+    item->fetch = {"fetch"};
+    if (gather_has_other_consumer) {
+      ops::Identity(s.WithOpName("other_fetch"), gather);
+      item->fetch.push_back("other_fetch");
+    }
+    item->init_ops = {"assign"};
+    TF_ASSERT_OK(s.ToGraphDef(&item->graph));
+    for (int i = 0; i < item->graph.node_size(); ++i) {
+      item->graph.mutable_node(i)->set_device("/device:CPU:0");
+    }
+  }
+};
+
+TEST_F(RemapperResourceSparseSegmentReductionTest, Fused) {
+  GrapplerItem item;
+  BuildItem(/*gather_has_other_consumer=*/false, &item);
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  int found = 0;
+  for (const NodeDef& node : output.node()) {
+    EXPECT_NE(node.name(), "gather");
+    if (node.name() == "mean") {
+      EXPECT_EQ(node.op(), "_ResourceSparseSegmentReduction");
+      ASSERT_EQ(node.input_size(), 5);
+      EXPECT_EQ(node.input(0), "var");
+      EXPECT_EQ(node.input(1), "ids");
+      EXPECT_EQ(node.input(2), "indices");
+      EXPECT_EQ(node.input(3), "segment_ids");
+      EXPECT_EQ(node.input(4), "num_segments");
+      EXPECT_EQ(node.attr().at("combiner").s(), "mean");
+      EXPECT_EQ(node.attr().at("num_num_segments").i(), 1);
+      EXPECT_EQ(node.attr().at("num_weights").i(), 0);
+      found++;
+    }
+  }
+  EXPECT_EQ(found, 1);
+
+  auto tensors_expected = EvaluateFetchNodes(item);
+  ASSERT_EQ(tensors_expected.size(), 1);
+  item.graph = std::move(output);
+  auto tensors = EvaluateFetchNodes(item);
+  ASSERT_EQ(tensors.size(), 1);
+  test::ExpectTensorNear<float>(tensors[0], tensors_expected[0], 1e-6);
+}
+
+TEST_F(RemapperResourceSparseSegmentReductionTest, GatherWithOtherConsumer) {
+  GrapplerItem item;
+  BuildItem(/*gather_has_other_consumer=*/true, &item);
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  for (const NodeDef& node : output.node()) {
+    if (node.name() == "mean") {
+      EXPECT_EQ(node.op(), "SparseSegmentMeanWithNumSegments");
+    }
+  }
+}
+
 class RemapperFuseMatMulWithBiasTest : public RemapperTest {
  public:
   template <DataType DTYPE>
@@ -2878,5 +3200,100 @@ TEST_F(RemapperFuseFusedConvWithFusedActivation, Conv3D_BF16) {
   RunTest<3, DT_BFLOAT16>();
 }
 
+// Returns the graph built by `s` with all its nodes on the CPU, rewritten by
+// the remapper if `remap`.
+Graph* RemapperBenchmarkGraph(const Scope& s, bool remap) {
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  for (int i = 0; i < item.graph.node_size(); ++i) {
+    item.graph.mutable_node(i)->set_device("/device:CPU:0");
+  }
+  GraphDef graph_def = item.graph;
+  if (remap) {
+    Remapper optimizer(RewriterConfig::ON);
+    TF_CHECK_OK(optimizer.Optimize(nullptr, item, &graph_def));
+  }
+  Graph* graph = new Graph(OpRegistry::Global());
+  TF_CHECK_OK(
+      ConvertGraphDefToGraph(GraphConstructorOptions(), graph_def, graph));
+  return graph;
+}
+
+Tensor RandomFloatTensor(const TensorShape& shape) {
+  Tensor tensor(DT_FLOAT, shape);
+  tensor.flat<float>().setRandom();
+  return tensor;
+}
+
+// Arguments: rows, depth, remap.
+static void BM_LayerNorm(::testing::benchmark::State& state) {
+  const int rows = state.range(0);
+  const int depth = state.range(1);
+  const bool remap = state.range(2);
+  Scope s = Scope::NewRootScope();
+  auto x = ops::Const(s.WithOpName("x"), RandomFloatTensor({rows, depth}));
+  LayerNormSubgraph(s, x, /*rank=*/2, depth);
+  test::Benchmark("cpu", RemapperBenchmarkGraph(s, remap),
+                  /*old_benchmark_api=*/false)
+      .Run(state);
+  state.SetItemsProcessed(state.iterations() * rows * depth);
+}
+BENCHMARK(BM_LayerNorm)
+    ->UseRealTime()
+    ->Args({512, 768, 0})
+    ->Args({512, 768, 1})
+    ->Args({4096, 1024, 0})
+    ->Args({4096, 1024, 1});
+
+// Arguments: heads, sequence length, depth, remap.
+static void BM_MaskedSoftmaxAttention(::testing::benchmark::State& state) {
+  const int heads = state.range(0);
+  const int length = state.range(1);
+  const int depth = state.range(2);
+  const bool remap = state.range(3);
+  Scope s = Scope::NewRootScope();
+  const TensorShape shape({1, heads, length, depth});
+  auto query = ops::Const(s.WithOpName("query"), RandomFloatTensor(shape));
+  auto key = ops::Const(s.WithOpName("key"), RandomFloatTensor(shape));
+  auto value = ops::Const(s.WithOpName("value"), RandomFloatTensor(shape));
+  auto mask = ops::Const(s.WithOpName("mask"),
+                         RandomFloatTensor({1, 1, length, length}));
+  MaskedSoftmaxAttentionSubgraph(s, query, key, value, mask,
+                                 1.0f / std::sqrt(depth));
+  test::Benchmark("cpu", RemapperBenchmarkGraph(s, remap),
+                  /*old_benchmark_api=*/false)
+      .Run(state);
+  state.SetItemsProcessed(state.iterations() * heads * length * length *
+                          depth * 4);
+}
+BENCHMARK(BM_MaskedSoftmaxAttention)
+    ->UseRealTime()
+    ->Args({12, 128, 64, 0})
+    ->Args({12, 128, 64, 1})
+    ->Args({12, 512, 64, 0})
+    ->Args({12, 512, 64, 1});
+
+// Arguments: rows, input depth, output depth, remap.
+static void BM_MatMulBiasAddGeluExact(::testing::benchmark::State& state) {
+  const int rows = state.range(0);
+  const int depth = state.range(1);
+  const int units = state.range(2);
+  const bool remap = state.range(3);
+  Scope s = Scope::NewRootScope();
+  auto x = ops::Const(s.WithOpName("x"), RandomFloatTensor({rows, depth}));
+  auto weights =
+      ops::Const(s.WithOpName("weights"), RandomFloatTensor({depth, units}));
+  auto bias = ops::Const(s.WithOpName("bias"), RandomFloatTensor({units}));
+  MatMulBiasAddGeluExactSubgraph(s, x, weights, bias);
+  test::Benchmark("cpu", RemapperBenchmarkGraph(s, remap),
+                  /*old_benchmark_api=*/false)
+      .Run(state);
+  state.SetItemsProcessed(state.iterations() * rows * depth * units * 2);
+}
+BENCHMARK(BM_MatMulBiasAddGeluExact)
+    ->UseRealTime()
+    ->Args({128, 768, 3072, 0})
+    ->Args({128, 768, 3072, 1});
+
 }  // namespace grappler
 }  // namespace tensorflow
@@ -86,6 +86,7 @@ class ResourceCountUpToOp : public OpKernel {
     OP_REQUIRES_OK(context, context->allocate_temp(dtype_, TensorShape({}),
                                                    variable->tensor(), attr));
     variable->tensor()->scalar<T>()() = before_increment.scalar<T>()() + 1;
+    variable->MarkUpdated();
     context->set_output(0, before_increment);
   }
 
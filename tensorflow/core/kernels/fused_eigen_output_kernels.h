@@ -21,7 +21,7 @@ limitations under the License.
 //   (1) {Conv2D/MatMul} + BiasAdd + <Activation>
 //   (2) {Conv2D/MatMul} + FusedBatchNorm + <Activation>
 //
-// Activation: Relu, Relu6, Elu, etc...
+// Activation: Relu, Relu6, Elu, Gelu, etc...
 
 #ifndef TENSORFLOW_CORE_KERNELS_FUSED_EIGEN_OUTPUT_KERNELS_H_
 #define TENSORFLOW_CORE_KERNELS_FUSED_EIGEN_OUTPUT_KERNELS_H_
@@ -151,6 +151,32 @@ struct LeakyRelu {
   };
 };
 
+// Applies the tanh approximation of `Gelu` to the passed input expression:
+//   0.5 * x * (1 + tanh(sqrt(2 / pi) * (x + 0.044715 * x^3)))
+struct GeluApproximate {
+  template <typename XprType>
+  static auto apply(XprType expr) {
+    using Scalar = typename XprType::Scalar;
+    const auto inner =
+        (expr + expr.cube() * expr.constant(static_cast<Scalar>(0.044715f))) *
+        expr.constant(static_cast<Scalar>(0.7978845608f));
+    return expr * expr.constant(static_cast<Scalar>(0.5f)) *
+           (inner.tanh() + expr.constant(static_cast<Scalar>(1)));
+  };
+};
+
+// Applies `Gelu` to the passed input expression:
+//   0.5 * x * (1 + erf(x / sqrt(2)))
+struct GeluExact {
+  template <typename XprType>
+  static auto apply(XprType expr) {
+    using Scalar = typename XprType::Scalar;
+    return expr * expr.constant(static_cast<Scalar>(0.5f)) *
+           ((expr * expr.constant(static_cast<Scalar>(0.7071067812f))).erf() +
+            expr.constant(static_cast<Scalar>(1)));
+  };
+};
+
 template <typename T>
 struct BiasAddArgs {
   const T* bias_add_data = nullptr;
@@ -163,7 +189,9 @@ struct BiasAddArgs {
            fusion == FusedComputationType::kBiasAddWithTanh ||
            fusion == FusedComputationType::kBiasAddWithSigmoid ||
            fusion == FusedComputationType::kBiasAddWithElu ||
-           fusion == FusedComputationType::kBiasAddWithLeakyRelu;
+           fusion == FusedComputationType::kBiasAddWithLeakyRelu ||
+           fusion == FusedComputationType::kBiasAddWithGeluApproximate ||
+           fusion == FusedComputationType::kBiasAddWithGeluExact;
   }
 };
 
@@ -398,6 +426,10 @@ using WithBiasAddAndElu = BiasAddOutputKernel<T, Elu>;
 template <typename T>
 using WithBiasAddAndLeakyRelu = BiasAddOutputKernel<T, LeakyRelu>;
 template <typename T>
+using WithBiasAddAndGeluApproximate = BiasAddOutputKernel<T, GeluApproximate>;
+template <typename T>
+using WithBiasAddAndGeluExact = BiasAddOutputKernel<T, GeluExact>;
+template <typename T>
 using WithFusedBatchNorm = FusedBatchNormOutputKernel<T>;
 template <typename T>
 using WithFusedBatchNormAndRelu = FusedBatchNormOutputKernel<T, Relu>;
@@ -0,0 +1,111 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/nn_ops.cc.
+
+#define EIGEN_USE_THREADS
+
+#include "Eigen/Core"  // from @eigen_archive
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+// The remapper replaces the Mean, SquaredDifference, Rsqrt, Mul, Sub and Add
+// ops (or the Reshape and FusedBatchNormV3 ops used by Keras) of a layer
+// normalization with this kernel, which normalizes each row of the input while
+// it is in cache instead of materializing every intermediate tensor.
+template <typename T>
+class FusedLayerNormOp : public OpKernel {
+ public:
+  explicit FusedLayerNormOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("epsilon", &epsilon_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& x = context->input(0);
+    const Tensor& scale = context->input(1);
+    const Tensor& offset = context->input(2);
+
+    OP_REQUIRES(context, x.dims() >= 1,
+                errors::InvalidArgument("x must be at least 1-dimensional: ",
+                                        x.shape().DebugString()));
+    const int64_t depth = x.dim_size(x.dims() - 1);
+    OP_REQUIRES(context,
+                TensorShapeUtils::IsVector(scale.shape()) &&
+                    scale.NumElements() == depth,
+                errors::InvalidArgument("scale must have shape [", depth,
+                                        "]: ", scale.shape().DebugString()));
+    OP_REQUIRES(context,
+                TensorShapeUtils::IsVector(offset.shape()) &&
+                    offset.NumElements() == depth,
+                errors::InvalidArgument("offset must have shape [", depth,
+                                        "]: ", offset.shape().DebugString()));
+
+    Tensor* y = nullptr;
+    OP_REQUIRES_OK(context, context->forward_input_or_allocate_output(
+                                {0}, 0, x.shape(), &y));
+    if (x.NumElements() == 0) return;
+
+    using Array = Eigen::Array<T, Eigen::Dynamic, 1>;
+    using ConstArrayMap = Eigen::Map<const Array>;
+    using ArrayMap = Eigen::Map<Array>;
+
+    const int64_t rows = x.NumElements() / depth;
+    const T* x_data = x.flat<T>().data();
+    T* y_data = y->flat<T>().data();
+    const ConstArrayMap scale_row(scale.flat<T>().data(), depth);
+    const ConstArrayMap offset_row(offset.flat<T>().data(), depth);
+    const T epsilon = static_cast<T>(epsilon_);
+
+    auto normalize = [&](int64_t begin, int64_t end) {
+      for (int64_t row = begin; row < end; ++row) {
+        const ConstArrayMap in(x_data + row * depth, depth);
+        ArrayMap out(y_data + row * depth, depth);
+        const T mean = in.mean();
+        // `out` may alias `in`, so the centered row is computed once into
+        // `out` and normalized in place.
+        out = in - mean;
+        const T variance = out.square().mean();
+        const T inv_stddev = T(1) / Eigen::numext::sqrt(variance + epsilon);
+        out = out * (scale_row * inv_stddev) + offset_row;
+      }
+    };
+
+    const DeviceBase::CpuWorkerThreads& worker_threads =
+        *(context->device()->tensorflow_cpu_worker_threads());
+    // Two passes over the row for the moments, one to normalize it.
+    const int64_t cost_per_row = 8 * depth;
+    Shard(worker_threads.num_threads, worker_threads.workers, rows,
+          cost_per_row, normalize);
+  }
+
+ private:
+  float epsilon_;
+};
+
+#define REGISTER_CPU(T)                                                    \
+  REGISTER_KERNEL_BUILDER(                                                 \
+      Name("_FusedLayerNorm").Device(DEVICE_CPU).TypeConstraint<T>("T"), \
+      FusedLayerNormOp<T>);
+
+TF_CALL_float(REGISTER_CPU);
+#undef REGISTER_CPU
+
+}  // namespace tensorflow
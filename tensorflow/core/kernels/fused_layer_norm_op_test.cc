@@ -0,0 +1,86 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cmath>
+
+#include "absl/strings/match.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+class FusedLayerNormOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(float epsilon) {
+    TF_ASSERT_OK(NodeDefBuilder("fused_layer_norm", "_FusedLayerNorm")
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Attr("epsilon", epsilon)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+};
+
+TEST_F(FusedLayerNormOpTest, NormalizesInnermostDimension) {
+  constexpr float kEpsilon = 0.001f;
+  MakeOp(kEpsilon);
+  const TensorShape shape({2, 3, 4});
+  Tensor x(DT_FLOAT, shape);
+  x.flat<float>().setRandom();
+  AddInputFromArray<float>(
+      shape, absl::Span<const float>(x.flat<float>().data(), x.NumElements()));
+  AddInputFromArray<float>(TensorShape({4}), {1.0f, 2.0f, 0.5f, -1.0f});
+  AddInputFromArray<float>(TensorShape({4}), {0.0f, 0.1f, -0.2f, 3.0f});
+  TF_ASSERT_OK(RunOpKernel());
+
+  const float scale[] = {1.0f, 2.0f, 0.5f, -1.0f};
+  const float offset[] = {0.0f, 0.1f, -0.2f, 3.0f};
+  Tensor expected(DT_FLOAT, shape);
+  auto in = x.flat_inner_dims<float>();
+  auto out = expected.flat_inner_dims<float>();
+  for (int row = 0; row < 6; ++row) {
+    float mean = 0, variance = 0;
+    for (int i = 0; i < 4; ++i) mean += in(row, i) / 4;
+    for (int i = 0; i < 4; ++i) {
+      variance += (in(row, i) - mean) * (in(row, i) - mean) / 4;
+    }
+    for (int i = 0; i < 4; ++i) {
+      out(row, i) = (in(row, i) - mean) / std::sqrt(variance + kEpsilon) *
+                        scale[i] +
+                    offset[i];
+    }
+  }
+  test::ExpectClose(expected, *GetOutput(0), /*atol=*/1e-5, /*rtol=*/1e-5);
+}
+
+TEST_F(FusedLayerNormOpTest, ScaleMustMatchDepth) {
+  MakeOp(0.001f);
+  AddInputFromArray<float>(TensorShape({2, 2}), {1, 2, 3, 4});
+  AddInputFromArray<float>(TensorShape({3}), {1, 1, 1});
+  AddInputFromArray<float>(TensorShape({2}), {0, 0});
+  Status s = RunOpKernel();
+  EXPECT_EQ(error::INVALID_ARGUMENT, s.code());
+  EXPECT_TRUE(absl::StrContains(s.message(), "scale must have shape [2]"));
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,212 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/nn_ops.cc.
+
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <vector>
+
+#include "Eigen/Core"  // from @eigen_archive
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Number of attention scores computed at once by a thread, sized to keep the
+// block of scores in L2 cache while it is used for the softmax and the second
+// matrix multiplication.
+constexpr int64_t kScoresBlockSize = 16 * 1024;
+
+}  // namespace
+
+// The remapper replaces the BatchMatMul, Mul, Add, Softmax and BatchMatMul ops
+// of a masked scaled dot-product attention with this kernel, which computes
+// the attention for a block of query rows at a time, so that the
+// [batch..., num_queries, num_keys] scores never leave the cache.
+template <typename T>
+class FusedMaskedSoftmaxAttentionOp : public OpKernel {
+ public:
+  explicit FusedMaskedSoftmaxAttentionOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("scale", &scale_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& query = context->input(0);
+    const Tensor& key = context->input(1);
+    const Tensor& value = context->input(2);
+    const Tensor& mask = context->input(3);
+
+    const int rank = query.dims();
+    OP_REQUIRES(context, rank >= 2,
+                errors::InvalidArgument(
+                    "query must be at least 2-dimensional: ",
+                    query.shape().DebugString()));
+    OP_REQUIRES(context, key.dims() == rank && value.dims() == rank,
+                errors::InvalidArgument(
+                    "query, key and value must have the same rank: ",
+                    query.shape().DebugString(), " vs. ",
+                    key.shape().DebugString(), " vs. ",
+                    value.shape().DebugString()));
+    int64_t batch_size = 1;
+    for (int i = 0; i < rank - 2; ++i) {
+      OP_REQUIRES(context,
+                  key.dim_size(i) == query.dim_size(i) &&
+                      value.dim_size(i) == query.dim_size(i),
+                  errors::InvalidArgument(
+                      "query, key and value must have the same batch "
+                      "dimensions: ",
+                      query.shape().DebugString(), " vs. ",
+                      key.shape().DebugString(), " vs. ",
+                      value.shape().DebugString()));
+      batch_size *= query.dim_size(i);
+    }
+    const int64_t num_queries = query.dim_size(rank - 2);
+    const int64_t depth = query.dim_size(rank - 1);
+    const int64_t num_keys = key.dim_size(rank - 2);
+    const int64_t value_depth = value.dim_size(rank - 1);
+    OP_REQUIRES(context,
+                key.dim_size(rank - 1) == depth &&
+                    value.dim_size(rank - 2) == num_keys,
+                errors::InvalidArgument(
+                    "Incompatible query, key and value shapes: ",
+                    query.shape().DebugString(), " vs. ",
+                    key.shape().DebugString(), " vs. ",
+                    value.shape().DebugString()));
+
+    // The mask is broadcast to the [batch..., num_queries, num_keys] scores:
+    // its dimensions are aligned with the innermost dimensions of the scores,
+    // and a dimension of size 1 has a stride of 0.
+    OP_REQUIRES(context, mask.dims() <= rank,
+                errors::InvalidArgument("mask of shape ",
+                                        mask.shape().DebugString(),
+                                        " is not broadcastable to the scores"));
+    TensorShape scores_shape = query.shape();
+    scores_shape.set_dim(rank - 1, num_keys);
+    std::vector<int64_t> mask_strides(rank, 0);
+    int64_t stride = 1;
+    for (int i = mask.dims() - 1, j = rank - 1; i >= 0; --i, --j) {
+      const int64_t size = mask.dim_size(i);
+      OP_REQUIRES(context, size == 1 || size == scores_shape.dim_size(j),
+                  errors::InvalidArgument(
+                      "mask of shape ", mask.shape().DebugString(),
+                      " is not broadcastable to the scores of shape ",
+                      scores_shape.DebugString()));
+      if (size != 1) mask_strides[j] = stride;
+      stride *= size;
+    }
+
+    TensorShape output_shape = query.shape();
+    output_shape.set_dim(rank - 1, value_depth);
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(0, output_shape, &output));
+    if (output->NumElements() == 0) return;
+    if (num_keys == 0) {
+      // Weighted sums of no values.
+      output->flat<T>().setZero();
+      return;
+    }
+
+    using Matrix =
+        Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+    using ConstMatrixMap = Eigen::Map<const Matrix>;
+    using MatrixMap = Eigen::Map<Matrix>;
+
+    const int64_t block_rows = std::min(
+        num_queries, std::max<int64_t>(1, kScoresBlockSize / num_keys));
+    const int64_t blocks_per_batch =
+        (num_queries + block_rows - 1) / block_rows;
+    const T* query_data = query.flat<T>().data();
+    const T* key_data = key.flat<T>().data();
+    const T* value_data = value.flat<T>().data();
+    const T* mask_data = mask.flat<T>().data();
+    T* output_data = output->flat<T>().data();
+    const T scale = static_cast<T>(scale_);
+
+    auto attend = [&](int64_t begin, int64_t end) {
+      Matrix scores(block_rows, num_keys);
+      for (int64_t block = begin; block < end; ++block) {
+        const int64_t batch = block / blocks_per_batch;
+        const int64_t first_row = (block % blocks_per_batch) * block_rows;
+        const int64_t rows = std::min(block_rows, num_queries - first_row);
+
+        int64_t mask_offset = 0;
+        for (int64_t i = rank - 3, b = batch; i >= 0; --i) {
+          mask_offset += (b % query.dim_size(i)) * mask_strides[i];
+          b /= query.dim_size(i);
+        }
+
+        const ConstMatrixMap q(
+            query_data + (batch * num_queries + first_row) * depth, rows,
+            depth);
+        const ConstMatrixMap k(key_data + batch * num_keys * depth, num_keys,
+                               depth);
+        const ConstMatrixMap v(value_data + batch * num_keys * value_depth,
+                               num_keys, value_depth);
+        MatrixMap out(
+            output_data + (batch * num_queries + first_row) * value_depth,
+            rows, value_depth);
+        auto block_scores = scores.topRows(rows);
+
+        block_scores.noalias() = q * k.transpose();
+        for (int64_t r = 0; r < rows; ++r) {
+          auto row = block_scores.row(r).array();
+          row *= scale;
+          const T* mask_row =
+              mask_data + mask_offset +
+              (first_row + r) * mask_strides[rank - 2];
+          if (mask_strides[rank - 1] == 0) {
+            row += mask_row[0];
+          } else {
+            row += Eigen::Map<const Eigen::Array<T, 1, Eigen::Dynamic>>(
+                mask_row, num_keys);
+          }
+          row = (row - row.maxCoeff()).exp();
+          row /= row.sum();
+        }
+        out.noalias() = block_scores * v;
+      }
+    };
+
+    const DeviceBase::CpuWorkerThreads& worker_threads =
+        *(context->device()->tensorflow_cpu_worker_threads());
+    const int64_t cost_per_block =
+        block_rows * num_keys * (2 * depth + 2 * value_depth + 16);
+    Shard(worker_threads.num_threads, worker_threads.workers,
+          batch_size * blocks_per_batch, cost_per_block, attend);
+  }
+
+ private:
+  float scale_;
+};
+
+#define REGISTER_CPU(T)                                          \
+  REGISTER_KERNEL_BUILDER(Name("_FusedMaskedSoftmaxAttention")   \
+                              .Device(DEVICE_CPU)                \
+                              .TypeConstraint<T>("T"),           \
+                          FusedMaskedSoftmaxAttentionOp<T>);
+
+TF_CALL_float(REGISTER_CPU);
+#undef REGISTER_CPU
+
+}  // namespace tensorflow
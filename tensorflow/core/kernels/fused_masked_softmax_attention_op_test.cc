@@ -0,0 +1,143 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+class FusedMaskedSoftmaxAttentionOpTest : public OpsTestBase {
+ protected:
+  // Runs the attention of a [batch, heads, num_queries, depth] query on
+  // [batch, heads, num_keys, depth] keys and values with a mask of
+  // `mask_shape`, and compares it with the unfused computation.
+  void RunAndVerify(int64_t batch, int64_t heads, int64_t num_queries,
+                    int64_t num_keys, int64_t depth,
+                    const TensorShape& mask_shape) {
+    constexpr float kScale = 0.25f;
+    TF_ASSERT_OK(NodeDefBuilder("attention", "_FusedMaskedSoftmaxAttention")
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Attr("scale", kScale)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+
+    Tensor query(DT_FLOAT, TensorShape({batch, heads, num_queries, depth}));
+    Tensor key(DT_FLOAT, TensorShape({batch, heads, num_keys, depth}));
+    Tensor value(DT_FLOAT, TensorShape({batch, heads, num_keys, depth}));
+    Tensor mask(DT_FLOAT, mask_shape);
+    for (Tensor* t : {&query, &key, &value, &mask}) {
+      t->flat<float>().setRandom();
+      AddInputFromArray<float>(
+          t->shape(),
+          absl::Span<const float>(t->flat<float>().data(), t->NumElements()));
+    }
+    TF_ASSERT_OK(RunOpKernel());
+
+    // The mask broadcast to the [batch, heads, num_queries, num_keys] scores.
+    std::vector<int64_t> mask_dims(4 - mask_shape.dims(), 1);
+    for (int64_t d : mask_shape.dim_sizes()) mask_dims.push_back(d);
+    auto mask_at = [&](int64_t b, int64_t h, int64_t i, int64_t j) {
+      const int64_t index[] = {b, h, i, j};
+      int64_t offset = 0;
+      for (int d = 0; d < 4; ++d) {
+        offset = offset * mask_dims[d] + (mask_dims[d] == 1 ? 0 : index[d]);
+      }
+      return mask.flat<float>()(offset);
+    };
+
+    Tensor expected(DT_FLOAT, query.shape());
+    auto q = query.tensor<float, 4>();
+    auto k = key.tensor<float, 4>();
+    auto v = value.tensor<float, 4>();
+    auto out = expected.tensor<float, 4>();
+    std::vector<double> scores(num_keys);
+    for (int64_t b = 0; b < batch; ++b) {
+      for (int64_t h = 0; h < heads; ++h) {
+        for (int64_t i = 0; i < num_queries; ++i) {
+          double max_score = -INFINITY;
+          for (int64_t j = 0; j < num_keys; ++j) {
+            double dot = 0;
+            for (int64_t d = 0; d < depth; ++d) {
+              dot += q(b, h, i, d) * k(b, h, j, d);
+            }
+            scores[j] = dot * kScale + mask_at(b, h, i, j);
+            max_score = std::max(max_score, scores[j]);
+          }
+          double sum = 0;
+          for (double& score : scores) {
+            score = std::exp(score - max_score);
+            sum += score;
+          }
+          for (int64_t d = 0; d < depth; ++d) {
+            double weighted = 0;
+            for (int64_t j = 0; j < num_keys; ++j) {
+              weighted += scores[j] / sum * v(b, h, j, d);
+            }
+            out(b, h, i, d) = weighted;
+          }
+        }
+      }
+    }
+    test::ExpectClose(expected, *GetOutput(0), /*atol=*/1e-5, /*rtol=*/1e-4);
+  }
+};
+
+TEST_F(FusedMaskedSoftmaxAttentionOpTest, PaddingMask) {
+  RunAndVerify(2, 3, 5, 7, 4, TensorShape({2, 1, 1, 7}));
+}
+
+TEST_F(FusedMaskedSoftmaxAttentionOpTest, CausalMask) {
+  RunAndVerify(2, 3, 7, 7, 4, TensorShape({7, 7}));
+}
+
+TEST_F(FusedMaskedSoftmaxAttentionOpTest, FullMask) {
+  RunAndVerify(1, 2, 3, 5, 8, TensorShape({1, 2, 3, 5}));
+}
+
+TEST_F(FusedMaskedSoftmaxAttentionOpTest, ManyBlocksOfQueries) {
+  // The scores of a batch do not fit in one block.
+  RunAndVerify(1, 2, 40, 1000, 8, TensorShape({1, 1, 1, 1000}));
+}
+
+TEST_F(FusedMaskedSoftmaxAttentionOpTest, MaskMustBeBroadcastable) {
+  TF_ASSERT_OK(NodeDefBuilder("attention", "_FusedMaskedSoftmaxAttention")
+                   .Input(FakeInput(DT_FLOAT))
+                   .Input(FakeInput(DT_FLOAT))
+                   .Input(FakeInput(DT_FLOAT))
+                   .Input(FakeInput(DT_FLOAT))
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  AddInputFromArray<float>(TensorShape({1, 2, 2}), {1, 2, 3, 4});
+  AddInputFromArray<float>(TensorShape({1, 3, 2}), {1, 2, 3, 4, 5, 6});
+  AddInputFromArray<float>(TensorShape({1, 3, 2}), {1, 2, 3, 4, 5, 6});
+  AddInputFromArray<float>(TensorShape({2}), {0, 0});
+  EXPECT_EQ(error::INVALID_ARGUMENT, RunOpKernel().code());
+}
+
+}  // namespace
+}  // namespace tensorflow
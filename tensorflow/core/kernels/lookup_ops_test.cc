@@ -15,16 +15,28 @@ limitations under the License.
 
 // Tests kernels of lookup ops.
 
+#include <string>
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
 #include "tensorflow/core/framework/fake_input.h"
 #include "tensorflow/core/framework/lookup_interface.h"
 #include "tensorflow/core/framework/node_def_builder.h"
 #include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/framework/shape_inference_testutil.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
 #include "tensorflow/core/kernels/lookup_table_op.h"
 #include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/kernels/perfect_hash_table.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/public/session_options.h"
 
 namespace tensorflow {
 namespace {
@@ -100,5 +112,172 @@ TEST_F(LookupOpsTest, AnonymousHashTable_RefCounting) {
   EXPECT_FALSE(alive);
 }
 
+class PerfectHashTableOpTest : public OpsTestBase {
+ protected:
+  // Writes a table mapping "brain" to 1 and "surgery" to 2.
+  void SetUp() override {
+    filename_ = io::JoinPath(testing::TmpDir(), "perfect_hash_table_op");
+    lookup::PerfectHashTableBuilder builder(DT_STRING, DT_INT64);
+    TF_ASSERT_OK(builder.Add("brain", 1));
+    TF_ASSERT_OK(builder.Add("surgery", 2));
+    TF_ASSERT_OK(builder.Write(Env::Default(), filename_));
+  }
+
+  // Runs a PerfectHashTable op of the file, and sets `table_` to its output.
+  Status MakeTable(DataType key_dtype, DataType value_dtype) {
+    // A shared table outlives its kernel, which the next op replaces.
+    TF_RETURN_IF_ERROR(NodeDefBuilder("table", "PerfectHashTable")
+                           .Attr("filename", filename_)
+                           .Attr("shared_name", "table")
+                           .Attr("key_dtype", key_dtype)
+                           .Attr("value_dtype", value_dtype)
+                           .Finalize(node_def()));
+    TF_RETURN_IF_ERROR(InitOp());
+    TF_RETURN_IF_ERROR(RunOpKernel());
+    table_ = *GetOutput(0);
+    return OkStatus();
+  }
+
+  Status Find(const std::vector<tstring>& keys, int64_t default_value) {
+    TF_RETURN_IF_ERROR(NodeDefBuilder("find", "LookupTableFindV2")
+                           .Input(FakeInput(DT_RESOURCE))
+                           .Input(FakeInput(DT_STRING))
+                           .Input(FakeInput(DT_INT64))
+                           .Finalize(node_def()));
+    TF_RETURN_IF_ERROR(InitOp());
+    inputs_.clear();
+    AddInputFromArray<ResourceHandle>(TensorShape({}),
+                                      {table_.scalar<ResourceHandle>()()});
+    AddInputFromArray<tstring>(
+        TensorShape({static_cast<int64_t>(keys.size())}), keys);
+    AddInputFromArray<int64_t>(TensorShape({}), {default_value});
+    return RunOpKernel();
+  }
+
+  std::string filename_;
+  Tensor table_;
+};
+
+TEST_F(PerfectHashTableOpTest, FindAndSize) {
+  TF_ASSERT_OK(MakeTable(DT_STRING, DT_INT64));
+
+  TF_ASSERT_OK(Find({"surgery", "brain", "brains", ""}, -1));
+  test::ExpectTensorEqual<int64_t>(test::AsTensor<int64_t>({2, 1, -1, -1}),
+                                   *GetOutput(0));
+
+  TF_ASSERT_OK(NodeDefBuilder("size", "LookupTableSizeV2")
+                   .Input(FakeInput(DT_RESOURCE))
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  inputs_.clear();
+  AddInputFromArray<ResourceHandle>(TensorShape({}),
+                                    {table_.scalar<ResourceHandle>()()});
+  TF_ASSERT_OK(RunOpKernel());
+  test::ExpectTensorEqual<int64_t>(test::AsScalar<int64_t>(2),
+                                   *GetOutput(0));
+}
+
+TEST_F(PerfectHashTableOpTest, FileDtypeMismatch) {
+  Status s = MakeTable(DT_INT64, DT_INT64);
+  EXPECT_TRUE(absl::StrContains(
+      s.ToString(), "maps string keys to int64 values, expected int64 keys"))
+      << s;
+  s = MakeTable(DT_STRING, DT_STRING);
+  EXPECT_TRUE(absl::StrContains(
+      s.ToString(), "maps string keys to int64 values, expected string keys "
+                    "and string values"))
+      << s;
+}
+
+TEST_F(PerfectHashTableOpTest, FindDtypeMismatch) {
+  TF_ASSERT_OK(MakeTable(DT_STRING, DT_INT64));
+
+  TF_ASSERT_OK(NodeDefBuilder("find", "LookupTableFindV2")
+                   .Input(FakeInput(DT_RESOURCE))
+                   .Input(FakeInput(DT_INT64))
+                   .Input(FakeInput(DT_STRING))
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  inputs_.clear();
+  AddInputFromArray<ResourceHandle>(TensorShape({}),
+                                    {table_.scalar<ResourceHandle>()()});
+  AddInputFromArray<int64_t>(TensorShape({1}), {1});
+  AddInputFromArray<tstring>(TensorShape({}), {"missing"});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(absl::StrContains(s.ToString(), "Signature mismatch")) << s;
+}
+
+// Adds a MutableHashTableV2 of int64 keys and values, shared by all the graphs
+// run on the benchmark's device.
+Node* MutableHashTable(Graph* g) {
+  Node* table;
+  TF_CHECK_OK(NodeBuilder(g->NewName("table"), "MutableHashTableV2")
+                  .Attr("key_dtype", DT_INT64)
+                  .Attr("value_dtype", DT_INT64)
+                  .Attr("shared_name", "benchmark_table")
+                  .Finalize(g, &table));
+  return table;
+}
+
+Node* Keys(Graph* g, int64_t num_keys, int64_t stride, int64_t modulo) {
+  Tensor keys(DT_INT64, TensorShape({num_keys}));
+  auto keys_flat = keys.flat<int64_t>();
+  for (int64_t i = 0; i < num_keys; ++i) {
+    keys_flat(i) = (i * stride) % modulo;
+  }
+  return test::graph::Constant(g, keys);
+}
+
+// Looks up batches of `batch_size` keys of a table of `table_size` entries,
+// with `num_lookups` LookupTableFindV2 ops running concurrently on as many
+// inter-op threads.
+void BM_MutableHashTableFind(::testing::benchmark::State& state) {
+  const int num_lookups = state.range(0);
+  const int batch_size = state.range(1);
+  constexpr int64_t kTableSize = 1 << 20;
+
+  Graph* init = new Graph(OpRegistry::Global());
+  {
+    Node* keys = Keys(init, kTableSize, 1, kTableSize);
+    Node* insert;
+    TF_CHECK_OK(NodeBuilder(init->NewName("insert"), "LookupTableInsertV2")
+                    .Input(MutableHashTable(init))
+                    .Input(keys)
+                    .Input(keys)
+                    .Finalize(init, &insert));
+  }
+
+  Graph* g = new Graph(OpRegistry::Global());
+  Node* table = MutableHashTable(g);
+  Node* default_value = test::graph::Constant(g, test::AsScalar<int64_t>(-1));
+  for (int i = 0; i < num_lookups; ++i) {
+    // Keys spread over the table, different for each lookup.
+    Node* keys = Keys(g, batch_size, 7919 * (i + 1), kTableSize);
+    Node* find;
+    TF_CHECK_OK(NodeBuilder(g->NewName("find"), "LookupTableFindV2")
+                    .Input(table)
+                    .Input(keys)
+                    .Input(default_value)
+                    .Finalize(g, &find));
+  }
+
+  SessionOptions options;
+  options.config.set_inter_op_parallelism_threads(num_lookups);
+  options.config.set_intra_op_parallelism_threads(1);
+  test::Benchmark("cpu", g, &options, init, nullptr, "",
+                  /*old_benchmark_api=*/false)
+      .Run(state);
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          num_lookups * batch_size);
+}
+BENCHMARK(BM_MutableHashTableFind)
+    ->UseRealTime()
+    ->ArgPair(1, 1)
+    ->ArgPair(1, 1024)
+    ->ArgPair(8, 1)
+    ->ArgPair(8, 1024)
+    ->ArgPair(32, 1)
+    ->ArgPair(32, 1024);
+
 }  // namespace
 }  // namespace tensorflow
@@ -16,14 +16,19 @@ limitations under the License.
 #include "tensorflow/core/kernels/lookup_table_op.h"
 #define EIGEN_USE_THREADS
 
+#include <array>
 #include <string>
 #include <type_traits>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/variant.h"
 #include "tensorflow/core/kernels/initializable_lookup_table.h"
+#include "tensorflow/core/kernels/perfect_hash_table.h"
+#include "tensorflow/core/lib/gtl/cleanup.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/lib/hash/hash.h"
 #include "tensorflow/core/platform/random.h"
@@ -36,7 +41,150 @@ std::string UniqueNodeName(const std::string& base) {
   return strings::StrCat(base, "/", counter.fetch_add(1), "/", random::New64());
 }
 
-// Lookup table that wraps an unordered_map, where the key and value data type
+// An unordered_map split into shards that are locked independently, so that
+// concurrent lookups and updates mostly take different locks. Operations on a
+// batch of keys group the keys by shard and take the lock of each shard once.
+template <class K, class V>
+class ShardedHashMap {
+ public:
+  using Map = std::unordered_map<K, V>;
+  static constexpr int kNumShards = 16;
+  using Maps = std::array<const Map*, kNumShards>;
+
+  size_t size() const {
+    size_t size = 0;
+    for (const Shard& shard : shards_) {
+      tf_shared_lock l(shard.mu);
+      size += shard.map.size();
+    }
+    return size;
+  }
+
+  // Calls `fn(map, key, i)` for each key `keys(i)`, with `map` its shard
+  // locked for reading.
+  template <class Keys, class Fn>
+  void ReadBatch(const Keys& keys, Fn fn) const {
+    GroupByShard(keys, [&](int index, const int64_t* begin,
+                           const int64_t* end) {
+      const Shard& shard = shards_[index];
+      tf_shared_lock l(shard.mu);
+      for (const int64_t* i = begin; i != end; ++i) {
+        fn(shard.map, SubtleMustCopyIfIntegral(keys(*i)), *i);
+      }
+    });
+  }
+
+  // Calls `fn(map, key, i)` for each key `keys(i)`, with `map` its shard
+  // locked for writing.
+  template <class Keys, class Fn>
+  void WriteBatch(const Keys& keys, Fn fn) {
+    GroupByShard(keys, [&](int index, const int64_t* begin,
+                           const int64_t* end) {
+      Shard& shard = shards_[index];
+      mutex_lock l(shard.mu);
+      for (const int64_t* i = begin; i != end; ++i) {
+        fn(shard.map, SubtleMustCopyIfIntegral(keys(*i)), *i);
+      }
+    });
+  }
+
+  // Like WriteBatch, but atomically clears the map first.
+  template <class Keys, class Fn>
+  void ReplaceBatch(const Keys& keys, Fn fn) TF_NO_THREAD_SAFETY_ANALYSIS {
+    for (Shard& shard : shards_) shard.mu.lock();
+    for (Shard& shard : shards_) shard.map.clear();
+    for (int64_t i = 0; i < keys.size(); ++i) {
+      auto&& key = SubtleMustCopyIfIntegral(keys(i));
+      fn(shards_[ShardIndex(key)].map, key, i);
+    }
+    for (Shard& shard : shards_) shard.mu.unlock();
+  }
+
+  // Calls `fn(maps)` with a consistent view of all the shards, locked for
+  // reading, and returns its result.
+  template <class Fn>
+  auto ReadAll(Fn fn) const TF_NO_THREAD_SAFETY_ANALYSIS {
+    Maps maps;
+    for (int i = 0; i < kNumShards; ++i) {
+      shards_[i].mu.lock_shared();
+      maps[i] = &shards_[i].map;
+    }
+    auto unlock = gtl::MakeCleanup([this]() TF_NO_THREAD_SAFETY_ANALYSIS {
+      for (const Shard& shard : shards_) shard.mu.unlock_shared();
+    });
+    return fn(maps);
+  }
+
+  // Number of entries of the shards passed to a ReadAll function.
+  static int64_t Size(const Maps& maps) {
+    int64_t size = 0;
+    for (const Map* map : maps) size += map->size();
+    return size;
+  }
+
+  // Approximate memory used by the buckets of the shards.
+  int64_t MemoryUsed() const {
+    int64_t ret = 0;
+    for (const Shard& shard : shards_) {
+      tf_shared_lock l(shard.mu);
+      for (unsigned i = 0; i < shard.map.bucket_count(); ++i) {
+        size_t bucket_size = shard.map.bucket_size(i);
+        if (bucket_size == 0) {
+          ret++;
+        } else {
+          ret += bucket_size;
+        }
+      }
+    }
+    return ret;
+  }
+
+ private:
+  // Aligned so that the locks of different shards don't share a cache line.
+  struct alignas(64) Shard {
+    mutable mutex mu;
+    Map map TF_GUARDED_BY(mu);
+  };
+
+  static int ShardIndex(const K& key) {
+    // The top bits of a multiplicative hash, which don't correlate with the
+    // bucket the map picks for the key.
+    const uint64 hash = typename Map::hasher()(key);
+    return (hash * 0x9E3779B97F4A7C15ULL) >> (64 - 4);
+  }
+  static_assert(kNumShards == 1 << 4, "ShardIndex takes 4 bits");
+
+  // Calls `fn(shard_index, begin, end)` for each shard holding some of
+  // `keys`, with [begin, end) the indices of those keys.
+  template <class Keys, class Fn>
+  static void GroupByShard(const Keys& keys, Fn fn) {
+    const int64_t n = keys.size();
+    if (n == 1) {
+      const int64_t first = 0;
+      fn(ShardIndex(SubtleMustCopyIfIntegral(keys(0))), &first, &first + 1);
+      return;
+    }
+    std::vector<uint8> shard_indices(n);
+    std::array<int64_t, kNumShards + 1> offsets = {};
+    for (int64_t i = 0; i < n; ++i) {
+      shard_indices[i] = ShardIndex(SubtleMustCopyIfIntegral(keys(i)));
+      ++offsets[shard_indices[i] + 1];
+    }
+    for (int i = 0; i < kNumShards; ++i) offsets[i + 1] += offsets[i];
+    std::vector<int64_t> order(n);
+    std::array<int64_t, kNumShards + 1> next = offsets;
+    for (int64_t i = 0; i < n; ++i) order[next[shard_indices[i]]++] = i;
+    for (int i = 0; i < kNumShards; ++i) {
+      if (offsets[i] != offsets[i + 1]) {
+        fn(i, order.data() + offsets[i], order.data() + offsets[i + 1]);
+      }
+    }
+  }
+
+  std::array<Shard, kNumShards> shards_;
+};
+
+// Lookup table that wraps a ShardedHashMap, where the key and value data type
 // is specified. Each individual value must be a scalar. If vector values are
 // required, use MutableHashTableOfTensors.
 //
@@ -55,10 +203,7 @@ class MutableHashTableOfScalars final : public LookupInterface {
  public:
   MutableHashTableOfScalars(OpKernelContext* ctx, OpKernel* kernel) {}
 
-  size_t size() const override {
-    tf_shared_lock l(mu_);
-    return table_.size();
-  }
+  size_t size() const override { return table_.size(); }
 
   Status Find(OpKernelContext* ctx, const Tensor& key, Tensor* value,
               const Tensor& default_value) override {
@@ -70,8 +215,8 @@ class MutableHashTableOfScalars final : public LookupInterface {
     int64_t default_total = default_flat.size();
     bool is_full_size_default = (total == default_total);
 
-    tf_shared_lock l(mu_);
-    for (int64_t i = 0; i < key_values.size(); ++i) {
+    table_.ReadBatch(key_values, [&](const auto& map, const K& key,
+                                     int64_t i) {
       // is_full_size_default is true:
       //   Each key has an independent default value, key_values(i)
       //   corresponding uses default_flat(i) as its default value.
@@ -79,9 +224,8 @@ class MutableHashTableOfScalars final : public LookupInterface {
       // is_full_size_default is false:
       //   All keys will share the default_flat(0) as default value.
       value_values(i) = gtl::FindWithDefault(
-          table_, SubtleMustCopyIfIntegral(key_values(i)),
-          is_full_size_default ? default_flat(i) : default_flat(0));
-    }
+          map, key, is_full_size_default ? default_flat(i) : default_flat(0));
+    });
 
     return OkStatus();
   }
@@ -90,13 +234,13 @@ class MutableHashTableOfScalars final : public LookupInterface {
     const auto key_values = keys.flat<K>();
     const auto value_values = values.flat<V>();
 
-    mutex_lock l(mu_);
+    const auto insert = [&](auto& map, const K& key, int64_t i) {
+      gtl::InsertOrUpdate(&map, key, SubtleMustCopyIfIntegral(value_values(i)));
+    };
     if (clear) {
-      table_.clear();
-    }
-    for (int64_t i = 0; i < key_values.size(); ++i) {
-      gtl::InsertOrUpdate(&table_, SubtleMustCopyIfIntegral(key_values(i)),
-                          SubtleMustCopyIfIntegral(value_values(i)));
+      table_.ReplaceBatch(key_values, insert);
+    } else {
+      table_.WriteBatch(key_values, insert);
     }
     return OkStatus();
   }
@@ -109,10 +253,9 @@ class MutableHashTableOfScalars final : public LookupInterface {
   Status Remove(OpKernelContext* ctx, const Tensor& keys) override {
     const auto key_values = keys.flat<K>();
 
-    mutex_lock l(mu_);
-    for (int64_t i = 0; i < key_values.size(); ++i) {
-      table_.erase(SubtleMustCopyIfIntegral(key_values(i)));
-    }
+    table_.WriteBatch(key_values, [](auto& map, const K& key, int64_t i) {
+      map.erase(key);
+    });
     return OkStatus();
   }
 
@@ -122,17 +265,18 @@ class MutableHashTableOfScalars final : public LookupInterface {
   }
 
   Status ExportValues(OpKernelContext* ctx) override {
-    tf_shared_lock l(mu_);
-    int64_t size = table_.size();
-
-    Tensor* keys;
-    Tensor* values;
-    TF_RETURN_IF_ERROR(
-        ctx->allocate_output("keys", TensorShape({size}), &keys));
-    TF_RETURN_IF_ERROR(
-        ctx->allocate_output("values", TensorShape({size}), &values));
-    ExportKeysAndValues(keys, values);
-    return OkStatus();
+    return table_.ReadAll([&](const typename Table::Maps& maps) -> Status {
+      int64_t size = Table::Size(maps);
+
+      Tensor* keys;
+      Tensor* values;
+      TF_RETURN_IF_ERROR(
+          ctx->allocate_output("keys", TensorShape({size}), &keys));
+      TF_RETURN_IF_ERROR(
+          ctx->allocate_output("values", TensorShape({size}), &values));
+      ExportKeysAndValues(maps, keys, values);
+      return OkStatus();
+    });
   }
 
   DataType key_dtype() const override { return DataTypeToEnum<K>::v(); }
@@ -144,25 +288,18 @@ class MutableHashTableOfScalars final : public LookupInterface {
   TensorShape value_shape() const override { return TensorShape(); }
 
   int64_t MemoryUsed() const override {
-    int64_t ret = 0;
-    tf_shared_lock l(mu_);
-    for (unsigned i = 0; i < table_.bucket_count(); ++i) {
-      size_t bucket_size = table_.bucket_size(i);
-      if (bucket_size == 0) {
-        ret++;
-      } else {
-        ret += bucket_size;
-      }
-    }
-    return sizeof(MutableHashTableOfScalars) + ret;
+    return sizeof(MutableHashTableOfScalars) + table_.MemoryUsed();
   }
 
   Status AsGraphDef(GraphDefBuilder* builder, Node** out) const override {
-    tf_shared_lock l(mu_);
-    int64_t size = table_.size();
-    Tensor keys(key_dtype(), TensorShape({size}));
-    Tensor values(value_dtype(), TensorShape({size}));
-    ExportKeysAndValues(&keys, &values);
+    Tensor keys;
+    Tensor values;
+    table_.ReadAll([&](const typename Table::Maps& maps) {
+      int64_t size = Table::Size(maps);
+      keys = Tensor(key_dtype(), TensorShape({size}));
+      values = Tensor(value_dtype(), TensorShape({size}));
+      ExportKeysAndValues(maps, &keys, &values);
+    });
 
     // We set use_node_name_sharing with a unique node name so that the resource
     // can outlive the MutableHashTableV2 kernel. This means that the lifetime
@@ -195,24 +332,27 @@ class MutableHashTableOfScalars final : public LookupInterface {
   }
 
  private:
-  // Writes all keys and values into `keys` and `values`. `keys` and `values`
-  // must point to tensors of size `table_.size()`.
-  void ExportKeysAndValues(Tensor* keys, Tensor* values) const
-      TF_SHARED_LOCKS_REQUIRED(mu_) {
+  typedef ShardedHashMap<K, V> Table;
+
+  // Writes all keys and values of `maps` into `keys` and `values`. `keys` and
+  // `values` must point to tensors of size `Table::Size(maps)`.
+  void ExportKeysAndValues(const typename Table::Maps& maps, Tensor* keys,
+                           Tensor* values) const {
     auto keys_data = keys->flat<K>();
     auto values_data = values->flat<V>();
     int64_t i = 0;
-    for (auto it = table_.begin(); it != table_.end(); ++it, ++i) {
-      keys_data(i) = it->first;
-      values_data(i) = it->second;
+    for (const auto* map : maps) {
+      for (auto it = map->begin(); it != map->end(); ++it, ++i) {
+        keys_data(i) = it->first;
+        values_data(i) = it->second;
+      }
     }
   }
 
-  mutable mutex mu_;
-  std::unordered_map<K, V> table_ TF_GUARDED_BY(mu_);
+  Table table_;
 };
 
-// Lookup table that wraps an unordered_map. Behaves identical to
+// Lookup table that wraps a ShardedHashMap. Behaves identical to
 // MutableHashTableOfScalars except that each value must be a vector.
 template <class K, class V>
 class MutableHashTableOfTensors final : public LookupInterface {
@@ -226,10 +366,7 @@ class MutableHashTableOfTensors final : public LookupInterface {
                                 value_shape_.DebugString()));
   }
 
-  size_t size() const override {
-    tf_shared_lock l(mu_);
-    return table_.size();
-  }
+  size_t size() const override { return table_.size(); }
 
   Status Find(OpKernelContext* ctx, const Tensor& key, Tensor* value,
               const Tensor& default_value) override {
@@ -242,10 +379,9 @@ class MutableHashTableOfTensors final : public LookupInterface {
     int64_t default_total = default_flat.size();
     bool is_full_size_default = (total == default_total);
 
-    tf_shared_lock l(mu_);
-    for (int64_t i = 0; i < key_values.size(); ++i) {
-      ValueArray* value_vec =
-          gtl::FindOrNull(table_, SubtleMustCopyIfIntegral(key_values(i)));
+    table_.ReadBatch(key_values, [&](const auto& map, const K& key,
+                                     int64_t i) {
+      const ValueArray* value_vec = gtl::FindOrNull(map, key);
       if (value_vec != nullptr) {
         for (int64_t j = 0; j < value_dim; j++) {
           value_values(i, j) = value_vec->at(j);
@@ -262,7 +398,7 @@ class MutableHashTableOfTensors final : public LookupInterface {
               is_full_size_default ? default_flat(i, j) : default_flat(0, j);
         }
       }
-    }
+    });
 
     return OkStatus();
   }
@@ -272,18 +408,18 @@ class MutableHashTableOfTensors final : public LookupInterface {
     const auto value_values = values.flat_inner_dims<V, 2>();
     int64_t value_dim = value_shape_.dim_size(0);
 
-    mutex_lock l(mu_);
-    if (clear) {
-      table_.clear();
-    }
-    for (int64_t i = 0; i < key_values.size(); ++i) {
+    const auto insert = [&](auto& map, const K& key, int64_t i) {
       ValueArray value_vec;
       for (int64_t j = 0; j < value_dim; j++) {
         V value = value_values(i, j);
         value_vec.push_back(value);
       }
-      gtl::InsertOrUpdate(&table_, SubtleMustCopyIfIntegral(key_values(i)),
-                          value_vec);
+      gtl::InsertOrUpdate(&map, key, value_vec);
+    };
+    if (clear) {
+      table_.ReplaceBatch(key_values, insert);
+    } else {
+      table_.WriteBatch(key_values, insert);
     }
     return OkStatus();
   }
@@ -296,10 +432,9 @@ class MutableHashTableOfTensors final : public LookupInterface {
   Status Remove(OpKernelContext* ctx, const Tensor& keys) override {
     const auto key_values = keys.flat<K>();
 
-    mutex_lock l(mu_);
-    for (int64_t i = 0; i < key_values.size(); ++i) {
-      table_.erase(SubtleMustCopyIfIntegral(key_values(i)));
-    }
+    table_.WriteBatch(key_values, [](auto& map, const K& key, int64_t i) {
+      map.erase(key);
+    });
     return OkStatus();
   }
 
@@ -309,18 +444,19 @@ class MutableHashTableOfTensors final : public LookupInterface {
   }
 
   Status ExportValues(OpKernelContext* ctx) override {
-    tf_shared_lock l(mu_);
-    int64_t size = table_.size();
-    int64_t value_dim = value_shape_.dim_size(0);
-
-    Tensor* keys;
-    Tensor* values;
-    TF_RETURN_IF_ERROR(
-        ctx->allocate_output("keys", TensorShape({size}), &keys));
-    TF_RETURN_IF_ERROR(ctx->allocate_output(
-        "values", TensorShape({size, value_dim}), &values));
-    ExportKeysAndValues(keys, values);
-    return OkStatus();
+    return table_.ReadAll([&](const typename Table::Maps& maps) -> Status {
+      int64_t size = Table::Size(maps);
+      int64_t value_dim = value_shape_.dim_size(0);
+
+      Tensor* keys;
+      Tensor* values;
+      TF_RETURN_IF_ERROR(
+          ctx->allocate_output("keys", TensorShape({size}), &keys));
+      TF_RETURN_IF_ERROR(ctx->allocate_output(
+          "values", TensorShape({size, value_dim}), &values));
+      ExportKeysAndValues(maps, keys, values);
+      return OkStatus();
+    });
   }
 
   DataType key_dtype() const override { return DataTypeToEnum<K>::v(); }
@@ -332,25 +468,19 @@ class MutableHashTableOfTensors final : public LookupInterface {
   TensorShape value_shape() const override { return value_shape_; }
 
   int64_t MemoryUsed() const override {
-    int64_t ret = 0;
-    tf_shared_lock l(mu_);
-    for (unsigned i = 0; i < table_.bucket_count(); ++i) {
-      size_t bucket_size = table_.bucket_size(i);
-      if (bucket_size == 0) {
-        ret++;
-      } else {
-        ret += bucket_size;
-      }
-    }
-    return sizeof(MutableHashTableOfTensors) + ret;
+    return sizeof(MutableHashTableOfTensors) + table_.MemoryUsed();
   }
 
   Status AsGraphDef(GraphDefBuilder* builder, Node** out) const override {
-    tf_shared_lock l(mu_);
-    int64_t size = table_.size();
-    Tensor keys(key_dtype(), TensorShape({size}));
-    Tensor values(value_dtype(), TensorShape({size, value_shape_.dim_size(0)}));
-    ExportKeysAndValues(&keys, &values);
+    Tensor keys;
+    Tensor values;
+    table_.ReadAll([&](const typename Table::Maps& maps) {
+      int64_t size = Table::Size(maps);
+      keys = Tensor(key_dtype(), TensorShape({size}));
+      values =
+          Tensor(value_dtype(), TensorShape({size, value_shape_.dim_size(0)}));
+      ExportKeysAndValues(maps, &keys, &values);
+    });
 
     // We set use_node_name_sharing with a unique node name so that the resource
     // can outlive the MutableHashTableOfTensorsV2 kernel. This means that the
@@ -384,28 +514,30 @@ class MutableHashTableOfTensors final : public LookupInterface {
   }
 
  private:
-  // Writes all keys and values into `keys` and `values`. `keys` and `values`
-  // must point to tensors of size `table_.size()`.
-  void ExportKeysAndValues(Tensor* keys, Tensor* values) const
-      TF_SHARED_LOCKS_REQUIRED(mu_) {
+  typedef gtl::InlinedVector<V, 4> ValueArray;
+  typedef ShardedHashMap<K, ValueArray> Table;
+
+  // Writes all keys and values of `maps` into `keys` and `values`. `keys` and
+  // `values` must point to tensors of size `Table::Size(maps)`.
+  void ExportKeysAndValues(const typename Table::Maps& maps, Tensor* keys,
+                           Tensor* values) const {
     int64_t value_dim = value_shape_.dim_size(0);
     auto keys_data = keys->flat<K>();
     auto values_data = values->matrix<V>();
     int64_t i = 0;
-    for (auto it = table_.begin(); it != table_.end(); ++it, ++i) {
-      K key = it->first;
-      ValueArray value = it->second;
-      keys_data(i) = key;
-      for (int64_t j = 0; j < value_dim; j++) {
-        values_data(i, j) = value[j];
+    for (const auto* map : maps) {
+      for (auto it = map->begin(); it != map->end(); ++it, ++i) {
+        keys_data(i) = it->first;
+        const ValueArray& value = it->second;
+        for (int64_t j = 0; j < value_dim; j++) {
+          values_data(i, j) = value[j];
+        }
       }
     }
   }
 
   TensorShape value_shape_;
-  mutable mutex mu_;
-  typedef gtl::InlinedVector<V, 4> ValueArray;
-  std::unordered_map<K, ValueArray> table_ TF_GUARDED_BY(mu_);
+  Table table_;
 };
 
 namespace {
@@ -878,6 +1010,111 @@ class MutableDenseHashTable final : public LookupInterface {
   uint64 deleted_key_hash_;
 };
 
+// Lookup table backed by an immutable, memory-mapped PerfectHashTableFile.
+// Opening it doesn't read the entries of the file, so it's ready right away,
+// and tables of the same file share its memory, also across processes.
+template <class K, class V>
+class PerfectHashTable final : public LookupInterface {
+ public:
+  PerfectHashTable(OpKernelContext* ctx, OpKernel* kernel) {
+    OP_REQUIRES_OK(ctx, GetNodeAttr(kernel->def(), "filename", &filename_));
+    OP_REQUIRES_OK(ctx,
+                   PerfectHashTableFile::Open(ctx->env(), filename_, &file_));
+    OP_REQUIRES(
+        ctx,
+        file_->key_dtype() == key_dtype() &&
+            file_->value_dtype() == value_dtype(),
+        errors::InvalidArgument(
+            "Perfect hash table file ", filename_, " maps ",
+            DataTypeString(file_->key_dtype()), " keys to ",
+            DataTypeString(file_->value_dtype()), " values, expected ",
+            DataTypeString(key_dtype()), " keys and ",
+            DataTypeString(value_dtype()), " values"));
+  }
+
+  size_t size() const override { return file_->size(); }
+
+  Status Find(OpKernelContext* ctx, const Tensor& key, Tensor* value,
+              const Tensor& default_value) override {
+    const auto key_values = key.flat<K>();
+    auto value_values = value->flat<V>();
+    const auto default_flat = default_value.flat<V>();
+    const bool is_full_size_default =
+        value_values.size() == default_flat.size();
+
+    for (int64_t i = 0; i < key_values.size(); ++i) {
+      const int64_t slot =
+          file_->Find(PerfectHashTableFingerprint(key_values(i)));
+      if (slot < 0) {
+        value_values(i) =
+            is_full_size_default ? default_flat(i) : default_flat(0);
+      } else {
+        TF_RETURN_IF_ERROR(GetValue(slot, &value_values(i)));
+      }
+    }
+    return OkStatus();
+  }
+
+  Status Insert(OpKernelContext* ctx, const Tensor& keys,
+                const Tensor& values) override {
+    return errors::Unimplemented("Perfect hash tables are immutable");
+  }
+
+  Status Remove(OpKernelContext* ctx, const Tensor& keys) override {
+    return errors::Unimplemented("Perfect hash tables are immutable");
+  }
+
+  Status ImportValues(OpKernelContext* ctx, const Tensor& keys,
+                      const Tensor& values) override {
+    return errors::Unimplemented("Perfect hash tables are immutable");
+  }
+
+  Status ExportValues(OpKernelContext* ctx) override {
+    return errors::Unimplemented(
+        "Perfect hash tables don't store their keys, so they can't be "
+        "exported");
+  }
+
+  DataType key_dtype() const override { return DataTypeToEnum<K>::v(); }
+
+  DataType value_dtype() const override { return DataTypeToEnum<V>::v(); }
+
+  TensorShape key_shape() const final { return TensorShape(); }
+
+  TensorShape value_shape() const override { return TensorShape(); }
+
+  // The entries are in the mapped file, which is shared.
+  int64_t MemoryUsed() const override { return sizeof(PerfectHashTable); }
+
+  Status AsGraphDef(GraphDefBuilder* builder, Node** out) const override {
+    *out = ops::SourceOp(
+        "PerfectHashTable",
+        builder->opts()
+            .WithName(UniqueNodeName("PerfectHashTableFromGraphDef"))
+            .WithAttr("filename", filename_)
+            .WithAttr("use_node_name_sharing", true)
+            .WithAttr("key_dtype", key_dtype())
+            .WithAttr("value_dtype", value_dtype()));
+    return OkStatus();
+  }
+
+ private:
+  Status GetValue(int64_t slot, int64_t* value) const {
+    *value = file_->GetInt64Value(slot);
+    return OkStatus();
+  }
+
+  Status GetValue(int64_t slot, tstring* value) const {
+    StringPiece data;
+    TF_RETURN_IF_ERROR(file_->GetStringValue(slot, &data));
+    value->assign(data.data(), data.size());
+    return OkStatus();
+  }
+
+  std::string filename_;
+  std::unique_ptr<PerfectHashTableFile> file_;
+};
+
 }  // namespace lookup
 
 // Base class for kernels that take a LookupTable handle as the 0th input.
@@ -1201,6 +1438,23 @@ REGISTER_KERNEL(tstring, int64_t);
 
 #undef REGISTER_KERNEL
 
+// Register the PerfectHashTable op.
+#define REGISTER_KERNEL(key_dtype, value_dtype)                           \
+  REGISTER_KERNEL_BUILDER(                                                \
+      Name("PerfectHashTable")                                            \
+          .Device(DEVICE_CPU)                                             \
+          .TypeConstraint<key_dtype>("key_dtype")                         \
+          .TypeConstraint<value_dtype>("value_dtype"),                    \
+      LookupTableOp<lookup::PerfectHashTable<key_dtype, value_dtype>,     \
+                    key_dtype, value_dtype>)
+
+REGISTER_KERNEL(int64_t, int64_t);
+REGISTER_KERNEL(int64_t, tstring);
+REGISTER_KERNEL(tstring, int64_t);
+REGISTER_KERNEL(tstring, tstring);
+
+#undef REGISTER_KERNEL
+
 // Register the MutableDenseHashTable op.
 #define REGISTER_KERNEL(key_dtype, value_dtype)                             \
   REGISTER_KERNEL_BUILDER(                                                  \
@@ -159,9 +159,26 @@ class FusedMatMulOpTest : public OpsTestBase {
       ops::Elu(root.WithOpName("with_activation"), with_bias);
     } else if (activation_type == "LeakyRelu") {
       ops::internal::LeakyRelu(root.WithOpName("with_activation"), with_bias);
-    } else if (activation_type == "GeluExact") {
-      VLOG(0) << "ERROR: GeluExact is yet not available!!";
-      ops::Identity(root.WithOpName("with_activation"), with_bias);
+    } else if (activation_type == "GeluApproximate" ||
+               activation_type == "GeluExact") {
+      auto scalar = [&](float value) {
+        return ops::Cast(root, ops::Const(root, value), kTValueType);
+      };
+      Output inner;
+      if (activation_type == "GeluApproximate") {
+        auto cube = ops::Mul(root, ops::Square(root, with_bias), with_bias);
+        inner = ops::Tanh(
+            root, ops::Mul(root,
+                           ops::AddV2(root, with_bias,
+                                      ops::Mul(root, cube, scalar(0.044715f))),
+                           scalar(0.7978845608f)));
+      } else {
+        inner =
+            ops::Erf(root, ops::Mul(root, with_bias, scalar(0.7071067812f)));
+      }
+      ops::Mul(root.WithOpName("with_activation"),
+               ops::Mul(root, with_bias, scalar(0.5f)),
+               ops::AddV2(root, inner, scalar(1.0f)));
     } else if (activation_type == "Sigmoid") {
       ops::Sigmoid(root.WithOpName("with_activation"), with_bias);
     } else if (activation_type == "Tanh") {
@@ -367,7 +384,8 @@ static auto GetActivations(DataType dtype) {
       // TODO: not sure how to add GeluExact op ??
       return std::vector{/*"GeluExact",*/ "Tanh", "Sigmoid"};
     default:
-      return std::vector{"Relu", "Relu6", "Elu", "LeakyRelu"};
+      return std::vector{"Relu",      "Relu6",           "Elu",
+                         "LeakyRelu", "GeluApproximate", "GeluExact"};
   }
 }
 
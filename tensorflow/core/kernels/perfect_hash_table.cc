@@ -0,0 +1,453 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/perfect_hash_table.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/random.h"
+#include "tensorflow/core/platform/strcat.h"
+
+namespace tensorflow {
+namespace lookup {
+namespace {
+
+constexpr char kMagic[8] = {'T', 'F', 'P', 'H', 'T', 'A', 'B', 'L'};
+constexpr uint32 kVersion = 1;
+// Written in the byte order of the host.
+constexpr uint32 kByteOrderMark = 0x01020304;
+
+// Average number of keys of a bucket of the hash function.
+constexpr uint64 kKeysPerBucket = 4;
+// Ratio of the number of keys to the number of slots.
+constexpr double kLoadFactor = 0.98;
+// Limits of the search for the pilots of the buckets, and of the number of
+// seeds tried if it fails.
+constexpr uint32 kMaxPilot = 1 << 24;
+constexpr int kMaxSeeds = 8;
+
+struct FileHeader {
+  char magic[8];
+  uint32 version;
+  uint32 byte_order_mark;
+  uint32 key_dtype;
+  uint32 value_dtype;
+  uint64 seed;
+  // The fingerprint of the empty slots, which no key has.
+  uint64 empty_fingerprint;
+  uint64 num_keys;
+  uint64 num_buckets;
+  uint64 num_slots;
+  // Offsets of the sections from the start of the file, multiples of 8.
+  uint64 pilots_offset;
+  uint64 fingerprints_offset;
+  uint64 values_offset;
+  uint64 string_data_offset;
+  uint64 string_data_size;
+};
+
+// The finalizer of MurmurHash3.
+uint64 Mix(uint64 x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
+
+// The perfect hash function of a fingerprint is Slot(fingerprint, seed, pilot)
+// with the pilot of Bucket(fingerprint, seed).
+uint64 Bucket(uint64 fingerprint, uint64 seed, uint64 num_buckets) {
+  return Mix(fingerprint ^ seed) % num_buckets;
+}
+
+uint64 Slot(uint64 fingerprint, uint64 seed, uint32 pilot, uint64 num_slots) {
+  return Mix(fingerprint ^ Mix((seed << 32) + pilot + 1)) % num_slots;
+}
+
+uint64 AlignTo8(uint64 offset) { return (offset + 7) & ~uint64{7}; }
+
+bool IsSupportedType(DataType dtype) {
+  return dtype == DT_INT64 || dtype == DT_STRING;
+}
+
+// Finds the pilot of each bucket such that the keys get distinct slots,
+// placing the largest buckets first, and sets the key index of each slot in
+// `slot_keys`, -1 for empty slots. Returns false if a bucket has no pilot
+// below kMaxPilot.
+bool FindPilots(const std::vector<uint64>& fingerprints, uint64 seed,
+                uint64 num_buckets, uint64 num_slots,
+                std::vector<uint32>* pilots, std::vector<int64_t>* slot_keys) {
+  // The keys of each bucket are keys[bucket_starts[b], bucket_starts[b + 1]).
+  std::vector<uint64> buckets(fingerprints.size());
+  std::vector<uint64> bucket_starts(num_buckets + 1, 0);
+  for (size_t i = 0; i < fingerprints.size(); ++i) {
+    buckets[i] = Bucket(fingerprints[i], seed, num_buckets);
+    ++bucket_starts[buckets[i] + 1];
+  }
+  std::partial_sum(bucket_starts.begin(), bucket_starts.end(),
+                   bucket_starts.begin());
+  std::vector<int64_t> keys(fingerprints.size());
+  std::vector<uint64> next(bucket_starts.begin(), bucket_starts.end() - 1);
+  for (size_t i = 0; i < fingerprints.size(); ++i) {
+    keys[next[buckets[i]]++] = i;
+  }
+  const auto bucket_size = [&](uint64 b) {
+    return bucket_starts[b + 1] - bucket_starts[b];
+  };
+  std::vector<uint64> order(num_buckets);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](uint64 a, uint64 b) {
+    return bucket_size(a) > bucket_size(b);
+  });
+
+  pilots->assign(num_buckets, 0);
+  slot_keys->assign(num_slots, -1);
+  std::vector<uint64> slots;
+  for (uint64 b : order) {
+    if (bucket_size(b) == 0) break;
+    for (uint32 pilot = 0;; ++pilot) {
+      if (pilot == kMaxPilot) return false;
+      slots.clear();
+      for (uint64 k = bucket_starts[b]; k < bucket_starts[b + 1]; ++k) {
+        const uint64 slot = Slot(fingerprints[keys[k]], seed, pilot, num_slots);
+        if ((*slot_keys)[slot] != -1 ||
+            std::find(slots.begin(), slots.end(), slot) != slots.end()) {
+          break;
+        }
+        slots.push_back(slot);
+      }
+      if (slots.size() == bucket_size(b)) {
+        for (size_t k = 0; k < slots.size(); ++k) {
+          (*slot_keys)[slots[k]] = keys[bucket_starts[b] + k];
+        }
+        (*pilots)[b] = pilot;
+        break;
+      }
+    }
+  }
+  return true;
+}
+
+// Appends `size` bytes of `data` to `file`, or zeros if `data` is null.
+Status Append(WritableFile* file, const void* data, uint64 size,
+              uint64* offset) {
+  if (data != nullptr) {
+    TF_RETURN_IF_ERROR(
+        file->Append(StringPiece(static_cast<const char*>(data), size)));
+  } else {
+    TF_RETURN_IF_ERROR(file->Append(std::string(size, '\0')));
+  }
+  *offset += size;
+  return OkStatus();
+}
+
+}  // namespace
+
+uint64 PerfectHashTableFingerprint(int64_t key) {
+  return Fingerprint64(
+      StringPiece(reinterpret_cast<const char*>(&key), sizeof(key)));
+}
+
+uint64 PerfectHashTableFingerprint(StringPiece key) {
+  return Fingerprint64(key);
+}
+
+Status PerfectHashTableFile::Open(Env* env, const std::string& filename,
+                                  std::unique_ptr<PerfectHashTableFile>* file) {
+  std::unique_ptr<ReadOnlyMemoryRegion> region;
+  TF_RETURN_IF_ERROR(env->NewReadOnlyMemoryRegionFromFile(filename, &region));
+  const char* base = static_cast<const char*>(region->data());
+  const uint64 file_size = region->length();
+  const auto invalid = [&filename](const char* reason) {
+    return errors::DataLoss("Invalid perfect hash table file ", filename, ": ",
+                            reason);
+  };
+
+  FileHeader header;
+  if (file_size < sizeof(header)) return invalid("truncated header");
+  std::memcpy(&header, base, sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+    return invalid("not a perfect hash table file");
+  }
+  if (header.version != kVersion) return invalid("unsupported version");
+  if (header.byte_order_mark != kByteOrderMark) {
+    return invalid("written on a host of another byte order");
+  }
+  const DataType key_dtype = static_cast<DataType>(header.key_dtype);
+  const DataType value_dtype = static_cast<DataType>(header.value_dtype);
+  if (!IsSupportedType(key_dtype) || !IsSupportedType(value_dtype)) {
+    return invalid("unsupported key or value type");
+  }
+  if (header.num_buckets == 0 || header.num_slots == 0 ||
+      header.num_keys > header.num_slots) {
+    return invalid("inconsistent sizes");
+  }
+  // Whether `count` elements of `size` bytes at `offset` are in the file.
+  const auto in_file = [file_size](uint64 offset, uint64 count, uint64 size) {
+    return offset % 8 == 0 && offset <= file_size &&
+           count <= (file_size - offset) / size;
+  };
+  const bool string_values = value_dtype == DT_STRING;
+  if (!in_file(header.pilots_offset, header.num_buckets, sizeof(uint32)) ||
+      !in_file(header.fingerprints_offset, header.num_slots, sizeof(uint64)) ||
+      !in_file(header.values_offset, header.num_slots + string_values,
+               sizeof(uint64)) ||
+      !in_file(header.string_data_offset, header.string_data_size, 1)) {
+    return invalid("truncated");
+  }
+
+  std::unique_ptr<PerfectHashTableFile> table_file(new PerfectHashTableFile);
+  table_file->key_dtype_ = key_dtype;
+  table_file->value_dtype_ = value_dtype;
+  table_file->seed_ = header.seed;
+  table_file->empty_fingerprint_ = header.empty_fingerprint;
+  table_file->num_keys_ = header.num_keys;
+  table_file->num_buckets_ = header.num_buckets;
+  table_file->num_slots_ = header.num_slots;
+  table_file->pilots_ =
+      reinterpret_cast<const uint32*>(base + header.pilots_offset);
+  table_file->fingerprints_ =
+      reinterpret_cast<const uint64*>(base + header.fingerprints_offset);
+  if (string_values) {
+    table_file->string_offsets_ =
+        reinterpret_cast<const uint64*>(base + header.values_offset);
+    table_file->string_data_ = base + header.string_data_offset;
+    table_file->string_data_size_ = header.string_data_size;
+  } else {
+    table_file->int64_values_ =
+        reinterpret_cast<const int64_t*>(base + header.values_offset);
+  }
+  table_file->region_ = std::move(region);
+  *file = std::move(table_file);
+  return OkStatus();
+}
+
+int64_t PerfectHashTableFile::Find(uint64 fingerprint) const {
+  if (fingerprint == empty_fingerprint_) return -1;
+  const uint32 pilot = pilots_[Bucket(fingerprint, seed_, num_buckets_)];
+  const uint64 slot = Slot(fingerprint, seed_, pilot, num_slots_);
+  return fingerprints_[slot] == fingerprint ? slot : -1;
+}
+
+Status PerfectHashTableFile::GetStringValue(int64_t slot,
+                                            StringPiece* value) const {
+  // The offsets are checked here rather than when opening the file, which
+  // would read all of them.
+  const uint64 begin = string_offsets_[slot];
+  const uint64 end = string_offsets_[slot + 1];
+  if (begin > end || end > string_data_size_) {
+    return errors::DataLoss("Invalid value offsets in perfect hash table file");
+  }
+  *value = StringPiece(string_data_ + begin, end - begin);
+  return OkStatus();
+}
+
+PerfectHashTableBuilder::PerfectHashTableBuilder(DataType key_dtype,
+                                                 DataType value_dtype)
+    : key_dtype_(key_dtype), value_dtype_(value_dtype) {}
+
+Status PerfectHashTableBuilder::AddFingerprint(DataType key_dtype,
+                                               uint64 fingerprint) {
+  if (key_dtype != key_dtype_) {
+    return errors::InvalidArgument("Expected a key of type ",
+                                   DataTypeString(key_dtype_), ", got ",
+                                   DataTypeString(key_dtype));
+  }
+  fingerprints_.push_back(fingerprint);
+  return OkStatus();
+}
+
+Status PerfectHashTableBuilder::Add(int64_t key, int64_t value) {
+  if (value_dtype_ != DT_INT64) {
+    return errors::InvalidArgument("Expected a value of type ",
+                                   DataTypeString(value_dtype_),
+                                   ", got int64");
+  }
+  TF_RETURN_IF_ERROR(
+      AddFingerprint(DT_INT64, PerfectHashTableFingerprint(key)));
+  int64_values_.push_back(value);
+  return OkStatus();
+}
+
+Status PerfectHashTableBuilder::Add(int64_t key, StringPiece value) {
+  if (value_dtype_ != DT_STRING) {
+    return errors::InvalidArgument("Expected a value of type ",
+                                   DataTypeString(value_dtype_),
+                                   ", got string");
+  }
+  TF_RETURN_IF_ERROR(
+      AddFingerprint(DT_INT64, PerfectHashTableFingerprint(key)));
+  string_values_.emplace_back(value);
+  return OkStatus();
+}
+
+Status PerfectHashTableBuilder::Add(StringPiece key, int64_t value) {
+  if (value_dtype_ != DT_INT64) {
+    return errors::InvalidArgument("Expected a value of type ",
+                                   DataTypeString(value_dtype_),
+                                   ", got int64");
+  }
+  TF_RETURN_IF_ERROR(
+      AddFingerprint(DT_STRING, PerfectHashTableFingerprint(key)));
+  int64_values_.push_back(value);
+  return OkStatus();
+}
+
+Status PerfectHashTableBuilder::Add(StringPiece key, StringPiece value) {
+  if (value_dtype_ != DT_STRING) {
+    return errors::InvalidArgument("Expected a value of type ",
+                                   DataTypeString(value_dtype_),
+                                   ", got string");
+  }
+  TF_RETURN_IF_ERROR(
+      AddFingerprint(DT_STRING, PerfectHashTableFingerprint(key)));
+  string_values_.emplace_back(value);
+  return OkStatus();
+}
+
+Status PerfectHashTableBuilder::Write(Env* env,
+                                      const std::string& filename) const {
+  if (!IsSupportedType(key_dtype_) || !IsSupportedType(value_dtype_)) {
+    return errors::InvalidArgument(
+        "Perfect hash tables map int64 or string keys to int64 or string "
+        "values, got ",
+        DataTypeString(key_dtype_), " keys and ", DataTypeString(value_dtype_),
+        " values");
+  }
+  const uint64 num_keys = fingerprints_.size();
+  std::vector<uint64> sorted_fingerprints(fingerprints_);
+  std::sort(sorted_fingerprints.begin(), sorted_fingerprints.end());
+  if (std::adjacent_find(sorted_fingerprints.begin(),
+                         sorted_fingerprints.end()) !=
+      sorted_fingerprints.end()) {
+    return errors::InvalidArgument(
+        "Two keys of the table are equal, or have the same fingerprint");
+  }
+  uint64 empty_fingerprint = 0;
+  for (uint64 fingerprint : sorted_fingerprints) {
+    if (fingerprint > empty_fingerprint) break;
+    ++empty_fingerprint;
+  }
+  sorted_fingerprints.clear();
+  sorted_fingerprints.shrink_to_fit();
+
+  FileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.byte_order_mark = kByteOrderMark;
+  header.key_dtype = key_dtype_;
+  header.value_dtype = value_dtype_;
+  header.empty_fingerprint = empty_fingerprint;
+  header.num_keys = num_keys;
+  header.num_buckets =
+      std::max<uint64>(1, (num_keys + kKeysPerBucket - 1) / kKeysPerBucket);
+  header.num_slots = std::max<uint64>(
+      {1, num_keys, static_cast<uint64>(std::ceil(num_keys / kLoadFactor))});
+
+  std::vector<uint32> pilots;
+  std::vector<int64_t> slot_keys;
+  bool found = false;
+  for (int seed = 0; seed < kMaxSeeds && !found; ++seed) {
+    header.seed = seed;
+    found = FindPilots(fingerprints_, header.seed, header.num_buckets,
+                       header.num_slots, &pilots, &slot_keys);
+  }
+  if (!found) {
+    return errors::Internal("Failed to find a perfect hash function of ",
+                            num_keys, " keys");
+  }
+
+  const bool string_values = value_dtype_ == DT_STRING;
+  std::vector<uint64> slot_fingerprints(header.num_slots, empty_fingerprint);
+  std::vector<int64_t> int64_values;
+  std::vector<uint64> string_offsets;
+  if (string_values) {
+    string_offsets.reserve(header.num_slots + 1);
+    string_offsets.push_back(0);
+  } else {
+    int64_values.resize(header.num_slots, 0);
+  }
+  for (uint64 slot = 0; slot < header.num_slots; ++slot) {
+    const int64_t key = slot_keys[slot];
+    if (key >= 0) slot_fingerprints[slot] = fingerprints_[key];
+    if (string_values) {
+      const uint64 size = key >= 0 ? string_values_[key].size() : 0;
+      string_offsets.push_back(string_offsets.back() + size);
+    } else if (key >= 0) {
+      int64_values[slot] = int64_values_[key];
+    }
+  }
+
+  header.pilots_offset = AlignTo8(sizeof(header));
+  header.fingerprints_offset =
+      AlignTo8(header.pilots_offset + header.num_buckets * sizeof(uint32));
+  header.values_offset =
+      header.fingerprints_offset + header.num_slots * sizeof(uint64);
+  header.string_data_offset =
+      header.values_offset +
+      (header.num_slots + string_values) * sizeof(uint64);
+  header.string_data_size = string_values ? string_offsets.back() : 0;
+
+  // Write to a temporary file, then rename it, as processes may have mapped
+  // the previous file.
+  const std::string temp_filename =
+      strings::StrCat(filename, ".tmp", random::New64());
+  std::unique_ptr<WritableFile> file;
+  TF_RETURN_IF_ERROR(env->NewWritableFile(temp_filename, &file));
+  uint64 offset = 0;
+  TF_RETURN_IF_ERROR(Append(file.get(), &header, sizeof(header), &offset));
+  TF_RETURN_IF_ERROR(
+      Append(file.get(), nullptr, header.pilots_offset - offset, &offset));
+  TF_RETURN_IF_ERROR(Append(file.get(), pilots.data(),
+                            pilots.size() * sizeof(uint32), &offset));
+  TF_RETURN_IF_ERROR(Append(file.get(), nullptr,
+                            header.fingerprints_offset - offset, &offset));
+  TF_RETURN_IF_ERROR(Append(file.get(), slot_fingerprints.data(),
+                            slot_fingerprints.size() * sizeof(uint64),
+                            &offset));
+  if (string_values) {
+    TF_RETURN_IF_ERROR(Append(file.get(), string_offsets.data(),
+                              string_offsets.size() * sizeof(uint64),
+                              &offset));
+    for (uint64 slot = 0; slot < header.num_slots; ++slot) {
+      if (slot_keys[slot] >= 0) {
+        TF_RETURN_IF_ERROR(file->Append(string_values_[slot_keys[slot]]));
+      }
+    }
+  } else {
+    TF_RETURN_IF_ERROR(Append(file.get(), int64_values.data(),
+                              int64_values.size() * sizeof(int64_t), &offset));
+  }
+  TF_RETURN_IF_ERROR(file->Close());
+  Status status = env->RenameFile(temp_filename, filename);
+  if (!status.ok()) {
+    env->DeleteFile(temp_filename).IgnoreError();
+  }
+  return status;
+}
+
+}  // namespace lookup
+}  // namespace tensorflow
@@ -0,0 +1,134 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_KERNELS_PERFECT_HASH_TABLE_H_
+#define TENSORFLOW_CORE_KERNELS_PERFECT_HASH_TABLE_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/file_system.h"
+#include "tensorflow/core/platform/stringpiece.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace lookup {
+
+// Files of immutable tables mapping int64 or string keys to int64 or string
+// values, which are read through a read-only memory mapping: opening a table
+// doesn't read its entries, and processes mapping the same file share its
+// memory.
+//
+// A file holds a perfect hash function of the 64-bit fingerprints of the keys,
+// which maps them to distinct slots, the fingerprint of the key of each slot
+// and the value of each slot. The keys themselves aren't stored: a key whose
+// fingerprint is the one of a key of the table is taken to be that key.
+//
+// The files are written by PerfectHashTableBuilder, e.g. through the
+// build_perfect_hash_table tool, in the byte order of the host.
+
+// Returns the fingerprint of a key of a table.
+uint64 PerfectHashTableFingerprint(int64_t key);
+uint64 PerfectHashTableFingerprint(StringPiece key);
+
+class PerfectHashTableFile {
+ public:
+  // Maps the table of `filename`, and checks its header.
+  static Status Open(Env* env, const std::string& filename,
+                     std::unique_ptr<PerfectHashTableFile>* file);
+
+  DataType key_dtype() const { return key_dtype_; }
+  DataType value_dtype() const { return value_dtype_; }
+
+  // Number of keys of the table.
+  int64_t size() const { return num_keys_; }
+
+  // Returns the slot of the key of `fingerprint`, or -1 if the table doesn't
+  // hold the key.
+  int64_t Find(uint64 fingerprint) const;
+
+  // Returns the value of `slot`, which must be a slot returned by Find, of a
+  // table of int64 values.
+  int64_t GetInt64Value(int64_t slot) const { return int64_values_[slot]; }
+
+  // Gets the value of `slot`, which must be a slot returned by Find, of a
+  // table of string values. `value` points into the mapped file.
+  Status GetStringValue(int64_t slot, StringPiece* value) const;
+
+ private:
+  PerfectHashTableFile() = default;
+
+  std::unique_ptr<ReadOnlyMemoryRegion> region_;
+  DataType key_dtype_ = DT_INVALID;
+  DataType value_dtype_ = DT_INVALID;
+  uint64 seed_ = 0;
+  uint64 empty_fingerprint_ = 0;
+  int64_t num_keys_ = 0;
+  uint64 num_buckets_ = 0;
+  uint64 num_slots_ = 0;
+  const uint32* pilots_ = nullptr;
+  const uint64* fingerprints_ = nullptr;
+  // The values of the slots, for int64 values.
+  const int64_t* int64_values_ = nullptr;
+  // The offsets of the values of the slots in `string_data_`, and the end of
+  // the last one, for string values.
+  const uint64* string_offsets_ = nullptr;
+  const char* string_data_ = nullptr;
+  uint64 string_data_size_ = 0;
+};
+
+// Builds the file of a table from its entries.
+//
+// Sample use case:
+//
+// PerfectHashTableBuilder builder(DT_STRING, DT_INT64);
+// TF_RETURN_IF_ERROR(builder.Add("a", 0));
+// TF_RETURN_IF_ERROR(builder.Add("b", 1));
+// TF_RETURN_IF_ERROR(builder.Write(Env::Default(), filename));
+class PerfectHashTableBuilder {
+ public:
+  PerfectHashTableBuilder(DataType key_dtype, DataType value_dtype);
+
+  // Adds an entry. Returns InvalidArgument if the types of the key and value
+  // aren't the ones of the table.
+  Status Add(int64_t key, int64_t value);
+  Status Add(int64_t key, StringPiece value);
+  Status Add(StringPiece key, int64_t value);
+  Status Add(StringPiece key, StringPiece value);
+
+  int64_t size() const { return fingerprints_.size(); }
+
+  // Builds the table and writes it to `filename`. Returns InvalidArgument if
+  // two keys are equal, or have the same fingerprint.
+  Status Write(Env* env, const std::string& filename) const;
+
+ private:
+  Status AddFingerprint(DataType key_dtype, uint64 fingerprint);
+
+  const DataType key_dtype_;
+  const DataType value_dtype_;
+  std::vector<uint64> fingerprints_;
+  std::vector<int64_t> int64_values_;
+  std::vector<std::string> string_values_;
+};
+
+}  // namespace lookup
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_PERFECT_HASH_TABLE_H_
@@ -0,0 +1,167 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/perfect_hash_table.h"
+
+#include <memory>
+#include <string>
+
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/strcat.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace lookup {
+namespace {
+
+std::string TablePath(const std::string& name) {
+  return io::JoinPath(testing::TmpDir(), name);
+}
+
+TEST(PerfectHashTableTest, Int64KeysAndValues) {
+  constexpr int kNumKeys = 10000;
+  PerfectHashTableBuilder builder(DT_INT64, DT_INT64);
+  for (int64_t key = 0; key < kNumKeys; ++key) {
+    TF_ASSERT_OK(builder.Add(key * 3, key + 100));
+  }
+  const std::string path = TablePath("int64_int64");
+  TF_ASSERT_OK(builder.Write(Env::Default(), path));
+
+  std::unique_ptr<PerfectHashTableFile> file;
+  TF_ASSERT_OK(PerfectHashTableFile::Open(Env::Default(), path, &file));
+  EXPECT_EQ(DT_INT64, file->key_dtype());
+  EXPECT_EQ(DT_INT64, file->value_dtype());
+  EXPECT_EQ(kNumKeys, file->size());
+  for (int64_t key = 0; key < 3 * kNumKeys; ++key) {
+    const int64_t slot = file->Find(PerfectHashTableFingerprint(key));
+    if (key % 3 == 0) {
+      ASSERT_GE(slot, 0) << key;
+      EXPECT_EQ(key / 3 + 100, file->GetInt64Value(slot));
+    } else {
+      EXPECT_EQ(-1, slot) << key;
+    }
+  }
+}
+
+TEST(PerfectHashTableTest, StringKeysAndValues) {
+  PerfectHashTableBuilder builder(DT_STRING, DT_STRING);
+  TF_ASSERT_OK(builder.Add("brain", "cerveau"));
+  TF_ASSERT_OK(builder.Add("", "empty"));
+  TF_ASSERT_OK(builder.Add("surgery", ""));
+  const std::string path = TablePath("string_string");
+  TF_ASSERT_OK(builder.Write(Env::Default(), path));
+
+  std::unique_ptr<PerfectHashTableFile> file;
+  TF_ASSERT_OK(PerfectHashTableFile::Open(Env::Default(), path, &file));
+  EXPECT_EQ(3, file->size());
+  const auto find = [&file](StringPiece key) -> std::string {
+    const int64_t slot = file->Find(PerfectHashTableFingerprint(key));
+    if (slot < 0) return "<missing>";
+    StringPiece value;
+    TF_EXPECT_OK(file->GetStringValue(slot, &value));
+    return std::string(value);
+  };
+  EXPECT_EQ("cerveau", find("brain"));
+  EXPECT_EQ("empty", find(""));
+  EXPECT_EQ("", find("surgery"));
+  EXPECT_EQ("<missing>", find("tensorflow"));
+}
+
+TEST(PerfectHashTableTest, MixedTypes) {
+  PerfectHashTableBuilder int64_keys(DT_INT64, DT_STRING);
+  TF_ASSERT_OK(int64_keys.Add(42, "answer"));
+  const std::string int64_keys_path = TablePath("int64_string");
+  TF_ASSERT_OK(int64_keys.Write(Env::Default(), int64_keys_path));
+
+  PerfectHashTableBuilder string_keys(DT_STRING, DT_INT64);
+  TF_ASSERT_OK(string_keys.Add("answer", 42));
+  const std::string string_keys_path = TablePath("string_int64");
+  TF_ASSERT_OK(string_keys.Write(Env::Default(), string_keys_path));
+
+  std::unique_ptr<PerfectHashTableFile> file;
+  TF_ASSERT_OK(
+      PerfectHashTableFile::Open(Env::Default(), int64_keys_path, &file));
+  int64_t slot = file->Find(PerfectHashTableFingerprint(int64_t{42}));
+  ASSERT_GE(slot, 0);
+  StringPiece value;
+  TF_ASSERT_OK(file->GetStringValue(slot, &value));
+  EXPECT_EQ("answer", value);
+
+  TF_ASSERT_OK(
+      PerfectHashTableFile::Open(Env::Default(), string_keys_path, &file));
+  slot = file->Find(PerfectHashTableFingerprint("answer"));
+  ASSERT_GE(slot, 0);
+  EXPECT_EQ(42, file->GetInt64Value(slot));
+}
+
+TEST(PerfectHashTableTest, EmptyTable) {
+  PerfectHashTableBuilder builder(DT_STRING, DT_INT64);
+  const std::string path = TablePath("empty");
+  TF_ASSERT_OK(builder.Write(Env::Default(), path));
+
+  std::unique_ptr<PerfectHashTableFile> file;
+  TF_ASSERT_OK(PerfectHashTableFile::Open(Env::Default(), path, &file));
+  EXPECT_EQ(0, file->size());
+  EXPECT_EQ(-1, file->Find(PerfectHashTableFingerprint("a")));
+}
+
+TEST(PerfectHashTableTest, RejectsWrongTypes) {
+  PerfectHashTableBuilder builder(DT_STRING, DT_INT64);
+  EXPECT_EQ(error::INVALID_ARGUMENT, builder.Add(1, 2).code());
+  EXPECT_EQ(error::INVALID_ARGUMENT, builder.Add("a", "b").code());
+  EXPECT_EQ(0, builder.size());
+
+  PerfectHashTableBuilder float_values(DT_STRING, DT_FLOAT);
+  EXPECT_EQ(error::INVALID_ARGUMENT,
+            float_values.Write(Env::Default(), TablePath("float")).code());
+}
+
+TEST(PerfectHashTableTest, RejectsDuplicateKeys) {
+  PerfectHashTableBuilder builder(DT_STRING, DT_INT64);
+  TF_ASSERT_OK(builder.Add("a", 1));
+  TF_ASSERT_OK(builder.Add("b", 2));
+  TF_ASSERT_OK(builder.Add("a", 3));
+  EXPECT_EQ(error::INVALID_ARGUMENT,
+            builder.Write(Env::Default(), TablePath("duplicates")).code());
+}
+
+TEST(PerfectHashTableTest, RejectsInvalidFiles) {
+  std::unique_ptr<PerfectHashTableFile> file;
+  const std::string not_a_table = TablePath("not_a_table");
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), not_a_table,
+                                 std::string(256, 'x')));
+  EXPECT_EQ(error::DATA_LOSS,
+            PerfectHashTableFile::Open(Env::Default(), not_a_table, &file)
+                .code());
+
+  PerfectHashTableBuilder builder(DT_INT64, DT_INT64);
+  for (int64_t key = 0; key < 100; ++key) {
+    TF_ASSERT_OK(builder.Add(key, key));
+  }
+  const std::string path = TablePath("truncated");
+  TF_ASSERT_OK(builder.Write(Env::Default(), path));
+  std::string contents;
+  TF_ASSERT_OK(ReadFileToString(Env::Default(), path, &contents));
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), path,
+                                 contents.substr(0, contents.size() - 8)));
+  EXPECT_EQ(error::DATA_LOSS,
+            PerfectHashTableFile::Open(Env::Default(), path, &file).code());
+}
+
+}  // namespace
+}  // namespace lookup
+}  // namespace tensorflow
@@ -12,9 +12,11 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
+#include <cstring>
 #include <limits>
 #include <memory>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #include "absl/status/status.h"
@@ -48,9 +50,11 @@ class FeatureReader {
   // Returns the number of feature values in the specified batch.
   virtual int64_t FeatureCount(int64_t batch) const = 0;
 
-  // Copies the value for the specified feature to `out`.
-  virtual void ReadValue(int64_t batch, int64_t n, uint64* out) const = 0;
-  virtual void ReadValue(int64_t batch, int64_t n, tstring* out) const = 0;
+  // Copies the values of the features in the specified batch to `out`.  The
+  // writers read each row once, so that a feature is hashed or converted to a
+  // string once rather than once for every cross it appears in.
+  virtual void ReadValues(int64_t batch, std::vector<uint64>* out) const = 0;
+  virtual void ReadValues(int64_t batch, std::vector<tstring>* out) const = 0;
 
   virtual ~FeatureReader() {}
 };
@@ -58,20 +62,20 @@ class FeatureReader {
 using FeatureReaders = std::vector<std::unique_ptr<FeatureReader>>;
 
 // Copies a feature value `src` to a tstring `dst`, using a view if appropriate.
-void CopyToString(const tstring& src, tstring* dst) {
+void CopyFeature(const tstring& src, tstring* dst) {
   if (src.type() == tstring::SMALL) {
     *dst = src;  // string buffer fits in the tstring object (under ~24 bytes)
   } else {
     dst->assign_as_view(src);
   }
 }
-void CopyToString(int64_t src, tstring* dst) { *dst = std::to_string(src); }
+void CopyFeature(int64_t src, tstring* dst) { *dst = std::to_string(src); }
 
 // Copies a feature value `src` to an int64 fingerprint `dst`.
-void CopyToFingerprint(const tstring& feature, uint64* dst) {
+void CopyFeature(const tstring& feature, uint64* dst) {
   *dst = Fingerprint64(feature);
 }
-void CopyToFingerprint(int64_t feature, uint64* dst) { *dst = feature; }
+void CopyFeature(int64_t feature, uint64* dst) { *dst = feature; }
 
 // A FeatureReader that is backed by a ragged tensor.
 template <typename ValuesType, typename SplitsType>
@@ -85,15 +89,24 @@ class RaggedFeatureReader : public FeatureReader {
     return row_splits_(batch + 1) - row_splits_(batch);
   }
 
-  void ReadValue(int64_t batch, int64_t n, uint64* out) const override {
-    CopyToFingerprint(values_(row_splits_(batch) + n), out);
+  void ReadValues(int64_t batch, std::vector<uint64>* out) const override {
+    ReadValuesImpl(batch, out);
   }
 
-  void ReadValue(int64_t batch, int64_t n, tstring* out) const override {
-    CopyToString(values_(row_splits_(batch) + n), out);
+  void ReadValues(int64_t batch, std::vector<tstring>* out) const override {
+    ReadValuesImpl(batch, out);
   }
 
  private:
+  template <typename T>
+  void ReadValuesImpl(int64_t batch, std::vector<T>* out) const {
+    const int64_t begin = row_splits_(batch);
+    out->resize(row_splits_(batch + 1) - begin);
+    for (int64_t n = 0; n < out->size(); ++n) {
+      CopyFeature(values_(begin + n), &(*out)[n]);
+    }
+  }
+
   const typename TTypes<ValuesType>::ConstFlat values_;
   const typename TTypes<SplitsType>::ConstFlat row_splits_;
 };
@@ -108,15 +121,23 @@ class DenseFeatureReader : public FeatureReader {
 
   int64_t FeatureCount(int64_t batch) const override { return feature_count_; }
 
-  void ReadValue(int64_t batch, int64_t n, uint64* out) const override {
-    CopyToFingerprint(values_(batch, n), out);
+  void ReadValues(int64_t batch, std::vector<uint64>* out) const override {
+    ReadValuesImpl(batch, out);
   }
 
-  void ReadValue(int64_t batch, int64_t n, tstring* out) const override {
-    CopyToString(values_(batch, n), out);
+  void ReadValues(int64_t batch, std::vector<tstring>* out) const override {
+    ReadValuesImpl(batch, out);
   }
 
  private:
+  template <typename T>
+  void ReadValuesImpl(int64_t batch, std::vector<T>* out) const {
+    out->resize(feature_count_);
+    for (int64_t n = 0; n < feature_count_; ++n) {
+      CopyFeature(values_(batch, n), &(*out)[n]);
+    }
+  }
+
   const typename TTypes<ValuesType>::ConstMatrix values_;
   const int64_t feature_count_;
 };
@@ -143,15 +164,24 @@ class SparseFeatureReader : public FeatureReader {
     return row_splits_[batch + 1] - row_splits_[batch];
   }
 
-  void ReadValue(int64_t batch, int64_t n, uint64* out) const override {
-    CopyToFingerprint(values_(row_splits_[batch] + n), out);
+  void ReadValues(int64_t batch, std::vector<uint64>* out) const override {
+    ReadValuesImpl(batch, out);
   }
 
-  void ReadValue(int64_t batch, int64_t n, tstring* out) const override {
-    CopyToString(values_(row_splits_[batch] + n), out);
+  void ReadValues(int64_t batch, std::vector<tstring>* out) const override {
+    ReadValuesImpl(batch, out);
   }
 
  private:
+  template <typename T>
+  void ReadValuesImpl(int64_t batch, std::vector<T>* out) const {
+    const int64_t begin = row_splits_[batch];
+    out->resize(row_splits_[batch + 1] - begin);
+    for (int64_t n = 0; n < out->size(); ++n) {
+      CopyFeature(values_(begin + n), &(*out)[n]);
+    }
+  }
+
   const typename TTypes<ValuesType>::ConstFlat values_;
   std::vector<int64_t> row_splits_;
 };
@@ -188,42 +218,73 @@ class OutputWriterImpl : public OutputWriter {
   // Reads features from the specified slice of batch indices, computes
   // feature crosses for each one, and writes them to values_out_.
   void WriteOutputSlice(int64_t begin, int64_t end) override {
-    std::vector<int> combination(features_.size(), 0);
+    std::vector<std::vector<FeatureType>> row(features_.size());
+    std::vector<int> combination;
+    std::vector<uint64> prefix_hashes(features_.size() + 1);
     for (int64_t b = begin; b < end; ++b) {
       auto row_start = splits_out_(b);
       auto row_limit = splits_out_(b + 1);
+      if (row_start == row_limit) continue;
+      for (int i = 0; i < features_.size(); ++i) {
+        features_[i]->ReadValues(b, &row[i]);
+      }
+      combination.assign(features_.size(), 0);
+      int first_changed = 0;
       for (auto i = row_start; i < row_limit; ++i) {
-        WriteCombination(b, combination, &values_out_(i));
-        NextCombination(b, &combination);
+        WriteCombination(row, combination, first_changed, &prefix_hashes,
+                         &values_out_(i));
+        first_changed = NextCombination(row, &combination);
       }
-      combination.assign(features_.size(), 0);  // reset for next batch.
     }
   }
 
  private:
+  // The value of a feature in a cross: its string for tf.ragged.cross, and its
+  // fingerprint for tf.ragged.cross_hashed.
+  using FeatureType =
+      typename std::conditional<std::is_same<ValuesType, tstring>::value,
+                                tstring, uint64>::type;
+
   // Joins the specified combination of input features into a single string,
-  // and writes it to *out.
-  void WriteCombination(int64_t batch_index,
-                        const std::vector<int>& combination, tstring* out) {
-    static const auto k_feature_separator = "_X_";
-    gtl::InlinedVector<tstring, 6> cross_vec(features_.size());
+  // and writes it to *out without building temporary strings.
+  void WriteCombination(const std::vector<std::vector<tstring>>& row,
+                        const std::vector<int>& combination,
+                        int first_changed_unused,
+                        std::vector<uint64>* prefix_hashes_unused,
+                        tstring* out) {
+    static constexpr StringPiece k_feature_separator = "_X_";
+    size_t size = k_feature_separator.size() * (combination.size() - 1);
+    for (int i = 0; i < combination.size(); ++i) {
+      size += row[i][combination[i]].size();
+    }
+    out->resize_uninitialized(size);
+    char* dst = out->mdata();
     for (int i = 0; i < combination.size(); ++i) {
-      features_[i]->ReadValue(batch_index, combination[i], &cross_vec[i]);
+      if (i > 0) {
+        std::memcpy(dst, k_feature_separator.data(),
+                    k_feature_separator.size());
+        dst += k_feature_separator.size();
+      }
+      const tstring& feature = row[i][combination[i]];
+      std::memcpy(dst, feature.data(), feature.size());
+      dst += feature.size();
     }
-    *out = absl::StrJoin(cross_vec, k_feature_separator);
   }
 
   // Joins the specified combination of input features into a single
-  // fingerprint, and writes it to *out.
-  void WriteCombination(int64_t batch_index,
-                        const std::vector<int>& combination, int64_t* out) {
+  // fingerprint, and writes it to *out.  (*prefix_hashes)[i] holds the
+  // fingerprint of the first i features of the previous combination, so only
+  // the features from `first_changed` on are concatenated.
+  void WriteCombination(const std::vector<std::vector<uint64>>& row,
+                        const std::vector<int>& combination, int first_changed,
+                        std::vector<uint64>* prefix_hashes, int64_t* out) {
     // Do the fingerprint concatenation on uint64.
-    uint64 hashed_output = hash_key_;
-    for (size_t i = 0; i < combination.size(); ++i) {
-      uint64 hash_i;
-      features_[i]->ReadValue(batch_index, combination[i], &hash_i);
-      hashed_output = FingerprintCat64(hashed_output, hash_i);
+    (*prefix_hashes)[0] = hash_key_;
+    for (size_t i = first_changed; i < combination.size(); ++i) {
+      (*prefix_hashes)[i + 1] =
+          FingerprintCat64((*prefix_hashes)[i], row[i][combination[i]]);
     }
+    const uint64 hashed_output = (*prefix_hashes)[combination.size()];
     // The return value is int64 based on the number of buckets.
     if (num_buckets_ > 0) {
       *out = hashed_output % num_buckets_;
@@ -233,21 +294,17 @@ class OutputWriterImpl : public OutputWriter {
     }
   }
 
-  // Updates `combination` to the next combination of input features.
-  void NextCombination(int64_t batch_index,
-                       std::vector<int>* combination) const {
-    bool carry = true;
-    for (int i = combination->size() - 1; i >= 0; i--) {
-      if (carry) {
-        (*combination)[i] = (*combination)[i] + 1;
-      }
-      if ((*combination)[i] == features_[i]->FeatureCount(batch_index)) {
-        (*combination)[i] = 0;
-      } else {
-        carry = false;
-        break;
-      }
+  // Updates `combination` to the next combination of input features, and
+  // returns the index of the first feature that changed.
+  int NextCombination(const std::vector<std::vector<FeatureType>>& row,
+                      std::vector<int>* combination) const {
+    int i = combination->size() - 1;
+    while (i > 0 && ++(*combination)[i] == row[i].size()) {
+      (*combination)[i] = 0;
+      --i;
     }
+    if (i == 0) ++(*combination)[0];
+    return i;
   }
 
   const FeatureReaders& features_;
@@ -367,8 +424,13 @@ class RaggedCrossOp : public OpKernel {
       output_writer->WriteOutputSlice(begin, end);
     };
 
-    // TODO(edloper): optimize cost_per_batch
-    const int cost_per_batch = 5000 * ragged_values_list.size();
+    // The cost of a batch grows with its number of crosses, which were
+    // counted when the row splits were built.
+    const int64_t kCostPerCrossedFeature = 100;
+    const int64_t crosses_per_batch =
+        batch_size > 0 ? values_out->NumElements() / batch_size : 0;
+    const int64_t cost_per_batch =
+        (1 + crosses_per_batch) * features.size() * kCostPerCrossedFeature;
     auto thread_pool =
         context->device()->tensorflow_cpu_worker_threads()->workers;
     thread_pool->ParallelFor(batch_size, cost_per_batch, do_work);
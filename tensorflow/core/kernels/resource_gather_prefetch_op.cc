@@ -0,0 +1,314 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/resource_variable_ops.cc.
+
+#include "tensorflow/core/kernels/resource_gather_prefetch_op.h"
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "tensorflow/core/framework/bounds_check.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/monitoring/counter.h"
+#include "tensorflow/core/platform/strcat.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+void ResourceGatherPrefetcher::Gather::RunWhenDone(
+    std::function<void()> callback) {
+  {
+    mutex_lock l(mu_);
+    if (!done_) {
+      callbacks_.push_back(std::move(callback));
+      return;
+    }
+  }
+  callback();
+}
+
+void ResourceGatherPrefetcher::Gather::Done() {
+  std::vector<std::function<void()>> callbacks;
+  {
+    mutex_lock l(mu_);
+    done_ = true;
+    callbacks.swap(callbacks_);
+  }
+  for (const auto& callback : callbacks) {
+    callback();
+  }
+}
+
+void ResourceGatherPrefetcher::Add(std::shared_ptr<Gather> gather) {
+  mutex_lock l(mu_);
+  gathers_.push_back(std::move(gather));
+  while (gathers_.size() > static_cast<size_t>(capacity_)) {
+    gathers_.pop_front();
+  }
+}
+
+std::shared_ptr<ResourceGatherPrefetcher::Gather>
+ResourceGatherPrefetcher::Take(const Var* var, const Tensor& indices) {
+  const StringPiece indices_data = indices.tensor_data();
+  mutex_lock l(mu_);
+  for (auto it = gathers_.begin(); it != gathers_.end(); ++it) {
+    const Gather& gather = **it;
+    if (gather.var.get() == var &&
+        gather.indices.dtype() == indices.dtype() &&
+        gather.indices.shape() == indices.shape() &&
+        gather.indices.tensor_data() == indices_data) {
+      std::shared_ptr<Gather> result = std::move(*it);
+      gathers_.erase(it);
+      return result;
+    }
+  }
+  return nullptr;
+}
+
+std::string ResourceGatherPrefetcher::DebugString() const {
+  mutex_lock l(mu_);
+  return strings::StrCat("ResourceGatherPrefetcher with ", gathers_.size(),
+                         " of ", capacity_, " gathers");
+}
+
+namespace {
+
+auto* resource_gather_prefetch_counter = monitoring::Counter<1>::New(
+    "/tensorflow/core/resource_gather_prefetch",
+    "The number of ResourceGatherPrefetched ops whose rows were prefetched "
+    "(hit), prefetched before an update of the variable (stale) or not "
+    "prefetched (miss).",
+    "result");
+
+// Checks that the rows `indices` of `var` can be gathered as `dtype`, and
+// returns the shape of the gathered rows.
+template <typename Index>
+Status ValidateGather(Var* var, DataType dtype, const Tensor& indices,
+                      TensorShape* shape) {
+  if (!var->is_initialized) {
+    return errors::FailedPrecondition(
+        "Trying to gather from an uninitialized variable");
+  }
+  const Tensor& params = *var->tensor();
+  if (params.dtype() != dtype) {
+    return errors::InvalidArgument(
+        "Trying to gather from variable with wrong dtype. Expected ",
+        DataTypeString(params.dtype()), " got ", DataTypeString(dtype));
+  }
+  if (params.dims() < 1) {
+    return errors::InvalidArgument("params must be at least 1 dimensional");
+  }
+  const int64_t limit = params.dim_size(0);
+  const auto ids = indices.flat<Index>();
+  for (int64_t i = 0; i < ids.size(); ++i) {
+    if (!FastBoundsCheck(ids(i), limit)) {
+      return errors::InvalidArgument("indices[", i, "] = ", ids(i),
+                                     " is not in [0, ", limit, ")");
+    }
+  }
+  *shape = indices.shape();
+  for (int d = 1; d < params.dims(); ++d) {
+    TF_RETURN_IF_ERROR(shape->AddDimWithStatus(params.dim_size(d)));
+  }
+  return OkStatus();
+}
+
+// Copies the validated rows `indices[start:end]` of `params` to `rows`.
+template <typename Index>
+void CopyRowRange(const Tensor& params, const Tensor& indices, int64_t start,
+                  int64_t end, Tensor* rows) {
+  const auto ids = indices.flat<Index>();
+  const int64_t row_bytes = params.TotalBytes() / params.dim_size(0);
+  const char* src = params.tensor_data().data();
+  char* dst = const_cast<char*>(rows->tensor_data().data());
+  for (int64_t i = start; i < end; ++i) {
+    std::memcpy(dst + i * row_bytes, src + ids(i) * row_bytes, row_bytes);
+  }
+}
+
+// Copies the validated rows `indices` of `params` to `rows`, sharded over
+// `worker_threads`.
+template <typename Index>
+void CopyRows(const Tensor& params, const Tensor& indices,
+              const DeviceBase::CpuWorkerThreads& worker_threads,
+              Tensor* rows) {
+  const int64_t num_rows = indices.NumElements();
+  if (num_rows == 0) return;
+  const int64_t row_bytes = params.TotalBytes() / params.dim_size(0);
+  Shard(worker_threads.num_threads, worker_threads.workers, num_rows,
+        row_bytes, [&](int64_t start, int64_t end) {
+          CopyRowRange<Index>(params, indices, start, end, rows);
+        });
+}
+
+template <typename Index>
+class PrefetchResourceGatherOp : public OpKernel {
+ public:
+  explicit PrefetchResourceGatherOp(OpKernelConstruction* c) : OpKernel(c) {
+    OP_REQUIRES_OK(c, c->GetAttr("dtype", &dtype_));
+    OP_REQUIRES_OK(c, c->GetAttr("capacity", &capacity_));
+    OP_REQUIRES(c, DataTypeCanUseMemcpy(dtype_),
+                errors::Unimplemented("PrefetchResourceGather does not "
+                                      "support variables of type ",
+                                      DataTypeString(dtype_)));
+  }
+
+  void Compute(OpKernelContext* c) override {
+    core::RefCountPtr<Var> var;
+    OP_REQUIRES_OK(c, LookupResource(c, HandleFromInput(c, 0), &var));
+    core::RefCountPtr<ResourceGatherPrefetcher> prefetcher;
+    OP_REQUIRES_OK(c, LookupOrCreateResource<ResourceGatherPrefetcher>(
+                          c, HandleFromInput(c, 2), &prefetcher,
+                          [this](ResourceGatherPrefetcher** ptr) {
+                            *ptr = new ResourceGatherPrefetcher(capacity_);
+                            return OkStatus();
+                          }));
+    auto gather = std::make_shared<ResourceGatherPrefetcher::Gather>(
+        std::move(var), c->input(1));
+    prefetcher->Add(gather);
+
+    // The rows are copied with the version of the variable read before them,
+    // so that an update racing with the copy makes them stale. The task copies
+    // them serially: it already runs on the intra-op thread pool, and must not
+    // wait for other tasks of that pool.
+    const DataType dtype = dtype_;
+    c->device()->tensorflow_cpu_worker_threads()->workers->Schedule(
+        [gather, dtype]() {
+          {
+            tf_shared_lock ml(*gather->var->mu());
+            const Tensor& params = *gather->var->tensor();
+            gather->version = gather->var->version.load();
+            gather->params_data = params.tensor_data().data();
+            TensorShape shape;
+            gather->status = ValidateGather<Index>(
+                gather->var.get(), dtype, gather->indices, &shape);
+            if (gather->status.ok()) {
+              gather->rows = Tensor(dtype, shape);
+              CopyRowRange<Index>(params, gather->indices, 0,
+                                  gather->indices.NumElements(),
+                                  &gather->rows);
+            }
+          }
+          gather->Done();
+        });
+  }
+
+ private:
+  DataType dtype_;
+  int capacity_;
+};
+
+template <typename Index>
+class ResourceGatherPrefetchedOp : public AsyncOpKernel {
+ public:
+  explicit ResourceGatherPrefetchedOp(OpKernelConstruction* c)
+      : AsyncOpKernel(c) {
+    OP_REQUIRES_OK(c, c->GetAttr("dtype", &dtype_));
+    OP_REQUIRES(c, DataTypeCanUseMemcpy(dtype_),
+                errors::Unimplemented("ResourceGatherPrefetched does not "
+                                      "support variables of type ",
+                                      DataTypeString(dtype_)));
+  }
+
+  void ComputeAsync(OpKernelContext* c, DoneCallback done) override {
+    core::RefCountPtr<Var> var;
+    OP_REQUIRES_OK_ASYNC(c, LookupResource(c, HandleFromInput(c, 0), &var),
+                         done);
+
+    // A prefetcher that does not exist yet has no prefetched rows.
+    core::RefCountPtr<ResourceGatherPrefetcher> prefetcher;
+    const Status s = LookupResource(c, HandleFromInput(c, 2), &prefetcher);
+    OP_REQUIRES_ASYNC(c, s.ok() || errors::IsNotFound(s), s, done);
+    std::shared_ptr<ResourceGatherPrefetcher::Gather> gather;
+    if (prefetcher) {
+      gather = prefetcher->Take(var.get(), c->input(1));
+    }
+    if (!gather) {
+      GatherRows(c, var.get(), nullptr);
+      done();
+      return;
+    }
+    // The gather holds a reference to the variable until it is consumed.
+    gather->RunWhenDone([this, c, gather, done]() {
+      GatherRows(c, gather->var.get(), gather.get());
+      done();
+    });
+  }
+
+ private:
+  // Outputs the rows of `gather` if the variable has not been updated since
+  // they were copied, or copies them from the variable otherwise. A gather is
+  // consumed in a callback of its Done(), on the thread of the prefetch task,
+  // so its rows are copied serially rather than sharded over that pool.
+  void GatherRows(OpKernelContext* c, Var* var,
+                  const ResourceGatherPrefetcher::Gather* gather) {
+    const Tensor& indices = c->input(1);
+    tf_shared_lock ml(*var->mu());
+    const char* result = "miss";
+    if (gather != nullptr && gather->status.ok()) {
+      // The buffer catches the writers that replace the tensor of the
+      // variable without marking it as updated.
+      if (gather->version == var->version.load() &&
+          gather->params_data == var->tensor()->tensor_data().data()) {
+        resource_gather_prefetch_counter->GetCell("hit")->IncrementBy(1);
+        c->set_output(0, gather->rows);
+        return;
+      }
+      result = "stale";
+    }
+    resource_gather_prefetch_counter->GetCell(result)->IncrementBy(1);
+
+    TensorShape shape;
+    OP_REQUIRES_OK(c, ValidateGather<Index>(var, dtype_, indices, &shape));
+    Tensor* rows = nullptr;
+    OP_REQUIRES_OK(c, c->allocate_output(0, shape, &rows));
+    if (gather != nullptr) {
+      CopyRowRange<Index>(*var->tensor(), indices, 0, indices.NumElements(),
+                          rows);
+    } else {
+      CopyRows<Index>(*var->tensor(), indices,
+                      *c->device()->tensorflow_cpu_worker_threads(), rows);
+    }
+  }
+
+  DataType dtype_;
+};
+
+}  // namespace
+
+REGISTER_RESOURCE_HANDLE_KERNEL(ResourceGatherPrefetcher);
+
+#define REGISTER_KERNELS(index_type)                                   \
+  REGISTER_KERNEL_BUILDER(Name("PrefetchResourceGather")               \
+                              .Device(DEVICE_CPU)                      \
+                              .TypeConstraint<index_type>("Tindices"), \
+                          PrefetchResourceGatherOp<index_type>);       \
+  REGISTER_KERNEL_BUILDER(Name("ResourceGatherPrefetched")             \
+                              .Device(DEVICE_CPU)                      \
+                              .TypeConstraint<index_type>("Tindices"), \
+                          ResourceGatherPrefetchedOp<index_type>);
+
+TF_CALL_int32(REGISTER_KERNELS);
+TF_CALL_int64(REGISTER_KERNELS);
+#undef REGISTER_KERNELS
+
+}  // namespace tensorflow
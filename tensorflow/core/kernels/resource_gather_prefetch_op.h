@@ -0,0 +1,87 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_KERNELS_RESOURCE_GATHER_PREFETCH_OP_H_
+#define TENSORFLOW_CORE_KERNELS_RESOURCE_GATHER_PREFETCH_OP_H_
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/framework/resource_base.h"
+#include "tensorflow/core/framework/resource_var.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/refcount.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+
+namespace tensorflow {
+
+// Staging buffer of the rows that PrefetchResourceGather gathers from resource
+// variables in the background, until a ResourceGatherPrefetched op with the
+// same variable and indices takes them.
+class ResourceGatherPrefetcher : public ResourceBase {
+ public:
+  // A gather of the rows `indices` of `var`.
+  struct Gather {
+    Gather(core::RefCountPtr<Var> var, const Tensor& indices)
+        : var(std::move(var)), indices(indices) {}
+
+    const core::RefCountPtr<Var> var;
+    const Tensor indices;
+
+    // Runs `callback` once the rows have been copied, right away if they
+    // already are.
+    void RunWhenDone(std::function<void()> callback);
+
+    // Marks the rows as copied and runs the pending callbacks.
+    void Done();
+
+    // Set before Done() is called. `version` and `params_data` are the version
+    // and the buffer of `var` from which `rows` were copied.
+    Status status;
+    int64_t version = -1;
+    const char* params_data = nullptr;
+    Tensor rows;
+
+   private:
+    mutex mu_;
+    bool done_ TF_GUARDED_BY(mu_) = false;
+    std::vector<std::function<void()>> callbacks_ TF_GUARDED_BY(mu_);
+  };
+
+  explicit ResourceGatherPrefetcher(int capacity) : capacity_(capacity) {}
+
+  // Adds a pending gather, dropping the oldest ones beyond the capacity.
+  void Add(std::shared_ptr<Gather> gather);
+
+  // Removes and returns the oldest gather of `indices` from `var`, or nullptr
+  // if there is none.
+  std::shared_ptr<Gather> Take(const Var* var, const Tensor& indices);
+
+  std::string DebugString() const override;
+
+ private:
+  const int capacity_;
+  mutable mutex mu_;
+  std::deque<std::shared_ptr<Gather>> gathers_ TF_GUARDED_BY(mu_);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_RESOURCE_GATHER_PREFETCH_OP_H_
@@ -0,0 +1,299 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/resource_gather_prefetch_op.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/resource_handle.h"
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/framework/resource_var.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/type_index.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/monitoring/cell_reader.h"
+#include "tensorflow/core/platform/notification.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+using ::tensorflow::monitoring::testing::CellReader;
+
+constexpr char kPrefetchMetric[] = "/tensorflow/core/resource_gather_prefetch";
+
+class ResourceGatherPrefetchOpTest : public OpsTestBase {
+ protected:
+  // Creates a variable of 5 rows of 2 columns, where row i is {i, 10 * i},
+  // and a prefetcher of capacity 2.
+  void SetUp() override {
+    ResourceMgr* rm = device_->resource_manager();
+    var_ = new Var(DT_FLOAT);
+    *var_->tensor() = test::AsTensor<float>(
+        {0, 0, 1, 10, 2, 20, 3, 30, 4, 40}, TensorShape({5, 2}));
+    var_->is_initialized = true;
+    TF_ASSERT_OK(rm->Create(rm->default_container(), "var", var_));
+    prefetcher_ = new ResourceGatherPrefetcher(/*capacity=*/2);
+    TF_ASSERT_OK(
+        rm->Create(rm->default_container(), "prefetcher", prefetcher_));
+  }
+
+  Status RunOp(const string& op, const std::vector<int32>& indices) {
+    TF_RETURN_IF_ERROR(NodeDefBuilder("op", op)
+                           .Input(FakeInput(DT_RESOURCE))
+                           .Input(FakeInput(DT_INT32))
+                           .Input(FakeInput(DT_RESOURCE))
+                           .Attr("dtype", DT_FLOAT)
+                           .Finalize(node_def()));
+    TF_RETURN_IF_ERROR(InitOp());
+    inputs_.clear();
+    AddHandleInput<Var>("var");
+    AddInputFromArray<int32>(
+        TensorShape({static_cast<int64_t>(indices.size())}), indices);
+    AddHandleInput<ResourceGatherPrefetcher>("prefetcher");
+    return RunOpKernel();
+  }
+
+  // Waits for the pending gather of `indices`.
+  void WaitForPrefetch(const std::vector<int32>& indices) {
+    std::shared_ptr<ResourceGatherPrefetcher::Gather> gather =
+        prefetcher_->Take(var_, test::AsTensor<int32>(indices));
+    ASSERT_NE(gather, nullptr);
+    Notification done;
+    gather->RunWhenDone([&done]() { done.Notify(); });
+    done.WaitForNotification();
+    prefetcher_->Add(std::move(gather));
+  }
+
+  // Runs the op `builder` writing the variable, with the inputs added by
+  // `add_inputs`.
+  Status RunWriter(NodeDefBuilder builder,
+                   const std::function<void()>& add_inputs) {
+    TF_RETURN_IF_ERROR(builder.Finalize(node_def()));
+    TF_RETURN_IF_ERROR(InitOp());
+    inputs_.clear();
+    add_inputs();
+    return RunOpKernel();
+  }
+
+  // Prefetches rows {3, 0}, runs `write` once they are copied, and expects
+  // ResourceGatherPrefetched to find them stale and return `expected`.
+  void ExpectStaleAfterWrite(const std::function<Status()>& write,
+                             const std::vector<float>& expected) {
+    CellReader<int64_t> reader(kPrefetchMetric);
+    TF_ASSERT_OK(RunOp("PrefetchResourceGather", {3, 0}));
+    WaitForPrefetch({3, 0});
+    TF_ASSERT_OK(write());
+    TF_ASSERT_OK(RunOp("ResourceGatherPrefetched", {3, 0}));
+
+    test::ExpectTensorEqual<float>(
+        test::AsTensor<float>(expected, TensorShape({2, 2})), *GetOutput(0));
+    EXPECT_EQ(reader.Delta("stale"), 1);
+    EXPECT_EQ(reader.Delta("hit"), 0);
+  }
+
+  template <typename T>
+  void AddHandleInput(const string& name) {
+    ResourceMgr* rm = device_->resource_manager();
+    AddInputFromArray<ResourceHandle>(
+        TensorShape({}), {MakeResourceHandle(rm->default_container(), name,
+                                             *device_, TypeIndex::Make<T>())});
+  }
+
+  Var* var_ = nullptr;
+  ResourceGatherPrefetcher* prefetcher_ = nullptr;
+};
+
+TEST_F(ResourceGatherPrefetchOpTest, Hit) {
+  CellReader<int64_t> reader(kPrefetchMetric);
+  TF_ASSERT_OK(RunOp("PrefetchResourceGather", {4, 1, 4}));
+  TF_ASSERT_OK(RunOp("ResourceGatherPrefetched", {4, 1, 4}));
+
+  test::ExpectTensorEqual<float>(
+      test::AsTensor<float>({4, 40, 1, 10, 4, 40}, TensorShape({3, 2})),
+      *GetOutput(0));
+  EXPECT_EQ(reader.Delta("hit"), 1);
+  EXPECT_EQ(reader.Delta("miss"), 0);
+
+  // The prefetched rows are consumed.
+  TF_ASSERT_OK(RunOp("ResourceGatherPrefetched", {4, 1, 4}));
+  EXPECT_EQ(reader.Delta("miss"), 1);
+}
+
+TEST_F(ResourceGatherPrefetchOpTest, MissWithOtherIndices) {
+  CellReader<int64_t> reader(kPrefetchMetric);
+  TF_ASSERT_OK(RunOp("PrefetchResourceGather", {4, 1}));
+  TF_ASSERT_OK(RunOp("ResourceGatherPrefetched", {1, 4}));
+
+  test::ExpectTensorEqual<float>(
+      test::AsTensor<float>({1, 10, 4, 40}, TensorShape({2, 2})),
+      *GetOutput(0));
+  EXPECT_EQ(reader.Delta("miss"), 1);
+  EXPECT_EQ(reader.Delta("hit"), 0);
+}
+
+TEST_F(ResourceGatherPrefetchOpTest, StaleAfterUpdate) {
+  CellReader<int64_t> reader(kPrefetchMetric);
+  TF_ASSERT_OK(RunOp("PrefetchResourceGather", {3, 0}));
+  WaitForPrefetch({3, 0});
+  {
+    mutex_lock ml(*var_->mu());
+    var_->tensor()->matrix<float>()(3, 1) = -30;
+    var_->MarkUpdated();
+  }
+  TF_ASSERT_OK(RunOp("ResourceGatherPrefetched", {3, 0}));
+
+  test::ExpectTensorEqual<float>(
+      test::AsTensor<float>({3, -30, 0, 0}, TensorShape({2, 2})),
+      *GetOutput(0));
+  EXPECT_EQ(reader.Delta("stale"), 1);
+  EXPECT_EQ(reader.Delta("hit"), 0);
+}
+
+TEST_F(ResourceGatherPrefetchOpTest, StaleAfterResourceScatterAdd) {
+  ExpectStaleAfterWrite(
+      [this]() {
+        return RunWriter(NodeDefBuilder("write", "ResourceScatterAdd")
+                             .Input(FakeInput(DT_RESOURCE))
+                             .Input(FakeInput(DT_INT32))
+                             .Input(FakeInput(DT_FLOAT)),
+                         [this]() {
+                           AddHandleInput<Var>("var");
+                           AddInputFromArray<int32>(TensorShape({1}), {3});
+                           AddInputFromArray<float>(TensorShape({1, 2}),
+                                                    {1, 1});
+                         });
+      },
+      {4, 31, 0, 0});
+}
+
+TEST_F(ResourceGatherPrefetchOpTest, StaleAfterAssignAddVariableOp) {
+  ExpectStaleAfterWrite(
+      [this]() {
+        return RunWriter(NodeDefBuilder("write", "AssignAddVariableOp")
+                             .Input(FakeInput(DT_RESOURCE))
+                             .Input(FakeInput(DT_FLOAT))
+                             .Attr("dtype", DT_FLOAT),
+                         [this]() {
+                           AddHandleInput<Var>("var");
+                           AddInputFromArray<float>(
+                               TensorShape({5, 2}),
+                               {1, 1, 1, 1, 1, 1, 1, 1, 1, 1});
+                         });
+      },
+      {4, 31, 1, 1});
+}
+
+TEST_F(ResourceGatherPrefetchOpTest, StaleAfterResourceSparseApplyAdagrad) {
+  Var* accum = new Var(DT_FLOAT);
+  *accum->tensor() = Tensor(DT_FLOAT, TensorShape({5, 2}));
+  accum->tensor()->flat<float>().setZero();
+  accum->is_initialized = true;
+  ResourceMgr* rm = device_->resource_manager();
+  TF_ASSERT_OK(rm->Create(rm->default_container(), "accum", accum));
+
+  // With a zero accumulator, the update of row 3 is -lr * sign(grad).
+  ExpectStaleAfterWrite(
+      [this]() {
+        return RunWriter(NodeDefBuilder("write", "ResourceSparseApplyAdagrad")
+                             .Input(FakeInput(DT_RESOURCE))
+                             .Input(FakeInput(DT_RESOURCE))
+                             .Input(FakeInput(DT_FLOAT))
+                             .Input(FakeInput(DT_FLOAT))
+                             .Input(FakeInput(DT_INT32)),
+                         [this]() {
+                           AddHandleInput<Var>("var");
+                           AddHandleInput<Var>("accum");
+                           AddInputFromArray<float>(TensorShape({}), {1});
+                           AddInputFromArray<float>(TensorShape({1, 2}),
+                                                    {1, 1});
+                           AddInputFromArray<int32>(TensorShape({1}), {3});
+                         });
+      },
+      {2, 29, 0, 0});
+}
+
+TEST_F(ResourceGatherPrefetchOpTest, StaleAfterResourceApplyGradientDescent) {
+  ExpectStaleAfterWrite(
+      [this]() {
+        return RunWriter(
+            NodeDefBuilder("write", "ResourceApplyGradientDescent")
+                .Input(FakeInput(DT_RESOURCE))
+                .Input(FakeInput(DT_FLOAT))
+                .Input(FakeInput(DT_FLOAT)),
+            [this]() {
+              AddHandleInput<Var>("var");
+              AddInputFromArray<float>(TensorShape({}), {1});
+              AddInputFromArray<float>(TensorShape({5, 2}),
+                                       {1, 1, 1, 1, 1, 1, 1, 1, 1, 1});
+            });
+      },
+      {2, 29, -1, -1});
+}
+
+TEST_F(ResourceGatherPrefetchOpTest, StaleAfterReplacementWithoutVersion) {
+  CellReader<int64_t> reader(kPrefetchMetric);
+  TF_ASSERT_OK(RunOp("PrefetchResourceGather", {3, 0}));
+  WaitForPrefetch({3, 0});
+  {
+    // Like the writers that replace the tensor of the variable without
+    // marking it as updated.
+    mutex_lock ml(*var_->mu());
+    *var_->tensor() = test::AsTensor<float>(
+        {0, -1, 1, 11, 2, 21, 3, 31, 4, 41}, TensorShape({5, 2}));
+  }
+  TF_ASSERT_OK(RunOp("ResourceGatherPrefetched", {3, 0}));
+
+  test::ExpectTensorEqual<float>(
+      test::AsTensor<float>({3, 31, 0, -1}, TensorShape({2, 2})),
+      *GetOutput(0));
+  EXPECT_EQ(reader.Delta("stale"), 1);
+  EXPECT_EQ(reader.Delta("hit"), 0);
+}
+
+TEST_F(ResourceGatherPrefetchOpTest, EvictsOldestGather) {
+  CellReader<int64_t> reader(kPrefetchMetric);
+  TF_ASSERT_OK(RunOp("PrefetchResourceGather", {0}));
+  TF_ASSERT_OK(RunOp("PrefetchResourceGather", {1}));
+  TF_ASSERT_OK(RunOp("PrefetchResourceGather", {2}));
+  TF_ASSERT_OK(RunOp("ResourceGatherPrefetched", {0}));
+  EXPECT_EQ(reader.Delta("miss"), 1);
+  TF_ASSERT_OK(RunOp("ResourceGatherPrefetched", {2}));
+  TF_ASSERT_OK(RunOp("ResourceGatherPrefetched", {1}));
+  EXPECT_EQ(reader.Delta("hit"), 2);
+
+  test::ExpectTensorEqual<float>(
+      test::AsTensor<float>({1, 10}, TensorShape({1, 2})), *GetOutput(0));
+}
+
+TEST_F(ResourceGatherPrefetchOpTest, IndexOutOfRange) {
+  TF_ASSERT_OK(RunOp("PrefetchResourceGather", {1, 5}));
+  Status s = RunOp("ResourceGatherPrefetched", {1, 5});
+  EXPECT_TRUE(
+      absl::StrContains(s.ToString(), "indices[1] = 5 is not in [0, 5)"))
+      << s;
+}
+
+}  // namespace
+}  // namespace tensorflow
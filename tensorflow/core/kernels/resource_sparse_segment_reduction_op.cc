@@ -0,0 +1,453 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/resource_variable_ops.cc.
+
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "Eigen/Core"  // from @eigen_archive
+#include "tensorflow/core/framework/bounds_check.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/framework/resource_var.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/kernels/training_op_helpers.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+typedef Eigen::ThreadPoolDevice CPUDevice;
+
+namespace {
+
+enum class Combiner { kSum, kMean, kSqrtN };
+
+Status GetCombiner(OpKernelConstruction* c, Combiner* combiner) {
+  string name;
+  TF_RETURN_IF_ERROR(c->GetAttr("combiner", &name));
+  if (name == "mean") {
+    *combiner = Combiner::kMean;
+  } else if (name == "sqrtn") {
+    *combiner = Combiner::kSqrtN;
+  } else {
+    *combiner = Combiner::kSum;
+  }
+  return OkStatus();
+}
+
+// Type in which the rows are accumulated.
+template <typename T>
+struct AccumulatorType {
+  using type = T;
+};
+template <>
+struct AccumulatorType<Eigen::half> {
+  using type = float;
+};
+template <>
+struct AccumulatorType<bfloat16> {
+  using type = float;
+};
+
+// The validated combination of the rows of a variable into output rows.
+template <typename Tacc>
+struct Combination {
+  // Variable row and output row of each entry of the combination.
+  std::vector<int64_t> rows;
+  std::vector<int64_t> segments;
+  // Weight of each entry, empty if the combination is unweighted.
+  std::vector<Tacc> weights;
+  // The entries of output row `s` are [segment_starts[s],
+  // segment_starts[s + 1]).
+  std::vector<int64_t> segment_starts;
+  // Scale of each output row, from the combiner.
+  std::vector<Tacc> scales;
+};
+
+// Builds the combination of the inputs of the op, checking that the segment
+// ids are sorted and less than `*num_segments`. If `*num_segments` is -1, it
+// is set to the last segment id + 1. Like the ResourceGather it replaces, it
+// checks that every id is in [0, num_rows), including the ids which no index
+// refers to.
+template <typename T, typename Tids, typename Tidx, typename Tsegmentids,
+          typename Tacc>
+Status BuildCombination(const Tensor& ids, const Tensor& indices,
+                        const Tensor& segment_ids, const Tensor* weights,
+                        int64_t num_rows, Combiner combiner,
+                        int64_t* num_segments,
+                        Combination<Tacc>* combination) {
+  if (!TensorShapeUtils::IsVector(ids.shape())) {
+    return errors::InvalidArgument("ids should be a vector, not shape ",
+                                   ids.shape().DebugString());
+  }
+  if (!TensorShapeUtils::IsVector(indices.shape())) {
+    return errors::InvalidArgument("indices should be a vector, not shape ",
+                                   indices.shape().DebugString());
+  }
+  if (!TensorShapeUtils::IsVector(segment_ids.shape())) {
+    return errors::InvalidArgument("segment_ids should be a vector, not shape ",
+                                   segment_ids.shape().DebugString());
+  }
+  const int64_t num_entries = indices.NumElements();
+  if (segment_ids.NumElements() != num_entries) {
+    return errors::InvalidArgument(
+        "segment_ids and indices should have same size: ",
+        segment_ids.NumElements(), " vs ", num_entries);
+  }
+  if (weights != nullptr && (!TensorShapeUtils::IsVector(weights->shape()) ||
+                             weights->NumElements() != num_entries)) {
+    return errors::InvalidArgument(
+        "weights should be a vector of the size of indices, not shape ",
+        weights->shape().DebugString());
+  }
+
+  const auto ids_vec = ids.vec<Tids>();
+  const auto indices_vec = indices.vec<Tidx>();
+  const auto segment_ids_vec = segment_ids.vec<Tsegmentids>();
+  const int64_t num_ids = ids.NumElements();
+  for (int64_t i = 0; i < num_ids; ++i) {
+    const Tids id = internal::SubtleMustCopy(ids_vec(i));
+    if (!FastBoundsCheck(id, num_rows)) {
+      // The error of ResourceGather, whose indices are the ids.
+      return errors::InvalidArgument("indices[", i, "] = ", id,
+                                     " is not in [0, ", num_rows, ")");
+    }
+  }
+  combination->rows.resize(num_entries);
+  combination->segments.resize(num_entries);
+  for (int64_t j = 0; j < num_entries; ++j) {
+    const Tidx index = internal::SubtleMustCopy(indices_vec(j));
+    if (!FastBoundsCheck(index, num_ids)) {
+      return errors::InvalidArgument("indices[", j, "] = ", index,
+                                     " is not in [0, ", num_ids, ")");
+    }
+    const Tids row = internal::SubtleMustCopy(ids_vec(index));
+    if (!FastBoundsCheck(row, num_rows)) {
+      return errors::InvalidArgument("indices[", index, "] = ", row,
+                                     " is not in [0, ", num_rows, ")");
+    }
+    const int64_t segment = internal::SubtleMustCopy(segment_ids_vec(j));
+    if (segment < 0) {
+      return errors::InvalidArgument("segment ids must be >= 0");
+    }
+    if (j > 0 && segment < combination->segments[j - 1]) {
+      return errors::InvalidArgument("segment ids are not increasing");
+    }
+    combination->rows[j] = row;
+    combination->segments[j] = segment;
+  }
+  const int64_t last_segment =
+      num_entries > 0 ? combination->segments[num_entries - 1] : -1;
+  if (*num_segments < 0) {
+    *num_segments = last_segment + 1;
+  } else if (last_segment >= *num_segments) {
+    return errors::InvalidArgument("segment ids must be < num_segments");
+  }
+
+  combination->weights.clear();
+  if (weights != nullptr) {
+    const auto weights_vec = weights->vec<T>();
+    combination->weights.resize(num_entries);
+    for (int64_t j = 0; j < num_entries; ++j) {
+      combination->weights[j] = static_cast<Tacc>(weights_vec(j));
+    }
+  }
+
+  combination->segment_starts.assign(*num_segments + 1, 0);
+  for (int64_t j = 0; j < num_entries; ++j) {
+    ++combination->segment_starts[combination->segments[j] + 1];
+  }
+  for (int64_t s = 0; s < *num_segments; ++s) {
+    combination->segment_starts[s + 1] += combination->segment_starts[s];
+  }
+
+  combination->scales.assign(*num_segments, Tacc(1));
+  if (combiner == Combiner::kSum) return OkStatus();
+  for (int64_t s = 0; s < *num_segments; ++s) {
+    Tacc total(0);
+    for (int64_t j = combination->segment_starts[s];
+         j < combination->segment_starts[s + 1]; ++j) {
+      const Tacc weight =
+          weights != nullptr ? combination->weights[j] : Tacc(1);
+      total += combiner == Combiner::kMean ? weight : weight * weight;
+    }
+    if (combiner == Combiner::kSqrtN) total = std::sqrt(total);
+    // As div_no_nan: empty segments, or segments of zero weights, are 0.
+    combination->scales[s] = total != Tacc(0) ? Tacc(1) / total : Tacc(0);
+  }
+  return OkStatus();
+}
+
+// Cost of accumulating the rows of `num_entries` entries, for Shard.
+int64_t AccumulationCost(int64_t num_entries, int64_t num_outputs,
+                         int64_t row_size) {
+  const int64_t entries_per_output =
+      num_outputs > 0 ? num_entries / num_outputs : 0;
+  return (entries_per_output + 1) * row_size;
+}
+
+}  // namespace
+
+// Computes _ResourceSparseSegmentReduction, gathering the rows of the
+// variable straight into their segment, without materializing them. The
+// output rows are computed in parallel.
+template <typename T, typename Tids, typename Tidx, typename Tsegmentids>
+class ResourceSparseSegmentReductionOp : public OpKernel {
+ public:
+  explicit ResourceSparseSegmentReductionOp(OpKernelConstruction* c)
+      : OpKernel(c) {
+    OP_REQUIRES_OK(c, GetCombiner(c, &combiner_));
+    OP_REQUIRES_OK(c, c->GetAttr("num_num_segments", &num_num_segments_));
+    OP_REQUIRES_OK(c, c->GetAttr("num_weights", &num_weights_));
+    OP_REQUIRES(c, num_num_segments_ <= 1 && num_weights_ <= 1,
+                errors::InvalidArgument(
+                    "num_num_segments and num_weights must be 0 or 1"));
+  }
+
+  void Compute(OpKernelContext* c) override {
+    const Tensor& ids = c->input(1);
+    const Tensor& indices = c->input(2);
+    const Tensor& segment_ids = c->input(3);
+    int64_t num_segments = -1;
+    if (num_num_segments_ > 0) {
+      const Tensor& num_segments_t = c->input(4);
+      OP_REQUIRES(c, TensorShapeUtils::IsScalar(num_segments_t.shape()),
+                  errors::InvalidArgument(
+                      "num_segments should be a scalar, not shape ",
+                      num_segments_t.shape().DebugString()));
+      num_segments = num_segments_t.dtype() == DT_INT32
+                         ? num_segments_t.scalar<int32>()()
+                         : num_segments_t.scalar<int64_t>()();
+      OP_REQUIRES(c, num_segments >= 0,
+                  errors::InvalidArgument("num_segments must be >= 0, got ",
+                                          num_segments));
+    }
+    const Tensor* weights =
+        num_weights_ > 0 ? &c->input(4 + num_num_segments_) : nullptr;
+
+    core::RefCountPtr<Var> v;
+    OP_REQUIRES_OK(c, LookupResource(c, HandleFromInput(c, 0), &v));
+    OP_REQUIRES_OK(c, EnsureSparseVariableAccess<CPUDevice, T>(c, v.get()));
+    // As in ResourceGather, hold the lock for the whole reduction rather than
+    // a reference to the buffer of the variable, so that writes don't copy it.
+    tf_shared_lock ml(*v->mu());
+    const Tensor& params = *v->tensor();
+    OP_REQUIRES(c, params.dtype() == DataTypeToEnum<T>::v(),
+                errors::InvalidArgument(
+                    "Trying to read variable with wrong dtype. Expected ",
+                    DataTypeString(DataTypeToEnum<T>::v()), " got ",
+                    DataTypeString(params.dtype())));
+    OP_REQUIRES(
+        c, TensorShapeUtils::IsVectorOrHigher(params.shape()),
+        errors::InvalidArgument("params must be at least 1 dimensional"));
+
+    Combination<Tacc> combination;
+    OP_REQUIRES_OK(c, (BuildCombination<T, Tids, Tidx, Tsegmentids>(
+                          ids, indices, segment_ids, weights,
+                          params.dim_size(0), combiner_, &num_segments,
+                          &combination)));
+
+    TensorShape output_shape = params.shape();
+    OP_REQUIRES_OK(c, output_shape.SetDimWithStatus(0, num_segments));
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(c, c->allocate_output(0, output_shape, &output));
+    if (output->NumElements() == 0) return;
+
+    const int64_t row_size = output->NumElements() / num_segments;
+    const T* params_data = params.flat<T>().data();
+    T* output_data = output->flat<T>().data();
+    auto combine = [&](int64_t begin, int64_t end) {
+      Eigen::Array<Tacc, Eigen::Dynamic, 1> sum(row_size);
+      for (int64_t s = begin; s < end; ++s) {
+        sum.setZero();
+        for (int64_t j = combination.segment_starts[s];
+             j < combination.segment_starts[s + 1]; ++j) {
+          ConstRow row(params_data + combination.rows[j] * row_size,
+                       row_size);
+          if (combination.weights.empty()) {
+            sum += row.template cast<Tacc>();
+          } else {
+            sum += row.template cast<Tacc>() * combination.weights[j];
+          }
+        }
+        Row(output_data + s * row_size, row_size) =
+            (sum * combination.scales[s]).template cast<T>();
+      }
+    };
+    const auto& worker_threads = *c->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads.num_threads, worker_threads.workers, num_segments,
+          AccumulationCost(combination.rows.size(), num_segments, row_size),
+          combine);
+  }
+
+ private:
+  using Tacc = typename AccumulatorType<T>::type;
+  using Row = Eigen::Map<Eigen::Array<T, Eigen::Dynamic, 1>>;
+  using ConstRow = Eigen::Map<const Eigen::Array<T, Eigen::Dynamic, 1>>;
+
+  Combiner combiner_;
+  int num_num_segments_;
+  int num_weights_;
+};
+
+// Computes _ResourceSparseSegmentReductionGrad: the gradient of each distinct
+// variable row of the combination is the sum of the gradients of its output
+// rows, scaled as in the forward pass. The distinct rows are computed in
+// parallel.
+template <typename T, typename Tids, typename Tidx, typename Tsegmentids>
+class ResourceSparseSegmentReductionGradOp : public OpKernel {
+ public:
+  explicit ResourceSparseSegmentReductionGradOp(OpKernelConstruction* c)
+      : OpKernel(c) {
+    OP_REQUIRES_OK(c, GetCombiner(c, &combiner_));
+    OP_REQUIRES_OK(c, c->GetAttr("num_weights", &num_weights_));
+    OP_REQUIRES(c, num_weights_ <= 1,
+                errors::InvalidArgument("num_weights must be 0 or 1"));
+  }
+
+  void Compute(OpKernelContext* c) override {
+    const Tensor& grad = c->input(0);
+    OP_REQUIRES(c, TensorShapeUtils::IsVectorOrHigher(grad.shape()),
+                errors::InvalidArgument("grad must be at least 1 dimensional"));
+    const Tensor* weights = num_weights_ > 0 ? &c->input(4) : nullptr;
+    int64_t num_segments = grad.dim_size(0);
+    // The forward pass checked the ids against the rows of the variable, which
+    // the gradient does not see: only check that they are non-negative.
+    Combination<Tacc> combination;
+    OP_REQUIRES_OK(c, (BuildCombination<T, Tids, Tidx, Tsegmentids>(
+                          c->input(1), c->input(2), c->input(3), weights,
+                          std::numeric_limits<int64_t>::max(), combiner_,
+                          &num_segments, &combination)));
+
+    // Sort the distinct rows, and group the entries by row with a stable
+    // counting sort.
+    std::vector<int64_t> unique_rows = combination.rows;
+    std::sort(unique_rows.begin(), unique_rows.end());
+    unique_rows.erase(std::unique(unique_rows.begin(), unique_rows.end()),
+                      unique_rows.end());
+    const int64_t num_unique = unique_rows.size();
+    const int64_t num_entries = combination.rows.size();
+    std::vector<int64_t> unique_of_entry(num_entries);
+    std::vector<int64_t> row_starts(num_unique + 1, 0);
+    for (int64_t j = 0; j < num_entries; ++j) {
+      unique_of_entry[j] =
+          std::lower_bound(unique_rows.begin(), unique_rows.end(),
+                           combination.rows[j]) -
+          unique_rows.begin();
+      ++row_starts[unique_of_entry[j] + 1];
+    }
+    for (int64_t u = 0; u < num_unique; ++u) {
+      row_starts[u + 1] += row_starts[u];
+    }
+    std::vector<int64_t> entries(num_entries);
+    {
+      std::vector<int64_t> next(row_starts.begin(), row_starts.end() - 1);
+      for (int64_t j = 0; j < num_entries; ++j) {
+        entries[next[unique_of_entry[j]]++] = j;
+      }
+    }
+
+    TensorShape output_shape = grad.shape();
+    OP_REQUIRES_OK(c, output_shape.SetDimWithStatus(0, num_unique));
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(c, c->allocate_output(0, output_shape, &output));
+    Tensor* sorted_unique_ids = nullptr;
+    OP_REQUIRES_OK(c, c->allocate_output(1, TensorShape({num_unique}),
+                                         &sorted_unique_ids));
+    auto sorted_unique_ids_vec = sorted_unique_ids->vec<Tids>();
+    for (int64_t u = 0; u < num_unique; ++u) {
+      sorted_unique_ids_vec(u) = static_cast<Tids>(unique_rows[u]);
+    }
+    if (output->NumElements() == 0) return;
+
+    const int64_t row_size = output->NumElements() / num_unique;
+    const T* grad_data = grad.flat<T>().data();
+    T* output_data = output->flat<T>().data();
+    auto accumulate = [&](int64_t begin, int64_t end) {
+      Eigen::Array<Tacc, Eigen::Dynamic, 1> sum(row_size);
+      for (int64_t u = begin; u < end; ++u) {
+        sum.setZero();
+        for (int64_t k = row_starts[u]; k < row_starts[u + 1]; ++k) {
+          const int64_t j = entries[k];
+          const int64_t s = combination.segments[j];
+          Tacc scale = combination.scales[s];
+          if (!combination.weights.empty()) scale *= combination.weights[j];
+          sum += ConstRow(grad_data + s * row_size, row_size)
+                     .template cast<Tacc>() *
+                 scale;
+        }
+        Row(output_data + u * row_size, row_size) = sum.template cast<T>();
+      }
+    };
+    const auto& worker_threads = *c->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads.num_threads, worker_threads.workers, num_unique,
+          AccumulationCost(num_entries, num_unique, row_size), accumulate);
+  }
+
+ private:
+  using Tacc = typename AccumulatorType<T>::type;
+  using Row = Eigen::Map<Eigen::Array<T, Eigen::Dynamic, 1>>;
+  using ConstRow = Eigen::Map<const Eigen::Array<T, Eigen::Dynamic, 1>>;
+
+  Combiner combiner_;
+  int num_weights_;
+};
+
+#define REGISTER_KERNELS(type, ids_type, index_type, segment_ids_type)   \
+  REGISTER_KERNEL_BUILDER(                                               \
+      Name("_ResourceSparseSegmentReduction")                            \
+          .Device(DEVICE_CPU)                                            \
+          .HostMemory("resource")                                        \
+          .TypeConstraint<type>("dtype")                                 \
+          .TypeConstraint<ids_type>("Tids")                              \
+          .TypeConstraint<index_type>("Tidx")                            \
+          .TypeConstraint<segment_ids_type>("Tsegmentids"),              \
+      ResourceSparseSegmentReductionOp<type, ids_type, index_type,       \
+                                       segment_ids_type>);               \
+  REGISTER_KERNEL_BUILDER(                                               \
+      Name("_ResourceSparseSegmentReductionGrad")                        \
+          .Device(DEVICE_CPU)                                            \
+          .TypeConstraint<type>("T")                                     \
+          .TypeConstraint<ids_type>("Tids")                              \
+          .TypeConstraint<index_type>("Tidx")                            \
+          .TypeConstraint<segment_ids_type>("Tsegmentids"),              \
+      ResourceSparseSegmentReductionGradOp<type, ids_type, index_type,   \
+                                           segment_ids_type>);
+#define REGISTER_KERNELS_FOR_EACH_SEGMENT_ID_TYPE(type, ids_type, index_type) \
+  REGISTER_KERNELS(type, ids_type, index_type, int32)                         \
+  REGISTER_KERNELS(type, ids_type, index_type, int64_t)
+#define REGISTER_KERNELS_FOR_EACH_INDEX_TYPE(type, ids_type)       \
+  REGISTER_KERNELS_FOR_EACH_SEGMENT_ID_TYPE(type, ids_type, int32) \
+  REGISTER_KERNELS_FOR_EACH_SEGMENT_ID_TYPE(type, ids_type, int64_t)
+#define REGISTER_CPU_KERNELS(type)                   \
+  REGISTER_KERNELS_FOR_EACH_INDEX_TYPE(type, int32) \
+  REGISTER_KERNELS_FOR_EACH_INDEX_TYPE(type, int64_t)
+
+TF_CALL_FLOAT_TYPES(REGISTER_CPU_KERNELS);
+
+#undef REGISTER_CPU_KERNELS
+#undef REGISTER_KERNELS_FOR_EACH_INDEX_TYPE
+#undef REGISTER_KERNELS_FOR_EACH_SEGMENT_ID_TYPE
+#undef REGISTER_KERNELS
+
+}  // namespace tensorflow
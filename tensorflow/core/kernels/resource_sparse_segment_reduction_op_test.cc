@@ -0,0 +1,222 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cmath>
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/resource_var.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+class ResourceSparseSegmentReductionOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(const string& combiner, int num_num_segments, int num_weights) {
+    TF_ASSERT_OK(NodeDefBuilder("op", "_ResourceSparseSegmentReduction")
+                     .Input(FakeInput(DT_RESOURCE))
+                     .Input(FakeInput(DT_INT32))
+                     .Input(FakeInput(DT_INT32))
+                     .Input(FakeInput(DT_INT32))
+                     .Input(FakeInput(num_num_segments, DT_INT32))
+                     .Input(FakeInput(num_weights, DT_FLOAT))
+                     .Attr("dtype", DT_FLOAT)
+                     .Attr("combiner", combiner)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+
+  // Adds a variable of 5 rows of 2 columns, where row i is {i, 10 * i}.
+  void AddVariable() {
+    Var* var = new Var(DT_FLOAT);
+    *var->tensor() = test::AsTensor<float>(
+        {0, 0, 1, 10, 2, 20, 3, 30, 4, 40}, TensorShape({5, 2}));
+    var->is_initialized = true;
+    AddResourceInput("", "var", var);
+  }
+};
+
+TEST_F(ResourceSparseSegmentReductionOpTest, Sum) {
+  MakeOp("sum", 0, 0);
+  AddVariable();
+  AddInputFromArray<int32>(TensorShape({3}), {4, 1, 3});
+  AddInputFromArray<int32>(TensorShape({4}), {0, 1, 2, 0});
+  AddInputFromArray<int32>(TensorShape({4}), {0, 0, 2, 2});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({3, 2}));
+  test::FillValues<float>(&expected, {5, 50, 0, 0, 7, 70});
+  test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+}
+
+TEST_F(ResourceSparseSegmentReductionOpTest, WeightedMeanWithNumSegments) {
+  MakeOp("mean", 1, 1);
+  AddVariable();
+  AddInputFromArray<int32>(TensorShape({3}), {4, 1, 3});
+  AddInputFromArray<int32>(TensorShape({4}), {0, 1, 2, 0});
+  AddInputFromArray<int32>(TensorShape({4}), {0, 0, 2, 2});
+  AddInputFromArray<int32>(TensorShape({}), {4});
+  AddInputFromArray<float>(TensorShape({4}), {1, 3, 2, 2});
+  TF_ASSERT_OK(RunOpKernel());
+
+  // Segment 0: (4 + 3) / 4, segment 2: (6 + 8) / 4.
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({4, 2}));
+  test::FillValues<float>(&expected, {1.75, 17.5, 0, 0, 3.5, 35, 0, 0});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+TEST_F(ResourceSparseSegmentReductionOpTest, SqrtN) {
+  MakeOp("sqrtn", 0, 0);
+  AddVariable();
+  AddInputFromArray<int32>(TensorShape({2}), {2, 3});
+  AddInputFromArray<int32>(TensorShape({2}), {0, 1});
+  AddInputFromArray<int32>(TensorShape({2}), {0, 0});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({1, 2}));
+  test::FillValues<float>(&expected, {5 / std::sqrt(2.f), 50 / std::sqrt(2.f)});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+TEST_F(ResourceSparseSegmentReductionOpTest, ManySegments) {
+  MakeOp("sum", 0, 0);
+  AddVariable();
+  constexpr int kNumSegments = 10000;
+  AddInputFromArray<int32>(TensorShape({5}), {0, 1, 2, 3, 4});
+  std::vector<int32> indices(2 * kNumSegments);
+  std::vector<int32> segment_ids(2 * kNumSegments);
+  std::vector<float> expected_values(2 * kNumSegments);
+  for (int s = 0; s < kNumSegments; ++s) {
+    indices[2 * s] = s % 5;
+    indices[2 * s + 1] = (s + 1) % 5;
+    segment_ids[2 * s] = segment_ids[2 * s + 1] = s;
+    expected_values[2 * s] = s % 5 + (s + 1) % 5;
+    expected_values[2 * s + 1] = 10 * expected_values[2 * s];
+  }
+  AddInputFromArray<int32>(TensorShape({2 * kNumSegments}), indices);
+  AddInputFromArray<int32>(TensorShape({2 * kNumSegments}), segment_ids);
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({kNumSegments, 2}));
+  test::FillValues<float>(&expected, expected_values);
+  test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+}
+
+TEST_F(ResourceSparseSegmentReductionOpTest, IdOutOfRange) {
+  MakeOp("sum", 0, 0);
+  AddVariable();
+  AddInputFromArray<int32>(TensorShape({2}), {1, 5});
+  AddInputFromArray<int32>(TensorShape({2}), {0, 1});
+  AddInputFromArray<int32>(TensorShape({2}), {0, 0});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(
+      absl::StrContains(s.ToString(), "indices[1] = 5 is not in [0, 5)"))
+      << s;
+}
+
+// As ResourceGather, every id is checked, even if no index refers to it.
+TEST_F(ResourceSparseSegmentReductionOpTest, UnreferencedIdOutOfRange) {
+  MakeOp("sum", 0, 0);
+  AddVariable();
+  AddInputFromArray<int32>(TensorShape({3}), {1, -1, 2});
+  AddInputFromArray<int32>(TensorShape({2}), {0, 2});
+  AddInputFromArray<int32>(TensorShape({2}), {0, 0});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(
+      absl::StrContains(s.ToString(), "indices[1] = -1 is not in [0, 5)"))
+      << s;
+}
+
+TEST_F(ResourceSparseSegmentReductionOpTest, IndexOutOfRange) {
+  MakeOp("sum", 0, 0);
+  AddVariable();
+  AddInputFromArray<int32>(TensorShape({2}), {1, 2});
+  AddInputFromArray<int32>(TensorShape({2}), {0, 2});
+  AddInputFromArray<int32>(TensorShape({2}), {0, 0});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(
+      absl::StrContains(s.ToString(), "indices[1] = 2 is not in [0, 2)"))
+      << s;
+}
+
+TEST_F(ResourceSparseSegmentReductionOpTest, UnsortedSegmentIds) {
+  MakeOp("sum", 0, 0);
+  AddVariable();
+  AddInputFromArray<int32>(TensorShape({2}), {1, 2});
+  AddInputFromArray<int32>(TensorShape({2}), {0, 1});
+  AddInputFromArray<int32>(TensorShape({2}), {1, 0});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(absl::StrContains(s.ToString(), "segment ids are not increasing"))
+      << s;
+}
+
+class ResourceSparseSegmentReductionGradOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(const string& combiner, int num_weights) {
+    TF_ASSERT_OK(NodeDefBuilder("op", "_ResourceSparseSegmentReductionGrad")
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_INT64))
+                     .Input(FakeInput(DT_INT32))
+                     .Input(FakeInput(DT_INT32))
+                     .Input(FakeInput(num_weights, DT_FLOAT))
+                     .Attr("combiner", combiner)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+};
+
+TEST_F(ResourceSparseSegmentReductionGradOpTest, WeightedMean) {
+  MakeOp("mean", 1);
+  AddInputFromArray<float>(TensorShape({3, 2}), {1, 2, 3, 4, 5, 6});
+  AddInputFromArray<int64_t>(TensorShape({3}), {40, 10, 30});
+  AddInputFromArray<int32>(TensorShape({4}), {0, 1, 2, 0});
+  AddInputFromArray<int32>(TensorShape({4}), {0, 0, 2, 2});
+  AddInputFromArray<float>(TensorShape({4}), {1, 3, 2, 2});
+  TF_ASSERT_OK(RunOpKernel());
+
+  // Row 10: 3 / 4 * grad[0], row 30: 2 / 4 * grad[2], row 40: 1 / 4 * grad[0]
+  // + 2 / 4 * grad[2].
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({3, 2}));
+  test::FillValues<float>(&expected, {0.75, 1.5, 2.5, 3, 2.75, 3.5});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+  test::ExpectTensorEqual<int64_t>(test::AsTensor<int64_t>({10, 30, 40}),
+                                   *GetOutput(1));
+}
+
+TEST_F(ResourceSparseSegmentReductionGradOpTest, Sum) {
+  MakeOp("sum", 0);
+  AddInputFromArray<float>(TensorShape({2, 1}), {1, 2});
+  AddInputFromArray<int64_t>(TensorShape({2}), {7, 3});
+  AddInputFromArray<int32>(TensorShape({3}), {0, 0, 1});
+  AddInputFromArray<int32>(TensorShape({3}), {0, 1, 1});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({2, 1}));
+  test::FillValues<float>(&expected, {2, 3});
+  test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+  test::ExpectTensorEqual<int64_t>(test::AsTensor<int64_t>({3, 7}),
+                                   *GetOutput(1));
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -77,6 +77,7 @@ limitations under the License.
 #include "tensorflow/core/kernels/resource_variable_util.h"
 #include "tensorflow/core/kernels/scatter_functor.h"
 #include "tensorflow/core/kernels/scatter_nd_util.h"
+#include "tensorflow/core/kernels/tiered_embedding_variable.h"
 #include "tensorflow/core/kernels/training_op_helpers.h"
 #include "tensorflow/core/kernels/variable_ops.h"
 #include "tensorflow/core/lib/core/errors.h"
@@ -475,6 +476,7 @@ class AssignVariableOp : public OpKernel {
       *variable->tensor() = value;
     }
     variable->is_initialized = true;
+    variable->MarkUpdated();
   }
 
  private:
@@ -627,6 +629,7 @@ class AssignUpdateVariableOp : public OpKernel {
     functor::DenseUpdate<Device, T, Op> update_functor;
     update_functor(context->eigen_device<Device>(), var_tensor->flat<T>(),
                    value.flat<T>());
+    variable->MarkUpdated();
   }
 };
 
@@ -718,6 +721,11 @@ class ResourceGatherOp : public OpKernel {
   }
 
   void Compute(OpKernelContext* c) override {
+    if (std::is_same<Device, CPUDevice>::value &&
+        IsTieredEmbeddingVariable(HandleFromInput(c, 0))) {
+      GatherTiered(c);
+      return;
+    }
     core::RefCountPtr<Var> v;
     OP_REQUIRES_OK(c, LookupResource(c, HandleFromInput(c, 0), &v));
     OP_REQUIRES_OK(c, EnsureSparseVariableAccess<Device, T>(c, v.get()));
@@ -811,6 +819,23 @@ class ResourceGatherOp : public OpKernel {
   }
 
  private:
+  // Gathers from a TieredEmbeddingVariable, which checks the indices and
+  // reads the rows that aren't cached from its file.
+  void GatherTiered(OpKernelContext* c) {
+    OP_REQUIRES(c, batch_dims_ == 0,
+                errors::Unimplemented("ResourceGather from a "
+                                      "TieredEmbeddingVariable does not "
+                                      "support batch_dims"));
+    core::RefCountPtr<TieredEmbeddingVariable> variable;
+    OP_REQUIRES_OK(c, LookupResource(c, HandleFromInput(c, 0), &variable));
+    const Tensor& indices = c->input(1);
+    TensorShape shape;
+    OP_REQUIRES_OK(c, variable->GatherShape(indices, &shape));
+    Tensor* out = nullptr;
+    OP_REQUIRES_OK(c, c->allocate_output(0, shape, &out));
+    OP_REQUIRES_OK(c, variable->Gather(indices, out));
+  }
+
   // Add the batch offset derived from params to each batch of indices.
   // Example: batch_dims = 1, indices = [[0, 1, 2], [0, 1, 2]]
   // If indexing into a params dimension of size 4, then the indices will become
@@ -1114,6 +1139,17 @@ class ResourceScatterUpdateOp : public OpKernel {
   }
 
   void Compute(OpKernelContext* c) override {
+    if (std::is_same<Device, CPUDevice>::value &&
+        IsTieredEmbeddingVariable(HandleFromInput(c, 0))) {
+      OP_REQUIRES(c, op == scatter_op::UpdateOp::ADD,
+                  errors::Unimplemented(
+                      "Only ResourceScatterAdd supports a "
+                      "TieredEmbeddingVariable, got ", type_string()));
+      core::RefCountPtr<TieredEmbeddingVariable> variable;
+      OP_REQUIRES_OK(c, LookupResource(c, HandleFromInput(c, 0), &variable));
+      OP_REQUIRES_OK(c, variable->ScatterAdd(c->input(1), c->input(2)));
+      return;
+    }
     core::RefCountPtr<Var> v;
     OP_REQUIRES_OK(c, LookupResource(c, HandleFromInput(c, 0), &v));
 
@@ -1130,10 +1166,12 @@ class ResourceScatterUpdateOp : public OpKernel {
     if (is_non_pod_dtype || use_exclusive_lock_) {
       mutex_lock ml(*v->mu());
       DoCompute(c);
+      if (c->status().ok()) v->MarkUpdated();
     } else {
       // For POD dtypes, we can safely run the update without the mutex.
       tf_shared_lock ml(*v->mu());
       DoCompute(c);
+      if (c->status().ok()) v->MarkUpdated();
     }
   }
 
@@ -16,7 +16,10 @@ limitations under the License.
 // Contains OP to generate sparse crosses.
 #include <assert.h>
 
+#include <algorithm>
+#include <cstring>
 #include <limits>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -270,6 +273,62 @@ StringPiece KeyedDenseTensorColumn<StringPiece>::Feature(
   return tensor_.matrix<tstring>()(batch, n);
 }
 
+// The features of the columns in one batch row. The crossers read each feature
+// once per row from here, instead of once for every cross it appears in.
+template <typename InternalType>
+class RowFeatures {
+ public:
+  explicit RowFeatures(
+      const std::vector<std::unique_ptr<ColumnInterface<InternalType>>>&
+          columns)
+      : columns_(columns), features_(columns.size()) {}
+
+  // Reads the features of the specified batch. Returns false if a column has
+  // no features, in which case the batch has no crosses.
+  bool Read(int64_t batch_index, bool strong_hash) {
+    for (int i = 0; i < columns_.size(); i++) {
+      const int64_t feature_count = columns_[i]->FeatureCount(batch_index);
+      if (feature_count == 0) return false;
+      features_[i].resize(feature_count);
+      for (int64_t n = 0; n < feature_count; n++) {
+        features_[i][n] = columns_[i]->Feature(batch_index, n, strong_hash);
+      }
+    }
+    return true;
+  }
+
+  int num_columns() const { return features_.size(); }
+  int64_t feature_count(int column) const { return features_[column].size(); }
+  const InternalType& feature(int column, int n) const {
+    return features_[column][n];
+  }
+
+ private:
+  const std::vector<std::unique_ptr<ColumnInterface<InternalType>>>& columns_;
+  std::vector<std::vector<InternalType>> features_;
+};
+
+// Calls `generate(permutation, first_changed)` for each cartesian product of
+// the features in `row`, with the last column varying fastest. Only the
+// columns from `first_changed` on differ from the previous permutation.
+template <typename InternalType, typename Generate>
+void ForEachPermutation(const RowFeatures<InternalType>& row,
+                        std::vector<int>* permutation, Generate generate) {
+  const int num_columns = row.num_columns();
+  permutation->assign(num_columns, 0);
+  int first_changed = 0;
+  while (true) {
+    generate(*permutation, first_changed);
+    int i = num_columns - 1;
+    while (i >= 0 && ++(*permutation)[i] == row.feature_count(i)) {
+      (*permutation)[i] = 0;
+      i--;
+    }
+    if (i < 0) return;
+    first_changed = i;
+  }
+}
+
 // Updates Output tensors with sparse crosses.
 template <typename OutType>
 class OutputUpdater {
@@ -277,170 +336,160 @@ class OutputUpdater {
   OutputUpdater(const std::vector<int64_t>& output_start_indices,
                 Tensor* indices_out, Tensor* values_out)
       : output_start_indices_(output_start_indices),
-        indices_out_(indices_out),
-        values_out_(values_out) {}
+        indices_matrix_(indices_out->matrix<int64_t>()),
+        value_vec_(values_out->vec<OutType>()) {}
 
-  void Update(const int64_t batch_index, const int64_t cross_count,
-              const OutType& cross) const {
+  // Sets the indices of the `cross_count`th cross of `batch_index`, and
+  // returns where to write its value.
+  OutType* Update(const int64_t batch_index,
+                  const int64_t cross_count) const {
     const int64_t output_index =
         output_start_indices_[batch_index] + cross_count;
-
-    auto indices_matrix = indices_out_->matrix<int64_t>();
-    indices_matrix(output_index, 0) = batch_index;
-    indices_matrix(output_index, 1) = cross_count;
-
-    auto value_vec = values_out_->vec<OutType>();
-    value_vec(output_index) = cross;
+    indices_matrix_(output_index, 0) = batch_index;
+    indices_matrix_(output_index, 1) = cross_count;
+    return &value_vec_(output_index);
   }
 
  private:
   const std::vector<int64_t>& output_start_indices_;
-  Tensor* indices_out_;
-  Tensor* values_out_;
+  typename TTypes<int64_t>::Matrix indices_matrix_;
+  typename TTypes<OutType>::Vec value_vec_;
 };
 
 // Generates the sparse crosses as concatenation of strings.
 template <typename InternalType>
 class StringCrosser {
  public:
-  StringCrosser(const std::vector<
-                    std::unique_ptr<ColumnInterface<InternalType>>>& columns,
-                const int64_t num_buckets_unused, const uint64 hash_key_unused,
-                const tstring k_feature_separator)
-      : columns_(columns), k_feature_separator_(k_feature_separator) {}
-
-  string Generate(const int64_t batch_index,
-                  const std::vector<int>& permutation,
-                  bool unused_strong_hash) const {
-    gtl::InlinedVector<InternalType, 6> cross_vec(columns_.size());
+  StringCrosser(const int64_t num_buckets_unused, const uint64 hash_key_unused,
+                const tstring& k_feature_separator)
+      : k_feature_separator_(k_feature_separator) {}
+
+  // Joins the features directly into `out`, without temporary strings.
+  void Generate(const RowFeatures<InternalType>& row,
+                const std::vector<int>& permutation, int first_changed_unused,
+                tstring* out) {
+    size_t size = k_feature_separator_.size() * (permutation.size() - 1);
     for (int i = 0; i < permutation.size(); i++) {
-      cross_vec[i] = columns_[i]->Feature(batch_index, permutation[i], false);
+      size += row.feature(i, permutation[i]).size();
+    }
+    out->resize_uninitialized(size);
+    char* dst = out->mdata();
+    for (int i = 0; i < permutation.size(); i++) {
+      if (i > 0) {
+        std::memcpy(dst, k_feature_separator_.data(),
+                    k_feature_separator_.size());
+        dst += k_feature_separator_.size();
+      }
+      const InternalType& feature = row.feature(i, permutation[i]);
+      std::memcpy(dst, feature.data(), feature.size());
+      dst += feature.size();
     }
-    // TODO(zakaria): this will copy the string twice, might effect
-    // performance.
-    return absl::StrJoin(cross_vec, k_feature_separator_);
   }
 
  private:
-  const std::vector<std::unique_ptr<ColumnInterface<InternalType>>>& columns_;
   const tstring k_feature_separator_;
 };
 
 // Generates the sparse crosses as nested hash to avoid string manipulations.
 class HashCrosser {
  public:
-  HashCrosser(
-      const std::vector<std::unique_ptr<ColumnInterface<int64_t>>>& columns,
-      const int64_t num_buckets, const uint64 hash_key,
-      const tstring k_feature_separator_unused)
-      : columns_(columns), num_buckets_(num_buckets), hash_key_(hash_key) {}
-
-  int64_t Generate(const int64_t batch_index,
-                   const std::vector<int>& permutation,
-                   bool unused_strong_hash) const {
-    // Do the fingerprint concatenation on uint64.
-    uint64 hashed_output = hash_key_;
-    for (size_t i = 0; i < permutation.size(); ++i) {
-      uint64 hash_i = columns_[i]->Feature(batch_index, permutation[i], false);
-      hashed_output = FingerprintCat64(hashed_output, hash_i);
+  HashCrosser(const int64_t num_buckets, const uint64 hash_key,
+              const tstring& k_feature_separator_unused)
+      : num_buckets_(num_buckets), hash_key_(hash_key) {}
+
+  void Generate(const RowFeatures<int64_t>& row,
+                const std::vector<int>& permutation, int first_changed,
+                int64_t* out) {
+    // Do the fingerprint concatenation on uint64. prefix_hashes_[i] is the
+    // concatenation of the features of the first i columns, so only the
+    // columns that changed since the previous permutation are hashed.
+    prefix_hashes_.resize(permutation.size() + 1);
+    prefix_hashes_[0] = hash_key_;
+    for (size_t i = first_changed; i < permutation.size(); ++i) {
+      uint64 hash_i = row.feature(i, permutation[i]);
+      prefix_hashes_[i + 1] = FingerprintCat64(prefix_hashes_[i], hash_i);
     }
+    const uint64 hashed_output = prefix_hashes_.back();
     // The return value is int64 based on the number of buckets.
     if (num_buckets_ > 0) {
-      return hashed_output % num_buckets_;
+      *out = hashed_output % num_buckets_;
     } else {
       // To prevent negative output we take modulo to max int64.
-      return hashed_output % std::numeric_limits<int64_t>::max();
+      *out = hashed_output % std::numeric_limits<int64_t>::max();
     }
   }
 
  private:
-  const std::vector<std::unique_ptr<ColumnInterface<int64_t>>>& columns_;
   const int64_t num_buckets_;
   const uint64 hash_key_;
+  std::vector<uint64> prefix_hashes_;
 };
 
 // Generates the sparse crosses as nested hash to avoid string manipulations.
 class HashCrosserV2 {
  public:
-  HashCrosserV2(
-      const std::vector<std::unique_ptr<ColumnInterface<int64_t>>>& columns,
-      const int64_t num_buckets, const uint64 hash_key_unused,
-      const tstring k_feature_separator_unused)
-      : columns_(columns), num_buckets_(num_buckets) {}
-
-  int64_t Generate(const int64_t batch_index,
-                   const std::vector<int>& permutation,
-                   bool strong_hash) const {
-    // Do the fingerprint concatenation on uint64.
-    uint64 hashed_output =
-        columns_[0]->Feature(batch_index, permutation[0], strong_hash);
-    for (size_t i = 1; i < permutation.size(); ++i) {
-      uint64 hash_i =
-          columns_[i]->Feature(batch_index, permutation[i], strong_hash);
-      hashed_output = FingerprintCat64(hashed_output, hash_i);
+  HashCrosserV2(const int64_t num_buckets, const uint64 hash_key_unused,
+                const tstring& k_feature_separator_unused)
+      : num_buckets_(num_buckets) {}
+
+  void Generate(const RowFeatures<int64_t>& row,
+                const std::vector<int>& permutation, int first_changed,
+                int64_t* out) {
+    // Do the fingerprint concatenation on uint64, keeping the concatenation
+    // of the features of the first i columns in prefix_hashes_[i].
+    prefix_hashes_.resize(permutation.size() + 1);
+    if (first_changed == 0) {
+      prefix_hashes_[1] = row.feature(0, permutation[0]);
+    }
+    for (size_t i = std::max(first_changed, 1); i < permutation.size(); ++i) {
+      uint64 hash_i = row.feature(i, permutation[i]);
+      prefix_hashes_[i + 1] = FingerprintCat64(prefix_hashes_[i], hash_i);
     }
+    const uint64 hashed_output = prefix_hashes_.back();
     // The return value is int64 based on the number of buckets.
     if (num_buckets_ > 0) {
-      return hashed_output % num_buckets_;
+      *out = hashed_output % num_buckets_;
     } else {
       // To prevent negative output we take modulo to max int64.
-      return hashed_output % std::numeric_limits<int64_t>::max();
+      *out = hashed_output % std::numeric_limits<int64_t>::max();
     }
   }
 
  private:
-  const std::vector<std::unique_ptr<ColumnInterface<int64_t>>>& columns_;
   const int64_t num_buckets_;
+  std::vector<uint64> prefix_hashes_;
 };
 
-// ProductIterator generates cartesian products based on indices.
-template <typename InternalType>
-class ProductIterator {
- public:
-  explicit ProductIterator(
-      const std::vector<std::unique_ptr<ColumnInterface<InternalType>>>&
-          columns,
-      int64_t batch_index)
-      : columns_(columns), batch_index_(batch_index) {
-    next_permutation_.resize(columns_.size(), 0);
-    // Sets has_next_ to false if any feature column has 0 features.
-    has_next_ = true;
-    for (int i = 0; i < columns_.size(); i++) {
-      if (columns_[i]->FeatureCount(batch_index_) == 0) {
-        has_next_ = false;
-        break;
-      }
-    }
-  }
-
-  std::vector<int> Next() {
-    std::vector<int> permutation(next_permutation_);
-
-    // Generates next permutation, if available.
-    bool carry = true;
-    for (int i = next_permutation_.size() - 1; i >= 0; i--) {
-      if (carry) {
-        next_permutation_[i] = next_permutation_[i] + 1;
-      }
-      if (next_permutation_[i] == columns_[i]->FeatureCount(batch_index_)) {
-        next_permutation_[i] = 0;
-      } else {
-        carry = false;
-        break;
-      }
-    }
-    has_next_ = !carry;
-    return permutation;
+// Generates the crosses of the batches in [begin, end) with `crosser`, and
+// writes them with `updater`.
+template <typename InternalType, typename Crosser, typename Updater>
+void CrossBatches(
+    const std::vector<std::unique_ptr<ColumnInterface<InternalType>>>& columns,
+    Crosser* crosser, const Updater& updater, bool strong_hash, int64_t begin,
+    int64_t end) {
+  RowFeatures<InternalType> row(columns);
+  std::vector<int> permutation;
+  for (int64_t b = begin; b < end; b++) {
+    if (!row.Read(b, strong_hash)) continue;
+    int64_t cross_count = 0;
+    ForEachPermutation(
+        row, &permutation,
+        [&](const std::vector<int>& product, int first_changed) {
+          crosser->Generate(row, product, first_changed,
+                            updater.Update(b, cross_count++));
+        });
   }
+}
 
-  bool HasNext() { return has_next_; }
-
- private:
-  bool has_next_;
-  const std::vector<std::unique_ptr<ColumnInterface<InternalType>>>& columns_;
-  const int64_t batch_index_;
-  std::vector<int> next_permutation_;
-};
+// Returns the Shard cost of crossing one batch, from the average number of
+// crosses per batch counted by CreateOutputTensors.
+int64_t CrossCostPerBatch(const Tensor& values_out, int64_t batch_size,
+                          int num_columns) {
+  const int64_t kCostPerCrossedFeature = 100;
+  const int64_t crosses_per_batch =
+      batch_size > 0 ? values_out.NumElements() / batch_size : 0;
+  return (1 + crosses_per_batch) * num_columns * kCostPerCrossedFeature;
+}
 
 template <bool HASHED_OUTPUT, typename InternalType>
 struct CrossTraits;
@@ -769,9 +818,6 @@ class SparseCrossOp : public OpKernel {
         GenerateColumnsFromInput<InternalType>(indices_list_in, values_list_in,
                                                shapes_list_in, dense_list_in);
 
-    const tstring k_feature_separator = "_X_";
-    typename CrossTraits<HASHED_OUTPUT, InternalType>::Crosser crosser(
-        columns, num_buckets_, hash_key_, k_feature_separator);
     Tensor* indices_out;
     Tensor* values_out;
     Tensor* shape_out;
@@ -785,24 +831,17 @@ class SparseCrossOp : public OpKernel {
 
     typename CrossTraits<HASHED_OUTPUT, InternalType>::Updater updater(
         output_start_indices, indices_out, values_out);
-    auto do_work = [&columns, crosser, updater](int64_t begin, int64_t end) {
-      for (int b = begin; b < end; b++) {
-        ProductIterator<InternalType> product_iterator(columns, b);
-        int64_t cross_count = 0;
-        while (product_iterator.HasNext()) {
-          const auto permutation = product_iterator.Next();
-          updater.Update(b, cross_count,
-                         crosser.Generate(b, permutation, false));
-          cross_count++;
-        }
-      }
+    auto do_work = [this, &columns, &updater](int64_t begin, int64_t end) {
+      const tstring k_feature_separator = "_X_";
+      typename CrossTraits<HASHED_OUTPUT, InternalType>::Crosser crosser(
+          num_buckets_, hash_key_, k_feature_separator);
+      CrossBatches(columns, &crosser, updater, /*strong_hash=*/false, begin,
+                   end);
     };
 
     auto* worker_threads = context->device()->tensorflow_cpu_worker_threads();
-    // TODO(zakaria): optimize kCostPerUnit
-    const int kCostPerUnit = 5000 * indices_list_in.size();
     Shard(worker_threads->num_threads, worker_threads->workers, batch_size,
-          kCostPerUnit, do_work);
+          CrossCostPerBatch(*values_out, batch_size, columns.size()), do_work);
   }
 
  private:
@@ -853,27 +892,18 @@ class SparseCrossV2Op : public OpKernel {
         context,
         CreateOutputTensors(columns, batch_size, context, &indices_out,
                             &values_out, &shape_out, &output_start_indices));
-    StringCrosser<tstring> crosser(columns, 0, 0, separator);
     OutputUpdater<tstring> updater(output_start_indices, indices_out,
                                    values_out);
-    auto do_work = [&columns, crosser, updater](int64_t begin, int64_t end) {
-      for (int b = begin; b < end; b++) {
-        ProductIterator<tstring> product_iterator(columns, b);
-        int64_t cross_count = 0;
-        while (product_iterator.HasNext()) {
-          const auto permutation = product_iterator.Next();
-          updater.Update(b, cross_count,
-                         crosser.Generate(b, permutation, false));
-          cross_count++;
-        }
-      }
+    auto do_work = [&columns, &separator, &updater](int64_t begin,
+                                                    int64_t end) {
+      StringCrosser<tstring> crosser(0, 0, separator);
+      CrossBatches(columns, &crosser, updater, /*strong_hash=*/false, begin,
+                   end);
     };
 
     auto* worker_threads = context->device()->tensorflow_cpu_worker_threads();
-    // TODO(zakaria): optimize kCostPerUnit
-    const int kCostPerUnit = 5000 * indices_list_in.size();
     Shard(worker_threads->num_threads, worker_threads->workers, batch_size,
-          kCostPerUnit, do_work);
+          CrossCostPerBatch(*values_out, batch_size, columns.size()), do_work);
   }
 };
 
@@ -931,29 +961,18 @@ class SparseCrossHashedOp : public OpKernel {
         context,
         CreateOutputTensors(columns, batch_size, context, &indices_out,
                             &values_out, &shape_out, &output_start_indices));
-    const tstring unused_sep;
-    HashCrosserV2 crosser(columns, num_buckets, 0, unused_sep);
     OutputUpdater<int64_t> updater(output_start_indices, indices_out,
                                    values_out);
-    auto do_work = [&columns, crosser, updater, strong_hash](int64_t begin,
-                                                             int64_t end) {
-      for (int b = begin; b < end; b++) {
-        ProductIterator<int64_t> product_iterator(columns, b);
-        int64_t cross_count = 0;
-        while (product_iterator.HasNext()) {
-          const auto permutation = product_iterator.Next();
-          updater.Update(b, cross_count,
-                         crosser.Generate(b, permutation, strong_hash));
-          cross_count++;
-        }
-      }
+    auto do_work = [&columns, &updater, num_buckets, strong_hash](
+                       int64_t begin, int64_t end) {
+      const tstring unused_sep;
+      HashCrosserV2 crosser(num_buckets, 0, unused_sep);
+      CrossBatches(columns, &crosser, updater, strong_hash, begin, end);
     };
 
     auto* worker_threads = context->device()->tensorflow_cpu_worker_threads();
-    // TODO(zakaria): optimize kCostPerUnit
-    const int kCostPerUnit = 5000 * indices_list_in.size();
     Shard(worker_threads->num_threads, worker_threads->workers, batch_size,
-          kCostPerUnit, do_work);
+          CrossCostPerBatch(*values_out, batch_size, columns.size()), do_work);
   }
 };
 
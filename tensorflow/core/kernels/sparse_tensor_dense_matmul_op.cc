@@ -19,11 +19,16 @@ limitations under the License.
 
 #include "tensorflow/core/kernels/sparse_tensor_dense_matmul_op.h"
 
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
 #include "tensorflow/core/framework/bounds_check.h"
 #include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/kernels/fill_functor.h"
 #include "tensorflow/core/platform/bfloat16.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
@@ -264,10 +269,6 @@ Status SparseTensorDenseMatMulImpl(
   const int lhs_index_a = ADJ_A ? 1 : 0;
   const int rhs_index_a = ADJ_A ? 0 : 1;
 
-  // TODO(ebrevdo): After many failed experiments, can't find a multi-threaded
-  // approach that achieves the performance of the single threaded
-  // one.  Perhaps Eigen threadpool implementation is just too slow?
-
   if (rhs_right < kNumVectorize) {
     // Disable vectorization if the RHS of output is too small
     auto maybe_adjoint_b = MaybeAdjoint<decltype(b), ADJ_B>(b);
@@ -321,6 +322,133 @@ Status SparseTensorDenseMatMulImpl(
   }
   return OkStatus();
 }
+
+// Computes the product in parallel over blocks of rows of the output. The
+// entries of A are bucketed by output row once, keeping their order within
+// each row so that each output element is summed in the same order as by
+// SparseTensorDenseMatMulImpl. Each row of the output is then accumulated
+// from rows of B, one block of columns at a time so that the block of the
+// output row stays in cache.
+template <typename T, typename Tsum, typename Tindices, bool ADJ_A, bool ADJ_B>
+Status ParallelSparseTensorDenseMatMulImpl(
+    OpKernelContext* ctx, typename TTypes<Tsum>::Matrix out,
+    typename TTypes<Tindices>::ConstMatrix a_indices,
+    typename TTypes<T>::ConstVec a_values, typename TTypes<T>::ConstMatrix b) {
+  // Number of bytes of a block of columns of an output row.
+  static constexpr int64_t kColumnBlockBytes = 8 << 10;
+
+  const int64_t nnz = a_values.size();
+  const int64_t num_rows = out.dimension(0);
+  const int64_t rhs_right = (ADJ_B ? b.dimension(0) : b.dimension(1));
+  const int64_t lhs_right = (ADJ_B ? b.dimension(1) : b.dimension(0));
+  const int lhs_index_a = ADJ_A ? 1 : 0;
+  const int rhs_index_a = ADJ_A ? 0 : 1;
+
+  // Copy and check the indices, and count the entries of each output row.
+  std::vector<Tindices> rows(nnz);
+  std::vector<Tindices> cols(nnz);
+  std::vector<int64_t> row_starts(num_rows + 1, 0);
+  bool sorted = true;
+  for (int64_t i = 0; i < nnz; ++i) {
+    const Tindices m = internal::SubtleMustCopy(a_indices(i, lhs_index_a));
+    const Tindices k = internal::SubtleMustCopy(a_indices(i, rhs_index_a));
+    if (!FastBoundsCheck(k, lhs_right)) {
+      return KOutOfBoundsError(k, i, rhs_index_a, lhs_right);
+    }
+    if (!FastBoundsCheck(m, num_rows)) {
+      return MOutOfBoundsError(m, i, lhs_index_a, num_rows);
+    }
+    sorted = sorted && (i == 0 || rows[i - 1] <= m);
+    rows[i] = m;
+    cols[i] = k;
+    ++row_starts[m + 1];
+  }
+  std::partial_sum(row_starts.begin(), row_starts.end(), row_starts.begin());
+
+  // The entries of row m are order[row_starts[m], row_starts[m + 1]), or
+  // directly that range if the indices are already ordered by row.
+  std::vector<int64_t> order;
+  if (!sorted) {
+    order.resize(nnz);
+    std::vector<int64_t> next(row_starts.begin(), row_starts.end() - 1);
+    for (int64_t i = 0; i < nnz; ++i) {
+      order[next[rows[i]]++] = i;
+    }
+  }
+
+  // Rows of B, or of its adjoint.
+  const T* b_data = b.data();
+  Eigen::Tensor<T, 2, Eigen::RowMajor> b_adjoint;
+  if (ADJ_B) {
+    Eigen::array<int, 2> shuffle(1, 0);
+    b_adjoint.resize(lhs_right, rhs_right);
+    b_adjoint.device(ctx->eigen_device<CPUDevice>()) =
+        b.shuffle(shuffle).conjugate();
+    b_data = b_adjoint.data();
+  }
+
+  const int64_t block_cols =
+      std::max<int64_t>(1, kColumnBlockBytes / sizeof(Tsum));
+  auto compute_rows = [&](int64_t begin, int64_t end) {
+    using OutRow = Eigen::Map<Eigen::Array<Tsum, Eigen::Dynamic, 1>>;
+    using BRow = Eigen::Map<const Eigen::Array<T, Eigen::Dynamic, 1>>;
+    for (int64_t n = 0; n < rhs_right; n += block_cols) {
+      const int64_t size = std::min(block_cols, rhs_right - n);
+      for (int64_t m = begin; m < end; ++m) {
+        OutRow out_row(&out(m, n), size);
+        for (int64_t j = row_starts[m]; j < row_starts[m + 1]; ++j) {
+          const int64_t i = sorted ? j : order[j];
+          const T a_value = ADJ_A ? MaybeConj(a_values(i)) : a_values(i);
+          BRow b_row(b_data + cols[i] * rhs_right + n, size);
+          out_row += b_row.template cast<Tsum>() * static_cast<Tsum>(a_value);
+        }
+      }
+    }
+  };
+
+  // Split the rows into blocks of about the same number of entries, as rows
+  // of sparse inputs often have very different numbers of entries.
+  const auto& worker_threads = *ctx->device()->tensorflow_cpu_worker_threads();
+  const int64_t num_blocks =
+      std::min<int64_t>(num_rows, 4 * worker_threads.num_threads);
+  std::vector<int64_t> block_starts(num_blocks + 1, num_rows);
+  for (int64_t block = 0; block < num_blocks; ++block) {
+    block_starts[block] =
+        std::lower_bound(row_starts.begin(), row_starts.end(),
+                         nnz * block / num_blocks) -
+        row_starts.begin();
+  }
+  block_starts[0] = 0;
+  const int64_t cost_per_block =
+      std::max<int64_t>(1, nnz / num_blocks) * rhs_right;
+  Shard(worker_threads.num_threads, worker_threads.workers, num_blocks,
+        cost_per_block, [&](int64_t begin, int64_t end) {
+          compute_rows(block_starts[begin], block_starts[end]);
+        });
+  return OkStatus();
+}
+
+// Computes the product in parallel if it's large enough for that to pay off.
+template <typename T, typename Tsum, typename Tindices, bool ADJ_A, bool ADJ_B>
+Status SparseTensorDenseMatMulCpu(
+    OpKernelContext* ctx, typename TTypes<Tsum>::Matrix out,
+    typename TTypes<Tindices>::ConstMatrix a_indices,
+    typename TTypes<T>::ConstVec a_values, typename TTypes<T>::ConstMatrix b) {
+  // Minimum number of multiply-adds of a parallel product.
+  static constexpr int64_t kMinParallelCost = 1 << 16;
+
+  const int64_t rhs_right = (ADJ_B ? b.dimension(0) : b.dimension(1));
+  const int num_threads =
+      ctx->device()->tensorflow_cpu_worker_threads()->num_threads;
+  if (num_threads > 1 && out.dimension(0) > 1 &&
+      a_values.size() * rhs_right >= kMinParallelCost) {
+    return ParallelSparseTensorDenseMatMulImpl<T, Tsum, Tindices, ADJ_A,
+                                               ADJ_B>(ctx, out, a_indices,
+                                                      a_values, b);
+  }
+  return SparseTensorDenseMatMulImpl<T, Tsum, Tindices, ADJ_A, ADJ_B>(
+      out, a_indices, a_values, b);
+}
 }  // namespace
 
 template <typename T, typename Tindices, bool ADJ_A, bool ADJ_B>
@@ -338,8 +466,8 @@ struct SparseTensorDenseMatMulFunctor<CPUDevice, T, Tindices, ADJ_A, ADJ_B> {
       auto temp_out = temp_out_t.matrix<Tsum>();
       temp_out.setZero();
       TF_RETURN_IF_ERROR(
-          SparseTensorDenseMatMulImpl<T, Tsum, Tindices, ADJ_A, ADJ_B>(
-              temp_out, a_indices, a_values, b));
+          SparseTensorDenseMatMulCpu<T, Tsum, Tindices, ADJ_A, ADJ_B>(
+              ctx, temp_out, a_indices, a_values, b));
       out = temp_out.template cast<T>();
     } else {
       out.setZero();
@@ -348,8 +476,8 @@ struct SparseTensorDenseMatMulFunctor<CPUDevice, T, Tindices, ADJ_A, ADJ_B> {
       auto out_workaround =
           *reinterpret_cast<typename TTypes<Tsum>::Matrix*>(&out);
       TF_RETURN_IF_ERROR(
-          SparseTensorDenseMatMulImpl<T, Tsum, Tindices, ADJ_A, ADJ_B>(
-              out_workaround, a_indices, a_values, b));
+          SparseTensorDenseMatMulCpu<T, Tsum, Tindices, ADJ_A, ADJ_B>(
+              ctx, out_workaround, a_indices, a_values, b));
     }
     return OkStatus();
   }
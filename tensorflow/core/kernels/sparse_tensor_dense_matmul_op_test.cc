@@ -120,4 +120,12 @@ BM_SparseTensorDenseMatmul(16384, 4096, 4096, 4096, false, true);
 BM_SparseTensorDenseMatmul(16384, 4096, 4096, 4096, true, false);
 BM_SparseTensorDenseMatmul(16384, 4096, 4096, 4096, true, true);
 
+// Wide-and-deep style inputs: batches of examples with tens of active
+// features each, out of a large vocabulary, times embedding-sized columns.
+BM_SparseTensorDenseMatmul(65536, 2048, 16384, 64, false, false);
+BM_SparseTensorDenseMatmul(65536, 2048, 16384, 256, false, false);
+BM_SparseTensorDenseMatmul(65536, 2048, 16384, 256, false, true);
+BM_SparseTensorDenseMatmul(262144, 8192, 16384, 256, false, false);
+BM_SparseTensorDenseMatmul(262144, 8192, 16384, 1024, false, false);
+
 }  // end namespace tensorflow
@@ -29,6 +29,8 @@ limitations under the License.
 
 #include "tensorflow/core/kernels/strided_slice_op.h"
 
+#include <optional>
+
 #include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
 #include "tensorflow/core/framework/bounds_check.h"
 #include "tensorflow/core/framework/op_kernel.h"
@@ -313,6 +315,9 @@ class StridedSliceAssignOp : public OpKernel {
 
     Tensor* old_lhs = nullptr;
     Tensor tmp;
+    core::RefCountPtr<Var> v;
+    // Held until the assignment into the resource variable is done.
+    std::optional<mutex_lock> ml;
     if (isTensor) {
       const Tensor& input = context->input(0);
 
@@ -327,12 +332,11 @@ class StridedSliceAssignOp : public OpKernel {
       }
     } else {
       if (context->input_dtype(0) == DT_RESOURCE) {
-        core::RefCountPtr<Var> v;
         OP_REQUIRES_OK(
             context, LookupResource(context, HandleFromInput(context, 0), &v));
         OP_REQUIRES_OK(context,
                        EnsureSparseVariableAccess<Device, T>(context, v.get()));
-        mutex_lock ml(*v->mu());
+        ml.emplace(*v->mu());
         old_lhs = v->tensor();
         OP_REQUIRES(context, old_lhs->dtype() == DataTypeToEnum<T>::value,
                     errors::InvalidArgument(
@@ -385,13 +389,14 @@ class StridedSliceAssignOp : public OpKernel {
 
 // Handle general dimensions.  The do{}while(false) construct is a common
 // approach to avoid pedantic extra semicolon warnings.
-#define HANDLE_DIM(NDIM)                                 \
-  do {                                                   \
-    if (processing_dims == NDIM) {                       \
-      HandleStridedSliceAssignCase<Device, T, NDIM>()(   \
-          context, begin, end, strides, bcast, old_lhs); \
-      return;                                            \
-    }                                                    \
+#define HANDLE_DIM(NDIM)                                  \
+  do {                                                    \
+    if (processing_dims == NDIM) {                        \
+      HandleStridedSliceAssignCase<Device, T, NDIM>()(    \
+          context, begin, end, strides, bcast, old_lhs);  \
+      if (v && context->status().ok()) v->MarkUpdated(); \
+      return;                                             \
+    }                                                     \
   } while (false)
       HANDLE_DIM(0);
       HANDLE_DIM(1);
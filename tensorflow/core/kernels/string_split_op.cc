@@ -15,6 +15,8 @@ limitations under the License.
 
 // See docs in ../ops/string_ops.cc.
 
+#include <algorithm>
+#include <cstring>
 #include <string>
 
 #include "tensorflow/core/framework/kernel_def_builder.h"
@@ -27,80 +29,65 @@ limitations under the License.
 
 namespace tensorflow {
 namespace {
-// Split input string `str` based on a character delimiter.
-// Returns a vector of StringPieces which are valid as long as input `str`
-// is valid.
+// Splits strings based on a delimiter: a single character, a set of
+// characters, or every character if the delimiter is empty. Split calls
+// `emit(token)` for each token accepted by `predicate`; the tokens are valid
+// as long as the string is.
 // Note: The single character delimiter is a common case and is implemented as
-// a series of finds in the input string, making it much more efficient than
-// SplitOnCharSet.
-template <typename Predicate>
-std::vector<StringPiece> SplitOnChar(const tstring& str, const char delim,
-                                     Predicate p) {
-  std::vector<StringPiece> result;
-  StringPiece text(str);
-  auto f = text.find(delim);
-  while (f != StringPiece::npos) {
-    StringPiece token = text.substr(0, f);
-    if (p(token)) {
-      result.emplace_back(token);
+// a series of memchr in the input string, which scan many characters at once.
+// A set of characters is looked up in a table rather than searched.
+class Splitter {
+ public:
+  explicit Splitter(StringPiece delimiter) : delimiter_(delimiter) {
+    for (const char c : delimiter_) {
+      is_delimiter_[static_cast<unsigned char>(c)] = true;
     }
-    text.remove_prefix(f + 1);
-    f = text.find(delim);
   }
-  if (p(text)) {
-    result.push_back(text);
-  }
-  return result;
-}
 
-// Split input string `str` based on a set of character delimiters.
-// Returns a vector of StringPieces which are valid as long as input `str`
-// is valid.
-// Based on str_util::Split.
-template <typename Predicate>
-std::vector<StringPiece> SplitOnCharSet(const tstring& str,
-                                        const tstring& delim_set, Predicate p) {
-  std::vector<StringPiece> result;
-  StringPiece text(str);
-  StringPiece delims(delim_set);
-  size_t token_start = 0;
-  for (size_t i = 0; i < text.size() + 1; i++) {
-    if ((i == text.size()) || (delims.find(text[i]) != StringPiece::npos)) {
-      StringPiece token(text.data() + token_start, i - token_start);
-      if (p(token)) {
-        result.emplace_back(token);
+  template <typename Predicate, typename Emit>
+  void Split(StringPiece text, Predicate predicate, Emit emit) const {
+    if (text.empty()) return;
+    if (delimiter_.empty()) {
+      for (size_t i = 0; i < text.size(); ++i) {
+        emit(StringPiece(text.data() + i, 1));
       }
-      token_start = i + 1;
+      return;
     }
-  }
-  return result;
-}
-
-// Split input string `str` based on given delimiter.
-// Returns a vector of StringPieces which are valid as long as input `str`
-// is valid.
-template <typename Predicate>
-std::vector<StringPiece> Split(const tstring& str, const tstring& delimiter,
-                               Predicate predicate) {
-  if (str.empty()) {
-    return std::vector<StringPiece>();
-  }
-  if (delimiter.empty()) {
-    std::vector<StringPiece> result;
-    result.resize(str.size());
-    for (size_t i = 0; i < str.size(); ++i) {
-      result[i] = StringPiece(str.data() + i, 1);
+    const char* token_start = text.data();
+    const char* const end = text.data() + text.size();
+    if (delimiter_.size() == 1) {
+      const char delim = delimiter_[0];
+      const char* f;
+      while ((f = static_cast<const char*>(
+                  memchr(token_start, delim, end - token_start))) != nullptr) {
+        EmitIf(StringPiece(token_start, f - token_start), predicate, emit);
+        token_start = f + 1;
+      }
+    } else {
+      for (const char* c = token_start; c != end; ++c) {
+        if (is_delimiter_[static_cast<unsigned char>(*c)]) {
+          EmitIf(StringPiece(token_start, c - token_start), predicate, emit);
+          token_start = c + 1;
+        }
+      }
     }
-    return result;
+    EmitIf(StringPiece(token_start, end - token_start), predicate, emit);
   }
-  if (delimiter.size() == 1) {
-    return SplitOnChar(str, delimiter[0], predicate);
+
+ private:
+  template <typename Predicate, typename Emit>
+  static void EmitIf(StringPiece token, Predicate predicate, Emit emit) {
+    if (predicate(token)) emit(token);
   }
-  return SplitOnCharSet(str, delimiter, predicate);
-}
 
-std::vector<StringPiece> SplitV2(const tstring& str, StringPiece sep,
-                                 int maxsplit) {
+  const StringPiece delimiter_;
+  bool is_delimiter_[256] = {};
+};
+
+// Splits `text` as python's str.split, calling `emit(token)` for each token.
+// The tokens are valid as long as `text` is.
+template <typename Emit>
+void SplitV2(StringPiece text, StringPiece sep, int maxsplit, Emit emit) {
   // This SplitV2 method matches the behavior of python's str.split:
   //   If sep is given, consecutive delimiters are not grouped together
   //   and are deemed to delimit empty strings (for example, '1,,2'.split(',')
@@ -114,13 +101,9 @@ std::vector<StringPiece> SplitV2(const tstring& str, StringPiece sep,
   //   end if the string has leading or trailing whitespace. Consequently,
   //   splitting an empty string or a string consisting of just whitespace
   //   with a None separator returns [].
-
-  std::vector<StringPiece> result;
-
-  StringPiece text(str);
   if (maxsplit == 0) {
-    result.emplace_back(text);
-    return result;
+    emit(text);
+    return;
   }
 
   if (sep.empty()) {
@@ -129,32 +112,44 @@ std::vector<StringPiece> SplitV2(const tstring& str, StringPiece sep,
     str_util::RemoveLeadingWhitespace(&text);
     int split = 0;
     while (str_util::ConsumeNonWhitespace(&text, &token)) {
-      result.push_back(token);
+      emit(token);
       str_util::RemoveLeadingWhitespace(&text);
       ++split;
       if (maxsplit > 0 && split == maxsplit) {
-        result.push_back(text);
-        return result;
+        emit(text);
+        return;
       }
     }
-    return result;
+    return;
   }
-  auto p = std::search(text.begin(), text.end(), sep.begin(), sep.end());
+  // Finds the next separator by scanning for its first character with memchr.
+  const auto find_sep = [sep](StringPiece text) -> size_t {
+    const char* const end = text.data() + text.size();
+    const char* p = text.data();
+    while (static_cast<size_t>(end - p) >= sep.size()) {
+      p = static_cast<const char*>(
+          memchr(p, sep[0], end - p - sep.size() + 1));
+      if (p == nullptr) break;
+      if (memcmp(p + 1, sep.data() + 1, sep.size() - 1) == 0) {
+        return p - text.data();
+      }
+      ++p;
+    }
+    return StringPiece::npos;
+  };
+  size_t f = find_sep(text);
   int split = 0;
-  while (p != text.end()) {
-    StringPiece token = text.substr(0, p - text.begin());
-    result.push_back(token);
-    text.remove_prefix(token.size());
-    text.remove_prefix(sep.size());
+  while (f != StringPiece::npos) {
+    emit(text.substr(0, f));
+    text.remove_prefix(f + sep.size());
     ++split;
     if (maxsplit > 0 && split == maxsplit) {
-      result.push_back(StringPiece(text));
-      return result;
+      emit(text);
+      return;
     }
-    p = std::search(text.begin(), text.end(), sep.begin(), sep.end());
+    f = find_sep(text);
   }
-  result.push_back(text);
-  return result;
+  emit(text);
 }
 
 }  // namespace
@@ -190,24 +185,24 @@ class StringSplitOp : public OpKernel {
     const auto delimiter_vec = delimiter_tensor->flat<tstring>();
     const tstring& delimiter = delimiter_vec(0);
     // Empty delimiter means split the input character by character.
-    std::vector<StringPiece> tokens;
-    // Guess that we'll be unpacking a handful of tokens per example.
-    static constexpr int kReserveSize = 4;
-    tokens.reserve(batch_size * kReserveSize);
+    const Splitter splitter(delimiter);
+    const auto for_each_token = [&](int64_t i, auto emit) {
+      if (skip_empty_) {
+        splitter.Split(input_vec(i), str_util::SkipEmpty(), emit);
+      } else {
+        splitter.Split(input_vec(i), str_util::AllowEmpty(), emit);
+      }
+    };
 
+    // Count the tokens, then write them: splitting twice is cheaper than
+    // collecting the tokens of every string.
     int64_t output_size = 0;
     int64_t max_num_entries = 0;
-    std::vector<int64_t> num_indices(batch_size);
     for (int64_t i = 0; i < batch_size; ++i) {
-      std::vector<StringPiece> parts =
-          skip_empty_ ? Split(input_vec(i), delimiter, str_util::SkipEmpty())
-                      : Split(input_vec(i), delimiter, str_util::AllowEmpty());
-      int64_t n_entries = parts.size();
-      num_indices[i] = n_entries;
+      int64_t n_entries = 0;
+      for_each_token(i, [&n_entries](StringPiece) { ++n_entries; });
       output_size += n_entries;
       max_num_entries = std::max(max_num_entries, n_entries);
-      tokens.insert(tokens.end(), std::make_move_iterator(parts.begin()),
-                    std::make_move_iterator(parts.end()));
     }
 
     Tensor* sp_indices_t;
@@ -224,14 +219,15 @@ class StringSplitOp : public OpKernel {
     auto sp_shape = sp_shape_t->vec<int64_t>();
     sp_shape(0) = batch_size;
     sp_shape(1) = max_num_entries;
-    size_t c = 0;
-    for (size_t i = 0; i < batch_size; ++i) {
-      for (size_t j = 0; j < num_indices[i]; ++j) {
+    int64_t c = 0;
+    for (int64_t i = 0; i < batch_size; ++i) {
+      int64_t j = 0;
+      for_each_token(i, [&](StringPiece token) {
         sp_indices(c, 0) = i;
-        sp_indices(c, 1) = j;
-        sp_tokens(c).assign(tokens[c].data(), tokens[c].size());
+        sp_indices(c, 1) = j++;
+        sp_tokens(c).assign(token.data(), token.size());
         ++c;
-      }
+      });
     }
   }
 
@@ -263,21 +259,17 @@ class StringSplitV2Op : public OpKernel {
                                         sep_tensor->shape().DebugString()));
     const auto sep_vec = sep_tensor->flat<tstring>();
     StringPiece sep(sep_vec(0));
-    std::vector<StringPiece> tokens;
-    // Guess that we'll be unpacking a handful of tokens per example.
-    static constexpr int kReserveSize = 4;
-    tokens.reserve(batch_size * kReserveSize);
 
+    // Count the tokens, then write them: splitting twice is cheaper than
+    // collecting the tokens of every string.
     int64_t output_size = 0;
     int64_t max_num_entries = 0;
-    std::vector<int64_t> num_indices(batch_size);
     for (int64_t i = 0; i < batch_size; ++i) {
-      std::vector<StringPiece> parts = SplitV2(input_vec(i), sep, maxsplit_);
-      int64_t n_entries = parts.size();
-      num_indices[i] = n_entries;
+      int64_t n_entries = 0;
+      SplitV2(input_vec(i), sep, maxsplit_,
+              [&n_entries](StringPiece) { ++n_entries; });
       output_size += n_entries;
       max_num_entries = std::max(max_num_entries, n_entries);
-      tokens.insert(tokens.end(), parts.begin(), parts.end());
     }
 
     Tensor* sp_indices_t;
@@ -294,14 +286,15 @@ class StringSplitV2Op : public OpKernel {
     auto sp_shape = sp_shape_t->vec<int64_t>();
     sp_shape(0) = batch_size;
     sp_shape(1) = max_num_entries;
-    size_t c = 0;
-    for (size_t i = 0; i < batch_size; ++i) {
-      for (size_t j = 0; j < num_indices[i]; ++j) {
+    int64_t c = 0;
+    for (int64_t i = 0; i < batch_size; ++i) {
+      int64_t j = 0;
+      SplitV2(input_vec(i), sep, maxsplit_, [&](StringPiece token) {
         sp_indices(c, 0) = i;
-        sp_indices(c, 1) = j;
-        sp_tokens(c).assign(tokens[c].data(), tokens[c].size());
+        sp_indices(c, 1) = j++;
+        sp_tokens(c).assign(token.data(), token.size());
         ++c;
-      }
+      });
     }
   }
 
@@ -54,6 +54,82 @@ const char* lines[] = {
     "backwards compatibility guarantee like C++, Go, Java, JavaScript and "
     "Swift."};
 
+class StringSplitOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(bool skip_empty) {
+    TF_ASSERT_OK(NodeDefBuilder("op", "StringSplit")
+                     .Input(FakeInput(DT_STRING))
+                     .Input(FakeInput(DT_STRING))
+                     .Attr("skip_empty", skip_empty)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+
+  void MakeV2Op(int maxsplit) {
+    TF_ASSERT_OK(NodeDefBuilder("op", "StringSplitV2")
+                     .Input(FakeInput(DT_STRING))
+                     .Input(FakeInput(DT_STRING))
+                     .Attr("maxsplit", maxsplit)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+
+  void ExpectOutputs(const std::vector<int64_t>& indices,
+                     const std::vector<tstring>& values,
+                     const std::vector<int64_t>& dense_shape) {
+    test::ExpectTensorEqual<int64_t>(
+        *GetOutput(0),
+        test::AsTensor<int64_t>(
+            indices, {static_cast<int64_t>(indices.size() / 2), 2}));
+    test::ExpectTensorEqual<tstring>(*GetOutput(1),
+                                     test::AsTensor<tstring>(values));
+    test::ExpectTensorEqual<int64_t>(*GetOutput(2),
+                                     test::AsTensor<int64_t>(dense_shape));
+  }
+};
+
+TEST_F(StringSplitOpTest, CharacterSet) {
+  MakeOp(/*skip_empty=*/true);
+  AddInputFromArray<tstring>(TensorShape({3}), {"a b,,c", "", ",d,"});
+  AddInputFromArray<tstring>(TensorShape({}), {" ,"});
+  TF_ASSERT_OK(RunOpKernel());
+  ExpectOutputs({0, 0, 0, 1, 0, 2, 2, 0}, {"a", "b", "c", "d"}, {3, 3});
+}
+
+TEST_F(StringSplitOpTest, CharacterWithEmptyTokens) {
+  MakeOp(/*skip_empty=*/false);
+  AddInputFromArray<tstring>(TensorShape({2}), {"a,,b", ",c"});
+  AddInputFromArray<tstring>(TensorShape({}), {","});
+  TF_ASSERT_OK(RunOpKernel());
+  ExpectOutputs({0, 0, 0, 1, 0, 2, 1, 0, 1, 1}, {"a", "", "b", "", "c"},
+                {2, 3});
+}
+
+TEST_F(StringSplitOpTest, EmptyDelimiter) {
+  MakeOp(/*skip_empty=*/true);
+  AddInputFromArray<tstring>(TensorShape({2}), {"ab", "c"});
+  AddInputFromArray<tstring>(TensorShape({}), {""});
+  TF_ASSERT_OK(RunOpKernel());
+  ExpectOutputs({0, 0, 0, 1, 1, 0}, {"a", "b", "c"}, {2, 2});
+}
+
+TEST_F(StringSplitOpTest, V2Separator) {
+  MakeV2Op(/*maxsplit=*/-1);
+  AddInputFromArray<tstring>(TensorShape({3}), {"1<>2<><>3", "", "<<>>"});
+  AddInputFromArray<tstring>(TensorShape({}), {"<>"});
+  TF_ASSERT_OK(RunOpKernel());
+  ExpectOutputs({0, 0, 0, 1, 0, 2, 0, 3, 1, 0, 2, 0, 2, 1},
+                {"1", "2", "", "3", "", "<", ">"}, {3, 4});
+}
+
+TEST_F(StringSplitOpTest, V2Whitespace) {
+  MakeV2Op(/*maxsplit=*/1);
+  AddInputFromArray<tstring>(TensorShape({2}), {"  a b  c ", " "});
+  AddInputFromArray<tstring>(TensorShape({}), {""});
+  TF_ASSERT_OK(RunOpKernel());
+  ExpectOutputs({0, 0, 0, 1}, {"a", "b  c "}, {2, 2});
+}
+
 Tensor GetTestTensor(int batch) {
   const int sz = TF_ARRAYSIZE(lines);
   Tensor t(DT_STRING, {batch});
@@ -64,10 +140,10 @@ Tensor GetTestTensor(int batch) {
   return t;
 }
 
-Graph* SetupStringSplitGraph(const Tensor& input) {
+Graph* SetupStringSplitGraph(const Tensor& input, const string& delimiter) {
   Graph* g = new Graph(OpRegistry::Global());
   Tensor delim(DT_STRING, TensorShape({}));
-  delim.flat<tstring>().setConstant(" ");
+  delim.flat<tstring>().setConstant(delimiter);
 
   TF_CHECK_OK(NodeBuilder("string_split_op", "StringSplit")
                   .Input(test::graph::Constant(g, input))
@@ -80,7 +156,7 @@ static void BM_StringSplit(::testing::benchmark::State& state) {
   const int batch_size = state.range(0);
 
   Tensor input = GetTestTensor(batch_size);
-  Graph* g = SetupStringSplitGraph(input);
+  Graph* g = SetupStringSplitGraph(input, " ");
   test::Benchmark("cpu", g, /*old_benchmark_api*/ false).Run(state);
   state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
 }
@@ -95,10 +171,10 @@ BENCHMARK(BM_StringSplit)
     ->Arg(128)
     ->Arg(256);
 
-Graph* SetupStringSplitV2Graph(const Tensor& input) {
+Graph* SetupStringSplitV2Graph(const Tensor& input, const string& separator) {
   Graph* g = new Graph(OpRegistry::Global());
   Tensor sep(DT_STRING, TensorShape({}));
-  sep.flat<tstring>().setConstant(" ");
+  sep.flat<tstring>().setConstant(separator);
 
   TF_CHECK_OK(NodeBuilder("string_split_op", "StringSplitV2")
                   .Input(test::graph::Constant(g, input))
@@ -111,7 +187,7 @@ static void BM_StringSplitV2(::testing::benchmark::State& state) {
   const int batch_size = state.range(0);
 
   Tensor input = GetTestTensor(batch_size);
-  Graph* g = SetupStringSplitV2Graph(input);
+  Graph* g = SetupStringSplitV2Graph(input, " ");
   test::Benchmark("cpu", g, /*old_benchmark_api*/ false).Run(state);
   state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
 }
@@ -126,4 +202,89 @@ BENCHMARK(BM_StringSplitV2)
     ->Arg(128)
     ->Arg(256);
 
+// Splits words on any punctuation, as text preprocessing does.
+static void BM_StringSplitCharacterSet(::testing::benchmark::State& state) {
+  const int batch_size = state.range(0);
+
+  Tensor input = GetTestTensor(batch_size);
+  Graph* g = SetupStringSplitGraph(input, " ,.()[]/");
+  test::Benchmark("cpu", g, /*old_benchmark_api*/ false).Run(state);
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+BENCHMARK(BM_StringSplitCharacterSet)
+    ->UseRealTime()
+    ->Arg(1)
+    ->Arg(32)
+    ->Arg(256)
+    ->Arg(4096);
+
+static void BM_StringSplitCharacters(::testing::benchmark::State& state) {
+  const int batch_size = state.range(0);
+
+  Tensor input = GetTestTensor(batch_size);
+  Graph* g = SetupStringSplitGraph(input, "");
+  test::Benchmark("cpu", g, /*old_benchmark_api*/ false).Run(state);
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+BENCHMARK(BM_StringSplitCharacters)->UseRealTime()->Arg(32)->Arg(256);
+
+static void BM_StringSplitV2Whitespace(::testing::benchmark::State& state) {
+  const int batch_size = state.range(0);
+
+  Tensor input = GetTestTensor(batch_size);
+  Graph* g = SetupStringSplitV2Graph(input, "");
+  test::Benchmark("cpu", g, /*old_benchmark_api*/ false).Run(state);
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+BENCHMARK(BM_StringSplitV2Whitespace)
+    ->UseRealTime()
+    ->Arg(1)
+    ->Arg(32)
+    ->Arg(256)
+    ->Arg(4096);
+
+static void BM_StringSplitV2Separator(::testing::benchmark::State& state) {
+  const int batch_size = state.range(0);
+
+  Tensor input = GetTestTensor(batch_size);
+  Graph* g = SetupStringSplitV2Graph(input, ", ");
+  test::Benchmark("cpu", g, /*old_benchmark_api*/ false).Run(state);
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+BENCHMARK(BM_StringSplitV2Separator)
+    ->UseRealTime()
+    ->Arg(1)
+    ->Arg(32)
+    ->Arg(256)
+    ->Arg(4096);
+
+// Hashes the strings of a batch, as feature columns do after splitting text.
+// The lines are long enough for tstring to store them out of line, so large
+// batches measure the prefetching and the sharding of the kernel.
+static void BM_StringToHashBucketFast(::testing::benchmark::State& state) {
+  const int batch_size = state.range(0);
+
+  Tensor input = GetTestTensor(batch_size);
+  Graph* g = new Graph(OpRegistry::Global());
+  TF_CHECK_OK(NodeBuilder("string_to_hash_bucket_fast_op",
+                          "StringToHashBucketFast")
+                  .Input(test::graph::Constant(g, input))
+                  .Attr("num_buckets", 1 << 20)
+                  .Finalize(g, nullptr /* node */));
+  test::Benchmark("cpu", g, /*old_benchmark_api*/ false).Run(state);
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          batch_size);
+}
+
+BENCHMARK(BM_StringToHashBucketFast)
+    ->UseRealTime()
+    ->Arg(1)
+    ->Arg(256)
+    ->Arg(4096)
+    ->Arg(65536);
+
 }  // end namespace tensorflow
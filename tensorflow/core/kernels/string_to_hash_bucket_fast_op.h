@@ -23,6 +23,8 @@ limitations under the License.
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/prefetch.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
@@ -44,18 +46,36 @@ class StringToHashBucketOp : public OpKernel {
                                             &output_tensor));
     auto output_flat = output_tensor->flat<int64_t>();
 
-    typedef decltype(input_flat.size()) Index;
-    for (Index i = 0; i < input_flat.size(); ++i) {
-      const uint64 input_hash = hash(input_flat(i));
-      const uint64 bucket_id = input_hash % num_buckets_;
-      // The number of buckets is always in the positive range of int64 so is
-      // the resulting bucket_id. Casting the bucket_id from uint64 to int64 is
-      // safe.
-      output_flat(i) = static_cast<int64_t>(bucket_id);
-    }
+    // Hashing a string mostly waits for its characters, which are out of
+    // line for long strings: prefetch the characters of the strings a few
+    // iterations ahead, so that several strings are loaded at once, and hash
+    // large batches in parallel.
+    auto hash_strings = [&](int64_t start, int64_t limit) {
+      for (int64_t i = start; i < limit; ++i) {
+        if (i + kPrefetchDistance < limit) {
+          port::prefetch<port::PREFETCH_HINT_T0>(
+              input_flat(i + kPrefetchDistance).data());
+        }
+        const uint64 input_hash = hash(input_flat(i));
+        const uint64 bucket_id = input_hash % num_buckets_;
+        // The number of buckets is always in the positive range of int64 so
+        // is the resulting bucket_id. Casting the bucket_id from uint64 to
+        // int64 is safe.
+        output_flat(i) = static_cast<int64_t>(bucket_id);
+      }
+    };
+    const auto& worker_threads =
+        *context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads.num_threads, worker_threads.workers,
+          input_flat.size(), kCostPerString, hash_strings);
   }
 
  private:
+  // Number of strings whose characters are prefetched ahead of the hashed one.
+  static constexpr int64_t kPrefetchDistance = 8;
+  // Guesstimate of the cost of hashing a string of a few words.
+  static constexpr int64_t kCostPerString = 100;
+
   int64_t num_buckets_;
 
   StringToHashBucketOp(const StringToHashBucketOp&) = delete;
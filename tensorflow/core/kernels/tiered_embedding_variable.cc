@@ -0,0 +1,538 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/tiered_embedding_variable.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/core/framework/bounds_check.h"
+#include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/tensor_slice.h"
+#include "tensorflow/core/framework/type_index.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/monitoring/counter.h"
+#include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/random_distributions.h"
+#include "tensorflow/core/platform/strcat.h"
+#include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
+
+namespace tensorflow {
+namespace {
+
+// Garbage below which the file of the rows isn't compacted.
+constexpr int64_t kMinCompactionBytes = 1 << 20;
+// Size of the slices of rows written or read by Save() and Restore().
+constexpr int64_t kSliceBytes = 64 << 20;
+
+auto* row_reads_counter = monitoring::Counter<1>::New(
+    "/tensorflow/core/tiered_embedding_variable/row_reads",
+    "The number of rows of TieredEmbeddingVariables read from the cache, "
+    "from the file or generated by the initializer.",
+    "tier");
+
+template <typename T>
+void InitializeValues(int64_t seed, int64_t row, float minval, float maxval,
+                      int64_t size, T* values) {
+  if (minval == maxval) {
+    std::fill(values, values + size, static_cast<T>(minval));
+    return;
+  }
+  using Uniform = random::UniformDistribution<random::PhiloxRandom, float>;
+  random::PhiloxRandom generator(seed, row);
+  Uniform uniform;
+  for (int64_t i = 0; i < size;) {
+    const auto samples = uniform(&generator);
+    for (int j = 0; j < Uniform::kResultElementCount && i < size; ++j, ++i) {
+      values[i] = static_cast<T>(minval + (maxval - minval) * samples[j]);
+    }
+  }
+}
+
+// Adds `updates`, or `updates[0]` to every value if `scalar`, to `values`.
+template <typename T>
+void AddValues(const T* updates, bool scalar, int64_t size, T* values) {
+  for (int64_t i = 0; i < size; ++i) {
+    values[i] += updates[scalar ? 0 : i];
+  }
+}
+
+// Calls `fn(i, row)` for each row `indices[i]`, after checking all of them.
+template <typename Index, typename Fn>
+Status ForEachRowImpl(const Tensor& indices, int64_t num_rows, Fn fn) {
+  const auto ids = indices.flat<Index>();
+  for (int64_t i = 0; i < ids.size(); ++i) {
+    if (!FastBoundsCheck(ids(i), num_rows)) {
+      return errors::InvalidArgument("indices[", i, "] = ", ids(i),
+                                     " is not in [0, ", num_rows, ")");
+    }
+  }
+  for (int64_t i = 0; i < ids.size(); ++i) {
+    TF_RETURN_IF_ERROR(fn(i, static_cast<int64_t>(ids(i))));
+  }
+  return OkStatus();
+}
+
+template <typename Fn>
+Status ForEachRow(const Tensor& indices, int64_t num_rows, Fn fn) {
+  switch (indices.dtype()) {
+    case DT_INT32:
+      return ForEachRowImpl<int32>(indices, num_rows, std::move(fn));
+    case DT_INT64:
+      return ForEachRowImpl<int64_t>(indices, num_rows, std::move(fn));
+    default:
+      return errors::InvalidArgument("indices must be int32 or int64, got ",
+                                     DataTypeString(indices.dtype()));
+  }
+}
+
+// Returns the slice of `length` rows from `start` of a tensor of `shape`.
+TensorSlice RowSlice(const TensorShape& shape, int64_t start, int64_t length) {
+  TensorSlice slice(shape.dims());
+  slice.set_start(0, start);
+  slice.set_length(0, length);
+  return slice;
+}
+
+}  // namespace
+
+Status TieredEmbeddingVariable::Create(Env* env, const Options& options,
+                                       TieredEmbeddingVariable** variable) {
+  if (!DataTypeIsFloating(options.dtype)) {
+    return errors::InvalidArgument(
+        "TieredEmbeddingVariable rows must be of a floating point type, got ",
+        DataTypeString(options.dtype));
+  }
+  if (options.shape.dims() < 1) {
+    return errors::InvalidArgument(
+        "TieredEmbeddingVariable shape must be at least 1 dimensional");
+  }
+  if (options.cache_rows < 1) {
+    return errors::InvalidArgument("cache_rows must be positive, got ",
+                                   options.cache_rows);
+  }
+  std::string path = options.path;
+  if (path.empty()) {
+    path = io::GetTempFilename("rows");
+  } else if (env->FileExists(path).ok()) {
+    // The file is truncated now and deleted with the variable.
+    return errors::AlreadyExists(
+        "TieredEmbeddingVariable path must not exist, got ", path);
+  }
+  auto* result = new TieredEmbeddingVariable(env, options, std::move(path));
+  Status status;
+  {
+    mutex_lock l(result->mu_);
+    status = result->OpenFile(/*truncate=*/true);
+  }
+  if (!status.ok()) {
+    result->Unref();
+    return status;
+  }
+  *variable = result;
+  return OkStatus();
+}
+
+TieredEmbeddingVariable::TieredEmbeddingVariable(Env* env,
+                                                 const Options& options,
+                                                 std::string path)
+    : env_(env),
+      dtype_(options.dtype),
+      shape_(options.shape),
+      num_rows_(options.shape.dim_size(0)),
+      row_size_(options.shape.num_elements() /
+                std::max<int64_t>(options.shape.dim_size(0), 1)),
+      row_bytes_(row_size_ * DataTypeSize(options.dtype)),
+      cache_rows_(std::min(options.cache_rows,
+                           std::max<int64_t>(options.shape.dim_size(0), 1))),
+      path_(std::move(path)),
+      initializer_minval_(options.initializer_minval),
+      initializer_maxval_(options.initializer_maxval),
+      seed_(options.seed) {
+  mutex_lock l(mu_);
+  cache_ = Tensor(dtype_, TensorShape({cache_rows_, row_size_}));
+  cache_base_ = const_cast<char*>(cache_.tensor_data().data());
+  file_offsets_.assign(num_rows_, -1);
+  Clear();
+}
+
+TieredEmbeddingVariable::~TieredEmbeddingVariable() {
+  mutex_lock l(mu_);
+  if (writer_ != nullptr) {
+    writer_->Close().IgnoreError();
+  }
+  writer_.reset();
+  reader_.reset();
+  env_->DeleteFile(path_).IgnoreError();
+}
+
+Status TieredEmbeddingVariable::GatherShape(const Tensor& indices,
+                                            TensorShape* shape) const {
+  *shape = indices.shape();
+  for (int d = 1; d < shape_.dims(); ++d) {
+    TF_RETURN_IF_ERROR(shape->AddDimWithStatus(shape_.dim_size(d)));
+  }
+  return OkStatus();
+}
+
+Status TieredEmbeddingVariable::Gather(const Tensor& indices, Tensor* output) {
+  if (output->dtype() != dtype_) {
+    return errors::InvalidArgument(
+        "Trying to gather ", DataTypeString(output->dtype()),
+        " from a TieredEmbeddingVariable of ", DataTypeString(dtype_));
+  }
+  char* out = const_cast<char*>(output->tensor_data().data());
+  mutex_lock l(mu_);
+  return ForEachRow(
+      indices, num_rows_,
+      [&](int64_t i, int64_t row) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) -> Status {
+        char* values;
+        TF_RETURN_IF_ERROR(GetRow(row, /*for_update=*/false, &values));
+        std::memcpy(out + i * row_bytes_, values, row_bytes_);
+        return OkStatus();
+      });
+}
+
+Status TieredEmbeddingVariable::ScatterAdd(const Tensor& indices,
+                                           const Tensor& updates) {
+  if (updates.dtype() != dtype_) {
+    return errors::InvalidArgument(
+        "DType of TieredEmbeddingVariable and updates does not match: ",
+        DataTypeString(dtype_), " vs. ", DataTypeString(updates.dtype()));
+  }
+  TensorShape shape;
+  TF_RETURN_IF_ERROR(GatherShape(indices, &shape));
+  const bool scalar = updates.dims() == 0;
+  if (!scalar && updates.shape() != shape) {
+    return errors::InvalidArgument(
+        "Must have updates.shape = indices.shape + params.shape[1:] or "
+        "updates.shape = [], got updates.shape ",
+        updates.shape().DebugString(), ", indices.shape ",
+        indices.shape().DebugString(), ", params.shape ",
+        shape_.DebugString());
+  }
+  const char* data = updates.tensor_data().data();
+  mutex_lock l(mu_);
+  return ForEachRow(
+      indices, num_rows_,
+      [&](int64_t i, int64_t row) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) -> Status {
+        char* values;
+        TF_RETURN_IF_ERROR(GetRow(row, /*for_update=*/true, &values));
+        const char* row_updates = scalar ? data : data + i * row_bytes_;
+        switch (dtype_) {
+#define CASE(T)                                                   \
+  case DataTypeToEnum<T>::value:                                  \
+    AddValues(reinterpret_cast<const T*>(row_updates), scalar,    \
+              row_size_, reinterpret_cast<T*>(values));           \
+    break;
+          TF_CALL_FLOAT_TYPES(CASE)
+#undef CASE
+          default:
+            break;
+        }
+        return OkStatus();
+      });
+}
+
+Status TieredEmbeddingVariable::Save(const std::string& prefix,
+                                     const std::string& tensor_name) {
+  BundleWriter writer(env_, prefix);
+  TF_RETURN_IF_ERROR(writer.status());
+  if (num_rows_ == 0) {
+    TF_RETURN_IF_ERROR(writer.Add(tensor_name, Tensor(dtype_, shape_)));
+    return writer.Finish();
+  }
+  const int64_t slice_rows =
+      std::max<int64_t>(1, kSliceBytes / std::max<int64_t>(row_bytes_, 1));
+  for (int64_t start = 0; start < num_rows_; start += slice_rows) {
+    const int64_t length = std::min(slice_rows, num_rows_ - start);
+    TensorShape slice_shape = shape_;
+    slice_shape.set_dim(0, length);
+    Tensor slice(dtype_, slice_shape);
+    char* data = const_cast<char*>(slice.tensor_data().data());
+    {
+      mutex_lock l(mu_);
+      for (int64_t i = 0; i < length; ++i) {
+        TF_RETURN_IF_ERROR(PeekRow(start + i, data + i * row_bytes_));
+      }
+    }
+    TF_RETURN_IF_ERROR(writer.AddSlice(
+        tensor_name, shape_, RowSlice(shape_, start, length), slice));
+  }
+  return writer.Finish();
+}
+
+Status TieredEmbeddingVariable::Restore(const std::string& prefix,
+                                        const std::string& tensor_name) {
+  BundleReader reader(env_, prefix);
+  TF_RETURN_IF_ERROR(reader.status());
+  DataType dtype;
+  TensorShape shape;
+  TF_RETURN_IF_ERROR(reader.LookupDtypeAndShape(tensor_name, &dtype, &shape));
+  if (dtype != dtype_ || shape != shape_) {
+    return errors::InvalidArgument(
+        "Trying to restore ", tensor_name, " of type ", DataTypeString(dtype),
+        " and shape ", shape.DebugString(),
+        " into a TieredEmbeddingVariable of type ", DataTypeString(dtype_),
+        " and shape ", shape_.DebugString());
+  }
+  mutex_lock l(mu_);
+  Clear();
+  TF_RETURN_IF_ERROR(OpenFile(/*truncate=*/true));
+  const int64_t slice_rows =
+      std::max<int64_t>(1, kSliceBytes / std::max<int64_t>(row_bytes_, 1));
+  for (int64_t start = 0; start < num_rows_; start += slice_rows) {
+    const int64_t length = std::min(slice_rows, num_rows_ - start);
+    TensorShape slice_shape = shape_;
+    slice_shape.set_dim(0, length);
+    Tensor slice(dtype_, slice_shape);
+    TF_RETURN_IF_ERROR(reader.LookupSlice(
+        tensor_name, RowSlice(shape_, start, length), &slice));
+    const char* data = slice.tensor_data().data();
+    for (int64_t i = 0; i < length; ++i) {
+      TF_RETURN_IF_ERROR(WriteRow(start + i, data + i * row_bytes_));
+    }
+  }
+  return OkStatus();
+}
+
+TieredEmbeddingVariable::Stats TieredEmbeddingVariable::GetStats() const {
+  mutex_lock l(mu_);
+  return stats_;
+}
+
+std::string TieredEmbeddingVariable::DebugString() const {
+  mutex_lock l(mu_);
+  return strings::StrCat("TieredEmbeddingVariable of shape ",
+                         shape_.DebugString(), " caching ",
+                         cached_rows_.size(), " of ", cache_rows_,
+                         " rows, with ", live_rows_, " rows in ", path_);
+}
+
+int64_t TieredEmbeddingVariable::MemoryUsed() const {
+  mutex_lock l(mu_);
+  return cache_.TotalBytes() + file_offsets_.size() * sizeof(int64_t);
+}
+
+Status TieredEmbeddingVariable::GetRow(int64_t row, bool for_update,
+                                       char** values) {
+  auto it = cached_rows_.find(row);
+  if (it != cached_rows_.end()) {
+    Touch(&it->second);
+    it->second.dirty |= for_update;
+    ++stats_.cache_hits;
+    row_reads_counter->GetCell("cache")->IncrementBy(1);
+    *values = CacheSlot(it->second.slot);
+    return OkStatus();
+  }
+
+  if (free_slots_.empty()) {
+    TF_RETURN_IF_ERROR(EvictRow());
+  }
+  const int64_t slot = free_slots_.back();
+  TF_RETURN_IF_ERROR(LoadRow(row, CacheSlot(slot)));
+  if (file_offsets_[row] < 0) {
+    ++stats_.initialized_rows;
+    row_reads_counter->GetCell("initializer")->IncrementBy(1);
+  } else {
+    ++stats_.file_reads;
+    row_reads_counter->GetCell("file")->IncrementBy(1);
+  }
+  free_slots_.pop_back();
+  std::list<int64_t>& rows = rows_by_frequency_[1];
+  rows.push_back(row);
+  cached_rows_[row] = {slot, /*frequency=*/1, for_update,
+                       std::prev(rows.end())};
+  min_frequency_ = 1;
+  *values = CacheSlot(slot);
+  return OkStatus();
+}
+
+Status TieredEmbeddingVariable::PeekRow(int64_t row, char* values) {
+  auto it = cached_rows_.find(row);
+  if (it != cached_rows_.end()) {
+    std::memcpy(values, CacheSlot(it->second.slot), row_bytes_);
+    return OkStatus();
+  }
+  return LoadRow(row, values);
+}
+
+Status TieredEmbeddingVariable::LoadRow(int64_t row, char* values) {
+  const int64_t offset = file_offsets_[row];
+  if (offset < 0) {
+    InitializeRow(row, values);
+    return OkStatus();
+  }
+  if (unflushed_) {
+    TF_RETURN_IF_ERROR(writer_->Flush());
+    unflushed_ = false;
+  }
+  StringPiece result;
+  TF_RETURN_IF_ERROR(reader_->Read(offset, row_bytes_, &result, values));
+  if (result.size() != static_cast<size_t>(row_bytes_)) {
+    return errors::DataLoss("Could not read row ", row, " of ", path_);
+  }
+  if (result.data() != values) {
+    std::memcpy(values, result.data(), row_bytes_);
+  }
+  return OkStatus();
+}
+
+void TieredEmbeddingVariable::InitializeRow(int64_t row, char* values) const {
+  switch (dtype_) {
+#define CASE(T)                                                        \
+  case DataTypeToEnum<T>::value:                                       \
+    InitializeValues(seed_, row, initializer_minval_,                  \
+                     initializer_maxval_, row_size_,                   \
+                     reinterpret_cast<T*>(values));                    \
+    break;
+    TF_CALL_FLOAT_TYPES(CASE)
+#undef CASE
+    default:
+      break;
+  }
+}
+
+Status TieredEmbeddingVariable::WriteRow(int64_t row, const char* values) {
+  TF_RETURN_IF_ERROR(writer_->Append(StringPiece(values, row_bytes_)));
+  if (file_offsets_[row] < 0) {
+    ++live_rows_;
+  }
+  file_offsets_[row] = file_bytes_;
+  file_bytes_ += row_bytes_;
+  unflushed_ = true;
+  ++stats_.file_writes;
+  return OkStatus();
+}
+
+Status TieredEmbeddingVariable::EvictRow() {
+  auto rows = rows_by_frequency_.find(min_frequency_);
+  const int64_t row = rows->second.front();
+  auto it = cached_rows_.find(row);
+  const int64_t slot = it->second.slot;
+  if (it->second.dirty) {
+    TF_RETURN_IF_ERROR(WriteRow(row, CacheSlot(slot)));
+  }
+  rows->second.pop_front();
+  if (rows->second.empty()) {
+    rows_by_frequency_.erase(rows);
+  }
+  cached_rows_.erase(it);
+  free_slots_.push_back(slot);
+  // The row is evicted even if the file can't be compacted.
+  return MaybeCompactFile();
+}
+
+void TieredEmbeddingVariable::Touch(CachedRow* cached_row) {
+  auto rows = rows_by_frequency_.find(cached_row->frequency);
+  const int64_t row = *cached_row->position;
+  rows->second.erase(cached_row->position);
+  if (rows->second.empty()) {
+    rows_by_frequency_.erase(rows);
+    if (min_frequency_ == cached_row->frequency) {
+      ++min_frequency_;
+    }
+  }
+  ++cached_row->frequency;
+  std::list<int64_t>& new_rows = rows_by_frequency_[cached_row->frequency];
+  new_rows.push_back(row);
+  cached_row->position = std::prev(new_rows.end());
+}
+
+Status TieredEmbeddingVariable::OpenFile(bool truncate) {
+  if (truncate) {
+    TF_RETURN_IF_ERROR(env_->NewWritableFile(path_, &writer_));
+    file_bytes_ = 0;
+  } else {
+    TF_RETURN_IF_ERROR(env_->NewAppendableFile(path_, &writer_));
+  }
+  unflushed_ = false;
+  return env_->NewRandomAccessFile(path_, &reader_);
+}
+
+Status TieredEmbeddingVariable::MaybeCompactFile() {
+  const int64_t live_bytes = live_rows_ * row_bytes_;
+  if (file_bytes_ - live_bytes <= std::max(live_bytes, kMinCompactionBytes)) {
+    return OkStatus();
+  }
+  TF_RETURN_IF_ERROR(writer_->Flush());
+  unflushed_ = false;
+
+  // Copies the live rows in file order, so that the file is read sequentially.
+  std::vector<std::pair<int64_t, int64_t>> live_rows;
+  live_rows.reserve(live_rows_);
+  for (int64_t row = 0; row < num_rows_; ++row) {
+    if (file_offsets_[row] >= 0) {
+      live_rows.emplace_back(file_offsets_[row], row);
+    }
+  }
+  std::sort(live_rows.begin(), live_rows.end());
+  const std::string compacted_path = strings::StrCat(path_, ".compacted");
+  std::unique_ptr<WritableFile> compacted;
+  TF_RETURN_IF_ERROR(env_->NewWritableFile(compacted_path, &compacted));
+  std::unique_ptr<char[]> buffer(new char[row_bytes_]);
+  for (size_t i = 0; i < live_rows.size(); ++i) {
+    TF_RETURN_IF_ERROR(LoadRow(live_rows[i].second, buffer.get()));
+    TF_RETURN_IF_ERROR(
+        compacted->Append(StringPiece(buffer.get(), row_bytes_)));
+  }
+  TF_RETURN_IF_ERROR(compacted->Close());
+
+  // The old file stays open until the compacted file replaces it and is
+  // reopened. On failure the rows are still read from and appended to the old
+  // file, through the handles that are still open.
+  Status status = env_->RenameFile(compacted_path, path_);
+  if (!status.ok()) {
+    env_->DeleteFile(compacted_path).IgnoreError();
+    return status;
+  }
+  std::unique_ptr<WritableFile> writer;
+  std::unique_ptr<RandomAccessFile> reader;
+  TF_RETURN_IF_ERROR(env_->NewAppendableFile(path_, &writer));
+  TF_RETURN_IF_ERROR(env_->NewRandomAccessFile(path_, &reader));
+  writer_->Close().IgnoreError();
+  writer_ = std::move(writer);
+  reader_ = std::move(reader);
+  for (size_t i = 0; i < live_rows.size(); ++i) {
+    file_offsets_[live_rows[i].second] = i * row_bytes_;
+  }
+  file_bytes_ = live_bytes;
+  return OkStatus();
+}
+
+void TieredEmbeddingVariable::Clear() {
+  cached_rows_.clear();
+  rows_by_frequency_.clear();
+  min_frequency_ = 0;
+  free_slots_.resize(cache_rows_);
+  for (int64_t slot = 0; slot < cache_rows_; ++slot) {
+    free_slots_[slot] = cache_rows_ - 1 - slot;
+  }
+  std::fill(file_offsets_.begin(), file_offsets_.end(), -1);
+  live_rows_ = 0;
+}
+
+bool IsTieredEmbeddingVariable(const ResourceHandle& handle) {
+  return handle.hash_code() ==
+         TypeIndex::Make<TieredEmbeddingVariable>().hash_code();
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,176 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_KERNELS_TIERED_EMBEDDING_VARIABLE_H_
+#define TENSORFLOW_CORE_KERNELS_TIERED_EMBEDDING_VARIABLE_H_
+
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "tensorflow/core/framework/resource_base.h"
+#include "tensorflow/core/framework/resource_handle.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+
+namespace tensorflow {
+
+// A variable of rows, such as an embedding table, that doesn't have to fit in
+// memory. The most frequently used rows are cached in memory, and the others
+// are stored in a local file:
+// - The cache holds up to `cache_rows` rows and evicts the least frequently
+//   used one, the least recently used among them, to make room for a row.
+// - Evicted rows that were updated are appended to the file. The file is
+//   compacted when more than half of it holds overwritten rows.
+// - Rows that were never written are generated from their index and the
+//   seed, uniformly in [initializer_minval, initializer_maxval).
+//
+// The file is a cache of the variable rather than a checkpoint: it is deleted
+// with the variable, and Save() writes the variable to a tensor bundle.
+//
+// ResourceGather and ResourceScatterAdd on CPU accept a handle to such a
+// variable in place of a resource variable. The variable is thread-safe.
+class TieredEmbeddingVariable : public ResourceBase {
+ public:
+  struct Options {
+    // Type of the rows. Must be a floating point type.
+    DataType dtype = DT_FLOAT;
+    // Shape of the variable, whose first dimension indexes the rows.
+    TensorShape shape;
+    // Number of rows cached in memory.
+    int64_t cache_rows = 1;
+    // File of the rows that aren't cached, or a temporary file if empty. The
+    // file must not exist: it is created with the variable and deleted with
+    // it.
+    std::string path;
+    float initializer_minval = 0.0f;
+    float initializer_maxval = 0.0f;
+    int64_t seed = 0;
+  };
+
+  // Number of row reads from each tier.
+  struct Stats {
+    int64_t cache_hits = 0;
+    int64_t file_reads = 0;
+    int64_t initialized_rows = 0;
+    int64_t file_writes = 0;
+  };
+
+  static Status Create(Env* env, const Options& options,
+                       TieredEmbeddingVariable** variable);
+
+  ~TieredEmbeddingVariable() override;
+
+  DataType dtype() const { return dtype_; }
+  const TensorShape& shape() const { return shape_; }
+
+  // Returns the shape of the rows `indices`, after checking the indices.
+  Status GatherShape(const Tensor& indices, TensorShape* shape) const;
+
+  // Copies the rows `indices` to `output`, of shape GatherShape(indices).
+  Status Gather(const Tensor& indices, Tensor* output);
+
+  // Adds `updates`, of shape GatherShape(indices), to the rows `indices`.
+  Status ScatterAdd(const Tensor& indices, const Tensor& updates);
+
+  // Writes the variable as the tensor `tensor_name` of the bundle `prefix`,
+  // by slices of rows so that it is never entirely in memory. The tensor can
+  // be read back with Restore() or any reader of sliced tensors.
+  Status Save(const std::string& prefix, const std::string& tensor_name);
+
+  // Replaces the variable by the tensor `tensor_name` of the bundle `prefix`.
+  Status Restore(const std::string& prefix, const std::string& tensor_name);
+
+  Stats GetStats() const;
+
+  std::string DebugString() const override;
+  int64_t MemoryUsed() const override;
+
+ private:
+  struct CachedRow {
+    int64_t slot;       // Row of cache_ holding the values.
+    int64_t frequency;  // Number of accesses since the row was cached.
+    bool dirty;         // Whether the values differ from the file's.
+    std::list<int64_t>::iterator position;  // In rows_by_frequency_.
+  };
+
+  TieredEmbeddingVariable(Env* env, const Options& options,
+                          std::string path);
+
+  // Returns the cached values of `row`, caching the row if needed.
+  Status GetRow(int64_t row, bool for_update, char** values)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  // Copies the values of `row` to `values` without caching the row.
+  Status PeekRow(int64_t row, char* values) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  // Reads `row` from the file, or generates it if it was never written.
+  Status LoadRow(int64_t row, char* values) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void InitializeRow(int64_t row, char* values) const;
+  Status WriteRow(int64_t row, const char* values)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  Status EvictRow() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void Touch(CachedRow* cached_row) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  Status OpenFile(bool truncate) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  Status MaybeCompactFile() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void Clear() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  char* CacheSlot(int64_t slot) const {
+    return cache_base_ + slot * row_bytes_;
+  }
+
+  Env* const env_;
+  const DataType dtype_;
+  const TensorShape shape_;
+  const int64_t num_rows_;
+  const int64_t row_size_;
+  const int64_t row_bytes_;
+  const int64_t cache_rows_;
+  const std::string path_;
+  const float initializer_minval_;
+  const float initializer_maxval_;
+  const int64_t seed_;
+
+  mutable mutex mu_;
+  Tensor cache_ TF_GUARDED_BY(mu_);
+  char* cache_base_ = nullptr;
+  absl::flat_hash_map<int64_t, CachedRow> cached_rows_ TF_GUARDED_BY(mu_);
+  // The cached rows of each frequency, from the least recently used.
+  absl::flat_hash_map<int64_t, std::list<int64_t>> rows_by_frequency_
+      TF_GUARDED_BY(mu_);
+  int64_t min_frequency_ TF_GUARDED_BY(mu_) = 0;
+  std::vector<int64_t> free_slots_ TF_GUARDED_BY(mu_);
+
+  // Offset of each row in the file, or -1 if it was never written.
+  std::vector<int64_t> file_offsets_ TF_GUARDED_BY(mu_);
+  std::unique_ptr<WritableFile> writer_ TF_GUARDED_BY(mu_);
+  std::unique_ptr<RandomAccessFile> reader_ TF_GUARDED_BY(mu_);
+  int64_t file_bytes_ TF_GUARDED_BY(mu_) = 0;
+  int64_t live_rows_ TF_GUARDED_BY(mu_) = 0;
+  bool unflushed_ TF_GUARDED_BY(mu_) = false;
+
+  Stats stats_ TF_GUARDED_BY(mu_);
+};
+
+// Returns whether `handle` refers to a TieredEmbeddingVariable.
+bool IsTieredEmbeddingVariable(const ResourceHandle& handle);
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_TIERED_EMBEDDING_VARIABLE_H_
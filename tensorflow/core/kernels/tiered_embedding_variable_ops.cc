@@ -0,0 +1,142 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/resource_variable_ops.cc.
+
+#include <string>
+
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/kernels/tiered_embedding_variable.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/refcount.h"
+
+namespace tensorflow {
+namespace {
+
+class TieredEmbeddingVarHandleOp : public OpKernel {
+ public:
+  explicit TieredEmbeddingVarHandleOp(OpKernelConstruction* c) : OpKernel(c) {
+    OP_REQUIRES_OK(c, c->GetAttr("container", &container_));
+    OP_REQUIRES_OK(c, c->GetAttr("shared_name", &shared_name_));
+    if (shared_name_.empty()) {
+      shared_name_ = name();
+    }
+    OP_REQUIRES_OK(c, c->GetAttr("dtype", &options_.dtype));
+    OP_REQUIRES_OK(c, c->GetAttr("shape", &options_.shape));
+    OP_REQUIRES_OK(c, c->GetAttr("cache_rows", &options_.cache_rows));
+    OP_REQUIRES_OK(c, c->GetAttr("path", &options_.path));
+    OP_REQUIRES_OK(c, c->GetAttr("initializer_minval",
+                                 &options_.initializer_minval));
+    OP_REQUIRES_OK(c, c->GetAttr("initializer_maxval",
+                                 &options_.initializer_maxval));
+    OP_REQUIRES_OK(c, c->GetAttr("seed", &options_.seed));
+  }
+
+  void Compute(OpKernelContext* c) override {
+    const ResourceHandle handle = MakeResourceHandle<TieredEmbeddingVariable>(
+        c, container_, shared_name_,
+        {DtypeAndPartialTensorShape{options_.dtype,
+                                    PartialTensorShape(options_.shape)}});
+    core::RefCountPtr<TieredEmbeddingVariable> variable;
+    OP_REQUIRES_OK(c, LookupOrCreateResource<TieredEmbeddingVariable>(
+                          c, handle, &variable,
+                          [this, c](TieredEmbeddingVariable** ptr) {
+                            return TieredEmbeddingVariable::Create(
+                                c->env(), options_, ptr);
+                          }));
+    OP_REQUIRES(c,
+                variable->dtype() == options_.dtype &&
+                    variable->shape() == options_.shape,
+                errors::InvalidArgument(
+                    "Shared TieredEmbeddingVariable ", shared_name_,
+                    " has type ", DataTypeString(variable->dtype()),
+                    " and shape ", variable->shape().DebugString(),
+                    ", expected ", DataTypeString(options_.dtype), " and ",
+                    options_.shape.DebugString()));
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(c, c->allocate_output(0, TensorShape({}), &output));
+    output->scalar<ResourceHandle>()() = handle;
+  }
+
+  bool IsExpensive() override { return false; }
+
+ private:
+  std::string container_;
+  std::string shared_name_;
+  TieredEmbeddingVariable::Options options_;
+};
+
+// Reads the scalar string inputs prefix and tensor_name of the save and
+// restore ops.
+Status GetBundleTensor(OpKernelContext* c, std::string* prefix,
+                       std::string* tensor_name) {
+  const Tensor& prefix_tensor = c->input(1);
+  const Tensor& tensor_name_tensor = c->input(2);
+  if (!TensorShapeUtils::IsScalar(prefix_tensor.shape()) ||
+      !TensorShapeUtils::IsScalar(tensor_name_tensor.shape())) {
+    return errors::InvalidArgument(
+        "prefix and tensor_name must be scalars, got shapes ",
+        prefix_tensor.shape().DebugString(), " and ",
+        tensor_name_tensor.shape().DebugString());
+  }
+  *prefix = prefix_tensor.scalar<tstring>()();
+  *tensor_name = tensor_name_tensor.scalar<tstring>()();
+  return OkStatus();
+}
+
+class SaveTieredEmbeddingVariableOp : public OpKernel {
+ public:
+  explicit SaveTieredEmbeddingVariableOp(OpKernelConstruction* c)
+      : OpKernel(c) {}
+
+  void Compute(OpKernelContext* c) override {
+    core::RefCountPtr<TieredEmbeddingVariable> variable;
+    OP_REQUIRES_OK(c, LookupResource(c, HandleFromInput(c, 0), &variable));
+    std::string prefix;
+    std::string tensor_name;
+    OP_REQUIRES_OK(c, GetBundleTensor(c, &prefix, &tensor_name));
+    OP_REQUIRES_OK(c, variable->Save(prefix, tensor_name));
+  }
+};
+
+class RestoreTieredEmbeddingVariableOp : public OpKernel {
+ public:
+  explicit RestoreTieredEmbeddingVariableOp(OpKernelConstruction* c)
+      : OpKernel(c) {}
+
+  void Compute(OpKernelContext* c) override {
+    core::RefCountPtr<TieredEmbeddingVariable> variable;
+    OP_REQUIRES_OK(c, LookupResource(c, HandleFromInput(c, 0), &variable));
+    std::string prefix;
+    std::string tensor_name;
+    OP_REQUIRES_OK(c, GetBundleTensor(c, &prefix, &tensor_name));
+    OP_REQUIRES_OK(c, variable->Restore(prefix, tensor_name));
+  }
+};
+
+}  // namespace
+
+REGISTER_KERNEL_BUILDER(Name("TieredEmbeddingVarHandleOp").Device(DEVICE_CPU),
+                        TieredEmbeddingVarHandleOp);
+REGISTER_KERNEL_BUILDER(
+    Name("SaveTieredEmbeddingVariable").Device(DEVICE_CPU),
+    SaveTieredEmbeddingVariableOp);
+REGISTER_KERNEL_BUILDER(
+    Name("RestoreTieredEmbeddingVariable").Device(DEVICE_CPU),
+    RestoreTieredEmbeddingVariableOp);
+
+}  // namespace tensorflow
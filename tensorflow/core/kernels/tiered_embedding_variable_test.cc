@@ -0,0 +1,408 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/tiered_embedding_variable.h"
+
+#include <string>
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/resource_handle.h"
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/monitoring/cell_reader.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/file_system.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
+
+namespace tensorflow {
+namespace {
+
+using ::tensorflow::monitoring::testing::CellReader;
+
+constexpr char kRowReadsMetric[] =
+    "/tensorflow/core/tiered_embedding_variable/row_reads";
+
+TieredEmbeddingVariable::Options MakeOptions(const TensorShape& shape,
+                                             int64_t cache_rows) {
+  TieredEmbeddingVariable::Options options;
+  options.shape = shape;
+  options.cache_rows = cache_rows;
+  return options;
+}
+
+// Env whose first file rename fails.
+class FailingRenameEnv : public EnvWrapper {
+ public:
+  FailingRenameEnv() : EnvWrapper(Env::Default()) {
+    FileSystem* file_system = nullptr;
+    TF_CHECK_OK(target()->GetFileSystemForFile(testing::TmpDir(),
+                                               &file_system));
+    file_system_ = std::make_unique<FailingRenameFileSystem>(file_system);
+  }
+
+  int renames() const { return file_system_->renames(); }
+
+  Status GetFileSystemForFile(const std::string& fname,
+                              FileSystem** result) override {
+    *result = file_system_.get();
+    return OkStatus();
+  }
+
+ private:
+  class FailingRenameFileSystem : public WrappedFileSystem {
+   public:
+    explicit FailingRenameFileSystem(FileSystem* file_system)
+        : WrappedFileSystem(file_system, /*token=*/nullptr) {}
+
+    int renames() const { return renames_; }
+
+    using WrappedFileSystem::RenameFile;
+    Status RenameFile(const std::string& src, const std::string& target,
+                      TransactionToken* token) override {
+      if (renames_++ == 0) {
+        return errors::Unavailable("Could not rename ", src);
+      }
+      return WrappedFileSystem::RenameFile(src, target, token);
+    }
+
+   private:
+    int renames_ = 0;
+  };
+
+  std::unique_ptr<FailingRenameFileSystem> file_system_;
+};
+
+class TieredEmbeddingVariableTest : public ::testing::Test {
+ protected:
+  ~TieredEmbeddingVariableTest() override {
+    for (TieredEmbeddingVariable* variable : variables_) {
+      variable->Unref();
+    }
+  }
+
+  TieredEmbeddingVariable* Create(
+      const TieredEmbeddingVariable::Options& options) {
+    TieredEmbeddingVariable* variable = nullptr;
+    TF_CHECK_OK(
+        TieredEmbeddingVariable::Create(Env::Default(), options, &variable));
+    variables_.push_back(variable);
+    return variable;
+  }
+
+  static Tensor Gather(TieredEmbeddingVariable* variable,
+                       const std::vector<int32>& indices) {
+    const Tensor indices_tensor = test::AsTensor<int32>(indices);
+    TensorShape shape;
+    TF_CHECK_OK(variable->GatherShape(indices_tensor, &shape));
+    Tensor output(variable->dtype(), shape);
+    TF_CHECK_OK(variable->Gather(indices_tensor, &output));
+    return output;
+  }
+
+  static void ScatterAdd(TieredEmbeddingVariable* variable,
+                         const std::vector<int32>& indices,
+                         const std::vector<float>& updates) {
+    TF_ASSERT_OK(variable->ScatterAdd(
+        test::AsTensor<int32>(indices),
+        test::AsTensor<float>(
+            updates, TensorShape({static_cast<int64_t>(indices.size()),
+                                  static_cast<int64_t>(updates.size() /
+                                                       indices.size())}))));
+  }
+
+ private:
+  std::vector<TieredEmbeddingVariable*> variables_;
+};
+
+TEST_F(TieredEmbeddingVariableTest, InitializesRowsFromSeed) {
+  TieredEmbeddingVariable::Options options = MakeOptions({100, 8}, 4);
+  options.initializer_minval = -1.0f;
+  options.initializer_maxval = 1.0f;
+  options.seed = 7;
+  TieredEmbeddingVariable* a = Create(options);
+  TieredEmbeddingVariable* b = Create(options);
+
+  // Rows don't depend on the order they are read in or on evictions.
+  const Tensor rows = Gather(a, {3, 99, 0, 1, 2});
+  Gather(b, {0, 1, 2, 4, 5});
+  test::ExpectTensorEqual<float>(rows, Gather(b, {3, 99, 0, 1, 2}));
+
+  const auto values = rows.flat<float>();
+  for (int64_t i = 0; i < values.size(); ++i) {
+    EXPECT_GE(values(i), -1.0f);
+    EXPECT_LT(values(i), 1.0f);
+  }
+  EXPECT_NE(values(0), values(8));
+}
+
+TEST_F(TieredEmbeddingVariableTest, InitializesRowsToConstant) {
+  TieredEmbeddingVariable::Options options = MakeOptions({4, 2}, 4);
+  options.initializer_minval = 0.5f;
+  options.initializer_maxval = 0.5f;
+  TieredEmbeddingVariable* variable = Create(options);
+
+  test::ExpectTensorEqual<float>(
+      test::AsTensor<float>({0.5, 0.5, 0.5, 0.5}, TensorShape({2, 2})),
+      Gather(variable, {3, 1}));
+}
+
+TEST_F(TieredEmbeddingVariableTest, EvictsUpdatedRowsToFile) {
+  CellReader<int64_t> reader(kRowReadsMetric);
+  TieredEmbeddingVariable* variable = Create(MakeOptions({4, 2}, 2));
+  ScatterAdd(variable, {0, 1}, {1, 2, 3, 4});
+
+  // Caching rows 2 and 3 evicts rows 0 and 1, which were updated.
+  test::ExpectTensorEqual<float>(
+      test::AsTensor<float>({0, 0, 0, 0}, TensorShape({2, 2})),
+      Gather(variable, {2, 3}));
+  test::ExpectTensorEqual<float>(
+      test::AsTensor<float>({3, 4, 1, 2}, TensorShape({2, 2})),
+      Gather(variable, {1, 0}));
+  Gather(variable, {0});
+
+  const TieredEmbeddingVariable::Stats stats = variable->GetStats();
+  EXPECT_EQ(stats.cache_hits, 1);
+  EXPECT_EQ(stats.initialized_rows, 4);
+  EXPECT_EQ(stats.file_writes, 2);
+  EXPECT_EQ(stats.file_reads, 2);
+  EXPECT_EQ(reader.Delta("cache"), 1);
+  EXPECT_EQ(reader.Delta("initializer"), 4);
+  EXPECT_EQ(reader.Delta("file"), 2);
+}
+
+TEST_F(TieredEmbeddingVariableTest, EvictsLeastFrequentlyUsedRow) {
+  TieredEmbeddingVariable* variable = Create(MakeOptions({4, 1}, 2));
+  Gather(variable, {0, 0, 0, 1});
+  // Row 1 is evicted although row 0 was used less recently.
+  Gather(variable, {2});
+  Gather(variable, {0});
+  EXPECT_EQ(variable->GetStats().cache_hits, 3);
+  Gather(variable, {1});
+  EXPECT_EQ(variable->GetStats().cache_hits, 3);
+  EXPECT_EQ(variable->GetStats().initialized_rows, 4);
+}
+
+TEST_F(TieredEmbeddingVariableTest, CompactsFile) {
+  const std::string path = io::JoinPath(testing::TmpDir(), "compacted_rows");
+  TieredEmbeddingVariable::Options options = MakeOptions({4, 256}, 1);
+  options.path = path;
+  TieredEmbeddingVariable* variable = Create(options);
+
+  // Each update evicts the other row, appending 1KB to the file.
+  const std::vector<float> ones(256, 1.0f);
+  for (int i = 0; i < 3000; ++i) {
+    ScatterAdd(variable, {i % 2}, ones);
+  }
+  EXPECT_EQ(variable->GetStats().file_writes, 2999);
+  uint64 file_size = 0;
+  TF_ASSERT_OK(Env::Default()->GetFileSize(path, &file_size));
+  EXPECT_LE(file_size, (1 << 20) + 2 * 1024);
+
+  const Tensor rows = Gather(variable, {0, 1, 2});
+  test::ExpectTensorEqual<float>(
+      rows.Slice(0, 2), test::AsTensor<float>(std::vector<float>(512, 1500),
+                                              TensorShape({2, 256})));
+  test::ExpectTensorEqual<float>(
+      rows.Slice(2, 3),
+      test::AsTensor<float>(std::vector<float>(256, 0), TensorShape({1, 256})));
+}
+
+TEST_F(TieredEmbeddingVariableTest, KeepsFileIfCompactionFails) {
+  FailingRenameEnv env;
+  TieredEmbeddingVariable::Options options = MakeOptions({4, 256}, 1);
+  options.path = io::JoinPath(testing::TmpDir(), "uncompacted_rows");
+  TieredEmbeddingVariable* variable = nullptr;
+  TF_ASSERT_OK(TieredEmbeddingVariable::Create(&env, options, &variable));
+
+  // The update whose eviction fails to compact the file isn't applied. The
+  // others still go to the old file until the next compaction succeeds.
+  const Tensor ones = test::AsTensor<float>(std::vector<float>(256, 1.0f),
+                                            TensorShape({1, 256}));
+  std::vector<float> updates(2, 0);
+  int failures = 0;
+  for (int i = 0; i < 3000; ++i) {
+    const Status s = variable->ScatterAdd(test::AsTensor<int32>({i % 2}), ones);
+    if (s.ok()) {
+      ++updates[i % 2];
+    } else {
+      EXPECT_TRUE(errors::IsUnavailable(s)) << s;
+      ++failures;
+    }
+  }
+  EXPECT_EQ(failures, 1);
+  EXPECT_GE(env.renames(), 2);
+  EXPECT_TRUE(errors::IsNotFound(
+      env.FileExists(strings::StrCat(options.path, ".compacted"))));
+
+  const Tensor rows = Gather(variable, {0, 1});
+  for (int row = 0; row < 2; ++row) {
+    test::ExpectTensorEqual<float>(
+        rows.Slice(row, row + 1),
+        test::AsTensor<float>(std::vector<float>(256, updates[row]),
+                              TensorShape({1, 256})));
+  }
+  variable->Unref();
+}
+
+TEST_F(TieredEmbeddingVariableTest, RejectsExistingPath) {
+  const std::string path = io::JoinPath(testing::TmpDir(), "existing_rows");
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), path, "contents"));
+  TieredEmbeddingVariable::Options options = MakeOptions({4, 2}, 1);
+  options.path = path;
+  TieredEmbeddingVariable* variable = nullptr;
+  EXPECT_TRUE(errors::IsAlreadyExists(
+      TieredEmbeddingVariable::Create(Env::Default(), options, &variable)));
+  std::string contents;
+  TF_ASSERT_OK(ReadFileToString(Env::Default(), path, &contents));
+  EXPECT_EQ(contents, "contents");
+}
+
+TEST_F(TieredEmbeddingVariableTest, DeletesFile) {
+  const std::string path = io::JoinPath(testing::TmpDir(), "deleted_rows");
+  TieredEmbeddingVariable::Options options = MakeOptions({4, 2}, 1);
+  options.path = path;
+  TieredEmbeddingVariable* variable = nullptr;
+  TF_ASSERT_OK(
+      TieredEmbeddingVariable::Create(Env::Default(), options, &variable));
+  TF_EXPECT_OK(Env::Default()->FileExists(path));
+  variable->Unref();
+  EXPECT_TRUE(errors::IsNotFound(Env::Default()->FileExists(path)));
+}
+
+TEST_F(TieredEmbeddingVariableTest, SavesAndRestores) {
+  const std::string prefix = io::JoinPath(testing::TmpDir(), "tiered_ckpt");
+  TieredEmbeddingVariable::Options options = MakeOptions({6, 3}, 2);
+  options.initializer_minval = -1.0f;
+  options.initializer_maxval = 1.0f;
+  options.seed = 1;
+  TieredEmbeddingVariable* saved = Create(options);
+  ScatterAdd(saved, {5, 0, 2}, {1, 1, 1, 2, 2, 2, 3, 3, 3});
+  const Tensor expected = Gather(saved, {0, 1, 2, 3, 4, 5});
+  TF_ASSERT_OK(saved->Save(prefix, "table"));
+
+  // The checkpoint holds a regular tensor.
+  BundleReader bundle(Env::Default(), prefix);
+  TF_ASSERT_OK(bundle.status());
+  Tensor tensor;
+  TF_ASSERT_OK(bundle.Lookup("table", &tensor));
+  test::ExpectTensorEqual<float>(expected, tensor);
+
+  options.seed = 2;
+  TieredEmbeddingVariable* restored = Create(options);
+  ScatterAdd(restored, {1}, {5, 5, 5});
+  TF_ASSERT_OK(restored->Restore(prefix, "table"));
+  test::ExpectTensorEqual<float>(expected,
+                                 Gather(restored, {0, 1, 2, 3, 4, 5}));
+
+  TieredEmbeddingVariable* other = Create(MakeOptions({6, 2}, 2));
+  EXPECT_TRUE(errors::IsInvalidArgument(other->Restore(prefix, "table")));
+}
+
+TEST_F(TieredEmbeddingVariableTest, IndexOutOfRange) {
+  TieredEmbeddingVariable* variable = Create(MakeOptions({4, 2}, 2));
+  Tensor output(DT_FLOAT, TensorShape({2, 2}));
+  Status s = variable->Gather(test::AsTensor<int32>({1, 4}), &output);
+  EXPECT_TRUE(
+      absl::StrContains(s.ToString(), "indices[1] = 4 is not in [0, 4)"))
+      << s;
+  s = variable->ScatterAdd(test::AsTensor<int32>({-1}),
+                           test::AsTensor<float>({1, 1}, TensorShape({1, 2})));
+  EXPECT_TRUE(
+      absl::StrContains(s.ToString(), "indices[0] = -1 is not in [0, 4)"))
+      << s;
+  // The rows before the bad index were not read.
+  EXPECT_EQ(variable->GetStats().initialized_rows, 0);
+}
+
+class TieredEmbeddingVariableOpsTest : public OpsTestBase {
+ protected:
+  // Creates a variable of 5 rows of 2 columns with TieredEmbeddingVarHandleOp.
+  void SetUp() override {
+    TF_ASSERT_OK(NodeDefBuilder("handle", "TieredEmbeddingVarHandleOp")
+                     .Attr("dtype", DT_FLOAT)
+                     .Attr("shape", TensorShape({5, 2}))
+                     .Attr("cache_rows", 2)
+                     .Attr("shared_name", "table")
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+    TF_ASSERT_OK(RunOpKernel());
+    handle_ = GetOutput(0)->scalar<ResourceHandle>()();
+    EXPECT_TRUE(IsTieredEmbeddingVariable(handle_));
+  }
+
+  Status ScatterAdd(const std::vector<int32>& indices,
+                    const std::vector<float>& updates) {
+    TF_RETURN_IF_ERROR(NodeDefBuilder("scatter", "ResourceScatterAdd")
+                           .Input(FakeInput(DT_RESOURCE))
+                           .Input(FakeInput(DT_INT32))
+                           .Input(FakeInput(DT_FLOAT))
+                           .Finalize(node_def()));
+    TF_RETURN_IF_ERROR(InitOp());
+    inputs_.clear();
+    AddInputFromArray<ResourceHandle>(TensorShape({}), {handle_});
+    const int64_t n = indices.size();
+    AddInputFromArray<int32>(TensorShape({n}), indices);
+    AddInputFromArray<float>(
+        TensorShape({n, static_cast<int64_t>(updates.size()) / n}), updates);
+    return RunOpKernel();
+  }
+
+  Status Gather(const std::vector<int32>& indices, int batch_dims = 0) {
+    TF_RETURN_IF_ERROR(NodeDefBuilder("gather", "ResourceGather")
+                           .Input(FakeInput(DT_RESOURCE))
+                           .Input(FakeInput(DT_INT32))
+                           .Attr("dtype", DT_FLOAT)
+                           .Attr("batch_dims", batch_dims)
+                           .Finalize(node_def()));
+    TF_RETURN_IF_ERROR(InitOp());
+    inputs_.clear();
+    AddInputFromArray<ResourceHandle>(TensorShape({}), {handle_});
+    AddInputFromArray<int32>(
+        TensorShape({static_cast<int64_t>(indices.size())}), indices);
+    return RunOpKernel();
+  }
+
+  ResourceHandle handle_;
+};
+
+TEST_F(TieredEmbeddingVariableOpsTest, GatherAndScatterAdd) {
+  TF_ASSERT_OK(ScatterAdd({4, 1}, {1, 2, 3, 4}));
+  TF_ASSERT_OK(ScatterAdd({0, 4}, {5, 5, 5, 5}));
+  TF_ASSERT_OK(Gather({4, 3, 1, 0}));
+  test::ExpectTensorEqual<float>(
+      test::AsTensor<float>({6, 7, 0, 0, 3, 4, 5, 5}, TensorShape({4, 2})),
+      *GetOutput(0));
+
+  core::RefCountPtr<TieredEmbeddingVariable> variable;
+  TF_ASSERT_OK(LookupResource(context_.get(), handle_, &variable));
+  EXPECT_GT(variable->GetStats().file_reads, 0);
+}
+
+TEST_F(TieredEmbeddingVariableOpsTest, GatherWithBatchDimsIsUnimplemented) {
+  EXPECT_TRUE(errors::IsUnimplemented(Gather({0}, /*batch_dims=*/1)));
+}
+
+}  // namespace
+}  // namespace tensorflow
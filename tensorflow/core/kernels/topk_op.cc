@@ -129,6 +129,88 @@ class TopK : public OpKernel {
 
 namespace functor {
 
+// Rows are split into chunks of at least this many columns.
+constexpr int64_t kTopKMinChunkSize = 1 << 14;
+
+// Returns the number of chunks into which to split each row, to compute the
+// top k of a few long rows in parallel: at most the number of threads per row,
+// with chunks of at least kTopKMinChunkSize columns and 4 * k columns, so that
+// merging the top k of the chunks is cheap. Returns 1 when the rows are
+// computed as a whole.
+inline int64_t NumTopKChunksPerRow(int64_t num_rows, int64_t num_cols, int k,
+                                   int num_threads) {
+  if (num_rows >= num_threads || k == num_cols) return 1;
+  const int64_t min_chunk_size = std::max<int64_t>(kTopKMinChunkSize, 4 * k);
+  return std::max<int64_t>(
+      1, std::min<int64_t>(num_threads / num_rows, num_cols / min_chunk_size));
+}
+
+// Computes the top k of rows split into `num_chunks` chunks: the top k of each
+// chunk are computed in parallel, then merged. Every one of the top k of a row
+// is among the top k of its chunk, for the order by decreasing value then
+// increasing index, so the result is the one of the whole rows.
+template <typename T, typename Tidx>
+void ChunkedRowsTopK(OpKernelContext* context, bool sorted, int k,
+                     const typename TTypes<T, 2>::ConstTensor& input,
+                     const int64_t num_rows, const int64_t num_cols,
+                     const int64_t num_chunks, const double cmp_cost,
+                     typename TTypes<T, 2>::Tensor values,
+                     typename TTypes<Tidx, 2>::Tensor indices) {
+  struct StableGreater {
+    bool operator()(const Tidx a, const Tidx b) const {
+      if (input_data[b] < input_data[a]) {
+        return true;
+      } else if (input_data[b] > input_data[a]) {
+        return false;
+      } else {
+        return a < b;
+      }
+    }
+    const T* input_data;
+  };
+  auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+  const int64_t chunk_size = Eigen::divup(num_cols, num_chunks);
+
+  // The top k of chunk c of row r are candidates[r * num_chunks + c], in no
+  // particular order.
+  std::vector<std::vector<Tidx>> candidates(num_rows * num_chunks);
+  auto SelectChunks = [&](int64_t start_chunk, int64_t limit_chunk) {
+    for (int64_t i = start_chunk; i < limit_chunk; ++i) {
+      const int64_t b = i / num_chunks;
+      const int64_t begin = (i % num_chunks) * chunk_size;
+      const int64_t end = std::min(num_cols, begin + chunk_size);
+      gtl::TopN<Tidx, StableGreater> filter(k, StableGreater{&input(b, 0)});
+      filter.reserve(end - begin);
+      for (int64_t c = begin; c < end; ++c) {
+        filter.push(static_cast<Tidx>(c));
+      }
+      candidates[i].assign(filter.unsorted_begin(), filter.unsorted_end());
+    }
+  };
+  Shard(worker_threads.num_threads, worker_threads.workers,
+        num_rows * num_chunks, static_cast<int64_t>(chunk_size * cmp_cost),
+        SelectChunks);
+
+  auto MergeChunks = [&](int64_t start_batch, int64_t limit_batch) {
+    std::vector<Tidx> merged;
+    for (int64_t b = start_batch; b < limit_batch; ++b) {
+      merged.clear();
+      for (int64_t i = b * num_chunks; i < (b + 1) * num_chunks; ++i) {
+        merged.insert(merged.end(), candidates[i].begin(), candidates[i].end());
+      }
+      const StableGreater comp{&input(b, 0)};
+      std::nth_element(merged.begin(), merged.begin() + (k - 1), merged.end(),
+                       comp);
+      if (sorted) std::sort(merged.begin(), merged.begin() + k, comp);
+      std::copy(merged.begin(), merged.begin() + k, &indices(b, 0));
+      std::transform(&indices(b, 0), &indices(b, k), &values(b, 0),
+                     [b, &input](const Tidx loc) { return input(b, loc); });
+    }
+  };
+  Shard(worker_threads.num_threads, worker_threads.workers, num_rows,
+        static_cast<int64_t>(num_chunks * k * cmp_cost), MergeChunks);
+}
+
 template <typename T, typename Tidx>
 struct TopKFunctor<CPUDevice, T, Tidx> {
   static EIGEN_ALWAYS_INLINE Status Compute(
@@ -161,6 +243,20 @@ struct TopKFunctor<CPUDevice, T, Tidx> {
       return OkStatus();
     }
 
+    // Guesstimate of the cost of a comparison.
+    const double cmp_cost = 3 * Eigen::TensorOpCost::AddCost<Tidx>() +
+                            Eigen::TensorOpCost::AddCost<T>();
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+
+    // With fewer rows than threads, also split the long rows.
+    const int64_t num_chunks = NumTopKChunksPerRow(
+        num_rows, num_cols, k, worker_threads.num_threads);
+    if (num_chunks > 1) {
+      ChunkedRowsTopK<T, Tidx>(context, sorted, k, input, num_rows, num_cols,
+                               num_chunks, cmp_cost, values, indices);
+      return OkStatus();
+    }
+
     auto SortIndices = [&](int64_t start_batch, int64_t limit_batch) {
       for (int32_t b = start_batch; b < limit_batch; ++b) {
         const T* input_data = &input(b, 0);
@@ -235,8 +331,6 @@ struct TopKFunctor<CPUDevice, T, Tidx> {
 
     // Guesstimate of cost; 4*N*log(K) where N == num_cols.
     // If K == N, assume the cost is N*log(K + 1).
-    const double cmp_cost = 3 * Eigen::TensorOpCost::AddCost<Tidx>() +
-                            Eigen::TensorOpCost::AddCost<T>();
     const double base_cost =
         cmp_cost *
         static_cast<double>(num_cols *
@@ -247,7 +341,6 @@ struct TopKFunctor<CPUDevice, T, Tidx> {
     const int64_t final_cost = (total_cost >= static_cast<double>(kint64max))
                                    ? kint64max
                                    : static_cast<int64_t>(total_cost);
-    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
     Shard(worker_threads.num_threads, worker_threads.workers, num_rows,
           final_cost, SortIndices);
 
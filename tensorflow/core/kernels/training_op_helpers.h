@@ -103,6 +103,14 @@ struct VariableInputLockHolder {
         locks_(std::move(other.locks_)),
         shared_locks_(std::move(other.shared_locks_)) {}
 
+  // Records that the locked resource variables have been updated. Must be
+  // called after a successful update, before the locks are released.
+  void MarkUpdated() {
+    for (Var* var : vars_) {
+      var->MarkUpdated();
+    }
+  }
+
   ~VariableInputLockHolder() {
     // Release the locks before unreffing the Vars, because each lock
     // is potentially borrowed from a Var in vars_.
@@ -991,6 +991,7 @@ class ApplyGradientDescentOp : public OpKernel {
     functor::ApplyGradientDescent<Device, T>()(
         device, var.flat<T>(), alpha.scalar<T>(), delta.flat<T>());
 
+    locks.MarkUpdated();
     MaybeForwardRefInputToRefOutput(ctx, 0, 0);
   }
 
@@ -1054,6 +1055,8 @@ class ApplyAdadeltaOp : public OpKernel {
     DoValidate(ctx);
     if (!ctx->status().ok()) return;
     DoCompute(ctx);
+    if (!ctx->status().ok()) return;
+    locks.MarkUpdated();
     MaybeForwardRefInputToRefOutput(ctx, 0, 0);
   }
 
@@ -1197,6 +1200,7 @@ class SparseApplyAdadeltaOp : public OpKernel {
     auto locks = MaybeLockVariableInputMutexesInOrder<Device, T>(
         ctx, use_exclusive_lock_, sparse, {0, 1, 2});
     DoCompute(ctx);
+    if (ctx->status().ok()) locks.MarkUpdated();
   }
 
   void DoCompute(OpKernelContext* ctx) {
@@ -1400,6 +1404,7 @@ class ApplyProximalGradientDescentOp : public OpKernel {
         device, var.flat<T>(), alpha.scalar<T>(), l1.scalar<T>(),
         l2.scalar<T>(), delta.flat<T>());
 
+    locks.MarkUpdated();
     MaybeForwardRefInputToRefOutput(ctx, 0, 0);
   }
 
@@ -1544,6 +1549,7 @@ class SparseApplyProximalGradientDescentOp : public OpKernel {
       }
     }
 
+    locks.MarkUpdated();
     MaybeForwardRefInputToRefOutput(ctx, 0, 0);
   }
 
@@ -1616,6 +1622,7 @@ class ApplyAdagradOp : public OpKernel {
                                        lr.scalar<T>(), grad.flat<T>(),
                                        update_slots_);
 
+    locks.MarkUpdated();
     MaybeForwardRefInputToRefOutput(ctx, 0, 0);
   }
 
@@ -1717,6 +1724,7 @@ class ApplyAdagradV2Op : public OpKernel {
                                          lr.scalar<T>(), epsilon.scalar<T>(),
                                          grad.flat<T>(), update_slots_);
 
+    locks.MarkUpdated();
     MaybeForwardRefInputToRefOutput(ctx, 0, 0);
   }
 
@@ -1833,6 +1841,7 @@ class ApplyProximalAdagradOp : public OpKernel {
         device, var.flat<T>(), accum.flat<T>(), lr.scalar<T>(), l1.scalar<T>(),
         l2.scalar<T>(), grad.flat<T>());
 
+    locks.MarkUpdated();
     MaybeForwardRefInputToRefOutput(ctx, 0, 0);
   }
 
@@ -1947,6 +1956,7 @@ class SparseApplyAdagradOp : public OpKernel {
                  lr.scalar<T>(), lr.scalar<T>(), grad.flat_outer_dims<T>(),
                  indices.vec<Tindex>(), inner_dim, update_slots_));
 
+    locks.MarkUpdated();
     MaybeForwardRefInputToRefOutput(ctx, 0, 0);
   }
 
@@ -2080,6 +2090,7 @@ class SparseApplyAdagradV2Op : public OpKernel {
                  lr.scalar<T>(), epsilon.scalar<T>(), grad.flat_outer_dims<T>(),
                  indices.vec<Tindex>(), inner_dim, update_slots_));
 
+    locks.MarkUpdated();
     MaybeForwardRefInputToRefOutput(ctx, 0, 0);
   }
 
@@ -2228,6 +2239,7 @@ class SparseApplyProximalAdagradOp : public OpKernel {
                  lr.scalar<T>(), l1.scalar<T>(), l2.scalar<T>(),
                  grad.flat_outer_dims<T>(), indices.vec<Tindex>(), inner_dim));
 
+    locks.MarkUpdated();
     MaybeForwardRefInputToRefOutput(ctx, 0, 0);
   }
 
@@ -2362,6 +2374,7 @@ class ApplyAdagradDAOp : public OpKernel {
         global_step.scalar<int64_t>()(), l1.scalar<T>(), l2.scalar<T>(),
         grad.flat<T>());
 
+    locks.MarkUpdated();
     MaybeForwardRefInputToRefOutput(ctx, 0, 0);
   }
 
@@ -2557,6 +2570,7 @@ class SparseApplyAdagradDAOp : public OpKernel {
       }
     }
 
+    locks.MarkUpdated();
     MaybeForwardRefInputToRefOutput(ctx, 0, 0);
   }
 
@@ -2689,6 +2703,7 @@ class ApplyFtrlOp : public OpKernel {
                                       l2.scalar<T>(), lr_power.scalar<T>());
     }
 
+    locks.MarkUpdated();
     MaybeForwardRefInputToRefOutput(ctx, 0, 0);
   }
 
@@ -2930,6 +2945,7 @@ class SparseApplyFtrlOp : public OpKernel {
                  lr_power.scalar<T>(), grad.flat_outer_dims<T>(), indices_vec,
                  inner_dim, multiply_linear_by_lr_));
 
+    locks.MarkUpdated();
     MaybeForwardRefInputToRefOutput(ctx, 0, 0);
   }
 
@@ -3110,6 +3126,7 @@ class ApplyMomentumOp : public OpKernel {
     functor::ApplyMomentum<Device, T>()(device, var.flat<T>(), accum.flat<T>(),
                                         lr.scalar<T>(), grad.flat<T>(),
                                         momentum.scalar<T>(), use_nesterov_);
+    locks.MarkUpdated();
     MaybeForwardRefInputToRefOutput(ctx, 0, 0);
   }
 
@@ -3250,6 +3267,7 @@ class SparseApplyMomentumOp : public OpKernel {
       }
     }
 
+    locks.MarkUpdated();
     MaybeForwardRefInputToRefOutput(ctx, 0, 0);
   }
 
@@ -3331,6 +3349,7 @@ class ApplyKerasMomentumOp : public OpKernel {
     functor::ApplyKerasMomentum<Device, T>()(
         device, var.flat<T>(), accum.flat<T>(), lr.scalar<T>(), grad.flat<T>(),
         momentum.scalar<T>(), use_nesterov_);
+    locks.MarkUpdated();
     MaybeForwardRefInputToRefOutput(ctx, 0, 0);
   }
 
@@ -3453,6 +3472,7 @@ class SparseApplyKerasMomentumOp : public OpKernel {
             "indices", SliceDebugString(indices.shape(), bad_i), " = ",
             indices_flat(bad_i), " is not in [0, ", var.dim_size(0), ")"));
 
+    locks.MarkUpdated();
     MaybeForwardRefInputToRefOutput(ctx, 0, 0);
   }
 
@@ -3597,6 +3617,7 @@ class ApplyAdamOp : public OpKernel {
         beta1.scalar<T>(), beta2.scalar<T>(), epsilon.scalar<T>(),
         grad.flat<T>(), use_nesterov_);
 
+    locks.MarkUpdated();
     MaybeForwardRefInputToRefOutput(ctx, 0, 0);
   }
 
@@ -3743,6 +3764,7 @@ class ApplyAdamWithAmsgradOp : public OpKernel {
         beta1.scalar<T>(), beta2.scalar<T>(), epsilon.scalar<T>(),
         grad.flat<T>());
 
+    locks.MarkUpdated();
     MaybeForwardRefInputToRefOutput(ctx, 0, 0);
   }
 
@@ -3873,6 +3895,7 @@ class ApplyAdaMaxOp : public OpKernel {
         beta1_power.scalar<T>(), lr.scalar<T>(), beta1.scalar<T>(),
         beta2.scalar<T>(), epsilon.scalar<T>(), grad.flat<T>());
 
+    locks.MarkUpdated();
     MaybeForwardRefInputToRefOutput(ctx, 0, 0);
   }
 
@@ -4001,6 +4024,7 @@ class ApplyRMSPropOp : public OpKernel {
                                        rho.scalar<T>(), momentum.scalar<T>(),
                                        epsilon.scalar<T>(), grad.flat<T>());
 
+    locks.MarkUpdated();
     MaybeForwardRefInputToRefOutput(ctx, 0, 0);
   }
 
@@ -4095,6 +4119,7 @@ class ApplyCenteredRMSPropOp : public OpKernel {
         device, var.flat<T>(), mg.flat<T>(), ms.flat<T>(), mom.flat<T>(),
         lr.scalar<T>(), rho.scalar<T>(), momentum.scalar<T>(),
         epsilon.scalar<T>(), grad.flat<T>());
+    locks.MarkUpdated();
     MaybeForwardRefInputToRefOutput(ctx, 0, 0);
   }
 
@@ -4291,6 +4316,7 @@ class SparseApplyRMSPropOp : public OpKernel {
       }
     }
 
+    locks.MarkUpdated();
     MaybeForwardRefInputToRefOutput(ctx, 0, 0);
   }
 
@@ -4433,6 +4459,7 @@ class SparseApplyCenteredRMSPropOp : public OpKernel {
       }
     }
 
+    locks.MarkUpdated();
     MaybeForwardRefInputToRefOutput(ctx, 0, 0);
   }
 
@@ -4532,6 +4559,7 @@ class ApplyAddSignOp : public OpKernel {
     functor::ApplyAddSign<Device, T>()(
         device, var.flat<T>(), m.flat<T>(), lr.scalar<T>(), alpha.scalar<T>(),
         sign_decay.scalar<T>(), beta.scalar<T>(), grad.flat<T>());
+    locks.MarkUpdated();
     MaybeForwardRefInputToRefOutput(ctx, 0, 0);
   }
 
@@ -4639,6 +4667,7 @@ class ApplyPowerSignOp : public OpKernel {
     functor::ApplyPowerSign<Device, T>()(
         device, var.flat<T>(), m.flat<T>(), lr.scalar<T>(), logbase.scalar<T>(),
         sign_decay.scalar<T>(), beta.scalar<T>(), grad.flat<T>());
+    locks.MarkUpdated();
     MaybeForwardRefInputToRefOutput(ctx, 0, 0);
   }
 
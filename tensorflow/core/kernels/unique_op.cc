@@ -13,9 +13,11 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
 #include <functional>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "tensorflow/core/framework/bounds_check.h"
@@ -26,6 +28,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/hash/hash.h"
 #include "tensorflow/core/platform/bfloat16.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 namespace {
@@ -68,6 +71,134 @@ struct UniqueOpHashMap<bfloat16, TIndex> {
   using map_type = std::unordered_map<bfloat16, TIndex>;
 };
 
+// Inputs with fewer elements than this along the unique axis are uniquified
+// on a single thread.
+constexpr int64_t kParallelUniqueMinSize = 1 << 16;
+
+// Uniquifies the keys `key(0), ..., key(n - 1)` on the worker threads. The
+// keys are partitioned by hash, so that equal keys fall in the same partition
+// and each partition is deduplicated by one thread with a copy of `empty_map`.
+//
+// Sets `idx(i)` to the index of the unique key equal to `key(i)`, where the
+// unique keys are numbered in order of first occurrence, as when inserting the
+// keys in order in a single map. Returns the position of the first occurrence
+// of each unique key in `unique_positions`, and its number of occurrences in
+// `counts` unless it is null.
+template <typename TIndex, typename Map, typename KeyFn>
+void ParallelUnique(const DeviceBase::CpuWorkerThreads& worker_threads,
+                    int64_t n, const Map& empty_map, KeyFn key,
+                    typename TTypes<TIndex>::Vec idx,
+                    std::vector<int64_t>* unique_positions,
+                    std::vector<TIndex>* counts) {
+  const int num_partitions = worker_threads.num_threads;
+  const int64_t chunk_size = (n + num_partitions - 1) / num_partitions;
+  const int num_chunks = (n + chunk_size - 1) / chunk_size;
+  const int64_t kCostPerKey = 100;
+  auto for_each_chunk = [&](int64_t cost_per_key, auto fn) {
+    Shard(worker_threads.num_threads, worker_threads.workers, num_chunks,
+          chunk_size * cost_per_key, [&](int64_t begin, int64_t end) {
+            for (int64_t c = begin; c < end; ++c) {
+              fn(c, c * chunk_size, std::min(n, (c + 1) * chunk_size));
+            }
+          });
+  };
+
+  // Assigns each key to a partition, and counts the keys of each partition in
+  // each chunk of the input. The hash of the map is multiplied by a Fibonacci
+  // constant and its high bits are used, so that the partitions and the maps
+  // do not depend on the same bits of the hash.
+  const auto hasher = empty_map.hash_function();
+  std::vector<int> partitions(n);
+  std::vector<int64_t> offsets(num_chunks * num_partitions, 0);
+  for_each_chunk(kCostPerKey, [&](int64_t c, int64_t begin, int64_t end) {
+    int64_t* chunk_offsets = &offsets[c * num_partitions];
+    for (int64_t i = begin; i < end; ++i) {
+      const uint64 h =
+          static_cast<uint64>(hasher(key(i))) * 0x9E3779B97F4A7C15ULL;
+      partitions[i] = static_cast<int>(((h >> 32) * num_partitions) >> 32);
+      ++chunk_offsets[partitions[i]];
+    }
+  });
+
+  // Lays out the positions of the keys grouped by partition, in increasing
+  // order within each partition.
+  std::vector<int64_t> partition_starts(num_partitions + 1);
+  int64_t offset = 0;
+  for (int p = 0; p < num_partitions; ++p) {
+    partition_starts[p] = offset;
+    for (int c = 0; c < num_chunks; ++c) {
+      const int64_t size = offsets[c * num_partitions + p];
+      offsets[c * num_partitions + p] = offset;
+      offset += size;
+    }
+  }
+  partition_starts[num_partitions] = n;
+  std::vector<int64_t> positions(n);
+  for_each_chunk(1, [&](int64_t c, int64_t begin, int64_t end) {
+    int64_t* chunk_offsets = &offsets[c * num_partitions];
+    for (int64_t i = begin; i < end; ++i) {
+      positions[chunk_offsets[partitions[i]]++] = i;
+    }
+  });
+
+  // Deduplicates each partition, numbering its unique keys locally and
+  // marking their first occurrences.
+  std::vector<uint8> is_first(n, 0);
+  std::vector<std::vector<TIndex>> global_indices(num_partitions);
+  std::vector<std::vector<TIndex>> local_counts(num_partitions);
+  Shard(worker_threads.num_threads, worker_threads.workers, num_partitions,
+        chunk_size * kCostPerKey * 2, [&](int64_t begin, int64_t end) {
+          for (int64_t p = begin; p < end; ++p) {
+            Map uniq(empty_map);
+            uniq.reserve(2 * (partition_starts[p + 1] - partition_starts[p]));
+            std::vector<TIndex>& partition_counts = local_counts[p];
+            for (int64_t k = partition_starts[p], j = 0;
+                 k < partition_starts[p + 1]; ++k) {
+              const int64_t i = positions[k];
+              auto it = uniq.emplace(key(i), j);
+              idx(i) = it.first->second;
+              if (it.second) {
+                is_first[i] = 1;
+                ++j;
+                if (counts != nullptr) partition_counts.push_back(0);
+              }
+              if (counts != nullptr) ++partition_counts[idx(i)];
+            }
+            global_indices[p].resize(uniq.size());
+          }
+        });
+
+  // Numbers the unique keys in order of their first occurrence.
+  std::vector<int64_t> chunk_starts(num_chunks + 1, 0);
+  for_each_chunk(1, [&](int64_t c, int64_t begin, int64_t end) {
+    chunk_starts[c + 1] =
+        std::count(is_first.begin() + begin, is_first.begin() + end, 1);
+  });
+  for (int c = 0; c < num_chunks; ++c) chunk_starts[c + 1] += chunk_starts[c];
+  unique_positions->resize(chunk_starts[num_chunks]);
+  for_each_chunk(1, [&](int64_t c, int64_t begin, int64_t end) {
+    for (int64_t i = begin, g = chunk_starts[c]; i < end; ++i) {
+      if (is_first[i]) {
+        global_indices[partitions[i]][idx(i)] = g;
+        (*unique_positions)[g++] = i;
+      }
+    }
+  });
+  for_each_chunk(2, [&](int64_t c, int64_t begin, int64_t end) {
+    for (int64_t i = begin; i < end; ++i) {
+      idx(i) = global_indices[partitions[i]][idx(i)];
+    }
+  });
+  if (counts != nullptr) {
+    counts->resize(unique_positions->size());
+    for (int p = 0; p < num_partitions; ++p) {
+      for (int64_t u = 0; u < local_counts[p].size(); ++u) {
+        (*counts)[global_indices[p][u]] = local_counts[p][u];
+      }
+    }
+  }
+}
+
 // `UniqueOp` computes the unique elements in the input tensor.
 //
 // * `T` is the element type.
@@ -142,8 +273,37 @@ class UniqueOp : public OpKernel {
                                 1, TensorShape({new_sizes[1]}), &idx));
     auto idx_vec = idx->template vec<TIndex>();
 
+    // Large inputs are uniquified by ParallelUnique, which also counts the
+    // unique elements for UniqueWithCounts.
+    const DeviceBase::CpuWorkerThreads& worker_threads =
+        *context->device()->tensorflow_cpu_worker_threads();
+    const bool parallel = worker_threads.num_threads > 1 &&
+                          new_sizes[1] >= kParallelUniqueMinSize;
+    std::vector<int64_t> unique_positions;
+    std::vector<TIndex> counts;
+    std::vector<TIndex>* counts_ptr = num_outputs() > 2 ? &counts : nullptr;
+
     int64_t uniq_size;
-    if (new_sizes[0] == 1 && new_sizes[2] == 1) {
+    if (new_sizes[0] == 1 && new_sizes[2] == 1 && parallel) {
+      using Map = typename UniqueOpHashMap<T, TIndex>::map_type;
+      auto Tin = input.flat<T>();
+      ParallelUnique<TIndex>(
+          worker_threads, Tin.size(), Map(),
+          [&Tin](int64_t i) { return typename Map::key_type(Tin(i)); },
+          idx_vec, &unique_positions, counts_ptr);
+
+      uniq_size = static_cast<int64_t>(unique_positions.size());
+      TensorShape output_shape(input.shape());
+      output_shape.set_dim(axis, uniq_size);
+      Tensor* output = nullptr;
+      OP_REQUIRES_OK(context,
+                     context->allocate_output(0, output_shape, &output));
+      auto Tout = output->flat<T>();
+
+      for (int64_t g = 0; g < uniq_size; ++g) {
+        Tout(g) = Tin(unique_positions[g]);
+      }
+    } else if (new_sizes[0] == 1 && new_sizes[2] == 1) {
       // Specialized and faster implementation when unique is run over single
       // elements. Here we put T directly into the map rather than ints pointing
       // to them as in the general case.
@@ -201,17 +361,25 @@ class UniqueOp : public OpKernel {
                           decltype(equal_to_fn)>
           uniq(0, hash_fn, equal_to_fn);
 
-      uniq.reserve(2 * Tin.dimension(1));
+      if (parallel) {
+        ParallelUnique<TIndex>(
+            worker_threads, Tin.dimension(1), uniq,
+            [](int64_t i) { return i; }, idx_vec, &unique_positions,
+            counts_ptr);
+        uniq_size = static_cast<int64_t>(unique_positions.size());
+      } else {
+        uniq.reserve(2 * Tin.dimension(1));
 
-      for (int64_t i = 0, j = 0; i < Tin.dimension(1); ++i) {
-        auto it = uniq.emplace(i, j);
-        idx_vec(i) = it.first->second;
-        if (it.second) {
-          ++j;
+        for (int64_t i = 0, j = 0; i < Tin.dimension(1); ++i) {
+          auto it = uniq.emplace(i, j);
+          idx_vec(i) = it.first->second;
+          if (it.second) {
+            ++j;
+          }
         }
+        uniq_size = static_cast<int64_t>(uniq.size());
       }
 
-      uniq_size = static_cast<int64_t>(uniq.size());
       new_sizes[1] = uniq_size;
       TensorShape output_shape(input.shape());
       output_shape.set_dim(axis, uniq_size);
@@ -220,12 +388,23 @@ class UniqueOp : public OpKernel {
                      context->allocate_output(0, output_shape, &output));
       auto Tout = output->shaped<T, 3>(new_sizes);
 
-      for (auto it : uniq) {
-        Tout.chip(it.second, 1) = Tin.chip(it.first, 1);
+      if (parallel) {
+        for (int64_t g = 0; g < uniq_size; ++g) {
+          Tout.chip(g, 1) = Tin.chip(unique_positions[g], 1);
+        }
+      } else {
+        for (auto it : uniq) {
+          Tout.chip(it.second, 1) = Tin.chip(it.first, 1);
+        }
       }
     }
 
-    if (num_outputs() > 2) {
+    if (num_outputs() > 2 && parallel) {
+      Tensor* output = nullptr;
+      OP_REQUIRES_OK(context, context->allocate_output(
+                                  2, TensorShape({uniq_size}), &output));
+      std::copy(counts.begin(), counts.end(), output->vec<TIndex>().data());
+    } else if (num_outputs() > 2) {
       Tensor* output = nullptr;
       OP_REQUIRES_OK(context, context->allocate_output(
                                   2, TensorShape({uniq_size}), &output));
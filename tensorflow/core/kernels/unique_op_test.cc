@@ -15,11 +15,16 @@ limitations under the License.
 
 #include <functional>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 #include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/framework/tensor_shape.pb.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/types.pb.h"
 #include "tensorflow/core/graph/algorithm.h"
@@ -28,6 +33,7 @@ limitations under the License.
 #include "tensorflow/core/kernels/ops_testutil.h"
 #include "tensorflow/core/kernels/ops_util.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/strcat.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
 
@@ -64,6 +70,101 @@ TensorProto GetRandomInt32TensorProtoWithRepeat(int dim, int repeat,
   return tensor_proto;
 }
 
+// Inputs large enough to be uniquified on several threads.
+constexpr int kLargeSize = 1 << 18;
+
+class UniqueOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(const string& op, DataType dtype) {
+    NodeDefBuilder builder("op", op);
+    builder.Input(FakeInput(dtype));
+    if (op == "UniqueV2") builder.Input(FakeInput(DT_INT64));
+    TF_ASSERT_OK(builder.Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+};
+
+// Computes the expected outputs of UniqueWithCounts for `values`.
+template <typename T>
+void ExpectUniqueWithCounts(const std::vector<T>& values, Tensor* y,
+                            Tensor* idx, Tensor* count) {
+  std::unordered_map<T, int32> uniq;
+  std::vector<T> y_values;
+  std::vector<int32> idx_values;
+  std::vector<int32> count_values;
+  for (const T& value : values) {
+    auto it = uniq.emplace(value, y_values.size());
+    if (it.second) {
+      y_values.push_back(value);
+      count_values.push_back(0);
+    }
+    idx_values.push_back(it.first->second);
+    ++count_values[it.first->second];
+  }
+  *y = test::AsTensor<T>(y_values);
+  *idx = test::AsTensor<int32>(idx_values);
+  *count = test::AsTensor<int32>(count_values);
+}
+
+TEST_F(UniqueOpTest, LargeInputWithCounts) {
+  MakeOp("UniqueWithCounts", DT_INT64);
+  std::vector<int64_t> values(kLargeSize);
+  for (int i = 0; i < kLargeSize; ++i) {
+    values[i] = (static_cast<int64_t>(i) * 7919) % 10007 - 5000;
+  }
+  AddInputFromArray<int64_t>(TensorShape({kLargeSize}), values);
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor y, idx, count;
+  ExpectUniqueWithCounts(values, &y, &idx, &count);
+  test::ExpectTensorEqual<int64_t>(y, *GetOutput(0));
+  test::ExpectTensorEqual<int32>(idx, *GetOutput(1));
+  test::ExpectTensorEqual<int32>(count, *GetOutput(2));
+}
+
+TEST_F(UniqueOpTest, LargeStringInput) {
+  MakeOp("Unique", DT_STRING);
+  std::vector<tstring> values(kLargeSize);
+  for (int i = 0; i < kLargeSize; ++i) {
+    values[i] = strings::StrCat("feature_", (i * 31) % 50000);
+  }
+  AddInputFromArray<tstring>(TensorShape({kLargeSize}), values);
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor y, idx, count;
+  ExpectUniqueWithCounts(values, &y, &idx, &count);
+  test::ExpectTensorEqual<tstring>(y, *GetOutput(0));
+  test::ExpectTensorEqual<int32>(idx, *GetOutput(1));
+}
+
+TEST_F(UniqueOpTest, LargeInputAlongAxis) {
+  MakeOp("UniqueV2", DT_INT32);
+  // Column i of the input is {i % 1000, i % 7}, so columns i and i + 7000
+  // are equal.
+  constexpr int kNumUnique = 7000;
+  std::vector<int32> values(2 * kLargeSize);
+  for (int i = 0; i < kLargeSize; ++i) {
+    values[i] = i % 1000;
+    values[kLargeSize + i] = i % 7;
+  }
+  AddInputFromArray<int32>(TensorShape({2, kLargeSize}), values);
+  AddInputFromArray<int64_t>(TensorShape({1}), {1});
+  TF_ASSERT_OK(RunOpKernel());
+
+  std::vector<int32> y_values(2 * kNumUnique);
+  std::vector<int32> idx_values(kLargeSize);
+  for (int i = 0; i < kNumUnique; ++i) {
+    y_values[i] = i % 1000;
+    y_values[kNumUnique + i] = i % 7;
+  }
+  for (int i = 0; i < kLargeSize; ++i) idx_values[i] = i % kNumUnique;
+  test::ExpectTensorEqual<int32>(
+      test::AsTensor<int32>(y_values, TensorShape({2, kNumUnique})),
+      *GetOutput(0));
+  test::ExpectTensorEqual<int32>(test::AsTensor<int32>(idx_values),
+                                 *GetOutput(1));
+}
+
 void BM_Unique_INT32(::testing::benchmark::State& state) {
   const int dim = state.range(0);
   const int max_int = state.range(1);
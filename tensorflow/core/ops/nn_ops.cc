@@ -260,6 +260,70 @@ Do not invoke this operator directly in Python. A fusion optimization is
 expected to create these operators.
 )doc");
 
+REGISTER_OP("_FusedLayerNorm")
+    .Input("x: T")
+    .Input("scale: T")
+    .Input("offset: T")
+    .Output("y: T")
+    .Attr("T: {float}")
+    .Attr("epsilon: float = 0.001")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle x;
+      TF_RETURN_IF_ERROR(c->WithRankAtLeast(c->input(0), 1, &x));
+      DimensionHandle depth = c->Dim(x, -1);
+      for (int i = 1; i <= 2; ++i) {
+        ShapeHandle vec;
+        TF_RETURN_IF_ERROR(c->WithRank(c->input(i), 1, &vec));
+        TF_RETURN_IF_ERROR(c->Merge(depth, c->Dim(vec, 0), &depth));
+      }
+      ShapeHandle y;
+      TF_RETURN_IF_ERROR(c->ReplaceDim(x, -1, depth, &y));
+      c->set_output(0, y);
+      return OkStatus();
+    })
+    .Doc(R"doc(
+Internal LayerNorm operation: reserved for internal use.
+
+Normalizes `x` over its innermost dimension, then scales and offsets it:
+  y = (x - mean(x)) * rsqrt(variance(x) + epsilon) * scale + offset
+
+Do not invoke this operator directly in Python. A fusion optimization is
+expected to create these operators.
+)doc");
+
+REGISTER_OP("_FusedMaskedSoftmaxAttention")
+    .Input("query: T")
+    .Input("key: T")
+    .Input("value: T")
+    .Input("mask: T")
+    .Output("output: T")
+    .Attr("T: {float}")
+    .Attr("scale: float = 1.0")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle query, key, value;
+      TF_RETURN_IF_ERROR(c->WithRankAtLeast(c->input(0), 2, &query));
+      TF_RETURN_IF_ERROR(c->WithRankAtLeast(c->input(1), 2, &key));
+      TF_RETURN_IF_ERROR(c->WithRankAtLeast(c->input(2), 2, &value));
+      DimensionHandle unused;
+      TF_RETURN_IF_ERROR(c->Merge(c->Dim(query, -1), c->Dim(key, -1), &unused));
+      TF_RETURN_IF_ERROR(c->Merge(c->Dim(key, -2), c->Dim(value, -2), &unused));
+      ShapeHandle output;
+      TF_RETURN_IF_ERROR(c->ReplaceDim(query, -1, c->Dim(value, -1), &output));
+      c->set_output(0, output);
+      return OkStatus();
+    })
+    .Doc(R"doc(
+Internal scaled dot-product attention operation: reserved for internal use.
+
+Computes BatchMatMul(Softmax(BatchMatMul(query, key, adj_y=true) * scale +
+mask), value) one block of queries at a time, without materializing the
+attention scores. `query`, `key` and `value` have the same batch dimensions and
+`mask` is broadcastable to the shape of the scores.
+
+Do not invoke this operator directly in Python. A fusion optimization is
+expected to create these operators.
+)doc");
+
 REGISTER_OP("FusedBatchNormGrad")
     .Input("y_backprop: T")
     .Input("x: T")
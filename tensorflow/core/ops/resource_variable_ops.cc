@@ -318,6 +318,186 @@ REGISTER_OP("ResourceGatherNd")
     .Attr("Tindices: {int32,int64}")
     .SetShapeFn(shape_inference::GatherNdShape);
 
+REGISTER_OP("_ResourceSparseSegmentReduction")
+    .Input("resource: resource")
+    .Input("ids: Tids")
+    .Input("indices: Tidx")
+    .Input("segment_ids: Tsegmentids")
+    .Input("num_segments: num_num_segments * Tnumsegments")
+    .Input("weights: num_weights * dtype")
+    .Output("output: dtype")
+    .Attr("dtype: {bfloat16, half, float, double}")
+    .Attr("combiner: {'sum', 'mean', 'sqrtn'} = 'sum'")
+    .Attr("num_num_segments: int >= 0 = 0")
+    .Attr("num_weights: int >= 0 = 0")
+    .Attr("Tids: {int32, int64} = DT_INT32")
+    .Attr("Tidx: {int32, int64} = DT_INT32")
+    .Attr("Tsegmentids: {int32, int64} = DT_INT32")
+    .Attr("Tnumsegments: {int32, int64} = DT_INT32")
+    .SetShapeFn([](InferenceContext* c) {
+      std::vector<ShapeAndType> handle_shape_and_type;
+      TF_RETURN_IF_ERROR(shape_inference::ValidateVariableResourceHandle(
+          c, &handle_shape_and_type));
+      ShapeHandle unused;
+      for (int i = 1; i <= 3; ++i) {
+        TF_RETURN_IF_ERROR(c->WithRank(c->input(i), 1, &unused));
+      }
+      ShapeHandle params_shape;
+      TF_RETURN_IF_ERROR(c->WithRankAtLeast(handle_shape_and_type[0].shape, 1,
+                                            &params_shape));
+      ShapeHandle row_shape;
+      TF_RETURN_IF_ERROR(c->Subshape(params_shape, 1, &row_shape));
+
+      int num_num_segments;
+      TF_RETURN_IF_ERROR(c->GetAttr("num_num_segments", &num_num_segments));
+      shape_inference::DimensionHandle num_segments = c->UnknownDim();
+      if (num_num_segments > 0) {
+        TF_RETURN_IF_ERROR(c->WithRank(c->input(4), 0, &unused));
+        TF_RETURN_IF_ERROR(c->MakeDimForScalarInput(4, &num_segments));
+      }
+      ShapeHandle out;
+      TF_RETURN_IF_ERROR(
+          c->Concatenate(c->Vector(num_segments), row_shape, &out));
+      c->set_output(0, out);
+      return OkStatus();
+    })
+    .Doc(R"doc(
+Internal operation which is a composition of gathering rows of a resource
+variable (ResourceGather) and combining them by segment
+(SparseSegmentSum/Mean/SqrtN[WithNumSegments]): reserved for internal use.
+
+Row `j` of the combination is the row `ids[indices[j]]` of the variable, scaled
+by `weights[j]` if given, and accumulated into the output row `segment_ids[j]`.
+The "mean" and "sqrtn" combiners divide each output row by the sum of the
+weights, or the square root of the sum of their squares, of its rows.
+
+Do not invoke this operator directly in Python. A fusion optimization is
+expected to create these operators.
+)doc");
+
+REGISTER_OP("_ResourceSparseSegmentReductionGrad")
+    .Input("grad: T")
+    .Input("ids: Tids")
+    .Input("indices: Tidx")
+    .Input("segment_ids: Tsegmentids")
+    .Input("weights: num_weights * T")
+    .Output("output: T")
+    .Output("sorted_unique_ids: Tids")
+    .Attr("T: {bfloat16, half, float, double}")
+    .Attr("combiner: {'sum', 'mean', 'sqrtn'} = 'sum'")
+    .Attr("num_weights: int >= 0 = 0")
+    .Attr("Tids: {int32, int64} = DT_INT32")
+    .Attr("Tidx: {int32, int64} = DT_INT32")
+    .Attr("Tsegmentids: {int32, int64} = DT_INT32")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle grad_shape;
+      TF_RETURN_IF_ERROR(c->WithRankAtLeast(c->input(0), 1, &grad_shape));
+      ShapeHandle unused;
+      for (int i = 1; i <= 3; ++i) {
+        TF_RETURN_IF_ERROR(c->WithRank(c->input(i), 1, &unused));
+      }
+      ShapeHandle row_shape;
+      TF_RETURN_IF_ERROR(c->Subshape(grad_shape, 1, &row_shape));
+      ShapeHandle out;
+      TF_RETURN_IF_ERROR(
+          c->Concatenate(c->Vector(c->UnknownDim()), row_shape, &out));
+      c->set_output(0, out);
+      c->set_output(1, c->Vector(c->UnknownDim()));
+      return OkStatus();
+    })
+    .Doc(R"doc(
+Internal operation computing the gradient of _ResourceSparseSegmentReduction
+with respect to its variable, as the rows `output` of the variable rows
+`sorted_unique_ids`: reserved for internal use.
+)doc");
+
+REGISTER_RESOURCE_HANDLE_OP(ResourceGatherPrefetcher);
+
+REGISTER_OP("PrefetchResourceGather")
+    .Input("resource: resource")
+    .Input("indices: Tindices")
+    .Input("prefetcher: resource")
+    .Attr("dtype: type")
+    .Attr("Tindices: {int32,int64}")
+    .Attr("capacity: int >= 1 = 2")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 0, &unused));
+      return OkStatus();
+    });
+
+REGISTER_OP("ResourceGatherPrefetched")
+    .Input("resource: resource")
+    .Input("indices: Tindices")
+    .Input("prefetcher: resource")
+    .Output("output: dtype")
+    .Attr("dtype: type")
+    .Attr("Tindices: {int32,int64}")
+    .SetShapeFn([](InferenceContext* c) {
+      std::vector<ShapeAndType> handle_shape_and_type;
+      TF_RETURN_IF_ERROR(shape_inference::ValidateVariableResourceHandle(
+          c, &handle_shape_and_type));
+      ShapeHandle params_shape;
+      TF_RETURN_IF_ERROR(c->WithRankAtLeast(handle_shape_and_type[0].shape,
+                                            1, &params_shape));
+      ShapeHandle unused;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 0, &unused));
+      ShapeHandle params_subshape;
+      TF_RETURN_IF_ERROR(c->Subshape(params_shape, 1, &params_subshape));
+      ShapeHandle out;
+      TF_RETURN_IF_ERROR(c->Concatenate(c->input(1), params_subshape, &out));
+      c->set_output(0, out);
+      return OkStatus();
+    });
+
+REGISTER_OP("TieredEmbeddingVarHandleOp")
+    .Attr("container: string = ''")
+    .Attr("shared_name: string = ''")
+    .Attr("dtype: {bfloat16, half, float, double}")
+    .Attr("shape: shape")
+    .Attr("cache_rows: int >= 1")
+    .Attr("path: string = ''")
+    .Attr("initializer_minval: float = 0")
+    .Attr("initializer_maxval: float = 0")
+    .Attr("seed: int = 0")
+    .Output("resource: resource")
+    .SetIsStateful()
+    .SetShapeFn([](InferenceContext* c) {
+      c->set_output(0, c->Scalar());
+      DataType t;
+      TF_RETURN_IF_ERROR(c->GetAttr("dtype", &t));
+      PartialTensorShape p;
+      TF_RETURN_IF_ERROR(c->GetAttr("shape", &p));
+      ShapeHandle s;
+      TF_RETURN_IF_ERROR(c->MakeShapeFromPartialTensorShape(p, &s));
+      TF_RETURN_IF_ERROR(c->WithRankAtLeast(s, 1, &s));
+      c->set_output_handle_shapes_and_types(0,
+                                            std::vector<ShapeAndType>{{s, t}});
+      return OkStatus();
+    });
+
+REGISTER_OP("SaveTieredEmbeddingVariable")
+    .Input("resource: resource")
+    .Input("prefix: string")
+    .Input("tensor_name: string")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 0, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 0, &unused));
+      return OkStatus();
+    });
+
+REGISTER_OP("RestoreTieredEmbeddingVariable")
+    .Input("resource: resource")
+    .Input("prefix: string")
+    .Input("tensor_name: string")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 0, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 0, &unused));
+      return OkStatus();
+    });
+
 namespace {
 
 Status ResourceScatterUpdateShape(InferenceContext* c) {
@@ -0,0 +1,333 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/lite/arena_plan.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/lite/simple_memory_arena.h"
+
+namespace tflite {
+namespace {
+
+using Alloc = ArenaAllocWithUsageInterval;
+
+constexpr size_t kOffsetNotAssigned = std::numeric_limits<size_t>::max();
+
+// The search stops after this many placements, or once it has compared this
+// many pairs of allocs, which keeps planning of large subgraphs short.
+constexpr int64_t kMaxSearchSteps = 1000;
+constexpr int64_t kMaxSearchWork = int64_t{1} << 24;
+
+// Serialized plans start with a magic number and a version, followed by the
+// number of allocs and the tensor, size and offset of each alloc, all little
+// endian.
+constexpr char kArenaPlanMagic[] = "TFAP";
+constexpr uint32_t kArenaPlanVersion = 1;
+constexpr size_t kHeaderBytes = 4 + 4 + 4;
+constexpr size_t kEntryBytes = 4 + 8 + 8;
+
+size_t AlignTo(size_t alignment, size_t offset) {
+  return offset % alignment == 0 ? offset
+                                 : offset + (alignment - offset % alignment);
+}
+
+bool UsedAtSameTime(const Alloc& a, const Alloc& b) {
+  return a.first_node <= b.last_node && b.first_node <= a.last_node;
+}
+
+// Places the allocs in `order`, each in the tightest gap left by the allocs
+// placed before it which are used at the same time, or after all of them.
+// Returns the size of the arena.
+size_t PlaceInOrder(size_t alignment, const std::vector<Alloc>& allocs,
+                    const std::vector<int>& order,
+                    std::vector<size_t>* offsets) {
+  offsets->assign(allocs.size(), 0);
+  // Allocs placed so far, ordered by offset.
+  std::vector<int> placed;
+  placed.reserve(order.size());
+  size_t arena_size = 0;
+  for (int i : order) {
+    const size_t size = allocs[i].size;
+    if (size == 0) continue;
+    size_t best_offset = kOffsetNotAssigned;
+    size_t best_offset_fit = kOffsetNotAssigned;
+    size_t current_offset = 0;
+    for (int j : placed) {
+      if (!UsedAtSameTime(allocs[i], allocs[j])) continue;
+      const size_t aligned_current_offset = AlignTo(alignment, current_offset);
+      const size_t offset = (*offsets)[j];
+      if (aligned_current_offset + size <= offset &&
+          offset - aligned_current_offset - size < best_offset_fit) {
+        best_offset = aligned_current_offset;
+        best_offset_fit = offset - aligned_current_offset - size;
+        // A perfect fit is as good as it gets.
+        if (best_offset_fit == 0) break;
+      }
+      current_offset = std::max(current_offset, offset + allocs[j].size);
+    }
+    if (best_offset == kOffsetNotAssigned) {
+      best_offset = AlignTo(alignment, current_offset);
+    }
+    (*offsets)[i] = best_offset;
+    arena_size = std::max(arena_size, best_offset + size);
+    auto insertion_it = std::upper_bound(
+        placed.begin(), placed.end(), best_offset,
+        [offsets](size_t offset, int j) { return offset < (*offsets)[j]; });
+    placed.insert(insertion_it, i);
+  }
+  return arena_size;
+}
+
+// Returns the number of bytes live during each node which is the first node
+// of an alloc, from the largest to the smallest. The number of live bytes only
+// grows at these nodes, so the first one is a lower bound of the arena size.
+std::vector<std::pair<size_t, int32_t>> LiveBytesByNode(
+    const std::vector<Alloc>& allocs) {
+  std::vector<int32_t> nodes;
+  nodes.reserve(allocs.size());
+  for (const Alloc& alloc : allocs) nodes.push_back(alloc.first_node);
+  std::sort(nodes.begin(), nodes.end());
+  nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+
+  std::vector<std::pair<size_t, int32_t>> live_bytes;
+  live_bytes.reserve(nodes.size());
+  for (int32_t node : nodes) {
+    size_t bytes = 0;
+    for (const Alloc& alloc : allocs) {
+      if (alloc.first_node <= node && node <= alloc.last_node) {
+        bytes += alloc.size;
+      }
+    }
+    live_bytes.emplace_back(bytes, node);
+  }
+  std::sort(live_bytes.begin(), live_bytes.end(),
+            [](const std::pair<size_t, int32_t>& a,
+               const std::pair<size_t, int32_t>& b) {
+              if (a.first != b.first) return a.first > b.first;
+              return a.second < b.second;
+            });
+  return live_bytes;
+}
+
+// Largest allocs first. For equal sizes, the alloc used first goes first.
+std::vector<int> OrderBySize(const std::vector<Alloc>& allocs) {
+  std::vector<int> order(allocs.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&allocs](int a, int b) {
+    if (allocs[a].size != allocs[b].size) {
+      return allocs[a].size > allocs[b].size;
+    }
+    return allocs[a].first_node < allocs[b].first_node;
+  });
+  return order;
+}
+
+// Allocs live during the nodes with the most live bytes first, from the
+// largest to the smallest.
+std::vector<int> OrderByBreadth(
+    const std::vector<Alloc>& allocs,
+    const std::vector<std::pair<size_t, int32_t>>& live_bytes) {
+  const std::vector<int> by_size = OrderBySize(allocs);
+  std::vector<bool> ordered(allocs.size(), false);
+  std::vector<int> order;
+  order.reserve(allocs.size());
+  for (const auto& node_live_bytes : live_bytes) {
+    const int32_t node = node_live_bytes.second;
+    for (int i : by_size) {
+      if (!ordered[i] && allocs[i].first_node <= node &&
+          node <= allocs[i].last_node) {
+        ordered[i] = true;
+        order.push_back(i);
+      }
+    }
+  }
+  // Every alloc is live during its first node, so all of them are ordered.
+  return order;
+}
+
+// Allocs in order of their first use, the longest lived first, as in the
+// left-edge algorithm for interval graph colouring.
+std::vector<int> OrderByFirstUse(const std::vector<Alloc>& allocs) {
+  std::vector<int> order(allocs.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&allocs](int a, int b) {
+    if (allocs[a].first_node != allocs[b].first_node) {
+      return allocs[a].first_node < allocs[b].first_node;
+    }
+    if (allocs[a].last_node != allocs[b].last_node) {
+      return allocs[a].last_node > allocs[b].last_node;
+    }
+    return allocs[a].size > allocs[b].size;
+  });
+  return order;
+}
+
+void AppendLittleEndian(uint64_t value, int bytes, std::string* out) {
+  for (int i = 0; i < bytes; ++i) {
+    out->push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+  }
+}
+
+uint64_t ReadLittleEndian(const char* data, int bytes) {
+  uint64_t value = 0;
+  for (int i = 0; i < bytes; ++i) {
+    value |= uint64_t{static_cast<unsigned char>(data[i])} << (8 * i);
+  }
+  return value;
+}
+
+}  // namespace
+
+std::string ArenaPlanMetadataName(int subgraph_index) {
+  return "TFLITE_ARENA_PLAN_" + std::to_string(subgraph_index);
+}
+
+size_t PlanArenaOffsets(size_t alignment, std::vector<Alloc>* allocs) {
+  if (allocs->empty()) return 0;
+  const std::vector<std::pair<size_t, int32_t>> live_bytes =
+      LiveBytesByNode(*allocs);
+  const size_t lower_bound = live_bytes.front().first;
+
+  std::vector<int> best_order;
+  std::vector<size_t> best_offsets;
+  size_t best_size = kOffsetNotAssigned;
+  std::vector<size_t> offsets;
+  for (const std::vector<int>& order :
+       {OrderBySize(*allocs), OrderByBreadth(*allocs, live_bytes),
+        OrderByFirstUse(*allocs)}) {
+    const size_t size = PlaceInOrder(alignment, *allocs, order, &offsets);
+    if (size < best_size) {
+      best_size = size;
+      best_order = order;
+      best_offsets.swap(offsets);
+    }
+  }
+
+  // Look for a better order by swapping pairs of allocs in the best one,
+  // keeping swaps which don't make the arena larger.
+  const int64_t num_allocs = allocs->size();
+  const int64_t num_steps = std::min(
+      kMaxSearchSteps, kMaxSearchWork / (num_allocs * num_allocs));
+  // A fixed seed keeps the plan deterministic.
+  std::minstd_rand random(/*seed=*/num_allocs);
+  std::uniform_int_distribution<int> uniform(0, num_allocs - 1);
+  std::vector<int> order = best_order;
+  for (int64_t step = 0; step < num_steps && best_size > lower_bound;
+       ++step) {
+    const int a = uniform(random);
+    const int b = uniform(random);
+    if (a == b) continue;
+    std::swap(order[a], order[b]);
+    const size_t size = PlaceInOrder(alignment, *allocs, order, &offsets);
+    if (size > best_size) {
+      std::swap(order[a], order[b]);
+    } else if (size < best_size) {
+      best_size = size;
+      best_offsets.swap(offsets);
+    }
+  }
+
+  for (int i = 0; i < num_allocs; ++i) {
+    (*allocs)[i].offset = best_offsets[i];
+  }
+  return best_size;
+}
+
+bool IsValidArenaPlan(size_t alignment, const std::vector<Alloc>& allocs) {
+  std::vector<int> by_offset;
+  by_offset.reserve(allocs.size());
+  for (int i = 0, end = allocs.size(); i < end; ++i) {
+    if (allocs[i].size == 0) continue;
+    // The end of each alloc is compared below, and must not wrap around.
+    if (allocs[i].offset % alignment != 0 ||
+        allocs[i].offset >
+            std::numeric_limits<size_t>::max() - allocs[i].size) {
+      return false;
+    }
+    by_offset.push_back(i);
+  }
+  std::sort(by_offset.begin(), by_offset.end(), [&allocs](int a, int b) {
+    return allocs[a].offset < allocs[b].offset;
+  });
+  for (int i = 0, end = by_offset.size(); i < end; ++i) {
+    const Alloc& alloc = allocs[by_offset[i]];
+    for (int j = i + 1;
+         j < end && allocs[by_offset[j]].offset < alloc.offset + alloc.size;
+         ++j) {
+      if (UsedAtSameTime(alloc, allocs[by_offset[j]])) return false;
+    }
+  }
+  return true;
+}
+
+std::string SerializeArenaPlan(const std::vector<Alloc>& allocs) {
+  std::string serialized(kArenaPlanMagic, 4);
+  serialized.reserve(kHeaderBytes + allocs.size() * kEntryBytes);
+  AppendLittleEndian(kArenaPlanVersion, 4, &serialized);
+  AppendLittleEndian(allocs.size(), 4, &serialized);
+  for (const Alloc& alloc : allocs) {
+    AppendLittleEndian(static_cast<uint32_t>(alloc.tensor), 4, &serialized);
+    AppendLittleEndian(alloc.size, 8, &serialized);
+    AppendLittleEndian(alloc.offset, 8, &serialized);
+  }
+  return serialized;
+}
+
+bool ApplySerializedArenaPlan(const char* data, size_t bytes,
+                              std::vector<Alloc>* allocs) {
+  if (data == nullptr || bytes < kHeaderBytes ||
+      std::string(data, 4) != std::string(kArenaPlanMagic, 4) ||
+      ReadLittleEndian(data + 4, 4) != kArenaPlanVersion) {
+    return false;
+  }
+  const uint64_t num_entries = ReadLittleEndian(data + 8, 4);
+  if (bytes != kHeaderBytes + num_entries * kEntryBytes) return false;
+
+  // Size and offset of each tensor.
+  // NOLINTNEXTLINE - absl::flat_hash_map increases binary size by 106kB.
+  std::unordered_map<int32_t, std::pair<uint64_t, uint64_t>> plan;
+  plan.reserve(num_entries);
+  const char* entry = data + kHeaderBytes;
+  for (uint64_t i = 0; i < num_entries; ++i, entry += kEntryBytes) {
+    plan[static_cast<int32_t>(ReadLittleEndian(entry, 4))] = {
+        ReadLittleEndian(entry + 4, 8), ReadLittleEndian(entry + 12, 8)};
+  }
+  for (Alloc& alloc : *allocs) {
+    if (alloc.size == 0) {
+      alloc.offset = 0;
+      continue;
+    }
+    auto it = plan.find(alloc.tensor);
+    if (it == plan.end() || it->second.first != alloc.size) return false;
+    // The offset comes from the model, and the end of the alloc must not wrap
+    // around.
+    const uint64_t offset = it->second.second;
+    if (offset > std::numeric_limits<size_t>::max() - alloc.size) return false;
+    alloc.offset = offset;
+  }
+  return true;
+}
+
+}  // namespace tflite
@@ -0,0 +1,69 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_ARENA_PLAN_H_
+#define TENSORFLOW_LITE_ARENA_PLAN_H_
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+#include "tensorflow/lite/simple_memory_arena.h"
+
+namespace tflite {
+
+// Offline placement of the tensors of a whole subgraph in an arena.
+//
+// Unlike SimpleMemoryArena::Allocate, which places tensors one at a time as
+// their nodes are planned, the functions below know the size and usage
+// interval of every tensor up front. This allows trying several orders in
+// which to place the tensors and keeping the one with the smallest arena.
+
+// Returns the name of the model metadata entry holding the serialized arena
+// plan of subgraph `subgraph_index`.
+std::string ArenaPlanMetadataName(int subgraph_index);
+
+// Sets the offset of each of `allocs`, whose size and usage interval
+// [first_node, last_node] must be set, such that allocs which are used at the
+// same time don't overlap, and returns the size of the resulting arena.
+// Offsets are multiples of `alignment`.
+//
+// The placement is the best of: greedy by size (largest tensors first),
+// greedy by breadth (tensors of the nodes with the most live bytes first),
+// interval colouring (tensors in order of first use), followed by a bounded
+// search swapping tensors in the best of these orders.
+size_t PlanArenaOffsets(size_t alignment,
+                        std::vector<ArenaAllocWithUsageInterval>* allocs);
+
+// Returns true if the offsets of `allocs` are multiples of `alignment` and
+// allocs which are used at the same time don't overlap.
+bool IsValidArenaPlan(size_t alignment,
+                      const std::vector<ArenaAllocWithUsageInterval>& allocs);
+
+// Serializes the tensor, size and offset of each of `allocs`.
+std::string SerializeArenaPlan(
+    const std::vector<ArenaAllocWithUsageInterval>& allocs);
+
+// Sets the offset of each of `allocs` to the offset of the same tensor in the
+// plan serialized in `data`. Returns false if `data` is malformed or if it
+// doesn't have an alloc of the same size for each of `allocs`, e.g. because
+// the input shapes changed since the plan was serialized. The usage intervals
+// are not serialized, callers should check the result with IsValidArenaPlan.
+bool ApplySerializedArenaPlan(const char* data, size_t bytes,
+                              std::vector<ArenaAllocWithUsageInterval>* allocs);
+
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_ARENA_PLAN_H_
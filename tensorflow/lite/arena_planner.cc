@@ -20,9 +20,11 @@ limitations under the License.
 #include <cstdint>
 #include <limits>
 #include <memory>
+#include <string>
 #include <utility>
 #include <vector>
 
+#include "tensorflow/lite/arena_plan.h"
 #include "tensorflow/lite/builtin_ops.h"
 #include "tensorflow/lite/core/c/common.h"
 #include "tensorflow/lite/graph_info.h"
@@ -38,14 +40,16 @@ constexpr int32_t kScalarTensorBytes = 4;
 ArenaPlanner::ArenaPlanner(TfLiteContext* context,
                            std::unique_ptr<GraphInfo> graph_info,
                            bool preserve_all_tensors, int tensor_alignment,
-                           int subgraph_index)
+                           int subgraph_index, bool optimize_arena_plan)
     : context_(context),
       graph_info_(std::move(graph_info)),
       arena_(kDefaultArenaAlignment, subgraph_index),
       persistent_arena_(kDefaultArenaAlignment, subgraph_index),
       preserve_all_tensors_(preserve_all_tensors),
       tensor_alignment_(tensor_alignment),
-      last_active_node_(kLastActiveNodeUndefined) {}
+      last_active_node_(kLastActiveNodeUndefined),
+      subgraph_index_(subgraph_index),
+      optimize_arena_plan_(optimize_arena_plan) {}
 
 ArenaPlanner::~ArenaPlanner() {
   arena_.ReleaseBuffer();
@@ -299,14 +303,19 @@ TfLiteStatus ArenaPlanner::PlanAllocations() {
   for (size_t i = 0; i < num_execution_nodes; ++i) {
     const TfLiteNode& node = graph_info_->node(i);
 
+    // Tensors of nodes which run concurrently must be live for as long as any
+    // of these nodes runs.
+    const std::pair<size_t, size_t> concurrent_nodes =
+        graph_info_->concurrent_nodes(i);
+
     // First queue output tensors for allocation.
     TfLiteIntArray* node_outputs = node.outputs;
     for (int j = 0; j < node_outputs->size; ++j) {
       int tensor_index = node_outputs->data[j];
       if (tensor_index == kTfLiteOptionalTensor) continue;
       //  Don't allocate output tensors here for shared memory parts.
-      nodes_to_tensors_[i].insert(tensor_index);
-      TF_LITE_ENSURE_STATUS(allocate(i, tensor_index));
+      nodes_to_tensors_[concurrent_nodes.first].insert(tensor_index);
+      TF_LITE_ENSURE_STATUS(allocate(concurrent_nodes.first, tensor_index));
     }
 
     // Then update the ref-counts of the node's inputs, and if necessary queue
@@ -321,7 +330,8 @@ TfLiteStatus ArenaPlanner::PlanAllocations() {
           tensor_index = FindSharedTensor(tensor_index);
           --refcounts[tensor_index];
           if (refcounts[tensor_index] == 0) {
-            TF_LITE_ENSURE_STATUS(deallocate(i, tensor_index));
+            TF_LITE_ENSURE_STATUS(
+                deallocate(concurrent_nodes.second, tensor_index));
           }
         }
       }
@@ -345,13 +355,15 @@ TfLiteStatus ArenaPlanner::ExecuteAllocations(int first_node, int last_node) {
   for (size_t i = first_node;
        i <= static_cast<size_t>(last_node) && i < num_execution_nodes; ++i) {
     const TfLiteNode& node = graph_info_->node(i);
+    const std::pair<size_t, size_t> concurrent_nodes =
+        graph_info_->concurrent_nodes(i);
     TfLiteIntArray* node_temporaries = node.temporaries;
     for (int j = 0; j < node_temporaries->size; ++j) {
       int tensor_index = node_temporaries->data[j];
-      alloc_node_[tensor_index] = i;
-      nodes_to_tensors_[i].insert(tensor_index);
+      alloc_node_[tensor_index] = concurrent_nodes.first;
+      nodes_to_tensors_[concurrent_nodes.first].insert(tensor_index);
       if (!preserve_all_tensors_) {
-        dealloc_node_[tensor_index] = i;
+        dealloc_node_[tensor_index] = concurrent_nodes.second;
       }
     }
   }
@@ -502,6 +514,13 @@ TfLiteStatus ArenaPlanner::CalculateAllocations(
     last_active_node_ = last_node;
     return kTfLiteOk;
   }
+  // Once all the tensors allocated from the first node have known sizes, the
+  // whole arena can be planned at once. Later calls for subsequent nodes, e.g.
+  // after a dynamic tensor was resized, fall back to allocating one tensor at
+  // a time around the planned ones.
+  const bool plan_whole_arena =
+      optimize_arena_plan_ && first_node == 0 && first_node < last_active_node_;
+  std::vector<ArenaAllocWithUsageInterval> whole_arena_allocs;
   if (first_node < last_active_node_) {
     arena_.ResetAllocs();
     last_active_node_ = first_node;
@@ -534,10 +553,19 @@ TfLiteStatus ArenaPlanner::CalculateAllocations(
       }
     }
     if (tensor.allocation_type == kTfLiteArenaRw) {
-      TF_LITE_ENSURE_STATUS(
-          arena_.Allocate(context_, tensor_alignment_, tensor.bytes,
-                          tensor_index, alloc_node_[tensor_index],
-                          dealloc_node_[tensor_index], &allocs_[tensor_index]));
+      if (plan_whole_arena) {
+        ArenaAllocWithUsageInterval alloc;
+        alloc.tensor = tensor_index;
+        alloc.size = tensor.bytes;
+        alloc.first_node = alloc_node_[tensor_index];
+        alloc.last_node = dealloc_node_[tensor_index];
+        whole_arena_allocs.push_back(alloc);
+      } else {
+        TF_LITE_ENSURE_STATUS(arena_.Allocate(
+            context_, tensor_alignment_, tensor.bytes, tensor_index,
+            alloc_node_[tensor_index], dealloc_node_[tensor_index],
+            &allocs_[tensor_index]));
+      }
     }
     // Check allocs_[].size to prevent from reallocation of persistent tensors.
     // Only allocate ArenaRwPersistent tensors which own their buffer.
@@ -552,10 +580,35 @@ TfLiteStatus ArenaPlanner::CalculateAllocations(
       }
     }
   }
+  if (plan_whole_arena) {
+    PlanWholeArena(&whole_arena_allocs);
+    for (const auto& alloc : whole_arena_allocs) {
+      TF_LITE_ENSURE_STATUS(arena_.AllocateAt(
+          context_, tensor_alignment_, alloc.size, alloc.offset, alloc.tensor,
+          alloc.first_node, alloc.last_node, &allocs_[alloc.tensor]));
+    }
+  }
   last_active_node_ = last_node;
   return kTfLiteOk;
 }
 
+void ArenaPlanner::PlanWholeArena(
+    std::vector<ArenaAllocWithUsageInterval>* allocs) {
+  const char* stored_plan = nullptr;
+  size_t stored_plan_bytes = 0;
+  if (context_->GetModelMetadata != nullptr &&
+      context_->GetModelMetadata(
+          context_, ArenaPlanMetadataName(subgraph_index_).c_str(),
+          &stored_plan, &stored_plan_bytes) == kTfLiteOk &&
+      ApplySerializedArenaPlan(stored_plan, stored_plan_bytes, allocs) &&
+      IsValidArenaPlan(tensor_alignment_, *allocs)) {
+    serialized_plan_.assign(stored_plan, stored_plan_bytes);
+    return;
+  }
+  PlanArenaOffsets(tensor_alignment_, allocs);
+  serialized_plan_ = SerializeArenaPlan(*allocs);
+}
+
 bool AreTensorsAllocatedInSameArena(int32_t root_tensor_index,
                                     int32_t tensor_index,
                                     const TfLiteTensor* tensors) {
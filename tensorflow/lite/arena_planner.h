@@ -17,6 +17,7 @@ limitations under the License.
 
 #include <cstdint>
 #include <memory>
+#include <string>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -51,9 +52,12 @@ class ArenaPlanner : public MemoryPlanner {
   // ArenaPlanner is destroyed. The inputs to the graph will not share
   // memory with any other tensor, effectively preserving them until the end
   // of inference.
+  // If `optimize_arena_plan` is true, the non-persistent tensors of the whole
+  // subgraph are placed at once by PlanArenaOffsets, or at the offsets stored
+  // in the model metadata by an earlier run, instead of one node at a time.
   ArenaPlanner(TfLiteContext* context, std::unique_ptr<GraphInfo> graph_info,
                bool preserve_all_tensors, int tensor_alignment,
-               int subgraph_index = 0);
+               int subgraph_index = 0, bool optimize_arena_plan = false);
   ~ArenaPlanner() override;
   ArenaPlanner(const ArenaPlanner&) = delete;
   ArenaPlanner& operator=(const ArenaPlanner&) = delete;
@@ -68,6 +72,7 @@ class ArenaPlanner : public MemoryPlanner {
   void DumpDebugInfo(const std::vector<int>& execution_plan) const override;
   void GetAllocInfo(size_t* arena_size,
                     size_t* arena_persist_size) const override;
+  std::string GetSerializedPlan() const override { return serialized_plan_; }
 
   // Returns the base arena location for a given allocation type.
   std::intptr_t BasePointer(TfLiteAllocationType type);
@@ -104,6 +109,11 @@ class ArenaPlanner : public MemoryPlanner {
   TfLiteStatus CalculateAllocations(int first_node, int last_node,
                                     std::vector<int32_t>* tensors_allocated);
 
+  // Sets the offsets of `allocs`, which hold all the non-persistent tensors
+  // of the subgraph, from the plan stored in the model metadata if it is
+  // still valid, or else by planning the whole arena.
+  void PlanWholeArena(std::vector<ArenaAllocWithUsageInterval>* allocs);
+
   // Assign absolute memory location to a tensor, based on its relative
   // position inside the corresponding arena buffer.
   TfLiteStatus ResolveTensorAllocation(int32_t tensor_index,
@@ -164,6 +174,15 @@ class ArenaPlanner : public MemoryPlanner {
 
   // Store number of references to each tensor.
   std::vector<int> refcounts_;
+
+  int subgraph_index_;
+
+  // If true, the non-persistent arena is planned for the whole subgraph at
+  // once when allocations are executed from the first node.
+  bool optimize_arena_plan_;
+
+  // The last whole-subgraph plan, see GetSerializedPlan.
+  std::string serialized_plan_;
 };
 
 }  // namespace tflite
@@ -19,13 +19,16 @@ limitations under the License.
 #include <cstddef>
 #include <cstdint>
 #include <initializer_list>
+#include <limits>
 #include <memory>
 #include <set>
+#include <string>
 #include <utility>
 #include <vector>
 
 #include <gtest/gtest.h>
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/lite/arena_plan.h"
 #include "tensorflow/lite/builtin_ops.h"
 #include "tensorflow/lite/core/c/common.h"
 #include "tensorflow/lite/graph_info.h"
@@ -204,14 +207,30 @@ void ReportError(TfLiteContext* context, const char* format, ...) {
   LOG(INFO) << temp_buffer;
 }
 
+// Serialized arena plan of subgraph 0 in the model metadata, if not empty.
+std::string* gArenaPlanMetadata = new std::string;
+
+TfLiteStatus GetModelMetadata(const TfLiteContext* context, const char* name,
+                              const char** ptr, size_t* bytes) {
+  if (gArenaPlanMetadata->empty() || ArenaPlanMetadataName(0) != name) {
+    return kTfLiteError;
+  }
+  *ptr = gArenaPlanMetadata->data();
+  *bytes = gArenaPlanMetadata->size();
+  return kTfLiteOk;
+}
+
 class ArenaPlannerTest : public ::testing::Test {
  protected:
-  void SetGraph(TestGraph* graph, bool preserve_all_tensors = false) {
+  void SetGraph(TestGraph* graph, bool preserve_all_tensors = false,
+                bool optimize_arena_plan = false) {
     graph_ = graph;
     context_.ReportError = ReportError;
+    context_.GetModelMetadata = GetModelMetadata;
     planner_ = std::make_unique<ArenaPlanner>(
         &context_, std::unique_ptr<GraphInfo>(new TestGraphInfo(graph)),
-        preserve_all_tensors, kTensorAlignment);
+        preserve_all_tensors, kTensorAlignment, /*subgraph_index=*/0,
+        optimize_arena_plan);
     CHECK(planner_->ResetAllocations() == kTfLiteOk);
     CHECK(planner_->PlanAllocations() == kTfLiteOk);
   }
@@ -1072,6 +1091,119 @@ TEST_F(ArenaPlannerTest, DebugTensors) {
   EXPECT_EQ(tensorOffsets.size(), 8);
 }
 
+TEST_F(ArenaPlannerTest, OptimizedArenaPlan) {
+  TestGraph graph({0},
+                  {
+                      /* in, out, tmp */
+                      {{0}, {1}, {}},
+                      {{1}, {2}, {6}},
+                      {{2, 0}, {3}, {}},
+                      {{3, 1}, {4}, {7}},
+                      {{4}, {5}, {}},
+                  },
+                  {5});
+  (*graph.tensors())[0].bytes = 20;
+  (*graph.tensors())[1].bytes = 40;
+  (*graph.tensors())[2].bytes = 32;
+  (*graph.tensors())[3].bytes = 28;
+  (*graph.tensors())[4].bytes = 28;
+  (*graph.tensors())[5].bytes = 36;
+  (*graph.tensors())[6].bytes = 32;
+  (*graph.tensors())[7].bytes = 40;
+  SetGraph(&graph);
+  Execute(0, graph.nodes().size() - 1);
+  size_t greedy_arena_size, persistent_arena_size;
+  planner_->GetAllocInfo(&greedy_arena_size, &persistent_arena_size);
+  EXPECT_TRUE(planner_->GetSerializedPlan().empty());
+
+  SetGraph(&graph, /*preserve_all_tensors=*/false,
+           /*optimize_arena_plan=*/true);
+  Execute(0, graph.nodes().size() - 1);
+  size_t arena_size;
+  planner_->GetAllocInfo(&arena_size, &persistent_arena_size);
+  // Placing the largest tensors first leaves a gap which the tensors live
+  // during the fourth node don't fit in. The optimized plan only needs the
+  // 128 bytes live during that node.
+  EXPECT_LT(arena_size, greedy_arena_size);
+  EXPECT_FALSE(planner_->GetSerializedPlan().empty());
+  EXPECT_EQ(GetOffset(4), GetOffset(3));
+  std::set<std::ptrdiff_t> offsets_of_fourth_node;
+  for (int i : {0, 1, 3, 7}) {
+    offsets_of_fourth_node.insert(GetOffset(i));
+    EXPECT_LE(GetOffsetAfter(i), 128);
+  }
+  EXPECT_EQ(offsets_of_fourth_node.size(), 4);
+}
+
+TEST_F(ArenaPlannerTest, ArenaPlanFromModelMetadata) {
+  TestGraph graph({0},
+                  {
+                      /* in, out, tmp */
+                      {{0}, {1}, {}},
+                      {{1}, {2}, {}},
+                      {{2}, {3}, {}},
+                  },
+                  {3});
+  // Every tensor in its own slot is a valid but wasteful plan.
+  std::vector<ArenaAllocWithUsageInterval> allocs(4);
+  for (int i = 0; i < 4; ++i) {
+    allocs[i].tensor = i;
+    allocs[i].size = (*graph.tensors())[i].bytes;
+    allocs[i].offset = i * 64;
+  }
+  *gArenaPlanMetadata = SerializeArenaPlan(allocs);
+  SetGraph(&graph, /*preserve_all_tensors=*/false,
+           /*optimize_arena_plan=*/true);
+  Execute(0, graph.nodes().size() - 1);
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(GetOffset(i), i * 64);
+  }
+  EXPECT_EQ(planner_->GetSerializedPlan(), *gArenaPlanMetadata);
+
+  // A plan for other tensor sizes is ignored.
+  allocs[2].size += 4;
+  *gArenaPlanMetadata = SerializeArenaPlan(allocs);
+  SetGraph(&graph, /*preserve_all_tensors=*/false,
+           /*optimize_arena_plan=*/true);
+  Execute(0, graph.nodes().size() - 1);
+  EXPECT_NE(GetOffset(2), 2 * 64);
+  EXPECT_NE(planner_->GetSerializedPlan(), *gArenaPlanMetadata);
+  gArenaPlanMetadata->clear();
+}
+
+TEST_F(ArenaPlannerTest, ArenaPlanWithWrappingOffsetIsIgnored) {
+  TestGraph graph({0},
+                  {
+                      /* in, out, tmp */
+                      {{0}, {1}, {}},
+                      {{1}, {2}, {}},
+                  },
+                  {2});
+  std::vector<ArenaAllocWithUsageInterval> allocs(3);
+  for (int i = 0; i < 3; ++i) {
+    allocs[i].tensor = i;
+    allocs[i].size = (*graph.tensors())[i].bytes;
+    allocs[i].offset = i * 64;
+  }
+  // The end of tensor 1 wraps around to a small value, which would overlap
+  // nothing and leave the arena small enough for the other tensors only.
+  allocs[1].offset = std::numeric_limits<size_t>::max() -
+                     std::numeric_limits<size_t>::max() % kTensorAlignment;
+  *gArenaPlanMetadata = SerializeArenaPlan(allocs);
+  SetGraph(&graph, /*preserve_all_tensors=*/false,
+           /*optimize_arena_plan=*/true);
+  Execute(0, graph.nodes().size() - 1);
+
+  // The planner fell back to PlanArenaOffsets.
+  EXPECT_NE(planner_->GetSerializedPlan(), *gArenaPlanMetadata);
+  size_t arena_size, persistent_arena_size;
+  planner_->GetAllocInfo(&arena_size, &persistent_arena_size);
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_LE(GetOffsetAfter(i), arena_size);
+  }
+  gArenaPlanMetadata->clear();
+}
+
 TEST_F(ArenaPlannerTest, SimpleProfilerTest) {
   gNumAlloc = 0;
   gNumDealloc = 0;
@@ -0,0 +1,509 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/lite/core/async/cpu_batching_backend.h"
+
+#include <algorithm>
+#include <chrono>  // NOLINT(build/c++11)
+#include <condition_variable>  // NOLINT(build/c++11)
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>  // NOLINT(build/c++11)
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/lite/builtin_ops.h"
+#include "tensorflow/lite/core/async/backend_async_kernel_interface.h"
+#include "tensorflow/lite/core/async/c/task.h"
+#include "tensorflow/lite/core/async/c/types.h"
+#include "tensorflow/lite/core/async/interop/c/attribute_map.h"
+#include "tensorflow/lite/core/async/interop/c/constants.h"
+#include "tensorflow/lite/core/async/interop/c/types.h"
+#include "tensorflow/lite/core/c/c_api_opaque.h"
+#include "tensorflow/lite/core/c/c_api_types.h"
+#include "tensorflow/lite/core/c/common.h"
+#include "tensorflow/lite/delegates/utils.h"
+#include "tensorflow/lite/delegates/utils/ret_macros.h"
+#include "tensorflow/lite/minimal_logging.h"
+#include "tensorflow/lite/util.h"
+
+namespace tflite {
+namespace async {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Host memory registered with the backend.
+struct Buffer {
+  char* data = nullptr;
+  size_t size = 0;
+  bool is_slice = false;
+};
+
+// An input or output of the signature.
+struct IoTensor {
+  TfLiteIoType io_type;
+  // Name of the input or output in the signature.
+  const char* name;
+  // Index of the tensor in the graph of the async interpreter.
+  int tensor_index = -1;
+  // Bytes of a batch element, for inputs.
+  size_t element_bytes = 0;
+};
+
+// The backend's data of a task, kept as its delegate execution data.
+struct TaskState {
+  // Buffer of each IoTensor.
+  std::vector<Buffer> buffers;
+  Clock::time_point scheduled_time;
+  bool done = true;
+  TfLiteStatus status = kTfLiteOk;
+};
+
+bool IsSupportedBufferType(const TfLiteAttributeMap* attrs) {
+  const char* type = nullptr;
+  return !TfLiteAttributeMapGetStringBufferAttr(
+             attrs, kTfLiteBufferAttrKeyResourceTypeName, &type) ||
+         std::strcmp(type, CpuBatchingBackend::kBufferType) == 0;
+}
+
+bool IsSupportedSyncType(const TfLiteAttributeMap* attrs) {
+  const char* type = nullptr;
+  return !TfLiteAttributeMapGetStringSyncAttr(
+             attrs, kTfLiteSynchronizationAttrKeyObjectTypeName, &type) ||
+         std::strcmp(type, kTfLiteSyncTypeNoSyncObj) == 0;
+}
+
+}  // namespace
+
+class CpuBatchingBackend::Kernel
+    : public delegates::BackendAsyncKernelInterface {
+ public:
+  Kernel(impl::SignatureRunner* runner, const Options& options)
+      : runner_(runner),
+        max_batch_size_(std::max(1, options.max_batch_size)),
+        max_batch_delay_(std::chrono::microseconds(
+            std::max<int64_t>(0, options.max_batch_delay_us))),
+        thread_([this] { Run(); }) {}
+
+  ~Kernel() override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    queue_cv_.notify_all();
+    thread_.join();
+  }
+
+  TfLiteStatus RegisterBuffer(TfLiteOpaqueContext* context,
+                              TfLiteIoType io_type,
+                              const TfLiteBackendBuffer* buffer,
+                              const TfLiteAttributeMap* attrs,
+                              TfLiteBufferHandle handle) override {
+    TFLITE_RET_CHECK_STATUS(TfLiteAttributeMapIsBufferAttributeMap(attrs),
+                            "attrs must be a buffer attribute map");
+    TFLITE_RET_CHECK_STATUS(IsSupportedBufferType(attrs),
+                            "unsupported buffer type");
+    Buffer registered;
+    TFLITE_RET_CHECK_STATUS(
+        TfLiteAttributeMapGetSizeTBufferAttr(attrs, kTfLiteBufferAttrKeySize,
+                                             &registered.size),
+        "the size of the buffer must be given");
+    registered.data = static_cast<char*>(TfLiteBackendBufferGetPtr(buffer));
+    TFLITE_RET_CHECK_STATUS(registered.data != nullptr, "null buffer");
+    std::lock_guard<std::mutex> lock(mutex_);
+    TFLITE_RET_CHECK_STATUS(buffers_.emplace(handle, registered).second,
+                            "the buffer handle is already registered");
+    return kTfLiteOk;
+  }
+
+  TfLiteStatus RegisterBufferSlice(TfLiteOpaqueContext* context,
+                                   TfLiteBufferHandle buffer_pool,
+                                   const TfLiteAttributeMap* attrs,
+                                   TfLiteBufferHandle handle) override {
+    TFLITE_RET_CHECK_STATUS(TfLiteAttributeMapIsBufferAttributeMap(attrs),
+                            "attrs must be a buffer attribute map");
+    size_t offset = 0;
+    size_t size = 0;
+    TfLiteAttributeMapGetSizeTBufferAttr(attrs, kTfLiteBufferAttrKeyOffset,
+                                         &offset);
+    TFLITE_RET_CHECK_STATUS(
+        TfLiteAttributeMapGetSizeTBufferAttr(attrs, kTfLiteBufferAttrKeySize,
+                                             &size),
+        "the size of the slice must be given");
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto pool = buffers_.find(buffer_pool);
+    TFLITE_RET_CHECK_STATUS(pool != buffers_.end() && !pool->second.is_slice,
+                            "the buffer pool isn't a registered buffer");
+    TFLITE_RET_CHECK_STATUS(
+        offset <= pool->second.size && size <= pool->second.size - offset,
+        "the slice exceeds the buffer pool");
+    const Buffer slice{pool->second.data + offset, size, /*is_slice=*/true};
+    TFLITE_RET_CHECK_STATUS(buffers_.emplace(handle, slice).second,
+                            "the buffer handle is already registered");
+    return kTfLiteOk;
+  }
+
+  TfLiteStatus UnregisterBuffer(TfLiteOpaqueContext* context,
+                                TfLiteBufferHandle handle) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    TFLITE_RET_CHECK_STATUS(buffers_.erase(handle) == 1,
+                            "the buffer handle isn't registered");
+    return kTfLiteOk;
+  }
+
+  const std::vector<const char*>& SupportedBufferTypes(
+      TfLiteIoType io_type) const override {
+    return supported_buffer_types_;
+  }
+
+  const std::vector<const char*>& SupportedSynchronizations(
+      TfLiteIoType io_type) const override {
+    return supported_synchronizations_;
+  }
+
+  bool ReconcileRestrictions(const TfLiteOpaqueContext* context,
+                             const TfLiteOpaqueNode* node, int tensor_index,
+                             const TfLiteAttributeMap* user_provided_attributes,
+                             TfLiteAttributeMap* merged,
+                             TfLiteAttributeMap* conflict) const override {
+    if (TfLiteAttributeMapIsBufferAttributeMap(user_provided_attributes)) {
+      if (!IsSupportedBufferType(user_provided_attributes)) {
+        if (conflict != nullptr) {
+          TfLiteAttributeMapSetStringBufferAttr(
+              conflict, kTfLiteBufferAttrKeyResourceTypeName, kBufferType);
+        }
+        return false;
+      }
+      TfLiteAttributeMapCopy(user_provided_attributes, merged);
+      TfLiteAttributeMapSetStringBufferAttr(
+          merged, kTfLiteBufferAttrKeyResourceTypeName, kBufferType);
+      return true;
+    }
+    if (TfLiteAttributeMapIsSyncAttributeMap(user_provided_attributes)) {
+      if (!IsSupportedSyncType(user_provided_attributes)) {
+        if (conflict != nullptr) {
+          TfLiteAttributeMapSetStringSyncAttr(
+              conflict, kTfLiteSynchronizationAttrKeyObjectTypeName,
+              kTfLiteSyncTypeNoSyncObj);
+        }
+        return false;
+      }
+      TfLiteAttributeMapCopy(user_provided_attributes, merged);
+      TfLiteAttributeMapSetStringSyncAttr(
+          merged, kTfLiteSynchronizationAttrKeyObjectTypeName,
+          kTfLiteSyncTypeNoSyncObj);
+      return true;
+    }
+    return false;
+  }
+
+  TfLiteStatus SetAttributes(TfLiteOpaqueContext* context,
+                             TfLiteOpaqueNode* node, int tensor_index,
+                             const TfLiteAttributeMap* attrs) override {
+    if (TfLiteAttributeMapIsBufferAttributeMap(attrs)) {
+      TFLITE_RET_CHECK_STATUS(IsSupportedBufferType(attrs),
+                              "unsupported buffer type");
+      return kTfLiteOk;
+    }
+    if (TfLiteAttributeMapIsSyncAttributeMap(attrs)) {
+      TFLITE_RET_CHECK_STATUS(IsSupportedSyncType(attrs),
+                              "unsupported synchronization type");
+      return kTfLiteOk;
+    }
+    return kTfLiteError;
+  }
+
+  // Matches the inputs and outputs of the signature with the tensors of the
+  // node by name. Mustn't be called while tasks are scheduled.
+  TfLiteStatus Prepare(TfLiteOpaqueContext* context,
+                       TfLiteOpaqueNode* node) override {
+    const int* node_inputs = nullptr;
+    int num_node_inputs = 0;
+    const int* node_outputs = nullptr;
+    int num_node_outputs = 0;
+    TF_LITE_ENSURE_STATUS(
+        TfLiteOpaqueNodeInputs(node, &node_inputs, &num_node_inputs));
+    TF_LITE_ENSURE_STATUS(
+        TfLiteOpaqueNodeOutputs(node, &node_outputs, &num_node_outputs));
+    const auto find_tensor = [context](const int* indices, int num_indices,
+                                       const TfLiteTensor* tensor) {
+      for (int i = 0; i < num_indices; ++i) {
+        const char* name = TfLiteOpaqueTensorName(
+            TfLiteOpaqueContextGetOpaqueTensor(context, indices[i]));
+        if (name != nullptr && tensor->name != nullptr &&
+            std::strcmp(name, tensor->name) == 0) {
+          return indices[i];
+        }
+      }
+      return -1;
+    };
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    io_tensors_.clear();
+    for (const char* name : runner_->input_names()) {
+      const TfLiteTensor* tensor = runner_->input_tensor(name);
+      TFLITE_RET_CHECK_STATUS(tensor->dims->size > 0,
+                              "the inputs must have a batch dimension");
+      IoTensor input{kTfLiteIoTypeInput, name,
+                     find_tensor(node_inputs, num_node_inputs, tensor)};
+      TFLITE_RET_CHECK_STATUS(input.tensor_index >= 0,
+                              "no tensor of the graph matches an input");
+      io_tensors_.push_back(input);
+    }
+    for (const char* name : runner_->output_names()) {
+      const TfLiteTensor* tensor = runner_->output_tensor(name);
+      IoTensor output{kTfLiteIoTypeOutput, name,
+                      find_tensor(node_outputs, num_node_outputs, tensor)};
+      TFLITE_RET_CHECK_STATUS(output.tensor_index >= 0,
+                              "no tensor of the graph matches an output");
+      io_tensors_.push_back(output);
+    }
+
+    // Learn the size of a batch element from a batch of one.
+    batch_size_ = 0;
+    TF_LITE_ENSURE_STATUS(ResizeBatch(1));
+    for (IoTensor& io_tensor : io_tensors_) {
+      if (io_tensor.io_type == kTfLiteIoTypeInput) {
+        io_tensor.element_bytes = runner_->input_tensor(io_tensor.name)->bytes;
+      }
+    }
+    return kTfLiteOk;
+  }
+
+  TfLiteStatus Eval(TfLiteOpaqueContext* context, TfLiteOpaqueNode* node,
+                    TfLiteExecutionTask* task) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto* state = static_cast<TaskState*>(
+        TfLiteExecutionTaskGetDelegateExecutionData(task, kernel()));
+    if (state == nullptr) {
+      state = new TaskState;
+      TfLiteExecutionTaskSetDelegateExecutionData(task, kernel(), state);
+    }
+    TFLITE_RET_CHECK_STATUS(state->done, "the task is already scheduled");
+    // Failures are also reported by `Wait`.
+    state->status = kTfLiteDelegateError;
+    TFLITE_RET_CHECK_STATUS(!io_tensors_.empty(),
+                            "the backend isn't prepared");
+    state->buffers.resize(io_tensors_.size());
+    for (size_t i = 0; i < io_tensors_.size(); ++i) {
+      const IoTensor& io_tensor = io_tensors_[i];
+      auto buffer = buffers_.find(
+          TfLiteExecutionTaskGetBufferByIndex(task, io_tensor.tensor_index));
+      TFLITE_RET_CHECK_STATUS(buffer != buffers_.end(),
+                              "an input or output has no registered buffer");
+      TFLITE_RET_CHECK_STATUS(
+          io_tensor.io_type != kTfLiteIoTypeInput ||
+              buffer->second.size >= io_tensor.element_bytes,
+          "an input buffer is too small");
+      state->buffers[i] = buffer->second;
+    }
+    state->scheduled_time = Clock::now();
+    state->done = false;
+    state->status = kTfLiteOk;
+    queue_.push_back(state);
+    queue_cv_.notify_one();
+    return kTfLiteOk;
+  }
+
+  TfLiteStatus Wait(TfLiteOpaqueContext* context,
+                    TfLiteExecutionTask* task) override {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto* state = static_cast<TaskState*>(
+        TfLiteExecutionTaskGetDelegateExecutionData(task, kernel()));
+    if (state == nullptr) return kTfLiteOk;
+    done_cv_.wait(lock, [state] { return state->done; });
+    return state->status;
+  }
+
+  TfLiteStatus Finish(TfLiteOpaqueContext* context,
+                      TfLiteExecutionTask* task) override {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto* state = static_cast<TaskState*>(
+        TfLiteExecutionTaskGetDelegateExecutionData(task, kernel()));
+    if (state == nullptr) return kTfLiteOk;
+    // The buffers of the task must stay valid until its batch is done.
+    done_cv_.wait(lock, [state] { return state->done; });
+    TfLiteExecutionTaskSetDelegateExecutionData(task, kernel(), nullptr);
+    delete state;
+    return kTfLiteOk;
+  }
+
+ private:
+  // Resizes the batch dimension of the inputs of `runner_` to `batch_size`.
+  TfLiteStatus ResizeBatch(int batch_size) {
+    if (batch_size == batch_size_) return kTfLiteOk;
+    for (const IoTensor& io_tensor : io_tensors_) {
+      if (io_tensor.io_type != kTfLiteIoTypeInput) continue;
+      const TfLiteIntArray* dims = runner_->input_tensor(io_tensor.name)->dims;
+      std::vector<int> new_dims(dims->data, dims->data + dims->size);
+      new_dims[0] = batch_size;
+      TF_LITE_ENSURE_STATUS(
+          runner_->ResizeInputTensor(io_tensor.name, new_dims));
+    }
+    TF_LITE_ENSURE_STATUS(runner_->AllocateTensors());
+    batch_size_ = batch_size;
+    return kTfLiteOk;
+  }
+
+  // Runs `batch` in a single invocation of `runner_`. Sets the status of the
+  // tasks whose outputs don't fit in their buffers in `statuses`.
+  TfLiteStatus RunBatch(const std::vector<TaskState*>& batch,
+                        std::vector<TfLiteStatus>& statuses) {
+    const int batch_size = batch.size();
+    TF_LITE_ENSURE_STATUS(ResizeBatch(batch_size));
+    for (size_t i = 0; i < io_tensors_.size(); ++i) {
+      const IoTensor& io_tensor = io_tensors_[i];
+      if (io_tensor.io_type != kTfLiteIoTypeInput) continue;
+      char* data = runner_->input_tensor(io_tensor.name)->data.raw;
+      for (int j = 0; j < batch_size; ++j) {
+        std::memcpy(data + j * io_tensor.element_bytes,
+                    batch[j]->buffers[i].data, io_tensor.element_bytes);
+      }
+    }
+    TF_LITE_ENSURE_STATUS(runner_->Invoke());
+    for (size_t i = 0; i < io_tensors_.size(); ++i) {
+      const IoTensor& io_tensor = io_tensors_[i];
+      if (io_tensor.io_type != kTfLiteIoTypeOutput) continue;
+      const TfLiteTensor* tensor = runner_->output_tensor(io_tensor.name);
+      const size_t element_bytes = tensor->bytes / batch_size;
+      for (int j = 0; j < batch_size; ++j) {
+        const Buffer& buffer = batch[j]->buffers[i];
+        if (buffer.size < element_bytes) {
+          TFLITE_LOG_PROD(TFLITE_LOG_ERROR,
+                          "The buffer of output %s is too small.",
+                          io_tensor.name);
+          statuses[j] = kTfLiteDelegateError;
+          continue;
+        }
+        std::memcpy(buffer.data, tensor->data.raw + j * element_bytes,
+                    element_bytes);
+      }
+    }
+    return kTfLiteOk;
+  }
+
+  // Runs the batches of tasks until the backend is destroyed. A batch starts
+  // when it's full or when its first task has waited for max_batch_delay_.
+  void Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      queue_cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+      if (queue_.empty()) return;
+      queue_cv_.wait_until(
+          lock, queue_.front()->scheduled_time + max_batch_delay_,
+          [this] { return stopping_ || queue_.size() >= max_batch_size_; });
+      const size_t batch_size = std::min(queue_.size(), max_batch_size_);
+      std::vector<TaskState*> batch(queue_.begin(),
+                                    queue_.begin() + batch_size);
+      queue_.erase(queue_.begin(), queue_.begin() + batch_size);
+      std::vector<TfLiteStatus> statuses(batch_size, kTfLiteOk);
+
+      lock.unlock();
+      const TfLiteStatus status = RunBatch(batch, statuses);
+      lock.lock();
+
+      for (size_t j = 0; j < batch_size; ++j) {
+        batch[j]->status = status != kTfLiteOk ? status : statuses[j];
+        batch[j]->done = true;
+      }
+      done_cv_.notify_all();
+    }
+  }
+
+  impl::SignatureRunner* const runner_;
+  const size_t max_batch_size_;
+  const Clock::duration max_batch_delay_;
+  const std::vector<const char*> supported_buffer_types_ = {kBufferType};
+  const std::vector<const char*> supported_synchronizations_ = {
+      kTfLiteSyncTypeNoSyncObj};
+
+  std::mutex mutex_;
+  // Signals new tasks and the destruction of the backend to the thread.
+  std::condition_variable queue_cv_;
+  // Signals finished batches.
+  std::condition_variable done_cv_;
+  std::unordered_map<TfLiteBufferHandle, Buffer> buffers_;
+  std::vector<IoTensor> io_tensors_;
+  std::deque<TaskState*> queue_;
+  bool stopping_ = false;
+  // Current batch size of the inputs of `runner_`, only used by Prepare and
+  // by the thread.
+  int batch_size_ = 0;
+
+  // Last member, the thread uses all the others.
+  std::thread thread_;
+};
+
+namespace {
+
+TfLiteStatus DelegatePrepare(TfLiteContext* context,
+                             TfLiteDelegate* tflite_delegate) {
+  // AsyncSubgraph needs the whole graph in a single delegated node.
+  delegates::IsNodeSupportedFn node_supported_fn =
+      [](TfLiteContext* context, TfLiteNode* node,
+         TfLiteRegistration* registration,
+         std::string* unsupported_details) -> bool { return true; };
+  delegates::GraphPartitionHelper helper(context, node_supported_fn);
+  TF_LITE_ENSURE_STATUS(helper.Partition(nullptr));
+  const std::vector<int> supported_nodes =
+      helper.GetNodesOfFirstNLargestPartitions(1);
+
+  TfLiteRegistration reg{};
+  reg.init = [](TfLiteContext* context, const char* buffer,
+                size_t length) -> void* {
+    const auto* params = reinterpret_cast<const TfLiteDelegateParams*>(buffer);
+    // AsyncSubgraph requires TfLiteNode.user_data to be the
+    // TfLiteAsyncKernel.
+    return static_cast<TfLiteAsyncKernel*>(params->delegate->data_);
+  };
+  reg.prepare = [](TfLiteContext*, TfLiteNode*) -> TfLiteStatus {
+    return kTfLiteOk;
+  };
+  reg.invoke = [](TfLiteContext* context, TfLiteNode*) -> TfLiteStatus {
+    TF_LITE_KERNEL_LOG(context,
+                       "CpuBatchingBackend only runs through "
+                       "AsyncSignatureRunner.");
+    return kTfLiteError;
+  };
+  reg.builtin_code = kTfLiteBuiltinDelegate;
+  reg.custom_name = "CpuBatchingBackend";
+  reg.version = 1;
+  reg.async_kernel = [](TfLiteContext*,
+                        TfLiteNode* node) -> TfLiteAsyncKernel* {
+    return static_cast<TfLiteAsyncKernel*>(node->user_data);
+  };
+
+  return context->ReplaceNodeSubsetsWithDelegateKernels(
+      context, reg, BuildTfLiteArray(supported_nodes).get(), tflite_delegate);
+}
+
+}  // namespace
+
+CpuBatchingBackend::CpuBatchingBackend(impl::SignatureRunner* runner,
+                                       const Options& options)
+    : kernel_(std::make_unique<Kernel>(runner, options)),
+      delegate_(TfLiteDelegateCreate()) {
+  delegate_.Prepare = &DelegatePrepare;
+  delegate_.data_ = kernel_->kernel();
+}
+
+CpuBatchingBackend::~CpuBatchingBackend() = default;
+
+}  // namespace async
+}  // namespace tflite
@@ -0,0 +1,84 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_CORE_ASYNC_CPU_BATCHING_BACKEND_H_
+#define TENSORFLOW_LITE_CORE_ASYNC_CPU_BATCHING_BACKEND_H_
+
+#include <cstdint>
+#include <memory>
+
+#include "tensorflow/lite/core/c/common.h"
+#include "tensorflow/lite/core/signature_runner.h"
+
+namespace tflite {
+namespace async {
+
+// WARNING: Experimental interface, subject to change
+//
+// An asynchronous backend that runs on CPU, for serving many concurrent
+// callers of an AsyncSignatureRunner. Tasks scheduled with `InvokeAsync` are
+// queued and coalesced into batched invocations of a synchronous
+// SignatureRunner of the same signature, run on a thread of the backend.
+//
+// Usage:
+//
+//   // The interpreter running the batches on CPU.
+//   SignatureRunner* runner = cpu_interpreter->GetSignatureRunner(key);
+//   CpuBatchingBackend backend(runner, options);
+//   // The interpreter serving the callers, of the same model.
+//   interpreter->ModifyGraphWithDelegate(backend.get_delegate());
+//   AsyncSignatureRunner* async_runner =
+//       interpreter->GetAsyncSignatureRunner(key);
+//
+// Dimension 0 of each input and output of the signature is its batch
+// dimension, which `runner` resizes to the number of tasks in a batch. Each
+// task reads and writes a single batch element.
+//
+// Buffers are of type kBufferType: a TfLiteBackendBuffer holding a pointer to
+// host memory, with the size of the memory given by the
+// kTfLiteBufferAttrKeySize attribute. Only the kTfLiteSyncTypeNoSyncObj
+// synchronization type is supported: the inputs of a task must be ready when
+// it is scheduled, and its outputs are ready when `Wait` on it returns.
+class CpuBatchingBackend {
+ public:
+  static constexpr char kBufferType[] = "host_memory";
+
+  struct Options {
+    // Maximum number of tasks run in one invocation.
+    int max_batch_size = 8;
+    // Maximum time in microseconds a task waits for more tasks to run with
+    // before its batch starts.
+    int64_t max_batch_delay_us = 1000;
+  };
+
+  // `runner` must outlive the backend and mustn't be used by anything else
+  // while the backend exists.
+  CpuBatchingBackend(impl::SignatureRunner* runner, const Options& options);
+  ~CpuBatchingBackend();
+
+  // Returns the delegate to apply to the interpreter serving the callers. It
+  // delegates the whole graph to the backend.
+  TfLiteDelegate* get_delegate() { return &delegate_; }
+
+ private:
+  class Kernel;
+
+  std::unique_ptr<Kernel> kernel_;
+  TfLiteDelegate delegate_;
+};
+
+}  // namespace async
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_CORE_ASYNC_CPU_BATCHING_BACKEND_H_
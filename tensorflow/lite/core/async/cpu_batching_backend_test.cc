@@ -0,0 +1,244 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/lite/core/async/cpu_batching_backend.h"
+
+#include <cstdlib>
+#include <memory>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "tensorflow/lite/core/async/async_signature_runner.h"
+#include "tensorflow/lite/core/async/c/task.h"
+#include "tensorflow/lite/core/async/c/types.h"
+#include "tensorflow/lite/core/async/interop/c/attribute_map.h"
+#include "tensorflow/lite/core/async/interop/c/constants.h"
+#include "tensorflow/lite/core/async/interop/c/types.h"
+#include "tensorflow/lite/core/c/builtin_op_data.h"
+#include "tensorflow/lite/core/c/c_api_types.h"
+#include "tensorflow/lite/core/c/common.h"
+#include "tensorflow/lite/core/interpreter.h"
+#include "tensorflow/lite/core/kernels/builtin_op_kernels.h"
+#include "tensorflow/lite/interpreter_test_util.h"
+
+namespace tflite {
+namespace async {
+namespace {
+
+constexpr char kSignatureKey[] = "serving_default";
+constexpr int kNumElements = 3;
+
+// A task with its own input and output buffers.
+class Task {
+ public:
+  Task(AsyncSignatureRunner* runner, float value)
+      : runner_(runner),
+        input_(kNumElements, value),
+        output_(kNumElements, 0.0f),
+        task_(runner->CreateTask()) {
+    input_handle_ = Register(kTfLiteIoTypeInput, input_.data());
+    output_handle_ = Register(kTfLiteIoTypeOutput, output_.data());
+    TfLiteExecutionTaskSetBuffer(task_, kTfLiteIoTypeInput, "input",
+                                 input_handle_);
+    TfLiteExecutionTaskSetBuffer(task_, kTfLiteIoTypeOutput, "output",
+                                 output_handle_);
+  }
+
+  ~Task() {
+    EXPECT_EQ(kTfLiteOk, runner_->Finish(task_));
+    runner_->UnregisterBuffer(input_handle_);
+    runner_->UnregisterBuffer(output_handle_);
+  }
+
+  TfLiteExecutionTask* task() { return task_; }
+  const std::vector<float>& output() const { return output_; }
+
+ private:
+  TfLiteBufferHandle Register(TfLiteIoType io_type, float* data) {
+    TfLiteBackendBuffer* buffer = TfLiteBackendBufferCreate();
+    TfLiteBackendBufferSetPtr(buffer, data);
+    TfLiteAttributeMap* attrs =
+        TfLiteAttributeMapCreate(kTfLiteAttrMapTypeBuffer);
+    TfLiteAttributeMapSetStringBufferAttr(attrs,
+                                          kTfLiteBufferAttrKeyResourceTypeName,
+                                          CpuBatchingBackend::kBufferType);
+    TfLiteAttributeMapSetSizeTBufferAttr(attrs, kTfLiteBufferAttrKeySize,
+                                         kNumElements * sizeof(float));
+    TfLiteBufferHandle handle = kTfLiteNullBufferHandle;
+    EXPECT_EQ(kTfLiteOk,
+              runner_->RegisterBuffer(io_type, buffer, attrs, &handle));
+    TfLiteAttributeMapDelete(attrs);
+    TfLiteBackendBufferDelete(buffer);
+    return handle;
+  }
+
+  AsyncSignatureRunner* runner_;
+  std::vector<float> input_;
+  std::vector<float> output_;
+  TfLiteExecutionTask* task_;
+  TfLiteBufferHandle input_handle_;
+  TfLiteBufferHandle output_handle_;
+};
+
+class CpuBatchingBackendTest : public InterpreterTest {
+ protected:
+  // Builds an interpreter computing `output = input + input`, with a batch of
+  // one.
+  static std::unique_ptr<Interpreter> BuildInterpreter() {
+    auto interpreter = std::make_unique<Interpreter>();
+    interpreter->AddTensors(2);
+    interpreter->SetInputs({0});
+    interpreter->SetOutputs({1});
+    TfLiteQuantizationParams quant;
+    interpreter->SetTensorParametersReadWrite(0, kTfLiteFloat32, "x",
+                                              {1, kNumElements}, quant);
+    interpreter->SetTensorParametersReadWrite(1, kTfLiteFloat32, "a",
+                                              {1, kNumElements}, quant);
+    auto* params =
+        reinterpret_cast<TfLiteAddParams*>(malloc(sizeof(TfLiteAddParams)));
+    params->activation = kTfLiteActNone;
+    params->pot_scale_int16 = false;
+    interpreter->AddNodeWithParameters({0, 0}, {1}, nullptr, 0, params,
+                                       ops::builtin::Register_ADD());
+    BuildSignature(interpreter.get(), kSignatureKey, {{"input", 0}},
+                   {{"output", 1}});
+    return interpreter;
+  }
+
+  void Init(const CpuBatchingBackend::Options& options) {
+    cpu_interpreter_ = BuildInterpreter();
+    cpu_runner_ = cpu_interpreter_->GetSignatureRunner(kSignatureKey);
+    ASSERT_NE(nullptr, cpu_runner_);
+    backend_ = std::make_unique<CpuBatchingBackend>(cpu_runner_, options);
+
+    interpreter_ = BuildInterpreter();
+    ASSERT_EQ(kTfLiteOk,
+              interpreter_->ModifyGraphWithDelegate(backend_->get_delegate()));
+    runner_ = interpreter_->GetAsyncSignatureRunner(kSignatureKey);
+    ASSERT_NE(nullptr, runner_);
+    ASSERT_EQ(kTfLiteOk, runner_->PrepareBackends());
+  }
+
+  // The delegate must outlive the interpreter it's applied to.
+  void TearDown() override { interpreter_.reset(); }
+
+  std::unique_ptr<Interpreter> cpu_interpreter_;
+  impl::SignatureRunner* cpu_runner_ = nullptr;
+  std::unique_ptr<CpuBatchingBackend> backend_;
+  AsyncSignatureRunner* runner_ = nullptr;
+};
+
+TEST_F(CpuBatchingBackendTest, RunsFullBatch) {
+  CpuBatchingBackend::Options options;
+  options.max_batch_size = 4;
+  // Long enough for the batch to only start once it's full.
+  options.max_batch_delay_us = 60 * 1000 * 1000;
+  Init(options);
+
+  std::vector<std::unique_ptr<Task>> tasks;
+  for (int i = 0; i < options.max_batch_size; ++i) {
+    tasks.push_back(std::make_unique<Task>(runner_, i));
+    ASSERT_EQ(kTfLiteOk, runner_->InvokeAsync(tasks.back()->task()));
+  }
+  for (int i = 0; i < options.max_batch_size; ++i) {
+    ASSERT_EQ(kTfLiteOk, runner_->Wait(tasks[i]->task()));
+    EXPECT_EQ(std::vector<float>(kNumElements, 2.0f * i), tasks[i]->output());
+  }
+  EXPECT_EQ(options.max_batch_size,
+            cpu_runner_->input_tensor("input")->dims->data[0]);
+}
+
+TEST_F(CpuBatchingBackendTest, RunsPartialBatchAfterDelay) {
+  CpuBatchingBackend::Options options;
+  options.max_batch_size = 4;
+  options.max_batch_delay_us = 1000;
+  Init(options);
+
+  Task task(runner_, 3.0f);
+  ASSERT_EQ(kTfLiteOk, runner_->InvokeAsync(task.task()));
+  ASSERT_EQ(kTfLiteOk, runner_->Wait(task.task()));
+  EXPECT_EQ(std::vector<float>(kNumElements, 6.0f), task.output());
+
+  // The task can be scheduled again.
+  ASSERT_EQ(kTfLiteOk, runner_->InvokeAsync(task.task()));
+  ASSERT_EQ(kTfLiteOk, runner_->Wait(task.task()));
+  EXPECT_EQ(std::vector<float>(kNumElements, 6.0f), task.output());
+}
+
+TEST_F(CpuBatchingBackendTest, ServesConcurrentCallers) {
+  CpuBatchingBackend::Options options;
+  options.max_batch_size = 3;
+  options.max_batch_delay_us = 500;
+  Init(options);
+
+  constexpr int kNumThreads = 8;
+  constexpr int kNumRuns = 20;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([this, i] {
+      Task task(runner_, i);
+      for (int run = 0; run < kNumRuns; ++run) {
+        ASSERT_EQ(kTfLiteOk, runner_->InvokeAsync(task.task()));
+        ASSERT_EQ(kTfLiteOk, runner_->Wait(task.task()));
+        EXPECT_EQ(std::vector<float>(kNumElements, 2.0f * i), task.output());
+      }
+    });
+  }
+  for (std::thread& thread : threads) thread.join();
+}
+
+TEST_F(CpuBatchingBackendTest, RejectsUnsupportedTypes) {
+  Init(CpuBatchingBackend::Options());
+
+  TfLiteAttributeMap* attrs =
+      TfLiteAttributeMapCreate(kTfLiteAttrMapTypeBuffer);
+  TfLiteAttributeMap* merged =
+      TfLiteAttributeMapCreate(kTfLiteAttrMapTypeBuffer);
+  TfLiteAttributeMap* conflict =
+      TfLiteAttributeMapCreate(kTfLiteAttrMapTypeBuffer);
+  TfLiteAttributeMapSetStringBufferAttr(
+      attrs, kTfLiteBufferAttrKeyResourceTypeName, "ahwb");
+  EXPECT_FALSE(runner_->ReconcileRestrictions(kTfLiteIoTypeInput, "input",
+                                              attrs, merged, conflict));
+  EXPECT_NE(kTfLiteOk,
+            runner_->SetAttributes(kTfLiteIoTypeInput, "input", attrs));
+  TfLiteAttributeMapSetStringBufferAttr(
+      attrs, kTfLiteBufferAttrKeyResourceTypeName,
+      CpuBatchingBackend::kBufferType);
+  EXPECT_TRUE(runner_->ReconcileRestrictions(kTfLiteIoTypeInput, "input",
+                                             attrs, merged, conflict));
+  TfLiteAttributeMapDelete(attrs);
+  TfLiteAttributeMapDelete(merged);
+  TfLiteAttributeMapDelete(conflict);
+
+  attrs = TfLiteAttributeMapCreate(kTfLiteAttrMapTypeSync);
+  merged = TfLiteAttributeMapCreate(kTfLiteAttrMapTypeSync);
+  conflict = TfLiteAttributeMapCreate(kTfLiteAttrMapTypeSync);
+  TfLiteAttributeMapSetStringSyncAttr(
+      attrs, kTfLiteSynchronizationAttrKeyObjectTypeName, "sync_fence_fd");
+  EXPECT_FALSE(runner_->ReconcileRestrictions(kTfLiteIoTypeOutput, "output",
+                                              attrs, merged, conflict));
+  const char* type = nullptr;
+  EXPECT_TRUE(TfLiteAttributeMapGetStringSyncAttr(
+      conflict, kTfLiteSynchronizationAttrKeyObjectTypeName, &type));
+  EXPECT_STREQ(kTfLiteSyncTypeNoSyncObj, type);
+  TfLiteAttributeMapDelete(attrs);
+  TfLiteAttributeMapDelete(merged);
+  TfLiteAttributeMapDelete(conflict);
+}
+
+}  // namespace
+}  // namespace async
+}  // namespace tflite
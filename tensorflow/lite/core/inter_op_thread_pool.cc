@@ -0,0 +1,105 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/lite/core/inter_op_thread_pool.h"
+
+#include <functional>
+#include <memory>
+#include <mutex>  // NOLINT(build/c++11)
+#include <thread>  // NOLINT(build/c++11)
+#include <utility>
+
+#include "tensorflow/lite/core/c/common.h"
+#include "tensorflow/lite/external_cpu_backend_context.h"
+
+namespace tflite {
+namespace internal {
+namespace {
+
+thread_local TfLiteExternalContext* worker_cpu_backend_context = nullptr;
+
+}  // namespace
+
+InterOpThreadPool::InterOpThreadPool(int num_threads) {
+  for (int i = 1; i < num_threads; ++i) {
+    auto cpu_backend_context = std::make_unique<ExternalCpuBackendContext>();
+    // Kernels create the internal backend context the first time they need
+    // it, so it is limited to one thread from the very first kernel.
+    cpu_backend_context->set_max_num_threads(1);
+    cpu_backend_contexts_.push_back(std::move(cpu_backend_context));
+  }
+  for (auto& cpu_backend_context : cpu_backend_contexts_) {
+    threads_.emplace_back(&InterOpThreadPool::WorkerLoop, this,
+                          cpu_backend_context.get());
+  }
+}
+
+InterOpThreadPool::~InterOpThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  work_available_.notify_all();
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+}
+
+void InterOpThreadPool::ParallelFor(int n, const std::function<void(int)>& fn) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  fn_ = &fn;
+  num_items_ = n;
+  next_item_ = 0;
+  num_done_items_ = 0;
+  ++generation_;
+  work_available_.notify_all();
+  RunItems(&lock);
+  work_done_.wait(lock, [this] { return num_done_items_ == num_items_; });
+  fn_ = nullptr;
+}
+
+TfLiteExternalContext* InterOpThreadPool::WorkerCpuBackendContext() {
+  return worker_cpu_backend_context;
+}
+
+void InterOpThreadPool::WorkerLoop(
+    ExternalCpuBackendContext* cpu_backend_context) {
+  worker_cpu_backend_context = cpu_backend_context;
+  std::unique_lock<std::mutex> lock(mutex_);
+  uint64_t generation = 0;
+  while (true) {
+    work_available_.wait(lock, [this, generation] {
+      return stop_ || generation_ != generation;
+    });
+    if (stop_) return;
+    generation = generation_;
+    RunItems(&lock);
+  }
+}
+
+void InterOpThreadPool::RunItems(std::unique_lock<std::mutex>* lock) {
+  while (next_item_ < num_items_) {
+    const int item = next_item_++;
+    const std::function<void(int)>& fn = *fn_;
+    lock->unlock();
+    fn(item);
+    lock->lock();
+    if (++num_done_items_ == num_items_) {
+      work_done_.notify_all();
+    }
+  }
+}
+
+}  // namespace internal
+}  // namespace tflite
@@ -0,0 +1,85 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_CORE_INTER_OP_THREAD_POOL_H_
+#define TENSORFLOW_LITE_CORE_INTER_OP_THREAD_POOL_H_
+
+#include <stdint.h>
+
+#include <condition_variable>  // NOLINT(build/c++11)
+#include <functional>
+#include <memory>
+#include <mutex>  // NOLINT(build/c++11)
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "tensorflow/lite/core/c/common.h"
+#include "tensorflow/lite/external_cpu_backend_context.h"
+
+namespace tflite {
+namespace internal {
+
+// A pool of threads used by a Subgraph to execute nodes which don't depend on
+// each other at the same time, see InterpreterOptions::SetNumInterOpThreads.
+//
+// The CPU backend context (ruy, gemmlowp and their caches) isn't thread-safe,
+// so each worker thread has its own, which kernels get from
+// TfLiteContext::GetExternalContext while they run on that thread. The
+// kernels running on worker threads are limited to one thread each: the
+// parallelism comes from running several of them at once.
+class InterOpThreadPool {
+ public:
+  // Work is done by the calling thread and `num_threads - 1` worker threads.
+  explicit InterOpThreadPool(int num_threads);
+  ~InterOpThreadPool();
+  InterOpThreadPool(const InterOpThreadPool&) = delete;
+  InterOpThreadPool& operator=(const InterOpThreadPool&) = delete;
+
+  int num_threads() const { return static_cast<int>(threads_.size()) + 1; }
+
+  // Calls `fn(i)` for each `i` in [0, n) on the calling thread and the worker
+  // threads, and returns once all the calls returned. Not reentrant.
+  void ParallelFor(int n, const std::function<void(int)>& fn);
+
+  // Returns the CPU backend context of the calling thread if it is a worker
+  // thread of a pool, nullptr otherwise.
+  static TfLiteExternalContext* WorkerCpuBackendContext();
+
+ private:
+  void WorkerLoop(ExternalCpuBackendContext* cpu_backend_context);
+
+  // Runs items of the current ParallelFor until there are none left. `lock`
+  // holds `mutex_`, and is released while running an item.
+  void RunItems(std::unique_lock<std::mutex>* lock);
+
+  std::mutex mutex_;
+  std::condition_variable work_available_;
+  std::condition_variable work_done_;
+  bool stop_ = false;
+  // Incremented by each ParallelFor.
+  uint64_t generation_ = 0;
+  const std::function<void(int)>* fn_ = nullptr;
+  int num_items_ = 0;
+  int next_item_ = 0;
+  int num_done_items_ = 0;
+
+  std::vector<std::unique_ptr<ExternalCpuBackendContext>>
+      cpu_backend_contexts_;
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace internal
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_CORE_INTER_OP_THREAD_POOL_H_
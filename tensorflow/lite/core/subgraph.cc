@@ -24,6 +24,7 @@ limitations under the License.
 #include <cstring>
 #include <iterator>
 #include <memory>
+#include <numeric>
 #include <string>
 #include <unordered_set>
 #include <utility>
@@ -39,6 +40,7 @@ limitations under the License.
 #include "tensorflow/lite/core/api/tensor_utils.h"
 #include "tensorflow/lite/core/c/c_api_types.h"
 #include "tensorflow/lite/core/c/common.h"
+#include "tensorflow/lite/core/inter_op_thread_pool.h"
 #include "tensorflow/lite/experimental/resource/resource_base.h"
 #include "tensorflow/lite/graph_info.h"
 #include "tensorflow/lite/memory_planner.h"
@@ -199,7 +201,11 @@ TfLiteStatus VerifyCustomAllocationForTensor(
 // indices.
 class InterpreterInfo : public GraphInfo {
  public:
-  explicit InterpreterInfo(Subgraph* subgraph) : subgraph_(subgraph) {}
+  // `inter_op_level_starts` are the starts of the levels of nodes which run
+  // concurrently, see `Subgraph::inter_op_level_starts_`.
+  InterpreterInfo(Subgraph* subgraph,
+                  const std::vector<int>* inter_op_level_starts)
+      : subgraph_(subgraph), inter_op_level_starts_(inter_op_level_starts) {}
 
   size_t num_tensors() const override { return subgraph_->tensors_size(); }
 
@@ -241,8 +247,18 @@ class InterpreterInfo : public GraphInfo {
     return subgraph_->variables();
   }
 
+  std::pair<size_t, size_t> concurrent_nodes(size_t index) const override {
+    const std::vector<int>& level_starts = *inter_op_level_starts_;
+    if (level_starts.empty()) return {index, index};
+    auto next_level = std::upper_bound(
+        level_starts.begin(), level_starts.end(), static_cast<int>(index));
+    return {static_cast<size_t>(*(next_level - 1)),
+            static_cast<size_t>(*next_level - 1)};
+  }
+
  public:
   Subgraph* subgraph_;
+  const std::vector<int>* inter_op_level_starts_;
 };
 
 Subgraph::Subgraph(ErrorReporter* error_reporter,
@@ -493,7 +509,7 @@ const char* GetDelegateKernalName(const TfLiteRegistration& registration) {
 
 TfLiteStatus Subgraph::PartitionGraph(const TfLiteIntArray* nodes_to_replace,
                                       std::vector<NodeSubset>* node_subsets) {
-  const InterpreterInfo info(this);
+  const InterpreterInfo info(this, &inter_op_level_starts_);
   return PartitionGraphIntoIndependentNodeSubsets(
       &info, nodes_to_replace, node_subsets,
       /*greedily=*/!DisableDelegateClustering(), control_edges_);
@@ -564,6 +580,7 @@ TfLiteStatus Subgraph::ReplaceNodeSubsetsWithDelegateKernels(
                   GetDelegateKernalName(registration), node_subsets.size());
 
   execution_plan_.clear();
+  inter_op_level_starts_.clear();
 
   for (auto& node_subset : node_subsets) {
     // Subsets claimed by the delegate should have a "macro" op created, the
@@ -615,6 +632,13 @@ TfLiteStatus Subgraph::ReplaceNodeSubsetsWithDelegateKernels(
 
 TfLiteExternalContext* Subgraph::GetExternalContext(
     TfLiteExternalContextType type) {
+  // Kernels running on an inter-op worker thread use the CPU backend context
+  // of that thread, the one of the interpreter isn't thread-safe.
+  if (type == kTfLiteCpuBackendContext) {
+    TfLiteExternalContext* worker_context =
+        internal::InterOpThreadPool::WorkerCpuBackendContext();
+    if (worker_context != nullptr) return worker_context;
+  }
   if (static_cast<int>(type) >= 0 && type < kTfLiteMaxExternalContexts) {
     return external_contexts_[type];
   }
@@ -1133,6 +1157,7 @@ TfLiteStatus Subgraph::AddNodeWithParameters(
   // Copying of registration is required to support unresolved custom ops.
   node_and_reg.second = *registration;
   execution_plan_.push_back(new_node_index);
+  inter_op_level_starts_.clear();
   return kTfLiteOk;
 }
 
@@ -1517,13 +1542,26 @@ TfLiteStatus Subgraph::PrepareOpsAndTensors() {
                            execution_plan_, &last_exec_plan_index_prepared));
   next_execution_plan_index_to_prepare_ = last_exec_plan_index_prepared + 1;
 
+  // The levels of concurrent nodes are planned once all the nodes are
+  // prepared, since this reorders the execution plan, and before the memory
+  // planner plans the lifetime of the tensors of the reordered plan.
+  if (inter_op_level_starts_.empty() && NumInterOpThreads() > 1 &&
+      !has_dynamic_tensors_ &&
+      next_execution_plan_index_to_plan_allocation_ == 0 &&
+      next_execution_plan_index_to_prepare_ == execution_plan_.size()) {
+    PlanInterOpLevels();
+    if (memory_planner_ && !inter_op_level_starts_.empty()) {
+      TF_LITE_ENSURE_STATUS(memory_planner_->PlanAllocations());
+    }
+  }
+
   if (!memory_planner_) {
 #ifdef TFLITE_USE_SIMPLE_MEMORY_PLANNER
     memory_planner_.reset(new SimplePlanner(&context_, CreateGraphInfo()));
 #else
     memory_planner_ = std::make_unique<ArenaPlanner>(
         &context_, CreateGraphInfo(), ShouldPreserveAllTensors(),
-        kDefaultTensorAlignment, subgraph_index_);
+        kDefaultTensorAlignment, subgraph_index_, ShouldOptimizeArenaPlan());
 #endif
     memory_planner_->PlanAllocations();
   }
@@ -1582,6 +1620,42 @@ TfLiteStatus Subgraph::Invoke() {
   telemetry::TelemetryReportEvent(&context_, "Invoke", status);
   return status;
 }
+TfLiteStatus Subgraph::EnsureNodeInputsAreReadable(
+    const TfLiteNode& node, const TfLiteRegistration& registration) {
+  for (int i = 0; i < node.inputs->size; ++i) {
+    int tensor_index = node.inputs->data[i];
+    if (tensor_index == kTfLiteOptionalTensor) {
+      continue;
+    }
+    TfLiteTensor* tensor = &tensors_[tensor_index];
+    if (tensor->delegate && tensor->delegate != node.delegate &&
+        tensor->data_is_stale) {
+      TF_LITE_ENSURE_STATUS(EnsureTensorDataIsReadable(tensor_index));
+    }
+    if (tensor->data.raw == nullptr && tensor->bytes > 0) {
+      if (registration.builtin_code == kTfLiteBuiltinReshape && i == 1 &&
+          tensor->dims->size != 1) {
+        // In general, having a tensor here with no buffer will be an error.
+        // However, for the reshape operator, the second input tensor is
+        // sometimes only used for the shape, not for the data. Thus, null
+        // buffer is ok in this situation.
+        // The situation where null buffer is not ok for reshape operator is
+        // only when there are 2 inputs given to the node and the one
+        // corresponding to the shape (i == 1) is a vector that contains all
+        // dimensions. See `GetOutputShape()` function in
+        // `tensorflow/lite/kernels/reshape.cc`
+        continue;
+      } else {
+        // In all other cases, we need to return an error as otherwise we will
+        // trigger a null pointer dereference (likely).
+        ReportError("Input tensor %d lacks data", tensor_index);
+        return kTfLiteError;
+      }
+    }
+  }
+  return kTfLiteOk;
+}
+
 TfLiteStatus Subgraph::InvokeImpl() {
   if (!consistent_) {
     ReportError("Invoke called on model that is not consistent.");
@@ -1602,6 +1676,18 @@ TfLiteStatus Subgraph::InvokeImpl() {
       tflite::OnTfLiteSubgraphInvoke(name_.c_str(), subgraph_index_);
 #endif  // TF_LITE_TENSORFLOW_PROFILER
 
+  // Nodes of the same level run concurrently once the whole graph is prepared
+  // and its tensors are allocated. Profilers expect one operator at a time.
+  if (!inter_op_level_starts_.empty() && profiler_ == nullptr &&
+      !has_dynamic_tensors_ &&
+      next_execution_plan_index_to_prepare_ == execution_plan_.size()) {
+    status = InvokeInterOpParallel();
+#ifdef TF_LITE_TENSORFLOW_PROFILER
+    tflite::OnTfLiteSubgraphInvokeEnd(trace_subgraph);
+#endif  // TF_LITE_TENSORFLOW_PROFILER
+    return status;
+  }
+
   // Invocations are always done in node order.
   // Note that calling Invoke repeatedly will cause the original memory plan to
   // be reused, unless either ResizeInputTensor() or AllocateTensors() has been
@@ -1636,37 +1722,7 @@ TfLiteStatus Subgraph::InvokeImpl() {
     TFLITE_SCOPED_TAGGED_OPERATOR_PROFILE(
         profile_op ? profiler_.get() : nullptr, op_name, node_index);
 
-    for (int i = 0; i < node.inputs->size; ++i) {
-      int tensor_index = node.inputs->data[i];
-      if (tensor_index == kTfLiteOptionalTensor) {
-        continue;
-      }
-      TfLiteTensor* tensor = &tensors_[tensor_index];
-      if (tensor->delegate && tensor->delegate != node.delegate &&
-          tensor->data_is_stale) {
-        TF_LITE_ENSURE_STATUS(EnsureTensorDataIsReadable(tensor_index));
-      }
-      if (tensor->data.raw == nullptr && tensor->bytes > 0) {
-        if (registration.builtin_code == kTfLiteBuiltinReshape && i == 1 &&
-            tensor->dims->size != 1) {
-          // In general, having a tensor here with no buffer will be an error.
-          // However, for the reshape operator, the second input tensor is
-          // sometimes only used for the shape, not for the data. Thus, null
-          // buffer is ok in this situation.
-          // The situation where null buffer is not ok for reshape operator is
-          // only when there are 2 inputs given to the node and the one
-          // corresponding to the shape (i == 1) is a vector that contains all
-          // dimensions. See `GetOutputShape()` function in
-          // `tensorflow/lite/kernels/reshape.cc`
-          continue;
-        } else {
-          // In all other cases, we need to return an error as otherwise we will
-          // trigger a null pointer dereference (likely).
-          ReportError("Input tensor %d lacks data", tensor_index);
-          return kTfLiteError;
-        }
-      }
-    }
+    TF_LITE_ENSURE_STATUS(EnsureNodeInputsAreReadable(node, registration));
     // Allocate dynamic tensors which memory is required to be allocated
     // before executing the node.
     MayAllocateOpOutput(&node);
@@ -1723,6 +1779,159 @@ TfLiteStatus Subgraph::InvokeImpl() {
   return status;
 }
 
+TfLiteStatus Subgraph::InvokeInterOpParallel() {
+  if (!inter_op_thread_pool_ ||
+      inter_op_thread_pool_->num_threads() != NumInterOpThreads()) {
+    inter_op_thread_pool_ =
+        std::make_unique<internal::InterOpThreadPool>(NumInterOpThreads());
+  }
+  std::vector<TfLiteStatus> statuses;
+  for (int level = 0; level + 1 < inter_op_level_starts_.size(); ++level) {
+    const int first = inter_op_level_starts_[level];
+    const int end = inter_op_level_starts_[level + 1];
+    for (int i = first; i < end; ++i) {
+      const auto& [node, registration] =
+          nodes_and_registration_[execution_plan_[i]];
+      TF_LITE_ENSURE_STATUS(EnsureNodeInputsAreReadable(node, registration));
+    }
+
+    if (check_cancelled_func_ != nullptr &&
+        check_cancelled_func_(cancellation_data_)) {
+      ReportError("Client requested cancel during Invoke()");
+      return kTfLiteError;
+    }
+
+    if (continue_invocation_ && !continue_invocation_->test_and_set()) {
+      // `Cancel` is called and cancellation flag is flipped.
+      ReportError("Client requested cancel during Invoke()");
+      return kTfLiteCancelled;
+    }
+
+    // Kernels must not grow `tensors_` while other kernels use it.
+    EnsureTensorsVectorCapacity();
+    tensor_resized_since_op_invoke_ = false;
+    statuses.assign(end - first, kTfLiteOk);
+    auto invoke_node = [&](int i) {
+      const int node_index = execution_plan_[first + i];
+      auto& [node, registration] = nodes_and_registration_[node_index];
+#ifdef TF_LITE_TENSORFLOW_PROFILER
+      tensorflow::profiler::TraceMe* trace_op = tflite::OnTfLiteOpInvoke(
+          GetTFLiteOpName(registration), subgraph_index_, node_index);
+#endif  // TF_LITE_TENSORFLOW_PROFILER
+      statuses[i] = OpInvoke(registration, &node);
+#ifdef TF_LITE_TENSORFLOW_PROFILER
+      tflite::OnTfLiteOpInvokeEnd(trace_op);
+#endif  // TF_LITE_TENSORFLOW_PROFILER
+    };
+    if (end - first == 1) {
+      invoke_node(0);
+    } else {
+      inter_op_thread_pool_->ParallelFor(end - first, invoke_node);
+    }
+
+    for (int i = first; i < end; ++i) {
+      if (statuses[i - first] == kTfLiteOk) continue;
+      const int node_index = execution_plan_[i];
+      const auto& [node, registration] = nodes_and_registration_[node_index];
+      auto err = ReportOpError(&context_, node, registration, node_index,
+                               "failed to invoke");
+      return statuses[i - first] == kTfLiteCancelled ? kTfLiteCancelled : err;
+    }
+  }
+  return kTfLiteOk;
+}
+
+bool Subgraph::IsInterOpBarrier(const TfLiteNode& node,
+                                const TfLiteRegistration& registration) const {
+  // Delegate kernels and custom ops may share state between nodes, e.g. the
+  // backend of the delegate.
+  if (node.delegate != nullptr || node.might_have_side_effect) return true;
+  switch (registration.builtin_code) {
+    case kTfLiteBuiltinCustom:
+    case kTfLiteBuiltinDelegate:
+    case kTfLiteBuiltinIf:
+    case kTfLiteBuiltinWhile:
+    case kTfLiteBuiltinStablehloWhile:
+    case kTfLiteBuiltinCallOnce:
+    // Random ops draw from a shared generator, the order of the draws must
+    // not change from one invocation to the next.
+    case kTfLiteBuiltinRandomUniform:
+    case kTfLiteBuiltinRandomStandardNormal:
+    case kTfLiteBuiltinMultinomial:
+      return true;
+    default:
+      break;
+  }
+  for (const TfLiteIntArray* tensor_indices : {node.inputs, node.outputs}) {
+    for (int i = 0; i < tensor_indices->size; ++i) {
+      const int tensor_index = tensor_indices->data[i];
+      if (tensor_index == kTfLiteOptionalTensor) continue;
+      const TfLiteTensor& tensor = tensors_[tensor_index];
+      if (tensor.is_variable || tensor.type == kTfLiteResource ||
+          tensor.type == kTfLiteVariant) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void Subgraph::PlanInterOpLevels() {
+  inter_op_level_starts_.clear();
+  const int num_nodes = execution_plan_.size();
+  if (NumInterOpThreads() <= 1 || num_nodes <= 1) return;
+
+  // The level of a node is one more than the highest level of the nodes
+  // producing its inputs, so that the nodes of a level don't depend on each
+  // other. Barriers get a level of their own, higher than the level of all the
+  // nodes before them in the execution plan and lower than the level of all
+  // the nodes after them.
+  std::vector<int> tensor_levels(tensors_.size(), -1);
+  std::vector<int> node_levels(num_nodes);
+  int max_level = -1;
+  int barrier_level = -1;
+  for (int i = 0; i < num_nodes; ++i) {
+    const auto& [node, registration] =
+        nodes_and_registration_[execution_plan_[i]];
+    int level = barrier_level + 1;
+    if (IsInterOpBarrier(node, registration)) {
+      level = max_level + 1;
+      barrier_level = level;
+    } else {
+      for (int j = 0; j < node.inputs->size; ++j) {
+        const int tensor_index = node.inputs->data[j];
+        if (tensor_index == kTfLiteOptionalTensor) continue;
+        level = std::max(level, tensor_levels[tensor_index] + 1);
+      }
+    }
+    for (int j = 0; j < node.outputs->size; ++j) {
+      const int tensor_index = node.outputs->data[j];
+      if (tensor_index == kTfLiteOptionalTensor) continue;
+      tensor_levels[tensor_index] = level;
+    }
+    node_levels[i] = level;
+    max_level = std::max(max_level, level);
+  }
+  // Every node has a level of its own, keep the execution plan as is.
+  if (max_level + 1 == num_nodes) return;
+
+  std::vector<int> order(num_nodes);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&node_levels](int a, int b) {
+    return node_levels[a] < node_levels[b];
+  });
+  std::vector<int> execution_plan;
+  execution_plan.reserve(num_nodes);
+  for (int i = 0; i < num_nodes; ++i) {
+    if (i == 0 || node_levels[order[i]] != node_levels[order[i - 1]]) {
+      inter_op_level_starts_.push_back(i);
+    }
+    execution_plan.push_back(execution_plan_[order[i]]);
+  }
+  inter_op_level_starts_.push_back(num_nodes);
+  execution_plan_ = std::move(execution_plan);
+}
+
 TfLiteStatus Subgraph::ResizeTensor(TfLiteContext* context,
                                     TfLiteTensor* tensor,
                                     TfLiteIntArray* new_size) {
@@ -1772,6 +1981,7 @@ TfLiteStatus Subgraph::ResizeTensor(TfLiteContext* context,
 }
 
 void Subgraph::ReportErrorImpl(const char* format, va_list args) {
+  std::lock_guard<std::mutex> lock(error_reporter_mutex_);
   error_reporter_->Report(format, args);
 }
 
@@ -1955,6 +2165,7 @@ TfLiteStatus Subgraph::SetExecutionPlan(const std::vector<int>& new_plan) {
                                   node_index < nodes_and_registration_.size());
   }
   execution_plan_ = new_plan;
+  inter_op_level_starts_.clear();
   return kTfLiteOk;
 }
 
@@ -2093,6 +2304,7 @@ TfLiteStatus Subgraph::UndoAllDelegates() {
   // Reset execution plan.
   execution_plan_ = pre_delegation_execution_plan_;
   pre_delegation_execution_plan_.clear();
+  inter_op_level_starts_.clear();
 
   // Handling FP16 delegation (if applies).
   //
@@ -2395,7 +2607,8 @@ void Subgraph::GetMemoryAllocInfo(SubgraphAllocInfo* alloc_info) const {
 }
 
 std::unique_ptr<GraphInfo> Subgraph::CreateGraphInfo() {
-  return std::unique_ptr<GraphInfo>(new InterpreterInfo(this));
+  return std::unique_ptr<GraphInfo>(
+      new InterpreterInfo(this, &inter_op_level_starts_));
 }
 
 void Subgraph::InitializeTensorReleaseMap() {
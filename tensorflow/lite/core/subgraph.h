@@ -22,6 +22,7 @@ limitations under the License.
 #include <cstdint>
 #include <map>
 #include <memory>
+#include <mutex>  // NOLINT(build/c++11)
 #include <string>
 #include <unordered_set>
 #include <utility>
@@ -33,6 +34,7 @@ limitations under the License.
 #include "tensorflow/lite/core/api/op_resolver.h"
 #include "tensorflow/lite/core/api/profiler.h"
 #include "tensorflow/lite/core/c/common.h"
+#include "tensorflow/lite/core/inter_op_thread_pool.h"
 #include "tensorflow/lite/core/macros.h"
 #include "tensorflow/lite/experimental/resource/initialization_status.h"
 #include "tensorflow/lite/experimental/resource/resource_base.h"
@@ -474,6 +476,28 @@ class Subgraph {
     return (options_ && options_->GetDisableDelegateClustering());
   }
 
+  // WARNING: This is an experimental API and subject to change.
+  // True if the arena of non-persistent tensors should be planned for the
+  // whole subgraph at once.
+  bool ShouldOptimizeArenaPlan() const {
+    return (options_ && options_->GetOptimizeArenaPlan());
+  }
+
+  // WARNING: This is an experimental API and subject to change.
+  // Returns the offsets of the non-persistent tensors planned by the last
+  // `AllocateTensors` with `InterpreterOptions::SetOptimizeArenaPlan`, or an
+  // empty string. Storing it in the model metadata entry named
+  // `ArenaPlanMetadataName(subgraph_index)` lets later loads skip planning.
+  std::string GetSerializedMemoryPlan() const {
+    return memory_planner_ ? memory_planner_->GetSerializedPlan() : "";
+  }
+
+  // WARNING: This is an experimental API and subject to change.
+  // Returns the number of threads used to run independent nodes.
+  int NumInterOpThreads() const {
+    return options_ ? options_->GetNumInterOpThreads() : 1;
+  }
+
   // Retrieves the corresponding TfLiteContext of a subgraph given a subgraph
   // index and switches to the delegate context for this subgraph. If an invalid
   // subgraph index is given, returns kTfLiteError.
@@ -697,6 +721,25 @@ class Subgraph {
   // Does not report invoke status through profiler.
   TfLiteStatus InvokeImpl();
 
+  // Invokes the levels of `inter_op_level_starts_` one after the other, with
+  // the nodes of a level running concurrently on `inter_op_thread_pool_`.
+  TfLiteStatus InvokeInterOpParallel();
+
+  // Copies the inputs of `node` whose data is stale in a delegate back to
+  // CPU memory, and returns an error if an input lacks data.
+  TfLiteStatus EnsureNodeInputsAreReadable(
+      const TfLiteNode& node, const TfLiteRegistration& registration);
+
+  // Groups the nodes of the execution plan into levels of nodes which can run
+  // concurrently, and reorders the execution plan level by level. Does
+  // nothing unless `NumInterOpThreads() > 1`.
+  void PlanInterOpLevels();
+
+  // Returns true if `node` must not run concurrently with any other node,
+  // e.g. because it has side effects.
+  bool IsInterOpBarrier(const TfLiteNode& node,
+                        const TfLiteRegistration& registration) const;
+
   // Allow a delegate to look at the graph and modify the graph to handle
   // parts of the graph themselves. After this is called, the graph may
   // contain new nodes that replace 1 more nodes.
@@ -1046,6 +1089,19 @@ class Subgraph {
 
   std::unique_ptr<MemoryPlanner> memory_planner_;
 
+  // The execution plan is a sequence of levels of nodes which don't depend on
+  // each other. Level `i` is [inter_op_level_starts_[i],
+  // inter_op_level_starts_[i + 1]) in `execution_plan_`. Empty if the nodes
+  // run one after the other.
+  std::vector<int> inter_op_level_starts_;
+
+  // Runs the nodes of a level concurrently. Created with the first level of
+  // more than one node.
+  std::unique_ptr<internal::InterOpThreadPool> inter_op_thread_pool_;
+
+  // Serializes the error reports of nodes running concurrently.
+  std::mutex error_reporter_mutex_;
+
   // Maps tensor index to custom allocation for all applicable tensors.
   std::map<int, TfLiteCustomAllocation> custom_allocations_;
 
@@ -143,7 +143,8 @@ void FullyConnectedTester::Test(TfLiteDelegate* delegate) const {
 
 std::vector<char> FullyConnectedTester::CreateTfLiteModel() const {
   std::random_device random_device;
-  auto rng = std::mt19937(random_device());
+  auto rng = std::mt19937(weights_seed_.has_value() ? *weights_seed_
+                                                    : random_device());
   auto range_rng = std::bind(
       std::uniform_real_distribution<float>(-25.0f, 25.0f), std::ref(rng));
 
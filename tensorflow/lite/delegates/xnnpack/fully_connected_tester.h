@@ -17,6 +17,7 @@ limitations under the License.
 #define TENSORFLOW_LITE_DELEGATES_XNNPACK_FULLY_CONNECTED_TESTER_H_
 
 #include <cstdint>
+#include <optional>
 #include <vector>
 
 #include <gtest/gtest.h>
@@ -143,6 +144,13 @@ class FullyConnectedTester {
     return *this;
   }
 
+  // Generates the weights from `seed` rather than a random seed, so that the
+  // tester creates the same model every time.
+  inline FullyConnectedTester& WeightsSeed(uint32_t seed) {
+    weights_seed_ = seed;
+    return *this;
+  }
+
   void Test(TfLiteDelegate* delegate) const;
 
  private:
@@ -170,6 +178,7 @@ class FullyConnectedTester {
   ::tflite::ActivationFunctionType activation_ =
       ::tflite::ActivationFunctionType_NONE;
   TfLiteXNNPackDelegateWeightsCache* weights_cache_ = nullptr;
+  std::optional<uint32_t> weights_seed_;
 };
 
 }  // namespace xnnpack
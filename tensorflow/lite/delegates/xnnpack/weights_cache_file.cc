@@ -0,0 +1,285 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/lite/delegates/xnnpack/weights_cache_file.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "tensorflow/lite/allocation.h"
+#include "tensorflow/lite/core/api/error_reporter.h"
+#include "tensorflow/lite/core/c/common.h"
+#include "tensorflow/lite/minimal_logging.h"
+
+namespace tflite {
+namespace xnnpack {
+namespace {
+
+constexpr char kMagic[8] = {'T', 'F', 'L', 'X', 'N', 'N', 'W', 'C'};
+constexpr uint32_t kVersion = 2;
+// Written in the byte order of the host.
+constexpr uint32_t kByteOrderMark = 0x01020304;
+
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order_mark;
+  uint64_t num_entries;
+  // Offset of the data of the entries from the start of the file.
+  uint64_t data_offset;
+  uint64_t data_size;
+};
+
+struct FileEntry {
+  uint64_t subgraph_key;
+  uint64_t fingerprint;
+  int32_t tensor_index;
+  uint32_t reserved;
+  // Offset of the data from `FileHeader::data_offset`.
+  uint64_t offset;
+  uint64_t size;
+};
+
+size_t AlignTo(size_t alignment, size_t offset) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+// Mapping a missing file isn't an error, don't let MMAPAllocation log it.
+class SilentErrorReporter : public ErrorReporter {
+ public:
+  int Report(const char*, va_list) override { return 0; }
+};
+
+uint64_t RotateLeft(uint64_t value, int shift) {
+  return (value << shift) | (value >> (64 - shift));
+}
+
+}  // namespace
+
+uint64_t FingerprintBytes(const void* data, size_t size, uint64_t seed) {
+  // 64-bit FNV-1a over words of 8 bytes, with each word multiplied and the
+  // hash rotated so that every bit of a word affects the whole hash.
+  constexpr uint64_t kPrime = 0x100000001b3ULL;
+  constexpr uint64_t kWordMultiplier = 0x9e3779b97f4a7c15ULL;
+  uint64_t hash = seed ^ 0xcbf29ce484222325ULL;
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+    uint64_t word;
+    std::memcpy(&word, bytes + i, sizeof(word));
+    hash = RotateLeft(hash ^ (word * kWordMultiplier), 31) * kPrime;
+  }
+  for (; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * kPrime;
+  }
+  return hash;
+}
+
+uint64_t FingerprintTensor(const TfLiteTensor& tensor, uint64_t seed) {
+  uint64_t hash = FingerprintBytes(&tensor.type, sizeof(tensor.type), seed);
+  hash = FingerprintBytes(&tensor.bytes, sizeof(tensor.bytes), hash);
+  if (tensor.dims != nullptr) {
+    hash = FingerprintBytes(tensor.dims->data,
+                            tensor.dims->size * sizeof(int), hash);
+  }
+  hash = FingerprintBytes(&tensor.params, sizeof(tensor.params), hash);
+  if (tensor.quantization.type == kTfLiteAffineQuantization &&
+      tensor.quantization.params != nullptr) {
+    const auto* params = static_cast<const TfLiteAffineQuantization*>(
+        tensor.quantization.params);
+    if (params->scale != nullptr) {
+      hash = FingerprintBytes(params->scale->data,
+                              params->scale->size * sizeof(float), hash);
+    }
+    if (params->zero_point != nullptr) {
+      hash = FingerprintBytes(params->zero_point->data,
+                              params->zero_point->size * sizeof(int), hash);
+    }
+    hash = FingerprintBytes(&params->quantized_dimension,
+                            sizeof(params->quantized_dimension), hash);
+  }
+  if (tensor.sparsity != nullptr) {
+    const TfLiteSparsity& sparsity = *tensor.sparsity;
+    const auto hash_array = [&hash](const TfLiteIntArray* array) {
+      if (array != nullptr) {
+        hash = FingerprintBytes(array->data, array->size * sizeof(int), hash);
+      }
+    };
+    hash_array(sparsity.traversal_order);
+    hash_array(sparsity.block_map);
+    for (int i = 0; i < sparsity.dim_metadata_size; ++i) {
+      const TfLiteDimensionMetadata& metadata = sparsity.dim_metadata[i];
+      hash = FingerprintBytes(&metadata.format, sizeof(metadata.format), hash);
+      hash = FingerprintBytes(&metadata.dense_size, sizeof(metadata.dense_size),
+                              hash);
+      hash_array(metadata.array_segments);
+      hash_array(metadata.array_indices);
+    }
+  }
+  if (tensor.data.raw_const == nullptr) return hash;
+  return FingerprintBytes(tensor.data.raw_const, tensor.bytes, hash);
+}
+
+size_t WeightsCacheFile::EntryKeyHash::operator()(const EntryKey& key) const {
+  return FingerprintBytes(&key.tensor_index, sizeof(key.tensor_index),
+                          key.subgraph_key);
+}
+
+std::unique_ptr<WeightsCacheFile> WeightsCacheFile::Load(const char* path) {
+  if (!MMAPAllocation::IsSupported()) return nullptr;
+  if (FILE* file = std::fopen(path, "rb")) {
+    std::fclose(file);
+  } else {
+    return nullptr;
+  }
+  SilentErrorReporter error_reporter;
+  auto allocation = std::make_unique<MMAPAllocation>(path, &error_reporter);
+  if (!allocation->valid()) return nullptr;
+
+  const char* base = static_cast<const char*>(allocation->base());
+  const size_t file_size = allocation->bytes();
+  FileHeader header;
+  if (file_size < sizeof(header)) return nullptr;
+  std::memcpy(&header, base, sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kVersion ||
+      header.byte_order_mark != kByteOrderMark ||
+      header.num_entries > (file_size - sizeof(header)) / sizeof(FileEntry) ||
+      header.data_offset % kWeightsCacheFileAlignment != 0 ||
+      header.data_offset <
+          sizeof(header) + header.num_entries * sizeof(FileEntry) ||
+      header.data_offset > file_size ||
+      header.data_size > file_size - header.data_offset ||
+      header.data_size < kWeightsCacheFileAlignment) {
+    TFLITE_LOG_PROD(TFLITE_LOG_WARNING,
+                    "Ignoring invalid XNNPACK weights cache file %s.", path);
+    return nullptr;
+  }
+
+  std::unique_ptr<WeightsCacheFile> cache_file(
+      new WeightsCacheFile(std::move(allocation)));
+  const char* data = base + header.data_offset;
+  // The data of each entry is followed by readable padding.
+  const uint64_t max_end = header.data_size - kWeightsCacheFileAlignment;
+  for (uint64_t i = 0; i < header.num_entries; ++i) {
+    FileEntry file_entry;
+    std::memcpy(&file_entry, base + sizeof(header) + i * sizeof(FileEntry),
+                sizeof(file_entry));
+    if (file_entry.offset > max_end ||
+        file_entry.size > max_end - file_entry.offset) {
+      TFLITE_LOG_PROD(TFLITE_LOG_WARNING,
+                      "Ignoring invalid XNNPACK weights cache file %s.", path);
+      return nullptr;
+    }
+    WeightsCacheEntry entry;
+    entry.subgraph_key = file_entry.subgraph_key;
+    entry.fingerprint = file_entry.fingerprint;
+    entry.tensor_index = file_entry.tensor_index;
+    entry.data = data + file_entry.offset;
+    entry.size = file_entry.size;
+    cache_file->entry_indices_[{entry.subgraph_key, entry.tensor_index}] =
+        cache_file->entries_.size();
+    cache_file->entries_.push_back(entry);
+  }
+  return cache_file;
+}
+
+bool WeightsCacheFile::Write(const char* path,
+                             const std::vector<WeightsCacheEntry>& entries) {
+  FileHeader header;
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.byte_order_mark = kByteOrderMark;
+  header.num_entries = entries.size();
+  header.data_offset =
+      AlignTo(kWeightsCacheFileAlignment,
+              sizeof(header) + entries.size() * sizeof(FileEntry));
+
+  std::vector<FileEntry> file_entries;
+  file_entries.reserve(entries.size());
+  uint64_t data_size = 0;
+  for (const WeightsCacheEntry& entry : entries) {
+    FileEntry file_entry;
+    file_entry.subgraph_key = entry.subgraph_key;
+    file_entry.fingerprint = entry.fingerprint;
+    file_entry.tensor_index = entry.tensor_index;
+    file_entry.reserved = 0;
+    file_entry.offset = AlignTo(kWeightsCacheFileAlignment, data_size);
+    file_entry.size = entry.size;
+    data_size = file_entry.offset + entry.size;
+    file_entries.push_back(file_entry);
+  }
+  // Readers may read a few bytes past the end of the last entry.
+  header.data_size = data_size + kWeightsCacheFileAlignment;
+
+  // Write to a file of a random name in the same directory, then rename it.
+  std::random_device random_device;
+  const std::string temp_path = std::string(path) + ".tmp" +
+                                std::to_string(random_device()) +
+                                std::to_string(random_device());
+  {
+    std::ofstream output(temp_path, std::ios::binary | std::ios::trunc);
+    const std::vector<char> padding(kWeightsCacheFileAlignment, 0);
+    auto write_padding = [&](uint64_t from, uint64_t to) {
+      while (from < to) {
+        const size_t size =
+            std::min<uint64_t>(to - from, kWeightsCacheFileAlignment);
+        output.write(padding.data(), size);
+        from += size;
+      }
+    };
+    output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    output.write(reinterpret_cast<const char*>(file_entries.data()),
+                 file_entries.size() * sizeof(FileEntry));
+    write_padding(sizeof(header) + file_entries.size() * sizeof(FileEntry),
+                  header.data_offset);
+    uint64_t offset = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+      write_padding(offset, file_entries[i].offset);
+      output.write(entries[i].data, entries[i].size);
+      offset = file_entries[i].offset + entries[i].size;
+    }
+    write_padding(offset, header.data_size);
+    output.close();
+    if (!output) {
+      std::remove(temp_path.c_str());
+      return false;
+    }
+  }
+  if (std::rename(temp_path.c_str(), path) != 0) {
+    std::remove(temp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+const char* WeightsCacheFile::Find(uint64_t subgraph_key, int tensor_index,
+                                   uint64_t fingerprint, size_t size) const {
+  const auto it = entry_indices_.find({subgraph_key, tensor_index});
+  if (it == entry_indices_.end()) return nullptr;
+  const WeightsCacheEntry& entry = entries_[it->second];
+  if (entry.fingerprint != fingerprint || entry.size != size) return nullptr;
+  return entry.data;
+}
+
+}  // namespace xnnpack
+}  // namespace tflite
@@ -0,0 +1,113 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LITE_DELEGATES_XNNPACK_WEIGHTS_CACHE_FILE_H_
+#define TENSORFLOW_LITE_DELEGATES_XNNPACK_WEIGHTS_CACHE_FILE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/lite/allocation.h"
+#include "tensorflow/lite/core/c/common.h"
+
+namespace tflite {
+namespace xnnpack {
+
+constexpr size_t kWeightsCacheFileAlignment = 64;
+
+// Data of a quasi-static tensor, i.e. a tensor the delegate unpacks from
+// static weights, e.g. by dequantizing FP16 weights or densifying sparse
+// weights.
+struct WeightsCacheEntry {
+  // Identifies the subgraph of the tensor, tensor indices are only unique
+  // within a subgraph.
+  uint64_t subgraph_key = 0;
+  // Fingerprint of the static weights the data was unpacked from and of the
+  // way they were unpacked. See FingerprintTensor.
+  uint64_t fingerprint = 0;
+  int tensor_index = -1;
+  const char* data = nullptr;
+  size_t size = 0;
+};
+
+// A file of unpacked quasi-static tensors, written once and memory-mapped
+// read-only by every process which delegates the same model, so that they
+// skip unpacking and share the unpacked data in the page cache.
+//
+// The file starts with a header and a table of entries, followed by the data
+// of the entries, each aligned to kWeightsCacheFileAlignment bytes from the
+// start of the file and followed by at least kWeightsCacheFileAlignment
+// readable bytes. It uses the byte order of the host which wrote it and is
+// rejected on a host with another byte order.
+class WeightsCacheFile {
+ public:
+  // Maps the file at `path`. Returns nullptr if it doesn't exist, can't be
+  // mapped on this platform, or isn't a valid weights cache file.
+  static std::unique_ptr<WeightsCacheFile> Load(const char* path);
+
+  // Writes `entries` to a new file which then atomically replaces the file at
+  // `path`, if any, so that processes loading the file concurrently see
+  // either the old or the new file. Returns false on error.
+  static bool Write(const char* path,
+                    const std::vector<WeightsCacheEntry>& entries);
+
+  // Returns the data of the entry matching all the arguments, or nullptr.
+  const char* Find(uint64_t subgraph_key, int tensor_index,
+                   uint64_t fingerprint, size_t size) const;
+
+  // The entries of the file, whose data point into the mapped file.
+  const std::vector<WeightsCacheEntry>& entries() const { return entries_; }
+
+ private:
+  explicit WeightsCacheFile(std::unique_ptr<Allocation> allocation)
+      : allocation_(std::move(allocation)) {}
+
+  struct EntryKey {
+    uint64_t subgraph_key;
+    int tensor_index;
+    bool operator==(const EntryKey& other) const {
+      return subgraph_key == other.subgraph_key &&
+             tensor_index == other.tensor_index;
+    }
+  };
+  struct EntryKeyHash {
+    size_t operator()(const EntryKey& key) const;
+  };
+
+  std::unique_ptr<Allocation> allocation_;
+  std::vector<WeightsCacheEntry> entries_;
+  // Index in `entries_` of the entry of each tensor.
+  std::unordered_map<EntryKey, size_t, EntryKeyHash> entry_indices_;
+};
+
+// Returns a fingerprint of `tensor` combined with `seed`. It covers the type,
+// shape, quantization and sparsity parameters and size of the tensor, and all
+// of its data.
+uint64_t FingerprintTensor(const TfLiteTensor& tensor, uint64_t seed);
+
+// Returns a fingerprint of `size` bytes at `data` combined with `seed`. It
+// reads the data 8 bytes at a time, so that fingerprinting weights costs
+// less than unpacking them.
+uint64_t FingerprintBytes(const void* data, size_t size, uint64_t seed);
+
+}  // namespace xnnpack
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_DELEGATES_XNNPACK_WEIGHTS_CACHE_FILE_H_
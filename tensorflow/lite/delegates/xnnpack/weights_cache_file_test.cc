@@ -0,0 +1,243 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/lite/delegates/xnnpack/weights_cache_file.h"
+
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "tensorflow/lite/core/c/common.h"
+#include "tensorflow/lite/delegates/xnnpack/fully_connected_tester.h"
+#include "tensorflow/lite/delegates/xnnpack/xnnpack_delegate.h"
+
+namespace tflite {
+namespace xnnpack {
+namespace {
+
+std::string TempPath(const char* name) {
+  return ::testing::TempDir() + "/" + name;
+}
+
+TEST(WeightsCacheFile, WriteAndLoad) {
+  const std::string path = TempPath("write_and_load.xnnpack_cache");
+  const std::vector<char> first(100, 'a');
+  const std::vector<char> second(3, 'b');
+  std::vector<WeightsCacheEntry> entries(2);
+  entries[0].subgraph_key = 1;
+  entries[0].fingerprint = 2;
+  entries[0].tensor_index = 3;
+  entries[0].data = first.data();
+  entries[0].size = first.size();
+  entries[1].subgraph_key = 1;
+  entries[1].fingerprint = 4;
+  entries[1].tensor_index = 5;
+  entries[1].data = second.data();
+  entries[1].size = second.size();
+  ASSERT_TRUE(WeightsCacheFile::Write(path.c_str(), entries));
+
+  std::unique_ptr<WeightsCacheFile> file =
+      WeightsCacheFile::Load(path.c_str());
+  ASSERT_NE(file, nullptr);
+  ASSERT_EQ(file->entries().size(), 2);
+  for (const WeightsCacheEntry& entry : file->entries()) {
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(entry.data) %
+                  kWeightsCacheFileAlignment,
+              0);
+  }
+  const char* data = file->Find(1, 3, 2, first.size());
+  ASSERT_NE(data, nullptr);
+  EXPECT_EQ(std::memcmp(data, first.data(), first.size()), 0);
+  data = file->Find(1, 5, 4, second.size());
+  ASSERT_NE(data, nullptr);
+  EXPECT_EQ(std::memcmp(data, second.data(), second.size()), 0);
+
+  EXPECT_EQ(file->Find(2, 3, 2, first.size()), nullptr);
+  EXPECT_EQ(file->Find(1, 4, 2, first.size()), nullptr);
+  EXPECT_EQ(file->Find(1, 3, 3, first.size()), nullptr);
+  EXPECT_EQ(file->Find(1, 3, 2, first.size() + 1), nullptr);
+  std::remove(path.c_str());
+}
+
+TEST(WeightsCacheFile, ReplaceLoadedFile) {
+  const std::string path = TempPath("replace_loaded_file.xnnpack_cache");
+  const std::vector<char> old_data(16, 'a');
+  std::vector<WeightsCacheEntry> entries(1);
+  entries[0].data = old_data.data();
+  entries[0].size = old_data.size();
+  ASSERT_TRUE(WeightsCacheFile::Write(path.c_str(), entries));
+  std::unique_ptr<WeightsCacheFile> old_file =
+      WeightsCacheFile::Load(path.c_str());
+  ASSERT_NE(old_file, nullptr);
+
+  const std::vector<char> new_data(16, 'b');
+  entries[0].data = new_data.data();
+  ASSERT_TRUE(WeightsCacheFile::Write(path.c_str(), entries));
+  std::unique_ptr<WeightsCacheFile> new_file =
+      WeightsCacheFile::Load(path.c_str());
+  ASSERT_NE(new_file, nullptr);
+
+  // The data of the old file stays valid.
+  EXPECT_EQ(std::memcmp(old_file->entries()[0].data, old_data.data(),
+                        old_data.size()),
+            0);
+  EXPECT_EQ(std::memcmp(new_file->entries()[0].data, new_data.data(),
+                        new_data.size()),
+            0);
+  std::remove(path.c_str());
+}
+
+TEST(WeightsCacheFile, RejectsInvalidFiles) {
+  EXPECT_EQ(WeightsCacheFile::Load(TempPath("missing").c_str()), nullptr);
+
+  const std::string path = TempPath("invalid.xnnpack_cache");
+  {
+    std::ofstream output(path, std::ios::binary);
+    output << "not a weights cache file, but long enough to hold a header";
+  }
+  EXPECT_EQ(WeightsCacheFile::Load(path.c_str()), nullptr);
+
+  // Truncated data.
+  const std::vector<char> data(1000, 'a');
+  std::vector<WeightsCacheEntry> entries(1);
+  entries[0].data = data.data();
+  entries[0].size = data.size();
+  ASSERT_TRUE(WeightsCacheFile::Write(path.c_str(), entries));
+  std::vector<char> contents;
+  {
+    std::ifstream input(path, std::ios::binary);
+    contents.assign(std::istreambuf_iterator<char>(input),
+                    std::istreambuf_iterator<char>());
+  }
+  {
+    std::ofstream output(path, std::ios::binary | std::ios::trunc);
+    output.write(contents.data(), contents.size() / 2);
+  }
+  EXPECT_EQ(WeightsCacheFile::Load(path.c_str()), nullptr);
+  std::remove(path.c_str());
+}
+
+TEST(WeightsCacheFile, FingerprintTensor) {
+  std::vector<float> data(100000, 1.0f);
+  TfLiteIntArray* dims = TfLiteIntArrayCreate(2);
+  dims->data[0] = 1;
+  dims->data[1] = 100000;
+  TfLiteTensor tensor = {};
+  tensor.type = kTfLiteFloat32;
+  tensor.dims = dims;
+  tensor.bytes = data.size() * sizeof(float);
+  tensor.data.f = data.data();
+
+  const uint64_t fingerprint = FingerprintTensor(tensor, 0);
+  EXPECT_EQ(FingerprintTensor(tensor, 0), fingerprint);
+  EXPECT_NE(FingerprintTensor(tensor, 1), fingerprint);
+
+  data.front() = 2.0f;
+  EXPECT_NE(FingerprintTensor(tensor, 0), fingerprint);
+  data.front() = 1.0f;
+  data.back() = 2.0f;
+  EXPECT_NE(FingerprintTensor(tensor, 0), fingerprint);
+  data.back() = 1.0f;
+  // Every element is covered, not only a sample of the data.
+  for (size_t i = 1; i + 1 < data.size(); i += 997) {
+    data[i] = 2.0f;
+    EXPECT_NE(FingerprintTensor(tensor, 0), fingerprint) << i;
+    data[i] = 1.0f;
+  }
+
+  dims->data[0] = 100000;
+  dims->data[1] = 1;
+  EXPECT_NE(FingerprintTensor(tensor, 0), fingerprint);
+  dims->data[0] = 1;
+  dims->data[1] = 100000;
+  EXPECT_EQ(FingerprintTensor(tensor, 0), fingerprint);
+
+  tensor.type = kTfLiteInt32;
+  EXPECT_NE(FingerprintTensor(tensor, 0), fingerprint);
+  TfLiteIntArrayFree(dims);
+}
+
+// Returns the inode of the file `path`, which a rewrite of the file changes
+// since it is renamed over the old one.
+ino_t FileInode(const std::string& path) {
+  struct stat st;
+  EXPECT_EQ(stat(path.c_str(), &st), 0) << path;
+  return st.st_ino;
+}
+
+TEST(WeightsCacheFile, Delegate) {
+  const std::string path = TempPath("delegate.xnnpack_cache");
+  std::remove(path.c_str());
+  TfLiteXNNPackDelegateOptions options = TfLiteXNNPackDelegateOptionsDefault();
+  options.experimental_weights_cache_file_path = path.c_str();
+
+  std::random_device random_device;
+  auto rng = std::mt19937(random_device());
+  auto channels_rng =
+      std::bind(std::uniform_int_distribution<int32_t>(2, 9), std::ref(rng));
+  const auto input_channels = channels_rng();
+  const auto output_channels = channels_rng();
+  FullyConnectedTester tester;
+  tester.InputShape({3, input_channels})
+      .InputChannels(input_channels)
+      .OutputChannels(output_channels)
+      .FP16Weights()
+      .WeightsSeed(1);
+  auto test_delegate = [&]() {
+    std::unique_ptr<TfLiteDelegate, decltype(&TfLiteXNNPackDelegateDelete)>
+        xnnpack_delegate(TfLiteXNNPackDelegateCreate(&options),
+                         TfLiteXNNPackDelegateDelete);
+    // Compares the outputs of the delegate with those of the reference
+    // kernels.
+    tester.Test(xnnpack_delegate.get());
+  };
+
+  test_delegate();
+  const std::unique_ptr<WeightsCacheFile> file =
+      WeightsCacheFile::Load(path.c_str());
+  ASSERT_NE(file, nullptr);
+  const size_t num_entries = file->entries().size();
+  EXPECT_GT(num_entries, 0);
+  const ino_t inode = FileInode(path);
+
+  // The same model reuses the weights of the file, without rewriting it.
+  test_delegate();
+  EXPECT_EQ(FileInode(path), inode);
+  std::unique_ptr<WeightsCacheFile> reused =
+      WeightsCacheFile::Load(path.c_str());
+  ASSERT_NE(reused, nullptr);
+  EXPECT_EQ(reused->entries().size(), num_entries);
+
+  // A model with other weights does not match the file, which is replaced.
+  tester.WeightsSeed(2);
+  test_delegate();
+  EXPECT_NE(FileInode(path), inode);
+  EXPECT_NE(WeightsCacheFile::Load(path.c_str()), nullptr);
+  std::remove(path.c_str());
+}
+
+}  // namespace
+}  // namespace xnnpack
+}  // namespace tflite
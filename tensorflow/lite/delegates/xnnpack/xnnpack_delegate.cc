@@ -37,6 +37,7 @@ limitations under the License.
 #include "tensorflow/lite/core/c/builtin_op_data.h"
 #include "tensorflow/lite/core/c/common.h"
 #include "tensorflow/lite/delegates/xnnpack/quantization_util.h"
+#include "tensorflow/lite/delegates/xnnpack/weights_cache_file.h"
 #include "tensorflow/lite/kernels/cpu_backend_context.h"
 #include "tensorflow/lite/kernels/internal/compatibility.h"
 #include "tensorflow/lite/kernels/internal/tensor_ctypes.h"
@@ -463,6 +464,62 @@ class VariableHolder {
   std::map<uint32_t, const TfLiteTensor*> global_id_to_dims_and_type_;
 };
 
+// Location of the unpacked data of a quasi-static tensor.
+struct QuasiStaticData {
+  // Offset of the data within Delegate::static_unpacked_data_, unless the data
+  // is in a weights cache file.
+  size_t offset = 0;
+  // Data in a weights cache file, or nullptr.
+  const char* cached_data = nullptr;
+  size_t size = 0;
+  // Fingerprint of the static data the tensor was unpacked from, see
+  // FingerprintTensor.
+  uint64_t fingerprint = 0;
+};
+
+// Returns a key identifying a subgraph in a weights cache file. Tensor indices
+// identify tensors within a subgraph only, so the key covers the whole
+// structure of the model: the type and shape of every tensor, and the
+// operators of the execution plan with their inputs and outputs.
+uint64_t WeightsCacheSubgraphKey(TfLiteContext* context,
+                                 const TfLiteIntArray* execution_plan) {
+  const auto hash_array = [](const TfLiteIntArray* array, uint64_t hash) {
+    if (array == nullptr) return hash;
+    hash = FingerprintBytes(&array->size, sizeof(array->size), hash);
+    return FingerprintBytes(array->data, array->size * sizeof(int), hash);
+  };
+  uint64_t hash = FingerprintBytes(&context->tensors_size,
+                                   sizeof(context->tensors_size), 0);
+  for (size_t t = 0; t < context->tensors_size; ++t) {
+    const TfLiteTensor& tensor = context->tensors[t];
+    hash = FingerprintBytes(&tensor.type, sizeof(tensor.type), hash);
+    hash = FingerprintBytes(&tensor.allocation_type,
+                            sizeof(tensor.allocation_type), hash);
+    hash = FingerprintBytes(&tensor.bytes, sizeof(tensor.bytes), hash);
+    hash = hash_array(tensor.dims, hash);
+  }
+  hash = hash_array(execution_plan, hash);
+  for (int i = 0; i < execution_plan->size; ++i) {
+    TfLiteNode* node = nullptr;
+    TfLiteRegistration* registration = nullptr;
+    if (context->GetNodeAndRegistration(context, execution_plan->data[i],
+                                        &node, &registration) != kTfLiteOk) {
+      continue;
+    }
+    hash = FingerprintBytes(&registration->builtin_code,
+                            sizeof(registration->builtin_code), hash);
+    hash = FingerprintBytes(&registration->version,
+                            sizeof(registration->version), hash);
+    if (registration->custom_name != nullptr) {
+      hash = FingerprintBytes(registration->custom_name,
+                              std::strlen(registration->custom_name), hash);
+    }
+    hash = hash_array(node->inputs, hash);
+    hash = hash_array(node->outputs, hash);
+  }
+  return hash;
+}
+
 class Delegate {
   friend class Subgraph;
 
@@ -499,6 +556,11 @@ class Delegate {
 
     options_ =
         options != nullptr ? *options : TfLiteXNNPackDelegateOptionsDefault();
+    if (options_.experimental_weights_cache_file_path != nullptr) {
+      weights_cache_file_path_ = options_.experimental_weights_cache_file_path;
+      options_.experimental_weights_cache_file_path =
+          weights_cache_file_path_.c_str();
+    }
     workspace_.reset(workspace);
   }
 
@@ -578,6 +640,13 @@ class Delegate {
 
   xnn_workspace_t workspace() const { return workspace_.get(); }
 
+  // Returns the unpacked data of a quasi-static tensor.
+  const char* static_unpacked_data(const QuasiStaticData& data) const {
+    return data.cached_data != nullptr
+               ? data.cached_data
+               : static_unpacked_data_.data() + data.offset;
+  }
+
   TfLiteStatus AssociateVariableWithTensor(int local_id,
                                            const TfLiteTensor* tensor,
                                            TfLiteContext* logging_context) {
@@ -634,12 +703,25 @@ class Delegate {
       kTfLiteDelegateFlagsPerOperatorProfiling,  // .flags
   };
 
+  // Writes the data of the quasi-static tensors of the subgraph identified
+  // by `subgraph_key` to the weights cache file, along with the data of the
+  // other subgraphs in `previous_file`, if any. Then maps the new file and
+  // uses its data instead of the data in static_unpacked_data_.
+  void WriteWeightsCacheFile(uint64_t subgraph_key,
+                             const WeightsCacheFile* previous_file);
+
   // Unpacked data for quasi-static tensors, i.e. tensors produced by
   // dequantizing or unpacking static buffers.
   std::vector<char> static_unpacked_data_;
-  // Mapping from a tensor index for a quasi-static tensor to the offset to
-  // its unpacked data within static_unpacked_data_.
-  std::unordered_map<int, size_t> static_unpacked_data_map_;
+  // Mapping from a tensor index for a quasi-static tensor to its unpacked
+  // data.
+  std::unordered_map<int, QuasiStaticData> static_unpacked_data_map_;
+  // Weights cache files holding the data of quasi-static tensors, see
+  // TfLiteXNNPackDelegateOptions::experimental_weights_cache_file_path. The
+  // file is loaded again for each delegated subgraph, since a previous
+  // subgraph may have rewritten it.
+  std::vector<std::unique_ptr<WeightsCacheFile>> weights_cache_files_;
+  std::string weights_cache_file_path_;
   // Set of indices of nodes which unpack static data, e.g. Dequantize
   // operators which convert FP16 static weights to FP32. These nodes are simply
   // ignored in the delegate implementation, because their outputs are
@@ -923,7 +1005,7 @@ class Subgraph {
         // Check for quasi-static data.
         const auto it = delegate.static_unpacked_data_map_.find(t);
         if (it != delegate.static_unpacked_data_map_.end()) {
-          data = delegate.static_unpacked_data_.data() + it->second;
+          data = delegate.static_unpacked_data(it->second);
         }
       }
       if (inputs.count(t) != 0) {
@@ -986,8 +1068,7 @@ class Subgraph {
 
     // Create a set of quasi-static tensors for VisitNode function
     std::unordered_set<int> quasi_static_tensors;
-    for (const std::pair<const int, size_t>& entry :
-         delegate.static_unpacked_data_map_) {
+    for (const auto& entry : delegate.static_unpacked_data_map_) {
       quasi_static_tensors.insert(entry.first);
     }
 
@@ -6388,6 +6469,7 @@ TfLiteIntArray* Delegate::PrepareOpsToDelegate(TfLiteContext* context) {
   // Clear previous data, in case the delegate is reused without re-creation.
   static_unpacked_data_map_.clear();
   static_unpacked_data_.clear();
+  weights_cache_files_.clear();
   static_unpack_nodes_.clear();
   static_sparse_weights_.clear();
   variable_holder_.ClearTensorIdToGlobalId();
@@ -6554,6 +6636,21 @@ TfLiteIntArray* Delegate::PrepareOpsToDelegate(TfLiteContext* context) {
                      quasi_static_tensors_producers[t2];
             });
 
+  // Data of the quasi-static tensors unpacked by a previous run.
+  const WeightsCacheFile* weights_cache_file = nullptr;
+  uint64_t subgraph_key = 0;
+  bool weights_cache_file_is_complete = true;
+  if (!weights_cache_file_path_.empty() &&
+      !sorted_quasi_static_tensors_to_unpack.empty()) {
+    subgraph_key = WeightsCacheSubgraphKey(context, execution_plan);
+    std::unique_ptr<WeightsCacheFile> file =
+        WeightsCacheFile::Load(weights_cache_file_path_.c_str());
+    if (file != nullptr) {
+      weights_cache_file = file.get();
+      weights_cache_files_.push_back(std::move(file));
+    }
+  }
+
   // Unpack static data of all tensors
   for (int t : sorted_quasi_static_tensors_to_unpack) {
     const int producer_index = quasi_static_tensors_producers[t];
@@ -6607,6 +6704,15 @@ TfLiteIntArray* Delegate::PrepareOpsToDelegate(TfLiteContext* context) {
     }
 
     const TfLiteTensor& output_tensor = context->tensors[t];
+    // The unpacked data depends on the unpacked tensor, its producer and the
+    // data it is unpacked from.
+    QuasiStaticData quasi_static_data;
+    quasi_static_data.size = output_tensor.bytes;
+    quasi_static_data.fingerprint = FingerprintTensor(
+        output_tensor,
+        static_unpacked_input_it_ != static_unpacked_data_map_.end()
+            ? static_unpacked_input_it_->second.fingerprint
+            : FingerprintTensor(input_tensor, registration->builtin_code));
     size_t tensor_elements = output_tensor.bytes;
     switch (output_tensor.type) {
       case kTfLiteFloat32:
@@ -6628,6 +6734,18 @@ TfLiteIntArray* Delegate::PrepareOpsToDelegate(TfLiteContext* context) {
       }
     }
 
+    if (weights_cache_file != nullptr) {
+      quasi_static_data.cached_data =
+          weights_cache_file->Find(subgraph_key, t,
+                                   quasi_static_data.fingerprint,
+                                   quasi_static_data.size);
+      if (quasi_static_data.cached_data != nullptr) {
+        static_unpacked_data_map_[t] = quasi_static_data;
+        continue;
+      }
+    }
+    weights_cache_file_is_complete = false;
+
     // Align to XNN_EXTRA_BYTES bytes
     while (static_unpacked_data_.size() % XNN_EXTRA_BYTES != 0) {
       static_unpacked_data_.push_back(0);
@@ -6638,7 +6756,7 @@ TfLiteIntArray* Delegate::PrepareOpsToDelegate(TfLiteContext* context) {
     char* unpacked_data = static_unpacked_data_.data() + tensor_offset;
     const char* packed_data =
         static_unpacked_input_it_ != static_unpacked_data_map_.end()
-            ? static_unpacked_data_.data() + static_unpacked_input_it_->second
+            ? static_unpacked_data(static_unpacked_input_it_->second)
             : static_cast<const char*>(input_tensor.data.data);
     switch (registration->builtin_code) {
       case kTfLiteBuiltinDequantize: {
@@ -6744,7 +6862,12 @@ TfLiteIntArray* Delegate::PrepareOpsToDelegate(TfLiteContext* context) {
         return nullptr;  // Hard error.
     }
 
-    static_unpacked_data_map_[t] = tensor_offset;
+    quasi_static_data.offset = tensor_offset;
+    static_unpacked_data_map_[t] = quasi_static_data;
+  }
+
+  if (!weights_cache_file_path_.empty() && !weights_cache_file_is_complete) {
+    WriteWeightsCacheFile(subgraph_key, weights_cache_file);
   }
 
   // Add nodes that unpack static data consumed by delegated nodes.
@@ -6774,6 +6897,54 @@ TfLiteIntArray* Delegate::PrepareOpsToDelegate(TfLiteContext* context) {
   return nodes_to_delegate;
 }
 
+void Delegate::WriteWeightsCacheFile(uint64_t subgraph_key,
+                                     const WeightsCacheFile* previous_file) {
+  std::vector<WeightsCacheEntry> entries;
+  if (previous_file != nullptr) {
+    for (const WeightsCacheEntry& entry : previous_file->entries()) {
+      if (entry.subgraph_key != subgraph_key) {
+        entries.push_back(entry);
+      }
+    }
+  }
+  for (const auto& [tensor_index, data] : static_unpacked_data_map_) {
+    WeightsCacheEntry entry;
+    entry.subgraph_key = subgraph_key;
+    entry.fingerprint = data.fingerprint;
+    entry.tensor_index = tensor_index;
+    entry.data = static_unpacked_data(data);
+    entry.size = data.size;
+    entries.push_back(entry);
+  }
+  if (!WeightsCacheFile::Write(weights_cache_file_path_.c_str(), entries)) {
+    TFLITE_LOG_PROD(tflite::TFLITE_LOG_WARNING,
+                    "Failed to write XNNPACK weights cache file %s.",
+                    weights_cache_file_path_.c_str());
+    return;
+  }
+
+  // Share the data of the new file with the other processes rather than keep
+  // a private copy.
+  std::unique_ptr<WeightsCacheFile> file =
+      WeightsCacheFile::Load(weights_cache_file_path_.c_str());
+  if (file == nullptr) return;
+  std::unordered_map<int, const char*> cached_data;
+  for (const auto& [tensor_index, data] : static_unpacked_data_map_) {
+    if (data.cached_data != nullptr) continue;
+    const char* tensor_data =
+        file->Find(subgraph_key, tensor_index, data.fingerprint, data.size);
+    // Another process may have replaced the file in the meantime.
+    if (tensor_data == nullptr) return;
+    cached_data[tensor_index] = tensor_data;
+  }
+  for (const auto& [tensor_index, tensor_data] : cached_data) {
+    static_unpacked_data_map_[tensor_index].cached_data = tensor_data;
+  }
+  weights_cache_files_.push_back(std::move(file));
+  static_unpacked_data_.clear();
+  static_unpacked_data_.shrink_to_fit();
+}
+
 void* SubgraphInit(TfLiteContext* context, const char* buffer, size_t length) {
   const TfLiteDelegateParams* params =
       reinterpret_cast<const TfLiteDelegateParams*>(buffer);
@@ -66,6 +66,15 @@ typedef struct {
   bool handle_variable_ops;
   // Enable adaptive optimization for AVX CPUs.
   bool experimental_adaptive_avx_optimization;
+  // Path of a file caching the weights which the delegate unpacks from static
+  // weights of the model (FP16 weights dequantized to FP32, sparse weights
+  // densified). When set, the delegate memory-maps the unpacked weights from
+  // the file instead of unpacking them, if the file holds weights unpacked
+  // from the same static weights, and otherwise unpacks them and writes the
+  // file. Processes delegating the same model with the same path share the
+  // unpacked weights in memory. Use one file per model.
+  // WARNING: This is an experimental API and subject to change.
+  const char* experimental_weights_cache_file_path;
 } TfLiteXNNPackDelegateOptions;
 
 // Returns a structure with the default XNNPack delegate options.
@@ -25,7 +25,7 @@ TfLiteStatus RefreshExternalCpuBackendContext(TfLiteContext* context) {
   if (external_context && external_context->internal_backend_context() &&
       context->recommended_num_threads != -1) {
     external_context->internal_backend_context()->SetMaxNumThreads(
-        context->recommended_num_threads);
+        external_context->CapNumThreads(context->recommended_num_threads));
   }
   return kTfLiteOk;
 }
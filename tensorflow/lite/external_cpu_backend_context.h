@@ -92,9 +92,27 @@ class ExternalCpuBackendContext : public TfLiteExternalContext {
     return internal_backend_context_.get();
   }
 
+  // Caps the number of threads of the internal backend context, including
+  // when it is created lazily, whatever the number of threads of the
+  // interpreter. -1 means no cap.
+  void set_max_num_threads(int max_num_threads) {
+    max_num_threads_ = max_num_threads;
+  }
+
+  // Returns `num_threads`, the number of threads of the interpreter, capped
+  // by set_max_num_threads.
+  int CapNumThreads(int num_threads) const {
+    if (max_num_threads_ == -1) return num_threads;
+    if (num_threads == -1 || num_threads > max_num_threads_) {
+      return max_num_threads_;
+    }
+    return num_threads;
+  }
+
  private:
   // Note the actual internal backend context object is lazily initialized.
   std::unique_ptr<TfLiteInternalBackendContext> internal_backend_context_;
+  int max_num_threads_ = -1;
 
   ExternalCpuBackendContext(const ExternalCpuBackendContext&) = delete;
   ExternalCpuBackendContext& operator=(const ExternalCpuBackendContext&) =
@@ -70,6 +70,13 @@ class GraphInfo {
 
   // Returns the indices of the variable tensors.
   virtual const std::vector<int>& variables() const = 0;
+
+  // Returns the first and last execution plan indices of the nodes which may
+  // run at the same time as the node at execution plan index `index`. The
+  // tensors used by any of these nodes must not share memory.
+  virtual std::pair<size_t, size_t> concurrent_nodes(size_t index) const {
+    return {index, index};
+  }
 };
 
 // Represents a subset of nodes in a TensorFlow Lite graph.
@@ -29,7 +29,9 @@ class InterpreterOptions {
       : experimental_preserve_all_tensors_(false),
         experimental_ensure_dynamic_tensors_are_released_(false),
         experimental_optimize_memory_for_large_tensors_(0),
-        experimental_disable_delegate_clustering_(false) {}
+        experimental_disable_delegate_clustering_(false),
+        experimental_optimize_arena_plan_(false),
+        experimental_num_inter_op_threads_(1) {}
 
   /// Preserving all intermediates tensors for debugging.
   /// WARNING: This is an experimental API and subject to change.
@@ -93,11 +95,46 @@ class InterpreterOptions {
     experimental_disable_delegate_clustering_ = value;
   }
 
+  /// Plan the placement of the non-persistent tensors of each subgraph at
+  /// once, trying several heuristics and keeping the smallest arena, instead
+  /// of placing tensors one node at a time. The resulting offsets are reused
+  /// without planning if the model metadata holds them (see
+  /// `Subgraph::GetSerializedMemoryPlan`). This makes `AllocateTensors`
+  /// slower when the model metadata doesn't hold a valid plan.
+  /// WARNING: This is an experimental API and subject to change.
+  void SetOptimizeArenaPlan(bool value = true) {
+    experimental_optimize_arena_plan_ = value;
+  }
+
+  /// Returns if the `experimental_optimize_arena_plan_` feature is enabled.
+  /// WARNING: This is an experimental API and subject to change.
+  bool GetOptimizeArenaPlan() { return experimental_optimize_arena_plan_; }
+
+  /// Run nodes which don't depend on each other on up to `value` threads at
+  /// the same time, e.g. the branches of an Inception block. Each of these
+  /// nodes runs single-threaded, so this is mostly useful for graphs with
+  /// many small ops which don't benefit from intra-op threads. Nodes with
+  /// side effects (custom ops, delegates, control flow, stateful ops and ops
+  /// using resources or variables) still run on their own. Subgraphs with
+  /// dynamic tensors, or invoked with a profiler, run sequentially. Running
+  /// nodes concurrently extends the lifetime of their tensors in the arena,
+  /// so this may increase memory usage.
+  /// WARNING: This is an experimental API and subject to change.
+  void SetNumInterOpThreads(int value) {
+    experimental_num_inter_op_threads_ = value;
+  }
+
+  /// Returns the number of threads used to run independent nodes.
+  /// WARNING: This is an experimental API and subject to change.
+  int GetNumInterOpThreads() { return experimental_num_inter_op_threads_; }
+
  private:
   bool experimental_preserve_all_tensors_;
   bool experimental_ensure_dynamic_tensors_are_released_;
   int experimental_optimize_memory_for_large_tensors_;
   bool experimental_disable_delegate_clustering_;
+  bool experimental_optimize_arena_plan_;
+  int experimental_num_inter_op_threads_;
 };
 
 }  // namespace tflite
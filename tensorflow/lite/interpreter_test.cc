@@ -20,6 +20,8 @@ limitations under the License.
 #include <stdlib.h>
 #include <string.h>
 
+#include <atomic>
+#include <chrono>  // NOLINT(build/c++11)
 #include <map>
 #include <memory>
 #include <string>
@@ -37,6 +39,7 @@ limitations under the License.
 #include "tensorflow/lite/delegates/utils/simple_delegate.h"
 #include "tensorflow/lite/external_cpu_backend_context.h"
 #include "tensorflow/lite/interpreter_test_util.h"
+#include "tensorflow/lite/kernels/cpu_backend_context.h"
 #include "tensorflow/lite/kernels/kernel_util.h"
 #include "tensorflow/lite/string_util.h"
 #include "tensorflow/lite/testing/util.h"
@@ -1127,6 +1130,96 @@ TEST(BasicInterpreter, ReleaseDynamicTensors) {
   ASSERT_EQ(interpreter.tensor(3)->bytes, sizeof(float) * 6 * 6);
 }
 
+// Number of branch nodes which started to run, see ScaleBranchInvoke.
+std::atomic<int> num_started_branches;
+// The thread calling Invoke, and the largest number of threads of the CPU
+// backend context of the branches running on other threads.
+std::thread::id invoking_thread;
+std::atomic<int> max_worker_backend_threads;
+
+// Multiplies its input by the index of its output tensor, once all the 4
+// branch nodes of the graph started, so that it fails unless the branches run
+// concurrently.
+TfLiteStatus ScaleBranchInvoke(TfLiteContext* context, TfLiteNode* node) {
+  ++num_started_branches;
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (num_started_branches < 4) {
+    if (std::chrono::steady_clock::now() > deadline) return kTfLiteError;
+    std::this_thread::yield();
+  }
+  if (std::this_thread::get_id() != invoking_thread) {
+    const int num_threads =
+        CpuBackendContext::GetFromContext(context)->max_num_threads();
+    int max_threads = max_worker_backend_threads;
+    while (num_threads > max_threads &&
+           !max_worker_backend_threads.compare_exchange_weak(max_threads,
+                                                             num_threads)) {
+    }
+  }
+  const TfLiteTensor* input = &context->tensors[node->inputs->data[0]];
+  TfLiteTensor* output = &context->tensors[node->outputs->data[0]];
+  for (int i = 0; i < NumElements(input); ++i) {
+    output->data.f[i] = input->data.f[i] * node->outputs->data[0];
+  }
+  return kTfLiteOk;
+}
+
+TEST(BasicInterpreter, InterOpParallelism) {
+  Interpreter interpreter;
+  ASSERT_EQ(interpreter.AddTensors(6), kTfLiteOk);
+  for (int i = 0; i < 6; ++i) {
+    ASSERT_EQ(interpreter.SetTensorParametersReadWrite(
+                  i, kTfLiteFloat32, "", {8}, TfLiteQuantizationParams()),
+              kTfLiteOk);
+  }
+  ASSERT_EQ(interpreter.SetInputs({0}), kTfLiteOk);
+  ASSERT_EQ(interpreter.SetOutputs({5}), kTfLiteOk);
+  TfLiteRegistration scale = {nullptr, nullptr, nullptr, nullptr};
+  scale.prepare = [](TfLiteContext* context, TfLiteNode* node) {
+    return context->ResizeTensor(
+        context, &context->tensors[node->outputs->data[0]],
+        TfLiteIntArrayCopy(context->tensors[node->inputs->data[0]].dims));
+  };
+  scale.invoke = ScaleBranchInvoke;
+  // Branches 1 to 4 only depend on the input, ADD_N depends on all of them.
+  for (int i = 1; i <= 4; ++i) {
+    ASSERT_EQ(interpreter.AddNodeWithParameters({0}, {i}, nullptr, 0, nullptr,
+                                                &scale),
+              kTfLiteOk);
+  }
+  ASSERT_EQ(
+      interpreter.AddNodeWithParameters({1, 2, 3, 4}, {5}, nullptr, 0, nullptr,
+                                        ops::builtin::Register_ADD_N()),
+      kTfLiteOk);
+
+  ASSERT_EQ(interpreter.SetNumThreads(4), kTfLiteOk);
+  InterpreterOptions options;
+  options.SetNumInterOpThreads(4);
+  interpreter.ApplyOptions(&options);
+  ASSERT_EQ(interpreter.AllocateTensors(), kTfLiteOk);
+  for (int i = 1; i <= 4; ++i) {
+    for (int j = 1; j < i; ++j) {
+      // The outputs of concurrent nodes must not share memory.
+      EXPECT_NE(interpreter.tensor(i)->data.raw,
+                interpreter.tensor(j)->data.raw);
+    }
+  }
+
+  invoking_thread = std::this_thread::get_id();
+  max_worker_backend_threads = 0;
+  for (int run = 0; run < 3; ++run) {
+    num_started_branches = 0;
+    for (int i = 0; i < 8; ++i) interpreter.typed_tensor<float>(0)[i] = i;
+    ASSERT_EQ(interpreter.Invoke(), kTfLiteOk);
+    for (int i = 0; i < 8; ++i) {
+      EXPECT_EQ(interpreter.typed_tensor<float>(5)[i], 10.f * i);
+    }
+  }
+  // Kernels on worker threads are single-threaded from their first run.
+  EXPECT_EQ(max_worker_backend_threads, 1);
+}
+
 TEST(InterpreterTensorsCapacityTest, TestWithinHeadroom) {
   Interpreter interpreter;
   ASSERT_EQ(interpreter.AddTensors(Interpreter::kTensorsReservedCapacity),
@@ -15,6 +15,7 @@ limitations under the License.
 #ifndef TENSORFLOW_LITE_MEMORY_PLANNER_H_
 #define TENSORFLOW_LITE_MEMORY_PLANNER_H_
 
+#include <string>
 #include <vector>
 
 #include "tensorflow/lite/core/c/common.h"
@@ -69,6 +70,11 @@ class MemoryPlanner {
   // Returns a map of allocation information. It's only used for debugging.
   virtual void GetAllocInfo(size_t *arena_size,
                             size_t *arena_persist_size) const = 0;
+
+  // Returns the offsets of the non-persistent tensors in a form which can be
+  // stored in the model metadata, so that later loads of the model can skip
+  // planning. Returns an empty string if the planner doesn't support it.
+  virtual std::string GetSerializedPlan() const { return ""; }
 };
 
 }  // namespace tflite
@@ -587,6 +587,7 @@ def build_conversion_flags(
     mlir_elide_elementsattrs_if_larger=None,
     use_buffer_offset=False,
     reduce_type_precision=False,
+    rematerialization_max_cost=0,
     **_
 ):
   """Builds protocol buffer describing a conversion of a model.
@@ -711,6 +712,10 @@ def build_conversion_flags(
     reduce_type_precision: Convert some tensor types to a lower precision if all
       values within that tensor are within the range of the lower precision.
       This could have side effects e.g. reduced flatbuffer size.
+    rematerialization_max_cost: An int, if not zero, clones ops to recompute
+      intermediate tensors near their later uses when this lowers the peak
+      memory of a subgraph, cloning at most this many ops per subgraph (any
+      number if negative).
 
   Returns:
     conversion_flags: protocol buffer describing the conversion process.
@@ -824,6 +829,8 @@ def build_conversion_flags(
     conversion_flags.use_buffer_offset = use_buffer_offset
   if reduce_type_precision is not None:
     conversion_flags.reduce_type_precision = reduce_type_precision
+  if rematerialization_max_cost is not None:
+    conversion_flags.rematerialization_max_cost = rematerialization_max_cost
   return conversion_flags
 
 
@@ -662,6 +662,7 @@ class TFLiteConverterBase:
     self._experimental_disable_fuse_mul_and_fc = False
     self._experimental_use_buffer_offset = False
     self._experimental_reduce_type_precision = False
+    self._experimental_rematerialization_max_cost = 0
 
     # Debug parameters
     self.mlir_dump_dir = None
@@ -814,6 +815,9 @@ class TFLiteConverterBase:
         ),
         "use_buffer_offset": self._experimental_use_buffer_offset,
         "reduce_type_precision": self._experimental_reduce_type_precision,
+        "rematerialization_max_cost": (
+            self._experimental_rematerialization_max_cost
+        ),
     }
 
     if self.saved_model_dir:
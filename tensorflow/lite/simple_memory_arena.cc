@@ -141,6 +141,30 @@ TfLiteStatus SimpleMemoryArena::Allocate(
   return kTfLiteOk;
 }
 
+TfLiteStatus SimpleMemoryArena::AllocateAt(
+    TfLiteContext* context, size_t alignment, size_t size, size_t offset,
+    int32_t tensor, int32_t first_node, int32_t last_node,
+    ArenaAllocWithUsageInterval* new_alloc) {
+  TF_LITE_ENSURE(context, alignment <= arena_alignment_);
+  TF_LITE_ENSURE(context, offset % alignment == 0);
+  TF_LITE_ENSURE(context, offset <= std::numeric_limits<size_t>::max() - size);
+  new_alloc->tensor = tensor;
+  new_alloc->first_node = first_node;
+  new_alloc->last_node = last_node;
+  new_alloc->size = size;
+  if (size == 0) {
+    new_alloc->offset = 0;
+    return kTfLiteOk;
+  }
+  new_alloc->offset = offset;
+  high_water_mark_ = std::max(high_water_mark_, offset + size);
+
+  auto insertion_it = std::upper_bound(active_allocs_.begin(),
+                                       active_allocs_.end(), *new_alloc);
+  active_allocs_.insert(insertion_it, *new_alloc);
+  return kTfLiteOk;
+}
+
 TfLiteStatus SimpleMemoryArena::Commit(TfLiteContext* context,
                                        bool* arena_reallocated) {
   size_t required_size = RequiredBufferSize();
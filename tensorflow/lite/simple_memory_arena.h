@@ -99,6 +99,15 @@ class SimpleMemoryArena {
                         int32_t tensor, int32_t first_node, int32_t last_node,
                         ArenaAllocWithUsageInterval* new_alloc);
 
+  // Schedule memory allocation for a tensor at a given offset, e.g. one
+  // computed by PlanArenaOffsets for the whole subgraph. The caller must make
+  // sure that it doesn't overlap with other allocations whose usage interval
+  // intersects with [first_node, last_node].
+  TfLiteStatus AllocateAt(TfLiteContext* context, size_t alignment,
+                          size_t size, size_t offset, int32_t tensor,
+                          int32_t first_node, int32_t last_node,
+                          ArenaAllocWithUsageInterval* new_alloc);
+
   inline size_t RequiredBufferSize() {
     // Add in a small amount of padding to reduce the chance of resize events
     // for small allocations.
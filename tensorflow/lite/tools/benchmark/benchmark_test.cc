@@ -473,6 +473,58 @@ TEST(BenchmarkTest, MaxDurationWorks) {
   benchmark.Run();
 }
 
+class NumRunsTestListener : public BenchmarkListener {
+ public:
+  void OnBenchmarkEnd(const BenchmarkResults& results) override {
+    num_runs_ = results.inference_time_us().count();
+  }
+  int64_t num_runs() const { return num_runs_; }
+
+ private:
+  int64_t num_runs_ = 0;
+};
+
+TEST(BenchmarkTest, RunInThroughputMode) {
+  ASSERT_THAT(g_fp32_model_path, testing::NotNull());
+  ASSERT_THAT(g_int8_model_path, testing::NotNull());
+  BenchmarkParams params = BenchmarkTfLiteModel::DefaultParams();
+  InitializeParams(params, /*num_runs=*/20, /*min_secs=*/0.0f,
+                   /*max_secs=*/150.0f);
+  params.Set<bool>("throughput_mode", true);
+  params.Set<std::string>("throughput_graphs", *g_int8_model_path);
+  params.Set<int32_t>("num_interpreters", 2);
+  params.Set<int32_t>("num_request_threads", 3);
+  TestBenchmark benchmark(std::move(params));
+  NumRunsTestListener listener;
+  benchmark.AddListener(&listener);
+  EXPECT_EQ(benchmark.Run(), kTfLiteOk);
+  EXPECT_GE(listener.num_runs(), 20);
+}
+
+TEST(BenchmarkTest, RunInThroughputModeWithRequestRate) {
+  ASSERT_THAT(g_fp32_model_path, testing::NotNull());
+  BenchmarkParams params = BenchmarkTfLiteModel::DefaultParams();
+  InitializeParams(params, /*num_runs=*/20, /*min_secs=*/0.0f,
+                   /*max_secs=*/150.0f);
+  params.Set<bool>("throughput_mode", true);
+  params.Set<int32_t>("num_interpreters", 2);
+  params.Set<float>("request_rate", 1000.0f);
+  TestBenchmark benchmark(std::move(params));
+  NumRunsTestListener listener;
+  benchmark.AddListener(&listener);
+  EXPECT_EQ(benchmark.Run(), kTfLiteOk);
+  EXPECT_EQ(listener.num_runs(), 20);
+}
+
+TEST(BenchmarkTest, ThroughputModeDoesntSupportOpProfiling) {
+  ASSERT_THAT(g_fp32_model_path, testing::NotNull());
+  BenchmarkParams params = CreateFp32Params();
+  params.Set<bool>("throughput_mode", true);
+  params.Set<bool>("enable_op_profiling", true);
+  TestBenchmark benchmark(std::move(params));
+  EXPECT_EQ(benchmark.Run(), kTfLiteError);
+}
+
 TEST(BenchmarkTest, ParametersArePopulatedWhenInputShapeIsNotSpecified) {
   ASSERT_THAT(g_fp32_model_path, testing::NotNull());
 
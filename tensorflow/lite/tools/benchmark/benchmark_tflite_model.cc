@@ -15,16 +15,22 @@ limitations under the License.
 
 #include "tensorflow/lite/tools/benchmark/benchmark_tflite_model.h"
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>  // NOLINT(build/c++11)
 #include <cstdarg>
 #include <cstdint>
 #include <cstdlib>
+#include <deque>
 #include <fstream>
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <mutex>  // NOLINT(build/c++11)
 #include <random>
 #include <sstream>
 #include <string>
+#include <thread>  // NOLINT(build/c++11)
 #include <unordered_set>
 #include <utility>
 #include <vector>
@@ -45,7 +51,9 @@ limitations under the License.
 #include "tensorflow/lite/kernels/cpu_backend_context.h"
 #include "tensorflow/lite/op_resolver.h"
 #include "tensorflow/lite/optional_debug_tools.h"
+#include "tensorflow/lite/profiling/memory_info.h"
 #include "tensorflow/lite/profiling/profile_summary_formatter.h"
+#include "tensorflow/lite/profiling/time.h"
 #include "tensorflow/lite/string_util.h"
 #include "tensorflow/lite/tools/benchmark/benchmark_utils.h"
 #include "tensorflow/lite/tools/benchmark/profiling_listener.h"
@@ -54,6 +62,10 @@ limitations under the License.
 #include "tensorflow/lite/tools/model_loader.h"
 #include "tensorflow/lite/tools/utils.h"
 
+#ifndef TFLITE_WITHOUT_XNNPACK
+#include "tensorflow/lite/delegates/xnnpack/xnnpack_delegate.h"
+#endif  // !defined(TFLITE_WITHOUT_XNNPACK)
+
 void RegisterSelectedOps(::tflite::MutableOpResolver* resolver);
 
 // Version with Weak linker attribute doing nothing: if someone links this
@@ -305,6 +317,54 @@ TfLiteStatus PopulateInputLayerInfo(
   return kTfLiteOk;
 }
 
+// Sets the values of the input tensors of `interpreter` from `inputs_data`.
+void SetInputTensors(const std::vector<InputTensorData>& inputs_data,
+                     Interpreter* interpreter) {
+  auto interpreter_inputs = interpreter->inputs();
+  for (int j = 0; j < interpreter_inputs.size(); ++j) {
+    int i = interpreter_inputs[j];
+    TfLiteTensor* t = interpreter->tensor(i);
+    if (t->type == kTfLiteString) {
+      if (inputs_data[j].data) {
+        static_cast<DynamicBuffer*>(inputs_data[j].data.get())
+            ->WriteToTensor(t, /*new_shape=*/nullptr);
+      } else {
+        tflite::DynamicBuffer buffer;
+        FillRandomString(&buffer, t->dims, []() {
+          return "we're have some friends over saturday to hang out in the "
+                 "yard";
+        });
+        buffer.WriteToTensor(t, /*new_shape=*/nullptr);
+      }
+    } else {
+      std::memcpy(t->data.raw, inputs_data[j].data.get(),
+                  inputs_data[j].bytes);
+    }
+  }
+}
+
+// Timings of a request served in the throughput mode.
+struct RequestTiming {
+  int model_index;
+  // From the arrival of the request to the start of its inference.
+  int64_t queueing_us;
+  // From the arrival of the request to the end of its inference.
+  int64_t latency_us;
+};
+
+// Returns percentiles of `values` computed with the nearest-rank method.
+std::string FormatPercentiles(std::vector<int64_t> values) {
+  if (values.empty()) return "n/a";
+  std::sort(values.begin(), values.end());
+  std::stringstream stream;
+  for (int percentile : {50, 90, 95, 99}) {
+    const size_t rank = (values.size() * percentile + 99) / 100;
+    stream << "p" << percentile << "=" << values[rank - 1] << " ";
+  }
+  stream << "max=" << values.back();
+  return stream.str();
+}
+
 std::shared_ptr<profiling::ProfileSummaryFormatter>
 CreateProfileSummaryFormatter(bool format_as_csv) {
   return format_as_csv
@@ -381,6 +441,20 @@ BenchmarkParams BenchmarkTfLiteModel::DefaultParams() {
                           BenchmarkParam::Create<int32_t>(0));
   default_params.AddParam("disable_delegate_clustering",
                           BenchmarkParam::Create<bool>(false));
+  default_params.AddParam("num_inter_op_threads",
+                          BenchmarkParam::Create<int32_t>(1));
+  default_params.AddParam("throughput_mode",
+                          BenchmarkParam::Create<bool>(false));
+  default_params.AddParam("throughput_graphs",
+                          BenchmarkParam::Create<std::string>(""));
+  default_params.AddParam("num_interpreters",
+                          BenchmarkParam::Create<int32_t>(1));
+  default_params.AddParam("num_request_threads",
+                          BenchmarkParam::Create<int32_t>(0));
+  default_params.AddParam("request_rate",
+                          BenchmarkParam::Create<float>(-1.0f));
+  default_params.AddParam("share_xnnpack_weights",
+                          BenchmarkParam::Create<bool>(false));
   default_params.AddParam("output_filepath",
                           BenchmarkParam::Create<std::string>(""));
 
@@ -413,7 +487,11 @@ BenchmarkTfLiteModel::~BenchmarkTfLiteModel() {
 
   // Destory the owned interpreter earlier than other objects (specially
   // 'owned_delegates_').
+  throughput_instances_.clear();
   interpreter_.reset();
+  // The XNNPACK weights caches must outlive the delegates using them.
+  owned_delegates_.clear();
+  xnnpack_weights_caches_.clear();
 }
 
 std::vector<Flag> BenchmarkTfLiteModel::GetFlags() {
@@ -469,6 +547,39 @@ std::vector<Flag> BenchmarkTfLiteModel::GetFlags() {
           "Optimize memory usage for large tensors with sacrificing latency."),
       CreateFlag<bool>("disable_delegate_clustering", &params_,
                        "Disable delegate clustering."),
+      CreateFlag<int32_t>(
+          "num_inter_op_threads", &params_,
+          "Number of threads running nodes which don't depend on each other "
+          "at the same time."),
+      CreateFlag<bool>(
+          "throughput_mode", &params_,
+          "Serve requests on --num_interpreters interpreters of each model "
+          "from --num_request_threads threads at the same time, and report "
+          "the throughput and latency percentiles of the requests. Each "
+          "interpreter uses --num_threads threads."),
+      CreateFlag<std::string>(
+          "throughput_graphs", &params_,
+          "A comma-separated list of models served along with --graph in the "
+          "throughput mode. Their inputs are random."),
+      CreateFlag<int32_t>("num_interpreters", &params_,
+                          "Number of interpreters of each model in the "
+                          "throughput mode."),
+      CreateFlag<int32_t>(
+          "num_request_threads", &params_,
+          "Number of threads serving requests in the throughput mode. By "
+          "default, one per interpreter."),
+      CreateFlag<float>(
+          "request_rate", &params_,
+          "Number of requests per second arriving at random times (i.e. a "
+          "Poisson process) in the throughput mode. The latency includes the "
+          "time requests wait for a free thread and interpreter. If not "
+          "positive, each thread issues a request as soon as the previous "
+          "one completes."),
+      CreateFlag<bool>(
+          "share_xnnpack_weights", &params_,
+          "In the throughput mode, apply an XNNPACK delegate to each "
+          "interpreter, sharing the packed weights between the interpreters "
+          "of a model through a weights cache."),
       CreateFlag<std::string>(
           "output_filepath", &params_,
           "File path to export outputs layer as binary data."),
@@ -528,6 +639,18 @@ void BenchmarkTfLiteModel::LogParams() {
                       "Optimize memory usage for large tensors", verbose);
   LOG_BENCHMARK_PARAM(bool, "disable_delegate_clustering",
                       "Disable delegate clustering", verbose);
+  LOG_BENCHMARK_PARAM(int32_t, "num_inter_op_threads",
+                      "Num inter-op threads", verbose);
+  LOG_BENCHMARK_PARAM(bool, "throughput_mode", "Throughput mode", verbose);
+  LOG_BENCHMARK_PARAM(std::string, "throughput_graphs",
+                      "Other graphs in throughput mode", verbose);
+  LOG_BENCHMARK_PARAM(int32_t, "num_interpreters",
+                      "Num interpreters per graph", verbose);
+  LOG_BENCHMARK_PARAM(int32_t, "num_request_threads", "Num request threads",
+                      verbose);
+  LOG_BENCHMARK_PARAM(float, "request_rate", "Requests per second", verbose);
+  LOG_BENCHMARK_PARAM(bool, "share_xnnpack_weights",
+                      "Share XNNPACK packed weights", verbose);
   LOG_BENCHMARK_PARAM(std::string, "output_filepath",
                       "File path to export outputs layer to", verbose);
   LOG_BENCHMARK_PARAM(int32_t, "tensor_name_display_length",
@@ -552,6 +675,25 @@ TfLiteStatus BenchmarkTfLiteModel::ValidateParams() {
     return kTfLiteError;
   }
 
+  if (params_.Get<bool>("throughput_mode")) {
+    if (params_.Get<int32_t>("num_interpreters") < 1) {
+      TFLITE_LOG(ERROR) << "--num_interpreters must be positive.";
+      return kTfLiteError;
+    }
+    // The profiler of `interpreter_` can't tell its requests from the others.
+    if (params_.Get<bool>("enable_op_profiling")) {
+      TFLITE_LOG(ERROR)
+          << "--enable_op_profiling isn't supported in the throughput mode.";
+      return kTfLiteError;
+    }
+#ifdef TFLITE_WITHOUT_XNNPACK
+    if (params_.Get<bool>("share_xnnpack_weights")) {
+      TFLITE_LOG(ERROR) << "--share_xnnpack_weights requires XNNPACK.";
+      return kTfLiteError;
+    }
+#endif  // defined(TFLITE_WITHOUT_XNNPACK)
+  }
+
   return PopulateInputLayerInfo(
       params_.Get<std::string>("input_layer"),
       params_.Get<std::string>("input_layer_shape"),
@@ -688,34 +830,20 @@ TfLiteStatus BenchmarkTfLiteModel::PrepareInputData() {
 }
 
 TfLiteStatus BenchmarkTfLiteModel::ResetInputsAndOutputs() {
-  auto interpreter_inputs = interpreter_->inputs();
-  // Set the values of the input tensors from inputs_data_.
-  for (int j = 0; j < interpreter_inputs.size(); ++j) {
-    int i = interpreter_inputs[j];
-    TfLiteTensor* t = interpreter_->tensor(i);
-    if (t->type == kTfLiteString) {
-      if (inputs_data_[j].data) {
-        static_cast<DynamicBuffer*>(inputs_data_[j].data.get())
-            ->WriteToTensor(t, /*new_shape=*/nullptr);
-      } else {
-        tflite::DynamicBuffer buffer;
-        FillRandomString(&buffer, t->dims, []() {
-          return "we're have some friends over saturday to hang out in the "
-                 "yard";
-        });
-        buffer.WriteToTensor(t, /*new_shape=*/nullptr);
-      }
-    } else {
-      std::memcpy(t->data.raw, inputs_data_[j].data.get(),
-                  inputs_data_[j].bytes);
-    }
-  }
-
+  SetInputTensors(inputs_data_, interpreter_.get());
   return kTfLiteOk;
 }
 
 TfLiteStatus BenchmarkTfLiteModel::InitInterpreter() {
   auto resolver = GetOpResolver();
+  return CreateInterpreter(*model_, *resolver, &interpreter_,
+                           &external_context_);
+}
+
+TfLiteStatus BenchmarkTfLiteModel::CreateInterpreter(
+    const FlatBufferModel& model, const OpResolver& resolver,
+    std::unique_ptr<Interpreter>* interpreter,
+    std::unique_ptr<ExternalCpuBackendContext>* external_context) {
   const int32_t num_threads = params_.Get<int32_t>("num_threads");
   const bool use_caching = params_.Get<bool>("use_caching");
 
@@ -726,35 +854,38 @@ TfLiteStatus BenchmarkTfLiteModel::InitInterpreter() {
       params_.Get<int32_t>("optimize_memory_for_large_tensors"));
   options.SetDisableDelegateClustering(
       params_.Get<bool>("disable_delegate_clustering"));
+  options.SetNumInterOpThreads(params_.Get<int32_t>("num_inter_op_threads"));
 
-  tflite::InterpreterBuilder builder(*model_, *resolver, &options);
+  tflite::InterpreterBuilder builder(model, resolver, &options);
   if (builder.SetNumThreads(num_threads) != kTfLiteOk) {
     TFLITE_LOG(ERROR) << "Failed to set thread number";
     return kTfLiteError;
   }
 
-  builder(&interpreter_);
-  if (!interpreter_) {
+  builder(interpreter);
+  if (!*interpreter) {
     TFLITE_LOG(ERROR) << "Failed to initialize the interpreter";
     return kTfLiteError;
   }
   // Manually enable caching behavior in TF Lite interpreter.
   if (use_caching) {
-    external_context_ = std::make_unique<tflite::ExternalCpuBackendContext>();
+    *external_context = std::make_unique<tflite::ExternalCpuBackendContext>();
     std::unique_ptr<tflite::CpuBackendContext> cpu_backend_context(
         new tflite::CpuBackendContext());
     cpu_backend_context->SetUseCaching(true);
     cpu_backend_context->SetMaxNumThreads(num_threads);
-    external_context_->set_internal_backend_context(
-        std::move(cpu_backend_context));
-    interpreter_->SetExternalContext(kTfLiteCpuBackendContext,
-                                     external_context_.get());
+    (*external_context)
+        ->set_internal_backend_context(std::move(cpu_backend_context));
+    (*interpreter)
+        ->SetExternalContext(kTfLiteCpuBackendContext,
+                             external_context->get());
   }
 
   return kTfLiteOk;
 }
 
 TfLiteStatus BenchmarkTfLiteModel::Init() {
+  throughput_instances_.clear();
   TF_LITE_ENSURE_STATUS(LoadModel());
   TF_LITE_ENSURE_STATUS(InitInterpreter());
 
@@ -781,10 +912,21 @@ TfLiteStatus BenchmarkTfLiteModel::Init() {
   interpreter_->SetAllowFp16PrecisionForFp32(params_.Get<bool>("allow_fp16"));
 
   owned_delegates_.clear();
+  xnnpack_weights_caches_.clear();
 
   // Contains all ids of TfLiteNodes that have been checked to see whether it's
   // delegated or not.
   std::unordered_set<int> checked_node_ids;
+  if (params_.Get<bool>("throughput_mode") &&
+      params_.Get<bool>("share_xnnpack_weights")) {
+    TF_LITE_ENSURE_STATUS(ApplySharedXnnpackDelegate(
+        /*model_index=*/0, interpreter_.get(), &owned_delegates_));
+    for (int node_id : interpreter_->execution_plan()) {
+      if (interpreter_->node_and_registration(node_id)->first.delegate) {
+        checked_node_ids.insert(node_id);
+      }
+    }
+  }
   tools::ProvidedDelegateList delegate_providers(&params_);
   auto created_delegates = delegate_providers.CreateAllRankedDelegates();
   TFLITE_MAY_LOG(INFO, (created_delegates.size() >= 2))
@@ -902,6 +1044,10 @@ TfLiteStatus BenchmarkTfLiteModel::Init() {
     return kTfLiteError;
   }
 
+  if (params_.Get<bool>("throughput_mode")) {
+    TF_LITE_ENSURE_STATUS(InitThroughputInstances());
+  }
+
   AddOwnedListener(
       std::unique_ptr<BenchmarkListener>(new RuyProfileListener()));
   AddOwnedListener(
@@ -910,6 +1056,300 @@ TfLiteStatus BenchmarkTfLiteModel::Init() {
   return kTfLiteOk;
 }
 
+TfLiteStatus BenchmarkTfLiteModel::ApplySharedXnnpackDelegate(
+    int model_index, Interpreter* interpreter,
+    std::vector<Interpreter::TfLiteDelegatePtr>* owned_delegates) {
+#ifdef TFLITE_WITHOUT_XNNPACK
+  TFLITE_LOG(ERROR) << "XNNPACK isn't supported.";
+  return kTfLiteError;
+#else   // !defined(TFLITE_WITHOUT_XNNPACK)
+  while (xnnpack_weights_caches_.size() <= model_index) {
+    xnnpack_weights_caches_.emplace_back(
+        TfLiteXNNPackDelegateWeightsCacheCreate(),
+        TfLiteXNNPackDelegateWeightsCacheDelete);
+  }
+  TfLiteXNNPackDelegateOptions options = TfLiteXNNPackDelegateOptionsDefault();
+  const int32_t num_threads = params_.Get<int32_t>("num_threads");
+  // Note that we don't want to use the thread pool for num_threads == 1.
+  options.num_threads = num_threads > 1 ? num_threads : 0;
+  options.weights_cache = xnnpack_weights_caches_[model_index].get();
+  owned_delegates->emplace_back(TfLiteXNNPackDelegateCreate(&options),
+                                TfLiteXNNPackDelegateDelete);
+  if (interpreter->ModifyGraphWithDelegate(owned_delegates->back().get()) !=
+      kTfLiteOk) {
+    TFLITE_LOG(ERROR) << "Failed to apply the XNNPACK delegate.";
+    return kTfLiteError;
+  }
+  return kTfLiteOk;
+#endif  // defined(TFLITE_WITHOUT_XNNPACK)
+}
+
+TfLiteStatus BenchmarkTfLiteModel::InitThroughputInstances() {
+  const auto start_mem_usage = profiling::memory::GetMemoryUsage();
+  throughput_models_.clear();
+  throughput_inputs_data_.clear();
+  for (const std::string& path :
+       Split(params_.Get<std::string>("throughput_graphs"), ',')) {
+    throughput_models_.push_back(FlatBufferModel::BuildFromFile(path.c_str()));
+    if (!throughput_models_.back()) {
+      TFLITE_LOG(ERROR) << "Failed to load model " << path;
+      return kTfLiteError;
+    }
+  }
+
+  throughput_instances_.clear();
+  throughput_instances_.push_back(std::make_unique<ThroughputInstance>());
+  throughput_instances_.back()->interpreter = interpreter_.get();
+  const int num_interpreters = params_.Get<int32_t>("num_interpreters");
+  for (int model_index = 0; model_index <= throughput_models_.size();
+       ++model_index) {
+    for (int i = model_index == 0 ? 1 : 0; i < num_interpreters; ++i) {
+      TF_LITE_ENSURE_STATUS(AddThroughputInstance(model_index));
+    }
+  }
+
+#ifndef TFLITE_WITHOUT_XNNPACK
+  // Keep the caches open to weights packed when tensors are resized.
+  for (auto& weights_cache : xnnpack_weights_caches_) {
+    if (!TfLiteXNNPackDelegateWeightsCacheFinalizeSoft(weights_cache.get())) {
+      TFLITE_LOG(ERROR) << "Failed to finalize the XNNPACK weights cache.";
+      return kTfLiteError;
+    }
+  }
+#endif  // !defined(TFLITE_WITHOUT_XNNPACK)
+
+  // The inputs of --graph are set up by PrepareInputData.
+  for (const auto& instance : throughput_instances_) {
+    if (instance->model_index == 0 ||
+        instance->model_index <= throughput_inputs_data_.size()) {
+      continue;
+    }
+    std::vector<InputTensorData> inputs_data;
+    for (int input : instance->interpreter->inputs()) {
+      inputs_data.push_back(
+          CreateRandomTensorData(*instance->interpreter->tensor(input),
+                                 /*layer_info=*/nullptr));
+    }
+    throughput_inputs_data_.push_back(std::move(inputs_data));
+  }
+
+  const auto mem_usage = profiling::memory::GetMemoryUsage() - start_mem_usage;
+  TFLITE_LOG(INFO) << "Created " << throughput_instances_.size()
+                   << " interpreters of " << throughput_models_.size() + 1
+                   << " models for the throughput mode.";
+  if (mem_usage.IsSupported()) {
+    TFLITE_LOG(INFO) << "Memory footprint delta of the interpreters after the "
+                        "first one (MB): "
+                     << mem_usage.mem_footprint_kb / 1024.0;
+  }
+  return kTfLiteOk;
+}
+
+TfLiteStatus BenchmarkTfLiteModel::AddThroughputInstance(int model_index) {
+  auto instance = std::make_unique<ThroughputInstance>();
+  instance->model_index = model_index;
+  const FlatBufferModel& model =
+      model_index == 0 ? *model_ : *throughput_models_[model_index - 1];
+  TF_LITE_ENSURE_STATUS(CreateInterpreter(model, *GetOpResolver(),
+                                          &instance->owned_interpreter,
+                                          &instance->external_context));
+  Interpreter* interpreter = instance->owned_interpreter.get();
+  instance->interpreter = interpreter;
+  interpreter->SetAllowFp16PrecisionForFp32(params_.Get<bool>("allow_fp16"));
+
+  if (params_.Get<bool>("share_xnnpack_weights")) {
+    TF_LITE_ENSURE_STATUS(ApplySharedXnnpackDelegate(model_index, interpreter,
+                                                     &instance->delegates));
+  }
+  tools::ProvidedDelegateList delegate_providers(&params_);
+  for (auto& created_delegate : delegate_providers.CreateAllRankedDelegates()) {
+    TfLiteDelegate* delegate = created_delegate.delegate.get();
+    instance->delegates.emplace_back(std::move(created_delegate.delegate));
+    if (interpreter->ModifyGraphWithDelegate(delegate) != kTfLiteOk) {
+      TFLITE_LOG(ERROR) << "Failed to apply "
+                        << created_delegate.provider->GetName()
+                        << " delegate.";
+      return kTfLiteError;
+    }
+  }
+
+  // Only the inputs of --graph may be resized.
+  for (int j = 0; model_index == 0 && j < inputs_.size(); ++j) {
+    const int i = interpreter->inputs()[j];
+    if (interpreter->tensor(i)->type != kTfLiteString) {
+      interpreter->ResizeInputTensor(i, inputs_[j].shape);
+    }
+  }
+  if (interpreter->AllocateTensors() != kTfLiteOk) {
+    TFLITE_LOG(ERROR) << "Failed to allocate tensors!";
+    return kTfLiteError;
+  }
+  throughput_instances_.push_back(std::move(instance));
+  return kTfLiteOk;
+}
+
+tensorflow::Stat<int64_t> BenchmarkTfLiteModel::Run(
+    int min_num_times, float min_secs, float max_secs, RunType run_type,
+    TfLiteStatus* invoke_status) {
+  if (params_.Get<bool>("throughput_mode")) {
+    return RunThroughput(min_num_times, min_secs, max_secs, run_type,
+                         invoke_status);
+  }
+  return BenchmarkModel::Run(min_num_times, min_secs, max_secs, run_type,
+                             invoke_status);
+}
+
+tensorflow::Stat<int64_t> BenchmarkTfLiteModel::RunThroughput(
+    int min_num_times, float min_secs, float max_secs, RunType run_type,
+    TfLiteStatus* invoke_status) {
+  const int num_models = throughput_models_.size() + 1;
+  const int num_instances = throughput_instances_.size();
+  int num_request_threads = params_.Get<int32_t>("num_request_threads");
+  if (num_request_threads <= 0) num_request_threads = num_instances;
+  // Warm up every interpreter, in a closed loop.
+  const float request_rate =
+      run_type == REGULAR ? params_.Get<float>("request_rate") : -1.0f;
+  if (run_type == WARMUP && min_num_times > 0) {
+    min_num_times = std::max(min_num_times, num_instances);
+  }
+  TFLITE_LOG(INFO) << "Serving requests on " << num_instances
+                   << " interpreters from " << num_request_threads
+                   << " threads for at least " << min_num_times
+                   << " requests and at least " << min_secs << " seconds but"
+                   << " stop issuing requests after " << max_secs
+                   << " seconds.";
+
+  for (const auto& instance : throughput_instances_) {
+    SetInputTensors(instance->model_index == 0
+                        ? inputs_data_
+                        : throughput_inputs_data_[instance->model_index - 1],
+                    instance->interpreter);
+  }
+
+  std::mutex mutex;
+  // Notified when an interpreter is released or a request arrives.
+  std::condition_variable condition;
+  // The free interpreters of each model, least recently used first.
+  std::vector<std::deque<ThroughputInstance*>> free_instances(num_models);
+  for (const auto& instance : throughput_instances_) {
+    free_instances[instance->model_index].push_back(instance.get());
+  }
+  // Requests which arrived with --request_rate, as {model, arrival time}.
+  std::deque<std::pair<int, int64_t>> arrived_requests;
+  bool stopped_issuing = false;
+  std::vector<RequestTiming> timings;
+  *invoke_status = kTfLiteOk;
+
+  const int64_t start_us = profiling::time::NowMicros();
+  const int64_t min_finish_us = start_us + static_cast<int64_t>(min_secs * 1e6);
+  const int64_t max_finish_us = start_us + static_cast<int64_t>(max_secs * 1e6);
+  auto should_issue = [&](int64_t request, int64_t now_us) {
+    return (request < min_num_times || now_us < min_finish_us) &&
+           now_us <= max_finish_us;
+  };
+  auto serve = [&](int model_index, int64_t arrival_us) {
+    ThroughputInstance* instance = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      condition.wait(lock,
+                     [&] { return !free_instances[model_index].empty(); });
+      instance = free_instances[model_index].front();
+      free_instances[model_index].pop_front();
+    }
+    const int64_t invoke_start_us = profiling::time::NowMicros();
+    const TfLiteStatus status = instance->interpreter->Invoke();
+    const int64_t invoke_end_us = profiling::time::NowMicros();
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      free_instances[model_index].push_back(instance);
+      timings.push_back({model_index, invoke_start_us - arrival_us,
+                         invoke_end_us - arrival_us});
+      if (status != kTfLiteOk) *invoke_status = status;
+    }
+    condition.notify_all();
+  };
+
+  std::atomic<int64_t> num_issued_requests(0);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_request_threads; ++i) {
+    threads.emplace_back([&] {
+      if (request_rate > 0) {
+        for (;;) {
+          std::pair<int, int64_t> request;
+          {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [&] {
+              return !arrived_requests.empty() || stopped_issuing;
+            });
+            if (arrived_requests.empty()) return;
+            request = arrived_requests.front();
+            arrived_requests.pop_front();
+          }
+          serve(request.first, request.second);
+        }
+      }
+      for (;;) {
+        const int64_t request = num_issued_requests++;
+        const int64_t now_us = profiling::time::NowMicros();
+        if (!should_issue(request, now_us)) return;
+        serve(request % num_models, now_us);
+      }
+    });
+  }
+  if (request_rate > 0) {
+    // Exponentially distributed gaps between arrivals.
+    std::exponential_distribution<double> gap_distribution(request_rate);
+    double arrival_us = start_us;
+    for (int64_t request = 0;; ++request) {
+      arrival_us += gap_distribution(random_engine_) * 1e6;
+      util::SleepForSeconds((arrival_us - profiling::time::NowMicros()) * 1e-6);
+      if (!should_issue(request, static_cast<int64_t>(arrival_us))) break;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        arrived_requests.emplace_back(request % num_models,
+                                      static_cast<int64_t>(arrival_us));
+      }
+      condition.notify_all();
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopped_issuing = true;
+    }
+    condition.notify_all();
+  }
+  for (std::thread& thread : threads) thread.join();
+  const int64_t elapsed_us = profiling::time::NowMicros() - start_us;
+
+  tensorflow::Stat<int64_t> run_stats;
+  std::vector<int64_t> queueing_us;
+  std::vector<std::vector<int64_t>> latency_us(num_models);
+  std::vector<int64_t> all_latency_us;
+  for (const RequestTiming& timing : timings) {
+    run_stats.UpdateStat(timing.latency_us);
+    queueing_us.push_back(timing.queueing_us);
+    latency_us[timing.model_index].push_back(timing.latency_us);
+    all_latency_us.push_back(timing.latency_us);
+  }
+  TFLITE_LOG(INFO) << "Served " << timings.size() << " requests in "
+                   << elapsed_us / 1e6 << " seconds, throughput: "
+                   << (elapsed_us > 0 ? timings.size() * 1e6 / elapsed_us : 0)
+                   << " requests per second.";
+  TFLITE_LOG(INFO) << "Latency (us): " << FormatPercentiles(all_latency_us);
+  TFLITE_LOG(INFO) << "Queueing delay (us): " << FormatPercentiles(queueing_us);
+  if (num_models > 1) {
+    for (int i = 0; i < num_models; ++i) {
+      TFLITE_LOG(INFO) << "Latency of model #" << i << " ("
+                       << latency_us[i].size() << " requests) (us): "
+                       << FormatPercentiles(latency_us[i]);
+    }
+  }
+
+  std::stringstream stream;
+  run_stats.OutputToStream(&stream);
+  TFLITE_LOG(INFO) << stream.str() << std::endl;
+  return run_stats;
+}
+
 TfLiteStatus BenchmarkTfLiteModel::LoadModel() {
   std::string fd_or_graph_path = params_.Get<std::string>("graph");
   model_loader_ = tools::CreateModelLoaderFromPath(fd_or_graph_path);
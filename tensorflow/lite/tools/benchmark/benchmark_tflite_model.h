@@ -30,6 +30,8 @@ limitations under the License.
 #include "tensorflow/lite/tools/model_loader.h"
 #include "tensorflow/lite/tools/utils.h"
 
+struct TfLiteXNNPackDelegateWeightsCache;
+
 namespace tflite {
 namespace benchmark {
 
@@ -77,6 +79,8 @@ class BenchmarkTfLiteModel : public BenchmarkModel {
   explicit BenchmarkTfLiteModel(BenchmarkParams params = DefaultParams());
   ~BenchmarkTfLiteModel() override;
 
+  using BenchmarkModel::Run;
+
   std::vector<Flag> GetFlags() override;
   void LogParams() override;
   TfLiteStatus ValidateParams() override;
@@ -89,6 +93,12 @@ class BenchmarkTfLiteModel : public BenchmarkModel {
   TfLiteStatus PrepareInputData() override;
   TfLiteStatus ResetInputsAndOutputs() override;
 
+  // Runs requests on all the interpreters at the same time in the throughput
+  // mode, see RunThroughput.
+  tensorflow::Stat<int64_t> Run(int min_num_times, float min_secs,
+                                float max_secs, RunType run_type,
+                                TfLiteStatus* invoke_status) override;
+
   int64_t MayGetModelFileSize() override;
 
   virtual TfLiteStatus LoadModel();
@@ -115,9 +125,46 @@ class BenchmarkTfLiteModel : public BenchmarkModel {
   std::unique_ptr<tflite::ExternalCpuBackendContext> external_context_;
 
  private:
+  // An interpreter serving requests in the throughput mode.
+  struct ThroughputInstance {
+    // Index of the model of the interpreter: 0 for --graph, i for the i-th
+    // model of --throughput_graphs.
+    int model_index = 0;
+    Interpreter* interpreter = nullptr;
+    std::unique_ptr<tflite::ExternalCpuBackendContext> external_context;
+    std::vector<Interpreter::TfLiteDelegatePtr> delegates;
+    // Null for `interpreter_`, which is the first instance of --graph.
+    std::unique_ptr<Interpreter> owned_interpreter;
+  };
+
   utils::InputTensorData CreateRandomTensorData(
       const TfLiteTensor& t, const InputLayerInfo* layer_info);
 
+  // Creates an interpreter of `model` configured by the benchmark params.
+  TfLiteStatus CreateInterpreter(
+      const FlatBufferModel& model, const OpResolver& resolver,
+      std::unique_ptr<Interpreter>* interpreter,
+      std::unique_ptr<ExternalCpuBackendContext>* external_context);
+
+  // Applies an XNNPACK delegate to `interpreter` which shares the packed
+  // weights with the other interpreters of the model at `model_index`.
+  TfLiteStatus ApplySharedXnnpackDelegate(
+      int model_index, Interpreter* interpreter,
+      std::vector<Interpreter::TfLiteDelegatePtr>* owned_delegates);
+
+  // Loads the models of --throughput_graphs and creates the interpreters of
+  // the throughput mode in addition to `interpreter_`.
+  TfLiteStatus InitThroughputInstances();
+  TfLiteStatus AddThroughputInstance(int model_index);
+
+  // Serves requests on all the interpreters from --num_request_threads
+  // threads, either in a closed loop or, with --request_rate, as they arrive,
+  // and reports the throughput and latency percentiles. Requests go to each
+  // model in turn, and to its least recently used free interpreter.
+  tensorflow::Stat<int64_t> RunThroughput(int min_num_times, float min_secs,
+                                          float max_secs, RunType run_type,
+                                          TfLiteStatus* invoke_status);
+
   void AddOwnedListener(std::unique_ptr<BenchmarkListener> listener) {
     if (listener == nullptr) return;
     owned_listeners_.emplace_back(std::move(listener));
@@ -127,6 +174,14 @@ class BenchmarkTfLiteModel : public BenchmarkModel {
   std::vector<std::unique_ptr<BenchmarkListener>> owned_listeners_;
   std::mt19937 random_engine_;
   std::vector<Interpreter::TfLiteDelegatePtr> owned_delegates_;
+  // The models of --throughput_graphs, with their input data.
+  std::vector<std::unique_ptr<tflite::FlatBufferModel>> throughput_models_;
+  std::vector<std::vector<utils::InputTensorData>> throughput_inputs_data_;
+  std::vector<std::unique_ptr<ThroughputInstance>> throughput_instances_;
+  // The XNNPACK weights cache of each model with --share_xnnpack_weights.
+  std::vector<std::unique_ptr<TfLiteXNNPackDelegateWeightsCache,
+                              void (*)(TfLiteXNNPackDelegateWeightsCache*)>>
+      xnnpack_weights_caches_;
   // Always TFLITE_LOG the benchmark result.
   BenchmarkLoggingListener log_output_;
   std::unique_ptr<tools::ModelLoader> model_loader_;
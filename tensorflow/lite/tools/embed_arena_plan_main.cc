@@ -0,0 +1,113 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Plans the arena of each subgraph of a model with
+// `InterpreterOptions::SetOptimizeArenaPlan` and stores the resulting tensor
+// offsets in the model metadata, so that interpreters created with the same
+// option skip planning when they load the output model. A stored plan is only
+// used if the tensor sizes it was made for are unchanged, e.g. after
+// `ResizeInputTensor` the arena is planned again.
+#include <fstream>  // NOLINT
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/lite/arena_plan.h"
+#include "tensorflow/lite/core/c/common.h"
+#include "tensorflow/lite/core/interpreter.h"
+#include "tensorflow/lite/core/interpreter_builder.h"
+#include "tensorflow/lite/core/model.h"
+#include "tensorflow/lite/interpreter_options.h"
+#include "tensorflow/lite/kernels/register.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+#include "tensorflow/lite/tools/command_line_flags.h"
+#include "tensorflow/lite/tools/logging.h"
+
+namespace tflite {
+
+constexpr char kInputModelFlag[] = "input_model";
+constexpr char kOutputModelFlag[] = "output_model";
+
+int Main(int argc, char* argv[]) {
+  std::string input_model_path;
+  std::string output_model_path;
+  std::vector<Flag> flag_list = {
+      Flag::CreateFlag(kInputModelFlag, &input_model_path,
+                       "Path to the input TFLite model."),
+      Flag::CreateFlag(kOutputModelFlag, &output_model_path,
+                       "Path to the output TFLite model."),
+  };
+  if (!Flags::Parse(&argc, const_cast<const char**>(argv), flag_list) ||
+      input_model_path.empty() || output_model_path.empty()) {
+    TFLITE_LOG(ERROR) << Flags::Usage(argv[0], flag_list);
+    return 1;
+  }
+
+  std::unique_ptr<FlatBufferModel> model =
+      FlatBufferModel::BuildFromFile(input_model_path.c_str());
+  if (!model) {
+    TFLITE_LOG(ERROR) << "Failed to load " << input_model_path;
+    return 1;
+  }
+  ops::builtin::BuiltinOpResolver resolver;
+  InterpreterOptions options;
+  options.SetOptimizeArenaPlan();
+  std::unique_ptr<Interpreter> interpreter;
+  if (InterpreterBuilder(*model, resolver, &options)(&interpreter) !=
+          kTfLiteOk ||
+      interpreter->AllocateTensors() != kTfLiteOk) {
+    TFLITE_LOG(ERROR) << "Failed to allocate the tensors of "
+                      << input_model_path;
+    return 1;
+  }
+
+  std::unique_ptr<ModelT> mutable_model(model->GetModel()->UnPack());
+  for (int i = 0, end = interpreter->subgraphs_size(); i < end; ++i) {
+    const std::string plan =
+        interpreter->subgraph(i)->GetSerializedMemoryPlan();
+    if (plan.empty()) continue;
+    const std::string name = ArenaPlanMetadataName(i);
+    // Replace the plan of an earlier run.
+    std::unique_ptr<MetadataT>* metadata = nullptr;
+    for (auto& existing : mutable_model->metadata) {
+      if (existing->name == name) metadata = &existing;
+    }
+    if (metadata == nullptr) {
+      mutable_model->metadata.push_back(std::make_unique<MetadataT>());
+      metadata = &mutable_model->metadata.back();
+      (*metadata)->name = name;
+    }
+    (*metadata)->buffer = mutable_model->buffers.size();
+    mutable_model->buffers.push_back(std::make_unique<BufferT>());
+    mutable_model->buffers.back()->data.assign(plan.begin(), plan.end());
+    TFLITE_LOG(INFO) << "Stored the arena plan of subgraph " << i << " ("
+                     << plan.size() << " bytes)";
+  }
+
+  flatbuffers::FlatBufferBuilder builder;
+  FinishModelBuffer(builder, Model::Pack(builder, mutable_model.get()));
+  std::ofstream output(output_model_path, std::ios::binary);
+  output.write(reinterpret_cast<const char*>(builder.GetBufferPointer()),
+               builder.GetSize());
+  if (!output) {
+    TFLITE_LOG(ERROR) << "Failed to write " << output_model_path;
+    return 1;
+  }
+  return 0;
+}
+
+}  // namespace tflite
+
+int main(int argc, char* argv[]) { return tflite::Main(argc, argv); }
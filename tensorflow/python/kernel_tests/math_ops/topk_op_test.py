@@ -195,6 +195,17 @@ class TopKTest(test.TestCase):
       values = -np.sort(-inputs, axis=1)[:, :k]
       self._validateTopK(inputs, k, values, indices)
 
+  def testFewLongRows(self):
+    # Few rows are split into chunks of columns, whose top k are merged.
+    b = 2
+    n = 300000
+    for k in [2, 100, 5000]:
+      # Lots of repeated integers, to check that ties are ordered by index.
+      inputs = np.random.randint(0, 1000, size=(b, n)).astype(np.int32)
+      indices = np.argsort(-inputs, axis=1, kind="mergesort")[:, :k]
+      values = -np.sort(-inputs, axis=1)[:, :k]
+      self._validateTopK(inputs, k, values, indices)
+
   def testTopAll(self):
     inputs = [[0.1, 0.3, 0.2, 0.4], [0.1, 0.3, 0.3, 0.2]]
     self._validateTopK(inputs, 4, [[0.4, 0.3, 0.2, 0.1], [0.3, 0.3, 0.2, 0.1]],
@@ -277,6 +288,24 @@ class TopKBenchmark(test.Benchmark):
                 "Throughput: %0.03g GB/s" % (name, r["wall_time"], throughput))
           sys.stdout.flush()
 
+  def benchmarkTopKFewRows(self):
+    for (m, n, k) in itertools.product([1, 4], [1000000, 10000000],
+                                       [100, 10000]):
+      name = "m_%d_n_%d_k_%d" % (m, n, k)
+      with ops.Graph().as_default():
+        with ops.device("/cpu:0"):
+          x = random_ops.random_uniform((m, n))
+          v = resource_variable_ops.ResourceVariable(x)
+          op = nn_ops.top_k(v, k)
+        with session.Session() as sess:
+          self.evaluate(v.initializer)
+          r = self.run_op_benchmark(sess, op, min_iters=10, name=name)
+          gb_processed_input = m * n / 1.0e9
+          throughput = gb_processed_input / r["wall_time"]
+          print("Benchmark: %s \t wall_time: %0.03g s \t "
+                "Throughput: %0.03g GB/s" % (name, r["wall_time"], throughput))
+          sys.stdout.flush()
+
 
 if __name__ == "__main__":
   test.main()
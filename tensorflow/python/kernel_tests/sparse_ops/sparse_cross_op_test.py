@@ -413,6 +413,26 @@ class SparseCrossOpTest(test.TestCase):
       all_values_are_different = len(out.values) == len(set(out.values))
       self.assertTrue(all_values_are_different)
 
+  @test_util.run_deprecated_v1
+  def test_hashed_3x2x2_matches_single_crosses(self):
+    """Tests that each hashed cross only depends on its own features."""
+    columns = [['a', 'b', 'c'], [1, 2], ['d', 'e']]
+    op = sparse_ops.sparse_cross_hashed(
+        [self._sparse_tensor([column]) for column in columns], hash_key=1234)
+    singles = []
+    for x in columns[0]:
+      for y in columns[1]:
+        for z in columns[2]:
+          singles.append(
+              sparse_ops.sparse_cross_hashed(
+                  [self._sparse_tensor([[v]]) for v in (x, y, z)],
+                  hash_key=1234))
+    with self.cached_session():
+      out = self.evaluate(op)
+      expected = [self.evaluate(single).values[0] for single in singles]
+      self.assertAllEqual([[0, i] for i in range(12)], out.indices)
+      self.assertAllEqual(expected, out.values)
+
   def _assert_sparse_tensor_empty(self, sp):
     self.assertEqual(0, sp.indices.size)
     self.assertEqual(0, sp.values.size)
@@ -37,6 +37,7 @@ from tensorflow.python.framework import errors
 from tensorflow.python.framework import extension_type
 from tensorflow.python.framework import indexed_slices
 from tensorflow.python.framework import memory_checker
+from tensorflow.python.framework import op_def_library
 from tensorflow.python.framework import ops
 from tensorflow.python.framework import tensor as tensor_lib
 from tensorflow.python.framework import tensor_shape
@@ -487,6 +488,57 @@ class ResourceVariableOpsTest(test_util.TensorFlowTestCase,
     # Only the false branch is taken so the gradient is 2.
     self.assertAllEqual(g[0], 2.0)
 
+  @parameterized.parameters("sum", "mean", "sqrtn")
+  @test_util.run_deprecated_v1
+  def testGradientResourceSparseSegmentReduction(self, combiner):
+    v = resource_variable_ops.ResourceVariable(
+        np.random.uniform(size=[5, 2]), dtype=dtypes.float32)
+    ids = constant_op.constant([4, 1, 3], dtype=dtypes.int64)
+    indices = constant_op.constant([0, 1, 2, 0])
+    segment_ids = constant_op.constant([0, 0, 2, 2])
+    weights = constant_op.constant([1., 3., 2., -0.5])
+    # The op is internal, so it has no generated Python wrapper.
+    _, _, fused_op, _ = op_def_library._apply_op_helper(  # pylint: disable=protected-access
+        "_ResourceSparseSegmentReduction",
+        resource=v.handle,
+        ids=ids,
+        indices=indices,
+        segment_ids=segment_ids,
+        num_segments=[],
+        weights=[weights],
+        dtype=dtypes.float32,
+        combiner=combiner)
+    fused = fused_op.outputs[0]
+
+    rows = array_ops.gather(v, array_ops.gather(ids, indices))
+    totals = math_ops.unsorted_segment_sum(
+        rows * array_ops.expand_dims(weights, 1), segment_ids, 3)
+    if combiner == "mean":
+      totals = math_ops.div_no_nan(
+          totals,
+          array_ops.expand_dims(
+              math_ops.unsorted_segment_sum(weights, segment_ids, 3), 1))
+    elif combiner == "sqrtn":
+      totals = math_ops.div_no_nan(
+          totals,
+          array_ops.expand_dims(
+              math_ops.sqrt(
+                  math_ops.unsorted_segment_sum(weights * weights, segment_ids,
+                                                3)), 1))
+
+    upstream = constant_op.constant([[1., 2.], [3., 4.], [-1., 0.5]])
+    fused_grads = gradients_impl.gradients(
+        math_ops.reduce_sum(fused * upstream), [v, weights])
+    expected_grads = gradients_impl.gradients(
+        math_ops.reduce_sum(totals * upstream), [v, weights])
+    self.assertIsInstance(fused_grads[0], indexed_slices.IndexedSlices)
+    self.evaluate(variables.global_variables_initializer())
+    self.assertAllClose(
+        self.evaluate(ops.convert_to_tensor(expected_grads[0])),
+        self.evaluate(ops.convert_to_tensor(fused_grads[0])))
+    self.assertAllClose(
+        self.evaluate(expected_grads[1]), self.evaluate(fused_grads[1]))
+
   @test_util.run_in_graph_and_eager_modes
   def testGradientGatherNdIndexedSlices(self):
     v = resource_variable_ops.ResourceVariable(
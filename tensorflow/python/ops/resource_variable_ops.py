@@ -40,6 +40,7 @@ from tensorflow.python.framework import device as pydev
 from tensorflow.python.framework import dtypes
 from tensorflow.python.framework import errors
 from tensorflow.python.framework import indexed_slices
+from tensorflow.python.framework import op_def_library
 from tensorflow.python.framework import ops
 from tensorflow.python.framework import tensor as tensor_module
 from tensorflow.python.framework import tensor_conversion_registry
@@ -2508,6 +2509,60 @@ def _GatherGrad(op, grad):
   return (indexed_slices.IndexedSlices(values, indices, params_shape), None)
 
 
+@ops.RegisterGradient("_ResourceSparseSegmentReduction")
+def _ResourceSparseSegmentReductionGrad(op, grad):
+  """Gradient for the fused gather and sparse segment reduction op."""
+  handle, ids, indices, segment_ids = op.inputs[:4]
+  combiner = compat.as_str(op.get_attr("combiner"))
+  weights = op.inputs[4 + op.get_attr("num_num_segments"):]
+  # The op is internal, so it has no generated Python wrapper.
+  _, _, _, (values, unique_ids) = op_def_library._apply_op_helper(  # pylint: disable=protected-access
+      "_ResourceSparseSegmentReductionGrad",
+      grad=grad,
+      ids=ids,
+      indices=indices,
+      segment_ids=segment_ids,
+      weights=weights,
+      combiner=combiner)
+  variable_grad = indexed_slices.IndexedSlices(values, unique_ids,
+                                               variable_shape(handle))
+  input_grads = [variable_grad] + [None] * (len(op.inputs) - 1)
+  if not weights:
+    return input_grads
+
+  # The gradient of the output row s with respect to the weight of its row j
+  # is scale[s] * (row[j] - output[s] * c[j]), where c[j] is 0 for "sum", 1
+  # for "mean" and weights[j] * scale[s] for "sqrtn".
+  weights = weights[0]
+  num_segments = array_ops.shape(grad, out_type=segment_ids.dtype)[0]
+  if combiner == "mean":
+    totals = math_ops.unsorted_segment_sum(weights, segment_ids, num_segments)
+    scales = math_ops.div_no_nan(array_ops.ones_like(totals), totals)
+  elif combiner == "sqrtn":
+    totals = math_ops.sqrt(
+        math_ops.unsorted_segment_sum(weights * weights, segment_ids,
+                                      num_segments))
+    scales = math_ops.div_no_nan(array_ops.ones_like(totals), totals)
+  else:
+    scales = array_ops.ones([num_segments], dtype=weights.dtype)
+  row_scales = array_ops.gather(scales, segment_ids)
+  num_rows = array_ops.size(indices)
+  rows = array_ops.reshape(
+      gen_resource_variable_ops.resource_gather(
+          handle, array_ops.gather(ids, indices), dtype=op.get_attr("dtype")),
+      [num_rows, -1])
+  if combiner != "sum":
+    outputs = array_ops.reshape(
+        array_ops.gather(op.outputs[0], segment_ids), [num_rows, -1])
+    if combiner == "sqrtn":
+      outputs *= array_ops.expand_dims(weights * row_scales, 1)
+    rows -= outputs
+  rows_grad = array_ops.reshape(
+      array_ops.gather(grad, segment_ids), [num_rows, -1])
+  input_grads[-1] = math_ops.reduce_sum(rows_grad * rows, axis=1) * row_scales
+  return input_grads
+
+
 @tf_export("__internal__.ops.is_resource_variable", v1=[])
 def is_resource_variable(var):
   """"Returns True if `var` is to be considered a ResourceVariable."""
@@ -0,0 +1,179 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Builds the file of a PerfectHashTable from a text file, with the key and
+// value of each line selected as by InitializeTableFromTextFile:
+//
+// build_perfect_hash_table --input=vocab.txt --output=vocab.table \
+//   --key_dtype=string --value_dtype=int64 --key_index=-2 --value_index=-1
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/perfect_hash_table.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/io/inputbuffer.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/util/command_line_flags.h"
+
+namespace tensorflow {
+namespace {
+
+constexpr int kLineNumber = -1;
+constexpr int kWholeLine = -2;
+constexpr size_t kInputBufferSize = 1 << 20;
+
+// A key or value of a line.
+struct Field {
+  int64_t int64_value = 0;
+  std::string string_value;
+};
+
+Status GetField(const std::string& line, const std::vector<string>& tokens,
+                int index, DataType dtype, int64_t line_number,
+                Field* field) {
+  if (index == kLineNumber) {
+    field->int64_value = line_number;
+    return OkStatus();
+  }
+  const std::string& token = index == kWholeLine ? line : tokens[index];
+  if (dtype == DT_STRING) {
+    field->string_value = token;
+  } else if (!strings::safe_strto64(token, &field->int64_value)) {
+    return errors::InvalidArgument("Field ", token, " in line ", line_number,
+                                   " is not a valid int64.");
+  }
+  return OkStatus();
+}
+
+Status AddEntry(const Field& key, const Field& value,
+                lookup::PerfectHashTableBuilder* builder, DataType key_dtype,
+                DataType value_dtype) {
+  if (key_dtype == DT_INT64) {
+    return value_dtype == DT_INT64
+               ? builder->Add(key.int64_value, value.int64_value)
+               : builder->Add(key.int64_value, value.string_value);
+  }
+  return value_dtype == DT_INT64
+             ? builder->Add(key.string_value, value.int64_value)
+             : builder->Add(key.string_value, value.string_value);
+}
+
+Status BuildTable(const std::string& input, const std::string& output,
+                  DataType key_dtype, DataType value_dtype, int key_index,
+                  int value_index, char delimiter) {
+  if (key_index < kWholeLine || value_index < kWholeLine) {
+    return errors::InvalidArgument("Invalid key or value index");
+  }
+  if ((key_index == kLineNumber && key_dtype != DT_INT64) ||
+      (value_index == kLineNumber && value_dtype != DT_INT64)) {
+    return errors::InvalidArgument("Line numbers are int64");
+  }
+  Env* env = Env::Default();
+  std::unique_ptr<RandomAccessFile> file;
+  TF_RETURN_IF_ERROR(env->NewRandomAccessFile(input, &file));
+  io::InputBuffer input_buffer(file.get(), kInputBufferSize);
+
+  lookup::PerfectHashTableBuilder builder(key_dtype, value_dtype);
+  const int num_columns = std::max(key_index, value_index) + 1;
+  std::string line;
+  Field key;
+  Field value;
+  for (int64_t line_number = 0;; ++line_number) {
+    Status status = input_buffer.ReadLine(&line);
+    if (errors::IsOutOfRange(status)) break;
+    TF_RETURN_IF_ERROR(status);
+    std::vector<string> tokens;
+    if (num_columns > 0) {
+      tokens = str_util::Split(line, delimiter);
+      if (tokens.size() < static_cast<size_t>(num_columns)) {
+        return errors::InvalidArgument("Invalid number of columns in ", input,
+                                       " line ", line_number, " (", line,
+                                       ")");
+      }
+    }
+    TF_RETURN_IF_ERROR(
+        GetField(line, tokens, key_index, key_dtype, line_number, &key));
+    TF_RETURN_IF_ERROR(
+        GetField(line, tokens, value_index, value_dtype, line_number, &value));
+    TF_RETURN_IF_ERROR(
+        AddEntry(key, value, &builder, key_dtype, value_dtype));
+  }
+  TF_RETURN_IF_ERROR(builder.Write(env, output));
+  printf("Wrote %lld entries to %s\n", static_cast<long long>(builder.size()),
+         output.c_str());
+  return OkStatus();
+}
+
+int Run(int argc, char** argv) {
+  string FLAGS_input = "";
+  string FLAGS_output = "";
+  string FLAGS_key_dtype = "string";
+  string FLAGS_value_dtype = "int64";
+  int32_t FLAGS_key_index = kWholeLine;
+  int32_t FLAGS_value_index = kLineNumber;
+  string FLAGS_delimiter = "\t";
+
+  std::vector<Flag> flag_list = {
+      Flag("input", &FLAGS_input, "Input text file name"),
+      Flag("output", &FLAGS_output, "Output table file name"),
+      Flag("key_dtype", &FLAGS_key_dtype, "Type of the keys: int64 or string"),
+      Flag("value_dtype", &FLAGS_value_dtype,
+           "Type of the values: int64 or string"),
+      Flag("key_index", &FLAGS_key_index,
+           "Column of the keys, -2 for the whole line or -1 for the line "
+           "number"),
+      Flag("value_index", &FLAGS_value_index,
+           "Column of the values, -2 for the whole line or -1 for the line "
+           "number"),
+      Flag("delimiter", &FLAGS_delimiter, "Delimiter of the columns")};
+
+  // Parse the command-line.
+  const string usage = Flags::Usage(argv[0], flag_list);
+  const bool parse_ok = Flags::Parse(&argc, argv, flag_list);
+  DataType key_dtype;
+  DataType value_dtype;
+  if (argc != 1 || !parse_ok || FLAGS_input.empty() || FLAGS_output.empty() ||
+      FLAGS_delimiter.size() != 1 ||
+      !DataTypeFromString(FLAGS_key_dtype, &key_dtype) ||
+      !DataTypeFromString(FLAGS_value_dtype, &value_dtype)) {
+    printf("%s", usage.c_str());
+    return 2;
+  }
+
+  port::InitMain(argv[0], &argc, &argv);
+
+  Status s = BuildTable(FLAGS_input, FLAGS_output, key_dtype, value_dtype,
+                        FLAGS_key_index, FLAGS_value_index, FLAGS_delimiter[0]);
+  if (!s.ok()) {
+    printf("Error building table %s: %s\n", FLAGS_output.c_str(),
+           s.ToString().c_str());
+    return 1;
+  }
+  return 0;
+}
+
+}  // namespace
+}  // namespace tensorflow
+
+int main(int argc, char** argv) { return tensorflow::Run(argc, argv); }